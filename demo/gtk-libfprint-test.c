@@ -54,6 +54,9 @@ struct _LibfprintDemoWindow
 
   FpImage             *img;
   ImageDisplayFlags    img_flags;
+
+  gboolean             streaming;
+  cairo_surface_t     *preview_surface;
 };
 
 G_DECLARE_FINAL_TYPE (LibfprintDemoWindow, libfprint_demo_window, FP, DEMO_WINDOW, GtkApplicationWindow)
@@ -187,6 +190,51 @@ update_image (LibfprintDemoWindow *win)
   g_object_unref (pixbuf);
 }
 
+/* Render one streamed frame. The grayscale image is expanded in place
+ * into a persistent cairo image surface that the GtkImage keeps
+ * referencing, so a frame costs a single gray-to-RGB pass and no
+ * per-frame allocation. (GTK 4's GdkMemoryTexture could wrap the
+ * grayscale buffer outright; with GTK 3 a reused image surface is the
+ * closest equivalent.) */
+static void
+libfprint_demo_render_preview (LibfprintDemoWindow *win,
+                               FpImage             *image)
+{
+  int width = fp_image_get_width (image);
+  int height = fp_image_get_height (image);
+  const guint8 *data = fp_image_get_data (image, NULL);
+  guint32 *pixels;
+  int stride, x, y;
+
+  if (!data)
+    return;
+
+  if (win->preview_surface == NULL ||
+      cairo_image_surface_get_width (win->preview_surface) != width ||
+      cairo_image_surface_get_height (win->preview_surface) != height)
+    {
+      g_clear_pointer (&win->preview_surface, cairo_surface_destroy);
+      win->preview_surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                                         width, height);
+    }
+
+  cairo_surface_flush (win->preview_surface);
+  stride = cairo_image_surface_get_stride (win->preview_surface) / 4;
+  pixels = (guint32 *) cairo_image_surface_get_data (win->preview_surface);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        guint32 gray = data[y * width + x];
+
+        pixels[y * stride + x] = gray << 16 | gray << 8 | gray;
+      }
+
+  cairo_surface_mark_dirty (win->preview_surface);
+  gtk_image_set_from_surface (GTK_IMAGE (win->capture_image),
+                              win->preview_surface);
+}
+
 static void
 libfprint_demo_set_spinner_label (LibfprintDemoWindow *win,
                                   const char          *message)
@@ -263,6 +311,48 @@ dev_start_capture (LibfprintDemoWindow *win)
   fp_device_capture (win->dev, TRUE, win->cancellable, (GAsyncReadyCallback) dev_capture_start_cb, win);
 }
 
+static void
+stream_frame_cb (FpDevice *dev,
+                 FpImage  *image,
+                 GError   *error,
+                 gpointer  user_data)
+{
+  LibfprintDemoWindow *win = user_data;
+
+  if (error)
+    {
+      /* Retry errors just mean this frame was unusable. */
+      if (error->domain == FP_DEVICE_RETRY)
+        return;
+
+      win->streaming = FALSE;
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          libfprint_demo_set_mode (win, CAPTURE_MODE);
+        }
+      else
+        {
+          g_warning ("Capture stream stopped: %s", error->message);
+          libfprint_demo_set_mode (win, ERROR_MODE);
+        }
+      return;
+    }
+
+  libfprint_demo_render_preview (win, image);
+}
+
+static void
+dev_start_stream (LibfprintDemoWindow *win)
+{
+  libfprint_demo_set_mode (win, CAPTURE_MODE);
+  /* Streaming keeps the device busy; only cancel makes sense. */
+  gtk_widget_set_sensitive (win->capture_button, FALSE);
+  gtk_widget_set_sensitive (win->cancel_button, TRUE);
+
+  fp_device_capture_stream_start (win->dev, FALSE, win->cancellable,
+                                  stream_frame_cb, win, NULL);
+}
+
 static void
 dev_open_cb (FpDevice *dev, GAsyncResult *res, void *user_data)
 {
@@ -277,7 +367,10 @@ dev_open_cb (FpDevice *dev, GAsyncResult *res, void *user_data)
       return;
     }
 
-  dev_start_capture (win);
+  if (win->streaming)
+    dev_start_stream (win);
+  else
+    dev_start_capture (win);
 }
 
 static void
@@ -383,6 +476,48 @@ activate_show_binary (GSimpleAction *action,
   update_image (win);
 }
 
+static void
+activate_stream (GSimpleAction *action,
+                 GVariant      *parameter,
+                 gpointer       user_data)
+{
+  LibfprintDemoWindow *win = user_data;
+  GVariant *state;
+  gboolean new_state;
+
+  state = g_action_get_state (G_ACTION (action));
+  new_state = !g_variant_get_boolean (state);
+  g_action_change_state (G_ACTION (action), g_variant_new_boolean (new_state));
+  g_variant_unref (state);
+
+  if (!new_state)
+    {
+      if (win->streaming)
+        {
+          fp_device_capture_stream_stop (win->dev);
+          win->streaming = FALSE;
+        }
+      libfprint_demo_set_mode (win, CAPTURE_MODE);
+      return;
+    }
+
+  win->streaming = TRUE;
+  g_clear_object (&win->cancellable);
+  win->cancellable = g_cancellable_new ();
+
+  if (win->opened)
+    {
+      dev_start_stream (win);
+      return;
+    }
+
+  libfprint_demo_set_spinner_label (win, "Opening fingerprint reader");
+  libfprint_demo_set_mode (win, SPINNER_MODE);
+  win->opened = TRUE;
+  fp_device_open (win->dev, win->cancellable,
+                  (GAsyncReadyCallback) dev_open_cb, win);
+}
+
 static void
 change_show_minutiae_state (GSimpleAction *action,
                             GVariant      *state,
@@ -399,6 +534,14 @@ change_show_binary_state (GSimpleAction *action,
   g_simple_action_set_state (action, state);
 }
 
+static void
+change_stream_state (GSimpleAction *action,
+                     GVariant      *state,
+                     gpointer       user_data)
+{
+  g_simple_action_set_state (action, state);
+}
+
 static GActionEntry app_entries[] = {
   { "quit", activate_quit, NULL, NULL, NULL },
 };
@@ -406,6 +549,7 @@ static GActionEntry app_entries[] = {
 static GActionEntry win_entries[] = {
   { "show-minutiae", activate_show_minutiae, NULL, "false", change_show_minutiae_state },
   { "show-binary", activate_show_binary, NULL, "false", change_show_binary_state },
+  { "stream", activate_stream, NULL, "false", change_stream_state },
   { "capture", activate_capture, NULL, NULL, NULL },
   { "cancel", cancel_capture, NULL, NULL, NULL }
 };
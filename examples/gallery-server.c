@@ -0,0 +1,366 @@
+/*
+ * Example gallery server, which keeps the identification gallery in a
+ * single shared-memory mapping that several worker processes attach to
+ * read-only, instead of each process deserializing its own copy.
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "example-gallery-server"
+
+#include <errno.h>
+#include <stdio.h>
+#include <libfprint/fprint.h>
+#include <glib-unix.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "storage.h"
+#include "utilities.h"
+
+/* A gallery file on tmpfs is a plain shared-memory segment: every process
+ * that maps it with fp_gallery_new_for_file() shares the same physical
+ * pages, so N attached matchers cost one copy of the template data rather
+ * than N deserialized copies. */
+#define DEFAULT_GALLERY_PATH "/dev/shm/fprint-example-gallery"
+#define DEFAULT_N_WORKERS 4
+#define MAX_N_WORKERS 64
+
+typedef struct _ServerData
+{
+  GMainLoop    *loop;
+  GCancellable *cancellable;
+  unsigned int  sigint_handler;
+  const char   *gallery_path;
+  GPtrArray    *gallery;
+  pid_t         workers[MAX_N_WORKERS];
+  int           n_workers;
+  int           shutdown_pipe[2];
+  int           ret_value;
+} ServerData;
+
+static void
+server_data_free (ServerData *server_data)
+{
+  g_clear_handle_id (&server_data->sigint_handler, g_source_remove);
+  g_clear_object (&server_data->cancellable);
+  g_clear_pointer (&server_data->gallery, g_ptr_array_unref);
+  g_main_loop_unref (server_data->loop);
+  g_free (server_data);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ServerData, server_data_free)
+
+static long
+resident_kib (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/* Runs in a forked child. Attaches the shared gallery read-only, faults
+ * every template in, then idles until the server closes the shutdown
+ * pipe. In a real deployment this is where each matcher daemon would
+ * run its identification requests against the shared templates. */
+static int
+worker_main (const char *gallery_path, int shutdown_fd)
+{
+  g_autoptr(GPtrArray) gallery = NULL;
+  char buf;
+  guint i;
+
+  gallery = gallery_corpus_load (gallery_path);
+  if (!gallery)
+    return EXIT_FAILURE;
+
+  /* Touch the minutiae tables so the pages are resident, the same state
+   * a matcher reaches after its first identify pass. */
+  for (i = 0; i < gallery->len; i++)
+    fp_print_get_finger (g_ptr_array_index (gallery, i));
+
+  g_print ("worker %d: attached %u prints, peak RSS %ld KiB\n",
+           getpid (), gallery->len, resident_kib ());
+
+  /* Block until the server exits; read returns 0 on pipe close. */
+  while (read (shutdown_fd, &buf, 1) < 0 && errno == EINTR)
+    continue;
+
+  return EXIT_SUCCESS;
+}
+
+static gboolean
+spawn_workers (ServerData *server_data)
+{
+  int i;
+
+  if (pipe (server_data->shutdown_pipe) < 0)
+    {
+      g_warning ("Failed to create shutdown pipe");
+      return FALSE;
+    }
+
+  for (i = 0; i < server_data->n_workers; i++)
+    {
+      pid_t pid = fork ();
+
+      if (pid < 0)
+        {
+          g_warning ("Failed to fork worker process");
+          return FALSE;
+        }
+
+      if (pid == 0)
+        {
+          close (server_data->shutdown_pipe[1]);
+          _exit (worker_main (server_data->gallery_path,
+                              server_data->shutdown_pipe[0]));
+        }
+
+      server_data->workers[i] = pid;
+    }
+
+  close (server_data->shutdown_pipe[0]);
+  server_data->shutdown_pipe[0] = -1;
+
+  return TRUE;
+}
+
+static void
+reap_workers (ServerData *server_data)
+{
+  int i;
+
+  /* Closing the write end wakes every worker's blocking read. */
+  if (server_data->shutdown_pipe[1] >= 0)
+    {
+      close (server_data->shutdown_pipe[1]);
+      server_data->shutdown_pipe[1] = -1;
+    }
+
+  for (i = 0; i < server_data->n_workers; i++)
+    {
+      if (server_data->workers[i] > 0)
+        waitpid (server_data->workers[i], NULL, 0);
+    }
+}
+
+static void
+on_device_closed (FpDevice *dev, GAsyncResult *res, void *user_data)
+{
+  ServerData *server_data = user_data;
+
+  g_autoptr(GError) error = NULL;
+
+  fp_device_close_finish (dev, res, &error);
+
+  if (error)
+    g_warning ("Failed closing device %s", error->message);
+
+  g_main_loop_quit (server_data->loop);
+}
+
+static void
+server_quit (FpDevice   *dev,
+             ServerData *server_data)
+{
+  if (!fp_device_is_open (dev))
+    {
+      g_main_loop_quit (server_data->loop);
+      return;
+    }
+
+  fp_device_close (dev, NULL, (GAsyncReadyCallback) on_device_closed, server_data);
+}
+
+static void
+on_identify_cb (FpDevice *dev, FpPrint *match, FpPrint *print,
+                gpointer user_data, GError *error)
+{
+  ServerData *server_data = user_data;
+
+  if (error)
+    {
+      g_warning ("Identify report: No finger matched, retry error reported: %s",
+                 error->message);
+      return;
+    }
+
+  if (match)
+    {
+      server_data->ret_value = EXIT_SUCCESS;
+      g_print ("IDENTIFIED as user %s!\n", fp_print_get_username (match));
+    }
+  else
+    {
+      g_print ("NOT IDENTIFIED!\n");
+    }
+}
+
+static void
+on_identify_completed (FpDevice *dev, GAsyncResult *res, void *user_data)
+{
+  ServerData *server_data = user_data;
+
+  g_autoptr(FpPrint) print = NULL;
+  g_autoptr(FpPrint) match = NULL;
+  g_autoptr(GError) error = NULL;
+
+  if (!fp_device_identify_finish (dev, res, &match, &print, &error))
+    {
+      g_warning ("Failed to identify print: %s", error->message);
+      server_data->ret_value = EXIT_FAILURE;
+    }
+
+  server_quit (dev, server_data);
+}
+
+static void
+on_device_opened (FpDevice *dev, GAsyncResult *res, void *user_data)
+{
+  ServerData *server_data = user_data;
+
+  g_autoptr(GError) error = NULL;
+
+  if (!fp_device_open_finish (dev, res, &error))
+    {
+      g_warning ("Failed to open device: %s", error->message);
+      server_quit (dev, server_data);
+      return;
+    }
+
+  g_print ("Opened device. Identifying against the shared gallery "
+           "(%u prints, server peak RSS %ld KiB)...\n",
+           server_data->gallery->len, resident_kib ());
+
+  fp_device_identify (dev, server_data->gallery, server_data->cancellable,
+                      on_identify_cb, server_data, NULL,
+                      (GAsyncReadyCallback) on_identify_completed,
+                      server_data);
+}
+
+static gboolean
+sigint_cb (void *user_data)
+{
+  ServerData *server_data = user_data;
+
+  g_cancellable_cancel (server_data->cancellable);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Build the shared gallery once from whatever storage already holds,
+ * unless a previous run (or another tool) left one behind. */
+static gboolean
+prepare_gallery_file (FpDevice *dev, const char *gallery_path)
+{
+  g_autoptr(GPtrArray) stored = NULL;
+
+  if (g_file_test (gallery_path, G_FILE_TEST_EXISTS))
+    return TRUE;
+
+  stored = gallery_data_load (dev);
+  if (!stored || !stored->len)
+    {
+      g_warning ("No stored prints to build a gallery from; enroll first");
+      return FALSE;
+    }
+
+  g_print ("Writing %u stored prints to %s\n", stored->len, gallery_path);
+  return gallery_corpus_save (stored, gallery_path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_autoptr(FpContext) ctx = NULL;
+  g_autoptr(ServerData) server_data = NULL;
+  GPtrArray *devices;
+  FpDevice *dev;
+
+  setenv ("G_MESSAGES_DEBUG", "all", 0);
+  setenv ("LIBUSB_DEBUG", "3", 0);
+
+  ctx = fp_context_new ();
+
+  devices = fp_context_get_devices (ctx);
+  if (!devices)
+    {
+      g_warning ("Impossible to get devices");
+      return EXIT_FAILURE;
+    }
+
+  dev = discover_device (devices);
+  if (!dev)
+    {
+      g_warning ("No devices detected.");
+      return EXIT_FAILURE;
+    }
+
+  if (!fp_device_has_feature (dev, FP_DEVICE_FEATURE_IDENTIFY))
+    {
+      g_warning ("Device %s does not support identification.",
+                 fp_device_get_name (dev));
+      return EXIT_FAILURE;
+    }
+
+  server_data = g_new0 (ServerData, 1);
+  server_data->ret_value = EXIT_FAILURE;
+  server_data->loop = g_main_loop_new (NULL, FALSE);
+  server_data->cancellable = g_cancellable_new ();
+  server_data->gallery_path = argc > 2 ? argv[2] : DEFAULT_GALLERY_PATH;
+  server_data->n_workers = argc > 1 ? atoi (argv[1]) : DEFAULT_N_WORKERS;
+  server_data->shutdown_pipe[0] = -1;
+  server_data->shutdown_pipe[1] = -1;
+
+  if (server_data->n_workers < 1 || server_data->n_workers > MAX_N_WORKERS)
+    {
+      g_warning ("Usage: %s [n-workers (1-%d)] [gallery-path]",
+                 argv[0], MAX_N_WORKERS);
+      return EXIT_FAILURE;
+    }
+
+  if (!prepare_gallery_file (dev, server_data->gallery_path))
+    return EXIT_FAILURE;
+
+  /* The server maps the gallery exactly like the workers do; all of
+   * them share one copy of the template pages. */
+  server_data->gallery = gallery_corpus_load (server_data->gallery_path);
+  if (!server_data->gallery)
+    return EXIT_FAILURE;
+
+  if (!spawn_workers (server_data))
+    {
+      reap_workers (server_data);
+      return EXIT_FAILURE;
+    }
+
+  server_data->sigint_handler = g_unix_signal_add_full (G_PRIORITY_HIGH,
+                                                        SIGINT,
+                                                        sigint_cb,
+                                                        server_data,
+                                                        NULL);
+  fp_device_open (dev, server_data->cancellable,
+                  (GAsyncReadyCallback) on_device_opened,
+                  server_data);
+
+  g_main_loop_run (server_data->loop);
+
+  reap_workers (server_data);
+
+  return server_data->ret_value;
+}
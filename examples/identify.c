@@ -33,6 +33,19 @@ typedef struct _IdentifyData
   GCancellable *cancellable;
   unsigned int  sigint_handler;
   int           ret_value;
+
+  /* Benchmark mode: repeat the identification bench_runs times against
+   * a gallery loaded once (mmap'd when a gallery file is given) and
+   * report latency percentiles. The gallery match itself is sharded
+   * across one worker thread per core inside the library; this measures
+   * the end-to-end latency of that fast path. */
+  GPtrArray    *gallery;
+  GArray       *latencies_us;
+  gint64        bench_started;
+  gint64        run_started;
+  int           bench_runs;
+  int           bench_done;
+  int           bench_matches;
 } IdentifyData;
 
 static void
@@ -40,6 +53,8 @@ identify_data_free (IdentifyData *identify_data)
 {
   g_clear_handle_id (&identify_data->sigint_handler, g_source_remove);
   g_clear_object (&identify_data->cancellable);
+  g_clear_pointer (&identify_data->gallery, g_ptr_array_unref);
+  g_clear_pointer (&identify_data->latencies_us, g_array_unref);
   g_main_loop_unref (identify_data->loop);
   g_free (identify_data);
 }
@@ -76,6 +91,43 @@ identify_quit (FpDevice     *dev,
 static void start_identification (FpDevice     *dev,
                                   IdentifyData *identify_data);
 
+static int
+compare_latency (gconstpointer a, gconstpointer b)
+{
+  gint64 la = *(const gint64 *) a;
+  gint64 lb = *(const gint64 *) b;
+
+  return (la > lb) - (la < lb);
+}
+
+static gint64
+latency_percentile (GArray *latencies_us, int percentile)
+{
+  guint index = (latencies_us->len - 1) * percentile / 100;
+
+  return g_array_index (latencies_us, gint64, index);
+}
+
+static void
+report_benchmark (IdentifyData *identify_data)
+{
+  double elapsed_sec;
+
+  elapsed_sec = (g_get_monotonic_time () - identify_data->bench_started) / 1e6;
+  g_array_sort (identify_data->latencies_us, compare_latency);
+
+  g_print ("Ran %d identifications against %u prints in %.2fs\n",
+           identify_data->bench_done, identify_data->gallery->len,
+           elapsed_sec);
+  g_print ("Matches:  %d/%d\n",
+           identify_data->bench_matches, identify_data->bench_done);
+  g_print ("Latency:  p50 %.2fms, p99 %.2fms\n",
+           latency_percentile (identify_data->latencies_us, 50) / 1e3,
+           latency_percentile (identify_data->latencies_us, 99) / 1e3);
+  g_print ("Rate:     %.1f identifications/sec\n",
+           identify_data->bench_done / elapsed_sec);
+}
+
 static void
 on_identify_completed (FpDevice *dev, GAsyncResult *res, void *user_data)
 {
@@ -98,6 +150,25 @@ on_identify_completed (FpDevice *dev, GAsyncResult *res, void *user_data)
         }
     }
 
+  if (identify_data->bench_runs > 0)
+    {
+      gint64 latency_us = g_get_monotonic_time () - identify_data->run_started;
+
+      g_array_append_val (identify_data->latencies_us, latency_us);
+      identify_data->bench_done++;
+
+      if (identify_data->bench_done < identify_data->bench_runs &&
+          !g_cancellable_is_cancelled (identify_data->cancellable))
+        {
+          start_identification (dev, identify_data);
+          return;
+        }
+
+      report_benchmark (identify_data);
+      identify_quit (dev, identify_data);
+      return;
+    }
+
   g_print ("Identify again? [Y/n]? ");
   if (fgets (buffer, sizeof (buffer), stdin) &&
       (buffer[0] == 'Y' || buffer[0] == 'y' || buffer[0] == '\n'))
@@ -136,6 +207,16 @@ on_identify_cb (FpDevice *dev, FpPrint *match, FpPrint *print,
       return;
     }
 
+  if (identify_data->bench_runs > 0)
+    {
+      if (match)
+        {
+          identify_data->bench_matches++;
+          identify_data->ret_value = EXIT_SUCCESS;
+        }
+      return;
+    }
+
   if (print && fp_print_get_image (print) &&
       print_image_save (print, "identify.pgm"))
     g_print ("Print image saved as identify.pgm\n");
@@ -214,6 +295,30 @@ on_list_completed (FpDevice *dev, GAsyncResult *res, gpointer user_data)
 static void
 start_identification (FpDevice *dev, IdentifyData *identify_data)
 {
+  if (identify_data->bench_runs > 0)
+    {
+      if (!identify_data->gallery)
+        identify_data->gallery = gallery_data_load (dev);
+
+      if (!identify_data->gallery || !identify_data->gallery->len)
+        {
+          g_warning ("No gallery available to benchmark against");
+          identify_quit (dev, identify_data);
+          return;
+        }
+
+      if (!identify_data->bench_started)
+        identify_data->bench_started = g_get_monotonic_time ();
+      identify_data->run_started = g_get_monotonic_time ();
+
+      fp_device_identify (dev, identify_data->gallery,
+                          identify_data->cancellable,
+                          on_identify_cb, identify_data, NULL,
+                          (GAsyncReadyCallback) on_identify_completed,
+                          identify_data);
+      return;
+    }
+
   if (fp_device_has_feature (dev, FP_DEVICE_FEATURE_STORAGE))
     {
       g_print ("Creating finger template, using device storage...\n");
@@ -269,16 +374,27 @@ sigint_cb (void *user_data)
 }
 
 int
-main (void)
+main (int argc, char *argv[])
 {
   g_autoptr(FpContext) ctx = NULL;
   g_autoptr(IdentifyData) identify_data = NULL;
   GPtrArray *devices;
   FpDevice *dev;
+  int bench_runs = 0;
 
   setenv ("G_MESSAGES_DEBUG", "all", 0);
   setenv ("LIBUSB_DEBUG", "3", 0);
 
+  if (argc > 1)
+    {
+      bench_runs = atoi (argv[1]);
+      if (bench_runs < 1)
+        {
+          g_warning ("Usage: %s [bench-runs] [gallery-path]", argv[0]);
+          return EXIT_FAILURE;
+        }
+    }
+
   ctx = fp_context_new ();
 
   devices = fp_context_get_devices (ctx);
@@ -306,6 +422,24 @@ main (void)
   identify_data->ret_value = EXIT_FAILURE;
   identify_data->loop = g_main_loop_new (NULL, FALSE);
   identify_data->cancellable = g_cancellable_new ();
+  identify_data->bench_runs = bench_runs;
+
+  if (bench_runs > 0)
+    {
+      identify_data->latencies_us = g_array_sized_new (FALSE, FALSE,
+                                                       sizeof (gint64),
+                                                       bench_runs);
+
+      if (argc > 2)
+        {
+          /* Map the gallery file once; the template pages are shared
+           * with any other process mapping the same file (see the
+           * gallery-server example). */
+          identify_data->gallery = gallery_corpus_load (argv[2]);
+          if (!identify_data->gallery)
+            return EXIT_FAILURE;
+        }
+    }
   identify_data->sigint_handler = g_unix_signal_add_full (G_PRIORITY_HIGH,
                                                           SIGINT,
                                                           sigint_cb,
@@ -36,8 +36,22 @@ typedef struct CaptureData
   unsigned int  sigint_handler;
   int           ret_value;
   const char   *filename;
+
+  /* Per-stage latency statistics mode, see stats_row_add(). */
+  int           iterations;
+  int           completed;
+  gulong        status_handler;
+  gint64        t_start;
+  gint64        t_needed;
+  gint64        t_present;
+  gint64        t_captured;
+  double        sum[4];
+  double        min[4];
+  double        max[4];
 } CaptureData;
 
+static const char *stat_names[4] = { "arming", "await-finger", "transfer", "minutiae" };
+
 static void
 capture_data_free (CaptureData *capture_data)
 {
@@ -76,6 +90,107 @@ capture_quit (FpDevice    *dev,
   fp_device_close (dev, NULL, (GAsyncReadyCallback) on_device_closed, capture_data);
 }
 
+static void
+stats_row_add (CaptureData *capture_data,
+               const double stages[4])
+{
+  int i;
+
+  g_print ("capture %2d:", capture_data->completed + 1);
+  for (i = 0; i < 4; i++)
+    {
+      g_print ("  %s %7.1f ms", stat_names[i], stages[i]);
+
+      capture_data->sum[i] += stages[i];
+      if (capture_data->completed == 0 || stages[i] < capture_data->min[i])
+        capture_data->min[i] = stages[i];
+      if (capture_data->completed == 0 || stages[i] > capture_data->max[i])
+        capture_data->max[i] = stages[i];
+    }
+  g_print ("\n");
+
+  capture_data->completed++;
+}
+
+static void
+stats_summary_print (CaptureData *capture_data)
+{
+  int i;
+
+  if (capture_data->completed == 0)
+    return;
+
+  g_print ("\nPer-stage latency over %d captures (mean/min/max ms):\n",
+           capture_data->completed);
+  for (i = 0; i < 4; i++)
+    g_print ("  %-12s %7.1f / %7.1f / %7.1f\n",
+             stat_names[i],
+             capture_data->sum[i] / capture_data->completed,
+             capture_data->min[i],
+             capture_data->max[i]);
+}
+
+static void
+on_finger_status (FpDevice    *dev,
+                  GParamSpec  *pspec,
+                  CaptureData *capture_data)
+{
+  FpFingerStatusFlags status = fp_device_get_finger_status (dev);
+
+  if (status & FP_FINGER_STATUS_NEEDED && capture_data->t_needed == 0)
+    capture_data->t_needed = g_get_monotonic_time ();
+  if (status & FP_FINGER_STATUS_PRESENT && capture_data->t_present == 0)
+    capture_data->t_present = g_get_monotonic_time ();
+}
+
+static void start_capture (FpDevice *dev, CaptureData *capture_data);
+
+static void
+minutiae_detected_cb (FpImage      *image,
+                      GAsyncResult *res,
+                      void         *user_data)
+{
+  g_autoptr(GError) error = NULL;
+  CaptureData *capture_data = user_data;
+  FpDevice *dev = g_object_get_data (G_OBJECT (image), "capture-device");
+  double stages[4];
+
+  if (!fp_image_detect_minutiae_finish (image, res, &error))
+    {
+      g_warning ("Error detecting minutiae: %s", error->message);
+      g_object_unref (image);
+      capture_quit (dev, capture_data);
+      return;
+    }
+
+  /* Not every driver reports every finger status transition; fall back
+   * to the previous timestamp so the blame lands on a later stage
+   * rather than producing a bogus negative duration. */
+  if (capture_data->t_needed == 0)
+    capture_data->t_needed = capture_data->t_start;
+  if (capture_data->t_present == 0)
+    capture_data->t_present = capture_data->t_needed;
+
+  stages[0] = (capture_data->t_needed - capture_data->t_start) / 1000.;
+  stages[1] = (capture_data->t_present - capture_data->t_needed) / 1000.;
+  stages[2] = (capture_data->t_captured - capture_data->t_present) / 1000.;
+  stages[3] = (g_get_monotonic_time () - capture_data->t_captured) / 1000.;
+  stats_row_add (capture_data, stages);
+
+  g_object_unref (image);
+
+  if (capture_data->completed < capture_data->iterations &&
+      !g_cancellable_is_cancelled (capture_data->cancellable))
+    {
+      start_capture (dev, capture_data);
+      return;
+    }
+
+  stats_summary_print (capture_data);
+  capture_data->ret_value = EXIT_SUCCESS;
+  capture_quit (dev, capture_data);
+}
+
 static void
 dev_capture_cb (FpDevice     *dev,
                 GAsyncResult *res,
@@ -85,17 +200,30 @@ dev_capture_cb (FpDevice     *dev,
   CaptureData *capture_data = user_data;
   FpImage *image = NULL;
 
-  g_clear_object (&capture_data->cancellable);
-
   image = fp_device_capture_finish (dev, res, &error);
   if (!image)
     {
       g_warning ("Error capturing data: %s", error->message);
+      if (capture_data->iterations > 0)
+        stats_summary_print (capture_data);
       capture_quit (dev, capture_data);
       return;
     }
 
+  if (capture_data->iterations > 0)
+    {
+      capture_data->t_captured = g_get_monotonic_time ();
+      g_object_set_data (G_OBJECT (image), "capture-device", dev);
+      fp_image_detect_minutiae (image, capture_data->cancellable,
+                                (GAsyncReadyCallback) minutiae_detected_cb,
+                                capture_data);
+      return;
+    }
+
+  g_clear_object (&capture_data->cancellable);
+
   save_image_to_pgm (image, capture_data->filename);
+  g_object_unref (image);
 
   capture_quit (dev, capture_data);
 }
@@ -103,6 +231,19 @@ dev_capture_cb (FpDevice     *dev,
 static void
 start_capture (FpDevice *dev, CaptureData *capture_data)
 {
+  if (capture_data->iterations > 0)
+    {
+      if (capture_data->status_handler == 0)
+        capture_data->status_handler =
+          g_signal_connect (dev, "notify::finger-status",
+                            G_CALLBACK (on_finger_status), capture_data);
+
+      capture_data->t_start = g_get_monotonic_time ();
+      capture_data->t_needed = 0;
+      capture_data->t_present = 0;
+      capture_data->t_captured = 0;
+    }
+
   fp_device_capture (dev, TRUE, capture_data->cancellable, (GAsyncReadyCallback) dev_capture_cb, capture_data);
 }
 
@@ -178,10 +319,20 @@ main (int argc, const char *argv[])
                                                          sigint_cb,
                                                          capture_data,
                                                          NULL);
-  if (argc == 2)
-    capture_data->filename = argv[1];
-  else
-    capture_data->filename = "finger.pgm";
+  capture_data->filename = "finger.pgm";
+  if (argc == 3 && g_strcmp0 (argv[1], "-n") == 0)
+    {
+      capture_data->iterations = atoi (argv[2]);
+      if (capture_data->iterations <= 0)
+        {
+          g_warning ("Usage: %s [-n iterations] [filename]", argv[0]);
+          return EXIT_FAILURE;
+        }
+    }
+  else if (argc == 2)
+    {
+      capture_data->filename = argv[1];
+    }
   fp_device_open (dev, capture_data->cancellable,
                   (GAsyncReadyCallback) on_device_opened,
                   capture_data);
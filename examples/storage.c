@@ -117,9 +117,69 @@ load_print_from_data (GVariant *data)
   return print;
 }
 
+GPtrArray *
+gallery_corpus_load (const char *path)
+{
+  g_autoptr(FpGallery) corpus = NULL;
+  g_autoptr(GError) error = NULL;
+  GPtrArray *stored_prints;
+  GPtrArray *gallery;
+  guint i;
+
+  corpus = fp_gallery_new_for_file (path, &error);
+  if (!corpus)
+    {
+      g_warning ("Error loading gallery corpus: %s", error->message);
+      return NULL;
+    }
+
+  /* The prints reference the mapped file directly, so this neither reads
+   * nor copies the template data; they stay valid after the gallery
+   * object goes away. */
+  stored_prints = fp_gallery_get_prints (corpus);
+  gallery = g_ptr_array_new_full (stored_prints->len, g_object_unref);
+  for (i = 0; i < stored_prints->len; i++)
+    g_ptr_array_add (gallery, g_object_ref (g_ptr_array_index (stored_prints, i)));
+
+  return gallery;
+}
+
+gboolean
+gallery_corpus_save (GPtrArray *gallery, const char *path)
+{
+  g_autoptr(GError) error = NULL;
+
+  if (!fp_gallery_write_to_file (gallery, path, &error))
+    {
+      g_warning ("Error saving gallery corpus: %s", error->message);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+gboolean
+gallery_corpus_append (FpPrint *print, const char *path)
+{
+  g_autoptr(GPtrArray) gallery = NULL;
+
+  /* Load whatever is there already; a missing file just means we are
+   * starting a new corpus. */
+  if (g_file_test (path, G_FILE_TEST_EXISTS))
+    gallery = gallery_corpus_load (path);
+  if (!gallery)
+    gallery = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_ptr_array_add (gallery, g_object_ref (print));
+
+  return gallery_corpus_save (gallery, path);
+}
+
 int
 print_data_save (FpPrint *print, FpFinger finger, gboolean update_fingerprint)
 {
+  const gchar *corpus_path = g_getenv (GALLERY_CORPUS_ENV);
+
   g_autofree gchar *descr = get_print_data_descriptor (print, NULL, finger);
 
   g_autoptr(GError) error = NULL;
@@ -129,6 +189,9 @@ print_data_save (FpPrint *print, FpFinger finger, gboolean update_fingerprint)
   gsize size;
   int res;
 
+  if (corpus_path)
+    return gallery_corpus_append (print, corpus_path) ? 0 : -1;
+
   dict = load_data ();
 
   fp_print_serialize (print, &data, &size, &error);
@@ -165,6 +228,8 @@ print_data_load (FpDevice *dev, FpFinger finger)
 GPtrArray *
 gallery_data_load (FpDevice *dev)
 {
+  const char *corpus_path = g_getenv (GALLERY_CORPUS_ENV);
+
   g_autoptr(GVariantDict) dict = NULL;
   g_autoptr(GVariant) dict_variant = NULL;
   g_autofree char *dev_prefix = NULL;
@@ -175,6 +240,9 @@ gallery_data_load (FpDevice *dev)
   GVariant *value;
   gchar *key;
 
+  if (corpus_path)
+    return gallery_corpus_load (corpus_path);
+
   gallery = g_ptr_array_new_with_free_func (g_object_unref);
   dict = load_data ();
   dict_variant = g_variant_dict_end (dict);
@@ -20,6 +20,17 @@
 
 #pragma once
 
+/* When this environment variable points to a file, the gallery is kept
+ * as a single memory-mapped FpGallery corpus instead of the per-print
+ * GVariant dict, which makes loading large test corpora near-instant. */
+#define GALLERY_CORPUS_ENV "FP_GALLERY_CORPUS"
+
+GPtrArray * gallery_corpus_load (const char *path);
+gboolean gallery_corpus_save (GPtrArray  *gallery,
+                              const char *path);
+gboolean gallery_corpus_append (FpPrint    *print,
+                                const char *path);
+
 int print_data_save (FpPrint *print,
                      FpFinger finger,
                      gboolean update_fingerprint);
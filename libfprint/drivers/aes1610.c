@@ -63,6 +63,12 @@ static int adjust_gain (unsigned char *buffer,
 #define FRAME_WIDTH 128
 #define FRAME_HEIGHT 8
 #define FRAME_SIZE (FRAME_WIDTH * FRAME_HEIGHT)
+/* Frame-quality gate: minimum count of strong histogram pixels and
+ * minimum squared deviation of the packed strip bytes for a frame to
+ * take part in assembly. Deliberately conservative; only frames with
+ * essentially no content are dropped. */
+#define FRAME_MIN_COVERAGE 10
+#define FRAME_MIN_SQ_DEV 50
 #define IMAGE_WIDTH (FRAME_WIDTH + (FRAME_WIDTH / 2))
 /* maximum number of frames to read during a scan */
 /* FIXME reduce substantially */
@@ -89,6 +95,7 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = FRAME_HEIGHT,
   .image_width = IMAGE_WIDTH,
   .get_pixel = aes_get_pixel,
+  .packed_4bpp = 1,
 };
 
 typedef void (*aes1610_read_regs_cb)(FpImageDevice *dev,
@@ -575,15 +582,34 @@ capture_read_strip_cb (FpiUsbTransfer *transfer, FpDevice *device,
   fp_dbg ("sum=%d", sum);
   if (sum > 0)
     {
-      /* FIXME: would preallocating strip buffers be a decent optimization? */
-      struct fpi_frame *stripe = g_malloc (FRAME_WIDTH * (FRAME_HEIGHT / 2) + sizeof (struct fpi_frame));
-      stripe->delta_x = 0;
-      stripe->delta_y = 0;
-      stripdata = stripe->data;
-      memcpy (stripdata, data + 1, FRAME_WIDTH * (FRAME_HEIGHT / 2));
-      self->strips = g_slist_prepend (self->strips, stripe);
-      self->strips_len++;
-      self->blanks_count = 0;
+      gint sq_dev;
+
+      /* This sensor frequently produces degenerate frames at the swipe
+       * edges: nearly empty frames with a few strong pixels, or
+       * saturated frames where the whole strip pins flat. Neither
+       * carries usable ridge structure, they only mislead the overlap
+       * search and pad out assembly, so gate on coverage and on the
+       * dynamic range of the strip before keeping it. The deviation is
+       * computed over the nibble-packed bytes, which preserves
+       * flatness. Dropped edge frames do not reset the blank counter,
+       * so a trailing run of junk cannot stall the capture end. */
+      sq_dev = fpi_std_sq_dev (data + 1, FRAME_WIDTH * (FRAME_HEIGHT / 2));
+      if (sum < FRAME_MIN_COVERAGE || sq_dev < FRAME_MIN_SQ_DEV)
+        {
+          fp_dbg ("dropping degenerate frame (sum=%d, sq_dev=%d)", sum, sq_dev);
+        }
+      else
+        {
+          /* FIXME: would preallocating strip buffers be a decent optimization? */
+          struct fpi_frame *stripe = g_malloc (FRAME_WIDTH * (FRAME_HEIGHT / 2) + sizeof (struct fpi_frame));
+          stripe->delta_x = 0;
+          stripe->delta_y = 0;
+          stripdata = stripe->data;
+          memcpy (stripdata, data + 1, FRAME_WIDTH * (FRAME_HEIGHT / 2));
+          self->strips = g_slist_prepend (self->strips, stripe);
+          self->strips_len++;
+          self->blanks_count = 0;
+        }
     }
   else
     {
@@ -67,11 +67,12 @@ struct _FpiDeviceAes2501
 {
   FpImageDevice parent;
 
-  guint8        read_regs_retry_count;
-  GSList       *strips;
-  size_t        strips_len;
-  gboolean      deactivating;
-  int           no_finger_cnt;
+  guint8                      read_regs_retry_count;
+  struct fpi_frame_assembler *assembler;
+  gboolean                    deactivating;
+  int                         no_finger_cnt;
+  guint16                     last_histogram[16];
+  gboolean                    have_last_histogram;
 };
 G_DECLARE_FINAL_TYPE (FpiDeviceAes2501, fpi_device_aes2501, FPI, DEVICE_AES2501,
                       FpImageDevice);
@@ -82,6 +83,7 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = FRAME_HEIGHT,
   .image_width = IMAGE_WIDTH,
   .get_pixel = aes_get_pixel,
+  .packed_4bpp = 1,
 };
 
 typedef void (*aes2501_read_regs_cb)(FpImageDevice *dev,
@@ -454,14 +456,11 @@ capture_read_strip_cb (FpiUsbTransfer *transfer, FpDevice *_dev,
         {
           FpImage *img;
 
-          self->strips = g_slist_reverse (self->strips);
-          fpi_do_movement_estimation (&assembling_ctx, self->strips);
-          img = fpi_assemble_frames (&assembling_ctx,
-                                     self->strips);
+          /* Movement estimation already ran while the swipe was in
+           * progress, only the stitching is left to do here. */
+          img = fpi_frame_assembler_finish (self->assembler);
+          g_clear_pointer (&self->assembler, fpi_frame_assembler_free);
           img->flags |= FPI_IMAGE_PARTIAL;
-          g_slist_free_full (self->strips, g_free);
-          self->strips = NULL;
-          self->strips_len = 0;
           fpi_image_device_image_captured (dev, img);
           fpi_image_device_report_finger_status (dev, FALSE);
           /* marking machine complete will re-trigger finger detection loop */
@@ -475,15 +474,46 @@ capture_read_strip_cb (FpiUsbTransfer *transfer, FpDevice *_dev,
   else
     {
       /* obtain next strip */
-      /* FIXME: would preallocating strip buffers be a decent optimization? */
-      struct fpi_frame *stripe = g_malloc (FRAME_WIDTH * FRAME_HEIGHT / 2 + sizeof (struct fpi_frame));
-      stripe->delta_x = 0;
-      stripe->delta_y = 0;
-      stripdata = stripe->data;
-      memcpy (stripdata, data + 1, 192 * 8);
+      guint16 *histogram = (guint16 *) (data + 1 + 192 * 8 + 1);
+      struct fpi_frame *stripe;
+      int hist_dist = 0;
+      int i;
+
       self->no_finger_cnt = 0;
-      self->strips = g_slist_prepend (self->strips, stripe);
-      self->strips_len++;
+      if (!self->assembler)
+        {
+          self->assembler = fpi_frame_assembler_new (&assembling_ctx,
+                                                     FRAME_WIDTH * FRAME_HEIGHT / 2,
+                                                     MAX_FRAMES);
+          self->have_last_histogram = FALSE;
+        }
+
+      /* The sensor histograms every strip itself; a strip whose
+       * histogram barely differs from the previous one is a stationary
+       * view, so discard it here rather than letting it occupy a frame
+       * slot and a movement-estimation pass. Movement replaces rows and
+       * redistributes bucket counts well past this threshold. */
+      for (i = 0; i < 16; i++)
+        hist_dist += ABS ((int) histogram[i] - (int) self->last_histogram[i]);
+
+      if (self->have_last_histogram && hist_dist < AES2501_HIST_STATIC_THRESH)
+        {
+          fp_dbg ("histogram static (dist=%d), dropping strip", hist_dist);
+          fpi_ssm_jump_to_state (ssm, CAPTURE_REQUEST_STRIP);
+          return;
+        }
+
+      memcpy (self->last_histogram, histogram, sizeof (self->last_histogram));
+      self->have_last_histogram = TRUE;
+
+      /* copy the strip into its preallocated slot */
+      stripe = fpi_frame_assembler_get_slot (self->assembler);
+      if (stripe)
+        {
+          stripdata = stripe->data;
+          memcpy (stripdata, data + 1, 192 * 8);
+          fpi_frame_assembler_commit_slot (self->assembler);
+        }
 
       fpi_ssm_jump_to_state (ssm, CAPTURE_REQUEST_STRIP);
     }
@@ -823,9 +853,7 @@ complete_deactivation (FpImageDevice *dev)
    * maybe we can do this with a master reset, unconditionally? */
 
   self->deactivating = FALSE;
-  g_slist_free (self->strips);
-  self->strips = NULL;
-  self->strips_len = 0;
+  g_clear_pointer (&self->assembler, fpi_frame_assembler_free);
   fpi_image_device_deactivate_complete (dev, NULL);
 }
 
@@ -171,3 +171,9 @@ enum aes2501_sensor_gain2 {
 
 #define AES2501_SUM_HIGH_THRESH 1000
 #define AES2501_SUM_LOW_THRESH 700
+
+/* Maximum L1 distance between the sensor-computed histograms of two
+ * consecutive strips for the newer one to count as stationary. The
+ * histogram covers 3072 pixels; this allows ~2% of the counts to move
+ * between buckets from noise. */
+#define AES2501_HIST_STATIC_THRESH 64
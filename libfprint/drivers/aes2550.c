@@ -59,6 +59,7 @@ struct _FpiDeviceAes2550
   size_t        strips_len;
   gboolean      deactivating;
   int           heartbeat_cnt;
+  GCancellable *fd_cancellable;
 };
 G_DECLARE_FINAL_TYPE (FpiDeviceAes2550, fpi_device_aes2550, FPI, DEVICE_AES2550,
                       FpImageDevice);
@@ -69,6 +70,7 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = FRAME_HEIGHT,
   .image_width = IMAGE_WIDTH,
   .get_pixel = aes_get_pixel,
+  .packed_4bpp = 1,
 };
 
 /****** FINGER PRESENCE DETECTION ******/
@@ -80,21 +82,33 @@ static unsigned char finger_det_reqs[] = {
   0xbd, (0 << AES2550_REGBD_LPO_IN_15_8_OFS),
   0xbe, (0 << AES2550_REGBE_LPO_IN_7_0_OFS),
   0xcf, AES2550_REGCF_INTERFERENCE_CHK_EN,
+  /* Re-arm finger detection from the chip's own low power oscillator,
+   * so the host parks a single read instead of polling. */
+  0x80, AES2550_REG80_LPO_START | AES2550_REG80_AUTO_RESTART_FD,
   AES2550_CMD_HEARTBEAT, 0x00, 0x01, 0x00,       /* Heart beat off */
   AES2550_CMD_RUN_FD,
 };
 
 static void start_finger_detection (FpImageDevice *dev);
+static void park_finger_detection (FpImageDevice *dev);
 
 static void
 finger_det_data_cb (FpiUsbTransfer *transfer, FpDevice *device,
                     gpointer user_data, GError *error)
 {
   FpImageDevice *dev = FP_IMAGE_DEVICE (device);
+  FpiDeviceAes2550 *self = FPI_DEVICE_AES2550 (device);
   unsigned char *data = transfer->buffer;
 
   if (error)
     {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+          self->deactivating)
+        {
+          g_error_free (error);
+          complete_deactivation (dev);
+          return;
+        }
       fpi_image_device_session_error (FP_IMAGE_DEVICE (device), error);
       return;
     }
@@ -106,21 +120,44 @@ finger_det_data_cb (FpiUsbTransfer *transfer, FpDevice *device,
   if ((transfer->actual_length >= 2) && (data[0] == 0x83) && (data[1] & AES2550_REG83_FINGER_PRESENT))
     {
       /* finger present, start capturing */
+      g_clear_object (&self->fd_cancellable);
       fpi_image_device_report_finger_status (dev, TRUE);
       start_capture (dev);
     }
   else
     {
-      /* no finger, poll for a new histogram */
-      start_finger_detection (dev);
+      /* No finger. The chip re-runs detection by itself, so just park
+       * the read again for the next result. */
+      park_finger_detection (dev);
     }
 }
 
+/* Park a read on the result endpoint with no timeout; the chip's
+ * auto-restarted finger detection completes it whenever it has
+ * something to say, without the host polling in between. */
+static void
+park_finger_detection (FpImageDevice *dev)
+{
+  FpiDeviceAes2550 *self = FPI_DEVICE_AES2550 (dev);
+  FpiUsbTransfer *transfer;
+
+  if (self->deactivating)
+    {
+      complete_deactivation (dev);
+      return;
+    }
+
+  transfer = fpi_usb_transfer_new (FP_DEVICE (dev));
+  /* 2 bytes of result */
+  fpi_usb_transfer_fill_bulk (transfer, EP_IN, AES2550_EP_IN_BUF_SIZE);
+  fpi_usb_transfer_submit (transfer, 0, self->fd_cancellable,
+                           finger_det_data_cb, NULL);
+}
+
 static void
 finger_det_reqs_cb (FpiUsbTransfer *t, FpDevice *device,
                     gpointer user_data, GError *error)
 {
-  FpiUsbTransfer *transfer;
   FpImageDevice *dev = FP_IMAGE_DEVICE (device);
 
   if (error)
@@ -129,11 +166,7 @@ finger_det_reqs_cb (FpiUsbTransfer *t, FpDevice *device,
       return;
     }
 
-  transfer = fpi_usb_transfer_new (device);
-  /* 2 bytes of result */
-  fpi_usb_transfer_fill_bulk (transfer, EP_IN, AES2550_EP_IN_BUF_SIZE);
-  fpi_usb_transfer_submit (transfer, BULK_TIMEOUT, NULL,
-                           finger_det_data_cb, NULL);
+  park_finger_detection (dev);
 }
 
 static void
@@ -150,6 +183,9 @@ start_finger_detection (FpImageDevice *dev)
       return;
     }
 
+  g_clear_object (&self->fd_cancellable);
+  self->fd_cancellable = g_cancellable_new ();
+
   transfer = fpi_usb_transfer_new (FP_DEVICE (dev));
   transfer->short_is_error = TRUE;
   fpi_usb_transfer_fill_bulk_full (transfer, EP_OUT, finger_det_reqs,
@@ -512,6 +548,10 @@ dev_deactivate (FpImageDevice *dev)
   FpiDeviceAes2550 *self = FPI_DEVICE_AES2550 (dev);
 
   self->deactivating = TRUE;
+  /* Kick the parked finger-detection read so deactivation does not
+   * have to wait for the chip to report. */
+  if (self->fd_cancellable)
+    g_cancellable_cancel (self->fd_cancellable);
 }
 
 static void
@@ -522,6 +562,7 @@ complete_deactivation (FpImageDevice *dev)
   G_DEBUG_HERE ();
 
   self->deactivating = FALSE;
+  g_clear_object (&self->fd_cancellable);
   g_slist_free (self->strips);
   self->strips = NULL;
   self->strips_len = 0;
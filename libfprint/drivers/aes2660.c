@@ -40,6 +40,7 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = AESX660_FRAME_HEIGHT,
   .image_width = IMAGE_WIDTH,
   .get_pixel = aes_get_pixel,
+  .packed_4bpp = 1,
 };
 
 static const FpIdEntry id_table[] = {
@@ -46,6 +46,14 @@ typedef struct
    * and for cancellation.
    */
   GCancellable *img_capture_cancel;
+
+  /* Raw frame buffer, allocated once and reused by every capture's
+   * bulk transfer. */
+  guint8       *capture_buf;
+
+  /* The next capture was already queued from img_cb, so the
+   * AWAIT_FINGER_ON transition must not start another one. */
+  gboolean      capture_prequeued;
 } FpiDeviceAes3kPrivate;
 
 #define CTRL_TIMEOUT 1000
@@ -53,6 +61,7 @@ typedef struct
 #define EP_OUT (2 | FPI_USB_ENDPOINT_OUT)
 
 static void do_capture (FpImageDevice *dev);
+static void do_capture_start (FpImageDevice *dev);
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (FpiDeviceAes3k, fpi_device_aes3k, FP_TYPE_IMAGE_DEVICE);
 
@@ -82,12 +91,14 @@ img_cb (FpiUsbTransfer *transfer, FpDevice *device,
   FpiDeviceAes3kPrivate *priv = fpi_device_aes3k_get_instance_private (self);
   FpiDeviceAes3kClass *cls = FPI_DEVICE_AES3K_GET_CLASS (self);
   unsigned char *ptr = transfer->buffer;
+  guint8 *assembled;
   FpImage *tmp;
   FpImage *img;
   int i;
 
   /* Image capture operation is finished (error/completed) */
   g_clear_object (&priv->img_capture_cancel);
+  priv->capture_prequeued = FALSE;
 
   if (error)
     {
@@ -107,17 +118,24 @@ img_cb (FpiUsbTransfer *transfer, FpDevice *device,
 
   fpi_image_device_report_finger_status (dev, TRUE);
 
-  tmp = fp_image_new (cls->frame_width, cls->frame_width);
-  tmp->width = cls->frame_width;
-  tmp->height = cls->frame_width;
-  tmp->flags = FPI_IMAGE_COLORS_INVERTED | FPI_IMAGE_V_FLIPPED | FPI_IMAGE_H_FLIPPED;
+  assembled = g_malloc (cls->frame_width * cls->frame_width);
   for (i = 0; i < cls->frame_number; i++)
     {
       fp_dbg ("frame header byte %02x", *ptr);
       ptr++;
-      aes3k_assemble_image (ptr, cls->frame_width, AES3K_FRAME_HEIGHT, tmp->data + (i * cls->frame_width * AES3K_FRAME_HEIGHT));
+      aes3k_assemble_image (ptr, cls->frame_width, AES3K_FRAME_HEIGHT, assembled + (i * cls->frame_width * AES3K_FRAME_HEIGHT));
       ptr += cls->frame_size;
     }
+  tmp = fp_image_new_take (cls->frame_width, cls->frame_width, assembled);
+  tmp->flags = FPI_IMAGE_COLORS_INVERTED | FPI_IMAGE_V_FLIPPED | FPI_IMAGE_H_FLIPPED;
+
+  /* The raw buffer is decoded; queue the next capture now so its
+   * register writes and bulk transfer overlap the resize and minutiae
+   * detection below. If the action completes instead, deactivation
+   * cancels it like any other pending capture. */
+  priv->img_capture_cancel = g_cancellable_new ();
+  priv->capture_prequeued = TRUE;
+  do_capture_start (dev);
 
   /* FIXME: this is an ugly hack to make the image big enough for NBIS
    * to process reliably */
@@ -140,8 +158,12 @@ do_capture (FpImageDevice *dev)
   FpiDeviceAes3kPrivate *priv = fpi_device_aes3k_get_instance_private (self);
   FpiDeviceAes3kClass *cls = FPI_DEVICE_AES3K_GET_CLASS (self);
 
+  if (!priv->capture_buf)
+    priv->capture_buf = g_malloc (cls->data_buflen);
+
   img_trf = fpi_usb_transfer_new (FP_DEVICE (dev));
-  fpi_usb_transfer_fill_bulk (img_trf, EP_IN, cls->data_buflen);
+  fpi_usb_transfer_fill_bulk_full (img_trf, EP_IN, priv->capture_buf,
+                                   cls->data_buflen, NULL);
   img_trf->short_is_error = TRUE;
   fpi_usb_transfer_submit (g_steal_pointer (&img_trf), 0,
                            priv->img_capture_cancel,
@@ -157,6 +179,7 @@ capture_reqs_cb (FpImageDevice *dev, GError *result, void *user_data)
   if (result)
     {
       g_clear_object (&priv->img_capture_cancel);
+      priv->capture_prequeued = FALSE;
       fpi_image_device_session_error (dev, result);
       return;
     }
@@ -213,6 +236,14 @@ aes3k_dev_change_state (FpImageDevice *dev, FpiImageDeviceState state)
 
   if (state == FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON)
     {
+      /* img_cb already queued this capture while the previous image
+       * was being processed. */
+      if (priv->capture_prequeued)
+        {
+          priv->capture_prequeued = FALSE;
+          return;
+        }
+
       g_assert (!priv->img_capture_cancel);
       priv->img_capture_cancel = g_cancellable_new ();
 
@@ -244,6 +275,11 @@ aes3k_dev_deinit (FpImageDevice *dev)
 {
   GError *error = NULL;
 
+  FpiDeviceAes3k *self = FPI_DEVICE_AES3K (dev);
+  FpiDeviceAes3kPrivate *priv = fpi_device_aes3k_get_instance_private (self);
+
+  g_clear_pointer (&priv->capture_buf, g_free);
+
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (dev)),
                                   0, 0, &error);
   fpi_image_device_close_complete (dev, error);
@@ -153,17 +153,71 @@ aes_write_regv (FpImageDevice *dev, const struct aes_regwrite *regs,
   continue_write_regv (dev, wdata);
 }
 
+/* Expands one packed 4bpp byte to its two 8bpp pixels: the low nibble
+ * is the even pixel, the high nibble the odd one, each scaled by 17
+ * into the full 8-bit range. The two output bytes are laid out in
+ * memory order, so a table entry can be stored as-is. */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define AES_EXPAND(n) ((guint16) ((((n) & 0xf) * 17) | ((((n) >> 4) * 17) << 8)))
+#else
+#define AES_EXPAND(n) ((guint16) (((((n) & 0xf) * 17) << 8) | (((n) >> 4) * 17)))
+#endif
+#define AES_EXPAND_2(n)   AES_EXPAND (n), AES_EXPAND ((n) + 1)
+#define AES_EXPAND_4(n)   AES_EXPAND_2 (n), AES_EXPAND_2 ((n) + 2)
+#define AES_EXPAND_8(n)   AES_EXPAND_4 (n), AES_EXPAND_4 ((n) + 4)
+#define AES_EXPAND_16(n)  AES_EXPAND_8 (n), AES_EXPAND_8 ((n) + 8)
+#define AES_EXPAND_32(n)  AES_EXPAND_16 (n), AES_EXPAND_16 ((n) + 16)
+#define AES_EXPAND_64(n)  AES_EXPAND_32 (n), AES_EXPAND_32 ((n) + 32)
+#define AES_EXPAND_128(n) AES_EXPAND_64 (n), AES_EXPAND_64 ((n) + 64)
+
+const guint16 aes_4bpp_expand_lut[256] = {
+  AES_EXPAND_128 (0), AES_EXPAND_128 (128)
+};
+
+/* Expand a run of vertically packed 4bpp pixels (two per byte, low
+ * nibble first) into 8bpp, two pixels per table load. The wide stores
+ * go through memcpy to stay alignment-safe, which compiles down to
+ * plain 64-bit stores. */
+void
+aes_unpack_4bpp (const unsigned char *packed,
+                 unsigned char       *out,
+                 unsigned int         npixels)
+{
+  unsigned int i = 0;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  for (; i + 8 <= npixels; i += 8, packed += 4)
+    {
+      guint64 v = (guint64) aes_4bpp_expand_lut[packed[0]] |
+                  (guint64) aes_4bpp_expand_lut[packed[1]] << 16 |
+                  (guint64) aes_4bpp_expand_lut[packed[2]] << 32 |
+                  (guint64) aes_4bpp_expand_lut[packed[3]] << 48;
+
+      memcpy (out + i, &v, sizeof (v));
+    }
+#endif
+
+  for (; i + 2 <= npixels; i += 2, packed++)
+    {
+      guint16 v = aes_4bpp_expand_lut[*packed];
+
+      memcpy (out + i, &v, sizeof (v));
+    }
+
+  if (i < npixels)
+    out[i] = (*packed & 0xf) * 17;
+}
+
 unsigned char
 aes_get_pixel (struct fpi_frame_asmbl_ctx *ctx,
                struct fpi_frame           *frame,
                unsigned int                x,
                unsigned int                y)
 {
-  unsigned char ret;
+  const unsigned char *pair;
 
-  ret = frame->data[x * (ctx->frame_height >> 1) + (y >> 1)];
-  ret = y % 2 ? ret >> 4 : ret & 0xf;
-  ret *= 17;
+  pair = (const unsigned char *)
+         &aes_4bpp_expand_lut[frame->data[x * (ctx->frame_height >> 1) + (y >> 1)]];
 
-  return ret;
+  return pair[y & 1];
 }
@@ -44,3 +44,11 @@ unsigned char aes_get_pixel (struct fpi_frame_asmbl_ctx *ctx,
                              struct fpi_frame           *frame,
                              unsigned int                x,
                              unsigned int                y);
+
+/* One entry per packed 4bpp byte, holding both expanded 8bpp pixels in
+ * memory order (even pixel first). */
+extern const guint16 aes_4bpp_expand_lut[256];
+
+void aes_unpack_4bpp (const unsigned char *packed,
+                      unsigned char       *out,
+                      unsigned int         npixels);
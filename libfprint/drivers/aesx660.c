@@ -33,6 +33,9 @@ typedef struct
   GSList             *strips;
   size_t              strips_len;
   gboolean            deactivating;
+  /* Whether the init and calibration sequences already ran since the
+   * device was opened; later activations only re-check the sensor ID. */
+  gboolean            init_done;
   struct aesX660_cmd *init_seq;
   size_t              init_seq_len;
   unsigned int        init_cmd_idx;
@@ -537,6 +540,17 @@ activate_read_id_cb (FpiUsbTransfer *transfer, FpDevice *device,
   switch (priv->init_seq_idx)
     {
     case 0:
+      if (priv->init_done)
+        {
+          /* The init and calibration sequences already ran since the
+           * device was opened and the ID read above just validated
+           * that the sensor is still responsive, so skip straight to
+           * finger detection. */
+          fp_dbg ("Activate: sensor already initialized, skipping init");
+          fpi_ssm_mark_completed (transfer->ssm);
+          break;
+        }
+
       priv->init_seq = cls->init_seqs[0];
       priv->init_seq_len = cls->init_seqs_len[0];
       priv->init_seq_idx = 1;
@@ -659,6 +673,11 @@ activate_run_state (FpiSsm *ssm, FpDevice *_dev)
 static void
 activate_sm_complete (FpiSsm *ssm, FpDevice *_dev, GError *error)
 {
+  FpiDeviceAesX660 *self = FPI_DEVICE_AES_X660 (_dev);
+  FpiDeviceAesX660Private *priv = fpi_device_aes_x660_get_instance_private (self);
+
+  priv->init_done = error == NULL;
+
   fpi_image_device_activate_complete (FP_IMAGE_DEVICE (_dev), error);
 
   if (!error)
@@ -708,6 +727,7 @@ aesX660_dev_deinit (FpImageDevice *dev)
                                   0, 0, &error);
 
   g_clear_pointer (&priv->stripe_packet, g_byte_array_unref);
+  priv->init_done = FALSE;
 
   fpi_image_device_close_complete (dev, error);
 }
@@ -36,6 +36,7 @@ struct _FpDeviceEgis0570
   gboolean      stop;
 
   GSList       *strips;
+  GSList       *packets;
   guint8       *background;
   gsize         strips_len;
 
@@ -45,10 +46,24 @@ struct _FpDeviceEgis0570
 G_DECLARE_FINAL_TYPE (FpDeviceEgis0570, fpi_device_egis0570, FPI, DEVICE_EGIS0570, FpImageDevice);
 G_DEFINE_TYPE (FpDeviceEgis0570, fpi_device_egis0570, FP_TYPE_IMAGE_DEVICE);
 
+/* Stripes reference their pixels in place inside the USB packet, which
+ * is kept alive in self->packets until the swipe is assembled. */
+struct egis_frame
+{
+  struct fpi_frame frame;
+  const guint8    *pixels;
+};
+
 static unsigned char
 egis_get_pixel (struct fpi_frame_asmbl_ctx *ctx, struct fpi_frame *frame, unsigned int x, unsigned int y)
 {
-  return frame->data[x + y * ctx->frame_width];
+  return ((struct egis_frame *) frame)->pixels[x + y * ctx->frame_width];
+}
+
+static const unsigned char *
+egis_get_frame_data (struct fpi_frame_asmbl_ctx *ctx, struct fpi_frame *frame)
+{
+  return ((struct egis_frame *) frame)->pixels;
 }
 
 static struct fpi_frame_asmbl_ctx assembling_ctx = {
@@ -56,6 +71,8 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = EGIS0570_RFMGHEIGHT,
   .image_width = EGIS0570_IMGWIDTH * 4 / 3,
   .get_pixel = egis_get_pixel,
+  .get_frame_data = egis_get_frame_data,
+  .packed_8bpp = 1,
 };
 
 /*
@@ -139,13 +156,14 @@ postprocess_frames (FpDeviceEgis0570 *self, guint8 * img)
 static void
 data_resp_cb (FpiUsbTransfer *transfer, FpDevice *dev, gpointer user_data, GError *error)
 {
-  unsigned char *stripdata;
   gboolean end = FALSE;
+  gboolean retained = FALSE;
   FpImageDevice *img_self = FP_IMAGE_DEVICE (dev);
   FpDeviceEgis0570 *self = FPI_DEVICE_EGIS0570 (dev);
 
   if (error)
     {
+      g_free (transfer->buffer);
       fpi_ssm_mark_failed (transfer->ssm, error);
       return;
     }
@@ -158,20 +176,18 @@ data_resp_cb (FpiUsbTransfer *transfer, FpDevice *dev, gpointer user_data, GErro
 
       fpi_image_device_report_finger_status (img_self, TRUE);
 
-      g_object_get (dev, "fpi-image-device-state", &state, NULL);
+      state = fpi_image_device_get_state (img_self);
       if (state == FPI_IMAGE_DEVICE_STATE_CAPTURE)
         {
           for (size_t k = 0; k < EGIS0570_IMGCOUNT; k += 1)
             {
               if (where_finger_is & (1 << k))
                 {
-                  struct fpi_frame *stripe = g_malloc (EGIS0570_IMGWIDTH * EGIS0570_RFMGHEIGHT + sizeof (struct fpi_frame));
-                  stripe->delta_x = 0;
-                  stripe->delta_y = 0;
-                  stripdata = stripe->data;
-                  memcpy (stripdata, (transfer->buffer) + (((k) * EGIS0570_IMGSIZE) + EGIS0570_IMGWIDTH * EGIS0570_RFMDIS), EGIS0570_IMGWIDTH * EGIS0570_RFMGHEIGHT);
+                  struct egis_frame *stripe = g_new0 (struct egis_frame, 1);
+                  stripe->pixels = (transfer->buffer) + (((k) * EGIS0570_IMGSIZE) + EGIS0570_IMGWIDTH * EGIS0570_RFMDIS);
                   self->strips = g_slist_prepend (self->strips, stripe);
                   self->strips_len += 1;
+                  retained = TRUE;
                 }
               else
                 {
@@ -186,6 +202,12 @@ data_resp_cb (FpiUsbTransfer *transfer, FpDevice *dev, gpointer user_data, GErro
       end = TRUE;
     }
 
+  /* Stripes only reference the packet; keep it alive until assembly. */
+  if (retained)
+    self->packets = g_slist_prepend (self->packets, transfer->buffer);
+  else
+    g_free (transfer->buffer);
+
   if (end)
     {
       if (!self->stop && (self->strips_len > 0))
@@ -198,6 +220,8 @@ data_resp_cb (FpiUsbTransfer *transfer, FpDevice *dev, gpointer user_data, GErro
           g_slist_free_full (self->strips, g_free);
           self->strips = NULL;
           self->strips_len = 0;
+          g_slist_free_full (self->packets, g_free);
+          self->packets = NULL;
           FpImage *resizeImage = fpi_image_resize (img, EGIS0570_RESIZE, EGIS0570_RESIZE);
           fpi_image_device_image_captured (img_self, resizeImage);
         }
@@ -213,7 +237,11 @@ recv_data_resp (FpiSsm *ssm, FpDevice *dev)
 {
   FpiUsbTransfer *transfer = fpi_usb_transfer_new (dev);
 
-  fpi_usb_transfer_fill_bulk (transfer, EGIS0570_EPIN, EGIS0570_INPSIZE);
+  /* The driver keeps ownership of the buffer: stripes are consumed in
+   * place from it and it must outlive the transfer. */
+  fpi_usb_transfer_fill_bulk_full (transfer, EGIS0570_EPIN,
+                                   g_malloc (EGIS0570_INPSIZE),
+                                   EGIS0570_INPSIZE, NULL);
 
   transfer->ssm = ssm;
   transfer->short_is_error = TRUE;
@@ -342,6 +370,9 @@ loop_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
 
   self->running = FALSE;
   g_clear_pointer (&self->background, g_free);
+  g_slist_free_full (g_steal_pointer (&self->strips), g_free);
+  self->strips_len = 0;
+  g_slist_free_full (g_steal_pointer (&self->packets), g_free);
 
   if (error)
     fpi_image_device_session_error (img_dev, error);
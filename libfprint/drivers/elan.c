@@ -41,6 +41,85 @@
 #include "drivers_api.h"
 #include "elan.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ELAN_HAVE_SIMD 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ELAN_HAVE_SIMD 1
+#endif
+
+#ifdef ELAN_HAVE_SIMD
+
+#if defined(__SSE2__)
+
+/* Running unsigned 16-bit min/max over 8 lanes. SSE2 only has signed
+ * 16-bit min/max, so the lanes are biased by 0x8000 first. */
+static inline void
+elan_minmax_run8 (const unsigned short *px, void *vmin, void *vmax)
+{
+  const __m128i bias = _mm_set1_epi16 ((short) 0x8000);
+  __m128i v = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) px), bias);
+
+  *(__m128i *) vmin = _mm_min_epi16 (*(__m128i *) vmin, v);
+  *(__m128i *) vmax = _mm_max_epi16 (*(__m128i *) vmax, v);
+}
+
+/* ((a - sub) * scale) >> 16 in eight unsigned 16-bit lanes, with the
+ * intermediate product computed in 32 bits. SSE2 has no 32-bit lane
+ * multiply, so pmuludq covers the even and odd lanes separately. */
+static inline __m128i
+elan_mulshift_run8 (__m128i v, __m128i sub, __m128i scale)
+{
+  __m128i d = _mm_sub_epi16 (v, sub);
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i lo = _mm_unpacklo_epi16 (d, zero);
+  __m128i hi = _mm_unpackhi_epi16 (d, zero);
+  __m128i r[2];
+  int half;
+
+  for (half = 0; half < 2; half++)
+    {
+      __m128i w = half ? hi : lo;
+      __m128i even = _mm_srli_epi64 (_mm_mul_epu32 (w, scale), 16);
+      __m128i odd = _mm_srli_epi64 (_mm_mul_epu32 (_mm_srli_si128 (w, 4),
+                                                   scale), 16);
+
+      r[half] = _mm_or_si128 (even, _mm_slli_si128 (odd, 4));
+    }
+
+  return _mm_packs_epi32 (r[0], r[1]);
+}
+
+#elif defined(__ARM_NEON)
+
+static inline void
+elan_minmax_run8 (const unsigned short *px, void *vmin, void *vmax)
+{
+  uint16x8_t v = vld1q_u16 (px);
+
+  *(uint16x8_t *) vmin = vminq_u16 (*(uint16x8_t *) vmin, v);
+  *(uint16x8_t *) vmax = vmaxq_u16 (*(uint16x8_t *) vmax, v);
+}
+
+/* ((a - sub) * scale) >> 16 in eight unsigned 16-bit lanes, with the
+ * intermediate product computed in 32 bits. */
+static inline uint16x8_t
+elan_mulshift_run8 (uint16x8_t v, uint16x8_t sub, uint32x4_t scale)
+{
+  uint16x8_t d = vsubq_u16 (v, sub);
+  uint32x4_t lo = vshrq_n_u32 (vmulq_u32 (vmovl_u16 (vget_low_u16 (d)),
+                                          scale), 16);
+  uint32x4_t hi = vshrq_n_u32 (vmulq_u32 (vmovl_u16 (vget_high_u16 (d)),
+                                          scale), 16);
+
+  return vcombine_u16 (vmovn_u32 (lo), vmovn_u32 (hi));
+}
+
+#endif
+
+#endif /* ELAN_HAVE_SIMD */
+
 static unsigned char
 elan_get_pixel (struct fpi_frame_asmbl_ctx *ctx,
                 struct fpi_frame *frame, unsigned int x,
@@ -54,6 +133,7 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = 0,
   .image_width = 0,
   .get_pixel = elan_get_pixel,
+  .packed_8bpp = 1,
 };
 
 struct _FpiDeviceElan
@@ -83,7 +163,9 @@ struct _FpiDeviceElan
   unsigned char   frame_height;
   unsigned char   raw_frame_height;
   int             num_frames;
-  GSList         *frames;
+  /* preallocated storage for ELAN_MAX_FRAMES frames, filled in place
+   * during capture so no per-frame allocation is needed */
+  unsigned short *frame_arena;
   /* end state */
 };
 G_DEFINE_TYPE (FpiDeviceElan, fpi_device_elan, FP_TYPE_IMAGE_DEVICE);
@@ -107,13 +189,15 @@ elan_dev_reset_state (FpiDeviceElan *elandev)
   g_free (elandev->last_read);
   elandev->last_read = NULL;
 
-  g_slist_free_full (elandev->frames, g_free);
-  elandev->frames = NULL;
   elandev->num_frames = 0;
 }
 
-static void
-elan_save_frame (FpiDeviceElan *self, unsigned short *frame)
+/* copy the last read into @frame, deinterleaving/rotating as needed;
+ * if @background is non-NULL it is subtracted during the copy (saving a
+ * second pass over the frame) and the sum of the result is returned */
+static unsigned int
+elan_save_frame (FpiDeviceElan *self, unsigned short *frame,
+                 const unsigned short *background)
 {
   G_DEBUG_HERE ();
 
@@ -136,18 +220,26 @@ elan_save_frame (FpiDeviceElan *self, unsigned short *frame)
   unsigned char raw_height = self->raw_frame_height;
   unsigned char frame_margin = (raw_height - self->frame_height) / 2;
   int frame_idx, raw_idx;
+  unsigned int sum = 0;
 
   for (int y = 0; y < frame_height; y++)
     for (int x = 0; x < frame_width; x++)
       {
+        unsigned short px;
+
         if (self->dev_type & ELAN_NOT_ROTATED)
           raw_idx = x + (y + frame_margin) * frame_width;
         else
           raw_idx = frame_margin + y + x * raw_height;
         frame_idx = x + y * frame_width;
-        frame[frame_idx] =
-          ((unsigned short *) self->last_read)[raw_idx];
+        px = ((unsigned short *) self->last_read)[raw_idx];
+        if (background)
+          px = background[frame_idx] > px ? 0 : px - background[frame_idx];
+        frame[frame_idx] = px;
+        sum += px;
       }
+
+  return sum;
 }
 
 static void
@@ -159,7 +251,7 @@ elan_save_background (FpiDeviceElan *elandev)
   elandev->background =
     g_malloc (elandev->frame_width * elandev->frame_height *
               sizeof (short));
-  elan_save_frame (elandev, elandev->background);
+  elan_save_frame (elandev, elandev->background, NULL);
 }
 
 /* save a frame as part of the fingerprint image
@@ -167,7 +259,7 @@ elan_save_background (FpiDeviceElan *elandev)
  * Elantech recommends 2-step non-linear normalization in order to reduce
  * 2^14 ADC resolution to 2^8 image:
  *
- * 1. background is subtracted (done here)
+ * 1. background is subtracted (fused into the copy in elan_save_frame)
  *
  * 2. pixels are grouped in 3 groups by intensity and each group is mapped
  *    separately onto the normalized frame (done in elan_process_frame_*)
@@ -203,29 +295,18 @@ elan_save_img_frame (FpiDeviceElan *elandev)
   G_DEBUG_HERE ();
 
   unsigned int frame_size = elandev->frame_width * elandev->frame_height;
-  unsigned short *frame = g_malloc (frame_size * sizeof (short));
-
-  elan_save_frame (elandev, frame);
-  unsigned int sum = 0;
-
-  for (int i = 0; i < frame_size; i++)
-    {
-      if (elandev->background[i] > frame[i])
-        frame[i] = 0;
-      else
-        frame[i] -= elandev->background[i];
-      sum += frame[i];
-    }
+  unsigned short *frame =
+    elandev->frame_arena + (unsigned int) elandev->num_frames * frame_size;
+  unsigned int sum = elan_save_frame (elandev, frame, elandev->background);
 
   if (sum == 0)
     {
       fp_dbg
         ("frame darker than background; finger present during calibration?");
-      g_free (frame);
+      /* the arena slot is simply reused for the next frame */
       return -1;
     }
 
-  elandev->frames = g_slist_prepend (elandev->frames, frame);
   elandev->num_frames += 1;
   return 0;
 }
@@ -242,8 +323,45 @@ elan_process_frame_linear (unsigned short *raw_frame,
   G_DEBUG_HERE ();
 
   unsigned short min = 0xffff, max = 0;
+  unsigned int i = 0;
+  guint32 scale;
 
-  for (int i = 0; i < frame_size; i++)
+#ifdef ELAN_HAVE_SIMD
+  if (frame_size >= 8)
+    {
+      unsigned short lanes_min[8], lanes_max[8];
+
+#if defined(__SSE2__)
+      __m128i vmin = _mm_set1_epi16 (0x7fff);
+      __m128i vmax = _mm_set1_epi16 ((short) 0x8000);
+      const __m128i bias = _mm_set1_epi16 ((short) 0x8000);
+
+      for (; i + 8 <= frame_size; i += 8)
+        elan_minmax_run8 (raw_frame + i, &vmin, &vmax);
+
+      _mm_storeu_si128 ((__m128i *) lanes_min, _mm_xor_si128 (vmin, bias));
+      _mm_storeu_si128 ((__m128i *) lanes_max, _mm_xor_si128 (vmax, bias));
+#elif defined(__ARM_NEON)
+      uint16x8_t vmin = vdupq_n_u16 (0xffff);
+      uint16x8_t vmax = vdupq_n_u16 (0);
+
+      for (; i + 8 <= frame_size; i += 8)
+        elan_minmax_run8 (raw_frame + i, &vmin, &vmax);
+
+      vst1q_u16 (lanes_min, vmin);
+      vst1q_u16 (lanes_max, vmax);
+#endif
+
+      for (int l = 0; l < 8; l++)
+        {
+          if (lanes_min[l] < min)
+            min = lanes_min[l];
+          if (lanes_max[l] > max)
+            max = lanes_max[l];
+        }
+    }
+#endif
+  for (; i < frame_size; i++)
     {
       if (raw_frame[i] < min)
         min = raw_frame[i];
@@ -253,14 +371,40 @@ elan_process_frame_linear (unsigned short *raw_frame,
 
   g_assert (max != min);
 
-  unsigned short px;
+  /* 255 / (max - min) as a Q16 fixed-point factor, so normalizing a
+   * pixel is a multiply and shift instead of a divide. */
+  scale = (0xffu << 16) / (max - min);
 
-  for (int i = 0; i < frame_size; i++)
-    {
-      px = raw_frame[i];
-      px = (px - min) * 0xff / (max - min);
-      frame->data[i] = (unsigned char) px;
-    }
+  i = 0;
+#ifdef ELAN_HAVE_SIMD
+#if defined(__SSE2__)
+  {
+    __m128i vsub = _mm_set1_epi16 ((short) min);
+    __m128i vscale = _mm_set1_epi32 (scale);
+
+    for (; i + 8 <= frame_size; i += 8)
+      {
+        __m128i v = _mm_loadu_si128 ((const __m128i *) (raw_frame + i));
+        __m128i px16 = elan_mulshift_run8 (v, vsub, vscale);
+
+        _mm_storel_epi64 ((__m128i *) (frame->data + i),
+                          _mm_packus_epi16 (px16, px16));
+      }
+  }
+#elif defined(__ARM_NEON)
+  {
+    uint16x8_t vsub = vdupq_n_u16 (min);
+    uint32x4_t vscale = vdupq_n_u32 (scale);
+
+    for (; i + 8 <= frame_size; i += 8)
+      vst1_u8 (frame->data + i,
+               vmovn_u16 (elan_mulshift_run8 (vld1q_u16 (raw_frame + i),
+                                              vsub, vscale)));
+  }
+#endif
+#endif
+  for (; i < frame_size; i++)
+    frame->data[i] = ((guint32) (raw_frame[i] - min) * scale) >> 16;
 
   *frames = g_slist_prepend (*frames, frame);
 }
@@ -278,6 +422,8 @@ elan_process_frame_thirds (unsigned short *raw_frame,
 
   unsigned short lvl0, lvl1, lvl2, lvl3;
   unsigned short *sorted = g_malloc (frame_size * sizeof (short));
+  guint32 s01, s12, s23;
+  unsigned int i = 0;
 
   memcpy (sorted, raw_frame, frame_size * sizeof (short));
   qsort (sorted, frame_size, sizeof (short), cmp_short);
@@ -287,17 +433,85 @@ elan_process_frame_thirds (unsigned short *raw_frame,
   lvl3 = sorted[frame_size - 1];
   g_free (sorted);
 
-  unsigned short px;
-
-  for (int i = 0; i < frame_size; i++)
+  /* Per-segment Q16 fixed-point factors; a segment with an empty level
+   * range can never be selected, its factor is arbitrary. */
+  s01 = lvl1 > lvl0 ? (99u << 16) / (lvl1 - lvl0) : 0;
+  s12 = lvl2 > lvl1 ? (56u << 16) / (lvl2 - lvl1) : 0;
+  s23 = lvl3 > lvl2 ? (100u << 16) / (lvl3 - lvl2) : 0;
+
+#ifdef ELAN_HAVE_SIMD
+#if defined(__SSE2__)
+  {
+    const __m128i bias = _mm_set1_epi16 ((short) 0x8000);
+    __m128i vlvl0 = _mm_set1_epi16 ((short) lvl0);
+    __m128i vlvl1 = _mm_set1_epi16 ((short) lvl1);
+    __m128i vlvl2 = _mm_set1_epi16 ((short) lvl2);
+    __m128i vlvl1b = _mm_set1_epi16 ((short) (lvl1 ^ 0x8000));
+    __m128i vlvl2b = _mm_set1_epi16 ((short) (lvl2 ^ 0x8000));
+    __m128i vs01 = _mm_set1_epi32 (s01);
+    __m128i vs12 = _mm_set1_epi32 (s12);
+    __m128i vs23 = _mm_set1_epi32 (s23);
+
+    for (; i + 8 <= frame_size; i += 8)
+      {
+        __m128i v = _mm_loadu_si128 ((const __m128i *) (raw_frame + i));
+        __m128i vb = _mm_xor_si128 (v, bias);
+        __m128i m1 = _mm_cmplt_epi16 (vb, vlvl1b);
+        __m128i m2 = _mm_cmplt_epi16 (vb, vlvl2b);
+        /* Lanes outside a segment compute garbage here, the masks
+         * discard them below. */
+        __m128i r0 = elan_mulshift_run8 (v, vlvl0, vs01);
+        __m128i r1 = _mm_add_epi16 (_mm_set1_epi16 (99),
+                                    elan_mulshift_run8 (v, vlvl1, vs12));
+        __m128i r2 = _mm_add_epi16 (_mm_set1_epi16 (155),
+                                    elan_mulshift_run8 (v, vlvl2, vs23));
+        __m128i r = _mm_or_si128 (_mm_and_si128 (m2, r1),
+                                  _mm_andnot_si128 (m2, r2));
+
+        r = _mm_or_si128 (_mm_and_si128 (m1, r0),
+                          _mm_andnot_si128 (m1, r));
+        _mm_storel_epi64 ((__m128i *) (frame->data + i),
+                          _mm_packus_epi16 (r, r));
+      }
+  }
+#elif defined(__ARM_NEON)
+  {
+    uint16x8_t vlvl0 = vdupq_n_u16 (lvl0);
+    uint16x8_t vlvl1 = vdupq_n_u16 (lvl1);
+    uint16x8_t vlvl2 = vdupq_n_u16 (lvl2);
+    uint32x4_t vs01 = vdupq_n_u32 (s01);
+    uint32x4_t vs12 = vdupq_n_u32 (s12);
+    uint32x4_t vs23 = vdupq_n_u32 (s23);
+
+    for (; i + 8 <= frame_size; i += 8)
+      {
+        uint16x8_t v = vld1q_u16 (raw_frame + i);
+        uint16x8_t m1 = vcltq_u16 (v, vlvl1);
+        uint16x8_t m2 = vcltq_u16 (v, vlvl2);
+        /* Lanes outside a segment compute garbage here, the masks
+         * discard them below. */
+        uint16x8_t r0 = elan_mulshift_run8 (v, vlvl0, vs01);
+        uint16x8_t r1 = vaddq_u16 (vdupq_n_u16 (99),
+                                   elan_mulshift_run8 (v, vlvl1, vs12));
+        uint16x8_t r2 = vaddq_u16 (vdupq_n_u16 (155),
+                                   elan_mulshift_run8 (v, vlvl2, vs23));
+
+        vst1_u8 (frame->data + i,
+                 vmovn_u16 (vbslq_u16 (m1, r0, vbslq_u16 (m2, r1, r2))));
+      }
+  }
+#endif
+#endif
+  for (; i < frame_size; i++)
     {
-      px = raw_frame[i];
-      if (lvl0 <= px && px < lvl1)
-        px = (px - lvl0) * 99 / (lvl1 - lvl0);
-      else if (lvl1 <= px && px < lvl2)
-        px = 99 + ((px - lvl1) * 56 / (lvl2 - lvl1));
-      else                      // (lvl2 <= px && px <= lvl3)
-        px = 155 + ((px - lvl2) * 100 / (lvl3 - lvl2));
+      unsigned short px = raw_frame[i];
+
+      if (px < lvl1)
+        px = ((guint32) (px - lvl0) * s01) >> 16;
+      else if (px < lvl2)
+        px = 99 + (((guint32) (px - lvl1) * s12) >> 16);
+      else                      /* (lvl2 <= px && px <= lvl3) */
+        px = 155 + (((guint32) (px - lvl2) * s23) >> 16);
       frame->data[i] = (unsigned char) px;
     }
 
@@ -308,18 +522,20 @@ static void
 elan_submit_image (FpImageDevice *dev)
 {
   FpiDeviceElan *self = FPI_DEVICE_ELAN (dev);
-  GSList *raw_frames;
+  unsigned int frame_size = self->frame_width * self->frame_height;
   GSList *frames = NULL;
   FpImage *img;
 
   G_DEBUG_HERE ();
 
-  raw_frames = g_slist_nth (self->frames, ELAN_SKIP_LAST_FRAMES);
-
   assembling_ctx.frame_width = self->frame_width;
   assembling_ctx.frame_height = self->frame_height;
   assembling_ctx.image_width = self->frame_width * 3 / 2;
-  g_slist_foreach (raw_frames, (GFunc) self->process_frame, &frames);
+  /* skip the last frames (see ELAN_SKIP_LAST_FRAMES); prepending while
+   * walking backwards leaves the list in capture order */
+  for (int i = self->num_frames - ELAN_SKIP_LAST_FRAMES - 1; i >= 0; i--)
+    self->process_frame (self->frame_arena + (unsigned int) i * frame_size,
+                         &frames);
   fpi_do_movement_estimation (&assembling_ctx, frames);
   img = fpi_assemble_frames (&assembling_ctx, frames);
   img->flags |= FPI_IMAGE_PARTIAL;
@@ -863,6 +1079,12 @@ activate_run_state (FpiSsm *ssm, FpDevice *dev)
         self->frame_height = ELAN_MAX_FRAME_HEIGHT;
       fp_dbg ("sensor dimensions, WxH: %dx%d", self->frame_width,
               self->raw_frame_height);
+      /* capture-session arena: frames are saved in place here, so no
+       * allocation happens while the finger is on the sensor */
+      g_free (self->frame_arena);
+      self->frame_arena =
+        g_malloc (ELAN_MAX_FRAMES * self->frame_width *
+                  self->frame_height * sizeof (short));
       fpi_ssm_next_state (ssm);
       break;
 
@@ -918,6 +1140,7 @@ dev_init (FpImageDevice *dev)
   /* common params */
   self->dev_type = fpi_device_get_driver_data (FP_DEVICE (dev));
   self->background = NULL;
+  self->frame_arena = NULL;
   self->process_frame = elan_process_frame_thirds;
 
   switch (self->dev_type)
@@ -940,6 +1163,7 @@ dev_deinit (FpImageDevice *dev)
 
   elan_dev_reset_state (self);
   g_free (self->background);
+  g_clear_pointer (&self->frame_arena, g_free);
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (dev)),
                                   0, 0, &error);
   fpi_image_device_close_complete (dev, error);
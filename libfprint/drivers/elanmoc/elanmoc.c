@@ -40,6 +40,9 @@ typedef void (*SynCmdMsgCallback) (FpiDeviceElanmoc *self,
 typedef struct
 {
   SynCmdMsgCallback callback;
+  /* Second command of a pipelined pair, see elanmoc_get_cmd_pipelined() */
+  SynCmdMsgCallback callback_next;
+  gboolean          first_done;
 } CommandData;
 
 static uint8_t *
@@ -88,6 +91,14 @@ elanmoc_cmd_ack_cb (FpiDeviceElanmoc *self,
     }
 }
 
+typedef enum {
+  FP_CMD_SEND = 0,
+  FP_CMD_SEND_NEXT,
+  FP_CMD_GET,
+  FP_CMD_GET_NEXT,
+  FP_CMD_NUM_STATES,
+} FpCmdState;
+
 static void
 fp_cmd_receive_cb (FpiUsbTransfer *transfer,
                    FpDevice       *device,
@@ -118,17 +129,27 @@ fp_cmd_receive_cb (FpiUsbTransfer *transfer,
       return;
     }
 
+  if (ssm_state == FP_CMD_GET_NEXT)
+    {
+      if (data->callback_next)
+        data->callback_next (self, transfer->buffer, transfer->actual_length, NULL);
+
+      fpi_ssm_mark_completed (transfer->ssm);
+      return;
+    }
+
   if (data->callback)
     data->callback (self, transfer->buffer, transfer->actual_length, NULL);
 
-  fpi_ssm_mark_completed (transfer->ssm);
-}
+  data->first_done = TRUE;
 
-typedef enum {
-  FP_CMD_SEND = 0,
-  FP_CMD_GET,
-  FP_CMD_NUM_STATES,
-} FpCmdState;
+  if (data->callback_next == NULL)
+    fpi_ssm_mark_completed (transfer->ssm);
+  else if (self->cmd_pipelined)
+    fpi_ssm_next_state (transfer->ssm);
+  else
+    fpi_ssm_jump_to_state (transfer->ssm, FP_CMD_SEND_NEXT);
+}
 
 static void
 fp_cmd_run_state (FpiSsm   *ssm,
@@ -155,18 +176,61 @@ fp_cmd_run_state (FpiSsm   *ssm,
         }
       break;
 
+    case FP_CMD_SEND_NEXT:
+      {
+        CommandData *data = fpi_ssm_get_data (ssm);
+
+        /* Without pipelining the second command goes out only once the
+         * first response has been read; we come back here from
+         * fp_cmd_receive_cb() in that case. */
+        if (self->cmd_transfer_next == NULL ||
+            (!self->cmd_pipelined && !data->first_done))
+          {
+            fpi_ssm_jump_to_state (ssm, FP_CMD_GET);
+            return;
+          }
+        self->cmd_transfer_next->ssm = ssm;
+        fpi_usb_transfer_submit (g_steal_pointer (&self->cmd_transfer_next),
+                                 ELAN_MOC_CMD_TIMEOUT,
+                                 NULL,
+                                 fpi_ssm_usb_transfer_cb,
+                                 NULL);
+      }
+      break;
+
     case FP_CMD_GET:
-      if (self->cmd_len_in == 0)
-        {
-          CommandData *data = fpi_ssm_get_data (ssm);
-          if (data->callback)
-            data->callback (self, NULL, 0, 0);
-          fpi_ssm_mark_completed (ssm);
-          return;
-        }
+      {
+        CommandData *data = fpi_ssm_get_data (ssm);
+
+        if (data->first_done)
+          {
+            /* Sequential pair: the first response is already in, read
+             * the second one. */
+            fpi_ssm_jump_to_state (ssm, FP_CMD_GET_NEXT);
+            return;
+          }
+        if (self->cmd_len_in == 0)
+          {
+            if (data->callback)
+              data->callback (self, NULL, 0, 0);
+            fpi_ssm_mark_completed (ssm);
+            return;
+          }
+        transfer = fpi_usb_transfer_new (dev);
+        transfer->ssm = ssm;
+        fpi_usb_transfer_fill_bulk (transfer, self->cmd_cancelable ? ELAN_EP_MOC_CMD_IN : ELAN_EP_CMD_IN, self->cmd_len_in);
+        fpi_usb_transfer_submit (transfer,
+                                 self->cmd_cancelable ? 0 : ELAN_MOC_CMD_TIMEOUT,
+                                 self->cmd_cancelable ? fpi_device_get_cancellable (dev) : NULL,
+                                 fp_cmd_receive_cb,
+                                 data);
+      }
+      break;
+
+    case FP_CMD_GET_NEXT:
       transfer = fpi_usb_transfer_new (dev);
       transfer->ssm = ssm;
-      fpi_usb_transfer_fill_bulk (transfer, self->cmd_cancelable ? ELAN_EP_MOC_CMD_IN : ELAN_EP_CMD_IN, self->cmd_len_in);
+      fpi_usb_transfer_fill_bulk (transfer, self->cmd_cancelable ? ELAN_EP_MOC_CMD_IN : ELAN_EP_CMD_IN, self->cmd_len_in_next);
       fpi_usb_transfer_submit (transfer,
                                self->cmd_cancelable ? 0 : ELAN_MOC_CMD_TIMEOUT,
                                self->cmd_cancelable ? fpi_device_get_cancellable (dev) : NULL,
@@ -185,11 +249,17 @@ fp_cmd_ssm_done (FpiSsm *ssm, FpDevice *dev, GError *error)
   CommandData *data = fpi_ssm_get_data (ssm);
 
   self->cmd_ssm = NULL;
+  g_clear_pointer (&self->cmd_transfer_next, fpi_usb_transfer_unref);
 
   if (error)
     {
-      if (data->callback)
-        data->callback (self, NULL, 0, error);
+      SynCmdMsgCallback callback = data->callback;
+
+      if (data->first_done && data->callback_next)
+        callback = data->callback_next;
+
+      if (callback)
+        callback (self, NULL, 0, error);
       else
         g_error_free (error);
     }
@@ -217,8 +287,60 @@ elanmoc_get_cmd (FpDevice *device, guint8 *buffer_out,
   data->callback = callback;
 
   self->cmd_transfer = g_steal_pointer (&transfer);
+  self->cmd_transfer_next = NULL;
   self->cmd_len_in = length_in;
+  self->cmd_len_in_next = 0;
   self->cmd_cancelable = cancelable;
+  self->cmd_pipelined = FALSE;
+
+  self->cmd_ssm = fpi_ssm_new (FP_DEVICE (self),
+                               fp_cmd_run_state,
+                               FP_CMD_NUM_STATES);
+
+  fpi_ssm_set_data (self->cmd_ssm, data, (GDestroyNotify) fp_cmd_ssm_done_data_free);
+
+  fpi_ssm_start (self->cmd_ssm, fp_cmd_ssm_done);
+}
+
+/* Issue two commands as one exchange. When pipelining is possible both
+ * commands are written back to back and the responses read afterwards,
+ * saving one host round-trip; the umockdev recordings replay transfers
+ * strictly in order, so under FP_DEVICE_EMULATION the pair degrades to
+ * the usual send/receive sequence. @callback runs on the first response
+ * before @callback_next, so it may set up state the second callback
+ * depends on, but must not issue commands of its own. */
+static void
+elanmoc_get_cmd_pipelined (FpDevice *device,
+                           guint8 *buffer_out, gsize length_out,
+                           gsize length_in, SynCmdMsgCallback callback,
+                           guint8 *buffer_out_next, gsize length_out_next,
+                           gsize length_in_next, SynCmdMsgCallback callback_next)
+{
+  FpiDeviceElanmoc *self = FPI_DEVICE_ELANMOC (device);
+
+  g_autoptr(FpiUsbTransfer) transfer = NULL;
+  g_autoptr(FpiUsbTransfer) transfer_next = NULL;
+  CommandData *data = g_new0 (CommandData, 1);
+
+  transfer = fpi_usb_transfer_new (device);
+  transfer->short_is_error = TRUE;
+  fpi_usb_transfer_fill_bulk_full (transfer, ELAN_EP_CMD_OUT, buffer_out,
+                                   length_out, g_free);
+
+  transfer_next = fpi_usb_transfer_new (device);
+  transfer_next->short_is_error = TRUE;
+  fpi_usb_transfer_fill_bulk_full (transfer_next, ELAN_EP_CMD_OUT, buffer_out_next,
+                                   length_out_next, g_free);
+
+  data->callback = callback;
+  data->callback_next = callback_next;
+
+  self->cmd_transfer = g_steal_pointer (&transfer);
+  self->cmd_transfer_next = g_steal_pointer (&transfer_next);
+  self->cmd_len_in = length_in;
+  self->cmd_len_in_next = length_in_next;
+  self->cmd_cancelable = FALSE;
+  self->cmd_pipelined = g_getenv ("FP_DEVICE_EMULATION") == NULL;
 
   self->cmd_ssm = fpi_ssm_new (FP_DEVICE (self),
                                fp_cmd_run_state,
@@ -317,6 +439,14 @@ elanmoc_reenroll_cb (FpiDeviceElanmoc *self,
                      gsize             length_in,
                      GError           *error)
 {
+  /* Second half of the pipelined setup pair; nothing to report if the
+   * enrolled-count callback already failed the task. */
+  if (self->task_ssm == NULL)
+    {
+      g_clear_error (&error);
+      return;
+    }
+
   if (error)
     {
       fpi_ssm_mark_failed (self->task_ssm, error);
@@ -367,22 +497,32 @@ elanmoc_enroll_cb (FpiDeviceElanmoc *self,
     }
   else
     {
-      if (buffer_in[1] == ELAN_MSG_OK)
+      gboolean msg_ok = buffer_in[1] == ELAN_MSG_OK;
+
+      if (msg_ok)
+        self->num_frames += 1;
+
+      /* Advance the state machine before reporting progress: the next
+       * wait-finger (or commit) command is then already in flight while
+       * the progress report winds its way to the application, so the
+       * sensor accepts the next touch without waiting for it. */
+      if (self->num_frames == ELAN_MOC_ENROLL_TIMES && msg_ok)
         {
-          self->num_frames += 1;
+          fpi_ssm_next_state (self->task_ssm);
           enroll_status_report (self, ENROLL_RSP_ENROLL_REPORT, self->num_frames, NULL);
         }
+      else if (self->num_frames < ELAN_MOC_ENROLL_TIMES)
+        {
+          fpi_ssm_jump_to_state (self->task_ssm, MOC_ENROLL_WAIT_FINGER);
+          enroll_status_report (self,
+                                msg_ok ? ENROLL_RSP_ENROLL_REPORT : ENROLL_RSP_RETRY,
+                                self->num_frames, NULL);
+        }
       else
         {
           enroll_status_report (self, ENROLL_RSP_RETRY, self->num_frames, NULL);
+          fpi_ssm_mark_failed (self->task_ssm, error);
         }
-
-      if (self->num_frames == ELAN_MOC_ENROLL_TIMES && buffer_in[1] == ELAN_MSG_OK)
-        fpi_ssm_next_state (self->task_ssm);
-      else if (self->num_frames < ELAN_MOC_ENROLL_TIMES)
-        fpi_ssm_jump_to_state (self->task_ssm, MOC_ENROLL_WAIT_FINGER);
-      else
-        fpi_ssm_mark_failed (self->task_ssm, error);
     }
 }
 
@@ -423,20 +563,28 @@ elan_enroll_run_state (FpiSsm *ssm, FpDevice *dev)
 {
   FpiDeviceElanmoc *self = FPI_DEVICE_ELANMOC (dev);
   guint8 *cmd_buf = NULL;
+  guint8 *reenroll_buf = NULL;
   guint8 *data = NULL;
 
   switch (fpi_ssm_get_cur_state (ssm))
     {
     case MOC_ENROLL_GET_ENROLLED_NUM:
+      /* Batch the enroll setup pair: the re-enroll check does not depend
+       * on the enrolled count on the wire, so both commands go out
+       * together and the first touch can be accepted sooner. */
+      data = fpi_ssm_get_data (ssm);
       cmd_buf = elanmoc_compose_cmd (&enrolled_number_cmd);
-      elanmoc_get_cmd (dev, cmd_buf, enrolled_number_cmd.cmd_len, enrolled_number_cmd.resp_len, 0, elanmoc_get_enrolled_cb);
+      reenroll_buf = elanmoc_compose_cmd (&elanmoc_check_reenroll_cmd);
+      memcpy (reenroll_buf + 3, data, ELAN_USERDATE_SIZE);
+      elanmoc_get_cmd_pipelined (dev,
+                                 cmd_buf, enrolled_number_cmd.cmd_len,
+                                 enrolled_number_cmd.resp_len, elanmoc_get_enrolled_cb,
+                                 reenroll_buf, elanmoc_check_reenroll_cmd.cmd_len,
+                                 elanmoc_check_reenroll_cmd.resp_len, elanmoc_reenroll_cb);
       break;
 
     case MOC_ENROLL_REENROLL_CHECK:
-      data = fpi_ssm_get_data (ssm);
-      cmd_buf = elanmoc_compose_cmd (&elanmoc_check_reenroll_cmd);
-      memcpy (cmd_buf + 3, data, ELAN_USERDATE_SIZE);
-      elanmoc_get_cmd (dev, cmd_buf, elanmoc_check_reenroll_cmd.cmd_len, elanmoc_check_reenroll_cmd.resp_len, 0, elanmoc_reenroll_cb);
+      /* Waiting for the second response of the pair issued above. */
       break;
 
     case MOC_ENROLL_WAIT_FINGER:
@@ -462,7 +610,6 @@ task_ssm_done (FpiSsm *ssm, FpDevice *dev, GError *error)
   FpiDeviceElanmoc *self = FPI_DEVICE_ELANMOC (dev);
 
   self->task_ssm = NULL;
-  g_clear_pointer (&self->list_result, g_ptr_array_unref);
 
   if (error)
     fpi_device_action_error (dev, error);
@@ -557,6 +704,8 @@ elanmoc_get_userid_cb (FpiDeviceElanmoc *self,
   /* Skip 0xfe messages */
   if (buffer_in[1] != 0xfe)
     {
+      GPtrArray *chunk;
+
       print = create_print_from_response (self, buffer_in, length_in, &error);
 
       if (!print)
@@ -565,7 +714,11 @@ elanmoc_get_userid_cb (FpiDeviceElanmoc *self,
           return;
         }
 
-      g_ptr_array_add (self->list_result, g_object_ref_sink (print));
+      /* Stream each print as its response arrives instead of holding
+       * the whole list until the enumeration finishes. */
+      chunk = g_ptr_array_new_with_free_func (g_object_unref);
+      g_ptr_array_add (chunk, g_object_ref_sink (print));
+      fpi_device_list_report (FP_DEVICE (self), chunk);
     }
 
   if(self->list_index <= ELAN_MAX_ENROLL_NUM)
@@ -574,7 +727,7 @@ elanmoc_get_userid_cb (FpiDeviceElanmoc *self,
     }
   else
     {
-      fpi_device_list_complete (FP_DEVICE (self), g_steal_pointer (&self->list_result), NULL);
+      fpi_device_list_complete (FP_DEVICE (self), NULL, NULL);
       fpi_ssm_next_state (self->task_ssm);
     }
 }
@@ -606,7 +759,6 @@ elanmoc_list (FpDevice *device)
 {
   FpiDeviceElanmoc *self = FPI_DEVICE_ELANMOC (device);
 
-  self->list_result = g_ptr_array_new_with_free_func (g_object_unref);
   self->task_ssm = fpi_ssm_new (FP_DEVICE (self),
                                 elan_list_run_state,
                                 MOC_LIST_NUM_STATES);
@@ -181,8 +181,11 @@ struct _FpiDeviceElanmoc
   FpiSsm         *task_ssm;
   FpiSsm         *cmd_ssm;
   FpiUsbTransfer *cmd_transfer;
+  FpiUsbTransfer *cmd_transfer_next;
   gboolean        cmd_cancelable;
+  gboolean        cmd_pipelined;
   gsize           cmd_len_in;
+  gsize           cmd_len_in_next;
   unsigned short  fw_ver;
   unsigned char   x_trace;
   unsigned char   y_trace;
@@ -191,5 +194,4 @@ struct _FpiDeviceElanmoc
   int             cancel_result;
   int             cmd_retry_cnt;
   int             list_index;
-  GPtrArray      *list_result;
 };
@@ -83,6 +83,13 @@ struct _FpiDeviceElanSpi
 
   gboolean deactivating, capturing;
 
+  /* burst reads for the line-by-line capture path; sized from the
+   * negotiated spidev block size once the sensor dimensions are known */
+  guint8   line_burst;
+  guint8   burst_submitted;
+  guint8  *burst_buffer;
+  guint8  *burst_status;
+
   /* active SPI status info */
   int spi_fd;
 };
@@ -421,21 +428,37 @@ elanspi_capture_old_line_handler (FpiSpiTransfer *transfer, FpDevice *dev, gpoin
       return;
     }
 
-  /* copy buffer from line into last_image */
-  for (int col = 0; col < self->sensor_width; col += 1)
+  /* deinterleave the valid lines of the burst into last_image: the
+   * first line was gated on the ready bit, later ones only count if
+   * the status fetched just before them showed the next line ready */
+  for (int line = 0; line < self->burst_submitted; line += 1)
     {
-      guint8 low =  transfer->buffer_rd[col * 2 + 1];
-      guint8 high = transfer->buffer_rd[col * 2];
+      const guint8 *row = self->burst_buffer + line * self->sensor_width * 2;
+
+      for (int col = 0; col < self->sensor_width; col += 1)
+        {
+          guint8 low =  row[col * 2 + 1];
+          guint8 high = row[col * 2];
 
-      self->last_image[self->sensor_width * self->old_data.line_ptr + col] = low + high * 0x100;
+          self->last_image[self->sensor_width * self->old_data.line_ptr + col] = low + high * 0x100;
+        }
+
+      self->old_data.line_ptr += 1;
+      self->sensor_status = self->burst_status[line];
+
+      if (self->old_data.line_ptr >= self->sensor_height)
+        break;
+      /* the rest of the burst was read before the sensor was ready;
+       * discard it and fall back to polling */
+      if (!(self->sensor_status & 4))
+        break;
     }
 
-  /* increment line ptr */
-  self->old_data.line_ptr += 1;
-  /* if there is still data, continue from check lineready */
+  /* if there is still data, continue from recv line; the status for the
+   * next line was already fetched in the same ioctl */
   if (self->old_data.line_ptr < self->sensor_height)
     {
-      fpi_ssm_jump_to_state (transfer->ssm, ELANSPI_CAPTOLD_CHECK_LINEREADY);
+      fpi_ssm_jump_to_state (transfer->ssm, ELANSPI_CAPTOLD_RECV_LINE);
     }
   else
     {
@@ -462,6 +485,7 @@ elanspi_capture_old_handler (FpiSsm *ssm, FpDevice *dev)
 {
   FpiDeviceElanSpi *self = FPI_DEVICE_ELANSPI (dev);
   FpiSpiTransfer *xfer = NULL;
+  int burst;
 
   switch (fpi_ssm_get_cur_state (ssm))
     {
@@ -495,12 +519,28 @@ elanspi_capture_old_handler (FpiSsm *ssm, FpDevice *dev)
           fpi_ssm_jump_to_state (ssm, ELANSPI_CAPTOLD_CHECK_LINEREADY);
           return;
         }
-      /* otherwise, perform a read */
-      xfer = fpi_spi_transfer_new (dev, self->spi_fd);
+      /* otherwise, read a burst of lines, each followed by the status
+       * check for the one after it, all batched into as few ioctls as
+       * the spidev limit allows; lines past the first are speculative
+       * and are only consumed if their preceding status was ready */
+      burst = MIN (self->line_burst, self->sensor_height - self->old_data.line_ptr);
+      for (int i = 0; i < burst; i += 1)
+        {
+          FpiSpiTransfer *line_xfer = fpi_spi_transfer_new (dev, self->spi_fd);
+
+          fpi_spi_transfer_write (line_xfer, 2);
+          line_xfer->buffer_wr[0] = 0x10;                   /* receieve line */
+          fpi_spi_transfer_read_full (line_xfer,
+                                      self->burst_buffer + i * self->sensor_width * 2,
+                                      self->sensor_width * 2, NULL);
+          if (!xfer)
+            xfer = line_xfer;
+          else
+            fpi_spi_transfer_append (xfer, line_xfer);
+          fpi_spi_transfer_append (xfer, elanspi_read_status (self, &self->burst_status[i]));
+        }
+      self->burst_submitted = burst;
       xfer->ssm = ssm;
-      fpi_spi_transfer_write (xfer, 2);
-      xfer->buffer_wr[0] = 0x10;                   /* receieve line */
-      fpi_spi_transfer_read (xfer, self->sensor_width * 2);
       fpi_spi_transfer_submit (xfer, NULL, elanspi_capture_old_line_handler, NULL);
       return;
     }
@@ -997,6 +1037,18 @@ do_sw_reset:
       self->last_image = g_malloc0 (self->sensor_width * self->sensor_height * 2);
       self->bg_image = g_malloc0 (self->sensor_width * self->sensor_height * 2);
       self->prev_frame_image = g_malloc0 (self->sensor_width * self->sensor_height * 2);
+      /* size line bursts to the spidev limit; each burst entry is a
+       * 2-byte receive command, a line of data and a 3-byte status read.
+       * Kept at one line under emulation so recorded transfers match. */
+      self->line_burst = MIN (self->sensor_height,
+                              MAX (1, fpi_spi_transfer_block_size () /
+                                   (self->sensor_width * 2 + 5)));
+      if (g_strcmp0 (g_getenv ("FP_DEVICE_EMULATION"), "1") == 0)
+        self->line_burst = 1;
+      g_clear_pointer (&self->burst_buffer, g_free);
+      g_clear_pointer (&self->burst_status, g_free);
+      self->burst_buffer = g_malloc0 ((gsize) self->line_burst * self->sensor_width * 2);
+      self->burst_status = g_malloc0 (self->line_burst);
       /* reset again */
       goto do_sw_reset;
 
@@ -1341,6 +1393,7 @@ elanspi_fp_frame_stitch_and_submit (FpiDeviceElanSpi *self)
     .frame_height = self->frame_height,
 
     .get_pixel = elanspi_fp_assembling_get_pixel,
+    .packed_8bpp = 1,
   };
 
   /* stitch image */
@@ -1683,6 +1736,8 @@ fpi_device_elanspi_finalize (GObject *this)
   g_clear_pointer (&self->bg_image, g_free);
   g_clear_pointer (&self->last_image, g_free);
   g_clear_pointer (&self->prev_frame_image, g_free);
+  g_clear_pointer (&self->burst_buffer, g_free);
+  g_clear_pointer (&self->burst_status, g_free);
   g_slist_free_full (g_steal_pointer (&self->fp_frame_list), g_free);
 
   G_OBJECT_CLASS (fpi_device_elanspi_parent_class)->finalize (this);
@@ -216,6 +216,9 @@ struct _FpiDeviceEtes603
   guint8       vrt;
   guint8       vrb;
 
+  /* Whether the cached calibration passed the probe frame check. */
+  gboolean     tunecheck_passed;
+
   unsigned int is_active;
 };
 G_DECLARE_FINAL_TYPE (FpiDeviceEtes603, fpi_device_etes603, FPI, DEVICE_ETES603,
@@ -649,6 +652,22 @@ enum {
   TUNEVRB_NUM_STATES
 };
 
+enum {
+  TUNECHECK_SET_REGS_REQ,
+  TUNECHECK_SET_REGS_ANS,
+  TUNECHECK_SET_DCOFFSET_REQ,
+  TUNECHECK_SET_DCOFFSET_ANS,
+  TUNECHECK_FRAME_REQ,
+  TUNECHECK_FRAME_ANS,
+  TUNECHECK_FINAL_SET_DCOFFSET_REQ,
+  TUNECHECK_FINAL_SET_DCOFFSET_ANS,
+  TUNECHECK_FINAL_SET_GAINVRTVRB_REQ,
+  TUNECHECK_FINAL_SET_GAINVRTVRB_ANS,
+  TUNECHECK_FINAL_SET_MODE_SLEEP_REQ,
+  TUNECHECK_FINAL_SET_MODE_SLEEP_ANS,
+  TUNECHECK_NUM_STATES
+};
+
 enum {
   FGR_FPA_INIT_SET_MODE_SLEEP_REQ,
   FGR_FPA_INIT_SET_MODE_SLEEP_ANS,
@@ -1262,6 +1281,12 @@ m_tunevrb_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
   if (!error)
     {
       fp_dbg ("Tuning is done. Starting finger detection.");
+      /* Remember the calibration so later opens of this device start
+       * from it instead of re-running the full tuning loop. */
+      fpi_device_set_driver_snapshot (dev,
+                                      g_variant_new ("(yyyy)", self->gain,
+                                                     self->dcoffset,
+                                                     self->vrt, self->vrb));
       m_start_fingerdetect (idev);
     }
 
@@ -1546,6 +1571,153 @@ m_init_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
     }
 }
 
+/*
+ * Check that the cached calibration still produces usable frames by
+ * grabbing a single probe frame with the tuning settings applied. The
+ * frame is judged with the same histogram bounds the VRT/VRB tuning
+ * loop accepts, so a pass means the full loop would have settled on
+ * these values anyway.
+ */
+static void
+m_tunecheck_state (FpiSsm *ssm, FpDevice *dev)
+{
+  FpiDeviceEtes603 *self = FPI_DEVICE_ETES603 (dev);
+  float hist[5];
+
+  if (self->is_active == FALSE)
+    {
+      fpi_ssm_mark_completed (ssm);
+      return;
+    }
+
+  switch (fpi_ssm_get_cur_state (ssm))
+    {
+    case TUNECHECK_SET_REGS_REQ:
+      fp_dbg ("Checking cached calibration (DCOFFSET=0x%02X,VRT=0x%02X,"
+              "VRB=0x%02X,GAIN=0x%02X)", self->dcoffset, self->vrt,
+              self->vrb, self->gain);
+      g_assert (self->dcoffset);
+      msg_set_regs (self, 8, REG_21, 0x23, REG_22, 0x21, REG_26, 0x11,
+                    REG_27, 0x00);
+      async_tx (dev, EP_OUT, async_tx_cb, ssm);
+      break;
+
+    case TUNECHECK_SET_REGS_ANS:
+      if (msg_check_ok (self))
+        goto err;
+      fpi_ssm_next_state (ssm);
+      break;
+
+    case TUNECHECK_SET_DCOFFSET_REQ:
+      /* Probe at DCoffset - 1, like the VRT/VRB tuning loop. */
+      msg_set_regs (self, 2, REG_DCOFFSET, self->dcoffset - 1);
+      async_tx (dev, EP_OUT, async_tx_cb, ssm);
+      break;
+
+    case TUNECHECK_SET_DCOFFSET_ANS:
+      if (msg_check_ok (self))
+        goto err;
+      fpi_ssm_next_state (ssm);
+      break;
+
+    case TUNECHECK_FRAME_REQ:
+      msg_get_frame (self, 0x01, self->gain, self->vrt, self->vrb);
+      async_tx (dev, EP_OUT, async_tx_cb, ssm);
+      break;
+
+    case TUNECHECK_FRAME_ANS:
+      process_hist ((guint8 *) self->ans, FRAME_SIZE, hist);
+      if (hist[0] + hist[1] > 0.95 || hist[4] > 0.95 ||
+          hist[4] + hist[3] > 0.4)
+        {
+          /* Calibration regressed, run the full tuning loop again. */
+          self->tunecheck_passed = FALSE;
+          fpi_ssm_mark_completed (ssm);
+          break;
+        }
+      self->tunecheck_passed = TRUE;
+      fpi_ssm_next_state (ssm);
+      break;
+
+    case TUNECHECK_FINAL_SET_DCOFFSET_REQ:
+      msg_set_regs (self, 2, REG_DCOFFSET, self->dcoffset);
+      async_tx (dev, EP_OUT, async_tx_cb, ssm);
+      break;
+
+    case TUNECHECK_FINAL_SET_DCOFFSET_ANS:
+      if (msg_check_ok (self))
+        goto err;
+      fpi_ssm_next_state (ssm);
+      break;
+
+    case TUNECHECK_FINAL_SET_GAINVRTVRB_REQ:
+      msg_set_regs (self, 6, REG_GAIN, self->gain, REG_VRT,
+                    self->vrt,
+                    REG_VRB, self->vrb);
+      async_tx (dev, EP_OUT, async_tx_cb, ssm);
+      break;
+
+    case TUNECHECK_FINAL_SET_GAINVRTVRB_ANS:
+      if (msg_check_ok (self))
+        goto err;
+      fpi_ssm_next_state (ssm);
+      break;
+
+    case TUNECHECK_FINAL_SET_MODE_SLEEP_REQ:
+      msg_set_mode_control (self, REG_MODE_SLEEP);
+      async_tx (dev, EP_OUT, async_tx_cb, ssm);
+      break;
+
+    case TUNECHECK_FINAL_SET_MODE_SLEEP_ANS:
+      if (msg_check_ok (self))
+        goto err;
+      fpi_ssm_mark_completed (ssm);
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+
+  return;
+err:
+  fpi_ssm_mark_failed (ssm, fpi_device_error_new (FP_DEVICE_ERROR_PROTO));
+}
+
+static void
+m_tunecheck_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
+{
+  FpiDeviceEtes603 *self = FPI_DEVICE_ETES603 (dev);
+  FpImageDevice *idev = FP_IMAGE_DEVICE (dev);
+
+  if (error)
+    {
+      fp_err ("Error while checking cached calibration");
+      reset_param (self);
+      fpi_image_device_session_error (idev, error);
+    }
+  else if (self->tunecheck_passed)
+    {
+      fp_dbg ("Cached calibration is still good. Starting finger detection.");
+      fpi_image_device_activate_complete (idev, NULL);
+      m_start_fingerdetect (idev);
+    }
+  else if (self->is_active)
+    {
+      FpiSsm *ssm_init;
+
+      fp_dbg ("Cached calibration regressed, retuning device...");
+      reset_param (self);
+      ssm_init = fpi_ssm_new (FP_DEVICE (idev), m_init_state,
+                              INIT_NUM_STATES);
+      fpi_ssm_start (ssm_init, m_init_complete);
+    }
+
+  if (!self->is_active)
+    m_exit_start (idev);
+
+}
+
 static void
 dev_activate (FpImageDevice *idev)
 {
@@ -1565,12 +1737,12 @@ dev_activate (FpImageDevice *idev)
     }
   else
     {
-      fp_dbg ("Using previous tuning (DCOFFSET=0x%02X,VRT=0x%02X,"
-              "VRB=0x%02X,GAIN=0x%02X).", self->dcoffset, self->vrt,
-              self->vrb, self->gain);
-      fpi_image_device_activate_complete (idev, NULL);
-      ssm = fpi_ssm_new (FP_DEVICE (idev), m_finger_state, FGR_NUM_STATES);
-      fpi_ssm_start (ssm, m_finger_complete);
+      /* Verify the cached tuning with a probe frame, re-tuning only if
+       * the image quality regressed since it was established. */
+      self->tunecheck_passed = FALSE;
+      ssm = fpi_ssm_new (FP_DEVICE (idev), m_tunecheck_state,
+                         TUNECHECK_NUM_STATES);
+      fpi_ssm_start (ssm, m_tunecheck_complete);
     }
 }
 
@@ -1593,6 +1765,7 @@ dev_open (FpImageDevice *idev)
 {
   GError *error = NULL;
   FpiDeviceEtes603 *self = FPI_DEVICE_ETES603 (idev);
+  GVariant *snapshot;
 
   if (!g_usb_device_claim_interface (fpi_device_get_usb_device (FP_DEVICE (idev)), 0, 0, &error))
     {
@@ -1604,6 +1777,19 @@ dev_open (FpImageDevice *idev)
   self->ans = g_malloc (FE_SIZE);
   self->fp = g_malloc (FE_SIZE * 4);
 
+  /* Start from the calibration a previous open settled on; the first
+   * activation probes it and falls back to full tuning on regression. */
+  snapshot = fpi_device_get_driver_snapshot (FP_DEVICE (idev));
+  if (self->dcoffset == 0 && snapshot &&
+      g_variant_is_of_type (snapshot, G_VARIANT_TYPE ("(yyyy)")))
+    {
+      g_variant_get (snapshot, "(yyyy)", &self->gain, &self->dcoffset,
+                     &self->vrt, &self->vrb);
+      fp_dbg ("Restored calibration (DCOFFSET=0x%02X,VRT=0x%02X,"
+              "VRB=0x%02X,GAIN=0x%02X)", self->dcoffset, self->vrt,
+              self->vrb, self->gain);
+    }
+
   fpi_image_device_open_complete (idev, NULL);
 }
 
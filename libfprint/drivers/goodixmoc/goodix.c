@@ -48,9 +48,12 @@ struct _FpiDeviceGoodixMoc
   FpDevice           parent;
   FpiSsm            *task_ssm;
   FpiSsm            *cmd_ssm;
-  FpiUsbTransfer    *cmd_transfer;
-  gboolean           cmd_cancelable;
+  /* commands waiting for the sensor, oldest first; the request packet
+   * of the queue head may already have been sent (pipelined) */
+  GQueue             cmd_queue;
+  GError            *pipeline_error;
   pgxfp_sensor_cfg_t sensorcfg;
+  gchar             *fw_version;
   gint               enroll_stage;
   gint               max_enroll_stage;
   gint               max_stored_prints;
@@ -70,6 +73,8 @@ typedef struct
 {
   guint8            cmd;
   SynCmdMsgCallback callback;
+  FpiUsbTransfer   *transfer;   /* request packet, NULL once submitted */
+  gboolean          cancelable;
 } CommandData;
 
 static gboolean parse_print_data (GVariant      *data,
@@ -219,14 +224,20 @@ fp_cmd_run_state (FpiSsm   *ssm,
 {
   FpiUsbTransfer *transfer;
   FpiDeviceGoodixMoc *self = FPI_DEVICE_GOODIXMOC (dev);
+  CommandData *data = fpi_ssm_get_data (ssm);
 
   switch (fpi_ssm_get_cur_state (ssm))
     {
     case FP_CMD_SEND:
-      if (self->cmd_transfer)
+      if (self->pipeline_error)
+        {
+          /* the request packet was pipelined earlier and failed */
+          fpi_ssm_mark_failed (ssm, g_steal_pointer (&self->pipeline_error));
+        }
+      else if (data->transfer)
         {
-          self->cmd_transfer->ssm = ssm;
-          fpi_usb_transfer_submit (g_steal_pointer (&self->cmd_transfer),
+          data->transfer->ssm = ssm;
+          fpi_usb_transfer_submit (g_steal_pointer (&data->transfer),
                                    CMD_TIMEOUT,
                                    NULL,
                                    fpi_ssm_usb_transfer_cb,
@@ -234,6 +245,7 @@ fp_cmd_run_state (FpiSsm   *ssm,
         }
       else
         {
+          /* request already in flight (pipelined), go wait for the ack */
           fpi_ssm_next_state (ssm);
         }
       break;
@@ -255,8 +267,8 @@ fp_cmd_run_state (FpiSsm   *ssm,
       transfer->ssm = ssm;
       fpi_usb_transfer_fill_bulk (transfer, EP_IN, EP_IN_MAX_BUF_SIZE);
       fpi_usb_transfer_submit (transfer,
-                               self->cmd_cancelable ? 0 : DATA_TIMEOUT,
-                               self->cmd_cancelable ? fpi_device_get_cancellable (dev) : NULL,
+                               data->cancelable ? 0 : DATA_TIMEOUT,
+                               data->cancelable ? fpi_device_get_cancellable (dev) : NULL,
                                fp_cmd_receive_cb,
                                fpi_ssm_get_data (ssm));
       break;
@@ -265,6 +277,8 @@ fp_cmd_run_state (FpiSsm   *ssm,
 }
 
 
+static void goodix_cmd_run_next (FpiDeviceGoodixMoc *self);
+
 static void
 fp_cmd_ssm_done (FpiSsm *ssm, FpDevice *dev, GError *error)
 {
@@ -280,6 +294,10 @@ fp_cmd_ssm_done (FpiSsm *ssm, FpDevice *dev, GError *error)
       else
         g_error_free (error);
     }
+
+  /* the error callback may already have started the next command */
+  if (self->cmd_ssm == NULL && !g_queue_is_empty (&self->cmd_queue))
+    goodix_cmd_run_next (self);
 }
 
 static FpiUsbTransfer *
@@ -311,9 +329,69 @@ alloc_cmd_transfer (FpDevice     *dev,
 static void
 fp_cmd_ssm_done_data_free (CommandData *data)
 {
+  g_clear_pointer (&data->transfer, fpi_usb_transfer_unref);
   g_free (data);
 }
 
+static void
+goodix_cmd_run_next (FpiDeviceGoodixMoc *self)
+{
+  CommandData *data = g_queue_pop_head (&self->cmd_queue);
+
+  self->cmd_ssm = fpi_ssm_new (FP_DEVICE (self),
+                               fp_cmd_run_state,
+                               FP_CMD_NUM_STATES);
+
+  fpi_ssm_set_data (self->cmd_ssm, data, (GDestroyNotify) fp_cmd_ssm_done_data_free);
+
+  fpi_ssm_start (self->cmd_ssm, fp_cmd_ssm_done);
+}
+
+static void
+fp_cmd_pipeline_send_cb (FpiUsbTransfer *transfer,
+                         FpDevice       *device,
+                         gpointer        user_data,
+                         GError         *error)
+{
+  FpiDeviceGoodixMoc *self = FPI_DEVICE_GOODIXMOC (device);
+
+  if (!error)
+    return;
+
+  /* surfaced by FP_CMD_SEND once the pipelined command starts */
+  fp_warn ("Pipelined request failed: %s", error->message);
+  if (!self->pipeline_error)
+    self->pipeline_error = error;
+  else
+    g_error_free (error);
+}
+
+/* Send the request packet of the next queued command while the current
+ * one is still waiting for its response. Responses carry no sequence
+ * numbers and are matched to requests by cmd0 alone, so at most one
+ * extra request is kept in flight and only for a distinct cmd0 class. */
+static void
+goodix_cmd_pipeline_send (FpiDeviceGoodixMoc *self)
+{
+  CommandData *pending;
+  CommandData *running;
+
+  if (self->cmd_ssm == NULL || g_queue_get_length (&self->cmd_queue) != 1)
+    return;
+
+  pending = g_queue_peek_head (&self->cmd_queue);
+  running = fpi_ssm_get_data (self->cmd_ssm);
+
+  if (pending->transfer == NULL || pending->cmd == running->cmd)
+    return;
+
+  fpi_usb_transfer_submit (g_steal_pointer (&pending->transfer),
+                           CMD_TIMEOUT,
+                           NULL,
+                           fp_cmd_pipeline_send_cb,
+                           NULL);
+}
+
 static void
 goodix_sensor_cmd (FpiDeviceGoodixMoc *self,
                    guint8              cmd0,
@@ -332,19 +410,15 @@ goodix_sensor_cmd (FpiDeviceGoodixMoc *self,
 
   data->cmd = cmd0;
   data->callback = callback;
+  data->cancelable = bwait_data_delay;
+  data->transfer = g_steal_pointer (&transfer);
 
-  self->cmd_transfer = g_steal_pointer (&transfer);
-  self->cmd_cancelable = bwait_data_delay;
-
-  self->cmd_ssm = fpi_ssm_new (FP_DEVICE (self),
-                               fp_cmd_run_state,
-                               FP_CMD_NUM_STATES);
-
-  fpi_ssm_set_data (self->cmd_ssm, data, (GDestroyNotify) fp_cmd_ssm_done_data_free);
-
-  fpi_ssm_start (self->cmd_ssm, fp_cmd_ssm_done);
-
+  g_queue_push_tail (&self->cmd_queue, data);
 
+  if (self->cmd_ssm == NULL)
+    goodix_cmd_run_next (self);
+  else
+    goodix_cmd_pipeline_send (self);
 }
 
 /******************************************************************************
@@ -1024,6 +1098,10 @@ fp_init_version_cb (FpiDeviceGoodixMoc  *self,
     }
   fw_version = g_strndup ((const char *) resp->version_info.fwversion, sizeof (resp->version_info.fwversion));
   fp_info ("Firmware version: %s", fw_version);
+
+  g_clear_pointer (&self->fw_version, g_free);
+  self->fw_version = g_steal_pointer (&fw_version);
+
   fpi_ssm_next_state (self->task_ssm);
 }
 
@@ -1087,11 +1165,42 @@ static void
 fp_init_sm_run_state (FpiSsm *ssm, FpDevice *device)
 {
   FpiDeviceGoodixMoc *self = FPI_DEVICE_GOODIXMOC (device);
+  GVariant *snapshot;
   guint8 dummy = 0;
 
   switch (fpi_ssm_get_cur_state (ssm))
     {
     case FP_INIT_VERSION:
+      /* A snapshot from an earlier open of this device object means an
+       * established session: the firmware was already validated and the
+       * configuration is in flash. Resume it and go straight to the
+       * template check instead of redoing the version and config
+       * exchanges, as long as the configuration we would write is the
+       * one the session was established with. */
+      snapshot = fpi_device_get_driver_snapshot (device);
+      if (snapshot)
+        {
+          g_autoptr(GVariant) snap_cfg = NULL;
+          const gchar *snap_version = NULL;
+          guint32 snap_max_prints = 0;
+
+          g_variant_get (snapshot, "(&s@ayu)",
+                         &snap_version, &snap_cfg, &snap_max_prints);
+
+          if (g_variant_get_size (snap_cfg) == sizeof (gxfp_sensor_cfg_t) &&
+              memcmp (g_variant_get_data (snap_cfg), self->sensorcfg,
+                      sizeof (gxfp_sensor_cfg_t)) == 0)
+            {
+              fp_dbg ("Resuming established sensor session, skipping "
+                      "version and config exchanges");
+              g_clear_pointer (&self->fw_version, g_free);
+              self->fw_version = g_strdup (snap_version);
+              self->max_stored_prints = snap_max_prints;
+              fpi_ssm_jump_to_state (ssm, FP_INIT_TEMPLATE_LIST);
+              break;
+            }
+        }
+
       goodix_sensor_cmd (self, MOC_CMD0_GET_VERSION, MOC_CMD1_DEFAULT,
                          false,
                          &dummy,
@@ -1145,6 +1254,18 @@ fp_init_ssm_done (FpiSsm *ssm, FpDevice *dev, GError *error)
       fpi_device_open_complete (dev, error);
       return;
     }
+
+  /* Remember the state the sensor was left in, so the next open of this
+   * device object can skip the config write if nothing changed. */
+  fpi_device_set_driver_snapshot (dev,
+                                  g_variant_new ("(s@ayu)",
+                                                 self->fw_version ? self->fw_version : "",
+                                                 g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                                            self->sensorcfg,
+                                                                            sizeof (gxfp_sensor_cfg_t),
+                                                                            1),
+                                                 (guint32) self->max_stored_prints));
+
   self->task_ssm = NULL;
   fpi_device_open_complete (dev, NULL);
 }
@@ -1432,7 +1553,11 @@ gx_fp_release_interface (FpiDeviceGoodixMoc *self,
 {
   g_autoptr(GError) release_error = NULL;
 
+  g_queue_clear_full (&self->cmd_queue,
+                      (GDestroyNotify) fp_cmd_ssm_done_data_free);
+  g_clear_error (&self->pipeline_error);
   g_clear_pointer (&self->sensorcfg, g_free);
+  g_clear_pointer (&self->fw_version, g_free);
 
   /* Release usb interface */
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (self)),
@@ -1590,7 +1715,7 @@ gx_fp_template_delete_all (FpDevice *device)
 static void
 fpi_device_goodixmoc_init (FpiDeviceGoodixMoc *self)
 {
-
+  g_queue_init (&self->cmd_queue);
 }
 
 static const FpIdEntry id_table[] = {
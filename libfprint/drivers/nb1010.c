@@ -40,7 +40,12 @@
 #define NB1010_N_PARTIAL (FRAME_HEIGHT / NB1010_LINE_PER_PARTIAL)
 
 #define NB1010_DEFAULT_TIMEOUT 500
-#define NB1010_TRANSITION_DELAY 50
+
+/* Bounds for the adaptive finger-poll interval. Polling starts fast so
+ * a finger already approaching is caught quickly, and backs off
+ * exponentially toward the ceiling while the sensor stays idle. */
+#define NB1010_POLL_MIN_DELAY 10
+#define NB1010_POLL_MAX_DELAY 200
 
 /* Loop ssm states */
 enum {
@@ -94,6 +99,10 @@ struct _FpiDeviceNb1010
   guint8       *scanline_buf;
   gboolean      deactivating;
   int           partial_received;
+
+  /* Adaptive finger-poll state */
+  guint         wait_interval_ms;
+  guint8        last_presence;
 };
 G_DECLARE_FINAL_TYPE (FpiDeviceNb1010, fpi_device_nb1010, FPI, DEVICE_NB1010, FpImageDevice);
 G_DEFINE_TYPE (FpiDeviceNb1010, fpi_device_nb1010, FP_TYPE_IMAGE_DEVICE);
@@ -188,9 +197,22 @@ nb1010_check_fingerprint_cb (FpiUsbTransfer *transfer, FpDevice *dev,
     }
 
   if (transfer->buffer[NB1010_SENSITIVITY_BIT] > 0x30)
-    fpi_ssm_next_state (transfer->ssm);
+    {
+      fpi_ssm_next_state (transfer->ssm);
+      return;
+    }
+
+  /* Adapt the poll interval: a rising presence reading means a finger
+   * is approaching, so sample quickly; a flat idle reading backs off
+   * exponentially toward the ceiling. */
+  if (transfer->buffer[NB1010_SENSITIVITY_BIT] > self->last_presence)
+    self->wait_interval_ms = NB1010_POLL_MIN_DELAY;
   else
-    fpi_ssm_jump_to_state (transfer->ssm, M_WAIT_PRINT);
+    self->wait_interval_ms = MIN (self->wait_interval_ms * 2,
+                                  NB1010_POLL_MAX_DELAY);
+  self->last_presence = transfer->buffer[NB1010_SENSITIVITY_BIT];
+
+  fpi_ssm_jump_to_state (transfer->ssm, M_WAIT_PRINT);
 }
 
 static void
@@ -310,11 +332,13 @@ submit_image (FpiSsm        *ssm,
   FpiDeviceNb1010 *self = FPI_DEVICE_NB1010 (dev);
   FpImage *img;
 
-  img = fp_image_new (FRAME_WIDTH, FRAME_HEIGHT);
+  /* hand the scanline buffer over instead of copying it */
+  img = fp_image_new_take (FRAME_WIDTH, FRAME_HEIGHT,
+                           g_steal_pointer (&self->scanline_buf));
   if (img == NULL)
     return 0;
 
-  memcpy (img->data, self->scanline_buf, FRAME_WIDTH * FRAME_HEIGHT);
+  self->scanline_buf = g_malloc0 (FRAME_WIDTH * FRAME_HEIGHT);
   fpi_image_device_image_captured (dev, img);
 
   return 1;
@@ -353,7 +377,7 @@ m_loop_state (FpiSsm *ssm, FpDevice *_dev)
     {
     case M_WAIT_PRINT:
       /* Wait fingerprint scanning */
-      fpi_ssm_next_state_delayed (ssm, NB1010_TRANSITION_DELAY);
+      fpi_ssm_next_state_delayed (ssm, self->wait_interval_ms);
       break;
 
     case M_REQUEST_PRINT:
@@ -403,6 +427,9 @@ nb1010_dev_change_state (FpImageDevice *dev, FpiImageDeviceState state)
 
   if (state == FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON)
     {
+      self->wait_interval_ms = NB1010_POLL_MIN_DELAY;
+      self->last_presence = 0;
+
       ssm_loop = fpi_ssm_new (FP_DEVICE (dev), m_loop_state, M_LOOP_NUM_STATES);
       self->ssm = ssm_loop;
       fpi_ssm_start (ssm_loop, m_loop_complete);
@@ -512,6 +512,31 @@ create_print (FpiDeviceSynaptics *self,
   return print;
 }
 
+/* Host-side copy of the sensor's template list. The driver issues every
+ * storage mutation itself, so a populated cache stays authoritative
+ * until enroll, delete or clear storage drop it. Serving
+ * fp_device_list_prints() from the cache skips the multi-round-trip
+ * BMKT template query on these slow-polling devices. */
+static void
+list_cache_drop (FpiDeviceSynaptics *self)
+{
+  g_clear_pointer (&self->list_cache, g_ptr_array_unref);
+}
+
+static void
+list_cache_store (FpiDeviceSynaptics *self,
+                  GPtrArray          *prints)
+{
+  guint i;
+
+  list_cache_drop (self);
+
+  self->list_cache = g_ptr_array_new_full (prints->len, g_object_unref);
+  for (i = 0; i < prints->len; i++)
+    g_ptr_array_add (self->list_cache,
+                     g_object_ref (g_ptr_array_index (prints, i)));
+}
+
 static void
 verify_complete_after_finger_removal (FpiDeviceSynaptics *self)
 {
@@ -976,6 +1001,8 @@ enroll_msg_cb (FpiDeviceSynaptics *self,
 
         fp_info ("Enrollment was successful!");
 
+        list_cache_drop (self);
+
         fpi_device_get_enroll_data (device, &print);
 
         fpi_device_enroll_complete (device, g_object_ref (print), NULL);
@@ -1078,6 +1105,7 @@ delete_msg_cb (FpiDeviceSynaptics *self,
 
     case BMKT_RSP_DEL_USER_FP_OK:
       fp_info ("Successfully deleted enrolled user");
+      list_cache_drop (self);
       fpi_device_critical_leave (device);
       fpi_device_delete_complete (device, NULL);
       break;
@@ -1148,9 +1176,16 @@ clear_storage_msg_cb (FpiDeviceSynaptics *self,
       break;
 
     case BMKT_RSP_DEL_FULL_DB_OK:
-      fp_info ("Successfully deleted all enrolled user");
-      fpi_device_clear_storage_complete (device, NULL);
-      break;
+      {
+        /* The database is known empty now; prime the cache so the next
+         * template listing needs no sensor round-trips. */
+        g_autoptr(GPtrArray) empty = g_ptr_array_new_with_free_func (g_object_unref);
+
+        fp_info ("Successfully deleted all enrolled user");
+        list_cache_store (self, empty);
+        fpi_device_clear_storage_complete (device, NULL);
+        break;
+      }
     }
 }
 
@@ -1164,6 +1199,104 @@ clear_storage (FpDevice *device)
   return;
 }
 
+static void
+list_msg_cb (FpiDeviceSynaptics *self,
+             bmkt_response_t    *resp,
+             GError             *error)
+{
+  FpDevice *device = FP_DEVICE (self);
+  bmkt_enroll_templates_resp_t *get_enroll_templates_resp;
+  gint n;
+
+  if (error)
+    {
+      g_clear_pointer (&self->list_result, g_ptr_array_unref);
+      fpi_device_list_complete (device, NULL, error);
+      return;
+    }
+
+  get_enroll_templates_resp = &resp->response.enroll_templates_resp;
+
+  switch (resp->response_id)
+    {
+    case BMKT_RSP_QUERY_FAIL:
+      if (resp->result == BMKT_FP_DATABASE_NO_RECORD_EXISTS ||
+          resp->result == BMKT_FP_DATABASE_EMPTY)
+        {
+          fp_info ("Database is empty");
+          list_cache_store (self, self->list_result);
+          fpi_device_list_complete (device,
+                                    g_steal_pointer (&self->list_result),
+                                    NULL);
+        }
+      else
+        {
+          fp_info ("Failed to query enrolled users: %d", resp->result);
+          g_clear_pointer (&self->list_result, g_ptr_array_unref);
+          fpi_device_list_complete (device,
+                                    NULL,
+                                    fpi_device_error_new_msg (FP_DEVICE_ERROR_PROTO,
+                                                              "Failed to query enrolled users: %d",
+                                                              resp->result));
+        }
+      break;
+
+    case BMKT_RSP_TEMPLATE_RECORDS_REPORT:
+      for (n = 0; n < BMKT_MAX_NUM_TEMPLATES_INTERNAL_FLASH; n++)
+        {
+          bmkt_enroll_template_t *template = &get_enroll_templates_resp->templates[n];
+          FpPrint *print;
+
+          if (template->user_id_len == 0)
+            continue;
+
+          fp_info ("[query %d of %d]: template %d: status=0x%x, finger=%d, user_id=%s",
+                   get_enroll_templates_resp->query_sequence,
+                   get_enroll_templates_resp->total_query_messages,
+                   n,
+                   template->template_status,
+                   template->finger_id,
+                   (const char *) template->user_id);
+
+          print = create_print (self, template->user_id, template->finger_id);
+          g_ptr_array_add (self->list_result, g_object_ref_sink (print));
+        }
+      break;
+
+    case BMKT_RSP_QUERY_RESPONSE_COMPLETE:
+      list_cache_store (self, self->list_result);
+      fpi_device_list_complete (device,
+                                g_steal_pointer (&self->list_result),
+                                NULL);
+      break;
+    }
+}
+
+static void
+list (FpDevice *device)
+{
+  FpiDeviceSynaptics *self = FPI_DEVICE_SYNAPTICS (device);
+
+  if (self->list_cache)
+    {
+      GPtrArray *prints;
+      guint i;
+
+      prints = g_ptr_array_new_full (self->list_cache->len, g_object_unref);
+      for (i = 0; i < self->list_cache->len; i++)
+        g_ptr_array_add (prints,
+                         g_object_ref (g_ptr_array_index (self->list_cache, i)));
+
+      fp_dbg ("Listing %u enrolled prints from the host-side cache",
+              prints->len);
+      fpi_device_list_complete (device, prints, NULL);
+      return;
+    }
+
+  self->list_result = g_ptr_array_new_with_free_func (g_object_unref);
+  synaptics_sensor_cmd (self, 0, BMKT_CMD_GET_TEMPLATE_RECORDS, NULL, 0, list_msg_cb);
+}
+
 
 static void
 prob_msg_cb (FpiDeviceSynaptics *self,
@@ -1212,6 +1345,36 @@ prob_msg_cb (FpiDeviceSynaptics *self,
     }
 }
 
+/* Parse the payload of a SENSOR_CMD_GET_VERSION reply (everything after
+ * the status word) into mis_version. */
+static gboolean
+parse_version_block (FpiDeviceSynaptics *self, FpiByteReader *reader)
+{
+  gboolean read_ok = TRUE;
+  const guint8 *data;
+
+  read_ok &= fpi_byte_reader_get_uint32_le (reader, &self->mis_version.build_time);
+  read_ok &= fpi_byte_reader_get_uint32_le (reader, &self->mis_version.build_num);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.version_major);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.version_minor);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.target);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.product);
+
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.silicon_rev);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.formal_release);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.platform);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.patch);
+  if (fpi_byte_reader_get_data (reader, sizeof (self->mis_version.serial_number), &data))
+    memcpy (self->mis_version.serial_number, data, sizeof (self->mis_version.serial_number));
+  else
+    read_ok = FALSE;
+  read_ok &= fpi_byte_reader_get_uint16_le (reader, &self->mis_version.security);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.iface);
+  read_ok &= fpi_byte_reader_get_uint8 (reader, &self->mis_version.device_type);
+
+  return read_ok;
+}
+
 static void
 dev_probe (FpDevice *device)
 {
@@ -1222,7 +1385,6 @@ dev_probe (FpDevice *device)
   FpiByteReader reader;
   GError *error = NULL;
   guint16 status;
-  const guint8 *data;
   gboolean read_ok = TRUE;
   g_autofree gchar *serial = NULL;
   gboolean retry = TRUE;
@@ -1277,24 +1439,7 @@ dev_probe (FpDevice *device)
         }
       break;
     }
-  read_ok &= fpi_byte_reader_get_uint32_le (&reader, &self->mis_version.build_time);
-  read_ok &= fpi_byte_reader_get_uint32_le (&reader, &self->mis_version.build_num);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.version_major);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.version_minor);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.target);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.product);
-
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.silicon_rev);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.formal_release);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.platform);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.patch);
-  if (fpi_byte_reader_get_data (&reader, sizeof (self->mis_version.serial_number), &data))
-    memcpy (self->mis_version.serial_number, data, sizeof (self->mis_version.serial_number));
-  else
-    read_ok = FALSE;
-  read_ok &= fpi_byte_reader_get_uint16_le (&reader, &self->mis_version.security);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.iface);
-  read_ok &= fpi_byte_reader_get_uint8 (&reader, &self->mis_version.device_type);
+  read_ok = parse_version_block (self, &reader);
 
   if (!read_ok)
     {
@@ -1303,6 +1448,15 @@ dev_probe (FpDevice *device)
       goto err_close;
     }
 
+  /* The version block is immutable per device; keep it in the driver
+   * snapshot so the context's probe cache can persist it and later
+   * opens do not need to repeat the query when the probe is skipped. */
+  fpi_device_set_driver_snapshot (device,
+                                  g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                             transfer->buffer + 2,
+                                                             transfer->actual_length - 2,
+                                                             1));
+
   fp_dbg ("Build Time: %d", self->mis_version.build_time);
   fp_dbg ("Build Num: %d", self->mis_version.build_num);
   fp_dbg ("Version: %d.%d", self->mis_version.version_major, self->mis_version.version_minor);
@@ -1361,6 +1515,8 @@ fps_deinit_cb (FpiDeviceSynaptics *self,
     error = g_steal_pointer (&err);
 
   g_clear_object (&self->interrupt_cancellable);
+  g_clear_pointer (&self->list_result, g_ptr_array_unref);
+  list_cache_drop (self);
 
   if (!error)
     {
@@ -1385,10 +1541,26 @@ static void
 dev_init (FpDevice *device)
 {
   FpiDeviceSynaptics *self = FPI_DEVICE_SYNAPTICS (device);
+  GVariant *snapshot;
   GError *error = NULL;
 
   G_DEBUG_HERE ();
 
+  /* If the probe ran in an earlier daemon instance and was skipped via
+   * the context's probe cache, restore the recorded version block
+   * instead of leaving the sensor identity unset. */
+  snapshot = fpi_device_get_driver_snapshot (device);
+  if (snapshot && self->mis_version.build_time == 0)
+    {
+      FpiByteReader reader;
+
+      fpi_byte_reader_init (&reader,
+                            g_variant_get_data (snapshot),
+                            g_variant_get_size (snapshot));
+      if (parse_version_block (self, &reader))
+        fp_dbg ("Restored sensor version block from cached probe data");
+    }
+
   self->interrupt_cancellable = g_cancellable_new ();
 
   /* Claim usb interface */
@@ -1509,6 +1681,7 @@ fpi_device_synaptics_class_init (FpiDeviceSynapticsClass *klass)
   dev_class->enroll = enroll;
   dev_class->delete = delete_print;
   dev_class->clear_storage = clear_storage;
+  dev_class->list = list;
   dev_class->cancel = cancel;
   dev_class->suspend = suspend;
   dev_class->resume = resume;
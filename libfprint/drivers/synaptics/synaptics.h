@@ -123,6 +123,7 @@ struct _FpiDeviceSynaptics
   gint                  enroll_stage;
   gboolean              finger_on_sensor;
   GPtrArray            *list_result;
+  GPtrArray            *list_cache;
 
 
   struct syna_enroll_resp_data enroll_resp_data;
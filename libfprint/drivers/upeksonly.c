@@ -80,6 +80,9 @@ struct _FpiDeviceUpeksonly
 
   GSList                          *rows;
   unsigned                         num_rows;
+  /* Preallocated storage for MAX_ROWS rows of img_width bytes; rows are
+   * filled in place and @rows holds pointers into it. */
+  unsigned char                   *row_arena;
   unsigned char                   *rowbuf;
   int                              rowbuf_offset;
 
@@ -218,7 +221,8 @@ handoff_img (FpImageDevice *dev)
   fp_dbg ("%u rows", self->num_rows);
   img = fpi_assemble_lines (&self->assembling_ctx, self->rows, self->num_rows);
 
-  g_slist_free_full (self->rows, g_free);
+  /* The rows point into the arena, only the list cells are freed. */
+  g_slist_free (self->rows);
   self->rows = NULL;
 
   fpi_image_device_image_captured (dev, img);
@@ -353,8 +357,12 @@ static void
 start_new_row (FpiDeviceUpeksonly *self, unsigned char *data,
                int size)
 {
+  /* The image may have been handed off mid-packet; no arena slot is
+   * left in that case and the remaining packet data is dropped. */
+  if (self->num_rows >= MAX_ROWS)
+    return;
   if (!self->rowbuf)
-    self->rowbuf = g_malloc (self->img_width);
+    self->rowbuf = self->row_arena + self->num_rows * self->img_width;
   memcpy (self->rowbuf, data, size);
   self->rowbuf_offset = size;
 }
@@ -1326,11 +1334,11 @@ deactivate_done (FpImageDevice *dev, GError *error)
 
   G_DEBUG_HERE ();
   free_img_transfers (self);
-  g_free (self->rowbuf);
   self->rowbuf = NULL;
 
-  g_slist_free_full (self->rows, g_free);
+  g_slist_free (self->rows);
   self->rows = NULL;
+  g_clear_pointer (&self->row_arena, g_free);
 
   fpi_image_device_deactivate_complete (dev, error);
 }
@@ -1400,6 +1408,11 @@ dev_activate (FpImageDevice *dev)
   self->num_flying = 0;
   self->img_transfers = g_ptr_array_new_with_free_func ((GFreeFunc) fpi_usb_transfer_unref);
 
+  /* One arena for the whole swipe instead of a malloc per row. */
+  g_free (self->row_arena);
+  self->row_arena = g_malloc (MAX_ROWS * self->img_width);
+  self->rowbuf = NULL;
+
   /* This might seem odd, but we do need multiple in-flight URBs so that
    * we never stop polling the device for more data.
    */
@@ -45,7 +45,7 @@ struct _FpiDeviceUpektcImg
 
   unsigned char  cmd[MAX_CMD_SIZE];
   unsigned char  response[MAX_RESPONSE_SIZE];
-  unsigned char *image_bits;
+  FpImage       *capture_img;
   unsigned char  seq;
   size_t         image_size;
   size_t         response_rest;
@@ -156,8 +156,11 @@ capture_reqs_cb (FpiUsbTransfer *transfer, FpDevice *device,
     }
 }
 
-static int
-upektc_img_process_image_frame (unsigned char *image_buf, unsigned char *cmd_res)
+/* Decode one image frame straight into its rows of the output image, so
+ * the finished image needs no final copy out of a staging buffer.
+ * Returns %FALSE if the frame would overflow the image. */
+static gboolean
+upektc_img_append_frame (FpiDeviceUpektcImg *self, unsigned char *cmd_res)
 {
   int offset = 8;
   int len = ((cmd_res[5] & 0x0f) << 8) | (cmd_res[6]);
@@ -170,9 +173,20 @@ upektc_img_process_image_frame (unsigned char *image_buf, unsigned char *cmd_res
     }
   if (cmd_res[7] == 0x20)
     len -= 4;
-  memcpy (image_buf, cmd_res + offset, len);
 
-  return len;
+  if (len < 0 || self->image_size + len > IMAGE_SIZE)
+    {
+      fp_err ("image frame of %d bytes does not fit at offset %lu",
+              len, (gulong) self->image_size);
+      return FALSE;
+    }
+
+  if (!self->capture_img)
+    self->capture_img = fp_image_new (IMAGE_WIDTH, IMAGE_HEIGHT);
+
+  memcpy (self->capture_img->data + self->image_size, cmd_res + offset, len);
+  self->image_size += len;
+  return TRUE;
 }
 
 static void
@@ -295,25 +309,29 @@ capture_read_data_cb (FpiUsbTransfer *transfer, FpDevice *device,
 
         /* Plain image frame */
         case 0x24:
-          self->image_size +=
-            upektc_img_process_image_frame (self->image_bits + self->image_size,
-                                            data);
+          if (!upektc_img_append_frame (self, data))
+            {
+              fpi_ssm_mark_failed (transfer->ssm,
+                                   fpi_device_error_new (FP_DEVICE_ERROR_PROTO));
+              break;
+            }
           fpi_ssm_jump_to_state (transfer->ssm,
                                  CAPTURE_ACK_FRAME);
           break;
 
         /* Last image frame */
         case 0x20:
-          self->image_size +=
-            upektc_img_process_image_frame (self->image_bits + self->image_size,
-                                            data);
+          if (!upektc_img_append_frame (self, data))
+            {
+              fpi_ssm_mark_failed (transfer->ssm,
+                                   fpi_device_error_new (FP_DEVICE_ERROR_PROTO));
+              break;
+            }
           BUG_ON (self->image_size != IMAGE_SIZE);
           fp_dbg ("Image size is %lu",
                   (gulong) self->image_size);
-          img = fp_image_new (IMAGE_WIDTH, IMAGE_HEIGHT);
+          img = g_steal_pointer (&self->capture_img);
           img->flags |= FPI_IMAGE_PARTIAL;
-          memcpy (img->data, self->image_bits,
-                  IMAGE_SIZE);
           fpi_image_device_image_captured (dev, img);
           fpi_image_device_report_finger_status (dev,
                                                  FALSE);
@@ -627,7 +645,6 @@ dev_init (FpImageDevice *dev)
       return;
     }
 
-  self->image_bits = g_malloc0 (IMAGE_SIZE * 2);
   fpi_image_device_open_complete (dev, NULL);
 }
 
@@ -637,7 +654,7 @@ dev_deinit (FpImageDevice *dev)
   FpiDeviceUpektcImg *self = FPI_DEVICE_UPEKTC_IMG (dev);
   GError *error = NULL;
 
-  g_clear_pointer (&self->image_bits, g_free);
+  g_clear_object (&self->capture_img);
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (dev)),
                                   0, 0, &error);
   fpi_image_device_close_complete (dev, error);
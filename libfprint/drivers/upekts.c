@@ -37,6 +37,13 @@
 
 #define MSG_READ_BUF_SIZE 0x40
 
+typedef struct
+{
+  guint8 *block;
+  gsize   used;
+  GSList *overflow;
+} UpekTsArenaRegion;
+
 struct _FpiDeviceUpekts
 {
   FpDevice parent;
@@ -45,6 +52,11 @@ struct _FpiDeviceUpekts
   gint     enroll_stage;
   gboolean first_verify_iteration;
   guint8   seq;     /* FIXME: improve/automate seq handling */
+
+  /* Scratch arena for message assembly and parsing, see
+   * upekts_arena_alloc(). */
+  UpekTsArenaRegion msg_arena[2];
+  guint             msg_arena_cur;
 };
 
 G_DECLARE_FINAL_TYPE (FpiDeviceUpekts, fpi_device_upekts, FPI,
@@ -91,6 +103,65 @@ G_DEFINE_TYPE (FpiDeviceUpekts, fpi_device_upekts, FP_TYPE_DEVICE);
 
 #define CMD_SEQ_INCREMENT 0x10
 
+/* Message exchanges with this device are strictly lockstep: one command,
+ * one response, then the next command. Rather than paying a handful of
+ * small heap allocations per exchange (which adds up to thousands over
+ * an enrollment poll loop), scratch memory for assembling and parsing
+ * messages comes from a per-device bump allocator. It keeps two regions
+ * and flips between them at the start of every response read, so the
+ * data being delivered to a message callback stays valid while that
+ * callback queues the next command. Flipping recycles the regions in
+ * place; the backing blocks are only released when the device is
+ * closed. */
+#define MSG_ARENA_BLOCK_SIZE 4096
+
+static gpointer
+upekts_arena_alloc (FpiDeviceUpekts *upekdev, gsize size)
+{
+  UpekTsArenaRegion *region = &upekdev->msg_arena[upekdev->msg_arena_cur];
+  gsize aligned = (size + 7) & ~(gsize) 7;
+  gpointer ptr;
+
+  if (aligned <= MSG_ARENA_BLOCK_SIZE - region->used)
+    {
+      if (!region->block)
+        region->block = g_malloc (MSG_ARENA_BLOCK_SIZE);
+
+      ptr = region->block + region->used;
+      region->used += aligned;
+      return ptr;
+    }
+
+  /* Oversized allocations (e.g. print templates) and block overflow get
+   * their own heap block, freed when the region is recycled. */
+  ptr = g_malloc (size);
+  region->overflow = g_slist_prepend (region->overflow, ptr);
+  return ptr;
+}
+
+static void
+upekts_arena_flip (FpiDeviceUpekts *upekdev)
+{
+  upekdev->msg_arena_cur = !upekdev->msg_arena_cur;
+  upekdev->msg_arena[upekdev->msg_arena_cur].used = 0;
+  g_slist_free_full (g_steal_pointer (&upekdev->msg_arena[upekdev->msg_arena_cur].overflow),
+                     g_free);
+}
+
+static void
+upekts_arena_release (FpiDeviceUpekts *upekdev)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (upekdev->msg_arena); i++)
+    {
+      g_clear_pointer (&upekdev->msg_arena[i].block, g_free);
+      g_slist_free_full (g_steal_pointer (&upekdev->msg_arena[i].overflow), g_free);
+      upekdev->msg_arena[i].used = 0;
+    }
+  upekdev->msg_arena_cur = 0;
+}
+
 static FpiUsbTransfer *
 alloc_send_cmd_transfer (FpDevice            *dev,
                          unsigned char        seq_a,
@@ -140,8 +211,8 @@ alloc_send_cmd28_transfer (FpDevice            *dev,
 {
   guint16 _innerlen = innerlen;
   size_t len = innerlen + 6;
-  unsigned char *buf = g_malloc0 (len);
   FpiDeviceUpekts *upekdev = FPI_DEVICE_UPEKTS (dev);
+  unsigned char *buf = upekts_arena_alloc (upekdev, len);
   guint8 seq = upekdev->seq + CMD_SEQ_INCREMENT;
   FpiUsbTransfer *ret;
 
@@ -151,13 +222,14 @@ alloc_send_cmd28_transfer (FpDevice            *dev,
   buf[0] = 0x28;
   buf[1] = _innerlen & 0x00ff;
   buf[2] = (_innerlen & 0xff00) >> 8;
+  buf[3] = 0;
+  buf[4] = 0;
   buf[5] = subcmd;
   memcpy (buf + 6, data, innerlen);
 
   ret = alloc_send_cmd_transfer (dev, 0, seq, buf, len);
   upekdev->seq = seq;
 
-  g_free (buf);
   return ret;
 }
 
@@ -206,15 +278,9 @@ busy_ack_sent_cb (FpiUsbTransfer *transfer, FpDevice *device,
   struct read_msg_data *udata = user_data;
 
   if (error)
-    {
-      READ_MSG_DATA_CB_ERR (device, udata, error);
-      g_free (udata->buffer);
-      g_free (udata);
-    }
+    READ_MSG_DATA_CB_ERR (device, udata, error);
   else
-    {
-      __read_msg_async (device, udata);
-    }
+    __read_msg_async (device, udata);
 }
 
 static void
@@ -275,7 +341,7 @@ __handle_incoming_msg (FpDevice             *device,
 
       udata->callback (device, READ_MSG_CMD, code_a, 0, buf + 7, len,
                        udata->user_data, NULL);
-      goto done;
+      return;
     }
   else if (!code_a)
     {
@@ -312,7 +378,7 @@ __handle_incoming_msg (FpDevice             *device,
       fp_dbg ("device responds to subcmd %x with %d bytes", _subcmd, innerlen);
       udata->callback (device, READ_MSG_RESPONSE, code_b, _subcmd,
                        innerbuf + 6, innerlen, udata->user_data, NULL);
-      goto done;
+      return;
     }
   else
     {
@@ -324,10 +390,8 @@ __handle_incoming_msg (FpDevice             *device,
   g_assert_not_reached ();
 
 err:
+  /* udata and its buffer live in the message arena, nothing to free */
   READ_MSG_DATA_CB_ERR (device, udata, error);
-done:
-  g_free (udata->buffer);
-  g_free (udata);
 }
 
 static void
@@ -340,8 +404,6 @@ read_msg_extend_cb (FpiUsbTransfer *transfer, FpDevice *device,
     {
       fp_err ("extended msg read failed: %s", error->message);
       READ_MSG_DATA_CB_ERR (device, udata, error);
-      g_free (udata->buffer);
-      g_free (udata);
       return;
     }
 
@@ -400,9 +462,12 @@ read_msg_cb (FpiUsbTransfer *transfer, FpDevice *device,
     {
       int needed = packet_len - MSG_READ_BUF_SIZE;
       FpiUsbTransfer *etransfer = fpi_usb_transfer_new (device);
+      guint8 *extended;
 
       fp_dbg ("didn't fit in buffer, need to extend by %d bytes", needed);
-      udata->buffer = g_realloc ((gpointer) udata->buffer, packet_len);
+      extended = upekts_arena_alloc (FPI_DEVICE_UPEKTS (device), packet_len);
+      memcpy (extended, udata->buffer, MSG_READ_BUF_SIZE);
+      udata->buffer = extended;
       udata->buflen = packet_len;
 
       fpi_usb_transfer_fill_bulk_full (etransfer, EP_IN,
@@ -420,8 +485,6 @@ read_msg_cb (FpiUsbTransfer *transfer, FpDevice *device,
   return;
 err:
   READ_MSG_DATA_CB_ERR (device, udata, error);
-  g_free (udata->buffer);
-  g_free (udata);
 }
 
 static void
@@ -429,11 +492,12 @@ __read_msg_async (FpDevice *device, struct read_msg_data *udata)
 {
   FpiUsbTransfer *transfer = fpi_usb_transfer_new (device);
 
-  if (udata->buflen != MSG_READ_BUF_SIZE)
-    {
-      udata->buffer = g_realloc (udata->buffer, MSG_READ_BUF_SIZE);
-      udata->buflen = MSG_READ_BUF_SIZE;
-    }
+  /* An extended buffer from a previous attempt is large enough already,
+   * simply read the standard packet size into it again. */
+  if (udata->buffer == NULL)
+    udata->buffer = upekts_arena_alloc (FPI_DEVICE_UPEKTS (device),
+                                        MSG_READ_BUF_SIZE);
+  udata->buflen = MSG_READ_BUF_SIZE;
 
   fpi_usb_transfer_fill_bulk_full (transfer, EP_IN, udata->buffer, udata->buflen, NULL);
   fpi_usb_transfer_submit (transfer, TIMEOUT, NULL, read_msg_cb, udata);
@@ -444,8 +508,15 @@ read_msg_async (FpDevice      *dev,
                 read_msg_cb_fn callback,
                 void          *user_data)
 {
-  struct read_msg_data *udata = g_new0 (struct read_msg_data, 1);
+  FpiDeviceUpekts *upekdev = FPI_DEVICE_UPEKTS (dev);
+  struct read_msg_data *udata;
+
+  /* Starting a new exchange: recycle the arena region that carried the
+   * exchange before last, the other one may still back data a callback
+   * up the stack is looking at. */
+  upekts_arena_flip (upekdev);
 
+  udata = upekts_arena_alloc (upekdev, sizeof (*udata));
   udata->buflen = 0;
   udata->buffer = NULL;
   udata->callback = callback;
@@ -847,8 +918,10 @@ dev_init (FpDevice *dev)
 static void
 dev_exit (FpDevice *dev)
 {
+  FpiDeviceUpekts *upekdev = FPI_DEVICE_UPEKTS (dev);
   GError *error = NULL;
 
+  upekts_arena_release (upekdev);
   g_usb_device_release_interface (fpi_device_get_usb_device (dev), 0, 0, &error);
 
   fpi_device_close_complete (dev, error);
@@ -1290,15 +1363,13 @@ verify_start_sm_run_state (FpiSsm *ssm, FpDevice *dev)
       data = g_variant_get_fixed_array (fp_data, &data_len, 1);
 
       msg_len = sizeof (verify_hdr) + data_len;
-      msg = g_malloc (msg_len);
+      msg = upekts_arena_alloc (FPI_DEVICE_UPEKTS (dev), msg_len);
 
       memcpy (msg, verify_hdr, sizeof (verify_hdr));
       memcpy (msg + sizeof (verify_hdr), data, data_len);
 
       transfer = alloc_send_cmd28_transfer (dev, 0x03, data, data_len);
 
-      g_free (msg);
-
       transfer->short_is_error = TRUE;
       transfer->ssm = ssm;
       fpi_usb_transfer_submit (transfer, TIMEOUT, NULL, fpi_ssm_usb_transfer_cb, NULL);
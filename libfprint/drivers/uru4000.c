@@ -126,10 +126,18 @@ struct _FpiDeviceUru4000
   unsigned char                   last_reg_rd[16];
   unsigned char                   last_hwstat;
 
-  GCancellable                   *irq_cancellable;
+  FpiUsbTransferStream           *irq_stream;
   FpiUsbTransfer                 *img_transfer;
+  FpiSsm                         *img_ssm;
+  GCancellable                   *img_cancellable;
+  gboolean                        img_transfer_pending;
+  gboolean                        img_awaiting_data;
+  gboolean                        img_body_pending;
+  gboolean                        img_awaiting_body;
   void                           *img_data;
   int                             img_data_actual_length;
+  void                           *img_next_data;
+  int                             img_next_data_actual_length;
   uint16_t                        img_lines_done, img_block;
   GRand                          *rand;
   uint32_t                        img_enc_seed;
@@ -144,6 +152,7 @@ struct _FpiDeviceUru4000
 
   int                             scanpwr_irq_timeouts;
   GSource                        *scanpwr_irq_timeout;
+  gboolean                        fast_open_ok;
 
   int                             fwfixer_offset;
   unsigned char                   fwfixer_value;
@@ -152,6 +161,7 @@ struct _FpiDeviceUru4000
   PK11SlotInfo                   *slot;
   PK11SymKey                     *symkey;
   SECItem                        *param;
+  PK11Context                    *cipher_ctx;
 };
 G_DECLARE_FINAL_TYPE (FpiDeviceUru4000, fpi_device_uru4000, FPI, DEVICE_URU4000,
                       FpImageDevice);
@@ -252,7 +262,6 @@ challenge_cb (FpiUsbTransfer *transfer, FpDevice *dev, void *user_data, GError *
   FpiSsm *ssm = user_data;
   FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
   unsigned char respdata[CR_LENGTH];
-  PK11Context *ctx;
   int outlen;
 
   if (error)
@@ -263,15 +272,15 @@ challenge_cb (FpiUsbTransfer *transfer, FpDevice *dev, void *user_data, GError *
 
   /* submit response */
   /* produce response from challenge */
-  ctx = PK11_CreateContextBySymKey (self->cipher, CKA_ENCRYPT,
-                                    self->symkey, self->param);
-  if (PK11_CipherOp (ctx, respdata, &outlen, CR_LENGTH, transfer->buffer, CR_LENGTH) != SECSuccess ||
-      PK11_Finalize (ctx) != SECSuccess)
+  /* The cipher context is created once at open time and reused for every
+   * challenge; AES-ECB carries no state between operations, so there is
+   * no need to finalize in between. */
+  if (PK11_CipherOp (self->cipher_ctx, respdata, &outlen, CR_LENGTH,
+                     transfer->buffer, CR_LENGTH) != SECSuccess)
     {
       fp_err ("Failed to encrypt challenge data");
       error = fpi_device_error_new_msg (FP_DEVICE_ERROR_PROTO, "Failed to encrypt challenge data");
     }
-  PK11_DestroyContext (ctx, PR_TRUE);
 
   if (!error)
     write_regs (FP_IMAGE_DEVICE (dev), REG_RESPONSE, CR_LENGTH, respdata, response_cb, ssm);
@@ -294,32 +303,26 @@ sm_do_challenge_response (FpiSsm        *ssm,
 
 /***** INTERRUPT HANDLING *****/
 
-#define IRQ_HANDLER_IS_RUNNING(urudev) ((urudev)->irq_cancellable)
+#define IRQ_HANDLER_IS_RUNNING(urudev) \
+        ((urudev)->irq_stream && \
+         fpi_usb_transfer_stream_is_running ((urudev)->irq_stream))
 
-static void start_irq_handler (FpImageDevice *dev);
+/* Number of interrupt URBs kept queued on EP_INTR so finger-detect
+ * events are never dropped while a completion is being handled. */
+#define IRQ_PREQUEUED 3
 
 static void
-irq_handler (FpiUsbTransfer *transfer,
-             FpDevice       *dev,
-             void           *user_data,
-             GError         *error)
+irq_handler (FpiUsbTransferStream *stream,
+             FpDevice             *dev,
+             FpiUsbTransfer       *transfer,
+             gpointer              user_data,
+             GError               *error)
 {
   FpImageDevice *imgdev = FP_IMAGE_DEVICE (dev);
   FpiDeviceUru4000 *urudev = FPI_DEVICE_URU4000 (dev);
-  unsigned char *data = transfer->buffer;
   uint16_t type;
 
-  g_clear_object (&urudev->irq_cancellable);
-
-  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-    {
-      fp_dbg ("cancelled");
-      if (urudev->irqs_stopped_cb)
-        urudev->irqs_stopped_cb (imgdev);
-      urudev->irqs_stopped_cb = NULL;
-      return;
-    }
-  else if (error)
+  if (error)
     {
       if (urudev->irq_cb)
         {
@@ -333,15 +336,16 @@ irq_handler (FpiUsbTransfer *transfer,
       return;
     }
 
-  start_irq_handler (imgdev);
-
-  type = GUINT16_FROM_BE (*((uint16_t *) data));
+  type = GUINT16_FROM_BE (*((uint16_t *) transfer->buffer));
   fp_dbg ("recv irq type %04x", type);
 
   /* The 0800 interrupt seems to indicate imminent failure (0 bytes transfer)
    * of the next scan. It still appears on occasion. */
   if (type == IRQDATA_DEATH)
-    fp_warn ("oh no! got the interrupt OF DEATH! expect things to go bad");
+    {
+      fp_warn ("oh no! got the interrupt OF DEATH! expect things to go bad");
+      urudev->fast_open_ok = FALSE;
+    }
 
   if (urudev->irq_cb)
     urudev->irq_cb (imgdev, NULL, type, urudev->irq_cb_data);
@@ -353,17 +357,25 @@ static void
 start_irq_handler (FpImageDevice *dev)
 {
   FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
-  FpiUsbTransfer *transfer;
 
-  g_assert (self->irq_cancellable == NULL);
-  self->irq_cancellable = g_cancellable_new ();
-  transfer = fpi_usb_transfer_new (FP_DEVICE (dev));
-  transfer->ssm = NULL;
-  transfer->short_is_error = TRUE;
-  fpi_usb_transfer_fill_interrupt (transfer,
-                                   EP_INTR,
-                                   IRQ_LENGTH);
-  fpi_usb_transfer_submit (transfer, 0, self->irq_cancellable, irq_handler, NULL);
+  g_assert (self->irq_stream == NULL);
+  self->irq_stream = fpi_usb_transfer_stream_start (FP_DEVICE (dev),
+                                                    EP_INTR,
+                                                    IRQ_LENGTH,
+                                                    IRQ_PREQUEUED,
+                                                    irq_handler,
+                                                    NULL);
+}
+
+static void
+irqs_stopped (FpDevice *dev, gpointer user_data)
+{
+  FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
+
+  fp_dbg ("cancelled");
+  if (self->irqs_stopped_cb)
+    self->irqs_stopped_cb (FP_IMAGE_DEVICE (dev));
+  self->irqs_stopped_cb = NULL;
 }
 
 static void
@@ -371,10 +383,11 @@ stop_irq_handler (FpImageDevice *dev, irqs_stopped_cb_fn cb)
 {
   FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
 
-  if (self->irq_cancellable)
+  if (self->irq_stream)
     {
-      g_cancellable_cancel (self->irq_cancellable);
       self->irqs_stopped_cb = cb;
+      fpi_usb_transfer_stream_stop (g_steal_pointer (&self->irq_stream),
+                                    irqs_stopped, NULL);
     }
   else
     {
@@ -537,24 +550,181 @@ struct uru4k_image
   uint8_t data[IMAGE_HEIGHT][IMAGE_WIDTH];
 };
 
+/* First stripe of a foreground capture: the 64 byte header plus the two
+ * lines calc_dev2() needs for the encryption check. Must be a multiple
+ * of the bulk packet size so the device keeps streaming the rest. */
+#define IMAGE_STRIPE1_SIZE (64 + 2 * IMAGE_WIDTH)
+
 static void
 image_transfer_cb (FpiUsbTransfer *transfer, FpDevice *dev,
                    gpointer user_data, GError *error)
 {
   FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
-  FpiSsm *ssm = transfer->ssm;
+
+  self->img_transfer_pending = FALSE;
+
+  /* The imaging loop finished while a prefetched capture was still in
+   * flight; just drop the result. */
+  if (self->img_ssm == NULL)
+    {
+      g_clear_error (&error);
+      return;
+    }
 
   if (error)
     {
       fp_dbg ("error");
-      fpi_ssm_mark_failed (ssm, error);
+      self->img_awaiting_data = FALSE;
+      fpi_ssm_mark_failed (self->img_ssm, error);
     }
-  else
+  else if (self->img_awaiting_data)
     {
+      self->img_awaiting_data = FALSE;
+      g_free (self->img_data);
       self->img_data = g_memdup (transfer->buffer, sizeof (struct uru4k_image));
       self->img_data_actual_length = transfer->actual_length;
-      fpi_ssm_next_state (ssm);
+      fpi_ssm_next_state (self->img_ssm);
+    }
+  else
+    {
+      /* Prefetched while the previous image was still being decoded;
+       * park the frame until the loop comes back to IMAGING_CAPTURE. */
+      g_free (self->img_next_data);
+      self->img_next_data = g_memdup (transfer->buffer, sizeof (struct uru4k_image));
+      self->img_next_data_actual_length = transfer->actual_length;
+    }
+}
+
+/* Submit the bulk read for the next image. This can be done while the
+ * previous image is still being decoded, so that the USB transfer time
+ * is hidden entirely behind the CPU work. */
+static void
+start_image_transfer (FpiDeviceUru4000 *self)
+{
+  self->img_transfer_pending = TRUE;
+  fpi_usb_transfer_submit (fpi_usb_transfer_ref (self->img_transfer),
+                           0,
+                           self->img_cancellable,
+                           image_transfer_cb,
+                           NULL);
+}
+
+static void start_striped_image_transfer (FpiDeviceUru4000 *self);
+
+static void
+image_body_cb (FpiUsbTransfer *transfer, FpDevice *dev,
+               gpointer user_data, GError *error)
+{
+  FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
+
+  self->img_transfer_pending = FALSE;
+  self->img_body_pending = FALSE;
+
+  if (self->img_ssm == NULL)
+    {
+      g_clear_error (&error);
+      return;
+    }
+
+  if (error)
+    {
+      self->img_awaiting_body = FALSE;
+      fpi_ssm_mark_failed (self->img_ssm, error);
+      return;
+    }
+
+  if (self->img_awaiting_data)
+    {
+      /* The frame was rejected while its body was still in flight; this
+       * read merely drained it. Start over with a fresh frame. */
+      start_striped_image_transfer (self);
+      return;
+    }
+
+  memcpy ((guint8 *) self->img_data + IMAGE_STRIPE1_SIZE,
+          transfer->buffer, transfer->actual_length);
+  self->img_data_actual_length += transfer->actual_length;
+
+  /* The imaging loop parks in IMAGING_DECODE or IMAGING_REPORT_IMAGE
+   * when it gets there before the body; wake it up again. */
+  if (self->img_awaiting_body)
+    {
+      self->img_awaiting_body = FALSE;
+      fpi_ssm_jump_to_state (self->img_ssm,
+                             fpi_ssm_get_cur_state (self->img_ssm));
+    }
+}
+
+static void
+image_stripe1_cb (FpiUsbTransfer *transfer, FpDevice *dev,
+                  gpointer user_data, GError *error)
+{
+  FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
+  struct uru4k_image *img;
+  FpiUsbTransfer *body;
+
+  if (self->img_ssm == NULL)
+    {
+      self->img_transfer_pending = FALSE;
+      g_clear_error (&error);
+      return;
+    }
+
+  if (error)
+    {
+      self->img_transfer_pending = FALSE;
+      self->img_awaiting_data = FALSE;
+      fpi_ssm_mark_failed (self->img_ssm, error);
+      return;
+    }
+
+  self->img_awaiting_data = FALSE;
+  g_free (self->img_data);
+  self->img_data = g_malloc0 (sizeof (struct uru4k_image));
+  memcpy (self->img_data, transfer->buffer, transfer->actual_length);
+  self->img_data_actual_length = transfer->actual_length;
+
+  img = self->img_data;
+  if (transfer->actual_length < IMAGE_STRIPE1_SIZE ||
+      img->num_lines * IMAGE_WIDTH + 64 <= transfer->actual_length)
+    {
+      /* Short or header-only frame; nothing more will follow. The
+       * length checks in the imaging loop sort out whether it is any
+       * good. */
+      self->img_transfer_pending = FALSE;
+      fpi_ssm_next_state (self->img_ssm);
+      return;
     }
+
+  /* Read the rest of the frame while the scramble-key register exchange
+   * runs; the decode states wait for it if it has not landed by then. */
+  self->img_body_pending = TRUE;
+  body = fpi_usb_transfer_new (dev);
+  body->ssm = self->img_ssm;
+  body->short_is_error = FALSE;
+  fpi_usb_transfer_fill_bulk (body, EP_DATA,
+                              sizeof (struct uru4k_image) - IMAGE_STRIPE1_SIZE);
+  fpi_usb_transfer_submit (body, 0, self->img_cancellable,
+                           image_body_cb, NULL);
+  fpi_ssm_next_state (self->img_ssm);
+}
+
+/* Foreground capture: the imaging loop is blocked on this frame, so read
+ * it in two stripes. The header stripe is enough to start the key
+ * exchange, which then overlaps the transfer of the frame body instead
+ * of running strictly after it. */
+static void
+start_striped_image_transfer (FpiDeviceUru4000 *self)
+{
+  FpiUsbTransfer *transfer;
+
+  self->img_transfer_pending = TRUE;
+  transfer = fpi_usb_transfer_new (FP_DEVICE (self));
+  transfer->ssm = self->img_ssm;
+  transfer->short_is_error = FALSE;
+  fpi_usb_transfer_fill_bulk (transfer, EP_DATA, IMAGE_STRIPE1_SIZE);
+  fpi_usb_transfer_submit (transfer, 0, self->img_cancellable,
+                           image_stripe1_cb, NULL);
 }
 
 enum {
@@ -656,11 +826,20 @@ imaging_run_state (FpiSsm *ssm, FpDevice *_dev)
     case IMAGING_CAPTURE:
       self->img_lines_done = 0;
       self->img_block = 0;
-      fpi_usb_transfer_submit (fpi_usb_transfer_ref (self->img_transfer),
-                               0,
-                               NULL,
-                               image_transfer_cb,
-                               NULL);
+      if (self->img_next_data)
+        {
+          /* The next frame arrived while the previous one was decoded. */
+          g_free (self->img_data);
+          self->img_data = g_steal_pointer (&self->img_next_data);
+          self->img_data_actual_length = self->img_next_data_actual_length;
+          fpi_ssm_next_state (ssm);
+        }
+      else
+        {
+          self->img_awaiting_data = TRUE;
+          if (!self->img_transfer_pending)
+            start_striped_image_transfer (self);
+        }
 
       break;
 
@@ -668,7 +847,8 @@ imaging_run_state (FpiSsm *ssm, FpDevice *_dev)
       fp_dbg ("hw header lines %d", img->num_lines);
 
       if (img->num_lines >= IMAGE_HEIGHT ||
-          self->img_data_actual_length < img->num_lines * IMAGE_WIDTH + 64)
+          (!self->img_body_pending &&
+           self->img_data_actual_length < img->num_lines * IMAGE_WIDTH + 64))
         {
           fp_err ("bad captured image (%d lines) or size mismatch %d < %d",
                   img->num_lines,
@@ -701,6 +881,37 @@ imaging_run_state (FpiSsm *ssm, FpDevice *_dev)
       break;
 
     case IMAGING_DECODE:
+      if (self->img_body_pending)
+        {
+          self->img_awaiting_body = TRUE;
+          return;
+        }
+      if (self->img_data_actual_length < img->num_lines * IMAGE_WIDTH + 64)
+        {
+          fp_err ("bad captured image, size mismatch %d < %d",
+                  self->img_data_actual_length,
+                  img->num_lines * IMAGE_WIDTH + 64);
+          fpi_ssm_jump_to_state (ssm, IMAGING_CAPTURE);
+          return;
+        }
+
+      /* Start reading the next frame now, so the bulk transfer overlaps
+       * with the decode work below. Hold off while this frame still asks
+       * for a key change; the new scramble seed must reach the device
+       * before it captures with it. */
+      if (self->activate_state == FPI_IMAGE_DEVICE_STATE_CAPTURE &&
+          !self->img_transfer_pending && !self->img_next_data)
+        {
+          gboolean key_change = FALSE;
+
+          for (i = 0; i < G_N_ELEMENTS (img->block_info); i++)
+            if (img->block_info[i].flags & BLOCKF_CHANGE_KEY)
+              key_change = TRUE;
+
+          if (!key_change)
+            start_image_transfer (self);
+        }
+
       key  = self->last_reg_rd[0];
       key |= self->last_reg_rd[1] << 8;
       key |= self->last_reg_rd[2] << 16;
@@ -750,6 +961,12 @@ imaging_run_state (FpiSsm *ssm, FpDevice *_dev)
       break;
 
     case IMAGING_REPORT_IMAGE:
+      if (self->img_body_pending)
+        {
+          self->img_awaiting_body = TRUE;
+          return;
+        }
+
       fpimg = fp_image_new (IMAGE_WIDTH, IMAGE_HEIGHT);
 
       to = r = 0;
@@ -797,11 +1014,23 @@ imaging_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
   if (error)
     fpi_image_device_session_error (FP_IMAGE_DEVICE (dev), error);
 
+  /* A prefetched capture may still be in flight; cancel it. Its callback
+   * sees img_ssm == NULL and drops the result. */
+  self->img_ssm = NULL;
+  self->img_awaiting_data = FALSE;
+  self->img_awaiting_body = FALSE;
+  self->img_body_pending = FALSE;
+  if (self->img_cancellable)
+    g_cancellable_cancel (self->img_cancellable);
+  g_clear_object (&self->img_cancellable);
+
   g_clear_pointer (&self->img_transfer, fpi_usb_transfer_unref);
 
   g_free (self->img_data);
   self->img_data = NULL;
   self->img_data_actual_length = 0;
+  g_clear_pointer (&self->img_next_data, g_free);
+  self->img_next_data_actual_length = 0;
 
   execute_state_change (FP_IMAGE_DEVICE (dev));
 }
@@ -1078,6 +1307,19 @@ init_run_state (FpiSsm *ssm, FpDevice *_dev)
       break;
 
     case INIT_CHECK_HWSTAT_POWERDOWN:
+      /* If the previous session on this device completed initialization
+       * and the reader still reports scan power (bit 7 clear), its
+       * firmware and key state persisted across the reopen; skip the
+       * power cycle, and with it the challenge/response renegotiation on
+       * auth_cr devices. A failed session clears fast_open_ok so the
+       * next activation runs the full sequence again. */
+      if (self->fast_open_ok && (self->last_hwstat & 0x80) == 0)
+        {
+          fp_dbg ("device still powered from previous session, fast open");
+          fpi_ssm_jump_to_state (ssm, INIT_DONE);
+          break;
+        }
+
       if ((self->last_hwstat & 0x80) == 0)
         sm_set_hwstat (ssm, dev, self->last_hwstat | 0x80);
       else
@@ -1145,6 +1387,7 @@ init_run_state (FpiSsm *ssm, FpDevice *_dev)
 static void
 activate_initsm_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
 {
+  FPI_DEVICE_URU4000 (dev)->fast_open_ok = (error == NULL);
   fpi_image_device_activate_complete (FP_IMAGE_DEVICE (dev), error);
 }
 
@@ -1223,6 +1466,8 @@ execute_state_change (FpImageDevice *dev)
                          IMAGING_NUM_STATES);
       self->img_enc_seed = g_rand_int_range (self->rand, 0, RAND_MAX);
       fp_dbg ("Image encryption seed: %d", self->img_enc_seed);
+      self->img_ssm = ssm;
+      self->img_cancellable = g_cancellable_new ();
       self->img_transfer = fpi_usb_transfer_new (FP_DEVICE (dev));
       self->img_transfer->ssm = ssm;
       self->img_transfer->short_is_error = FALSE;
@@ -1367,7 +1612,15 @@ dev_init (FpImageDevice *dev)
   self->profile = &uru4k_dev_info[driver_data];
   self->interface = g_usb_interface_get_number (iface);
 
-  /* Set up encryption */
+  /* Set up encryption; the NSS objects are host-side state, so reuse
+   * them across reopens instead of rebuilding the cipher context on
+   * every open. */
+  if (self->cipher_ctx != NULL)
+    {
+      fpi_image_device_open_complete (dev, NULL);
+      return;
+    }
+
   self->cipher = CKM_AES_ECB;
   self->slot = PK11_GetBestSlot (self->cipher, NULL);
   if (self->slot == NULL)
@@ -1398,6 +1651,23 @@ dev_init (FpImageDevice *dev)
     }
   self->param = PK11_ParamFromIV (self->cipher, NULL);
 
+  self->cipher_ctx = PK11_CreateContextBySymKey (self->cipher, CKA_ENCRYPT,
+                                                 self->symkey, self->param);
+  if (self->cipher_ctx == NULL)
+    {
+      fp_err ("failed to create NSS cipher context");
+      PK11_FreeSymKey (self->symkey);
+      self->symkey = NULL;
+      SECITEM_FreeItem (self->param, PR_TRUE);
+      self->param = NULL;
+      PK11_FreeSlot (self->slot);
+      self->slot = NULL;
+      fpi_image_device_open_complete (dev,
+                                      fpi_device_error_new_msg (FP_DEVICE_ERROR_GENERAL,
+                                                                "Failed to create NSS cipher context"));
+      return;
+    }
+
   fpi_image_device_open_complete (dev, NULL);
 }
 
@@ -1407,12 +1677,8 @@ dev_deinit (FpImageDevice *dev)
   GError *error = NULL;
   FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (dev);
 
-  if (self->symkey)
-    PK11_FreeSymKey (self->symkey);
-  if (self->param)
-    SECITEM_FreeItem (self->param, PR_TRUE);
-  if (self->slot)
-    PK11_FreeSlot (self->slot);
+  /* NSS objects are kept for reuse on reopen; they are released when the
+   * device object is finalized. */
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (dev)),
                                   self->interface, 0, &error);
   g_clear_pointer (&self->rand, g_rand_free);
@@ -1450,12 +1716,32 @@ fpi_device_uru4000_init (FpiDeviceUru4000 *self)
 {
 }
 
+static void
+fpi_device_uru4000_finalize (GObject *object)
+{
+  FpiDeviceUru4000 *self = FPI_DEVICE_URU4000 (object);
+
+  if (self->cipher_ctx)
+    PK11_DestroyContext (self->cipher_ctx, PR_TRUE);
+  if (self->symkey)
+    PK11_FreeSymKey (self->symkey);
+  if (self->param)
+    SECITEM_FreeItem (self->param, PR_TRUE);
+  if (self->slot)
+    PK11_FreeSlot (self->slot);
+
+  G_OBJECT_CLASS (fpi_device_uru4000_parent_class)->finalize (object);
+}
+
 static void
 fpi_device_uru4000_class_init (FpiDeviceUru4000Class *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   FpDeviceClass *dev_class = FP_DEVICE_CLASS (klass);
   FpImageDeviceClass *img_class = FP_IMAGE_DEVICE_CLASS (klass);
 
+  object_class->finalize = fpi_device_uru4000_finalize;
+
   dev_class->id = "uru4000";
   dev_class->full_name = "Digital Persona U.are.U 4000/4000B/4500";
   dev_class->type = FP_DEVICE_TYPE_USB;
@@ -37,12 +37,19 @@
 #define NR_REQS (IMG_HEIGHT / ROWS_PER_RQ)
 #define RQ_SIZE (IMG_WIDTH * ROWS_PER_RQ)
 #define IMG_SIZE (IMG_WIDTH * IMG_HEIGHT)
+/* Number of line-group reads kept in flight. Queued bulk URBs are
+ * filled strictly in submission order, so every read still lands in its
+ * own slice of the image, but the sensor streams at its native line
+ * rate instead of waiting out a host round trip per group. */
+#define CAPTURE_QUEUE_DEPTH 4
 
 struct _FpDeviceVcom5s
 {
   FpImageDevice parent;
 
-  int           capture_iteration;
+  int           capture_submitted;
+  int           capture_completed;
+  GError       *capture_error;
   FpImage      *capture_img;
   gboolean      loop_running;
   gboolean      deactivating;
@@ -163,13 +170,33 @@ capture_cb (FpiUsbTransfer *transfer, FpDevice *device,
   FpImageDevice *imgdev = FP_IMAGE_DEVICE (device);
   FpDeviceVcom5s *self = FPI_DEVICE_VCOM5S (device);
 
+  self->capture_completed++;
+
   if (error)
     {
-      fpi_ssm_mark_failed (transfer->ssm, error);
+      if (self->capture_error)
+        g_error_free (error);
+      else
+        self->capture_error = error;
+    }
+  else if (!self->capture_error && self->capture_submitted < NR_REQS)
+    {
+      capture_iterate (transfer->ssm, device);
+    }
+
+  /* Conclude only once every in-flight read has landed, so no late
+   * completion can write into a buffer that is already gone. */
+  if (self->capture_completed < self->capture_submitted)
+    return;
+
+  if (self->capture_error)
+    {
+      fpi_ssm_mark_failed (transfer->ssm,
+                           g_steal_pointer (&self->capture_error));
       return;
     }
 
-  if (++self->capture_iteration == NR_REQS)
+  if (self->capture_completed == NR_REQS)
     {
       FpImage *img = self->capture_img;
       /* must clear this early, otherwise the call chain takes us into
@@ -182,10 +209,6 @@ capture_cb (FpiUsbTransfer *transfer, FpDevice *device,
       fpi_image_device_image_captured (imgdev, img);
       fpi_ssm_next_state (transfer->ssm);
     }
-  else
-    {
-      capture_iterate (transfer->ssm, device);
-    }
 }
 
 static void
@@ -193,7 +216,7 @@ capture_iterate (FpiSsm   *ssm,
                  FpDevice *dev)
 {
   FpDeviceVcom5s *self = FPI_DEVICE_VCOM5S (dev);
-  int iteration = self->capture_iteration;
+  int iteration = self->capture_submitted++;
   FpiUsbTransfer *transfer = fpi_usb_transfer_new (FP_DEVICE (dev));
 
   transfer->ssm = ssm;
@@ -215,10 +238,15 @@ sm_do_capture (FpiSsm   *ssm,
   FpDeviceVcom5s *self = FPI_DEVICE_VCOM5S (dev);
   FpImageDeviceClass *cls = FP_IMAGE_DEVICE_GET_CLASS (dev);
 
+  int i;
+
   G_DEBUG_HERE ();
   self->capture_img = fp_image_new (cls->img_width, cls->img_height);
-  self->capture_iteration = 0;
-  capture_iterate (ssm, dev);
+  self->capture_submitted = 0;
+  self->capture_completed = 0;
+  g_clear_error (&self->capture_error);
+  for (i = 0; i < MIN (CAPTURE_QUEUE_DEPTH, NR_REQS); i++)
+    capture_iterate (ssm, dev);
 }
 
 /***** CAPTURE LOOP *****/
@@ -280,6 +308,7 @@ loopsm_complete (FpiSsm *ssm, FpDevice *dev, GError *error)
 
   g_object_unref (self->capture_img);
   self->capture_img = NULL;
+  g_clear_error (&self->capture_error);
   self->loop_running = FALSE;
 
   if (error && !self->deactivating)
@@ -398,38 +398,44 @@ clear_data (FpDeviceVfs0050 *vdev)
   vdev->memory = vdev->bytes = 0;
 }
 
+/* Number of interrupt URBs kept parked on EP3 while waiting for a
+ * finger, so an event arriving while a completion is being handled is
+ * not dropped. */
+#define VFS_IRQ_PREQUEUED 2
+
 /* After receiving interrupt from EP3 */
 static void
-interrupt_callback (FpiUsbTransfer *transfer, FpDevice *device,
-                    gpointer user_data, GError *error)
+interrupt_stream_cb (FpiUsbTransferStream *stream, FpDevice *device,
+                     FpiUsbTransfer *transfer, gpointer user_data,
+                     GError *error)
 {
   FpDeviceVfs0050 *self = FPI_DEVICE_VFS0050 (device);
-  unsigned char *interrupt = transfer->buffer;
-
-  /* we expect a cancellation error when the device is deactivating
-   * go into the SSM_CLEAR_EP2 state in that case. */
-  if (!self->active && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-    {
-      g_error_free (error);
-      fpi_ssm_jump_to_state (transfer->ssm, SSM_CLEAR_EP2);
-      return;
-    }
+  FpiSsm *ssm = user_data;
+  unsigned char *interrupt;
 
+  /* Deactivation stops the stream instead of erroring it, so anything
+   * surfacing here is a real transport problem. */
   if (error)
     {
       fp_err ("USB read interrupt transfer: %s",
               error->message);
-      fpi_ssm_mark_failed (transfer->ssm, error);
+      fpi_usb_transfer_stream_stop (g_steal_pointer (&self->irq_stream),
+                                    NULL, NULL);
+      fpi_ssm_mark_failed (ssm, error);
       return;
     }
 
+  interrupt = transfer->buffer;
+  fpi_usb_transfer_stream_stop (g_steal_pointer (&self->irq_stream),
+                                NULL, NULL);
+
   /* Standard interrupts */
   if (memcmp (interrupt, interrupt1, VFS_INTERRUPT_SIZE) == 0 ||
       memcmp (interrupt, interrupt2, VFS_INTERRUPT_SIZE) == 0 ||
       memcmp (interrupt, interrupt3, VFS_INTERRUPT_SIZE) == 0)
     {
       /* Go to the next ssm stage */
-      fpi_ssm_next_state (transfer->ssm);
+      fpi_ssm_next_state (ssm);
       return;
     }
 
@@ -439,7 +445,7 @@ interrupt_callback (FpiUsbTransfer *transfer, FpDevice *device,
       fp_warn ("Finger is already on the scanner");
 
       /* Go to the next ssm stage */
-      fpi_ssm_next_state (transfer->ssm);
+      fpi_ssm_next_state (ssm);
       return;
     }
 
@@ -449,7 +455,7 @@ interrupt_callback (FpiUsbTransfer *transfer, FpDevice *device,
           interrupt[3] & 0xff, interrupt[4] & 0xff);
 
   /* Abort ssm */
-  fpi_ssm_mark_failed (transfer->ssm,
+  fpi_ssm_mark_failed (ssm,
                        fpi_device_error_new (FP_DEVICE_ERROR_PROTO));
 }
 
@@ -536,41 +542,37 @@ activate_ssm (FpiSsm *ssm, FpDevice *dev)
       send_control_packet (ssm, dev);
       break;
 
-    case SSM_ASK_INTERRUPT: {
-        FpiUsbTransfer *transfer;
-        /* Activated, light must be blinking now */
-
-        /* If we first time here, report that activate completed */
-        if (self->need_report)
-          {
-            fpi_image_device_activate_complete (idev, NULL);
-            self->need_report = 0;
-          }
+    case SSM_ASK_INTERRUPT:
+      /* Activated, light must be blinking now */
 
-        /* Asynchronously enquire an interrupt */
-        transfer = fpi_usb_transfer_new (dev);
-        transfer->ssm = ssm;
-        transfer->short_is_error = TRUE;
-        fpi_usb_transfer_fill_interrupt (transfer, 0x83, VFS_INTERRUPT_SIZE);
-        fpi_usb_transfer_submit (transfer,
-                                 0,
-                                 fpi_device_get_cancellable (dev),
-                                 interrupt_callback, NULL);
+      /* If we first time here, report that activate completed */
+      if (self->need_report)
+        {
+          fpi_image_device_activate_complete (idev, NULL);
+          self->need_report = 0;
+        }
 
-        /* I've put it here to be sure that data is cleared */
-        clear_data (self);
+      /* Park interrupt transfers on EP3; the SSM sleeps in
+       * SSM_WAIT_INTERRUPT with no bus or CPU activity until the
+       * sensor reports a finger. */
+      g_assert (self->irq_stream == NULL);
+      self->irq_stream = fpi_usb_transfer_stream_start (dev,
+                                                        EP3_IN,
+                                                        VFS_INTERRUPT_SIZE,
+                                                        VFS_IRQ_PREQUEUED,
+                                                        interrupt_stream_cb,
+                                                        ssm);
+
+      /* I've put it here to be sure that data is cleared */
+      clear_data (self);
 
-        fpi_ssm_next_state (ssm);
-        break;
-      }
+      fpi_ssm_next_state (ssm);
+      break;
 
     case SSM_WAIT_INTERRUPT:
-      /* TODO: This state is unused at this point. When we
-       *       are in this state, then a user cancellation will
-       *       cause deactivation. In that case, the USB transfer
-       *       is cancelled and the device is set to not be active.
-       *       We then go into SSM_CLEAR_EP2 based on the
-       *       cancellation. */
+      /* Parked on the interrupt stream. interrupt_stream_cb() resumes
+       * the SSM when the sensor reports a finger; dev_deactivate()
+       * stops the stream and resumes it at SSM_CLEAR_EP2. */
       break;
 
     case SSM_RECEIVE_FINGER: {
@@ -650,6 +652,13 @@ dev_activate_callback (FpiSsm *ssm, FpDevice *dev, GError *error)
   FpDeviceVfs0050 *self = FPI_DEVICE_VFS0050 (dev);
 
   self->ssm_active = 0;
+  self->ssm = NULL;
+
+  /* The stream is stopped before the SSM is resumed, so it can only
+   * still exist here if the SSM failed from another source. */
+  if (self->irq_stream)
+    fpi_usb_transfer_stream_stop (g_steal_pointer (&self->irq_stream),
+                                  NULL, NULL);
 
   if (error)
     {
@@ -670,9 +679,19 @@ dev_activate (FpImageDevice *idev)
   self->need_report = 1;
   self->ssm_active = 1;
 
-  FpiSsm *ssm = fpi_ssm_new (FP_DEVICE (idev), activate_ssm, SSM_STATES);
+  self->ssm = fpi_ssm_new (FP_DEVICE (idev), activate_ssm, SSM_STATES);
 
-  fpi_ssm_start (ssm, dev_activate_callback);
+  fpi_ssm_start (self->ssm, dev_activate_callback);
+}
+
+/* Resumes the SSM on the teardown path once the parked interrupt
+ * transfers have drained after deactivation. */
+static void
+irq_stream_stopped_cb (FpDevice *dev, gpointer user_data)
+{
+  FpiSsm *ssm = user_data;
+
+  fpi_ssm_jump_to_state (ssm, SSM_CLEAR_EP2);
 }
 
 /* Deactivate device */
@@ -690,6 +709,13 @@ dev_deactivate (FpImageDevice *idev)
   /* Initialize flags */
   self->active = 0;
   self->need_report = 1;
+
+  /* If the SSM is parked waiting for a finger, stop the interrupt
+   * stream and resume it on the teardown path. In every other state
+   * the SSM checks self->active itself at the next boundary. */
+  if (self->irq_stream)
+    fpi_usb_transfer_stream_stop (g_steal_pointer (&self->irq_stream),
+                                  irq_stream_stopped_cb, self->ssm);
 }
 
 /* Callback for dev_open ssm */
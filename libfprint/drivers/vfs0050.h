@@ -92,6 +92,12 @@ struct _FpDeviceVfs0050
   /* For dev_deactivate to check whether ssm still running or not */
   char ssm_active;
 
+  /* The running activation ssm, for dev_deactivate to resume it */
+  FpiSsm *ssm;
+
+  /* Interrupt transfers parked on EP3 while waiting for a finger */
+  FpiUsbTransferStream *irq_stream;
+
   /* Should we call fpi_imgdev_activate_complete or fpi_imgdev_deactivate_complete */
   char need_report;
 
@@ -47,6 +47,9 @@
 /* Minimum image height */
 #define VFS_IMG_MIN_HEIGHT 200
 
+/* Minimum capture window in lines */
+#define VFS_IMG_WINDOW_MIN 600
+
 /* Scan level threshold */
 #define VFS_IMG_SLT_BEGIN 768
 #define VFS_IMG_SLT_END 64
@@ -122,6 +125,9 @@ struct _FpDeviceVfs101
 
   /* Image height */
   int height;
+
+  /* Capture window in lines */
+  int window;
 };
 G_DECLARE_FINAL_TYPE (FpDeviceVfs101, fpi_device_vfs101, FPI, DEVICE_VFS101,
                       FpImageDevice);
@@ -641,10 +647,20 @@ img_extract (FpiSsm        *ssm,
 {
   FpDeviceVfs101 *self = FPI_DEVICE_VFS101 (dev);
   FpImage *img;
+  int raw_height = self->height;
 
   /* Screen image to remove noise and find top and bottom line */
   img_screen (self);
 
+  /* Adapt the capture window from this presentation: the next get print
+   * requests roughly twice the lines the fingerprint band occupied,
+   * instead of streaming the whole reader buffer. A swipe that fills
+   * the current window falls back to the full buffer. */
+  if (raw_height >= self->window)
+    self->window = VFS_BUFFER_HEIGHT;
+  else if (self->height >= VFS_IMG_MIN_HEIGHT)
+    self->window = CLAMP (2 * self->height, VFS_IMG_WINDOW_MIN, VFS_BUFFER_HEIGHT);
+
   /* Check image height */
   if (self->height < VFS_IMG_MIN_HEIGHT)
     {
@@ -780,12 +796,12 @@ m_loop_state (FpiSsm *ssm, FpDevice *_dev)
     {
     case M_LOOP_0_GET_PRINT:
       /* Send get print command to the reader */
-      vfs_get_print (ssm, dev, VFS_BUFFER_HEIGHT, 1);
+      vfs_get_print (ssm, dev, self->window, 1);
       break;
 
     case M_LOOP_0_SLEEP:
-      /* Wait fingerprint scanning */
-      fpi_ssm_next_state_delayed (ssm, 50);
+      /* Wait fingerprint scanning; poll less often when throttling */
+      fpi_ssm_next_state_delayed (ssm, fpi_device_should_throttle (_dev) ? 200 : 50);
       break;
 
     case M_LOOP_0_GET_STATE:
@@ -865,7 +881,7 @@ m_loop_state (FpiSsm *ssm, FpDevice *_dev)
 
     case M_LOOP_1_GET_PRINT:
       /* Send get print command to the reader */
-      vfs_get_print (ssm, dev, VFS_BUFFER_HEIGHT, 1);
+      vfs_get_print (ssm, dev, self->window, 1);
       break;
 
     case M_LOOP_1_LOAD_IMAGE:
@@ -1277,6 +1293,9 @@ dev_activate (FpImageDevice *dev)
   /* Reset loop counter */
   self->counter = 0;
 
+  /* Start with the full capture window */
+  self->window = VFS_BUFFER_HEIGHT;
+
   /* Start init ssm */
   ssm = fpi_ssm_new (FP_DEVICE (dev), m_init_state, M_INIT_NUM_STATES);
   fpi_ssm_start (ssm, m_init_complete);
@@ -121,6 +121,83 @@ usb_send (FpDeviceVfs301 *dev, const guint8 *data, gssize length, GError **error
     }
 }
 
+static void
+usb_pipelined_cb (FpiUsbTransfer *transfer,
+                  FpDevice       *device,
+                  gpointer        user_data,
+                  GError         *error)
+{
+  int *pending = user_data;
+
+  (*pending)--;
+
+  /* XXX: Swallows transfer errors just like usb_send()/usb_recv(). */
+  if (error)
+    {
+      g_warning ("Error in pipelined transfer, continuing anyway: %s",
+                 error->message);
+      g_error_free (error);
+    }
+}
+
+/* Send a command and read the device's expected response with both
+ * transfers in flight at once: the response URB is already queued when
+ * the device answers, saving the host round trip between the write
+ * completing and the read being submitted. The protocol stays in
+ * lockstep, commands are never reordered. @free_func may be %NULL for
+ * static data such as the init fragments, avoiding the copy. */
+FP_GNUC_ACCESS (read_only, 2, 3)
+static void
+usb_send_recv (FpDeviceVfs301 *dev,
+               const guint8   *data,
+               gssize          length,
+               GDestroyNotify  free_func,
+               guint8          recv_endpoint,
+               int             recv_len)
+{
+  g_autoptr(GMainContext) context = NULL;
+  FpiUsbTransfer *send, *recv;
+  int pending = 2;
+
+  /* umockdev replays the recorded ioctls strictly in order, so fall
+   * back to fully sequential submission under emulation. */
+  if (g_getenv ("FP_DEVICE_EMULATION"))
+    {
+      g_autoptr(FpiUsbTransfer) transfer = NULL;
+
+      transfer = fpi_usb_transfer_new (FP_DEVICE (dev));
+      transfer->short_is_error = TRUE;
+      fpi_usb_transfer_fill_bulk_full (transfer, VFS301_SEND_ENDPOINT,
+                                       (guint8 *) data, length, free_func);
+      if (!fpi_usb_transfer_submit_sync (transfer, VFS301_DEFAULT_WAIT_TIMEOUT, NULL))
+        g_warning ("Error while sending data, continuing anyway");
+
+      usb_recv (dev, recv_endpoint, recv_len, NULL, NULL);
+      return;
+    }
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  send = fpi_usb_transfer_new (FP_DEVICE (dev));
+  send->short_is_error = TRUE;
+  fpi_usb_transfer_fill_bulk_full (send, VFS301_SEND_ENDPOINT,
+                                   (guint8 *) data, length, free_func);
+  fpi_usb_transfer_submit (send, VFS301_DEFAULT_WAIT_TIMEOUT, NULL,
+                           usb_pipelined_cb, &pending);
+
+  recv = fpi_usb_transfer_new (FP_DEVICE (dev));
+  recv->short_is_error = TRUE;
+  fpi_usb_transfer_fill_bulk (recv, recv_endpoint, recv_len);
+  fpi_usb_transfer_submit (recv, VFS301_DEFAULT_WAIT_TIMEOUT, NULL,
+                           usb_pipelined_cb, &pending);
+
+  while (pending > 0)
+    g_main_context_iteration (context, TRUE);
+
+  g_main_context_pop_thread_default (context);
+}
+
 /************************** OUT MESSAGES GENERATION ***************************/
 
 static guint8 *
@@ -432,7 +509,19 @@ img_process_data (int first_block, FpDeviceVfs301 *dev, const guint8 *buf, int l
     usb_send (dev, data, len, NULL); \
   }
 
-#define RAW_DATA(x) g_memdup (x, sizeof (x)), sizeof (x)
+/* Generated command with its response read pipelined. */
+#define USB_SEND_RECV(type, subtype, ep, rlen) \
+  { \
+    const guint8 *data; \
+    gssize len; \
+    data = vfs301_proto_generate (type, subtype, &len); \
+    usb_send_recv (dev, data, len, g_free, ep, rlen); \
+  }
+
+/* Static init fragment with its response read pipelined; the fragment
+ * is sent in place without being copied. */
+#define RAW_SEND_RECV(x, ep, rlen) \
+  usb_send_recv (dev, x, sizeof (x), NULL, ep, rlen)
 
 #define IS_VFS301_FP_SEQ_START(b) ((b[0] == 0x01) && (b[1] == 0xfe))
 
@@ -603,86 +692,57 @@ vfs301_proto_process_event_poll (FpDeviceVfs301 *dev)
 void
 vfs301_proto_init (FpDeviceVfs301 *dev)
 {
-  USB_SEND (0x01, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 38);
-  USB_SEND (0x0B, 0x04);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 6);      /* 000000000000 */
-  USB_SEND (0x0B, 0x05);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 7);      /* 00000000000000 */
-  USB_SEND (0x19, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 64);
+  USB_SEND_RECV (0x01, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 38);
+  USB_SEND_RECV (0x0B, 0x04, VFS301_RECEIVE_ENDPOINT_CTRL, 6);      /* 000000000000 */
+  USB_SEND_RECV (0x0B, 0x05, VFS301_RECEIVE_ENDPOINT_CTRL, 7);      /* 00000000000000 */
+  USB_SEND_RECV (0x19, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 64);
   USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 4);      /* 6BB4D0BC */
-  usb_send (dev, RAW_DATA (vfs301_06_1), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-
-  USB_SEND (0x01, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 38);
-  USB_SEND (0x1A, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  usb_send (dev, RAW_DATA (vfs301_06_2), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  USB_SEND (0x0220, 1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_06_1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+
+  USB_SEND_RECV (0x01, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 38);
+  USB_SEND_RECV (0x1A, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_06_2, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x0220, 1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 256);
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 32);
 
-  USB_SEND (0x1A, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  usb_send (dev, RAW_DATA (vfs301_06_3), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x1A, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_06_3, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
 
-  USB_SEND (0x01, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 38);
-  USB_SEND (0x02D0, 1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x01, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 38);
+  USB_SEND_RECV (0x02D0, 1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 11648);      /* 56 * vfs301_init_line_t[] */
-  USB_SEND (0x02D0, 2);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x02D0, 2, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 53248);      /* 2 * 128 * vfs301_init_line_t[] */
-  USB_SEND (0x02D0, 3);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x02D0, 3, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 19968);      /* 96 * vfs301_init_line_t[] */
-  USB_SEND (0x02D0, 4);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x02D0, 4, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 5824);      /* 28 * vfs301_init_line_t[] */
-  USB_SEND (0x02D0, 5);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x02D0, 5, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 6656);      /* 32 * vfs301_init_line_t[] */
-  USB_SEND (0x02D0, 6);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x02D0, 6, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 6656);      /* 32 * vfs301_init_line_t[] */
-  USB_SEND (0x02D0, 7);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x02D0, 7, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 832);
-  usb_send (dev, RAW_DATA (vfs301_12), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_12, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
 
-  USB_SEND (0x1A, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  usb_send (dev, RAW_DATA (vfs301_06_2), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  USB_SEND_RECV (0x1A, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_06_2, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
   USB_SEND (0x0220, 2);
   PARALLEL_RECEIVE (
     VFS301_RECEIVE_ENDPOINT_CTRL, 2,             /* 0000 */
     VFS301_RECEIVE_ENDPOINT_DATA, 5760
                    );
 
-  USB_SEND (0x1A, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  usb_send (dev, RAW_DATA (vfs301_06_1), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-
-  USB_SEND (0x1A, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  usb_send (dev, RAW_DATA (vfs301_06_4), NULL);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-  usb_send (dev, RAW_DATA (vfs301_24), NULL);     /* turns on white */
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
-
-  USB_SEND (0x01, -1);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 38);
-  USB_SEND (0x0220, 3);
-  USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 2368);
+  USB_SEND_RECV (0x1A, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_06_1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+
+  USB_SEND_RECV (0x1A, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_06_4, VFS301_RECEIVE_ENDPOINT_CTRL, 2);      /* 0000 */
+  RAW_SEND_RECV (vfs301_24, VFS301_RECEIVE_ENDPOINT_CTRL, 2);     /* turns on white, 0000 */
+
+  USB_SEND_RECV (0x01, -1, VFS301_RECEIVE_ENDPOINT_CTRL, 38);
+  USB_SEND_RECV (0x0220, 3, VFS301_RECEIVE_ENDPOINT_CTRL, 2368);
   USB_RECV (VFS301_RECEIVE_ENDPOINT_CTRL, 36);
   USB_RECV (VFS301_RECEIVE_ENDPOINT_DATA, 5760);
 }
@@ -246,6 +246,13 @@ enum {
   CAPTURE_LINES = 256,
   MAXLINES = 2000,
   MAX_CAPTURE_LINES = 100000,
+  /* Moving-row coverage at which the swipe is terminated early: the
+   * print is fully represented well before the finger leaves the
+   * sensor on a deliberate slow swipe, and stopping here lets assembly
+   * and detection run while the finger is still lifting. Stationary
+   * repeats are not recorded, so this corresponds to physical swipe
+   * length, not swipe time. MAXLINES stays as the hard cap. */
+  SUFFICIENT_LINES = 700,
 };
 
 static struct fpi_line_asmbl_ctx assembling_ctx = {
@@ -364,6 +371,12 @@ process_chunk (FpDeviceVfs5011 *self, int transferred)
                                         self->lastline);
           memmove (self->lastline, linebuf, VFS5011_LINE_SIZE);
           self->lines_recorded++;
+          if (self->lines_recorded >= SUFFICIENT_LINES)
+            {
+              fp_dbg ("process_chunk: %d moving lines banked, stopping early",
+                      self->lines_recorded);
+              return 1;
+            }
           if (self->lines_recorded >= self->max_lines_recorded)
             {
               fp_dbg ("process_chunk: recorded %d lines, finishing",
@@ -103,8 +103,10 @@ struct _FpDeviceVfs7552
   FpiImageDeviceState     dev_state_next;
   gboolean                background_captured;
   unsigned char           background[VFS7552_IMAGE_SIZE];
-  unsigned char           image[VFS7552_IMAGE_SIZE];
+  /* heap allocated so ownership can be handed to the FpImage */
+  unsigned char          *image;
   gint                    lines_captured;
+  FpiVarianceCache        variance_cache;
 
   gboolean                deactivating;
   gboolean                loop_running;
@@ -573,7 +575,8 @@ capture_run_state (FpiSsm *ssm, FpDevice *_dev)
       if (!self->background_captured)
         {
           // Calculate the variance of the captured image
-          variance_before = fpi_std_sq_dev (self->image, VFS7552_IMAGE_SIZE);
+          variance_before = fpi_std_sq_dev_cached (self->image, VFS7552_IMAGE_SIZE,
+                                                   &self->variance_cache);
           fp_dbg ("variance_before = %d\n", variance_before);
           self->background_captured = TRUE;
           memcpy (self->background, self->image, VFS7552_IMAGE_SIZE);
@@ -583,7 +586,8 @@ capture_run_state (FpiSsm *ssm, FpDevice *_dev)
         }
 
       clean_image (self);
-      variance_after = fpi_std_sq_dev (self->image, VFS7552_IMAGE_SIZE);
+      variance_after = fpi_std_sq_dev_cached (self->image, VFS7552_IMAGE_SIZE,
+                                              &self->variance_cache);
       fp_dbg ("variance_after = %d\n", variance_after);
 
       if (self->dev_state == FPI_IMAGE_DEVICE_STATE_CAPTURE ||
@@ -772,24 +776,19 @@ capture_complete (FpiSsm *ssm, FpDevice *_dev, GError *error)
   if (!self->deactivating && !error)
     {
       FpImage *img;
-      img = fp_image_new (2 * VFS7552_IMAGE_WIDTH,
-                          2 * VFS7552_IMAGE_HEIGHT);
-      // Scale the image
-      for (int j = 0; j < VFS7552_IMAGE_HEIGHT; j++)
-        {
-          for (int i = 0; i < VFS7552_IMAGE_WIDTH; i++)
-            {
-              int ref = j * VFS7552_IMAGE_WIDTH + i;
-              int ref_new = 4 * j * VFS7552_IMAGE_WIDTH + 2 * i;
-              img->data[ref_new] = self->image[ref];
-              img->data[ref_new + 1] = self->image[ref];
-              img->data[ref_new + 2 * VFS7552_IMAGE_WIDTH] = self->image[ref];
-              img->data[ref_new + 2 * VFS7552_IMAGE_WIDTH + 1] = self->image[ref];
-            }
-        }
+      FpImage *scaled;
+
+      // Hand the capture buffer to the image without copying and
+      // scale it up 2x for minutiae detection
+      img = fp_image_new_take (VFS7552_IMAGE_WIDTH,
+                               VFS7552_IMAGE_HEIGHT,
+                               g_steal_pointer (&self->image));
+      self->image = g_malloc0 (VFS7552_IMAGE_SIZE);
+      scaled = fpi_image_resize (img, 2, 2);
+      g_object_unref (img);
 
       fp_dbg ("Image captured");
-      fpi_image_device_image_captured (dev, img);
+      fpi_image_device_image_captured (dev, scaled);
     }
   self->loop_running = FALSE;
 
@@ -933,8 +932,11 @@ open_complete (FpiSsm *ssm, FpDevice *_dev, GError *error)
 static void
 dev_close (FpImageDevice *dev)
 {
+  FpDeviceVfs7552 *self = FPI_DEVICE_VFS7552 (dev);
   GError *error = NULL;
 
+  g_clear_pointer (&self->image, g_free);
+  fpi_variance_cache_clear (&self->variance_cache);
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (dev)),
                                   0, 0, &error);
 
@@ -1016,9 +1018,13 @@ dev_activate (FpImageDevice *dev)
 static void
 dev_open (FpImageDevice *dev)
 {
+  FpDeviceVfs7552 *self = FPI_DEVICE_VFS7552 (dev);
   FpiSsm *ssm;
   GError *error = NULL;
 
+  self->image = g_malloc0 (VFS7552_IMAGE_SIZE);
+  fpi_variance_cache_init (&self->variance_cache, VFS7552_IMAGE_SIZE);
+
   // First we need to reset the device, otherwise opening will fail at state 13
   if (!g_usb_device_reset (fpi_device_get_usb_device (FP_DEVICE (dev)), &error))
     {
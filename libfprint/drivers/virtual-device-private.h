@@ -80,6 +80,8 @@ struct _FpDeviceVirtualDevice
   guint                     wait_command_id;
   guint                     sleep_timeout_id;
   guint                     enroll_stages_passed;
+  guint                     op_latency_ms;
+  gboolean                  op_latency_applied;
   gboolean                  match_reported;
   gboolean                  supports_cancellation;
   gboolean                  injected_synthetic_cmd;
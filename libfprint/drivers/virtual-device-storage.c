@@ -33,8 +33,6 @@
 
 G_DEFINE_TYPE (FpDeviceVirtualDeviceStorage, fpi_device_virtual_device_storage, fpi_device_virtual_device_get_type ())
 
-static GPtrArray * get_stored_prints (FpDeviceVirtualDevice * self);
-
 static void
 dev_identify (FpDevice *dev)
 {
@@ -47,7 +45,6 @@ dev_identify (FpDevice *dev)
 
   if (scan_id)
     {
-      g_autoptr(GPtrArray) stored = get_stored_prints (self);
       GPtrArray *prints;
       GVariant *data = NULL;
       FpPrint *new_scan;
@@ -63,12 +60,11 @@ dev_identify (FpDevice *dev)
       fpi_device_get_identify_data (dev, &prints);
       g_debug ("Trying to identify print '%s' against a gallery of %u prints", scan_id, prints->len);
 
-      if (!g_ptr_array_find_with_equal_func (stored,
-                                             new_scan,
-                                             (GEqualFunc) fp_print_equal,
-                                             NULL))
+      /* The storage is keyed by the print ID, so look the scan up
+       * directly instead of materializing an FpPrint for every stored
+       * template; this keeps identification O(1) in the storage size. */
+      if (!g_hash_table_contains (self->prints_storage, scan_id))
         {
-          match = FALSE;
           g_clear_object (&new_scan);
         }
       else if (g_ptr_array_find_with_equal_func (prints,
@@ -46,6 +46,8 @@ G_DEFINE_TYPE (FpDeviceVirtualDevice, fpi_device_virtual_device, FP_TYPE_DEVICE)
 #define SET_SCAN_TYPE_PREFIX "SET_SCAN_TYPE "
 #define SET_CANCELLATION_PREFIX "SET_CANCELLATION_ENABLED "
 #define SET_KEEP_ALIVE_PREFIX "SET_KEEP_ALIVE "
+#define SET_LATENCY_PREFIX "SET_LATENCY "
+#define BULK_INSERT_CMD_PREFIX "BULK_INSERT "
 
 #define LIST_CMD "LIST"
 #define UNPLUG_CMD "UNPLUG"
@@ -111,10 +113,14 @@ sleep_timeout_cb (gpointer data)
   self->sleep_timeout_id = 0;
 
   if (g_cancellable_is_cancelled (self->cancellable))
-    return FALSE;
+    {
+      self->op_latency_applied = FALSE;
+      return FALSE;
+    }
 
   g_debug ("Sleeping completed");
   maybe_continue_current_action (self);
+  self->op_latency_applied = FALSE;
 
   return FALSE;
 }
@@ -161,6 +167,18 @@ process_cmds (FpDeviceVirtualDevice * self,
       return TRUE;
     }
 
+  /* Simulate the per-operation latency of a real match-on-chip sensor.
+   * The flag is reset once the resumed operation has run, so each
+   * (re)start of command processing pays the latency exactly once. */
+  if (self->op_latency_ms > 0 && !self->op_latency_applied)
+    {
+      g_debug ("Simulating operation latency of %ums", self->op_latency_ms);
+      self->op_latency_applied = TRUE;
+      self->sleep_timeout_id = g_timeout_add (self->op_latency_ms,
+                                              sleep_timeout_cb, self);
+      return FALSE;
+    }
+
   while (self->pending_commands->len > 0)
     {
       g_autofree gchar *cmd = NULL;
@@ -344,6 +362,33 @@ recv_instruction_cb (GObject      *source_object,
 
           g_debug ("Keep alive toggled: %d", self->keep_alive);
         }
+      else if (g_str_has_prefix (cmd, SET_LATENCY_PREFIX))
+        {
+          self->op_latency_ms = g_ascii_strtoull (
+            cmd + strlen (SET_LATENCY_PREFIX), NULL, 10);
+
+          g_debug ("Simulated operation latency set to %ums",
+                   self->op_latency_ms);
+        }
+      else if (g_str_has_prefix (cmd, BULK_INSERT_CMD_PREFIX))
+        {
+          g_auto(GStrv) args = NULL;
+          guint64 count, i;
+
+          args = g_strsplit (cmd + strlen (BULK_INSERT_CMD_PREFIX), " ", 2);
+          count = g_ascii_strtoull (args[0], NULL, 10);
+
+          g_assert (self->prints_storage);
+          g_assert (count > 0 && args[1] != NULL);
+
+          for (i = 0; i < count; i++)
+            g_hash_table_add (self->prints_storage,
+                              g_strdup_printf ("%s-%" G_GUINT64_FORMAT,
+                                               args[1], i));
+
+          g_debug ("Bulk-inserted %" G_GUINT64_FORMAT
+                   " prints with prefix '%s'", count, args[1]);
+        }
       else
         {
           g_ptr_array_add (self->pending_commands, g_steal_pointer (&cmd));
@@ -700,6 +745,7 @@ dev_cancel (FpDevice *dev)
   g_debug ("Got cancellation!");
   g_clear_handle_id (&self->sleep_timeout_id, g_source_remove);
   g_clear_handle_id (&self->wait_command_id, g_source_remove);
+  self->op_latency_applied = FALSE;
 
   maybe_continue_current_action (self);
 }
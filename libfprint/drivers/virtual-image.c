@@ -27,6 +27,13 @@
 
 #define FP_COMPONENT "virtual_image"
 
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "fpi-log.h"
 
 #include "virtual-device-private.h"
@@ -44,6 +51,24 @@ struct _FpDeviceVirtualImage
   gboolean                  automatic_finger;
   FpImage                  *recv_img;
   gint                      recv_img_hdr[2];
+
+  /* Shared-memory injection (-6/-7 commands): the client maps a ring of
+   * equally sized frames into a file and only sends slot indices over
+   * the socket. */
+  guint8                   *shm_map;
+  gsize                     shm_size;
+  guint                     shm_width;
+  guint                     shm_height;
+  guint                     shm_slots;
+  char                     *shm_ctrl;
+
+  /* Replay mode (FP_VIRTUAL_IMAGE_REPLAY), feeds a directory of images
+   * back-to-back without a client connection. */
+  GPtrArray                *replay_images;
+  guint                     replay_next;
+  guint                     replay_interval_ms;
+  gint64                    replay_inject_time;
+  GSource                  *replay_timeout;
 };
 
 G_DECLARE_FINAL_TYPE (FpDeviceVirtualImage, fpi_device_virtual_image, FPI, DEVICE_VIRTUAL_IMAGE, FpImageDevice)
@@ -81,6 +106,136 @@ recv_image_img_recv_cb (GObject      *source_object,
   recv_image (self);
 }
 
+/* Shared-memory injection: instead of streaming pixel data through the
+ * socket, a client can map a ring of frames and inject them by index.
+ * The -6 command carries the length of a "WIDTH HEIGHT NSLOTS PATH"
+ * control string which follows it; the named file (typically a memfd or
+ * a file on /dev/shm) is mapped read-only and must hold NSLOTS frames
+ * of WIDTH * HEIGHT bytes back-to-back. The -7 command then injects the
+ * frame in slot hdr[1] as a captured image. Only a header and a single
+ * in-process copy remain per image, which lets soak tests saturate the
+ * detection pipeline instead of being bounded by socket throughput. */
+
+static void
+shm_unmap (FpDeviceVirtualImage *self)
+{
+  if (self->shm_map)
+    munmap (self->shm_map, self->shm_size);
+  self->shm_map = NULL;
+  self->shm_size = 0;
+  self->shm_slots = 0;
+}
+
+static gboolean
+shm_map_ring (FpDeviceVirtualImage *self,
+              const char           *ctrl)
+{
+  guint width, height, nslots;
+  int offset = 0;
+  int fd;
+  struct stat st;
+  gsize size;
+  void *map;
+
+  if (sscanf (ctrl, "%u %u %u %n", &width, &height, &nslots, &offset) != 3 ||
+      offset == 0 || ctrl[offset] == '\0' ||
+      width == 0 || height == 0 || width > 5000 || height > 5000 ||
+      nslots == 0)
+    {
+      g_warning ("Malformed shared-memory ring description \"%s\"", ctrl);
+      return FALSE;
+    }
+
+  size = (gsize) nslots * width * height;
+
+  fd = open (ctrl + offset, O_RDONLY);
+  if (fd < 0)
+    {
+      g_warning ("Cannot open shared-memory ring %s", ctrl + offset);
+      return FALSE;
+    }
+
+  if (fstat (fd, &st) < 0 || (gsize) st.st_size < size)
+    {
+      g_warning ("Shared-memory ring %s is smaller than described", ctrl + offset);
+      close (fd);
+      return FALSE;
+    }
+
+  map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      g_warning ("Cannot map shared-memory ring %s", ctrl + offset);
+      return FALSE;
+    }
+
+  shm_unmap (self);
+  self->shm_map = map;
+  self->shm_size = size;
+  self->shm_width = width;
+  self->shm_height = height;
+  self->shm_slots = nslots;
+
+  g_debug ("Mapped %u frames of %ux%u from %s", nslots, width, height, ctrl + offset);
+
+  return TRUE;
+}
+
+static void
+shm_inject_slot (FpDeviceVirtualImage *self,
+                 guint                 slot)
+{
+  FpImageDevice *device = FP_IMAGE_DEVICE (self);
+  gsize frame_size;
+  FpImage *image;
+
+  if (!self->shm_map || slot >= self->shm_slots)
+    {
+      g_warning ("Shared-memory slot %u requested without a matching mapping", slot);
+      return;
+    }
+
+  frame_size = (gsize) self->shm_width * self->shm_height;
+
+  image = fp_image_new (self->shm_width, self->shm_height);
+  memcpy ((guint8 *) image->data,
+          self->shm_map + slot * frame_size,
+          frame_size);
+
+  if (self->automatic_finger)
+    fpi_image_device_report_finger_status (device, TRUE);
+  fpi_image_device_image_captured (device, image);
+  if (self->automatic_finger)
+    fpi_image_device_report_finger_status (device, FALSE);
+}
+
+static void
+recv_shm_ctrl_recv_cb (GObject      *source_object,
+                       GAsyncResult *res,
+                       gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+  FpiDeviceVirtualListener *listener = FPI_DEVICE_VIRTUAL_LISTENER (source_object);
+  FpDeviceVirtualImage *self;
+  gsize bytes;
+
+  bytes = fpi_device_virtual_listener_read_finish (listener, res, &error);
+
+  if (!bytes || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED))
+    return;
+
+  self = FPI_DEVICE_VIRTUAL_IMAGE (user_data);
+
+  if (!shm_map_ring (self, self->shm_ctrl))
+    fpi_device_virtual_listener_connection_close (listener);
+  g_clear_pointer (&self->shm_ctrl, g_free);
+
+  /* And, listen for more images from the same client. */
+  recv_image (self);
+}
+
 static void
 recv_image_hdr_recv_cb (GObject      *source_object,
                         GAsyncResult *res,
@@ -145,6 +300,28 @@ recv_image_hdr_recv_cb (GObject      *source_object,
           fpi_device_remove (FP_DEVICE (self));
           break;
 
+        case -6:
+          /* -6 maps a shared-memory frame ring; hdr[1] bytes of
+           * "WIDTH HEIGHT NSLOTS PATH" follow */
+          if (self->recv_img_hdr[1] <= 0 || self->recv_img_hdr[1] >= 4096)
+            {
+              fpi_device_virtual_listener_connection_close (listener);
+              break;
+            }
+          self->shm_ctrl = g_malloc0 (self->recv_img_hdr[1] + 1);
+          fpi_device_virtual_listener_read (listener,
+                                            TRUE,
+                                            self->shm_ctrl,
+                                            self->recv_img_hdr[1],
+                                            recv_shm_ctrl_recv_cb,
+                                            self);
+          return;
+
+        case -7:
+          /* -7 injects the frame in the given ring slot */
+          shm_inject_slot (self, self->recv_img_hdr[1]);
+          break;
+
         default:
           /* disconnect client, it didn't play fair */
           fpi_device_virtual_listener_connection_close (listener);
@@ -176,6 +353,157 @@ recv_image (FpDeviceVirtualImage *self)
                                     self);
 }
 
+/* Replay mode: setting FP_VIRTUAL_IMAGE_REPLAY to a directory of raw
+ * PGM (P5) images makes the device feed them round-robin whenever the
+ * image device waits for a finger, without any client connection. The
+ * injection delay between images is FP_VIRTUAL_IMAGE_REPLAY_INTERVAL
+ * milliseconds (default 10, i.e. up to 100 captures/sec), and the time
+ * from injection to deactivation is logged per image, so CI can
+ * soak-test the full image device pipeline at production rates. Build
+ * with -Dtracing=true for a per-stage breakdown of the same run. */
+
+static gint
+replay_cmp_paths (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const char **) a, *(const char **) b);
+}
+
+static FpImage *
+replay_load_pgm (const char *path, GError **error)
+{
+  g_autofree char *contents = NULL;
+  FpImage *image;
+  gsize length;
+  guint width, height, maxval;
+  int offset = 0;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  /* Comments in the header are not supported. */
+  if (sscanf (contents, "P5 %u %u %u%n", &width, &height, &maxval, &offset) != 3 ||
+      offset == 0 || maxval != 255 ||
+      width == 0 || height == 0 || width > 5000 || height > 5000 ||
+      (gsize) offset + 1 + (gsize) width * height > length)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Not an 8 bit binary PGM image");
+      return NULL;
+    }
+
+  image = fp_image_new (width, height);
+  memcpy ((guint8 *) image->data, contents + offset + 1, width * height);
+
+  return image;
+}
+
+static void
+replay_inject_cb (FpDevice *device, gpointer user_data)
+{
+  FpDeviceVirtualImage *self = FPI_DEVICE_VIRTUAL_IMAGE (device);
+  FpImage *image;
+
+  self->replay_timeout = NULL;
+
+  image = g_ptr_array_index (self->replay_images, self->replay_next);
+  self->replay_next = (self->replay_next + 1) % self->replay_images->len;
+
+  self->replay_inject_time = g_get_monotonic_time ();
+
+  fpi_image_device_report_finger_status (FP_IMAGE_DEVICE (self), TRUE);
+  fpi_image_device_image_captured (FP_IMAGE_DEVICE (self),
+                                   g_object_ref (image));
+  fpi_image_device_report_finger_status (FP_IMAGE_DEVICE (self), FALSE);
+}
+
+static void
+replay_state_changed_cb (FpImageDevice      *device,
+                         FpiImageDeviceState state,
+                         gpointer            user_data)
+{
+  FpDeviceVirtualImage *self = FPI_DEVICE_VIRTUAL_IMAGE (device);
+
+  /* Feed the next image whenever the device waits for a finger. */
+  if (state != FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON)
+    return;
+
+  if (self->replay_timeout)
+    return;
+
+  self->replay_timeout = fpi_device_add_timeout (FP_DEVICE (self),
+                                                 self->replay_interval_ms,
+                                                 replay_inject_cb,
+                                                 NULL, NULL);
+}
+
+static void
+replay_init (FpDeviceVirtualImage *self)
+{
+  g_autoptr(GDir) dir = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GPtrArray) paths = NULL;
+  g_autoptr(GPtrArray) images = NULL;
+  const char *dirname;
+  const char *interval;
+  const char *name;
+  guint i;
+
+  dirname = g_getenv ("FP_VIRTUAL_IMAGE_REPLAY");
+  if (!dirname)
+    return;
+
+  dir = g_dir_open (dirname, 0, &error);
+  if (!dir)
+    {
+      g_warning ("Cannot open replay directory: %s", error->message);
+      return;
+    }
+
+  paths = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (dir)))
+    if (g_str_has_suffix (name, ".pgm"))
+      g_ptr_array_add (paths, g_build_filename (dirname, name, NULL));
+  g_ptr_array_sort (paths, replay_cmp_paths);
+
+  images = g_ptr_array_new_with_free_func (g_object_unref);
+  for (i = 0; i < paths->len; i++)
+    {
+      const char *path = g_ptr_array_index (paths, i);
+      FpImage *image;
+      g_autoptr(GError) img_error = NULL;
+
+      image = replay_load_pgm (path, &img_error);
+      if (!image)
+        {
+          g_warning ("Cannot load replay image %s: %s",
+                     path, img_error->message);
+          continue;
+        }
+      g_ptr_array_add (images, image);
+    }
+
+  if (images->len == 0)
+    {
+      g_warning ("No usable images in replay directory %s", dirname);
+      return;
+    }
+
+  self->replay_interval_ms = 10;
+  interval = g_getenv ("FP_VIRTUAL_IMAGE_REPLAY_INTERVAL");
+  if (interval)
+    self->replay_interval_ms = MAX (1, (guint) g_ascii_strtoull (interval, NULL, 10));
+
+  self->replay_images = g_steal_pointer (&images);
+
+  g_signal_connect (self,
+                    "fpi-image-device-state-changed",
+                    G_CALLBACK (replay_state_changed_cb),
+                    NULL);
+
+  g_message ("Replaying %u images from %s every %u ms",
+             self->replay_images->len, dirname, self->replay_interval_ms);
+}
+
 static void
 on_listener_connected (FpiDeviceVirtualListener *listener,
                        gpointer                  user_data)
@@ -185,9 +513,7 @@ on_listener_connected (FpiDeviceVirtualListener *listener,
 
   self->automatic_finger = TRUE;
 
-  g_object_get (self,
-                "fpi-image-device-state", &state,
-                NULL);
+  state = fpi_image_device_get_state (FP_IMAGE_DEVICE (self));
 
   switch (state)
     {
@@ -215,6 +541,9 @@ dev_init (FpImageDevice *dev)
 
   G_DEBUG_HERE ();
 
+  if (!self->replay_images)
+    replay_init (self);
+
   listener = fpi_device_virtual_listener_new ();
   cancellable = g_cancellable_new ();
 
@@ -243,9 +572,12 @@ dev_deinit (FpImageDevice *dev)
 
   G_DEBUG_HERE ();
 
+  g_clear_pointer (&self->replay_timeout, g_source_destroy);
   g_cancellable_cancel (self->cancellable);
   g_clear_object (&self->cancellable);
   g_clear_object (&self->listener);
+  g_clear_pointer (&self->shm_ctrl, g_free);
+  shm_unmap (self);
 
   /* Delay result to open up the possibility of testing race conditions. */
   fpi_device_add_timeout (FP_DEVICE (dev), 100, (FpTimeoutFunc) fpi_image_device_close_complete, NULL, NULL);
@@ -265,6 +597,16 @@ dev_activate (FpImageDevice *dev)
 static void
 dev_deactivate (FpImageDevice *dev)
 {
+  FpDeviceVirtualImage *self = FPI_DEVICE_VIRTUAL_IMAGE (dev);
+
+  if (self->replay_inject_time != 0)
+    {
+      g_message ("Replayed image processed in %.2f ms",
+                 (g_get_monotonic_time () - self->replay_inject_time) / 1000.0);
+      self->replay_inject_time = 0;
+    }
+  g_clear_pointer (&self->replay_timeout, g_source_destroy);
+
   fpi_image_device_deactivate_complete (dev, NULL);
 }
 
@@ -274,10 +616,8 @@ dev_notify_removed_cb (FpDevice *dev)
   FpiImageDeviceState state;
   gboolean removed;
 
-  g_object_get (dev,
-                "fpi-image-device-state", &state,
-                "removed", &removed,
-                NULL);
+  state = fpi_image_device_get_state (FP_IMAGE_DEVICE (dev));
+  g_object_get (dev, "removed", &removed, NULL);
 
   if (!removed || state == FPI_IMAGE_DEVICE_STATE_INACTIVE)
     return;
@@ -305,12 +645,25 @@ static const FpIdEntry driver_ids[] = {
   { .virtual_envvar = NULL }
 };
 
+static void
+fpi_device_virtual_image_finalize (GObject *object)
+{
+  FpDeviceVirtualImage *self = FPI_DEVICE_VIRTUAL_IMAGE (object);
+
+  g_clear_pointer (&self->replay_images, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (fpi_device_virtual_image_parent_class)->finalize (object);
+}
+
 static void
 fpi_device_virtual_image_class_init (FpDeviceVirtualImageClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   FpDeviceClass *dev_class = FP_DEVICE_CLASS (klass);
   FpImageDeviceClass *img_class = FP_IMAGE_DEVICE_CLASS (klass);
 
+  object_class->finalize = fpi_device_virtual_image_finalize;
+
   dev_class->id = FP_COMPONENT;
   dev_class->full_name = "Virtual image device for debugging";
   dev_class->type = FP_DEVICE_TYPE_VIRTUAL;
@@ -22,6 +22,8 @@
 
 #include "fpi-context.h"
 #include "fpi-device.h"
+#include "fp-device-private.h"
+#include "fpi-simd.h"
 #include <gusb.h>
 #include <stdio.h>
 
@@ -41,8 +43,25 @@
  *
  * The <link linkend="device-added">device-added</link> and device-removed signals allow you to handle devices
  * that may be hotplugged at runtime.
+ *
+ * # Threading # {#threading}
+ *
+ * A #FpContext is owned by the #GMainContext that was the thread-default
+ * at creation time: device probing happens there, the internal device
+ * list is only ever modified from it, and #FpContext::device-added and
+ * #FpContext::device-removed are always emitted from it. On top of that,
+ * fp_context_enumerate() and fp_context_dup_devices() may be called from
+ * any thread, provided that some thread keeps iterating the owning main
+ * context. This lets multi-threaded daemons discover devices centrally
+ * and hand each device to its own worker thread without a process-wide
+ * lock.
  */
 
+/* Maximum number of devices that may be probing at the same time. Keeping
+ * this bounded avoids hammering the USB subsystem when many readers (or a
+ * resume-time replug storm) show up at once; further probes are queued. */
+#define FP_CONTEXT_MAX_PARALLEL_INITS 4
+
 typedef struct
 {
   GUsbContext  *usb_ctx;
@@ -53,8 +72,31 @@ typedef struct
   gint          pending_devices;
   gboolean      enumerated;
 
+  GQueue        init_queue;
+  gint          active_inits;
+  gboolean      init_pump_scheduled;
+  GTask        *enumerate_task;
+
+  /* The thread-default main context at creation time; all internal
+   * state changes and signal emissions happen on it. */
+  GMainContext *main_context;
+
+  /* Protects @devices against concurrent readers (see
+   * fp_context_dup_devices()); mutations only happen on @main_context. */
+  GMutex        devices_lock;
+
+  /* Wakes non-owner threads blocked in fp_context_enumerate(). */
+  GMutex        enumerate_lock;
+  GCond         enumerate_cond;
+  gboolean      enumerate_settled;
+
   GArray       *drivers;
+  GArray       *usb_id_index;
+  GHashTable   *usb_negative_cache;
   GPtrArray    *devices;
+
+  GKeyFile     *probe_cache;
+  gchar        *probe_cache_path;
 } FpContextPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (FpContext, fp_context, G_TYPE_OBJECT)
@@ -111,7 +153,10 @@ remove_device_idle_cb (RemoveDeviceData *data)
   g_return_val_if_fail (g_ptr_array_find (priv->devices, data->device, &idx), G_SOURCE_REMOVE);
 
   g_signal_emit (data->context, signals[DEVICE_REMOVED_SIGNAL], 0, data->device);
+
+  g_mutex_lock (&priv->devices_lock);
   g_ptr_array_remove_index_fast (priv->devices, idx);
+  g_mutex_unlock (&priv->devices_lock);
 
   return G_SOURCE_REMOVE;
 }
@@ -140,7 +185,7 @@ remove_device (FpContext *context, FpDevice *device)
   g_source_set_callback (source,
                          G_SOURCE_FUNC (remove_device_idle_cb), data,
                          (GDestroyNotify) remove_device_data_free);
-  g_source_attach (source, g_main_context_get_thread_default ());
+  g_source_attach (source, priv->main_context);
 
   priv->sources = g_slist_prepend (priv->sources, source);
 }
@@ -172,53 +217,376 @@ device_removed_cb (FpContext *context, FpDevice *device)
     }
 }
 
+static void fp_context_pump_device_init (FpContext *context);
+static void fp_context_maybe_complete_enumerate (FpContext *context);
+static void fp_context_signal_enumerate_settled (FpContext *context);
+static void fp_context_probe_cache_store (FpContext *self, FpDevice *dev);
+static void fp_context_probe_cache_forget (FpContext *self, FpDevice *dev);
+
 static void
 async_device_init_done_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
   g_autoptr(GError) error = NULL;
-  FpDevice *device;
+  g_autoptr(FpDevice) device = FP_DEVICE (source_object);
   FpContext *context;
   FpContextPrivate *priv;
 
-  device = FP_DEVICE (g_async_initable_new_finish (G_ASYNC_INITABLE (source_object),
-                                                   res, &error));
-  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  if (!g_async_initable_init_finish (G_ASYNC_INITABLE (source_object), res, &error) &&
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     return;
 
   context = FP_CONTEXT (user_data);
   priv = fp_context_get_instance_private (context);
   priv->pending_devices--;
+  priv->active_inits--;
 
   if (error)
     {
       g_message ("Ignoring device due to initialization error: %s", error->message);
-      return;
+      fp_context_probe_cache_forget (context, device);
     }
+  else
+    {
+      fp_context_probe_cache_store (context, device);
+
+      g_mutex_lock (&priv->devices_lock);
+      g_ptr_array_add (priv->devices, g_object_ref (device));
+      g_mutex_unlock (&priv->devices_lock);
 
-  g_ptr_array_add (priv->devices, device);
+      g_signal_connect_object (device, "removed",
+                               (GCallback) device_removed_cb,
+                               context,
+                               G_CONNECT_SWAPPED);
 
-  g_signal_connect_object (device, "removed",
-                           (GCallback) device_removed_cb,
-                           context,
-                           G_CONNECT_SWAPPED);
+      g_signal_emit (context, signals[DEVICE_ADDED_SIGNAL], 0, device);
+    }
 
-  g_signal_emit (context, signals[DEVICE_ADDED_SIGNAL], 0, device);
+  fp_context_pump_device_init (context);
+  fp_context_maybe_complete_enumerate (context);
+  fp_context_signal_enumerate_settled (context);
 }
 
+/* Start queued device probes, up to the parallelism bound. */
 static void
-usb_device_added_cb (FpContext *self, GUsbDevice *device, GUsbContext *usb_ctx)
+fp_context_pump_device_init (FpContext *context)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+
+  while (priv->active_inits < FP_CONTEXT_MAX_PARALLEL_INITS &&
+         !g_queue_is_empty (&priv->init_queue))
+    {
+      FpDevice *device = g_queue_pop_head (&priv->init_queue);
+
+      priv->active_inits++;
+      g_async_initable_init_async (G_ASYNC_INITABLE (device),
+                                   G_PRIORITY_LOW,
+                                   priv->cancellable,
+                                   async_device_init_done_cb,
+                                   context);
+    }
+}
+
+static gboolean
+pump_device_init_idle_cb (gpointer user_data)
+{
+  FpContext *context = FP_CONTEXT (user_data);
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+
+  priv->init_pump_scheduled = FALSE;
+  fp_context_pump_device_init (context);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Queue the (not yet initialized) @device for probing, taking ownership.
+ *
+ * The probe round starts from an idle handler below the USB event
+ * priority rather than right away. A hub reset re-enumerates several
+ * readers back to back; deferring until those events have all been
+ * dispatched batches them into one round of bounded-parallel probes
+ * (and lets a removal of the old device instance be processed before
+ * its replacement starts probing). */
+static void
+fp_context_enqueue_device_init (FpContext *context, FpDevice *device)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+  g_autoptr(GSource) source = NULL;
+
+  priv->pending_devices++;
+  g_queue_push_tail (&priv->init_queue, device);
+
+  if (priv->init_pump_scheduled)
+    return;
+  priv->init_pump_scheduled = TRUE;
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_LOW);
+  g_source_set_callback (source, pump_device_init_idle_cb,
+                         g_object_ref (context), g_object_unref);
+  g_source_attach (source, priv->main_context);
+}
+
+static gboolean
+complete_enumerate_idle_cb (gpointer user_data)
+{
+  FpContext *context = FP_CONTEXT (user_data);
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+
+  /* A hotplug event may have queued new devices in the meantime; the
+   * last probe to finish will re-arm this idle handler. */
+  if (!priv->pending_devices && priv->enumerate_task)
+    {
+      g_autoptr(GTask) task = g_steal_pointer (&priv->enumerate_task);
+
+      g_task_return_boolean (task, TRUE);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fp_context_maybe_complete_enumerate (FpContext *context)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+  g_autoptr(GSource) source = NULL;
+
+  if (!priv->enumerate_task || priv->pending_devices)
+    return;
+
+  /* Complete from an idle handler that runs after the device probes so
+   * that pending hotplug events are processed first (see the comment in
+   * fp_context_enumerate about USB persist). */
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_LOW + 1);
+  g_source_set_callback (source, complete_enumerate_idle_cb,
+                         g_object_ref (context), g_object_unref);
+  g_source_attach (source, priv->main_context);
+}
+
+/* Wake threads blocked in fp_context_enumerate() once the initial
+ * enumeration has settled; runs on the owning main context. */
+static void
+fp_context_signal_enumerate_settled (FpContext *context)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+
+  if (!priv->enumerated || priv->pending_devices)
+    return;
+
+  g_mutex_lock (&priv->enumerate_lock);
+  priv->enumerate_settled = TRUE;
+  g_cond_broadcast (&priv->enumerate_cond);
+  g_mutex_unlock (&priv->enumerate_lock);
+}
+
+/* Persistent probe cache, enabled by pointing FP_PROBE_CACHE at a key
+ * file. Probing a device usually means opening it and doing I/O just to
+ * learn its serial number; caching the result keyed by the USB platform
+ * ID and validated against a driver/descriptor checksum lets a warm
+ * restart skip straight to the probe completion. */
+static GKeyFile *
+fp_context_get_probe_cache (FpContext *self)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (self);
+  const gchar *path;
+
+  if (priv->probe_cache)
+    return priv->probe_cache;
+
+  path = g_getenv ("FP_PROBE_CACHE");
+  if (!path || path[0] == '\0')
+    return NULL;
+
+  priv->probe_cache_path = g_strdup (path);
+  priv->probe_cache = g_key_file_new ();
+  /* A missing or unreadable file simply starts with an empty cache. */
+  g_key_file_load_from_file (priv->probe_cache, path, G_KEY_FILE_NONE, NULL);
+
+  return priv->probe_cache;
+}
+
+static void
+fp_context_save_probe_cache (FpContext *self)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (self);
+  g_autoptr(GError) error = NULL;
+
+  if (!g_key_file_save_to_file (priv->probe_cache, priv->probe_cache_path, &error))
+    g_debug ("Could not save probe cache: %s", error->message);
+}
+
+/* The cached result is only valid for the same driver and device
+ * revision; hash the identifying descriptor fields so stale entries are
+ * ignored after e.g. a firmware update. */
+static gchar *
+fp_context_probe_cache_checksum (FpDeviceClass *cls, GUsbDevice *device)
+{
+  g_autofree gchar *ident = NULL;
+
+  ident = g_strdup_printf ("%s/%04x:%04x/%04x",
+                           cls->id,
+                           g_usb_device_get_vid (device),
+                           g_usb_device_get_pid (device),
+                           g_usb_device_get_release (device));
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA1, ident, -1);
+}
+
+static void
+fp_context_probe_cache_restore (FpContext     *self,
+                                FpDevice      *dev,
+                                FpDeviceClass *cls,
+                                GUsbDevice    *device)
+{
+  GKeyFile *cache = fp_context_get_probe_cache (self);
+  const gchar *group;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *cached_checksum = NULL;
+  g_autofree gchar *device_id = NULL;
+  g_autofree gchar *device_name = NULL;
+  g_autofree gchar *snapshot_type = NULL;
+  g_autofree gchar *snapshot_data = NULL;
+
+  /* Nothing to skip if the driver does not implement probing. */
+  if (!cache || !cls->probe)
+    return;
+
+  group = g_usb_device_get_platform_id (device);
+  cached_checksum = g_key_file_get_string (cache, group, "checksum", NULL);
+  if (!cached_checksum)
+    return;
+
+  checksum = fp_context_probe_cache_checksum (cls, device);
+  if (g_strcmp0 (checksum, cached_checksum) != 0)
+    return;
+
+  device_id = g_key_file_get_string (cache, group, "device-id", NULL);
+  if (!device_id)
+    return;
+  device_name = g_key_file_get_string (cache, group, "device-name", NULL);
+
+  g_debug ("Restoring cached probe result for %s", group);
+  fpi_device_set_probe_result (dev, device_id, device_name);
+
+  /* Drivers may have stashed immutable probe data (sensor identity,
+   * capabilities) in their snapshot; hand it back so the skipped probe
+   * does not leave them without it. */
+  snapshot_type = g_key_file_get_string (cache, group, "snapshot-type", NULL);
+  snapshot_data = g_key_file_get_string (cache, group, "snapshot", NULL);
+  if (snapshot_type && snapshot_data &&
+      g_variant_type_string_is_valid (snapshot_type))
+    {
+      guchar *bytes;
+      gsize len = 0;
+
+      bytes = g_base64_decode (snapshot_data, &len);
+      fpi_device_set_driver_snapshot (dev,
+                                      g_variant_new_from_data (G_VARIANT_TYPE (snapshot_type),
+                                                               bytes, len, FALSE,
+                                                               g_free, bytes));
+    }
+}
+
+static void
+fp_context_probe_cache_store (FpContext *self, FpDevice *dev)
+{
+  GKeyFile *cache = fp_context_get_probe_cache (self);
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (dev);
+  GUsbDevice *device;
+  const gchar *group;
+  const gchar *device_id;
+  const gchar *device_name;
+  GVariant *snapshot;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *cached_id = NULL;
+
+  if (!cache || cls->type != FP_DEVICE_TYPE_USB || !cls->probe)
+    return;
+
+  device_id = fp_device_get_device_id (dev);
+  if (!device_id)
+    return;
+
+  device = fpi_device_get_usb_device (dev);
+  group = g_usb_device_get_platform_id (device);
+  checksum = fp_context_probe_cache_checksum (cls, device);
+
+  snapshot = fpi_device_get_driver_snapshot (dev);
+
+  /* Avoid rewriting the file on every start when nothing changed. */
+  cached_id = g_key_file_get_string (cache, group, "device-id", NULL);
+  if (g_strcmp0 (cached_id, device_id) == 0 &&
+      (!snapshot || g_key_file_has_key (cache, group, "snapshot", NULL)))
+    return;
+
+  device_name = fp_device_get_name (dev);
+  g_key_file_set_string (cache, group, "driver", cls->id);
+  g_key_file_set_string (cache, group, "checksum", checksum);
+  g_key_file_set_string (cache, group, "device-id", device_id);
+  if (device_name)
+    g_key_file_set_string (cache, group, "device-name", device_name);
+
+  if (snapshot)
+    {
+      g_autoptr(GVariant) normal = g_variant_get_normal_form (snapshot);
+      g_autofree gchar *encoded = NULL;
+
+      encoded = g_base64_encode (g_variant_get_data (normal),
+                                 g_variant_get_size (normal));
+      g_key_file_set_string (cache, group, "snapshot-type",
+                             g_variant_get_type_string (snapshot));
+      g_key_file_set_string (cache, group, "snapshot", encoded);
+    }
+
+  fp_context_save_probe_cache (self);
+}
+
+static void
+fp_context_probe_cache_forget (FpContext *self, FpDevice *dev)
+{
+  GKeyFile *cache = fp_context_get_probe_cache (self);
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (dev);
+  GUsbDevice *device;
+  const gchar *group;
+
+  if (!cache || cls->type != FP_DEVICE_TYPE_USB)
+    return;
+
+  device = fpi_device_get_usb_device (dev);
+  if (!device)
+    return;
+
+  group = g_usb_device_get_platform_id (device);
+  if (g_key_file_remove_group (cache, group, NULL))
+    fp_context_save_probe_cache (self);
+}
+
+/* One row of the flattened USB device ID index. */
+typedef struct
+{
+  guint16 vid;
+  guint16 pid;
+  GType   driver;
+  guint64 driver_data;
+} FpUsbIdIndexEntry;
+
+/* The drivers' ID tables only exist once their class is initialized, so
+ * matching a USB device used to initialize (and free) all 30+ driver
+ * classes on every device-added event. Flatten the tables into one
+ * vid:pid index instead, built on first use: each class is initialized
+ * exactly once per context and released right after its table has been
+ * copied, and later device events only ever touch the class of the
+ * driver that actually matched. */
+static GArray *
+fp_context_get_usb_id_index (FpContext *self)
 {
   FpContextPrivate *priv = fp_context_get_instance_private (self);
-  GType found_driver = G_TYPE_NONE;
-  const FpIdEntry *found_entry = NULL;
-  gint found_score = 0;
   gint i;
-  guint16 pid, vid;
 
-  pid = g_usb_device_get_pid (device);
-  vid = g_usb_device_get_vid (device);
+  if (priv->usb_id_index)
+    return priv->usb_id_index;
+
+  priv->usb_id_index = g_array_new (FALSE, FALSE, sizeof (FpUsbIdIndexEntry));
 
-  /* Find the best driver to handle this USB device. */
   for (i = 0; i < priv->drivers->len; i++)
     {
       GType driver = g_array_index (priv->drivers, GType, i);
@@ -230,39 +598,198 @@ usb_device_added_cb (FpContext *self, GUsbDevice *device, GUsbContext *usb_ctx)
 
       for (entry = cls->id_table; entry->pid; entry++)
         {
-          gint driver_score = 50;
+          FpUsbIdIndexEntry index_entry = {
+            .vid = entry->vid,
+            .pid = entry->pid,
+            .driver = driver,
+            .driver_data = entry->driver_data,
+          };
+
+          g_array_append_val (priv->usb_id_index, index_entry);
+        }
+    }
 
-          if (entry->pid != pid || entry->vid != vid)
-            continue;
+  g_debug ("Indexed %u USB device IDs", priv->usb_id_index->len);
 
-          if (cls->usb_discover)
-            driver_score = cls->usb_discover (device);
+  return priv->usb_id_index;
+}
 
-          /* Is this driver better than the one we had? */
-          if (driver_score <= found_score)
-            continue;
+#define USB_NEGATIVE_CACHE_GROUP "negative-usb"
 
-          found_score = driver_score;
-          found_driver = driver;
-          found_entry = entry;
-        }
+/* Digest of the full USB ID index, in the style of
+ * fp_context_probe_cache_checksum() above. A count alone is not enough
+ * to validate the persisted negative cache: a driver-set change that
+ * swaps one ID for another keeps the length while changing what
+ * matches. */
+static gchar *
+fp_context_usb_id_index_checksum (FpContext *self)
+{
+  GArray *id_index = fp_context_get_usb_id_index (self);
+  g_autoptr(GString) ident = g_string_new (NULL);
+  gint i;
+
+  for (i = 0; i < id_index->len; i++)
+    {
+      FpUsbIdIndexEntry *entry = &g_array_index (id_index, FpUsbIdIndexEntry, i);
+
+      g_string_append_printf (ident, "%s/%04x:%04x/%" G_GUINT64_FORMAT "\n",
+                              g_type_name (entry->driver),
+                              entry->vid, entry->pid, entry->driver_data);
+    }
+
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA1, ident->str, -1);
+}
+
+/* IDs that matched no entry of the USB ID index. Most devices on a bus
+ * are hubs, keyboards and the like which will never be fingerprint
+ * readers, so remembering the misses lets hub-reset storms skip the
+ * match loop entirely. With FP_PROBE_CACHE enabled the set is persisted
+ * in the probe-cache key file, keyed by a digest of the ID index so a
+ * cache written by a different driver set cannot suppress matching. */
+static GHashTable *
+fp_context_get_usb_negative_cache (FpContext *self)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (self);
+  GKeyFile *cache;
+  g_auto(GStrv) keys = NULL;
+  gint i;
+
+  if (priv->usb_negative_cache)
+    return priv->usb_negative_cache;
+
+  priv->usb_negative_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  cache = fp_context_get_probe_cache (self);
+  if (!cache)
+    return priv->usb_negative_cache;
+
+  {
+    g_autofree gchar *checksum = fp_context_usb_id_index_checksum (self);
+    g_autofree gchar *cached_checksum = NULL;
+
+    cached_checksum = g_key_file_get_string (cache, USB_NEGATIVE_CACHE_GROUP,
+                                             "id-index-checksum", NULL);
+    if (g_strcmp0 (checksum, cached_checksum) != 0)
+      {
+        g_key_file_remove_group (cache, USB_NEGATIVE_CACHE_GROUP, NULL);
+        return priv->usb_negative_cache;
+      }
+  }
+
+  keys = g_key_file_get_keys (cache, USB_NEGATIVE_CACHE_GROUP, NULL, NULL);
+  for (i = 0; keys && keys[i]; i++)
+    {
+      guint64 vid, pid;
+      gchar *end = NULL;
+
+      vid = g_ascii_strtoull (keys[i], &end, 16);
+      if (!end || *end != ':' || vid > G_MAXUINT16)
+        continue;
+      pid = g_ascii_strtoull (end + 1, &end, 16);
+      if (!end || *end != '\0' || pid > G_MAXUINT16)
+        continue;
+
+      g_hash_table_add (priv->usb_negative_cache,
+                        GUINT_TO_POINTER (((guint) vid << 16) | (guint) pid));
+    }
+
+  return priv->usb_negative_cache;
+}
+
+static void
+fp_context_usb_negative_cache_store (FpContext *self, guint16 vid, guint16 pid)
+{
+  GHashTable *negative = fp_context_get_usb_negative_cache (self);
+  GKeyFile *cache;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *checksum = NULL;
+
+  g_hash_table_add (negative, GUINT_TO_POINTER (((guint) vid << 16) | pid));
+
+  cache = fp_context_get_probe_cache (self);
+  if (!cache)
+    return;
+
+  name = g_strdup_printf ("%04x:%04x", vid, pid);
+  checksum = fp_context_usb_id_index_checksum (self);
+  g_key_file_set_string (cache, USB_NEGATIVE_CACHE_GROUP,
+                         "id-index-checksum", checksum);
+  g_key_file_set_boolean (cache, USB_NEGATIVE_CACHE_GROUP, name, TRUE);
+  fp_context_save_probe_cache (self);
+}
+
+static void
+usb_device_added_cb (FpContext *self, GUsbDevice *device, GUsbContext *usb_ctx)
+{
+  GArray *id_index;
+  GType found_driver = G_TYPE_NONE;
+  guint64 found_driver_data = 0;
+  gint found_score = 0;
+  gboolean id_matched = FALSE;
+  gint i;
+  guint16 pid, vid;
+
+  pid = g_usb_device_get_pid (device);
+  vid = g_usb_device_get_vid (device);
+
+  if (g_hash_table_contains (fp_context_get_usb_negative_cache (self),
+                             GUINT_TO_POINTER (((guint) vid << 16) | pid)))
+    {
+      g_debug ("USB device %04X:%04X cached as matching no driver", vid, pid);
+      return;
+    }
+
+  id_index = fp_context_get_usb_id_index (self);
+
+  /* Find the best driver to handle this USB device. */
+  for (i = 0; i < id_index->len; i++)
+    {
+      FpUsbIdIndexEntry *entry = &g_array_index (id_index, FpUsbIdIndexEntry, i);
+      gint driver_score = 50;
+
+      if (entry->pid != pid || entry->vid != vid)
+        continue;
+
+      id_matched = TRUE;
+
+      {
+        g_autoptr(FpDeviceClass) cls = g_type_class_ref (entry->driver);
+
+        if (cls->usb_discover)
+          driver_score = cls->usb_discover (device);
+      }
+
+      /* Is this driver better than the one we had? */
+      if (driver_score <= found_score)
+        continue;
+
+      found_score = driver_score;
+      found_driver = entry->driver;
+      found_driver_data = entry->driver_data;
     }
 
   if (found_driver == G_TYPE_NONE)
     {
       g_debug ("No driver found for USB device %04X:%04X", vid, pid);
+      /* Only IDs absent from the index are remembered: usb_discover()
+       * rejections can depend on device state and must be re-run. */
+      if (!id_matched)
+        fp_context_usb_negative_cache_store (self, vid, pid);
       return;
     }
 
-  priv->pending_devices++;
-  g_async_initable_new_async (found_driver,
-                              G_PRIORITY_LOW,
-                              priv->cancellable,
-                              async_device_init_done_cb,
-                              self,
-                              "fpi-usb-device", device,
-                              "fpi-driver-data", found_entry->driver_data,
-                              NULL);
+  {
+    g_autoptr(FpDeviceClass) cls = g_type_class_ref (found_driver);
+    FpDevice *dev;
+
+    dev = g_object_new (found_driver,
+                        "fpi-usb-device", device,
+                        "fpi-driver-data", found_driver_data,
+                        NULL);
+
+    fp_context_probe_cache_restore (self, dev, cls, device);
+    fp_context_enqueue_device_init (self, dev);
+  }
 }
 
 static void
@@ -292,10 +819,19 @@ fp_context_finalize (GObject *object)
   FpContextPrivate *priv = fp_context_get_instance_private (self);
 
   g_clear_pointer (&priv->devices, g_ptr_array_unref);
+  g_queue_clear_full (&priv->init_queue, g_object_unref);
 
   g_cancellable_cancel (priv->cancellable);
   g_clear_object (&priv->cancellable);
+  g_clear_pointer (&priv->main_context, g_main_context_unref);
+  g_mutex_clear (&priv->devices_lock);
+  g_mutex_clear (&priv->enumerate_lock);
+  g_cond_clear (&priv->enumerate_cond);
   g_clear_pointer (&priv->drivers, g_array_unref);
+  g_clear_pointer (&priv->usb_id_index, g_array_unref);
+  g_clear_pointer (&priv->usb_negative_cache, g_hash_table_unref);
+  g_clear_pointer (&priv->probe_cache, g_key_file_unref);
+  g_clear_pointer (&priv->probe_cache_path, g_free);
 
   g_slist_free_full (g_steal_pointer (&priv->sources), (GDestroyNotify) g_source_destroy);
 
@@ -363,6 +899,8 @@ fp_context_init (FpContext *self)
 
   g_debug ("Initializing FpContext (libfprint version " LIBFPRINT_VERSION ")");
 
+  fpi_simd_init ();
+
   priv->drivers = fpi_get_driver_types ();
 
   if (get_drivers_whitelist_env ())
@@ -380,6 +918,12 @@ fp_context_init (FpContext *self)
     }
 
   priv->devices = g_ptr_array_new_with_free_func (g_object_unref);
+  g_queue_init (&priv->init_queue);
+
+  priv->main_context = g_main_context_ref_thread_default ();
+  g_mutex_init (&priv->devices_lock);
+  g_mutex_init (&priv->enumerate_lock);
+  g_cond_init (&priv->enumerate_cond);
 
   priv->cancellable = g_cancellable_new ();
   priv->usb_ctx = g_usb_context_new (&error);
@@ -416,26 +960,14 @@ fp_context_new (void)
   return g_object_new (FP_TYPE_CONTEXT, NULL);
 }
 
-/**
- * fp_context_enumerate:
- * @context: a #FpContext
- *
- * Enumerate all devices. You should call this function exactly once
- * at startup. Please note that it iterates the mainloop until all
- * devices are enumerated.
- */
-void
-fp_context_enumerate (FpContext *context)
+/* Kick off discovery of all devices; probe completions are then handled
+ * from async_device_init_done_cb as they trickle in. */
+static void
+fp_context_start_enumerate (FpContext *context)
 {
   FpContextPrivate *priv = fp_context_get_instance_private (context);
-  gboolean dispatched;
   gint i;
 
-  g_return_if_fail (FP_IS_CONTEXT (context));
-
-  if (priv->enumerated)
-    return;
-
   priv->enumerated = TRUE;
 
   /* USB devices are handled from callbacks */
@@ -461,15 +993,11 @@ fp_context_enumerate (FpContext *context)
             continue;
 
           g_debug ("Found virtual environment device: %s, %s", entry->virtual_envvar, val);
-          priv->pending_devices++;
-          g_async_initable_new_async (driver,
-                                      G_PRIORITY_LOW,
-                                      priv->cancellable,
-                                      async_device_init_done_cb,
-                                      context,
-                                      "fpi-environ", val,
-                                      "fpi-driver-data", entry->driver_data,
-                                      NULL);
+          fp_context_enqueue_device_init (context,
+                                          g_object_new (driver,
+                                                        "fpi-environ", val,
+                                                        "fpi-driver-data", entry->driver_data,
+                                                        NULL));
           g_debug ("created");
         }
     }
@@ -537,16 +1065,12 @@ fp_context_enumerate (FpContext *context)
                 if (matched_hidraw == NULL)
                   continue;
               }
-            priv->pending_devices++;
-            g_async_initable_new_async (driver,
-                                        G_PRIORITY_LOW,
-                                        priv->cancellable,
-                                        async_device_init_done_cb,
-                                        context,
-                                        "fpi-driver-data", entry->driver_data,
-                                        "fpi-udev-data-spidev", (matched_spidev ? g_udev_device_get_device_file (matched_spidev->data) : NULL),
-                                        "fpi-udev-data-hidraw", (matched_hidraw ? g_udev_device_get_device_file (matched_hidraw->data) : NULL),
-                                        NULL);
+            fp_context_enqueue_device_init (context,
+                                            g_object_new (driver,
+                                                          "fpi-driver-data", entry->driver_data,
+                                                          "fpi-udev-data-spidev", (matched_spidev ? g_udev_device_get_device_file (matched_spidev->data) : NULL),
+                                                          "fpi-udev-data-hidraw", (matched_hidraw ? g_udev_device_get_device_file (matched_hidraw->data) : NULL),
+                                                          NULL));
             /* remove entries from list to avoid conflicts */
             if (matched_spidev)
               {
@@ -566,20 +1090,154 @@ fp_context_enumerate (FpContext *context)
     g_list_foreach (hidraw_devices, (GFunc) g_object_unref, NULL);
   }
 #endif
+}
+
+/* Cross-thread entry point for fp_context_enumerate(): starts the
+ * enumeration on the owning main context; completion is signalled from
+ * async_device_init_done_cb as probes finish. */
+static gboolean
+start_enumerate_invoke_cb (gpointer user_data)
+{
+  FpContext *context = FP_CONTEXT (user_data);
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+
+  if (!priv->enumerated)
+    fp_context_start_enumerate (context);
+
+  /* Nothing was discovered (or everything already settled). */
+  fp_context_signal_enumerate_settled (context);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * fp_context_enumerate:
+ * @context: a #FpContext
+ *
+ * Enumerate all devices. You should call this function exactly once
+ * at startup. Please note that it iterates the mainloop until all
+ * devices are enumerated.
+ *
+ * This function may be called from any thread (see the
+ * [threading][threading] section). When the owning main context is
+ * iterated by another thread, enumeration runs there and this call
+ * blocks until all discovered devices have finished probing.
+ *
+ * See fp_context_enumerate_async() for a non-blocking alternative.
+ */
+void
+fp_context_enumerate (FpContext *context)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+  gboolean dispatched;
+
+  g_return_if_fail (FP_IS_CONTEXT (context));
+
+  if (g_main_context_acquire (priv->main_context))
+    {
+      if (!priv->enumerated)
+        {
+          fp_context_start_enumerate (context);
+
+          /* Iterate until 1. we have no pending devices, and 2. the mainloop is idle
+           * This takes care of processing hotplug events that happened during
+           * enumeration.
+           * This is important due to USB `persist` being turned off. At resume time,
+           * devices will disappear and immediately re-appear. In this situation,
+           * enumerate could first see the old state with a removed device resulting
+           * in it to not be discovered.
+           * As a hotplug event is seemingly emitted by the kernel immediately, we can
+           * simply make sure to process all events before returning from enumerate.
+           */
+          dispatched = TRUE;
+          while (priv->pending_devices || dispatched)
+            dispatched = g_main_context_iteration (priv->main_context, !!priv->pending_devices);
+        }
+
+      g_main_context_release (priv->main_context);
+
+      fp_context_signal_enumerate_settled (context);
+      return;
+    }
+
+  /* Another thread is running the owning main context; have it start
+   * the enumeration and wait for the probes to settle there. */
+  g_mutex_lock (&priv->enumerate_lock);
+  if (!priv->enumerate_settled)
+    {
+      g_main_context_invoke_full (priv->main_context, G_PRIORITY_DEFAULT,
+                                  start_enumerate_invoke_cb,
+                                  g_object_ref (context), g_object_unref);
 
-  /* Iterate until 1. we have no pending devices, and 2. the mainloop is idle
-   * This takes care of processing hotplug events that happened during
-   * enumeration.
-   * This is important due to USB `persist` being turned off. At resume time,
-   * devices will disappear and immediately re-appear. In this situation,
-   * enumerate could first see the old state with a removed device resulting
-   * in it to not be discovered.
-   * As a hotplug event is seemingly emitted by the kernel immediately, we can
-   * simply make sure to process all events before returning from enumerate.
-   */
-  dispatched = TRUE;
-  while (priv->pending_devices || dispatched)
-    dispatched = g_main_context_iteration (NULL, !!priv->pending_devices);
+      while (!priv->enumerate_settled)
+        g_cond_wait (&priv->enumerate_cond, &priv->enumerate_lock);
+    }
+  g_mutex_unlock (&priv->enumerate_lock);
+}
+
+/**
+ * fp_context_enumerate_async:
+ * @context: a #FpContext
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call once enumeration has settled
+ * @user_data: the data to pass to @callback
+ *
+ * Start enumerating all devices without blocking the mainloop. The
+ * #FpContext::device-added signal is emitted for each device as soon as
+ * its probe completes, so the first usable reader becomes available
+ * before slower devices have finished initializing. @callback is called
+ * once all discovered devices have been probed.
+ *
+ * Device probes run concurrently, with the parallelism bounded to avoid
+ * overwhelming the USB subsystem.
+ */
+void
+fp_context_enumerate_async (FpContext          *context,
+                            GCancellable       *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer            user_data)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (FP_IS_CONTEXT (context));
+
+  task = g_task_new (context, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fp_context_enumerate_async);
+
+  if (priv->enumerated)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  g_warn_if_fail (priv->enumerate_task == NULL);
+  priv->enumerate_task = g_steal_pointer (&task);
+
+  fp_context_start_enumerate (context);
+
+  /* Completes right away if nothing was discovered. */
+  fp_context_maybe_complete_enumerate (context);
+}
+
+/**
+ * fp_context_enumerate_finish:
+ * @context: a #FpContext
+ * @result: a #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous operation to enumerate the devices.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_context_enumerate_finish (FpContext    *context,
+                             GAsyncResult *result,
+                             GError      **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, context), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 /**
@@ -588,6 +1246,11 @@ fp_context_enumerate (FpContext *context)
  *
  * Get all devices. fp_context_enumerate() will be called as needed.
  *
+ * The returned array is owned by @context and only modified from its
+ * owning main context, so it is safe to use from there without further
+ * synchronization. Threads that do not iterate the owning main context
+ * must use fp_context_dup_devices() instead.
+ *
  * Returns: (transfer none) (element-type FpDevice): a new #GPtrArray of #FpDevice's.
  */
 GPtrArray *
@@ -601,3 +1264,477 @@ fp_context_get_devices (FpContext *context)
 
   return priv->devices;
 }
+
+/**
+ * fp_context_dup_devices:
+ * @context: a #FpContext
+ *
+ * Get a snapshot of all devices. fp_context_enumerate() will be called
+ * as needed.
+ *
+ * Unlike fp_context_get_devices() this may be called from any thread
+ * (see the [threading][threading] section): the returned array holds
+ * its own references and is not affected by later hotplug events, which
+ * continue to be reported through the #FpContext::device-added and
+ * #FpContext::device-removed signals on the owning main context.
+ *
+ * Returns: (transfer container) (element-type FpDevice): a new #GPtrArray of #FpDevice's.
+ */
+GPtrArray *
+fp_context_dup_devices (FpContext *context)
+{
+  FpContextPrivate *priv = fp_context_get_instance_private (context);
+  GPtrArray *devices;
+  guint i;
+
+  g_return_val_if_fail (FP_IS_CONTEXT (context), NULL);
+
+  fp_context_enumerate (context);
+
+  g_mutex_lock (&priv->devices_lock);
+  devices = g_ptr_array_new_full (priv->devices->len, g_object_unref);
+  for (i = 0; i < priv->devices->len; i++)
+    g_ptr_array_add (devices, g_object_ref (g_ptr_array_index (priv->devices, i)));
+  g_mutex_unlock (&priv->devices_lock);
+
+  return devices;
+}
+
+/**
+ * SECTION: fp-device-group
+ * @title: FpDeviceGroup
+ * @short_description: Dispatch operations over interchangeable readers
+ *
+ * An #FpDeviceGroup bundles the identical readers of one station (same
+ * driver, typically several units plugged into one machine) behind a
+ * single dispatch point. fp_device_group_enroll() and
+ * fp_device_group_capture() start the operation on the least-busy open
+ * member - judged by the running operation plus the depth of its op
+ * queue, see fp_device_set_op_queueing() - so concurrent callers spread
+ * over the hardware instead of serializing on the first device. When a
+ * member fails with a device-level error, the operation transparently
+ * fails over to the next member; user-facing conditions such as
+ * #FP_DEVICE_RETRY errors or a duplicate enroll are reported as usual.
+ *
+ * The group is a snapshot of the context's device list at creation
+ * time; create a new group after #FpContext::device-added or
+ * #FpContext::device-removed to pick up hotplug changes. Opening and
+ * closing the member devices remains the caller's responsibility, and
+ * the usual threading rules for using the devices apply unchanged.
+ */
+
+struct _FpDeviceGroup
+{
+  GObject    parent_instance;
+
+  GPtrArray *devices;
+};
+
+G_DEFINE_TYPE (FpDeviceGroup, fp_device_group, G_TYPE_OBJECT)
+
+static void
+fp_device_group_finalize (GObject *object)
+{
+  FpDeviceGroup *self = FP_DEVICE_GROUP (object);
+
+  g_clear_pointer (&self->devices, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (fp_device_group_parent_class)->finalize (object);
+}
+
+static void
+fp_device_group_class_init (FpDeviceGroupClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fp_device_group_finalize;
+}
+
+static void
+fp_device_group_init (FpDeviceGroup *self)
+{
+  self->devices = g_ptr_array_new_with_free_func (g_object_unref);
+}
+
+/**
+ * fp_context_get_device_group:
+ * @context: a #FpContext
+ * @driver: the driver ID the members must share, see
+ *   fp_device_get_driver()
+ *
+ * Creates a device group from the context's current devices using the
+ * given @driver. fp_context_enumerate() will be called as needed.
+ *
+ * Returns: (transfer full) (nullable): a new #FpDeviceGroup, or %NULL
+ *   if no device uses @driver
+ */
+FpDeviceGroup *
+fp_context_get_device_group (FpContext *context, const gchar *driver)
+{
+  FpDeviceGroup *group;
+  GPtrArray *devices;
+  guint i;
+
+  g_return_val_if_fail (FP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (driver != NULL, NULL);
+
+  devices = fp_context_get_devices (context);
+  if (!devices)
+    return NULL;
+
+  group = g_object_new (FP_TYPE_DEVICE_GROUP, NULL);
+
+  for (i = 0; i < devices->len; i++)
+    {
+      FpDevice *device = g_ptr_array_index (devices, i);
+
+      if (g_strcmp0 (fp_device_get_driver (device), driver) == 0)
+        g_ptr_array_add (group->devices, g_object_ref (device));
+    }
+
+  if (group->devices->len == 0)
+    g_clear_object (&group);
+
+  return group;
+}
+
+/**
+ * fp_device_group_get_devices:
+ * @group: a #FpDeviceGroup
+ *
+ * Returns: (transfer none) (element-type FpDevice): the member devices
+ */
+GPtrArray *
+fp_device_group_get_devices (FpDeviceGroup *group)
+{
+  g_return_val_if_fail (FP_IS_DEVICE_GROUP (group), NULL);
+
+  return group->devices;
+}
+
+typedef struct
+{
+  GTask           *task;
+  FpDeviceGroup   *group;
+
+  /* Members already attempted for this operation (borrowed pointers,
+   * the group holds the references). */
+  GPtrArray       *tried;
+
+  gboolean         is_enroll;
+
+  FpPrint         *template_print;
+  FpEnrollProgress progress_cb;
+  gpointer         progress_data;
+  GDestroyNotify   progress_destroy;
+
+  gboolean         wait_for_finger;
+} FpDeviceGroupOp;
+
+static void
+fp_device_group_op_free (FpDeviceGroupOp *op)
+{
+  if (op->progress_destroy && op->progress_data)
+    op->progress_destroy (op->progress_data);
+
+  g_clear_object (&op->template_print);
+  g_clear_pointer (&op->tried, g_ptr_array_unref);
+  g_clear_object (&op->group);
+  g_clear_object (&op->task);
+  g_free (op);
+}
+
+/* The least-busy open member that was not tried yet, or NULL. */
+static FpDevice *
+fp_device_group_pick_device (FpDeviceGroup *self, GPtrArray *tried)
+{
+  FpDevice *best = NULL;
+  guint best_load = 0;
+  guint i;
+
+  for (i = 0; i < self->devices->len; i++)
+    {
+      FpDevice *device = g_ptr_array_index (self->devices, i);
+      guint load;
+
+      if (g_ptr_array_find (tried, device, NULL))
+        continue;
+      if (!fp_device_is_open (device))
+        continue;
+
+      load = fpi_device_get_op_load (device);
+      if (!best || load < best_load)
+        {
+          best = device;
+          best_load = load;
+        }
+    }
+
+  return best;
+}
+
+/* Whether an operation error indicates the reader itself failed, so
+ * that re-running the operation on another member can help. User-facing
+ * conditions (retry prompts, cancellation, data problems) are final. */
+static gboolean
+fp_device_group_error_is_failover (const GError *error)
+{
+  if (error->domain == FP_DEVICE_RETRY)
+    return FALSE;
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return FALSE;
+
+  if (error->domain == FP_DEVICE_ERROR)
+    {
+      switch (error->code)
+        {
+        case FP_DEVICE_ERROR_GENERAL:
+        case FP_DEVICE_ERROR_NOT_OPEN:
+        case FP_DEVICE_ERROR_BUSY:
+        case FP_DEVICE_ERROR_PROTO:
+        case FP_DEVICE_ERROR_REMOVED:
+        case FP_DEVICE_ERROR_TOO_HOT:
+          return TRUE;
+
+        default:
+          /* NOT_SUPPORTED and the DATA errors relate to the request or
+           * the print, and identical readers would fail the same way. */
+          return FALSE;
+        }
+    }
+
+  /* Transport errors (G_USB_DEVICE_ERROR, G_IO_ERROR) point at the
+   * specific reader. */
+  return TRUE;
+}
+
+static gboolean fp_device_group_op_dispatch (FpDeviceGroupOp *op);
+
+static void
+fp_device_group_enroll_done (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FpDeviceGroupOp *op = user_data;
+  FpPrint *print;
+  GError *error = NULL;
+
+  print = fp_device_enroll_finish (FP_DEVICE (source_object), res, &error);
+
+  if (!print && fp_device_group_error_is_failover (error))
+    {
+      g_debug ("Reader %s failed enroll (%s), trying another group member",
+               fp_device_get_name (FP_DEVICE (source_object)), error->message);
+      if (fp_device_group_op_dispatch (op))
+        {
+          g_error_free (error);
+          return;
+        }
+    }
+
+  if (print)
+    g_task_return_pointer (op->task, print, g_object_unref);
+  else
+    g_task_return_error (op->task, error);
+  fp_device_group_op_free (op);
+}
+
+static void
+fp_device_group_capture_done (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FpDeviceGroupOp *op = user_data;
+  FpImage *image;
+  GError *error = NULL;
+
+  image = fp_device_capture_finish (FP_DEVICE (source_object), res, &error);
+
+  if (!image && fp_device_group_error_is_failover (error))
+    {
+      g_debug ("Reader %s failed capture (%s), trying another group member",
+               fp_device_get_name (FP_DEVICE (source_object)), error->message);
+      if (fp_device_group_op_dispatch (op))
+        {
+          g_error_free (error);
+          return;
+        }
+    }
+
+  if (image)
+    g_task_return_pointer (op->task, image, g_object_unref);
+  else
+    g_task_return_error (op->task, error);
+  fp_device_group_op_free (op);
+}
+
+/* Start (or fail over) the operation on the next member; FALSE when no
+ * untried open member is left. */
+static gboolean
+fp_device_group_op_dispatch (FpDeviceGroupOp *op)
+{
+  FpDevice *device;
+
+  device = fp_device_group_pick_device (op->group, op->tried);
+  if (!device)
+    return FALSE;
+
+  g_ptr_array_add (op->tried, device);
+
+  if (op->is_enroll)
+    {
+      /* The progress destroy notify stays with the group operation so
+       * that a failover attempt can reuse the progress data. */
+      fp_device_enroll (device, g_object_ref (op->template_print),
+                        g_task_get_cancellable (op->task),
+                        op->progress_cb, op->progress_data, NULL,
+                        fp_device_group_enroll_done, op);
+    }
+  else
+    {
+      fp_device_capture (device, op->wait_for_finger,
+                         g_task_get_cancellable (op->task),
+                         fp_device_group_capture_done, op);
+    }
+
+  return TRUE;
+}
+
+static FpDeviceGroupOp *
+fp_device_group_op_new (FpDeviceGroup      *group,
+                        GCancellable       *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer            user_data)
+{
+  FpDeviceGroupOp *op;
+
+  op = g_new0 (FpDeviceGroupOp, 1);
+  op->group = g_object_ref (group);
+  op->task = g_task_new (group, cancellable, callback, user_data);
+  op->tried = g_ptr_array_new ();
+
+  return op;
+}
+
+/**
+ * fp_device_group_enroll:
+ * @group: a #FpDeviceGroup
+ * @template_print: (transfer floating): a #FpPrint
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @progress_cb: (nullable) (scope notified): progress reporting callback
+ * @progress_data: (closure progress_cb): user data for @progress_cb
+ * @progress_destroy: (destroy progress_data): Destroy notify for @progress_data
+ * @callback: (scope async): the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Like fp_device_enroll(), but started on the least-busy open member
+ * of the group, with failover to the remaining members on device-level
+ * errors. A failover restarts the enrollment from the first stage, so
+ * @progress_cb may report stage numbers starting over.
+ *
+ * Retrieve the result with fp_device_group_enroll_finish().
+ */
+void
+fp_device_group_enroll (FpDeviceGroup      *group,
+                        FpPrint            *template_print,
+                        GCancellable       *cancellable,
+                        FpEnrollProgress    progress_cb,
+                        gpointer            progress_data,
+                        GDestroyNotify      progress_destroy,
+                        GAsyncReadyCallback callback,
+                        gpointer            user_data)
+{
+  FpDeviceGroupOp *op;
+
+  g_return_if_fail (FP_IS_DEVICE_GROUP (group));
+
+  op = fp_device_group_op_new (group, cancellable, callback, user_data);
+  op->is_enroll = TRUE;
+  op->template_print = FP_IS_PRINT (template_print) ?
+                       g_object_ref_sink (template_print) : NULL;
+  op->progress_cb = progress_cb;
+  op->progress_data = progress_data;
+  op->progress_destroy = progress_destroy;
+
+  if (!fp_device_group_op_dispatch (op))
+    {
+      g_task_return_error (op->task,
+                           fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_OPEN,
+                                                     "No open device in the group"));
+      fp_device_group_op_free (op);
+    }
+}
+
+/**
+ * fp_device_group_enroll_finish:
+ * @group: a #FpDeviceGroup
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous group enroll operation, see
+ * fp_device_group_enroll(). The error semantics match
+ * fp_device_enroll_finish().
+ *
+ * Returns: (transfer full): The enrolled #FpPrint, or %NULL on error
+ */
+FpPrint *
+fp_device_group_enroll_finish (FpDeviceGroup *group,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, group), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * fp_device_group_capture:
+ * @group: a #FpDeviceGroup
+ * @wait_for_finger: Whether to wait for a finger or not
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Like fp_device_capture(), but started on the least-busy open member
+ * of the group, with failover to the remaining members on device-level
+ * errors. Retrieve the result with fp_device_group_capture_finish().
+ */
+void
+fp_device_group_capture (FpDeviceGroup      *group,
+                         gboolean            wait_for_finger,
+                         GCancellable       *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer            user_data)
+{
+  FpDeviceGroupOp *op;
+
+  g_return_if_fail (FP_IS_DEVICE_GROUP (group));
+
+  op = fp_device_group_op_new (group, cancellable, callback, user_data);
+  op->wait_for_finger = wait_for_finger;
+
+  if (!fp_device_group_op_dispatch (op))
+    {
+      g_task_return_error (op->task,
+                           fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_OPEN,
+                                                     "No open device in the group"));
+      fp_device_group_op_free (op);
+    }
+}
+
+/**
+ * fp_device_group_capture_finish:
+ * @group: a #FpDeviceGroup
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous group capture operation, see
+ * fp_device_group_capture().
+ *
+ * Returns: (transfer full): The captured #FpImage, or %NULL on error
+ */
+FpImage *
+fp_device_group_capture_finish (FpDeviceGroup *group,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, group), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -47,6 +47,46 @@ FpContext *fp_context_new (void);
 
 void fp_context_enumerate (FpContext *context);
 
+void fp_context_enumerate_async (FpContext          *context,
+                                 GCancellable       *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer            user_data);
+
+gboolean fp_context_enumerate_finish (FpContext    *context,
+                                      GAsyncResult *result,
+                                      GError      **error);
+
 GPtrArray *fp_context_get_devices (FpContext *context);
 
+GPtrArray *fp_context_dup_devices (FpContext *context);
+
+#define FP_TYPE_DEVICE_GROUP (fp_device_group_get_type ())
+G_DECLARE_FINAL_TYPE (FpDeviceGroup, fp_device_group, FP, DEVICE_GROUP, GObject)
+
+FpDeviceGroup *fp_context_get_device_group (FpContext   *context,
+                                            const gchar *driver);
+
+GPtrArray *fp_device_group_get_devices (FpDeviceGroup *group);
+
+void fp_device_group_enroll (FpDeviceGroup      *group,
+                             FpPrint            *template_print,
+                             GCancellable       *cancellable,
+                             FpEnrollProgress    progress_cb,
+                             gpointer            progress_data,
+                             GDestroyNotify      progress_destroy,
+                             GAsyncReadyCallback callback,
+                             gpointer            user_data);
+FpPrint *fp_device_group_enroll_finish (FpDeviceGroup *group,
+                                        GAsyncResult  *result,
+                                        GError       **error);
+
+void fp_device_group_capture (FpDeviceGroup      *group,
+                              gboolean            wait_for_finger,
+                              GCancellable       *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer            user_data);
+FpImage *fp_device_group_capture_finish (FpDeviceGroup *group,
+                                         GAsyncResult  *result,
+                                         GError       **error);
+
 G_END_DECLS
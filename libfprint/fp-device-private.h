@@ -39,6 +39,11 @@
 #define DEFAULT_TEMP_HOT_SECONDS (3 * 60)
 #define DEFAULT_TEMP_COLD_SECONDS (9 * 60)
 
+/* How long a device stays warm after fp_device_close() when the
+ * FP_IDLE_POLICY_KEEP_WARM idle policy is in effect.
+ */
+#define DEFAULT_IDLE_WARM_SECONDS 30
+
 typedef struct
 {
   FpDeviceType type;
@@ -57,15 +62,63 @@ typedef struct
 
   gchar          *device_id;
   gchar          *device_name;
+
+  /* Probe result restored from FpContext's persistent probe cache;
+   * when set, initialization skips the driver's probe vfunc. */
+  gchar          *probe_cached_id;
+  gchar          *probe_cached_name;
   FpScanType      scan_type;
   FpDeviceFeature features;
 
   guint64         driver_data;
 
+  /* Driver-owned state snapshot kept for the lifetime of the device
+   * object, across close/open and suspend/resume cycles. Lets drivers
+   * skip re-initialization steps when the hardware preserved its
+   * state, e.g. match-on-chip sensors that stay powered over S3. */
+  GVariant       *driver_snapshot;
+
   gint            nr_enroll_stages;
   GSList         *sources;
 
-  /* We always make sure that only one task is run at a time. */
+  /* Optional gallery screened for duplicates during software-matched
+   * enrollment. See fp_device_set_enroll_duplicates_gallery(). */
+  GPtrArray      *enroll_duplicates_gallery;
+
+  /* We always make sure that only one task is run at a time.
+   * With operation queueing enabled, calls arriving while a task is in
+   * flight are parked on op_queue and re-issued once the device is
+   * free, instead of failing with FP_DEVICE_ERROR_BUSY. */
+  gboolean op_queueing;
+  gboolean op_pumping;
+
+  /* Defer queued maintenance operations and stretch driver polling
+   * while the device is warm. See fp_device_set_thermal_throttling(). */
+  gboolean temp_throttle;
+  GQueue   op_queue;
+
+  /* Operation priority classes. Operations started while
+   * ops_background is set queue behind interactive entries and yield
+   * at SSM state boundaries when an interactive operation arrives.
+   * See fp_device_set_background_ops(). */
+  gboolean ops_background;
+  gboolean current_op_background;
+  gboolean preempt_requested;
+
+  /* Report retryable scan errors through the match callback and keep
+   * the operation running instead of completing with the retry error.
+   * See fp_device_set_resume_on_retry(). */
+  gboolean resume_on_retry;
+
+  /* Optional dedicated worker thread. When in use, driver entry points
+   * run on worker_context instead of the caller's context, so devices
+   * scale independently across cores. Created at open, joined at
+   * finalize. See fp_device_set_worker_thread(). */
+  gboolean      use_worker;
+  GThread      *worker_thread;
+  GMainContext *worker_context;
+  GMainLoop    *worker_loop;
+
   FpiDeviceAction     current_action;
   GTask              *current_task;
   GError             *current_cancellation_reason;
@@ -80,6 +133,22 @@ typedef struct
   gboolean            wait_for_finger;
   FpFingerStatusFlags finger_status;
 
+  /* Batch deletion: the driver's delete vfunc is re-invoked for each
+   * entry without completing the operation in between.
+   * See fp_device_delete_prints(). */
+  GPtrArray          *delete_prints;
+  guint               delete_stage;
+
+  /* Continuous capture stream. The stream re-arms the regular capture
+   * action after every delivered frame until it is stopped or hits a
+   * fatal error. See fp_device_capture_stream_start(). */
+  gboolean                      capture_stream_active;
+  gboolean                      capture_stream_wait_for_finger;
+  GCancellable                 *capture_stream_cancellable;
+  FpDeviceCaptureStreamCallback capture_stream_cb;
+  gpointer                      capture_stream_data;
+  GDestroyNotify                capture_stream_destroy;
+
   /* Driver critical sections */
   guint    critical_section;
   GSource *critical_section_flush_source;
@@ -91,6 +160,28 @@ typedef struct
   GTask  *suspend_resume_task;
   GError *suspend_error;
 
+  /* Idle policy (deferred close) state */
+  FpIdlePolicy idle_policy;
+  guint        idle_timeout_ms;
+  gboolean     is_warm;
+  GSource     *warm_timeout;
+
+  /* Per-endpoint USB transfer statistics; updated from the transfer
+   * completion path, which may run on the worker thread, while
+   * fp_device_get_transfer_stats() snapshots from the caller. */
+  GMutex  transfer_stats_lock;
+  GArray *transfer_stats;
+
+  /* Always-on operational counters, incremented atomically on the
+   * capture, retry, state machine and match paths; snapshotted by
+   * fp_device_get_statistics(). */
+  gint stat_frames_captured;
+  gint stat_frames_dropped;
+  gint stat_retries[FP_DEVICE_STATISTICS_N_RETRY_REASONS];
+  gint stat_ssm_restarts;
+  gint stat_matches_attempted;
+  gint stat_matches_aborted;
+
   /* Device temperature model information and state */
   GSource      *temp_timeout;
   FpTemperature temp_current;
@@ -118,11 +209,24 @@ typedef struct
   FpPrint       *enrolled_print;   /* verify */
   GPtrArray     *gallery;   /* identify */
 
+  /* Multi-finger fused verification: the prints are verified one after
+   * another within one operation, without deactivating the sensor in
+   * between; enrolled_print tracks the one currently being verified.
+   * See fp_device_verify_multi(). */
+  GPtrArray     *multi_prints;
+  guint          multi_stage;
+
   gboolean       result_reported;
   FpPrint       *match;
   FpPrint       *print;
   GError        *error;
 
+  /* Ranked identification. When max_candidates is non-zero the matcher
+   * fills candidates with up to that many #FpIdentifyCandidate entries,
+   * best score first. See fp_device_identify_full(). */
+  guint          max_candidates;
+  GPtrArray     *candidates;
+
   FpMatchCb      match_cb;
   gpointer       match_data;
   GDestroyNotify match_destroy;
@@ -130,10 +234,51 @@ typedef struct
 
 void match_data_free (FpMatchData *match_data);
 
+typedef struct
+{
+  /* Prints accumulated from fpi_device_list_report() when no progress
+   * callback consumes them; returned from the finish function. */
+  GPtrArray *prints;
+
+  /* Streaming listing: chunks are handed to the callback as they
+   * arrive instead of being accumulated.
+   * See fp_device_list_prints_full(). */
+  FpListProgressCb list_cb;
+  gpointer         list_data;
+  GDestroyNotify   list_destroy;
+} FpListData;
+
+void list_data_free (FpListData *list_data);
+
 void fpi_device_suspend (FpDevice *device);
 void fpi_device_resume (FpDevice *device);
 
+void fpi_device_pump_op_queue (FpDevice *device);
+guint fpi_device_get_op_load (FpDevice *device);
+
+gboolean fpi_device_should_preempt (FpDevice *device);
+
+GMainContext *fpi_device_get_driver_context (FpDevice *device);
+void          fpi_device_invoke_driver (FpDevice *device,
+                                        void (*vfunc) (FpDevice *device));
+
 void fpi_device_configure_wakeup (FpDevice *device,
                                   gboolean  enabled);
 void fpi_device_update_temp (FpDevice *device,
                              gboolean  is_active);
+
+void fpi_device_transfer_stats_submitted (FpDevice *device,
+                                          guint8    endpoint);
+void fpi_device_transfer_stats_completed (FpDevice *device,
+                                          guint8    endpoint,
+                                          gssize    actual_length,
+                                          gint64    latency_us,
+                                          gboolean  failed);
+
+void fpi_device_stats_frame_captured (FpDevice *device,
+                                      gboolean  dropped);
+void fpi_device_stats_retry (FpDevice     *device,
+                             FpDeviceRetry reason);
+void fpi_device_stats_ssm_restart (FpDevice *device);
+void fpi_device_stats_match_attempted (FpDevice *device);
+void fpi_device_stats_match_aborted (FpDevice *device);
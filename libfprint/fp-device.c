@@ -22,6 +22,7 @@
 #include "fpi-log.h"
 
 #include "fp-device-private.h"
+#include "fpi-trace.h"
 
 /**
  * SECTION: fp-device
@@ -33,6 +34,20 @@
 
 static void fp_device_async_initable_iface_init (GAsyncInitableIface *iface);
 
+typedef struct _FpDeviceQueuedOp FpDeviceQueuedOp;
+static void fp_device_queued_op_discard (FpDeviceQueuedOp *op);
+static gboolean fp_device_op_deferred_by_temp (FpDevice         *device,
+                                               FpDeviceQueuedOp *op);
+static void fp_device_identify_internal (FpDevice           *device,
+                                         GPtrArray          *prints,
+                                         guint               max_candidates,
+                                         GCancellable       *cancellable,
+                                         FpMatchCb           match_cb,
+                                         gpointer            match_data,
+                                         GDestroyNotify      match_destroy,
+                                         GAsyncReadyCallback callback,
+                                         gpointer            user_data);
+
 G_DEFINE_TYPE_EXTENDED (FpDevice, fp_device, G_TYPE_OBJECT, G_TYPE_FLAG_ABSTRACT,
                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
                                                fp_device_async_initable_iface_init)
@@ -80,6 +95,121 @@ G_DEFINE_QUARK (fp - device - retry - quark, fp_device_retry)
  **/
 G_DEFINE_QUARK (fp - device - error - quark, fp_device_error)
 
+static gpointer
+fp_device_worker_thread_func (gpointer user_data)
+{
+  FpDevice *device = user_data;
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  /* Make the worker context the thread-default one, so that anything
+   * the driver starts from its entry points (USB transfers, timeouts
+   * taken outside of an action) completes back on this thread. */
+  g_main_context_push_thread_default (priv->worker_context);
+  g_main_loop_run (priv->worker_loop);
+  g_main_context_pop_thread_default (priv->worker_context);
+
+  return NULL;
+}
+
+static void
+fp_device_worker_start (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (!priv->use_worker || priv->worker_thread)
+    return;
+
+  priv->worker_context = g_main_context_new ();
+  priv->worker_loop = g_main_loop_new (priv->worker_context, FALSE);
+  priv->worker_thread = g_thread_new ("fp-device-worker",
+                                      fp_device_worker_thread_func,
+                                      device);
+}
+
+/* The worker survives close so that a later open reuses it; it is only
+ * taken down together with the device object. */
+static void
+fp_device_worker_stop (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (!priv->worker_thread)
+    return;
+
+  g_main_loop_quit (priv->worker_loop);
+  g_thread_join (g_steal_pointer (&priv->worker_thread));
+  g_clear_pointer (&priv->worker_loop, g_main_loop_unref);
+  g_clear_pointer (&priv->worker_context, g_main_context_unref);
+}
+
+/* The context driver-facing sources must attach to: the worker context
+ * when a worker thread is in use, otherwise the context of the current
+ * task, falling back to the thread-default one outside of any action. */
+GMainContext *
+fpi_device_get_driver_context (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (priv->worker_context)
+    return priv->worker_context;
+
+  if (priv->current_task)
+    return g_task_get_context (priv->current_task);
+
+  return g_main_context_get_thread_default ();
+}
+
+typedef struct
+{
+  FpDevice *device;
+  void      (*vfunc) (FpDevice *device);
+} FpDeviceInvokeData;
+
+static gboolean
+fp_device_invoke_driver_cb (gpointer user_data)
+{
+  FpDeviceInvokeData *data = user_data;
+
+  data->vfunc (data->device);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fp_device_invoke_data_free (gpointer user_data)
+{
+  FpDeviceInvokeData *data = user_data;
+
+  g_object_unref (data->device);
+  g_free (data);
+}
+
+/* Run a driver entry point, marshalled onto the worker thread when one
+ * is in use and called directly otherwise. */
+void
+fpi_device_invoke_driver (FpDevice *device,
+                          void (*vfunc) (FpDevice *device))
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpDeviceInvokeData *data;
+
+  if (!priv->worker_context)
+    {
+      vfunc (device);
+      return;
+    }
+
+  data = g_new0 (FpDeviceInvokeData, 1);
+  data->device = g_object_ref (device);
+  data->vfunc = vfunc;
+
+  g_main_context_invoke_full (priv->worker_context,
+                              G_PRIORITY_DEFAULT,
+                              fp_device_invoke_driver_cb,
+                              data,
+                              fp_device_invoke_data_free);
+}
+
 static gboolean
 fp_device_cancel_in_idle_cb (gpointer user_data)
 {
@@ -118,7 +248,7 @@ fp_device_cancelled_cb (GCancellable *cancellable, FpDevice *self)
                          self,
                          NULL);
   g_source_attach (priv->current_idle_cancel_source,
-                   g_task_get_context (priv->current_task));
+                   fpi_device_get_driver_context (self));
   g_source_unref (priv->current_idle_cancel_source);
 }
 
@@ -137,6 +267,15 @@ setup_task_cancellable (FpDevice *device)
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
   FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
 
+#if HAVE_TRACING
+  {
+    g_autofree char *action_str = NULL;
+
+    action_str = g_enum_to_string (FPI_TYPE_DEVICE_ACTION, priv->current_action);
+    fpi_trace_span_begin ("action %s", action_str);
+  }
+#endif
+
   /* Create an internal cancellable and hook it up. */
   priv->current_cancellable = g_cancellable_new ();
   if (cls->cancel)
@@ -158,6 +297,51 @@ setup_task_cancellable (FpDevice *device)
     }
 }
 
+static void
+fp_device_warm_close_cb (GObject      *source_object,
+                         GAsyncResult *res,
+                         gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (res), &error))
+    g_warning ("Deferred close of warm device failed: %s", error->message);
+}
+
+/* Really close a device that was only kept warm after fp_device_close().
+ * The user visible close already completed; errors can only be logged. */
+static void
+fp_device_warm_flush (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (!priv->is_warm)
+    return;
+
+  /* Cannot happen as long as is_warm excludes any other action, but do
+   * not start a second task if it somehow does. */
+  if (priv->current_task)
+    return;
+
+  g_clear_pointer (&priv->warm_timeout, g_source_destroy);
+  priv->is_warm = FALSE;
+
+  priv->current_action = FPI_DEVICE_ACTION_CLOSE;
+  priv->current_task = g_task_new (device, NULL, fp_device_warm_close_cb, NULL);
+  setup_task_cancellable (device);
+
+  fpi_device_invoke_driver (device, FP_DEVICE_GET_CLASS (device)->close);
+}
+
+static void
+fp_device_warm_timeout_cb (FpDevice *device, gpointer user_data)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  priv->warm_timeout = NULL;
+  fp_device_warm_flush (device);
+}
+
 static void
 fp_device_constructed (GObject *object)
 {
@@ -218,17 +402,35 @@ fp_device_finalize (GObject *object)
   g_assert (priv->current_task == NULL);
   if (priv->is_open)
     g_warning ("User destroyed open device! Not cleaning up properly!");
+  if (priv->is_warm)
+    g_warning ("User destroyed warm device! Not cleaning up properly!");
 
+  fp_device_worker_stop (self);
+
+  g_clear_pointer (&priv->warm_timeout, g_source_destroy);
   g_clear_pointer (&priv->temp_timeout, g_source_destroy);
 
+  g_queue_clear_full (&priv->op_queue,
+                      (GDestroyNotify) fp_device_queued_op_discard);
+
   g_slist_free_full (priv->sources, (GDestroyNotify) g_source_destroy);
 
   g_clear_pointer (&priv->current_idle_cancel_source, g_source_destroy);
   g_clear_pointer (&priv->current_task_idle_return_source, g_source_destroy);
   g_clear_pointer (&priv->critical_section_flush_source, g_source_destroy);
 
+  g_clear_pointer (&priv->driver_snapshot, g_variant_unref);
+  g_clear_pointer (&priv->enroll_duplicates_gallery, g_ptr_array_unref);
+  g_clear_pointer (&priv->delete_prints, g_ptr_array_unref);
+  g_clear_object (&priv->capture_stream_cancellable);
+
   g_clear_pointer (&priv->device_id, g_free);
   g_clear_pointer (&priv->device_name, g_free);
+  g_clear_pointer (&priv->probe_cached_id, g_free);
+  g_clear_pointer (&priv->probe_cached_name, g_free);
+
+  g_clear_pointer (&priv->transfer_stats, g_array_unref);
+  g_mutex_clear (&priv->transfer_stats_lock);
 
   g_clear_object (&priv->usb_device);
   g_clear_pointer (&priv->virtual_env, g_free);
@@ -367,9 +569,17 @@ device_idle_probe_cb (FpDevice *self, gpointer user_data)
    * This effectively disables USB "persist" for us, and possibly turns off
    * USB wakeup if it was enabled for some reason.
    */
+  FpDevicePrivate *priv = fp_device_get_instance_private (self);
+
   fpi_device_configure_wakeup (self, FALSE);
 
-  if (!FP_DEVICE_GET_CLASS (self)->probe)
+  if (priv->probe_cached_id)
+    {
+      g_debug ("Using cached probe result for %s", priv->probe_cached_id);
+      fpi_device_probe_complete (self, priv->probe_cached_id,
+                                 priv->probe_cached_name, NULL);
+    }
+  else if (!FP_DEVICE_GET_CLASS (self)->probe)
     fpi_device_probe_complete (self, NULL, NULL, NULL);
   else
     FP_DEVICE_GET_CLASS (self)->probe (self);
@@ -600,6 +810,11 @@ fp_device_class_init (FpDeviceClass *klass)
 static void
 fp_device_init (FpDevice *self)
 {
+  FpDevicePrivate *priv = fp_device_get_instance_private (self);
+
+  g_queue_init (&priv->op_queue);
+  g_mutex_init (&priv->transfer_stats_lock);
+  priv->transfer_stats = g_array_new (FALSE, TRUE, sizeof (FpUsbTransferStats));
 }
 
 /**
@@ -739,172 +954,918 @@ fp_device_get_temperature (FpDevice *device)
   return priv->temp_current;
 }
 
-/**
- * fp_device_supports_identify:
- * @device: A #FpDevice
- *
- * Check whether the device supports identification.
- *
- * Returns: Whether the device supports identification
- * Deprecated: 1.92.0: Use fp_device_has_feature() instead.
- */
-gboolean
-fp_device_supports_identify (FpDevice *device)
+/* Must be called with transfer_stats_lock held. */
+static FpUsbTransferStats *
+transfer_stats_get_locked (FpDevicePrivate *priv, guint8 endpoint)
+{
+  FpUsbTransferStats *stats;
+  guint i;
+
+  for (i = 0; i < priv->transfer_stats->len; i++)
+    {
+      stats = &g_array_index (priv->transfer_stats, FpUsbTransferStats, i);
+      if (stats->endpoint == endpoint)
+        return stats;
+    }
+
+  g_array_set_size (priv->transfer_stats, priv->transfer_stats->len + 1);
+  stats = &g_array_index (priv->transfer_stats, FpUsbTransferStats,
+                          priv->transfer_stats->len - 1);
+  stats->endpoint = endpoint;
+  return stats;
+}
+
+void
+fpi_device_transfer_stats_submitted (FpDevice *device, guint8 endpoint)
 {
-  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+  g_mutex_lock (&priv->transfer_stats_lock);
+  transfer_stats_get_locked (priv, endpoint)->submitted++;
+  g_mutex_unlock (&priv->transfer_stats_lock);
+}
 
-  return cls->identify && !!(priv->features & FP_DEVICE_FEATURE_IDENTIFY);
+void
+fpi_device_transfer_stats_completed (FpDevice *device,
+                                     guint8    endpoint,
+                                     gssize    actual_length,
+                                     gint64    latency_us,
+                                     gboolean  failed)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpUsbTransferStats *stats;
+  guint bucket = 0;
+
+  while (latency_us > 1 && bucket < FP_USB_TRANSFER_STATS_N_LATENCY_BUCKETS - 1)
+    {
+      latency_us >>= 1;
+      bucket++;
+    }
+
+  g_mutex_lock (&priv->transfer_stats_lock);
+  stats = transfer_stats_get_locked (priv, endpoint);
+  if (failed)
+    {
+      stats->failed++;
+    }
+  else
+    {
+      stats->completed++;
+      if (actual_length > 0)
+        stats->bytes += actual_length;
+    }
+  stats->latency_us[bucket]++;
+  g_mutex_unlock (&priv->transfer_stats_lock);
 }
 
 /**
- * fp_device_supports_capture:
+ * fp_device_get_transfer_stats:
  * @device: A #FpDevice
  *
- * Check whether the device supports capturing images.
+ * Retrieves the per-endpoint USB transfer statistics accumulated since
+ * the device object was created: submission, completion and failure
+ * counts, payload bytes and a completion latency histogram. Together
+ * these distinguish a slow driver (few, large transfers) from a
+ * degrading link (rising latencies and failure counts) without a USB
+ * sniffer.
  *
- * Returns: Whether the device supports image capture
- * Deprecated: 1.92.0: Use fp_device_has_feature() instead.
+ * The counters keep accumulating over the lifetime of the device; the
+ * returned array is a snapshot. Devices that are not USB devices
+ * return an empty array.
+ *
+ * Returns: (transfer full) (element-type FpUsbTransferStats): Array of
+ *   #FpUsbTransferStats, one entry per endpoint used so far
  */
-gboolean
-fp_device_supports_capture (FpDevice *device)
+GArray *
+fp_device_get_transfer_stats (FpDevice *device)
 {
-  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  GArray *snapshot;
 
-  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+  g_return_val_if_fail (FP_IS_DEVICE (device), NULL);
 
-  return cls->capture && !!(priv->features & FP_DEVICE_FEATURE_CAPTURE);
+  snapshot = g_array_new (FALSE, FALSE, sizeof (FpUsbTransferStats));
+
+  g_mutex_lock (&priv->transfer_stats_lock);
+  g_array_append_vals (snapshot,
+                       priv->transfer_stats->data,
+                       priv->transfer_stats->len);
+  g_mutex_unlock (&priv->transfer_stats_lock);
+
+  return snapshot;
 }
 
-/**
- * fp_device_has_storage:
- * @device: A #FpDevice
- *
- * Whether the device has on-chip storage. If it has, you can list the
- * prints stored on the with fp_device_list_prints() and you should
- * always delete prints from the device again using
- * fp_device_delete_print().
- * Deprecated: 1.92.0: Use fp_device_has_feature() instead.
- */
-gboolean
-fp_device_has_storage (FpDevice *device)
+/* Number of operations the device would have to finish before a newly
+ * submitted one could start: the running operation plus anything parked
+ * on the op queue. Used by the device-group dispatch in fp-context.c to
+ * pick the least-busy reader. */
+guint
+fpi_device_get_op_load (FpDevice *device)
 {
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
-
-  return !!(priv->features & FP_DEVICE_FEATURE_STORAGE);
+  return (priv->current_task ? 1 : 0) + g_queue_get_length (&priv->op_queue);
 }
 
-/**
- * fp_device_open:
- * @device: a #FpDevice
- * @cancellable: (nullable): a #GCancellable, or %NULL
- * @callback: the function to call on completion
- * @user_data: the data to pass to @callback
- *
- * Start an asynchronous operation to open the device. The callback will
- * be called once the operation has finished. Retrieve the result with
- * fp_device_open_finish().
- */
 void
-fp_device_open (FpDevice           *device,
-                GCancellable       *cancellable,
-                GAsyncReadyCallback callback,
-                gpointer            user_data)
+fpi_device_stats_frame_captured (FpDevice *device, gboolean dropped)
 {
-  g_autoptr(GTask) task = NULL;
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
-  GError *error = NULL;
 
-  task = g_task_new (device, cancellable, callback, user_data);
-  if (g_task_return_error_if_cancelled (task))
-    return;
+  g_atomic_int_inc (&priv->stat_frames_captured);
+  if (dropped)
+    g_atomic_int_inc (&priv->stat_frames_dropped);
+}
 
-  if (priv->is_open)
-    {
-      g_task_return_error (task,
-                           fpi_device_error_new (FP_DEVICE_ERROR_ALREADY_OPEN));
-      return;
-    }
+void
+fpi_device_stats_retry (FpDevice *device, FpDeviceRetry reason)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-  if (priv->current_task || priv->is_suspended)
-    {
-      g_task_return_error (task,
-                           fpi_device_error_new (FP_DEVICE_ERROR_BUSY));
-      return;
-    }
+  if ((guint) reason >= FP_DEVICE_STATISTICS_N_RETRY_REASONS)
+    reason = FP_DEVICE_RETRY_GENERAL;
+  g_atomic_int_inc (&priv->stat_retries[reason]);
+}
 
-  switch (priv->type)
-    {
-    case FP_DEVICE_TYPE_USB:
-      if (!g_usb_device_open (priv->usb_device, &error))
-        {
-          g_task_return_error (task, error);
-          return;
-        }
-      break;
+void
+fpi_device_stats_ssm_restart (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-    case FP_DEVICE_TYPE_VIRTUAL:
-    case FP_DEVICE_TYPE_UDEV:
-      break;
+  g_atomic_int_inc (&priv->stat_ssm_restarts);
+}
 
-    default:
-      g_assert_not_reached ();
-      g_task_return_error (task, fpi_device_error_new (FP_DEVICE_ERROR_GENERAL));
-      return;
-    }
+void
+fpi_device_stats_match_attempted (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-  priv->current_action = FPI_DEVICE_ACTION_OPEN;
-  priv->current_task = g_steal_pointer (&task);
-  setup_task_cancellable (device);
-  fpi_device_report_finger_status (device, FP_FINGER_STATUS_NONE);
+  g_atomic_int_inc (&priv->stat_matches_attempted);
+}
+
+void
+fpi_device_stats_match_aborted (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-  FP_DEVICE_GET_CLASS (device)->open (device);
+  g_atomic_int_inc (&priv->stat_matches_aborted);
 }
 
 /**
- * fp_device_open_finish:
+ * fp_device_get_statistics:
  * @device: A #FpDevice
- * @result: A #GAsyncResult
- * @error: Return location for errors, or %NULL to ignore
+ * @stats: (out caller-allocates): Receives the counter snapshot
  *
- * Finish an asynchronous operation to open the device.
- * See fp_device_open().
+ * Retrieves the always-on operational counters accumulated since the
+ * device object was created: frames captured and dropped, retry
+ * conditions by reason, state machine restarts and match outcomes.
  *
- * Returns: (type void): %FALSE on error, %TRUE otherwise
+ * Unlike the tracing facilities these counters are never disabled;
+ * they are plain atomic increments on paths that move whole images, so
+ * the overhead is not measurable. Fleet monitoring can poll them to
+ * spot a degrading sensor early, e.g. a rising ratio of retries to
+ * captured frames.
+ *
+ * The counters keep accumulating over the lifetime of the device;
+ * @stats receives a snapshot.
  */
-gboolean
-fp_device_open_finish (FpDevice     *device,
-                       GAsyncResult *result,
-                       GError      **error)
+void
+fp_device_get_statistics (FpDevice *device, FpDeviceStatistics *stats)
 {
-  return g_task_propagate_boolean (G_TASK (result), error);
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  guint i;
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (stats != NULL);
+
+  stats->frames_captured = g_atomic_int_get (&priv->stat_frames_captured);
+  stats->frames_dropped = g_atomic_int_get (&priv->stat_frames_dropped);
+  for (i = 0; i < FP_DEVICE_STATISTICS_N_RETRY_REASONS; i++)
+    stats->retries[i] = g_atomic_int_get (&priv->stat_retries[i]);
+  stats->ssm_restarts = g_atomic_int_get (&priv->stat_ssm_restarts);
+  stats->matches_attempted = g_atomic_int_get (&priv->stat_matches_attempted);
+  stats->matches_aborted_early = g_atomic_int_get (&priv->stat_matches_aborted);
 }
 
 /**
- * fp_device_close:
- * @device: a #FpDevice
- * @cancellable: (nullable): a #GCancellable, or %NULL
- * @callback: the function to call on completion
- * @user_data: the data to pass to @callback
- *
- * Start an asynchronous operation to close the device. The callback will
- * be called once the operation has finished. Retrieve the result with
- * fp_device_close_finish().
+ * fp_device_set_idle_policy:
+ * @device: A #FpDevice
+ * @policy: The #FpIdlePolicy to use
+ * @timeout_ms: Time in milliseconds to keep the device warm after
+ *   fp_device_close(), or 0 for a built-in default
+ *
+ * Configure what happens to the hardware when the device is closed.
+ *
+ * With %FP_IDLE_POLICY_KEEP_WARM, fp_device_close() completes immediately
+ * and the hardware is kept initialized for @timeout_ms, so that a
+ * subsequent fp_device_open() within that window is instantaneous. Some
+ * devices re-negotiate encryption or re-calibrate on every open, which can
+ * take several hundred milliseconds; this policy avoids that cost for
+ * back-to-back uses. If no open happens within the timeout, the device is
+ * closed for real in the background.
+ *
+ * Switching back to %FP_IDLE_POLICY_DEFAULT closes a currently warm
+ * device immediately.
  */
 void
-fp_device_close (FpDevice           *device,
-                 GCancellable       *cancellable,
-                 GAsyncReadyCallback callback,
-                 gpointer            user_data)
+fp_device_set_idle_policy (FpDevice    *device,
+                           FpIdlePolicy policy,
+                           guint        timeout_ms)
 {
-  g_autoptr(GTask) task = NULL;
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  priv->idle_policy = policy;
+  priv->idle_timeout_ms = timeout_ms ? timeout_ms : DEFAULT_IDLE_WARM_SECONDS * 1000;
+
+  if (policy != FP_IDLE_POLICY_KEEP_WARM)
+    fp_device_warm_flush (device);
+}
+
+/* An operation that arrived while another one was still in flight.
+ * The original arguments are captured and the public entry point is
+ * simply called again once the device becomes free; any validation
+ * (device not open, unsupported feature, ...) happens at that point,
+ * exactly as if the caller had waited for the right moment. */
+struct _FpDeviceQueuedOp
+{
+  void (*invoke) (FpDevice         *device,
+                  FpDeviceQueuedOp *op);
+
+  GCancellable       *cancellable;
+  GAsyncReadyCallback callback;
+  gpointer            user_data;
+
+  /* Priority class recorded at queue time, see
+   * fp_device_set_background_ops(). */
+  gboolean            background;
+
+  /* Per-operation arguments; only the ones the operation uses are set. */
+  FpPrint         *print;
+  GPtrArray       *gallery;
+  gboolean         wait_for_finger;
+  FpEnrollProgress enroll_progress_cb;
+  gpointer         enroll_progress_data;
+  GDestroyNotify   enroll_progress_destroy;
+  FpMatchCb        match_cb;
+  gpointer         match_data;
+  GDestroyNotify   match_destroy;
+  guint            max_candidates;
+  FpListProgressCb list_cb;
+  gpointer         list_data;
+  GDestroyNotify   list_destroy;
+};
+
+static FpDeviceQueuedOp *
+fp_device_queued_op_new (void (*invoke) (FpDevice *, FpDeviceQueuedOp *),
+                         GCancellable       *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer            user_data)
+{
+  FpDeviceQueuedOp *op = g_new0 (FpDeviceQueuedOp, 1);
+
+  op->invoke = invoke;
+  op->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+  op->callback = callback;
+  op->user_data = user_data;
+
+  return op;
+}
+
+static void
+fp_device_queued_op_free (FpDeviceQueuedOp *op)
+{
+  g_clear_object (&op->cancellable);
+  g_clear_object (&op->print);
+  g_clear_pointer (&op->gallery, g_ptr_array_unref);
+  g_free (op);
+}
+
+/* Free an operation that is dropped without ever running, releasing the
+ * caller-supplied closures that the public entry point would otherwise
+ * have taken ownership of. */
+static void
+fp_device_queued_op_discard (FpDeviceQueuedOp *op)
+{
+  if (op->enroll_progress_destroy)
+    op->enroll_progress_destroy (op->enroll_progress_data);
+  if (op->match_destroy)
+    op->match_destroy (op->match_data);
+  if (op->list_destroy)
+    op->list_destroy (op->list_data);
+  fp_device_queued_op_free (op);
+}
+
+static gboolean
+fp_device_should_queue_op (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  /* Suspended devices keep failing with FP_DEVICE_ERROR_BUSY even with
+   * queueing enabled; there is no telling when (or if) a resume will
+   * come. Operations re-issued by the pump itself must not re-queue
+   * behind the entries still waiting after them. */
+  if (priv->op_queueing && !priv->is_suspended && !priv->op_pumping &&
+      (priv->current_task || !g_queue_is_empty (&priv->op_queue)))
+    return TRUE;
+
+  /* The operation is about to start; remember its priority class so a
+   * later interactive arrival can ask a background one to yield. */
+  priv->current_op_background = priv->ops_background;
+  return FALSE;
+}
+
+/* Enqueue @op honoring the priority classes: interactive operations
+ * are inserted ahead of any queued background entries (order stays
+ * FIFO within each class), and if a background operation currently
+ * holds the device it is asked to yield at its next SSM state
+ * boundary. */
+static void
+fp_device_queue_op (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  GList *sibling;
+
+  op->background = priv->ops_background;
+
+  if (op->background)
+    {
+      g_queue_push_tail (&priv->op_queue, op);
+      return;
+    }
+
+  for (sibling = priv->op_queue.head; sibling; sibling = sibling->next)
+    if (((FpDeviceQueuedOp *) sibling->data)->background)
+      break;
+
+  if (sibling)
+    g_queue_insert_before (&priv->op_queue, sibling, op);
+  else
+    g_queue_push_tail (&priv->op_queue, op);
+
+  if (priv->current_task && priv->current_op_background)
+    priv->preempt_requested = TRUE;
+}
+
+/**
+ * fp_device_set_op_queueing:
+ * @device: A #FpDevice
+ * @enabled: Whether to queue operations
+ *
+ * By default, starting an operation while another one is still running
+ * fails immediately with #FP_DEVICE_ERROR_BUSY. With queueing enabled,
+ * such operations are instead queued and started in FIFO order the
+ * moment the device becomes free, without an intermediate main loop
+ * iteration. This lets back-to-back operations (e.g. a verify issued
+ * while the previous one is still deactivating the sensor) begin as
+ * early as physically possible.
+ *
+ * Queued operations are validated when they actually start, so they can
+ * still fail in all the usual ways; a queued operation whose
+ * #GCancellable is cancelled while waiting returns %G_IO_ERROR_CANCELLED
+ * without ever touching the device. Operations started while the device
+ * is suspended keep failing with #FP_DEVICE_ERROR_BUSY regardless of
+ * this setting.
+ *
+ * Disabling queueing does not affect operations that are already queued.
+ */
+void
+fp_device_set_op_queueing (FpDevice *device,
+                           gboolean  enabled)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  priv->op_queueing = enabled;
+}
+
+/**
+ * fp_device_set_background_ops:
+ * @device: A #FpDevice
+ * @background: Whether operations started from now on are background ones
+ *
+ * Assigns a priority class to the operations started after this call.
+ * Background operations (maintenance such as template sync or storage
+ * garbage collection) queue behind every waiting interactive entry,
+ * and a running background operation is asked to yield at its next
+ * sequential-state-machine boundary when an interactive operation
+ * arrives; it then completes with %G_IO_ERROR_CANCELLED and can be
+ * retried later. An interactive operation therefore starts after at
+ * most one driver state of delay instead of waiting for the whole
+ * maintenance run.
+ *
+ * Only effective together with fp_device_set_op_queueing(); without
+ * queueing a busy device still fails new calls with
+ * #FP_DEVICE_ERROR_BUSY.
+ */
+void
+fp_device_set_background_ops (FpDevice *device,
+                              gboolean  background)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  priv->ops_background = background;
+}
+
+/* Called by the state machines at state boundaries: whether the
+ * running operation is a background one that should yield to a waiting
+ * interactive operation. One-shot, so the cleanup states running after
+ * the preemption error do not trip over it again. */
+gboolean
+fpi_device_should_preempt (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (!priv->preempt_requested || !priv->current_op_background)
+    return FALSE;
+
+  priv->preempt_requested = FALSE;
+  return TRUE;
+}
+
+/**
+ * fp_device_set_worker_thread:
+ * @device: A #FpDevice
+ * @enabled: Whether to run driver code on a dedicated thread
+ *
+ * By default all devices dispatch their driver code on the
+ * #GMainContext that was the thread-default one when each operation
+ * was started, typically one main loop shared by the whole
+ * application. With several devices capturing simultaneously, a slow
+ * driver callback on one device then delays frame handling on the
+ * others.
+ *
+ * With this setting enabled, a dedicated thread with its own
+ * #GMainContext is created when the device is opened, and all driver
+ * entry points, USB transfer completions and driver timeouts run
+ * there. Devices then scale independently across cores. Completion
+ * callbacks of the public API are unaffected and still arrive on the
+ * context the operation was started from; property notifications
+ * emitted by driver code, such as #FpDevice:finger-status, are however
+ * emitted from the worker thread.
+ *
+ * The setting must be changed while the device is closed and takes
+ * effect at the next fp_device_open(). The worker thread is kept
+ * across close/open cycles and only freed with the device object.
+ */
+void
+fp_device_set_worker_thread (FpDevice *device,
+                             gboolean  enabled)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (priv->is_open == FALSE);
+
+  priv->use_worker = enabled;
+}
+
+/**
+ * fp_device_set_thermal_throttling:
+ * @device: A #FpDevice
+ * @enabled: Whether to throttle on temperature
+ *
+ * The temperature model behind #FpDevice:temperature normally only acts
+ * once the device reaches %FP_TEMPERATURE_HOT, at which point running
+ * operations are cancelled with #FP_DEVICE_ERROR_TOO_HOT. For always-on
+ * deployments it is preferable to never get there.
+ *
+ * With thermal throttling enabled, queued maintenance operations
+ * (enroll, delete, listing and clearing storage) wait in the operation
+ * queue while the device is %FP_TEMPERATURE_WARM and resume once it has
+ * cooled down to %FP_TEMPERATURE_COLD; interactive operations are
+ * unaffected. While the device is %FP_TEMPERATURE_HOT all queued
+ * operations wait instead of failing. Drivers that poll for finger
+ * presence additionally stretch their polling interval while warm.
+ *
+ * This only changes when queued operations start, so it is mostly
+ * useful together with fp_device_set_op_queueing().
+ */
+void
+fp_device_set_thermal_throttling (FpDevice *device,
+                                  gboolean  enabled)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  priv->temp_throttle = enabled;
+}
+
+/**
+ * fp_device_set_resume_on_retry:
+ * @device: A #FpDevice
+ * @enabled: Whether to keep operations running across retryable errors
+ *
+ * By default a verify or identify operation completes with the
+ * #FP_DEVICE_RETRY error when a scan fails in a retryable way (short
+ * swipe, finger off center), and the application starts a new
+ * operation. On devices that need a full deactivation/reactivation
+ * cycle between operations this adds hundreds of milliseconds before
+ * the next swipe is accepted, and users routinely swipe again into a
+ * dead sensor.
+ *
+ * With this setting enabled, image devices report retryable errors
+ * through the #FpMatchCb callback and keep the sensor armed for the
+ * next swipe within the same operation; the operation only completes
+ * with a conclusive match result or a fatal error. Applications using
+ * this must watch the match callback for retry errors to give user
+ * feedback.
+ *
+ * Devices that match on-chip are not affected by this setting.
+ */
+void
+fp_device_set_resume_on_retry (FpDevice *device,
+                               gboolean  enabled)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  priv->resume_on_retry = enabled;
+}
+
+/**
+ * fp_device_set_enroll_duplicates_gallery:
+ * @device: A #FpDevice
+ * @prints: (nullable) (element-type FpPrint): Enrolled prints to screen
+ *   against, or %NULL to disable the screen
+ *
+ * Provide the prints already enrolled in the application's storage so
+ * that software-matched enrollment can refuse re-enrolling a finger
+ * that is already in there. Each good enroll stage is screened with a
+ * cheap prefilter ranking and at most one full comparison, so the cost
+ * does not grow with the gallery the way running a separate
+ * fp_device_identify() per stage would. A detected duplicate fails the
+ * enrollment with #FP_DEVICE_ERROR_DATA_DUPLICATE.
+ *
+ * This only applies to devices that match on the host; devices with
+ * %FP_DEVICE_FEATURE_DUPLICATES_CHECK detect duplicates natively
+ * against their internal storage and ignore this gallery.
+ *
+ * The gallery stays set until replaced or cleared.
+ */
+void
+fp_device_set_enroll_duplicates_gallery (FpDevice  *device,
+                                         GPtrArray *prints)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  g_clear_pointer (&priv->enroll_duplicates_gallery, g_ptr_array_unref);
+  if (prints)
+    priv->enroll_duplicates_gallery = g_ptr_array_ref (prints);
+}
+
+/* Start the next queued operation, if any. Called from the task return
+ * path in fpi-device.c right after the finished task has been
+ * completed. */
+void
+fpi_device_pump_op_queue (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpDeviceQueuedOp *op;
+
+  /* An operation may finish synchronously (e.g. opening a warm device,
+   * or failing validation); in that case keep going so the queue cannot
+   * stall behind it. */
+  while (!priv->current_task && !priv->is_suspended &&
+         (op = g_queue_peek_head (&priv->op_queue)))
+    {
+      if (fp_device_op_deferred_by_temp (device, op))
+        {
+          g_debug ("Deferring queued operation until the device cools down");
+          break;
+        }
+      g_queue_pop_head (&priv->op_queue);
+
+      g_debug ("Starting queued operation, %u more pending",
+               g_queue_get_length (&priv->op_queue));
+
+      priv->op_pumping = TRUE;
+      op->invoke (device, op);
+      priv->op_pumping = FALSE;
+      /* The invoked entry point recorded the live ops_background
+       * setting; what matters is the class recorded at queue time. */
+      priv->current_op_background = op->background;
+      fp_device_queued_op_free (op);
+    }
+}
+
+static void
+fp_device_queued_open (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_open (device, op->cancellable, op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_close (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_close (device, op->cancellable, op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_enroll (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_enroll (device, op->print, op->cancellable,
+                    op->enroll_progress_cb, op->enroll_progress_data,
+                    op->enroll_progress_destroy,
+                    op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_verify (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_verify (device, op->print, op->cancellable,
+                    op->match_cb, op->match_data, op->match_destroy,
+                    op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_verify_multi (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_verify_multi (device, op->gallery, op->cancellable,
+                          op->match_cb, op->match_data, op->match_destroy,
+                          op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_identify (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_identify_internal (device, op->gallery, op->max_candidates,
+                               op->cancellable,
+                               op->match_cb, op->match_data, op->match_destroy,
+                               op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_capture (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_capture (device, op->wait_for_finger, op->cancellable,
+                     op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_delete_print (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_delete_print (device, op->print, op->cancellable,
+                          op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_delete_prints (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_delete_prints (device, op->gallery, op->cancellable,
+                           op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_list_prints (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_list_prints (device, op->cancellable, op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_list_prints_full (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_list_prints_full (device, op->list_cb, op->list_data,
+                              op->list_destroy, op->cancellable,
+                              op->callback, op->user_data);
+}
+
+static void
+fp_device_queued_clear_storage (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  fp_device_clear_storage (device, op->cancellable, op->callback, op->user_data);
+}
+
+/* With thermal throttling enabled, queued maintenance operations wait
+ * until the temperature model returns to COLD instead of pushing a warm
+ * device towards the hard stop; once the device reports HOT everything
+ * waits, since starting an operation would only fail with
+ * FP_DEVICE_ERROR_TOO_HOT anyway. Interactive entries are queued
+ * ahead of background ones, so only a deferred interactive head holds
+ * them back. The pump is re-run from the temperature model on every
+ * downward transition. */
+static gboolean
+fp_device_op_deferred_by_temp (FpDevice *device, FpDeviceQueuedOp *op)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (!priv->temp_throttle || priv->temp_current == FP_TEMPERATURE_COLD)
+    return FALSE;
+
+  if (priv->temp_current == FP_TEMPERATURE_HOT)
+    return TRUE;
+
+  return op->invoke == fp_device_queued_enroll ||
+         op->invoke == fp_device_queued_delete_print ||
+         op->invoke == fp_device_queued_delete_prints ||
+         op->invoke == fp_device_queued_list_prints ||
+         op->invoke == fp_device_queued_list_prints_full ||
+         op->invoke == fp_device_queued_clear_storage;
+}
+
+/**
+ * fp_device_supports_identify:
+ * @device: A #FpDevice
+ *
+ * Check whether the device supports identification.
+ *
+ * Returns: Whether the device supports identification
+ * Deprecated: 1.92.0: Use fp_device_has_feature() instead.
+ */
+gboolean
+fp_device_supports_identify (FpDevice *device)
+{
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  return cls->identify && !!(priv->features & FP_DEVICE_FEATURE_IDENTIFY);
+}
+
+/**
+ * fp_device_supports_capture:
+ * @device: A #FpDevice
+ *
+ * Check whether the device supports capturing images.
+ *
+ * Returns: Whether the device supports image capture
+ * Deprecated: 1.92.0: Use fp_device_has_feature() instead.
+ */
+gboolean
+fp_device_supports_capture (FpDevice *device)
+{
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  return cls->capture && !!(priv->features & FP_DEVICE_FEATURE_CAPTURE);
+}
+
+/**
+ * fp_device_has_storage:
+ * @device: A #FpDevice
+ *
+ * Whether the device has on-chip storage. If it has, you can list the
+ * prints stored on the with fp_device_list_prints() and you should
+ * always delete prints from the device again using
+ * fp_device_delete_print().
+ * Deprecated: 1.92.0: Use fp_device_has_feature() instead.
+ */
+gboolean
+fp_device_has_storage (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  return !!(priv->features & FP_DEVICE_FEATURE_STORAGE);
+}
+
+/**
+ * fp_device_open:
+ * @device: a #FpDevice
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to open the device. The callback will
+ * be called once the operation has finished. Retrieve the result with
+ * fp_device_open_finish().
+ */
+void
+fp_device_open (FpDevice           *device,
+                GCancellable       *cancellable,
+                GAsyncReadyCallback callback,
+                gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  GError *error = NULL;
+
+  if (fp_device_should_queue_op (device))
+    {
+      fp_device_queue_op (device,
+                          fp_device_queued_op_new (fp_device_queued_open,
+                                                   cancellable, callback, user_data));
+      return;
+    }
+
+  task = g_task_new (device, cancellable, callback, user_data);
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (priv->is_open)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_ALREADY_OPEN));
+      return;
+    }
+
+  if (priv->current_task || priv->is_suspended)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_BUSY));
+      return;
+    }
+
+  /* A warm device is still physically open, just hand it back. */
+  if (priv->is_warm)
+    {
+      g_clear_pointer (&priv->warm_timeout, g_source_destroy);
+      priv->is_warm = FALSE;
+      priv->is_open = TRUE;
+      g_object_notify (G_OBJECT (device), "open");
+      fpi_device_report_finger_status (device, FP_FINGER_STATUS_NONE);
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  switch (priv->type)
+    {
+    case FP_DEVICE_TYPE_USB:
+      if (!g_usb_device_open (priv->usb_device, &error))
+        {
+          g_task_return_error (task, error);
+          return;
+        }
+      break;
+
+    case FP_DEVICE_TYPE_VIRTUAL:
+    case FP_DEVICE_TYPE_UDEV:
+      break;
+
+    default:
+      g_assert_not_reached ();
+      g_task_return_error (task, fpi_device_error_new (FP_DEVICE_ERROR_GENERAL));
+      return;
+    }
+
+  priv->current_action = FPI_DEVICE_ACTION_OPEN;
+  priv->current_task = g_steal_pointer (&task);
+  setup_task_cancellable (device);
+  fpi_device_report_finger_status (device, FP_FINGER_STATUS_NONE);
+
+  fp_device_worker_start (device);
+  fpi_device_invoke_driver (device, FP_DEVICE_GET_CLASS (device)->open);
+}
+
+/**
+ * fp_device_open_finish:
+ * @device: A #FpDevice
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous operation to open the device.
+ * See fp_device_open().
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_open_finish (FpDevice     *device,
+                       GAsyncResult *result,
+                       GError      **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * fp_device_close:
+ * @device: a #FpDevice
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to close the device. The callback will
+ * be called once the operation has finished. Retrieve the result with
+ * fp_device_close_finish().
+ */
+void
+fp_device_close (FpDevice           *device,
+                 GCancellable       *cancellable,
+                 GAsyncReadyCallback callback,
+                 gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  if (fp_device_should_queue_op (device))
+    {
+      fp_device_queue_op (device,
+                          fp_device_queued_op_new (fp_device_queued_close,
+                                                   cancellable, callback, user_data));
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -923,11 +1884,31 @@ fp_device_close (FpDevice           *device,
       return;
     }
 
+  /* With the keep-warm policy the close is only deferred; the driver
+   * stays initialized until the idle timeout expires or the device is
+   * opened again. */
+  if (priv->idle_policy == FP_IDLE_POLICY_KEEP_WARM && !priv->is_removed)
+    {
+      priv->is_open = FALSE;
+      priv->is_warm = TRUE;
+      g_object_notify (G_OBJECT (device), "open");
+      fpi_device_report_finger_status (device, FP_FINGER_STATUS_NONE);
+
+      g_clear_pointer (&priv->warm_timeout, g_source_destroy);
+      priv->warm_timeout = fpi_device_add_timeout (device,
+                                                   priv->idle_timeout_ms,
+                                                   fp_device_warm_timeout_cb,
+                                                   NULL, NULL);
+
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
   priv->current_action = FPI_DEVICE_ACTION_CLOSE;
   priv->current_task = g_steal_pointer (&task);
   setup_task_cancellable (device);
 
-  FP_DEVICE_GET_CLASS (device)->close (device);
+  fpi_device_invoke_driver (device, FP_DEVICE_GET_CLASS (device)->close);
 }
 
 /**
@@ -1126,6 +2107,21 @@ fp_device_enroll (FpDevice           *device,
   FpEnrollData *data;
   FpiPrintType print_type;
 
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_enroll,
+                                    cancellable, callback, user_data);
+      op->print = FP_IS_PRINT (template_print) ?
+                  g_object_ref_sink (template_print) : NULL;
+      op->enroll_progress_cb = progress_cb;
+      op->enroll_progress_data = progress_data;
+      op->enroll_progress_destroy = progress_destroy;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1193,7 +2189,7 @@ fp_device_enroll (FpDevice           *device,
   // Attach the progress data as task data so that it is destroyed
   g_task_set_task_data (priv->current_task, data, (GDestroyNotify) enroll_data_free);
 
-  FP_DEVICE_GET_CLASS (device)->enroll (device);
+  fpi_device_invoke_driver (device, FP_DEVICE_GET_CLASS (device)->enroll);
 }
 
 /**
@@ -1247,6 +2243,21 @@ fp_device_verify (FpDevice           *device,
   FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
   FpMatchData *data;
 
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_verify,
+                                    cancellable, callback, user_data);
+      op->print = FP_IS_PRINT (enrolled_print) ?
+                  g_object_ref (enrolled_print) : NULL;
+      op->match_cb = match_cb;
+      op->match_data = match_data;
+      op->match_destroy = match_destroy;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1294,7 +2305,125 @@ fp_device_verify (FpDevice           *device,
   // Attach the match data as task data so that it is destroyed
   g_task_set_task_data (priv->current_task, data, (GDestroyNotify) match_data_free);
 
-  cls->verify (device);
+  fpi_device_invoke_driver (device, cls->verify);
+}
+
+/**
+ * fp_device_verify_multi:
+ * @device: a #FpDevice
+ * @enrolled_prints: (element-type FpPrint) (transfer none): The enrolled prints, one per finger
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @match_cb: (nullable) (scope notified): match reporting callback
+ * @match_data: (closure match_cb): user data for @match_cb
+ * @match_destroy: (destroy match_data): Destroy notify for @match_data
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to verify several enrolled prints in
+ * one transaction, e.g. two fingers of the same user for high-security
+ * setups. The prints are verified one after another without
+ * deactivating the sensor in between, so the transaction is roughly as
+ * fast as the scans themselves rather than paying a full
+ * activation cycle per finger.
+ *
+ * The fused decision is conjunctive: the operation succeeds only when
+ * every print matched, and a non-match of any finger ends it
+ * immediately. @match_cb is called once per finger, so user interfaces
+ * can prompt for the next finger as each one passes. Retrieve the
+ * result with fp_device_verify_multi_finish().
+ */
+void
+fp_device_verify_multi (FpDevice           *device,
+                        GPtrArray          *enrolled_prints,
+                        GCancellable       *cancellable,
+                        FpMatchCb           match_cb,
+                        gpointer            match_data,
+                        GDestroyNotify      match_destroy,
+                        GAsyncReadyCallback callback,
+                        gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
+  FpMatchData *data;
+  guint i;
+
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_verify_multi,
+                                    cancellable, callback, user_data);
+      op->gallery = enrolled_prints ? g_ptr_array_ref (enrolled_prints) : NULL;
+      op->match_cb = match_cb;
+      op->match_data = match_data;
+      op->match_destroy = match_destroy;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
+  task = g_task_new (device, cancellable, callback, user_data);
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (!enrolled_prints || enrolled_prints->len == 0)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new_msg (FP_DEVICE_ERROR_DATA_INVALID,
+                                                     "No prints to verify against"));
+      return;
+    }
+
+  if (!priv->is_open)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_NOT_OPEN));
+      return;
+    }
+
+  if (priv->current_task || priv->is_suspended)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_BUSY));
+      return;
+    }
+
+  if (!cls->verify || !(priv->features & FP_DEVICE_FEATURE_VERIFY))
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                                     "Device has no verification support"));
+      return;
+    }
+
+  priv->current_action = FPI_DEVICE_ACTION_VERIFY;
+  priv->current_task = g_steal_pointer (&task);
+  setup_task_cancellable (device);
+
+  fpi_device_update_temp (device, TRUE);
+  if (priv->temp_current == FP_TEMPERATURE_HOT)
+    {
+      g_task_return_error (task, fpi_device_error_new (FP_DEVICE_ERROR_TOO_HOT));
+      fpi_device_update_temp (device, FALSE);
+      return;
+    }
+
+  data = g_new0 (FpMatchData, 1);
+  /* Copy for the same reason fp_device_identify() copies its gallery. */
+  data->multi_prints = g_ptr_array_new_full (enrolled_prints->len,
+                                             g_object_unref);
+  for (i = 0; i < enrolled_prints->len; i++)
+    g_ptr_array_add (data->multi_prints,
+                     g_object_ref (g_ptr_array_index (enrolled_prints, i)));
+  data->enrolled_print = g_object_ref (g_ptr_array_index (data->multi_prints, 0));
+  data->match_cb = match_cb;
+  data->match_data = match_data;
+  data->match_destroy = match_destroy;
+
+  // Attach the match data as task data so that it is destroyed
+  g_task_set_task_data (priv->current_task, data, (GDestroyNotify) match_data_free);
+
+  fpi_device_invoke_driver (device, cls->verify);
 }
 
 /**
@@ -1344,29 +2473,40 @@ fp_device_verify_finish (FpDevice     *device,
 }
 
 /**
- * fp_device_identify:
- * @device: a #FpDevice
- * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
- * @cancellable: (nullable): a #GCancellable, or %NULL
- * @match_cb: (nullable) (scope notified): match reporting callback
- * @match_data: (closure match_cb): user data for @match_cb
- * @match_destroy: (destroy match_data): Destroy notify for @match_data
- * @callback: the function to call on completion
- * @user_data: the data to pass to @callback
+ * fp_device_verify_multi_finish:
+ * @device: A #FpDevice
+ * @result: A #GAsyncResult
+ * @match: (out): Whether every requested finger matched
+ * @print: (out) (transfer full) (nullable): Location to store the last scanned print, or %NULL to ignore
+ * @error: Return location for errors, or %NULL to ignore
  *
- * Start an asynchronous operation to identify prints. The callback will
- * be called once the operation has finished. Retrieve the result with
- * fp_device_identify_finish().
+ * Finish an asynchronous operation to verify several enrolled prints.
+ * @match is only %TRUE when all of them matched.
+ *
+ * See fp_device_verify_multi().
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
  */
-void
-fp_device_identify (FpDevice           *device,
-                    GPtrArray          *prints,
-                    GCancellable       *cancellable,
-                    FpMatchCb           match_cb,
-                    gpointer            match_data,
-                    GDestroyNotify      match_destroy,
-                    GAsyncReadyCallback callback,
-                    gpointer            user_data)
+gboolean
+fp_device_verify_multi_finish (FpDevice     *device,
+                               GAsyncResult *result,
+                               gboolean     *match,
+                               FpPrint     **print,
+                               GError      **error)
+{
+  return fp_device_verify_finish (device, result, match, print, error);
+}
+
+static void
+fp_device_identify_internal (FpDevice           *device,
+                             GPtrArray          *prints,
+                             guint               max_candidates,
+                             GCancellable       *cancellable,
+                             FpMatchCb           match_cb,
+                             gpointer            match_data,
+                             GDestroyNotify      match_destroy,
+                             GAsyncReadyCallback callback,
+                             gpointer            user_data)
 {
   g_autoptr(GTask) task = NULL;
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
@@ -1374,6 +2514,21 @@ fp_device_identify (FpDevice           *device,
   FpMatchData *data;
   int i;
 
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_identify,
+                                    cancellable, callback, user_data);
+      op->gallery = prints ? g_ptr_array_ref (prints) : NULL;
+      op->match_cb = match_cb;
+      op->match_data = match_data;
+      op->match_destroy = match_destroy;
+      op->max_candidates = max_candidates;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1423,11 +2578,84 @@ fp_device_identify (FpDevice           *device,
   data->match_cb = match_cb;
   data->match_data = match_data;
   data->match_destroy = match_destroy;
+  data->max_candidates = max_candidates;
 
   // Attach the match data as task data so that it is destroyed
   g_task_set_task_data (priv->current_task, data, (GDestroyNotify) match_data_free);
 
-  cls->identify (device);
+  fpi_device_invoke_driver (device, cls->identify);
+}
+
+/**
+ * fp_device_identify:
+ * @device: a #FpDevice
+ * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @match_cb: (nullable) (scope notified): match reporting callback
+ * @match_data: (closure match_cb): user data for @match_cb
+ * @match_destroy: (destroy match_data): Destroy notify for @match_data
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to identify prints. The callback will
+ * be called once the operation has finished. Retrieve the result with
+ * fp_device_identify_finish().
+ */
+void
+fp_device_identify (FpDevice           *device,
+                    GPtrArray          *prints,
+                    GCancellable       *cancellable,
+                    FpMatchCb           match_cb,
+                    gpointer            match_data,
+                    GDestroyNotify      match_destroy,
+                    GAsyncReadyCallback callback,
+                    gpointer            user_data)
+{
+  fp_device_identify_internal (device, prints, 0, cancellable,
+                               match_cb, match_data, match_destroy,
+                               callback, user_data);
+}
+
+/**
+ * fp_device_identify_full:
+ * @device: a #FpDevice
+ * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
+ * @max_candidates: Maximum number of ranked candidates to report
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @match_cb: (nullable) (scope notified): match reporting callback
+ * @match_data: (closure match_cb): user data for @match_cb
+ * @match_destroy: (destroy match_data): Destroy notify for @match_data
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Like fp_device_identify(), but additionally collects up to
+ * @max_candidates ranked #FpIdentifyCandidate entries with their raw
+ * matcher scores, best first, for callers that fuse fingerprint
+ * similarity with other factors instead of acting on the single best
+ * match. The candidate list may include gallery prints below the match
+ * threshold; the conventional match result is unaffected.
+ *
+ * Ranking requires scoring the whole gallery, so unlike
+ * fp_device_identify() the scan cannot stop at the first match.
+ * Devices that match on-chip report no candidates. Retrieve the result
+ * with fp_device_identify_full_finish().
+ */
+void
+fp_device_identify_full (FpDevice           *device,
+                         GPtrArray          *prints,
+                         guint               max_candidates,
+                         GCancellable       *cancellable,
+                         FpMatchCb           match_cb,
+                         gpointer            match_data,
+                         GDestroyNotify      match_destroy,
+                         GAsyncReadyCallback callback,
+                         gpointer            user_data)
+{
+  g_return_if_fail (max_candidates > 0);
+
+  fp_device_identify_internal (device, prints, max_candidates, cancellable,
+                               match_cb, match_data, match_destroy,
+                               callback, user_data);
 }
 
 /**
@@ -1468,12 +2696,52 @@ fp_device_identify_finish (FpDevice     *device,
     }
   if (match)
     {
-      *match = data ? data->match : NULL;
-      if (*match)
-        g_object_ref (*match);
+      *match = data ? data->match : NULL;
+      if (*match)
+        g_object_ref (*match);
+    }
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * fp_device_identify_full_finish:
+ * @device: A #FpDevice
+ * @result: A #GAsyncResult
+ * @match: (out) (transfer full) (nullable): Location for the matched #FpPrint, or %NULL
+ * @print: (out) (transfer full) (nullable): Location for the new #FpPrint, or %NULL
+ * @candidates: (out) (transfer full) (nullable) (element-type FpIdentifyCandidate):
+ *   Location for the ranked candidate list, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous operation started with
+ * fp_device_identify_full(). In addition to the
+ * fp_device_identify_finish() results, @candidates receives the ranked
+ * #FpIdentifyCandidate list, best score first, or %NULL when the
+ * matcher reported none. The array owns its entries and the print
+ * references they hold.
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_identify_full_finish (FpDevice     *device,
+                                GAsyncResult *result,
+                                FpPrint     **match,
+                                FpPrint     **print,
+                                GPtrArray   **candidates,
+                                GError      **error)
+{
+  if (candidates)
+    {
+      FpMatchData *data;
+
+      data = g_task_get_task_data (G_TASK (result));
+
+      *candidates = data && data->candidates ?
+                    g_ptr_array_ref (data->candidates) : NULL;
     }
 
-  return g_task_propagate_boolean (G_TASK (result), error);
+  return fp_device_identify_finish (device, result, match, print, error);
 }
 
 /**
@@ -1499,6 +2767,17 @@ fp_device_capture (FpDevice           *device,
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
   FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
 
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_capture,
+                                    cancellable, callback, user_data);
+      op->wait_for_finger = wait_for_finger;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1539,7 +2818,7 @@ fp_device_capture (FpDevice           *device,
 
   priv->wait_for_finger = wait_for_finger;
 
-  cls->capture (device);
+  fpi_device_invoke_driver (device, cls->capture);
 }
 
 /**
@@ -1564,6 +2843,147 @@ fp_device_capture_finish (FpDevice     *device,
   return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+static void
+fp_device_capture_stream_teardown (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  GDestroyNotify destroy = priv->capture_stream_destroy;
+  gpointer data = priv->capture_stream_data;
+
+  priv->capture_stream_active = FALSE;
+  priv->capture_stream_cb = NULL;
+  priv->capture_stream_data = NULL;
+  priv->capture_stream_destroy = NULL;
+  g_clear_object (&priv->capture_stream_cancellable);
+
+  if (destroy)
+    destroy (data);
+}
+
+static void
+fp_device_capture_stream_cb (GObject      *source_object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  FpDevice *device = FP_DEVICE (source_object);
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_autoptr(FpImage) image = NULL;
+  g_autoptr(GError) error = NULL;
+
+  image = fp_device_capture_finish (device, result, &error);
+
+  if (!priv->capture_stream_active)
+    {
+      /* Stopped while this frame was in flight; the result (usually a
+       * cancellation) is of no interest anymore. */
+      fp_device_capture_stream_teardown (device);
+      return;
+    }
+
+  priv->capture_stream_cb (device, image, error,
+                           priv->capture_stream_data);
+
+  /* The frame callback may have stopped the stream. */
+  if (!priv->capture_stream_active)
+    {
+      fp_device_capture_stream_teardown (device);
+      return;
+    }
+
+  if (error && error->domain != FP_DEVICE_RETRY)
+    {
+      fp_device_capture_stream_teardown (device);
+      return;
+    }
+
+  fp_device_capture (device,
+                     priv->capture_stream_wait_for_finger,
+                     priv->capture_stream_cancellable,
+                     fp_device_capture_stream_cb,
+                     NULL);
+}
+
+/**
+ * fp_device_capture_stream_start:
+ * @device: a #FpDevice
+ * @wait_for_finger: Whether to wait for a finger or not
+ * @cancellable: (nullable): a #GCancellable for the whole stream, or %NULL
+ * @frame_cb: (scope notified): the function to call for each frame
+ * @user_data: the data to pass to @frame_cb
+ * @destroy: (nullable): Destroy notify for @user_data
+ *
+ * Start a continuous capture stream. Frames are delivered through
+ * @frame_cb as soon as the device produces them; after each frame the
+ * next capture is issued immediately, without the caller having to
+ * schedule individual fp_device_capture() operations.
+ *
+ * Retry errors (%FP_DEVICE_RETRY) are reported through @frame_cb and the
+ * stream keeps running. Any other error — including the device not being
+ * open or being busy — is reported through @frame_cb and ends the stream.
+ *
+ * Delivered images are reference counted; hold on to a frame past the
+ * callback with g_object_ref() rather than copying it.
+ *
+ * Stop the stream with fp_device_capture_stream_stop() or by cancelling
+ * @cancellable.
+ */
+void
+fp_device_capture_stream_start (FpDevice                     *device,
+                                gboolean                      wait_for_finger,
+                                GCancellable                 *cancellable,
+                                FpDeviceCaptureStreamCallback frame_cb,
+                                gpointer                      user_data,
+                                GDestroyNotify                destroy)
+{
+  FpDevicePrivate *priv;
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (frame_cb != NULL);
+
+  priv = fp_device_get_instance_private (device);
+  g_return_if_fail (!priv->capture_stream_active);
+
+  priv->capture_stream_active = TRUE;
+  priv->capture_stream_wait_for_finger = wait_for_finger;
+  priv->capture_stream_cancellable =
+    cancellable ? g_object_ref (cancellable) : g_cancellable_new ();
+  priv->capture_stream_cb = frame_cb;
+  priv->capture_stream_data = user_data;
+  priv->capture_stream_destroy = destroy;
+
+  fp_device_capture (device,
+                     wait_for_finger,
+                     priv->capture_stream_cancellable,
+                     fp_device_capture_stream_cb,
+                     NULL);
+}
+
+/**
+ * fp_device_capture_stream_stop:
+ * @device: a #FpDevice
+ *
+ * Stop a capture stream started with fp_device_capture_stream_start().
+ * The in-flight capture is cancelled and no further frames are
+ * delivered; the frame callback is not called for the cancellation.
+ *
+ * This is safe to call from within the frame callback.
+ */
+void
+fp_device_capture_stream_stop (FpDevice *device)
+{
+  FpDevicePrivate *priv;
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  priv = fp_device_get_instance_private (device);
+  if (!priv->capture_stream_active)
+    return;
+
+  priv->capture_stream_active = FALSE;
+  g_cancellable_cancel (priv->capture_stream_cancellable);
+}
+
 /**
  * fp_device_delete_print:
  * @device: a #FpDevice
@@ -1590,6 +3010,18 @@ fp_device_delete_print (FpDevice           *device,
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
   FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
 
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_delete_print,
+                                    cancellable, callback, user_data);
+      op->print = FP_IS_PRINT (enrolled_print) ?
+                  g_object_ref (enrolled_print) : NULL;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1623,7 +3055,7 @@ fp_device_delete_print (FpDevice           *device,
                         g_object_ref (enrolled_print),
                         g_object_unref);
 
-  cls->delete (device);
+  fpi_device_invoke_driver (device, cls->delete);
 }
 
 /**
@@ -1646,6 +3078,117 @@ fp_device_delete_print_finish (FpDevice     *device,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/**
+ * fp_device_delete_prints:
+ * @device: a #FpDevice
+ * @enrolled_prints: (element-type FpPrint) (transfer none): #FpPrint's to delete
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to delete several prints from the
+ * device. The callback will be called once the operation has finished.
+ * Retrieve the result with fp_device_delete_prints_finish().
+ *
+ * The prints are deleted within a single operation: the driver is
+ * re-invoked for each print without deactivating the device in between,
+ * which avoids the per-operation overhead of calling
+ * fp_device_delete_print() once per print. The operation fails on the
+ * first print that cannot be deleted; prints earlier in the array will
+ * already have been removed at that point.
+ *
+ * To wipe the whole storage, fp_device_clear_storage() is preferable as
+ * drivers may implement it with a single bulk-erase command.
+ */
+void
+fp_device_delete_prints (FpDevice           *device,
+                         GPtrArray          *enrolled_prints,
+                         GCancellable       *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
+  guint i;
+
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_delete_prints,
+                                    cancellable, callback, user_data);
+      op->gallery = enrolled_prints ? g_ptr_array_ref (enrolled_prints) : NULL;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
+  task = g_task_new (device, cancellable, callback, user_data);
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (!priv->is_open)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_NOT_OPEN));
+      return;
+    }
+
+  if (priv->current_task || priv->is_suspended)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_BUSY));
+      return;
+    }
+
+  /* Succeed immediately if delete is not implemented or there is
+   * nothing to do. */
+  if (!cls->delete || !(priv->features & FP_DEVICE_FEATURE_STORAGE_DELETE) ||
+      !enrolled_prints || enrolled_prints->len == 0)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  priv->current_action = FPI_DEVICE_ACTION_DELETE;
+  priv->current_task = g_steal_pointer (&task);
+  setup_task_cancellable (device);
+
+  /* Copy for the same reason fp_device_identify() copies its gallery. */
+  priv->delete_prints = g_ptr_array_new_full (enrolled_prints->len,
+                                              g_object_unref);
+  for (i = 0; i < enrolled_prints->len; i++)
+    g_ptr_array_add (priv->delete_prints,
+                     g_object_ref (g_ptr_array_index (enrolled_prints, i)));
+  priv->delete_stage = 0;
+
+  g_task_set_task_data (priv->current_task,
+                        g_object_ref (g_ptr_array_index (priv->delete_prints, 0)),
+                        g_object_unref);
+
+  fpi_device_invoke_driver (device, cls->delete);
+}
+
+/**
+ * fp_device_delete_prints_finish:
+ * @device: A #FpDevice
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous operation to delete several enrolled prints.
+ *
+ * See fp_device_delete_prints().
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_delete_prints_finish (FpDevice     *device,
+                                GAsyncResult *result,
+                                GError      **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 /**
  * fp_device_list_prints:
  * @device: a #FpDevice
@@ -1668,6 +3211,14 @@ fp_device_list_prints (FpDevice           *device,
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
   FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
 
+  if (fp_device_should_queue_op (device))
+    {
+      fp_device_queue_op (device,
+                          fp_device_queued_op_new (fp_device_queued_list_prints,
+                                                   cancellable, callback, user_data));
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1698,7 +3249,11 @@ fp_device_list_prints (FpDevice           *device,
   priv->current_task = g_steal_pointer (&task);
   setup_task_cancellable (device);
 
-  cls->list (device);
+  g_task_set_task_data (priv->current_task,
+                        g_new0 (FpListData, 1),
+                        (GDestroyNotify) list_data_free);
+
+  fpi_device_invoke_driver (device, cls->list);
 }
 
 /**
@@ -1721,6 +3276,122 @@ fp_device_list_prints_finish (FpDevice     *device,
   return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+/**
+ * fp_device_list_prints_full:
+ * @device: a #FpDevice
+ * @progress_cb: (scope notified): a #FpListProgressCb to report listed prints
+ * @progress_data: user data for @progress_cb
+ * @progress_destroy: (destroy progress_data): Destroy notify for @progress_data
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to list all prints stored on the
+ * device, streaming them to @progress_cb in chunks as the protocol
+ * responses arrive rather than collecting the complete list first. The
+ * first prints become available without waiting for the full
+ * enumeration, and memory use stays bounded by the chunk size even on
+ * sensors holding hundreds of templates.
+ *
+ * Streamed prints are not retained by libfprint; once the operation
+ * has finished, retrieve the result with
+ * fp_device_list_prints_full_finish().
+ *
+ * Streaming granularity is up to the driver: drivers that fetch the
+ * whole list in one protocol exchange report a single chunk.
+ */
+void
+fp_device_list_prints_full (FpDevice           *device,
+                            FpListProgressCb    progress_cb,
+                            gpointer            progress_data,
+                            GDestroyNotify      progress_destroy,
+                            GCancellable       *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
+  FpListData *data;
+
+  if (fp_device_should_queue_op (device))
+    {
+      FpDeviceQueuedOp *op;
+
+      op = fp_device_queued_op_new (fp_device_queued_list_prints_full,
+                                    cancellable, callback, user_data);
+      op->list_cb = progress_cb;
+      op->list_data = progress_data;
+      op->list_destroy = progress_destroy;
+      fp_device_queue_op (device, op);
+      return;
+    }
+
+  task = g_task_new (device, cancellable, callback, user_data);
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (!priv->is_open)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_NOT_OPEN));
+      return;
+    }
+
+  if (priv->current_task || priv->is_suspended)
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new (FP_DEVICE_ERROR_BUSY));
+      return;
+    }
+
+  if (!cls->list || !(priv->features & FP_DEVICE_FEATURE_STORAGE))
+    {
+      g_task_return_error (task,
+                           fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                                     "Device has no storage"));
+      return;
+    }
+
+  priv->current_action = FPI_DEVICE_ACTION_LIST;
+  priv->current_task = g_steal_pointer (&task);
+  setup_task_cancellable (device);
+
+  data = g_new0 (FpListData, 1);
+  data->list_cb = progress_cb;
+  data->list_data = progress_data;
+  data->list_destroy = progress_destroy;
+  g_task_set_task_data (priv->current_task, data,
+                        (GDestroyNotify) list_data_free);
+
+  fpi_device_invoke_driver (device, cls->list);
+}
+
+/**
+ * fp_device_list_prints_full_finish:
+ * @device: A #FpDevice
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous operation to list all device stored prints.
+ * The prints themselves were delivered to the progress callback.
+ *
+ * See fp_device_list_prints_full().
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_list_prints_full_finish (FpDevice     *device,
+                                   GAsyncResult *result,
+                                   GError      **error)
+{
+  g_autoptr(GPtrArray) prints = NULL;
+
+  prints = g_task_propagate_pointer (G_TASK (result), error);
+
+  return prints != NULL;
+}
+
 /**
  * fp_device_clear_storage:
  * @device: a #FpDevice
@@ -1745,6 +3416,14 @@ fp_device_clear_storage (FpDevice           *device,
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
   FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
 
+  if (fp_device_should_queue_op (device))
+    {
+      fp_device_queue_op (device,
+                          fp_device_queued_op_new (fp_device_queued_clear_storage,
+                                                   cancellable, callback, user_data));
+      return;
+    }
+
   task = g_task_new (device, cancellable, callback, user_data);
   if (g_task_return_error_if_cancelled (task))
     return;
@@ -1783,7 +3462,7 @@ fp_device_clear_storage (FpDevice           *device,
   priv->current_task = g_steal_pointer (&task);
   setup_task_cancellable (device);
 
-  cls->clear_storage (device);
+  fpi_device_invoke_driver (device, cls->clear_storage);
 
   return;
 }
@@ -1816,6 +3495,20 @@ async_result_ready (GObject *source_object, GAsyncResult *res, gpointer user_dat
   *task = g_object_ref (G_TASK (res));
 }
 
+/* Iterate the calling thread's context until the async operation behind
+ * a sync wrapper completes. The context is resolved once per call
+ * instead of once per iteration, and the thread-default context is
+ * honored, so tight sequential sync loops dispatch straight on the
+ * caller's own loop without any per-call context setup. */
+static void
+sync_wait_for_task (GAsyncResult **task)
+{
+  g_autoptr(GMainContext) context = g_main_context_ref_thread_default ();
+
+  while (!*task)
+    g_main_context_iteration (context, TRUE);
+}
+
 /**
  * fp_device_open_sync:
  * @device: a #FpDevice
@@ -1836,8 +3529,7 @@ fp_device_open_sync (FpDevice     *device,
   g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
 
   fp_device_open (device, cancellable, async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_open_finish (device, task, error);
 }
@@ -1862,8 +3554,7 @@ fp_device_close_sync (FpDevice     *device,
   g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
 
   fp_device_close (device, cancellable, async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_close_finish (device, task, error);
 }
@@ -1898,8 +3589,7 @@ fp_device_enroll_sync (FpDevice        *device,
   fp_device_enroll (device, template_print, cancellable,
                     progress_cb, progress_data, NULL,
                     async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_enroll_finish (device, task, error);
 }
@@ -1938,8 +3628,7 @@ fp_device_verify_sync (FpDevice     *device,
                     cancellable,
                     match_cb, match_data, NULL,
                     async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_verify_finish (device, task, match, print, error);
 }
@@ -1978,8 +3667,7 @@ fp_device_identify_sync (FpDevice     *device,
                       cancellable,
                       match_cb, match_data, NULL,
                       async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_identify_finish (device, task, match, print, error);
 }
@@ -2010,8 +3698,7 @@ fp_device_capture_sync (FpDevice     *device,
                      wait_for_finger,
                      cancellable,
                      async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_capture_finish (device, task, error);
 }
@@ -2041,12 +3728,41 @@ fp_device_delete_print_sync (FpDevice     *device,
                           enrolled_print,
                           cancellable,
                           async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_delete_print_finish (device, task, error);
 }
 
+/**
+ * fp_device_delete_prints_sync:
+ * @device: a #FpDevice
+ * @enrolled_prints: (element-type FpPrint) (transfer none): #FpPrint's to delete
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Delete several prints from the device in one operation.
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_delete_prints_sync (FpDevice     *device,
+                              GPtrArray    *enrolled_prints,
+                              GCancellable *cancellable,
+                              GError      **error)
+{
+  g_autoptr(GAsyncResult) task = NULL;
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  fp_device_delete_prints (device,
+                           enrolled_prints,
+                           cancellable,
+                           async_result_ready, &task);
+  sync_wait_for_task (&task);
+
+  return fp_device_delete_prints_finish (device, task, error);
+}
+
 /**
  * fp_device_list_prints_sync:
  * @device: a #FpDevice
@@ -2069,8 +3785,7 @@ fp_device_list_prints_sync (FpDevice     *device,
   fp_device_list_prints (device,
                          NULL,
                          async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_list_prints_finish (device, task, error);
 }
@@ -2098,8 +3813,7 @@ fp_device_clear_storage_sync (FpDevice     *device,
   fp_device_clear_storage (device,
                            cancellable,
                            async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_clear_storage_finish (device, task, error);
 }
@@ -2124,8 +3838,7 @@ fp_device_suspend_sync (FpDevice     *device,
   g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
 
   fp_device_suspend (device, cancellable, async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_suspend_finish (device, task, error);
 }
@@ -2150,8 +3863,7 @@ fp_device_resume_sync (FpDevice     *device,
   g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
 
   fp_device_resume (device, cancellable, async_result_ready, &task);
-  while (!task)
-    g_main_context_iteration (NULL, TRUE);
+  sync_wait_for_task (&task);
 
   return fp_device_resume_finish (device, task, error);
 }
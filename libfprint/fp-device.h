@@ -102,6 +102,21 @@ typedef enum {
   FP_TEMPERATURE_HOT,
 } FpTemperature;
 
+/**
+ * FpIdlePolicy:
+ * @FP_IDLE_POLICY_DEFAULT: Close the device immediately when requested.
+ * @FP_IDLE_POLICY_KEEP_WARM: Keep the device open for a while after
+ *   fp_device_close() so that an immediately following fp_device_open()
+ *   does not pay the hardware initialization cost again.
+ *
+ * Policy describing what happens to the underlying hardware when the
+ * device is closed. See fp_device_set_idle_policy().
+ */
+typedef enum {
+  FP_IDLE_POLICY_DEFAULT,
+  FP_IDLE_POLICY_KEEP_WARM,
+} FpIdlePolicy;
+
 /**
  * FpDeviceRetry:
  * @FP_DEVICE_RETRY_GENERAL: The scan did not succeed due to poor scan quality
@@ -217,6 +232,112 @@ typedef void (*FpMatchCb) (FpDevice *device,
                            gpointer  user_data,
                            GError   *error);
 
+/**
+ * FpDeviceCaptureStreamCallback:
+ * @device: a #FpDevice
+ * @image: (nullable) (transfer none): The captured frame, or %NULL on error
+ * @error: (nullable) (transfer none): #GError or %NULL
+ *
+ * Report one frame of a continuous capture stream started with
+ * fp_device_capture_stream_start().
+ *
+ * If @error is of type %FP_DEVICE_RETRY, then the frame could not be
+ * captured (e.g. the finger moved too fast) and the stream continues
+ * running. Any other error is fatal and ends the stream; no further
+ * frames will be delivered after it.
+ *
+ * Reference @image with g_object_ref() to keep it beyond the callback.
+ */
+typedef void (*FpDeviceCaptureStreamCallback) (FpDevice *device,
+                                               FpImage  *image,
+                                               GError   *error,
+                                               gpointer  user_data);
+
+/**
+ * FpListProgressCb:
+ * @device: a #FpDevice
+ * @prints: (element-type FpPrint) (transfer none): prints reported so far
+ * @user_data: user data passed to fp_device_list_prints_full()
+ *
+ * Report a chunk of stored prints during a listing operation started
+ * with fp_device_list_prints_full(). The callback may be invoked several
+ * times as protocol responses arrive from the device; each invocation
+ * carries only the newly listed prints.
+ *
+ * Reference the prints with g_object_ref() to keep them beyond the
+ * callback; the chunk array itself is owned by libfprint.
+ */
+typedef void (*FpListProgressCb) (FpDevice  *device,
+                                  GPtrArray *prints,
+                                  gpointer   user_data);
+
+/**
+ * FP_USB_TRANSFER_STATS_N_LATENCY_BUCKETS:
+ *
+ * Number of latency histogram buckets in #FpUsbTransferStats. Bucket
+ * @i counts completions that took between 2^i and 2^(i+1) microseconds.
+ */
+#define FP_USB_TRANSFER_STATS_N_LATENCY_BUCKETS 24
+
+/**
+ * FpUsbTransferStats:
+ * @endpoint: The USB endpoint address, or 0 for control transfers
+ * @submitted: Number of transfers submitted on the endpoint
+ * @completed: Number of transfers that completed successfully
+ * @failed: Number of transfers that completed with an error
+ * @bytes: Total payload bytes moved by successful transfers
+ * @latency_us: Completion latency histogram with power-of-two
+ *   microsecond buckets; bucket @i counts completions (successful or
+ *   not) that took between 2^i and 2^(i+1) microseconds
+ *
+ * Per-endpoint USB transfer statistics, see
+ * fp_device_get_transfer_stats().
+ */
+typedef struct
+{
+  guint8  endpoint;
+  guint64 submitted;
+  guint64 completed;
+  guint64 failed;
+  guint64 bytes;
+  guint64 latency_us[FP_USB_TRANSFER_STATS_N_LATENCY_BUCKETS];
+} FpUsbTransferStats;
+
+/**
+ * FP_DEVICE_STATISTICS_N_RETRY_REASONS:
+ *
+ * Number of entries in the per-reason retry counter array of
+ * #FpDeviceStatistics; the array is indexed by #FpDeviceRetry.
+ */
+#define FP_DEVICE_STATISTICS_N_RETRY_REASONS (FP_DEVICE_RETRY_REMOVE_FINGER + 1)
+
+/**
+ * FpDeviceStatistics:
+ * @frames_captured: Images the driver reported as successfully captured
+ * @frames_dropped: Captured images rejected by the fast quality gate
+ *   before minutiae detection
+ * @retries: Retry conditions reported to the user, indexed by the
+ *   #FpDeviceRetry reason
+ * @ssm_restarts: Driver state machines started again after having
+ *   completed once
+ * @matches_attempted: Verify or identify match operations started on a
+ *   successfully captured scan
+ * @matches_aborted_early: Match operations that ended without a
+ *   conclusive comparison, because they were cancelled or the scanned
+ *   print could not be created
+ *
+ * Always-on operational counters, see fp_device_get_statistics().
+ */
+typedef struct
+{
+  guint64 frames_captured;
+  guint64 frames_dropped;
+  guint64 retries[FP_DEVICE_STATISTICS_N_RETRY_REASONS];
+  guint64 ssm_restarts;
+  guint64 matches_attempted;
+  guint64 matches_aborted_early;
+} FpDeviceStatistics;
+
 const gchar *fp_device_get_driver (FpDevice *device);
 const gchar *fp_device_get_device_id (FpDevice *device);
 const gchar *fp_device_get_name (FpDevice *device);
@@ -225,6 +346,24 @@ FpScanType   fp_device_get_scan_type (FpDevice *device);
 FpFingerStatusFlags fp_device_get_finger_status (FpDevice *device);
 gint         fp_device_get_nr_enroll_stages (FpDevice *device);
 FpTemperature fp_device_get_temperature (FpDevice *device);
+GArray       *fp_device_get_transfer_stats (FpDevice *device);
+void          fp_device_get_statistics (FpDevice           *device,
+                                        FpDeviceStatistics *stats);
+void          fp_device_set_idle_policy (FpDevice    *device,
+                                         FpIdlePolicy policy,
+                                         guint        timeout_ms);
+void          fp_device_set_enroll_duplicates_gallery (FpDevice  *device,
+                                                       GPtrArray *prints);
+void          fp_device_set_resume_on_retry (FpDevice *device,
+                                             gboolean  enabled);
+void          fp_device_set_op_queueing (FpDevice *device,
+                                         gboolean  enabled);
+void          fp_device_set_background_ops (FpDevice *device,
+                                            gboolean  background);
+void          fp_device_set_worker_thread (FpDevice *device,
+                                           gboolean  enabled);
+void          fp_device_set_thermal_throttling (FpDevice *device,
+                                                 gboolean  enabled);
 
 FpDeviceFeature     fp_device_get_features (FpDevice *device);
 gboolean            fp_device_has_feature (FpDevice       *device,
@@ -269,6 +408,15 @@ void fp_device_verify (FpDevice           *device,
                        GAsyncReadyCallback callback,
                        gpointer            user_data);
 
+void fp_device_verify_multi (FpDevice           *device,
+                             GPtrArray          *enrolled_prints,
+                             GCancellable       *cancellable,
+                             FpMatchCb           match_cb,
+                             gpointer            match_data,
+                             GDestroyNotify      match_destroy,
+                             GAsyncReadyCallback callback,
+                             gpointer            user_data);
+
 void fp_device_identify (FpDevice           *device,
                          GPtrArray          *prints,
                          GCancellable       *cancellable,
@@ -278,23 +426,73 @@ void fp_device_identify (FpDevice           *device,
                          GAsyncReadyCallback callback,
                          gpointer            user_data);
 
+/**
+ * FpIdentifyCandidate:
+ * @print: The gallery #FpPrint this candidate refers to
+ * @score: The raw matcher score, higher is more similar
+ *
+ * One entry of the ranked candidate list produced by
+ * fp_device_identify_full(). Scores are comparable between candidates
+ * of one operation but are matcher specific; for the built-in NBIS
+ * matcher they are bozorth3 scores and the device's match threshold
+ * decides whether a candidate also counts as a match.
+ */
+typedef struct
+{
+  FpPrint *print;
+  gint     score;
+} FpIdentifyCandidate;
+
+void fp_device_identify_full (FpDevice           *device,
+                              GPtrArray          *prints,
+                              guint               max_candidates,
+                              GCancellable       *cancellable,
+                              FpMatchCb           match_cb,
+                              gpointer            match_data,
+                              GDestroyNotify      match_destroy,
+                              GAsyncReadyCallback callback,
+                              gpointer            user_data);
+
 void fp_device_capture (FpDevice           *device,
                         gboolean            wait_for_finger,
                         GCancellable       *cancellable,
                         GAsyncReadyCallback callback,
                         gpointer            user_data);
 
+void fp_device_capture_stream_start (FpDevice                     *device,
+                                     gboolean                      wait_for_finger,
+                                     GCancellable                 *cancellable,
+                                     FpDeviceCaptureStreamCallback frame_cb,
+                                     gpointer                      user_data,
+                                     GDestroyNotify                destroy);
+
+void fp_device_capture_stream_stop (FpDevice *device);
+
 void fp_device_delete_print (FpDevice           *device,
                              FpPrint            *enrolled_print,
                              GCancellable       *cancellable,
                              GAsyncReadyCallback callback,
                              gpointer            user_data);
 
+void fp_device_delete_prints (FpDevice           *device,
+                              GPtrArray          *enrolled_prints,
+                              GCancellable       *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer            user_data);
+
 void fp_device_list_prints (FpDevice           *device,
                             GCancellable       *cancellable,
                             GAsyncReadyCallback callback,
                             gpointer            user_data);
 
+void fp_device_list_prints_full (FpDevice           *device,
+                                 FpListProgressCb    progress_cb,
+                                 gpointer            progress_data,
+                                 GDestroyNotify      progress_destroy,
+                                 GCancellable       *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer            user_data);
+
 void fp_device_clear_storage (FpDevice           *device,
                               GCancellable       *cancellable,
                               GAsyncReadyCallback callback,
@@ -320,20 +518,37 @@ gboolean fp_device_verify_finish (FpDevice     *device,
                                   gboolean     *match,
                                   FpPrint     **print,
                                   GError      **error);
+gboolean fp_device_verify_multi_finish (FpDevice     *device,
+                                        GAsyncResult *result,
+                                        gboolean     *match,
+                                        FpPrint     **print,
+                                        GError      **error);
 gboolean fp_device_identify_finish (FpDevice     *device,
                                     GAsyncResult *result,
                                     FpPrint     **match,
                                     FpPrint     **print,
                                     GError      **error);
+gboolean fp_device_identify_full_finish (FpDevice     *device,
+                                         GAsyncResult *result,
+                                         FpPrint     **match,
+                                         FpPrint     **print,
+                                         GPtrArray   **candidates,
+                                         GError      **error);
 FpImage * fp_device_capture_finish (FpDevice     *device,
                                     GAsyncResult *result,
                                     GError      **error);
 gboolean fp_device_delete_print_finish (FpDevice     *device,
                                         GAsyncResult *result,
                                         GError      **error);
+gboolean fp_device_delete_prints_finish (FpDevice     *device,
+                                         GAsyncResult *result,
+                                         GError      **error);
 GPtrArray * fp_device_list_prints_finish (FpDevice     *device,
                                           GAsyncResult *result,
                                           GError      **error);
+gboolean fp_device_list_prints_full_finish (FpDevice     *device,
+                                            GAsyncResult *result,
+                                            GError      **error);
 gboolean fp_device_clear_storage_finish (FpDevice     *device,
                                          GAsyncResult *result,
                                          GError      **error);
@@ -374,6 +589,10 @@ gboolean fp_device_delete_print_sync (FpDevice     *device,
                                       FpPrint      *enrolled_print,
                                       GCancellable *cancellable,
                                       GError      **error);
+gboolean fp_device_delete_prints_sync (FpDevice     *device,
+                                       GPtrArray    *enrolled_prints,
+                                       GCancellable *cancellable,
+                                       GError      **error);
 GPtrArray * fp_device_list_prints_sync (FpDevice     *device,
                                         GCancellable *cancellable,
                                         GError      **error);
@@ -0,0 +1,1159 @@
+/*
+ * FPrint Gallery - Persistent template gallery
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "gallery"
+#include "fpi-log.h"
+
+#include "fp-gallery.h"
+#include "fp-print-private.h"
+#include "fpi-print.h"
+
+#ifdef G_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+/**
+ * SECTION: fp-gallery
+ * @title: FpGallery
+ * @short_description: Persistent, memory-mapped template gallery
+ *
+ * A gallery file is a packed, versioned container of NBIS templates with a
+ * fixed on-disk layout. Unlike fp_print_deserialize(), which re-parses a
+ * GVariant for every print, loading a gallery maps the file once and
+ * converts the packed tables in a single linear pass. Identify startup
+ * cost therefore stops scaling with per-print parsing overhead.
+ *
+ * Minutiae tables are stored as int16 structure-of-arrays records
+ * trimmed to the actual minutiae count (500 dpi coordinates and angles
+ * fit comfortably), rather than as the matcher's fixed-size
+ * #xyt_struct, which reserves space for %MAX_FILE_MINUTIAE minutiae
+ * regardless of how many a view holds. A typical view shrinks from
+ * ~12kB to a few hundred bytes, so large galleries stream from disk
+ * instead of faulting a page per view. The load-time conversion back
+ * into #xyt_struct is unavoidable as long as bozorth3 dictates that
+ * layout.
+ *
+ * Gallery files are tied to the native byte order and are meant as a local
+ * cache; use fp_print_serialize() for portable interchange.
+ *
+ * Template payloads are content addressed: entries that carry identical
+ * minutiae tables but different metadata (as produced by multi-site sync,
+ * where only username or description diverge) reference a single shared
+ * payload, so metadata copies do not grow the file. Prints loaded from
+ * shared payloads also share one in-memory conversion, which lets
+ * fpi_print_bz3_match_gallery() score each distinct template once.
+ *
+ * Where at-rest size and replication bandwidth matter more than mapping
+ * simplicity — large galleries replicated onto flash-backed edge
+ * controllers — fp_gallery_write_to_file_full() can additionally
+ * compress the packed tables with zlib, roughly a threefold reduction.
+ * Compressed payloads are inflated on first use into a bounded cache of
+ * ready-to-match templates, and the prefilter vectors used by the
+ * identification screening pass are stored uncompressed next to them,
+ * so scanning a large gallery only ever inflates the few plausible
+ * candidates.
+ */
+
+#define FP_GALLERY_MAGIC "FPGL"
+#define FP_GALLERY_VERSION 3
+#define FP_GALLERY_VERSION_COMPRESSED 4
+#define FP_GALLERY_USER_ID_LEN 64
+
+/* Decompressed payloads a compressed gallery keeps cached beyond those
+ * pinned by already materialized prints. */
+#define FP_GALLERY_CACHE_PAYLOADS 256
+
+typedef struct
+{
+  gchar   magic[4];
+  guint32 version;
+  guint32 n_prints;
+  guint32 reserved;
+  /* Followed by n_prints guint32 entry offsets (from file start). */
+} FpGalleryHeader;
+
+typedef struct
+{
+  guint32 n_views;
+  /* Offset (from file start) of n_views packed views. Each view is a
+   * guint16 minutiae count followed by three gint16 arrays of that
+   * length (x, y, theta), concatenated back to back; the whole payload
+   * is padded to a 4 byte multiple. Entries with identical tables
+   * share one payload. */
+  guint32 payload;
+  gchar   user_id[FP_GALLERY_USER_ID_LEN];
+} FpGalleryEntry;
+
+/* Version 4 entry. The packed view layout matches version 3, but the
+ * payload is zlib compressed; its compressed and expanded sizes are
+ * recorded, and the per-view prefilter vectors are stored uncompressed
+ * in a separate block so identification can screen entries without
+ * touching the payload. */
+typedef struct
+{
+  guint32 n_views;
+  guint32 payload;      /* Offset of the compressed packed views */
+  guint32 payload_size; /* Compressed size in bytes */
+  guint32 raw_size;     /* Expanded size in bytes */
+  /* Offset of n_views records of fpi_print_prefilter_size() bytes,
+   * see fpi_print_export_prefilters(). */
+  guint32 prefilters;
+  guint32 reserved;
+  gchar   user_id[FP_GALLERY_USER_ID_LEN];
+} FpGalleryEntryV4;
+
+G_STATIC_ASSERT (sizeof (FpGalleryHeader) % 4 == 0);
+G_STATIC_ASSERT (sizeof (FpGalleryEntry) % 4 == 0);
+G_STATIC_ASSERT (sizeof (FpGalleryEntryV4) % 4 == 0);
+
+struct _FpGallery
+{
+  GObject      parent_instance;
+
+  GMappedFile *map;
+  GPtrArray   *prints;
+};
+
+G_DEFINE_TYPE (FpGallery, fp_gallery, G_TYPE_OBJECT)
+
+static void
+fp_gallery_finalize (GObject *object)
+{
+  FpGallery *self = FP_GALLERY (object);
+
+  g_clear_pointer (&self->prints, g_ptr_array_unref);
+  g_clear_pointer (&self->map, g_mapped_file_unref);
+
+  G_OBJECT_CLASS (fp_gallery_parent_class)->finalize (object);
+}
+
+static void
+fp_gallery_class_init (FpGalleryClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fp_gallery_finalize;
+}
+
+static void
+fp_gallery_init (FpGallery *self)
+{
+  self->prints = g_ptr_array_new_with_free_func (g_object_unref);
+}
+
+/* Number of bytes one packed view occupies within the remaining
+ * payload, or 0 when it does not fit or is malformed. */
+static gsize
+fp_gallery_view_size (const guint8 *view,
+                      gsize         remaining)
+{
+  guint16 n;
+
+  if (remaining < sizeof (guint16))
+    return 0;
+
+  n = *(const guint16 *) view;
+  if (n == 0 || n > MAX_FILE_MINUTIAE)
+    return 0;
+
+  if (remaining - sizeof (guint16) < (gsize) n * 3 * sizeof (gint16))
+    return 0;
+
+  return sizeof (guint16) + (gsize) n * 3 * sizeof (gint16);
+}
+
+/* Expand one packed int16 structure-of-arrays view into the fixed
+ * layout bozorth3 requires. */
+static struct xyt_struct *
+fp_gallery_view_unpack (const guint8 *view)
+{
+  const gint16 *cols = (const gint16 *) (view + sizeof (guint16));
+  struct xyt_struct *xyt = g_new0 (struct xyt_struct, 1);
+  guint16 n = *(const guint16 *) view;
+  guint i;
+
+  xyt->nrows = n;
+  for (i = 0; i < n; i++)
+    {
+      xyt->xcol[i] = cols[i];
+      xyt->ycol[i] = cols[n + i];
+      xyt->thetacol[i] = cols[2 * n + i];
+    }
+
+  return xyt;
+}
+
+/* Capacity of the decompressed-payload cache. FP_GALLERY_CACHE
+ * overrides the default for deployments balancing memory against
+ * repeat decompression of a churning match set. */
+static guint
+fp_gallery_cache_capacity (void)
+{
+  static gsize cap = 0;
+
+  if (g_once_init_enter (&cap))
+    {
+      const char *env = g_getenv ("FP_GALLERY_CACHE");
+      gint64 value = FP_GALLERY_CACHE_PAYLOADS;
+
+      if (env)
+        {
+          value = g_ascii_strtoll (env, NULL, 10);
+          if (value < 1 || value > G_MAXINT32)
+            {
+              g_warning ("FP_GALLERY_CACHE out of range, using %d",
+                         FP_GALLERY_CACHE_PAYLOADS);
+              value = FP_GALLERY_CACHE_PAYLOADS;
+            }
+        }
+
+      g_once_init_leave (&cap, value);
+    }
+
+  return cap;
+}
+
+/* Bounded LRU of decompressed payloads, shared by every print of one
+ * compressed gallery. Eviction only drops the cache's reference: views
+ * pinned by already materialized prints stay valid until those prints
+ * go away, so at any time the resident set is the cache plus whatever
+ * the matcher actually scored. */
+typedef struct
+{
+  gint        ref_count;
+  GMutex      lock;
+  GHashTable *views; /* payload offset -> GPtrArray of xyt_struct */
+  GQueue      lru;   /* payload offsets, most recently used first */
+  guint       capacity;
+} FpGalleryCache;
+
+static FpGalleryCache *
+fp_gallery_cache_new (void)
+{
+  FpGalleryCache *cache = g_new0 (FpGalleryCache, 1);
+
+  cache->ref_count = 1;
+  g_mutex_init (&cache->lock);
+  cache->views = g_hash_table_new_full (NULL, NULL, NULL,
+                                        (GDestroyNotify) g_ptr_array_unref);
+  g_queue_init (&cache->lru);
+  cache->capacity = fp_gallery_cache_capacity ();
+
+  return cache;
+}
+
+static FpGalleryCache *
+fp_gallery_cache_ref (FpGalleryCache *cache)
+{
+  g_atomic_int_inc (&cache->ref_count);
+  return cache;
+}
+
+static void
+fp_gallery_cache_unref (FpGalleryCache *cache)
+{
+  if (!g_atomic_int_dec_and_test (&cache->ref_count))
+    return;
+
+  g_queue_clear (&cache->lru);
+  g_hash_table_unref (cache->views);
+  g_mutex_clear (&cache->lock);
+  g_free (cache);
+}
+
+/* Handle for one compressed payload, installed as the lazy data of
+ * every print referencing it; prints sharing a payload share one
+ * handle, which also makes it the matcher's deduplication key. Keeps
+ * the mapping and the cache alive for as long as any print needs
+ * them, independent of the #FpGallery object. */
+typedef struct
+{
+  gint            ref_count;
+  GMappedFile    *map;
+  FpGalleryCache *cache;
+  guint32         payload;
+  guint32         payload_size;
+  guint32         raw_size;
+  guint32         n_views;
+} FpGalleryLazyPayload;
+
+static FpGalleryLazyPayload *
+fp_gallery_lazy_payload_ref (FpGalleryLazyPayload *lazy)
+{
+  g_atomic_int_inc (&lazy->ref_count);
+  return lazy;
+}
+
+static void
+fp_gallery_lazy_payload_unref (gpointer data)
+{
+  FpGalleryLazyPayload *lazy = data;
+
+  if (!g_atomic_int_dec_and_test (&lazy->ref_count))
+    return;
+
+  fp_gallery_cache_unref (lazy->cache);
+  g_mapped_file_unref (lazy->map);
+  g_free (lazy);
+}
+
+static FpGalleryLazyPayload *
+fp_gallery_lazy_payload_new (FpGallery              *self,
+                             FpGalleryCache         *cache,
+                             const FpGalleryEntryV4 *entry)
+{
+  FpGalleryLazyPayload *lazy = g_new0 (FpGalleryLazyPayload, 1);
+
+  lazy->ref_count = 1;
+  lazy->map = g_mapped_file_ref (self->map);
+  lazy->cache = fp_gallery_cache_ref (cache);
+  lazy->payload = entry->payload;
+  lazy->payload_size = entry->payload_size;
+  lazy->raw_size = entry->raw_size;
+  lazy->n_views = entry->n_views;
+
+  return lazy;
+}
+
+/* Inflate the compressed payload into a freshly allocated buffer of the
+ * recorded expanded size. Returns %NULL when the stream is corrupt or
+ * disagrees with the recorded size. */
+static guint8 *
+fp_gallery_payload_inflate (const FpGalleryLazyPayload *lazy)
+{
+  g_autoptr(GZlibDecompressor) decompressor = NULL;
+  g_autofree guint8 *raw = g_malloc (lazy->raw_size);
+  const guint8 *in;
+  gsize in_len = lazy->payload_size;
+  gsize out_pos = 0;
+
+  in = (const guint8 *) g_mapped_file_get_contents (lazy->map) + lazy->payload;
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+
+  while (TRUE)
+    {
+      g_autoptr(GError) error = NULL;
+      GConverterResult res;
+      gsize bytes_read = 0, bytes_written = 0;
+
+      res = g_converter_convert (G_CONVERTER (decompressor),
+                                 in, in_len,
+                                 raw + out_pos, lazy->raw_size - out_pos,
+                                 G_CONVERTER_INPUT_AT_END,
+                                 &bytes_read, &bytes_written, &error);
+      if (res == G_CONVERTER_ERROR)
+        {
+          fp_warn ("Gallery payload could not be decompressed: %s",
+                   error->message);
+          return NULL;
+        }
+
+      in += bytes_read;
+      in_len -= bytes_read;
+      out_pos += bytes_written;
+
+      if (res == G_CONVERTER_FINISHED)
+        break;
+
+      if (bytes_read == 0 && bytes_written == 0)
+        {
+          fp_warn ("Gallery payload decompression made no progress");
+          return NULL;
+        }
+    }
+
+  if (out_pos != lazy->raw_size)
+    {
+      fp_warn ("Gallery payload expanded to %" G_GSIZE_FORMAT " of %u bytes",
+               out_pos, lazy->raw_size);
+      return NULL;
+    }
+
+  return g_steal_pointer (&raw);
+}
+
+/* FpiPrintLazyFunc: fetch the decompressed payload backing @print from
+ * the cache (inflating it on a miss) and fill in the placeholder
+ * views. Runs on whichever thread first needs the views; the cache
+ * lock serializes prints sharing a payload. */
+static void
+fp_gallery_materialize_views (FpPrint *print, gpointer user_data)
+{
+  FpGalleryLazyPayload *lazy = user_data;
+  FpGalleryCache *cache = lazy->cache;
+  GPtrArray *views;
+  guint32 i;
+
+  g_mutex_lock (&cache->lock);
+
+  views = g_hash_table_lookup (cache->views, GUINT_TO_POINTER (lazy->payload));
+  if (views)
+    {
+      g_ptr_array_ref (views);
+      g_queue_remove (&cache->lru, GUINT_TO_POINTER (lazy->payload));
+      g_queue_push_head (&cache->lru, GUINT_TO_POINTER (lazy->payload));
+    }
+  else
+    {
+      g_autofree guint8 *raw = fp_gallery_payload_inflate (lazy);
+      const guint8 *view = raw;
+      gsize remaining = lazy->raw_size;
+
+      views = g_ptr_array_new_full (lazy->n_views, g_free);
+      for (i = 0; raw && i < lazy->n_views; i++)
+        {
+          gsize size = fp_gallery_view_size (view, remaining);
+
+          if (size == 0)
+            break;
+
+          g_ptr_array_add (views, fp_gallery_view_unpack (view));
+          view += size;
+          remaining -= size;
+        }
+
+      /* A corrupt payload materializes as empty views, so the print
+       * scores nothing instead of crashing the matcher. */
+      if (views->len != lazy->n_views)
+        {
+          if (raw)
+            fp_warn ("Gallery payload at %u is malformed", lazy->payload);
+          g_ptr_array_set_size (views, 0);
+          for (i = 0; i < lazy->n_views; i++)
+            g_ptr_array_add (views, g_new0 (struct xyt_struct, 1));
+        }
+
+      g_hash_table_insert (cache->views, GUINT_TO_POINTER (lazy->payload),
+                           g_ptr_array_ref (views));
+      g_queue_push_head (&cache->lru, GUINT_TO_POINTER (lazy->payload));
+
+      while (g_queue_get_length (&cache->lru) > cache->capacity)
+        g_hash_table_remove (cache->views, g_queue_pop_tail (&cache->lru));
+    }
+
+  g_mutex_unlock (&cache->lock);
+
+  /* As in fp_gallery_print_from_entry(): the print holds its views
+   * through the shared conversion, not the non-owning array. */
+  g_object_set_data_full (G_OBJECT (print), "fp-gallery-views",
+                          views, (GDestroyNotify) g_ptr_array_unref);
+
+  for (i = 0; i < views->len; i++)
+    print->prints->pdata[i] = g_ptr_array_index (views, i);
+}
+
+static FpPrint *
+fp_gallery_print_from_entry (FpGallery            *self,
+                             const FpGalleryEntry *entry,
+                             GPtrArray            *views)
+{
+  g_autofree gchar *user_id = NULL;
+  FpPrint *print;
+  guint32 i;
+
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT, NULL));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+
+  /* The xyt tables are owned by the per-payload conversion, shared by
+   * every print referencing that payload; replace the owning array
+   * installed by fpi_print_set_type() with a non-owning one and keep
+   * the conversion alive for as long as the print is. */
+  g_ptr_array_unref (print->prints);
+  print->prints = g_ptr_array_new ();
+  g_object_set_data_full (G_OBJECT (print), "fp-gallery-views",
+                          g_ptr_array_ref (views),
+                          (GDestroyNotify) g_ptr_array_unref);
+
+  for (i = 0; i < views->len; i++)
+    g_ptr_array_add (print->prints, g_ptr_array_index (views, i));
+
+  user_id = g_strndup (entry->user_id, FP_GALLERY_USER_ID_LEN);
+  if (user_id[0] != '\0')
+    fpi_print_fill_from_user_id (print, user_id);
+
+  return print;
+}
+
+static FpPrint *
+fp_gallery_print_from_entry_v4 (FpGallery              *self,
+                                const FpGalleryEntryV4 *entry,
+                                FpGalleryLazyPayload   *lazy)
+{
+  const guint8 *data = (const guint8 *) g_mapped_file_get_contents (self->map);
+  g_autofree gchar *user_id = NULL;
+  FpPrint *print;
+
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT, NULL));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+
+  /* The views are decompressed on first use; until then the print
+   * carries placeholders plus the stored prefilter vectors, which is
+   * all the identification screening pass needs. */
+  fpi_print_set_lazy_views (print, entry->n_views,
+                            fp_gallery_materialize_views,
+                            fp_gallery_lazy_payload_ref (lazy),
+                            fp_gallery_lazy_payload_unref);
+  fpi_print_import_prefilters (print, data + entry->prefilters);
+
+  user_id = g_strndup (entry->user_id, FP_GALLERY_USER_ID_LEN);
+  if (user_id[0] != '\0')
+    fpi_print_fill_from_user_id (print, user_id);
+
+  return print;
+}
+
+/**
+ * fp_gallery_new_for_file:
+ * @path: Path of the gallery file to map
+ * @error: Return location for error
+ *
+ * Memory-map the gallery at @path and build the list of contained prints.
+ * The packed minutiae tables are expanded once per stored payload; prints
+ * sharing a payload share the expanded tables, which remain valid for the
+ * life time of each print.
+ *
+ * For compressed galleries (see %FP_GALLERY_WRITE_COMPRESS) only the
+ * entry metadata and the stored prefilter vectors are read here; the
+ * compressed payloads are inflated on first use, per payload, into a
+ * bounded cache.
+ *
+ * Returns: (transfer full): A newly created #FpGallery, or %NULL on error
+ */
+FpGallery *
+fp_gallery_new_for_file (const gchar *path,
+                         GError     **error)
+{
+  g_autoptr(FpGallery) self = NULL;
+  g_autoptr(GHashTable) converted = NULL;
+  g_autoptr(GHashTable) payloads = NULL;
+  FpGalleryCache *cache = NULL;
+  const FpGalleryHeader *header;
+  const guint32 *offsets;
+  const guint8 *data;
+  gsize length;
+  gboolean compressed;
+  guint32 i;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  self = g_object_new (FP_TYPE_GALLERY, NULL);
+
+  self->map = g_mapped_file_new (path, FALSE, error);
+  if (!self->map)
+    return NULL;
+
+  data = (const guint8 *) g_mapped_file_get_contents (self->map);
+  length = g_mapped_file_get_length (self->map);
+
+  if (length < sizeof (FpGalleryHeader))
+    goto invalid_format;
+
+  header = (const FpGalleryHeader *) data;
+  if (memcmp (header->magic, FP_GALLERY_MAGIC, 4) != 0 ||
+      (header->version != FP_GALLERY_VERSION &&
+       header->version != FP_GALLERY_VERSION_COMPRESSED))
+    goto invalid_format;
+  compressed = header->version == FP_GALLERY_VERSION_COMPRESSED;
+
+  /* Division form: n_prints comes from the file, and the
+   * multiplication could wrap size_t on 32-bit platforms. */
+  if (header->n_prints > (length - sizeof (FpGalleryHeader)) / sizeof (guint32))
+    goto invalid_format;
+
+  /* Converted views keyed by payload offset; entries sharing a payload
+   * share one conversion. Compressed galleries share one lazy payload
+   * handle instead. */
+  converted = g_hash_table_new_full (NULL, NULL, NULL,
+                                     (GDestroyNotify) g_ptr_array_unref);
+  if (compressed)
+    {
+      cache = fp_gallery_cache_new ();
+      payloads = g_hash_table_new_full (NULL, NULL, NULL,
+                                        fp_gallery_lazy_payload_unref);
+    }
+
+  offsets = (const guint32 *) (data + sizeof (FpGalleryHeader));
+  for (i = 0; i < header->n_prints; i++)
+    {
+      const FpGalleryEntry *entry;
+      GPtrArray *views;
+
+      if (compressed)
+        {
+          const FpGalleryEntryV4 *entry4;
+          FpGalleryLazyPayload *lazy;
+
+          if (offsets[i] % 4 != 0 ||
+              offsets[i] + sizeof (FpGalleryEntryV4) > length)
+            goto invalid_format;
+
+          entry4 = (const FpGalleryEntryV4 *) (data + offsets[i]);
+          if (entry4->n_views == 0 ||
+              entry4->payload % 4 != 0 ||
+              entry4->payload_size == 0 ||
+              entry4->payload > length ||
+              entry4->payload_size > length - entry4->payload ||
+              entry4->raw_size == 0 ||
+              entry4->raw_size > (gsize) entry4->n_views *
+              (sizeof (guint16) + MAX_FILE_MINUTIAE * 3 * sizeof (gint16)) + 3 ||
+              entry4->prefilters > length ||
+              entry4->n_views * fpi_print_prefilter_size () >
+              length - entry4->prefilters)
+            goto invalid_format;
+
+          lazy = g_hash_table_lookup (payloads,
+                                      GUINT_TO_POINTER (entry4->payload));
+          if (!lazy)
+            {
+              lazy = fp_gallery_lazy_payload_new (self, cache, entry4);
+              g_hash_table_insert (payloads,
+                                   GUINT_TO_POINTER (entry4->payload), lazy);
+            }
+          else if (lazy->n_views != entry4->n_views ||
+                   lazy->payload_size != entry4->payload_size ||
+                   lazy->raw_size != entry4->raw_size)
+            {
+              goto invalid_format;
+            }
+
+          g_ptr_array_add (self->prints,
+                           fp_gallery_print_from_entry_v4 (self, entry4, lazy));
+          continue;
+        }
+
+      if (offsets[i] % 4 != 0 ||
+          offsets[i] + sizeof (FpGalleryEntry) > length)
+        goto invalid_format;
+
+      entry = (const FpGalleryEntry *) (data + offsets[i]);
+      if (entry->n_views == 0 ||
+          entry->payload % 4 != 0 ||
+          entry->payload > length)
+        goto invalid_format;
+
+      views = g_hash_table_lookup (converted, GUINT_TO_POINTER (entry->payload));
+      if (!views)
+        {
+          const guint8 *view = data + entry->payload;
+          gsize remaining = length - entry->payload;
+          guint32 j;
+
+          views = g_ptr_array_new_full (entry->n_views, g_free);
+          g_hash_table_insert (converted, GUINT_TO_POINTER (entry->payload),
+                               views);
+
+          for (j = 0; j < entry->n_views; j++)
+            {
+              gsize size = fp_gallery_view_size (view, remaining);
+
+              if (size == 0)
+                goto invalid_format;
+
+              g_ptr_array_add (views, fp_gallery_view_unpack (view));
+              view += size;
+              remaining -= size;
+            }
+        }
+      else if (views->len != entry->n_views)
+        {
+          goto invalid_format;
+        }
+
+      g_ptr_array_add (self->prints,
+                       fp_gallery_print_from_entry (self, entry, views));
+    }
+
+  g_clear_pointer (&cache, fp_gallery_cache_unref);
+  return g_steal_pointer (&self);
+
+invalid_format:
+  g_clear_pointer (&cache, fp_gallery_cache_unref);
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Gallery file could not be parsed");
+  return NULL;
+}
+
+/**
+ * fp_gallery_get_prints:
+ * @gallery: A #FpGallery
+ *
+ * Returns the prints contained in the gallery, in file order. The array is
+ * suitable for passing to fp_device_identify().
+ *
+ * Returns: (transfer none) (element-type FpPrint): The gallery prints
+ */
+GPtrArray *
+fp_gallery_get_prints (FpGallery *gallery)
+{
+  g_return_val_if_fail (FP_IS_GALLERY (gallery), NULL);
+
+  return gallery->prints;
+}
+
+/**
+ * fp_gallery_get_size:
+ * @gallery: A #FpGallery
+ *
+ * Returns: The number of prints in the gallery
+ */
+guint
+fp_gallery_get_size (FpGallery *gallery)
+{
+  g_return_val_if_fail (FP_IS_GALLERY (gallery), 0);
+
+  return gallery->prints->len;
+}
+
+static void
+fp_gallery_warmup_thread_func (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+  FpGallery *self = source_object;
+  const guint8 *data;
+  gsize length;
+  gsize off;
+  guint touched = 0;
+  guint i;
+
+  data = (const guint8 *) g_mapped_file_get_contents (self->map);
+  length = g_mapped_file_get_length (self->map);
+
+#ifdef MADV_WILLNEED
+  /* Hint the kernel to read ahead; the touch loop below makes the
+   * faults happen here rather than during the first identify. */
+  madvise ((void *) data, length, MADV_WILLNEED);
+#endif
+
+  /* Touch one byte per smallest supported page. The accumulation keeps
+   * the reads from being optimized away. */
+  for (off = 0; off < length; off += 4096)
+    {
+      touched += data[off];
+
+      if ((off & 0xfffff) == 0 &&
+          g_task_return_error_if_cancelled (task))
+        return;
+    }
+
+  fp_dbg ("warmed %" G_GSIZE_FORMAT " bytes (checksum %u)", length, touched);
+
+  for (i = 0; i < self->prints->len; i++)
+    {
+      if (g_task_return_error_if_cancelled (task))
+        return;
+
+      fpi_print_prewarm (g_ptr_array_index (self->prints, i));
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * fp_gallery_warmup_async:
+ * @gallery: A #FpGallery
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Pre-fault the mapped gallery pages and pre-build the per-print
+ * matcher caches (prefilter vectors and bozorth edge tables) on a
+ * background thread, so the first identify after start-up performs
+ * like a warm one. Intended to be started during idle time right after
+ * loading the gallery; the warm-up must have finished before the
+ * prints take part in a match, as the caches are built without
+ * locking.
+ *
+ * Warming up is purely an optimization: cancelling it, or skipping it
+ * entirely, only costs latency on the first identify.
+ *
+ * For compressed galleries only the mapped pages are pre-faulted; the
+ * payloads stay compressed, so warming up does not expand the whole
+ * gallery into memory.
+ */
+void
+fp_gallery_warmup_async (FpGallery          *gallery,
+                         GCancellable       *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (FP_IS_GALLERY (gallery));
+
+  task = g_task_new (gallery, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fp_gallery_warmup_async);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_run_in_thread (task, fp_gallery_warmup_thread_func);
+}
+
+/**
+ * fp_gallery_warmup_finish:
+ * @gallery: A #FpGallery
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an operation started with fp_gallery_warmup_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_gallery_warmup_finish (FpGallery    *gallery,
+                          GAsyncResult *result,
+                          GError      **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, gallery), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Check that every print can be stored in a gallery file,
+ * materializing deferred views along the way. */
+static gboolean
+fp_gallery_validate_prints (GPtrArray *prints,
+                            GError   **error)
+{
+  guint i;
+
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+
+      guint j;
+
+      if (print->type != FPI_PRINT_NBIS)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "Only NBIS prints can be stored in a gallery");
+          return FALSE;
+        }
+
+      fpi_print_ensure_views (print);
+
+      for (j = 0; j < print->prints->len; j++)
+        {
+          struct xyt_struct *xyt = g_ptr_array_index (print->prints, j);
+          gint k;
+
+          if (xyt->nrows <= 0 || xyt->nrows > MAX_FILE_MINUTIAE)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "Print view has an invalid minutiae count");
+              return FALSE;
+            }
+
+          for (k = 0; k < xyt->nrows; k++)
+            {
+              if (xyt->xcol[k] < G_MININT16 || xyt->xcol[k] > G_MAXINT16 ||
+                  xyt->ycol[k] < G_MININT16 || xyt->ycol[k] > G_MAXINT16 ||
+                  xyt->thetacol[k] < G_MININT16 || xyt->thetacol[k] > G_MAXINT16)
+                {
+                  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                               "Print view minutia does not fit 16 bits");
+                  return FALSE;
+                }
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+/* Pack every view of @print into the on-disk payload layout shared by
+ * both gallery versions, padded to a 4 byte multiple so deduplication
+ * keys stay deterministic and the next entry remains aligned. */
+static GBytes *
+fp_gallery_pack_print (FpPrint *print)
+{
+  GByteArray *tables = g_byte_array_new ();
+  guint j;
+
+  for (j = 0; j < print->prints->len; j++)
+    {
+      struct xyt_struct *xyt = g_ptr_array_index (print->prints, j);
+      gint16 col[MAX_FILE_MINUTIAE];
+      guint16 n = xyt->nrows;
+      const int *cols[] = { xyt->xcol, xyt->ycol, xyt->thetacol };
+      guint c;
+      gint k;
+
+      g_byte_array_append (tables, (const guint8 *) &n, sizeof (n));
+      for (c = 0; c < G_N_ELEMENTS (cols); c++)
+        {
+          for (k = 0; k < xyt->nrows; k++)
+            col[k] = cols[c][k];
+          g_byte_array_append (tables, (const guint8 *) col,
+                               n * sizeof (gint16));
+        }
+    }
+  while (tables->len % 4 != 0)
+    g_byte_array_append (tables, (const guint8 *) "", 1);
+
+  return g_byte_array_free_to_bytes (tables);
+}
+
+/**
+ * fp_gallery_write_to_file:
+ * @prints: (element-type FpPrint): NBIS prints to store
+ * @path: Path of the gallery file to create
+ * @error: Return location for error
+ *
+ * Write @prints into a packed gallery file at @path, replacing any existing
+ * file atomically. Only prints of the NBIS type can be stored; per-print
+ * metadata is preserved through the encoded user ID.
+ *
+ * Prints whose minutiae tables are byte-identical share a single stored
+ * payload, keyed by content; only their metadata entries are duplicated.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_gallery_write_to_file (GPtrArray   *prints,
+                          const gchar *path,
+                          GError     **error)
+{
+  g_autoptr(GByteArray) buffer = NULL;
+  g_autoptr(GHashTable) payloads = NULL;
+  FpGalleryHeader header = { FP_GALLERY_MAGIC, FP_GALLERY_VERSION, 0, 0 };
+  gsize offset;
+  guint i;
+
+  g_return_val_if_fail (prints != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (!fp_gallery_validate_prints (prints, error))
+    return FALSE;
+
+  header.n_prints = prints->len;
+
+  buffer = g_byte_array_new ();
+  g_byte_array_append (buffer, (const guint8 *) &header, sizeof (header));
+
+  /* Reserve the offset table, fill it in as entries are appended. */
+  offset = buffer->len;
+  g_byte_array_set_size (buffer, buffer->len + prints->len * sizeof (guint32));
+
+  /* Payload bytes already in the file, keyed by content; entries with
+   * identical tables point at one shared payload. The stored value is
+   * the payload offset biased by one so 0 means "not seen". */
+  payloads = g_hash_table_new_full ((GHashFunc) g_bytes_hash,
+                                    (GEqualFunc) g_bytes_equal,
+                                    (GDestroyNotify) g_bytes_unref, NULL);
+
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+      g_autofree gchar *user_id = NULL;
+      g_autoptr(GBytes) body = NULL;
+      FpGalleryEntry entry = { 0, };
+      gpointer seen;
+
+      ((guint32 *) (buffer->data + offset))[i] = buffer->len;
+
+      body = fp_gallery_pack_print (print);
+
+      entry.n_views = print->prints->len;
+      user_id = fpi_print_generate_user_id (print);
+      g_strlcpy (entry.user_id, user_id, FP_GALLERY_USER_ID_LEN);
+
+      seen = g_hash_table_lookup (payloads, body);
+      if (seen)
+        {
+          entry.payload = GPOINTER_TO_UINT (seen) - 1;
+          g_byte_array_append (buffer, (const guint8 *) &entry, sizeof (entry));
+        }
+      else
+        {
+          entry.payload = buffer->len + sizeof (entry);
+          g_hash_table_insert (payloads, g_bytes_ref (body),
+                               GUINT_TO_POINTER (entry.payload + 1));
+          g_byte_array_append (buffer, (const guint8 *) &entry, sizeof (entry));
+          g_byte_array_append (buffer,
+                               g_bytes_get_data (body, NULL),
+                               g_bytes_get_size (body));
+        }
+    }
+
+  return g_file_set_contents (path, (const gchar *) buffer->data,
+                              buffer->len, error);
+}
+
+/* Deflate @body with zlib. Returns %NULL with @error set. */
+static GBytes *
+fp_gallery_deflate (GBytes  *body,
+                    GError **error)
+{
+  g_autoptr(GZlibCompressor) compressor = NULL;
+  g_autoptr(GByteArray) out = NULL;
+  const guint8 *in;
+  gsize in_len;
+  gboolean finished = FALSE;
+  guint8 outbuf[16384];
+
+  in = g_bytes_get_data (body, &in_len);
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1);
+  out = g_byte_array_sized_new (in_len / 2);
+
+  while (!finished)
+    {
+      GConverterResult res;
+      gsize bytes_read = 0, bytes_written = 0;
+
+      res = g_converter_convert (G_CONVERTER (compressor),
+                                 in, in_len,
+                                 outbuf, sizeof (outbuf),
+                                 G_CONVERTER_INPUT_AT_END,
+                                 &bytes_read, &bytes_written, error);
+      if (res == G_CONVERTER_ERROR)
+        return NULL;
+
+      g_byte_array_append (out, outbuf, bytes_written);
+      in += bytes_read;
+      in_len -= bytes_read;
+      finished = res == G_CONVERTER_FINISHED;
+    }
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&out));
+}
+
+static gboolean
+fp_gallery_write_compressed (GPtrArray   *prints,
+                             const gchar *path,
+                             GError     **error)
+{
+  g_autoptr(GByteArray) buffer = NULL;
+  g_autoptr(GHashTable) payloads = NULL;
+  FpGalleryHeader header = { FP_GALLERY_MAGIC, FP_GALLERY_VERSION_COMPRESSED, 0, 0 };
+  gsize offset;
+  guint i;
+
+  if (!fp_gallery_validate_prints (prints, error))
+    return FALSE;
+
+  header.n_prints = prints->len;
+
+  buffer = g_byte_array_new ();
+  g_byte_array_append (buffer, (const guint8 *) &header, sizeof (header));
+
+  /* Reserve the offset table, fill it in as entries are appended. */
+  offset = buffer->len;
+  g_byte_array_set_size (buffer, buffer->len + prints->len * sizeof (guint32));
+
+  /* Deduplication as in fp_gallery_write_to_file(), keyed by the
+   * uncompressed body; the stored value is a heap copy of the entry
+   * fields describing the shared payload. */
+  payloads = g_hash_table_new_full ((GHashFunc) g_bytes_hash,
+                                    (GEqualFunc) g_bytes_equal,
+                                    (GDestroyNotify) g_bytes_unref, g_free);
+
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+      g_autofree gchar *user_id = NULL;
+      g_autoptr(GBytes) body = NULL;
+      FpGalleryEntryV4 entry = { 0, };
+      FpGalleryEntryV4 *seen;
+
+      ((guint32 *) (buffer->data + offset))[i] = buffer->len;
+
+      body = fp_gallery_pack_print (print);
+
+      entry.n_views = print->prints->len;
+      user_id = fpi_print_generate_user_id (print);
+      g_strlcpy (entry.user_id, user_id, FP_GALLERY_USER_ID_LEN);
+
+      seen = g_hash_table_lookup (payloads, body);
+      if (seen)
+        {
+          entry.payload = seen->payload;
+          entry.payload_size = seen->payload_size;
+          entry.raw_size = seen->raw_size;
+          entry.prefilters = seen->prefilters;
+          g_byte_array_append (buffer, (const guint8 *) &entry, sizeof (entry));
+        }
+      else
+        {
+          g_autoptr(GByteArray) filters = g_byte_array_new ();
+          g_autoptr(GBytes) deflated = NULL;
+
+          deflated = fp_gallery_deflate (body, error);
+          if (!deflated)
+            return FALSE;
+
+          fpi_print_export_prefilters (print, filters);
+
+          entry.prefilters = buffer->len + sizeof (entry);
+          entry.payload = entry.prefilters + filters->len;
+          entry.payload_size = g_bytes_get_size (deflated);
+          entry.raw_size = g_bytes_get_size (body);
+
+          g_hash_table_insert (payloads, g_bytes_ref (body),
+                               g_memdup (&entry, sizeof (entry)));
+
+          g_byte_array_append (buffer, (const guint8 *) &entry, sizeof (entry));
+          g_byte_array_append (buffer, filters->data, filters->len);
+          g_byte_array_append (buffer,
+                               g_bytes_get_data (deflated, NULL),
+                               g_bytes_get_size (deflated));
+          /* Keep the next entry 4 byte aligned past the compressed
+           * bytes, which have no natural length alignment. */
+          while (buffer->len % 4 != 0)
+            g_byte_array_append (buffer, (const guint8 *) "", 1);
+        }
+    }
+
+  return g_file_set_contents (path, (const gchar *) buffer->data,
+                              buffer->len, error);
+}
+
+/**
+ * fp_gallery_write_to_file_full:
+ * @prints: (element-type FpPrint): NBIS prints to store
+ * @path: Path of the gallery file to create
+ * @flags: #FpGalleryWriteFlags modifying the written format
+ * @error: Return location for error
+ *
+ * Like fp_gallery_write_to_file(), with control over the on-disk
+ * format. With %FP_GALLERY_WRITE_COMPRESS the packed minutiae tables
+ * are stored zlib compressed — typically around a third of the
+ * uncompressed size — while the per-view prefilter vectors stay
+ * readable in place, so loading and screening such a gallery never
+ * touches the compressed payloads; they are inflated per template on
+ * first use, see fp_gallery_new_for_file().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_gallery_write_to_file_full (GPtrArray          *prints,
+                               const gchar        *path,
+                               FpGalleryWriteFlags flags,
+                               GError            **error)
+{
+  g_return_val_if_fail (prints != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (flags & FP_GALLERY_WRITE_COMPRESS)
+    return fp_gallery_write_compressed (prints, path, error);
+
+  return fp_gallery_write_to_file (prints, path, error);
+}
@@ -0,0 +1,65 @@
+/*
+ * FPrint Gallery - Persistent template gallery
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "fp-print.h"
+
+G_BEGIN_DECLS
+
+#define FP_TYPE_GALLERY (fp_gallery_get_type ())
+G_DECLARE_FINAL_TYPE (FpGallery, fp_gallery, FP, GALLERY, GObject)
+
+FpGallery *fp_gallery_new_for_file (const gchar *path,
+                                    GError     **error);
+
+GPtrArray *fp_gallery_get_prints (FpGallery *gallery);
+guint      fp_gallery_get_size (FpGallery *gallery);
+
+void       fp_gallery_warmup_async (FpGallery          *gallery,
+                                    GCancellable       *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer            user_data);
+gboolean   fp_gallery_warmup_finish (FpGallery    *gallery,
+                                     GAsyncResult *result,
+                                     GError      **error);
+
+gboolean   fp_gallery_write_to_file (GPtrArray   *prints,
+                                     const gchar *path,
+                                     GError     **error);
+
+/**
+ * FpGalleryWriteFlags:
+ * @FP_GALLERY_WRITE_NONE: No flags
+ * @FP_GALLERY_WRITE_COMPRESS: Compress the stored minutiae tables with
+ *   zlib; readers decompress each template on first use
+ *
+ * Flags modifying the format written by fp_gallery_write_to_file_full().
+ */
+typedef enum /*< flags >*/ {
+  FP_GALLERY_WRITE_NONE = 0,
+  FP_GALLERY_WRITE_COMPRESS = 1 << 0,
+} FpGalleryWriteFlags;
+
+gboolean   fp_gallery_write_to_file_full (GPtrArray          *prints,
+                                          const gchar        *path,
+                                          FpGalleryWriteFlags flags,
+                                          GError            **error);
+
+G_END_DECLS
@@ -23,6 +23,10 @@
 
 #define IMG_ENROLL_STAGES 5
 
+/* Raw-frame budget per enroll operation: only this many stage prints
+ * keep their pixel data, see fp_image_device_enroll_keep_raw(). */
+#define ENROLL_RAW_FRAMES_KEPT 2
+
 typedef struct
 {
   FpiImageDeviceState state;
@@ -32,10 +36,25 @@ typedef struct
 
   gint                enroll_stage;
 
+  /* Quality scores of the enroll frames admitted to the raw-frame
+   * budget, see fp_image_device_enroll_keep_raw(). */
+  guint               enroll_kept_quality[ENROLL_RAW_FRAMES_KEPT];
+  guint               enroll_kept_count;
+
   gboolean            minutiae_scan_active;
+  gboolean            match_active;
+
+  /* A retryable error was reported with resume-on-retry set; once the
+   * finger leaves the sensor, re-arm it instead of deactivating. */
+  gboolean            retry_pending;
   GError             *action_error;
   FpImage            *capture_image;
 
+  /* Detection session (LFS_SESSION) carried across the minutiae scans
+   * of one enroll action, so later stages reuse the earlier stages'
+   * direction-map results. */
+  gpointer            minutiae_session;
+
   gint                bz3_threshold;
 } FpImageDevicePrivate;
 
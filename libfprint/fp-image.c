@@ -22,7 +22,10 @@
 
 #include "fpi-image.h"
 #include "fpi-log.h"
+#include "fpi-simd.h"
+#include "fpi-trace.h"
 
+#include <math.h>
 #include <nbis.h>
 
 /**
@@ -48,30 +51,241 @@ static GParamSpec *properties[N_PROPS];
 FpImage *
 fp_image_new (gint width, gint height)
 {
-  return g_object_new (FP_TYPE_IMAGE,
+  FpImage *self;
+
+  self = g_object_new (FP_TYPE_IMAGE,
                        "width", width,
                        "height", height,
                        NULL);
+  self->data = g_malloc0 (self->width * self->height);
+
+  return self;
 }
 
+/**
+ * fp_image_new_take: (skip)
+ * @width: The width of the image
+ * @height: The height of the image
+ * @data: (transfer full): Image data, one byte per pixel in row-major
+ *   order, %width * %height bytes long, allocated with g_malloc()
+ *
+ * Create a new #FpImage taking ownership of an existing pixel buffer,
+ * avoiding the copy that fp_image_new() plus memcpy() would incur.
+ * Drivers can hand their capture buffer directly to the image.
+ *
+ * Returns: (transfer full): A newly created #FpImage
+ */
+FpImage *
+fp_image_new_take (gint width, gint height, guint8 *data)
+{
+  FpImage *self;
+
+  self = g_object_new (FP_TYPE_IMAGE,
+                       "width", width,
+                       "height", height,
+                       NULL);
+  self->data = data;
+
+  return self;
+}
+
+/* Drop the image pixels, honoring their backing: pixels wrapped from a
+ * file mapping belong to the mapping, everything else to the heap. */
 static void
-fp_image_finalize (GObject *object)
+fp_image_release_data (FpImage *self)
 {
-  FpImage *self = (FpImage *) object;
+  if (self->mapped)
+    {
+      self->data = NULL;
+      g_clear_pointer (&self->mapped, g_mapped_file_unref);
+    }
+  else
+    {
+      g_clear_pointer (&self->data, g_free);
+    }
+}
 
-  g_clear_pointer (&self->data, g_free);
-  g_clear_pointer (&self->binarized, g_free);
-  g_clear_pointer (&self->minutiae, g_ptr_array_unref);
+static FpImage *
+fp_image_new_mapped (GMappedFile *map, gsize offset, guint width, guint height)
+{
+  FpImage *self;
 
-  G_OBJECT_CLASS (fp_image_parent_class)->finalize (object);
+  self = g_object_new (FP_TYPE_IMAGE,
+                       "width", width,
+                       "height", height,
+                       NULL);
+  self->mapped = map;
+  self->data = (guint8 *) g_mapped_file_get_contents (map) + offset;
+
+  return self;
+}
+
+/* Scan the next unsigned decimal in a PGM header, skipping whitespace
+ * and "#" comment lines before it. */
+static gboolean
+pgm_next_int (const gchar *buf, gsize len, gsize *pos, guint *value)
+{
+  gsize i = *pos;
+  guint v = 0;
+  gboolean seen = FALSE;
+
+  while (i < len)
+    {
+      if (buf[i] == '#')
+        {
+          while (i < len && buf[i] != '\n')
+            i++;
+        }
+      else if (g_ascii_isspace (buf[i]))
+        {
+          i++;
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  while (i < len && g_ascii_isdigit (buf[i]))
+    {
+      v = v * 10 + (buf[i] - '0');
+      if (v > G_MAXUINT16)
+        return FALSE;
+      seen = TRUE;
+      i++;
+    }
+
+  if (!seen)
+    return FALSE;
+
+  *pos = i;
+  *value = v;
+  return TRUE;
+}
+
+/**
+ * fp_image_new_from_file:
+ * @path: (type filename): Path of an 8-bit binary PGM ("P5") file
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Create a new #FpImage backed by a memory mapped image file. The pixel
+ * data is not copied: the image wraps the mapping directly and keeps it
+ * alive for as long as the original pixels are needed, so replaying a
+ * capture corpus costs no read I/O once the page cache is warm. The
+ * file must be an 8-bit binary PGM, as written by fp_image_export_async()
+ * with %FP_IMAGE_EXPORT_FORMAT_PGM or by the img-capture example; use
+ * fp_image_new_from_file_raw() for headerless pixel dumps.
+ *
+ * Returns: (transfer full): A newly created #FpImage, or %NULL on error
+ */
+FpImage *
+fp_image_new_from_file (const gchar *path, GError **error)
+{
+  g_autoptr(GMappedFile) map = NULL;
+  const gchar *buf;
+  gsize len, pos;
+  guint width, height, maxval;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  map = g_mapped_file_new (path, FALSE, error);
+  if (!map)
+    return NULL;
+
+  buf = g_mapped_file_get_contents (map);
+  len = g_mapped_file_get_length (map);
+
+  if (len < 2 || buf[0] != 'P' || buf[1] != '5')
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "%s is not a binary PGM file", path);
+      return NULL;
+    }
+
+  pos = 2;
+  if (!pgm_next_int (buf, len, &pos, &width) ||
+      !pgm_next_int (buf, len, &pos, &height) ||
+      !pgm_next_int (buf, len, &pos, &maxval) ||
+      pos >= len || !g_ascii_isspace (buf[pos]))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "%s has a malformed PGM header", path);
+      return NULL;
+    }
+  /* A single whitespace character separates the header from the pixels. */
+  pos++;
+
+  if (width == 0 || height == 0 || maxval != 255)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "%s: only 8-bit grayscale PGM images are supported", path);
+      return NULL;
+    }
+
+  if (len - pos < (gsize) width * height)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                   "%s is truncated", path);
+      return NULL;
+    }
+
+  return fp_image_new_mapped (g_steal_pointer (&map), pos, width, height);
+}
+
+/**
+ * fp_image_new_from_file_raw:
+ * @path: (type filename): Path of a headerless 8-bit grayscale pixel dump
+ * @width: The width of the image
+ * @height: The height of the image
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Create a new #FpImage backed by a memory mapped raw pixel file, one
+ * byte per pixel in row-major order. Like fp_image_new_from_file() the
+ * pixels are wrapped zero-copy; the geometry must be supplied by the
+ * caller since the file carries none.
+ *
+ * Returns: (transfer full): A newly created #FpImage, or %NULL on error
+ */
+FpImage *
+fp_image_new_from_file_raw (const gchar *path,
+                            gint         width,
+                            gint         height,
+                            GError     **error)
+{
+  g_autoptr(GMappedFile) map = NULL;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  map = g_mapped_file_new (path, FALSE, error);
+  if (!map)
+    return NULL;
+
+  if (g_mapped_file_get_length (map) < (gsize) width * height)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                   "%s is smaller than %dx%d pixels", path, width, height);
+      return NULL;
+    }
+
+  return fp_image_new_mapped (g_steal_pointer (&map), 0, width, height);
 }
 
 static void
-fp_image_constructed (GObject *object)
+fp_image_finalize (GObject *object)
 {
   FpImage *self = (FpImage *) object;
+  guint i;
 
-  self->data = g_malloc0 (self->width * self->height);
+  fp_image_release_data (self);
+  g_clear_pointer (&self->binarized, g_free);
+  for (i = 0; i < FPI_IMAGE_PYRAMID_DEPTH; i++)
+    g_clear_pointer (&self->pyramid[i], g_free);
+  g_clear_pointer (&self->minutiae, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (fp_image_parent_class)->finalize (object);
 }
 
 static void
@@ -126,7 +340,6 @@ fp_image_class_init (FpImageClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->finalize = fp_image_finalize;
-  object_class->constructed = fp_image_constructed;
   object_class->set_property = fp_image_set_property;
   object_class->get_property = fp_image_get_property;
 
@@ -154,6 +367,7 @@ fp_image_class_init (FpImageClass *klass)
 static void
 fp_image_init (FpImage *self)
 {
+  self->quality_score = -1;
 }
 
 typedef struct
@@ -165,6 +379,7 @@ typedef struct
   FpiImageFlags       flags;
   guchar             *image;
   guchar             *binarized;
+  gpointer            session;
 } DetectMinutiaeData;
 
 static void
@@ -185,6 +400,8 @@ fp_image_detect_minutiae_cb (GObject      *source_object,
   FpImage *image;
   DetectMinutiaeData *data = g_task_get_task_data (task);
 
+  fpi_trace_span_end ("detect-minutiae %p", source_object);
+
   if (!g_task_had_error (task))
     {
       gint i;
@@ -192,11 +409,20 @@ fp_image_detect_minutiae_cb (GObject      *source_object,
 
       image->flags = data->flags;
 
-      g_clear_pointer (&image->data, g_free);
+      /* The normalized pixels replace the originals; this also drops a
+       * file mapping once its contents are no longer referenced. */
+      fp_image_release_data (image);
       image->data = g_steal_pointer (&data->image);
 
+      /* The pixels changed, so cached downscales of them are stale. */
+      for (i = 0; i < FPI_IMAGE_PYRAMID_DEPTH; i++)
+        g_clear_pointer (&image->pyramid[i], g_free);
+
       g_clear_pointer (&image->binarized, g_free);
-      image->binarized = g_steal_pointer (&data->binarized);
+      if (image->retention == FP_IMAGE_RETENTION_MINUTIAE_ONLY)
+        g_clear_pointer (&data->binarized, g_free);
+      else
+        image->binarized = g_steal_pointer (&data->binarized);
 
       g_clear_pointer (&image->minutiae, g_ptr_array_unref);
       image->minutiae = g_ptr_array_new_full (data->minutiae->num,
@@ -214,6 +440,24 @@ fp_image_detect_minutiae_cb (GObject      *source_object,
     data->user_cb (source_object, res, user_data);
 }
 
+/* The normalization kernels below run in-place over full frames before
+ * minutiae detection and are shaped for the auto-vectorizer (see
+ * fpi-simd.h). */
+
+FPI_SIMD_CLONES static void
+reverse_bytes (guint8 *data, gint len)
+{
+  int i;
+
+  for (i = 0; i < len / 2; i++)
+    {
+      guint8 tmp = data[i];
+
+      data[i] = data[len - i - 1];
+      data[len - i - 1] = tmp;
+    }
+}
+
 static void
 vflip (guint8 *data, gint width, gint height)
 {
@@ -240,20 +484,13 @@ vflip (guint8 *data, gint width, gint height)
 static void
 hflip (guint8 *data, gint width, gint height)
 {
-  unsigned char rowbuf[width];
-  int i, j;
+  int i;
 
   for (i = 0; i < height; i++)
-    {
-      int offset = i * width;
-
-      memcpy (rowbuf, data + offset, width);
-      for (j = 0; j < width; j++)
-        data[offset + j] = rowbuf[width - j - 1];
-    }
+    reverse_bytes (data + i * width, width);
 }
 
-static void
+FPI_SIMD_CLONES static void
 invert_colors (guint8 *data, gint width, gint height)
 {
   int data_len = width * height;
@@ -263,6 +500,12 @@ invert_colors (guint8 *data, gint width, gint height)
     data[i] = 0xff - data[i];
 }
 
+static int
+fp_image_detect_minutiae_cancelled (void *user_data)
+{
+  return g_cancellable_is_cancelled (G_CANCELLABLE (user_data));
+}
+
 static void
 fp_image_detect_minutiae_thread_func (GTask        *task,
                                       gpointer      source_object,
@@ -283,28 +526,57 @@ fp_image_detect_minutiae_thread_func (GTask        *task,
   gint r;
   g_autofree LFSPARMS *lfsparms = NULL;
 
-  /* Normalize the image first */
-  if (data->flags & FPI_IMAGE_H_FLIPPED)
+  /* Normalize the image first. A flip around both axes is a 180°
+   * rotation, i.e. one pass reversing the whole buffer instead of a
+   * row reversal pass followed by a row swap pass. */
+  if ((data->flags & FPI_IMAGE_H_FLIPPED) && (data->flags & FPI_IMAGE_V_FLIPPED))
+    reverse_bytes (data->image, data->width * data->height);
+  else if (data->flags & FPI_IMAGE_H_FLIPPED)
     hflip (data->image, data->width, data->height);
-
-  if (data->flags & FPI_IMAGE_V_FLIPPED)
+  else if (data->flags & FPI_IMAGE_V_FLIPPED)
     vflip (data->image, data->width, data->height);
 
   if (data->flags & FPI_IMAGE_COLORS_INVERTED)
     invert_colors (data->image, data->width, data->height);
 
-  data->flags &= ~(FPI_IMAGE_H_FLIPPED | FPI_IMAGE_V_FLIPPED | FPI_IMAGE_COLORS_INVERTED);
+  if (data->flags & FPI_IMAGE_CLAHE)
+    fpi_image_clahe (data->image, data->width, data->height);
+
+  data->flags &= ~(FPI_IMAGE_H_FLIPPED | FPI_IMAGE_V_FLIPPED | FPI_IMAGE_COLORS_INVERTED |
+                   FPI_IMAGE_CLAHE);
 
   lfsparms = g_memdup (&g_lfsparms_V2, sizeof (LFSPARMS));
   lfsparms->remove_perimeter_pts = data->flags & FPI_IMAGE_PARTIAL ? TRUE : FALSE;
+  lfsparms->adaptive_binarize = data->flags & FPI_IMAGE_ADAPTIVE_BINARIZATION ? TRUE : FALSE;
+  /* Embedded deployments can cap detection's transient buffers at the
+   * cost of some extra time on large sensors. */
+  lfsparms->low_memory = g_getenv ("FP_LOW_MEMORY") != NULL ? TRUE : FALSE;
+
+  /* Let the scan bail out at the next stage boundary once the task is
+   * cancelled, instead of blocking the pool thread for the full run. */
+  if (cancellable)
+    lfs_set_cancel_check (fp_image_detect_minutiae_cancelled, cancellable);
 
   timer = g_timer_new ();
   r = get_minutiae (&minutiae, &quality_map, &direction_map,
                     &low_contrast_map, &low_flow_map, &high_curve_map,
                     &map_w, &map_h, &bdata, &bw, &bh, &bd,
                     data->image, data->width, data->height, 8,
-                    data->ppmm, lfsparms);
+                    data->ppmm, lfsparms, data->session);
   g_timer_stop (timer);
+
+  if (cancellable)
+    lfs_set_cancel_check (NULL, NULL);
+
+  if (r == LFS_CANCELLED)
+    {
+      fp_dbg ("Minutiae scan cancelled after %f secs", g_timer_elapsed (timer, NULL));
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                               "Minutiae scan was cancelled");
+      g_object_unref (task);
+      return;
+    }
+
   fp_dbg ("Minutiae scan completed in %f secs", g_timer_elapsed (timer, NULL));
 
   data->binarized = g_steal_pointer (&bdata);
@@ -392,6 +664,47 @@ fp_image_get_data (FpImage *self, gsize *len)
   return self->data;
 }
 
+/* Re-run the detection to rebuild the binarized buffer after it was
+ * dropped under FP_IMAGE_RETENTION_MINUTIAE_ONLY. The image data was
+ * already normalized by the first detection, so the flags can be taken
+ * as-is; everything but the binarized result is thrown away. */
+static void
+fp_image_regenerate_binarized (FpImage *self)
+{
+  struct fp_minutiae *minutiae = NULL;
+  g_autofree gint *direction_map = NULL;
+  g_autofree gint *low_contrast_map = NULL;
+  g_autofree gint *low_flow_map = NULL;
+  g_autofree gint *high_curve_map = NULL;
+  g_autofree gint *quality_map = NULL;
+  g_autofree guchar *bdata = NULL;
+  g_autofree guchar *idata = NULL;
+  g_autofree LFSPARMS *lfsparms = NULL;
+  gint map_w, map_h;
+  gint bw, bh, bd;
+  gint r;
+
+  idata = g_memdup (self->data, self->width * self->height);
+  lfsparms = g_memdup (&g_lfsparms_V2, sizeof (LFSPARMS));
+  lfsparms->remove_perimeter_pts = self->flags & FPI_IMAGE_PARTIAL ? TRUE : FALSE;
+  lfsparms->low_memory = g_getenv ("FP_LOW_MEMORY") != NULL ? TRUE : FALSE;
+
+  r = get_minutiae (&minutiae, &quality_map, &direction_map,
+                    &low_contrast_map, &low_flow_map, &high_curve_map,
+                    &map_w, &map_h, &bdata, &bw, &bh, &bd,
+                    idata, self->width, self->height, 8,
+                    self->ppmm, lfsparms, NULL);
+  g_clear_pointer (&minutiae, free_minutiae);
+
+  if (r)
+    {
+      fp_err ("regenerating binarized image failed, code %d", r);
+      return;
+    }
+
+  self->binarized = g_steal_pointer (&bdata);
+}
+
 /**
  * fp_image_get_binarized:
  * @self: A #FpImage
@@ -401,17 +714,126 @@ fp_image_get_data (FpImage *self, gsize *len)
  * freed. You need to first detect the minutiae using
  * fp_image_detect_minutiae().
  *
+ * Under %FP_IMAGE_RETENTION_MINUTIAE_ONLY the buffer is regenerated on
+ * demand, which re-runs the detection synchronously.
+ *
  * Returns: (transfer none) (array length=len): The binarized image data
  */
 const guchar *
 fp_image_get_binarized (FpImage *self, gsize *len)
 {
+  if (!self->binarized && self->minutiae && self->data)
+    fp_image_regenerate_binarized (self);
+
   if (len && self->binarized)
     *len = self->width * self->height;
 
   return self->binarized;
 }
 
+/* Block size for the coarse quality estimate; matches the map block
+ * size mindtct uses at 500 ppi. */
+#define QUALITY_BLOCK_SIZE 8
+/* Minimum gray-level variance for a block to count as fingerprint
+ * rather than background. */
+#define QUALITY_MIN_VARIANCE 100.0
+/* Foreground coverage at which the score is no longer penalized. */
+#define QUALITY_FULL_COVERAGE 0.25
+
+/**
+ * fp_image_get_quality_score:
+ * @self: A #FpImage
+ *
+ * Estimates the fingerprint image quality in a single cheap pass over
+ * the pixels, combining local contrast with the coherence of the
+ * coarse ridge-flow direction. Unlike the per-minutia quality from
+ * fp_image_detect_minutiae() this does not run the detection pipeline,
+ * so it is suitable for discarding bad frames early.
+ *
+ * Returns: A score between 0 (garbage) and 100 (clean ridge flow)
+ */
+guint
+fp_image_get_quality_score (FpImage *self)
+{
+  gdouble coherence_sum = 0.0;
+  gdouble coverage;
+  guint fg_blocks = 0, blocks = 0;
+  guint bx, by, x, y;
+
+  g_return_val_if_fail (FP_IS_IMAGE (self), 0);
+
+  if (self->quality_score >= 0)
+    return self->quality_score;
+
+  if (!self->data ||
+      self->width < QUALITY_BLOCK_SIZE || self->height < QUALITY_BLOCK_SIZE)
+    return 0;
+
+  for (by = 0; by + QUALITY_BLOCK_SIZE <= self->height; by += QUALITY_BLOCK_SIZE)
+    {
+      for (bx = 0; bx + QUALITY_BLOCK_SIZE <= self->width; bx += QUALITY_BLOCK_SIZE)
+        {
+          gdouble sum = 0.0, sq_sum = 0.0;
+          gdouble gxx = 0.0, gyy = 0.0, gxy = 0.0;
+          gdouble mean, variance, denom;
+          guint n = QUALITY_BLOCK_SIZE * QUALITY_BLOCK_SIZE;
+
+          for (y = by; y < by + QUALITY_BLOCK_SIZE; y++)
+            {
+              const guint8 *row = self->data + y * self->width + bx;
+
+              for (x = 0; x < QUALITY_BLOCK_SIZE; x++)
+                {
+                  gdouble p = row[x];
+                  gdouble gx, gy;
+
+                  sum += p;
+                  sq_sum += p * p;
+
+                  /* Forward differences within the block interior. */
+                  if (x + 1 < QUALITY_BLOCK_SIZE && y + 1 < by + QUALITY_BLOCK_SIZE)
+                    {
+                      gx = (gdouble) row[x + 1] - p;
+                      gy = (gdouble) row[x + self->width] - p;
+                      gxx += gx * gx;
+                      gyy += gy * gy;
+                      gxy += gx * gy;
+                    }
+                }
+            }
+
+          blocks++;
+
+          mean = sum / n;
+          variance = sq_sum / n - mean * mean;
+          if (variance < QUALITY_MIN_VARIANCE)
+            continue;
+
+          fg_blocks++;
+
+          /* Standard ridge-flow coherence of the gradient tensor:
+           * 1 for a perfectly oriented block, 0 for isotropic noise. */
+          denom = gxx + gyy;
+          if (denom > 0.0)
+            coherence_sum += sqrt ((gxx - gyy) * (gxx - gyy) + 4.0 * gxy * gxy) / denom;
+        }
+    }
+
+  if (fg_blocks == 0 || blocks == 0)
+    {
+      self->quality_score = 0;
+      return 0;
+    }
+
+  /* Penalize frames where only a sliver of the sensor saw the finger. */
+  coverage = MIN (1.0, ((gdouble) fg_blocks / blocks) / QUALITY_FULL_COVERAGE);
+
+  self->quality_score = (gint) (100.0 * coverage * (coherence_sum / fg_blocks) + 0.5);
+  self->quality_score = CLAMP (self->quality_score, 0, 100);
+
+  return self->quality_score;
+}
+
 /**
  * fp_image_get_minutiae:
  * @self: A #FpImage
@@ -428,6 +850,88 @@ fp_image_get_minutiae (FpImage *self)
   return self->minutiae;
 }
 
+/**
+ * fp_image_set_retention:
+ * @self: A #FpImage
+ * @retention: The #FpImageRetention policy to apply
+ *
+ * Sets the buffer retention policy for the image. With
+ * %FP_IMAGE_RETENTION_MINUTIAE_ONLY the binarized buffer is dropped as
+ * soon as minutiae have been extracted from it; if it already exists it
+ * is dropped immediately. See fp_image_get_binarized() for how to get
+ * it back.
+ *
+ * The default is %FP_IMAGE_RETENTION_FULL.
+ */
+void
+fp_image_set_retention (FpImage *self, FpImageRetention retention)
+{
+  g_return_if_fail (FP_IS_IMAGE (self));
+
+  self->retention = retention;
+
+  if (retention == FP_IMAGE_RETENTION_MINUTIAE_ONLY && self->minutiae)
+    g_clear_pointer (&self->binarized, g_free);
+}
+
+/* Dedicated pool for minutiae detection, so detections do not queue
+ * behind unrelated work in GLib's shared GTask pool. Entries are sorted
+ * by task priority, letting interactive matches overtake queued
+ * background work such as enrollment processing. The size can be set
+ * with the FP_DETECT_THREADS environment variable; detection itself
+ * parallelizes internally, so a small pool is enough. */
+#define DETECT_POOL_DEFAULT_THREADS 2
+
+static gint
+fp_image_detect_pool_sort (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  return g_task_get_priority ((GTask *) a) - g_task_get_priority ((GTask *) b);
+}
+
+static void
+fp_image_detect_pool_func (gpointer data, gpointer user_data)
+{
+  GTask *task = data;
+
+  /* The thread function returns the task and releases the creation
+   * reference handed over by fp_image_detect_minutiae(). */
+  fp_image_detect_minutiae_thread_func (task,
+                                        g_task_get_source_object (task),
+                                        g_task_get_task_data (task),
+                                        g_task_get_cancellable (task));
+}
+
+static GThreadPool *
+fp_image_detect_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    {
+      const gchar *env = g_getenv ("FP_DETECT_THREADS");
+      gint threads = DETECT_POOL_DEFAULT_THREADS;
+      GThreadPool *new_pool;
+
+      if (env)
+        {
+          gint64 value = g_ascii_strtoll (env, NULL, 10);
+
+          if (value >= 1 && value <= 64)
+            threads = value;
+          else
+            g_warning ("Ignoring out of range FP_DETECT_THREADS value \"%s\"", env);
+        }
+
+      new_pool = g_thread_pool_new (fp_image_detect_pool_func, NULL,
+                                    threads, FALSE, NULL);
+      g_thread_pool_set_sort_function (new_pool,
+                                       fp_image_detect_pool_sort, NULL);
+      g_once_init_leave (&pool, new_pool);
+    }
+
+  return pool;
+}
+
 /**
  * fp_image_detect_minutiae:
  * @self: A #FpImage
@@ -455,9 +959,14 @@ fp_image_detect_minutiae (FpImage            *self,
   data->height = self->height;
   data->ppmm = self->ppmm;
   data->user_cb = callback;
+  /* One-shot: the session is owned by the image device and only valid
+   * for the scan it was attached for. */
+  data->session = g_steal_pointer (&self->detection_session);
 
   g_task_set_task_data (task, data, (GDestroyNotify) fp_image_detect_minutiae_free);
-  g_task_run_in_thread (task, fp_image_detect_minutiae_thread_func);
+  g_task_set_priority (task, self->detect_priority);
+  fpi_trace_span_begin ("detect-minutiae %p", self);
+  g_thread_pool_push (fp_image_detect_pool (), task, NULL);
 }
 
 /**
@@ -478,6 +987,287 @@ fp_image_detect_minutiae_finish (FpImage      *self,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+typedef struct
+{
+  guint   pending;
+  GError *error;
+} BatchDetectData;
+
+static void
+fp_image_detect_minutiae_batch_free (BatchDetectData *data)
+{
+  g_clear_error (&data->error);
+  g_free (data);
+}
+
+static void
+fp_image_detect_minutiae_batch_cb (GObject      *source_object,
+                                   GAsyncResult *res,
+                                   gpointer      user_data)
+{
+  GTask *task = user_data;
+  BatchDetectData *data = g_task_get_task_data (task);
+  g_autoptr(GError) error = NULL;
+
+  /* Detections complete on the context the batch was started from, so
+   * the countdown needs no locking. */
+  if (!fp_image_detect_minutiae_finish (FP_IMAGE (source_object), res, &error) &&
+      data->error == NULL)
+    data->error = g_steal_pointer (&error);
+
+  data->pending -= 1;
+  if (data->pending > 0)
+    return;
+
+  if (data->error)
+    g_task_return_error (task, g_steal_pointer (&data->error));
+  else
+    g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+/**
+ * fp_image_detect_minutiae_batch:
+ * @images: (array length=n_images): The #FpImage's to process
+ * @n_images: Length of @images
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to call once all detections completed
+ * @user_data: the data to pass to @callback
+ *
+ * Detects the minutiae of several images at once. The detections are
+ * distributed over the detection pool and run concurrently, which cuts
+ * the wall-clock time of e.g. enrollment post-processing compared to
+ * waiting for each image in turn. @callback is invoked once every image
+ * has completed; if any detection failed, the first error is reported
+ * by fp_image_detect_minutiae_batch_finish() while the other images
+ * keep whatever their detection produced.
+ */
+void
+fp_image_detect_minutiae_batch (FpImage            **images,
+                                guint                n_images,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+  GTask *task;
+  BatchDetectData *data;
+  guint i;
+
+  g_return_if_fail (images != NULL || n_images == 0);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fp_image_detect_minutiae_batch);
+
+  if (n_images == 0)
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  data = g_new0 (BatchDetectData, 1);
+  data->pending = n_images;
+  g_task_set_task_data (task, data,
+                        (GDestroyNotify) fp_image_detect_minutiae_batch_free);
+
+  for (i = 0; i < n_images; i++)
+    fp_image_detect_minutiae (images[i], cancellable,
+                              fp_image_detect_minutiae_batch_cb, task);
+}
+
+/**
+ * fp_image_detect_minutiae_batch_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish minutiae detection of a batch of images started with
+ * fp_image_detect_minutiae_batch().
+ *
+ * Returns: %TRUE if every detection succeeded
+ */
+gboolean
+fp_image_detect_minutiae_batch_finish (GAsyncResult *result,
+                                       GError      **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+typedef struct
+{
+  FpImageExportFormat format;
+  /* Borrowed from the image; the task's reference on the image keeps
+   * the buffer alive for the duration of the export. */
+  const guint8       *pixels;
+  gsize               len;
+  gint                width, height;
+} ExportData;
+
+static void
+fp_image_export_thread_func (GTask        *task,
+                             gpointer      source_object,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+  ExportData *data = task_data;
+  g_autoptr(GByteArray) out = NULL;
+  gchar header[32];
+  gsize header_len;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  header_len = g_snprintf (header, sizeof (header), "P5\n%d %d\n255\n",
+                           data->width, data->height);
+
+  if (data->format == FP_IMAGE_EXPORT_FORMAT_PGM)
+    {
+      out = g_byte_array_sized_new (header_len + data->len);
+      g_byte_array_append (out, (const guint8 *) header, header_len);
+      g_byte_array_append (out, data->pixels, data->len);
+    }
+  else
+    {
+      g_autoptr(GZlibCompressor) compressor = NULL;
+      const guint8 *chunks[2] = { (const guint8 *) header, data->pixels };
+      gsize chunk_lens[2] = { header_len, data->len };
+      gboolean finished = FALSE;
+      guint8 outbuf[16384];
+      gint i;
+
+      compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+      out = g_byte_array_sized_new (data->len / 2);
+
+      /* Feed header and pixel buffer through the compressor back to
+       * back, so no concatenated copy of the frame is ever made. */
+      for (i = 0; i < 2 && !finished; i++)
+        {
+          const guint8 *in = chunks[i];
+          gsize in_len = chunk_lens[i];
+          GConverterFlags flags =
+            (i == 1) ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS;
+
+          while (in_len > 0 || (i == 1 && !finished))
+            {
+              g_autoptr(GError) error = NULL;
+              GConverterResult res;
+              gsize bytes_read = 0, bytes_written = 0;
+
+              res = g_converter_convert (G_CONVERTER (compressor),
+                                         in, in_len,
+                                         outbuf, sizeof (outbuf),
+                                         flags,
+                                         &bytes_read, &bytes_written,
+                                         &error);
+              if (res == G_CONVERTER_ERROR)
+                {
+                  /* The compressor wants the next input chunk. */
+                  if (g_error_matches (error, G_IO_ERROR,
+                                       G_IO_ERROR_PARTIAL_INPUT) &&
+                      in_len == 0 && i == 0)
+                    break;
+
+                  g_task_return_error (task, g_steal_pointer (&error));
+                  return;
+                }
+
+              g_byte_array_append (out, outbuf, bytes_written);
+              in += bytes_read;
+              in_len -= bytes_read;
+
+              if (res == G_CONVERTER_FINISHED)
+                {
+                  finished = TRUE;
+                  break;
+                }
+            }
+        }
+    }
+
+  g_task_return_pointer (task,
+                         g_byte_array_free_to_bytes (g_steal_pointer (&out)),
+                         (GDestroyNotify) g_bytes_unref);
+}
+
+/**
+ * fp_image_export_async:
+ * @self: A #FpImage
+ * @format: The #FpImageExportFormat to produce
+ * @binarized: Export the binarized image rather than the grayscale one
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Encode the image for archival on a worker thread, straight from the
+ * image's pixel buffer; no intermediate copy of the frame is made and
+ * the calling main loop is not blocked while encoding. Retrieve the
+ * result with fp_image_export_finish().
+ *
+ * The image must not be modified while the export runs; in particular
+ * do not run fp_image_detect_minutiae() on it concurrently.
+ *
+ * If @binarized is set and the binarized buffer was dropped through
+ * %FP_IMAGE_RETENTION_MINUTIAE_ONLY, it is regenerated synchronously
+ * first; see fp_image_get_binarized().
+ */
+void
+fp_image_export_async (FpImage            *self,
+                       FpImageExportFormat format,
+                       gboolean            binarized,
+                       GCancellable       *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  ExportData *data;
+  const guchar *pixels;
+  gsize len = 0;
+
+  g_return_if_fail (FP_IS_IMAGE (self));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+
+  if (binarized)
+    pixels = fp_image_get_binarized (self, &len);
+  else
+    pixels = fp_image_get_data (self, &len);
+
+  if (!pixels || len == 0)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               "Image has no %s data to export",
+                               binarized ? "binarized" : "pixel");
+      return;
+    }
+
+  data = g_new0 (ExportData, 1);
+  data->format = format;
+  data->pixels = pixels;
+  data->len = len;
+  data->width = self->width;
+  data->height = self->height;
+
+  g_task_set_task_data (task, data, g_free);
+  g_task_run_in_thread (task, fp_image_export_thread_func);
+}
+
+/**
+ * fp_image_export_finish:
+ * @self: A #FpImage
+ * @result: A #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous image export. See fp_image_export_async().
+ *
+ * Returns: (transfer full): The encoded image, or %NULL on error
+ */
+GBytes *
+fp_image_export_finish (FpImage      *self,
+                        GAsyncResult *result,
+                        GError      **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /**
  * fp_minutia_get_coords:
  * @min: A #FpMinutia
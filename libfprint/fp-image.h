@@ -28,17 +28,64 @@ G_BEGIN_DECLS
 
 typedef struct fp_minutia FpMinutia;
 
+/**
+ * FpImageRetention:
+ * @FP_IMAGE_RETENTION_FULL: Keep all pixel buffers, including the
+ *   binarized image, for the lifetime of the image. This is the default.
+ * @FP_IMAGE_RETENTION_MINUTIAE_ONLY: Drop the binarized buffer once
+ *   minutiae have been extracted. fp_image_get_binarized() regenerates
+ *   it on demand, at the cost of re-running the detection.
+ *
+ * Policy controlling which pixel buffers an image keeps around after
+ * minutiae detection. Applications holding many images at once (e.g.
+ * during multi-finger enrollment) can use
+ * %FP_IMAGE_RETENTION_MINUTIAE_ONLY to roughly halve the per-image
+ * memory footprint.
+ */
+typedef enum {
+  FP_IMAGE_RETENTION_FULL,
+  FP_IMAGE_RETENTION_MINUTIAE_ONLY,
+} FpImageRetention;
+
+/**
+ * FpImageExportFormat:
+ * @FP_IMAGE_EXPORT_FORMAT_PGM: Binary PGM ("P5"), uncompressed.
+ * @FP_IMAGE_EXPORT_FORMAT_PGM_GZ: Binary PGM, gzip compressed.
+ *
+ * Archive formats produced by fp_image_export_async(). Grayscale
+ * fingerprint frames compress well losslessly; gzip typically shrinks
+ * them to a fraction of the raw size while staying readable with
+ * standard tools.
+ */
+typedef enum {
+  FP_IMAGE_EXPORT_FORMAT_PGM,
+  FP_IMAGE_EXPORT_FORMAT_PGM_GZ,
+} FpImageExportFormat;
+
 G_DECLARE_FINAL_TYPE (FpImage, fp_image, FP, IMAGE, GObject)
 
 FpImage     *fp_image_new (gint width,
                            gint height);
+FpImage     *fp_image_new_take (gint    width,
+                                gint    height,
+                                guint8 *data);
+FpImage     *fp_image_new_from_file (const gchar *path,
+                                     GError     **error);
+FpImage     *fp_image_new_from_file_raw (const gchar *path,
+                                         gint         width,
+                                         gint         height,
+                                         GError     **error);
 
 guint         fp_image_get_width (FpImage *self);
 guint         fp_image_get_height (FpImage *self);
 gdouble       fp_image_get_ppmm (FpImage *self);
+guint         fp_image_get_quality_score (FpImage *self);
 
 GPtrArray *   fp_image_get_minutiae (FpImage *self);
 
+void          fp_image_set_retention (FpImage         *self,
+                                      FpImageRetention retention);
+
 void          fp_image_detect_minutiae (FpImage            *self,
                                         GCancellable       *cancellable,
                                         GAsyncReadyCallback callback,
@@ -46,6 +93,23 @@ void          fp_image_detect_minutiae (FpImage            *self,
 gboolean      fp_image_detect_minutiae_finish (FpImage      *self,
                                                GAsyncResult *result,
                                                GError      **error);
+void          fp_image_detect_minutiae_batch (FpImage            **images,
+                                              guint                n_images,
+                                              GCancellable        *cancellable,
+                                              GAsyncReadyCallback  callback,
+                                              gpointer             user_data);
+gboolean      fp_image_detect_minutiae_batch_finish (GAsyncResult *result,
+                                                     GError      **error);
+
+void          fp_image_export_async (FpImage            *self,
+                                     FpImageExportFormat format,
+                                     gboolean            binarized,
+                                     GCancellable       *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer            user_data);
+GBytes *      fp_image_export_finish (FpImage      *self,
+                                      GAsyncResult *result,
+                                      GError      **error);
 
 const guchar * fp_image_get_data (FpImage *self,
                                   gsize   *len);
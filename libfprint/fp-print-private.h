@@ -43,4 +43,29 @@ struct _FpPrint
 
   GVariant  *data;
   GPtrArray *prints;
+
+  /* Deferred view materialization. When @lazy_cb is set, @prints holds
+   * %NULL placeholders that fpi_print_ensure_views() fills in on first
+   * use; until then @lazy_data identifies the backing payload and
+   * doubles as the matcher's deduplication key for the print. */
+  FpiPrintLazyFunc lazy_cb;
+  gpointer         lazy_data;
+  GDestroyNotify   lazy_destroy;
+  gint             lazy_done;
+
+  /* Lazily built bozorth edge tables, prefilter vectors and pose
+   * estimates, one per entry in @prints. */
+  GPtrArray *bz_edge_tables;
+  GPtrArray *bz_prefilters;
+  GPtrArray *bz_poses;
+
+  /* Reliability-ranked minutiae prefixes used to prescreen match
+   * candidates, one per entry in @prints; %NULL for views whose
+   * reliability data is gone (deserialized or merged templates). */
+  GPtrArray *bz_prefixes;
+
+  /* Lazily computed digest of the print body, used by fp_print_equal()
+   * to reject non-matching prints without walking the full data. */
+  guint64  body_hash;
+  gboolean body_hash_valid;
 };
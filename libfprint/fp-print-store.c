@@ -0,0 +1,587 @@
+/*
+ * FPrint Print Store - Asynchronous print storage
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "print-store"
+#include "fpi-log.h"
+
+#include "fp-print-store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+/**
+ * SECTION: fp-print-store
+ * @title: FpPrintStore
+ * @short_description: Asynchronous, batched print storage
+ *
+ * A #FpPrintStore persists serialized prints in a single #GVariant
+ * dictionary file, keyed by driver, device ID and finger. Unlike doing
+ * synchronous file I/O from the mainloop (the pattern the example
+ * programs used to demonstrate), saves are asynchronous and
+ * write-behind: fp_print_store_save_print_async() updates the in-memory
+ * state immediately and completes once a short coalescing window has
+ * elapsed and the batched state has been written out and synced. Saving
+ * several prints back to back — e.g. at the end of a multi-stage
+ * enrollment — therefore costs a single write and a single fdatasync()
+ * instead of one per print, and none of it blocks the mainloop.
+ *
+ * The file format is the same dictionary of serialized prints used by
+ * the example programs, so existing storage files load unchanged.
+ *
+ * A #FpPrintStore is not thread-safe; use it from a single thread, with
+ * a running main context for the asynchronous completions.
+ */
+
+/* How long a save waits for further saves to batch with before the
+ * state is written out. Long enough to span the gap between enroll
+ * stages, short enough to not be noticeable at the end of enrollment. */
+#define FP_PRINT_STORE_FLUSH_INTERVAL_MS 50
+
+struct _FpPrintStore
+{
+  GObject     parent_instance;
+
+  gchar      *path;
+
+  /* Descriptor string → GBytes with the serialized print. */
+  GHashTable *prints;
+
+  /* Save tasks waiting for the next flush to hit the disk. */
+  GPtrArray  *pending_tasks;
+  GSource    *flush_source;
+  gboolean    flush_running;
+  gboolean    dirty;
+};
+
+G_DEFINE_TYPE (FpPrintStore, fp_print_store, G_TYPE_OBJECT)
+
+static gchar *
+print_descriptor (const gchar *driver, const gchar *device_id, FpFinger finger)
+{
+  return g_strdup_printf ("%s/%s/%x", driver, device_id, finger);
+}
+
+static GVariant *
+fp_print_store_to_variant (FpPrintStore *self)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_hash_table_iter_init (&iter, self->prints);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      gconstpointer data;
+      gsize size;
+
+      data = g_bytes_get_data (value, &size);
+      g_variant_builder_add (&builder, "{sv}", (const gchar *) key,
+                             g_variant_new_fixed_array (G_VARIANT_TYPE ("y"),
+                                                        data, size, 1));
+    }
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/* Write @contents to @path through a temporary file with a single
+ * fdatasync() before the rename, so a crash leaves either the old or
+ * the new state, never a torn file. */
+static gboolean
+write_contents_synced (const gchar *path,
+                       GBytes      *contents,
+                       GError     **error)
+{
+  g_autofree gchar *tmp_path = g_strdup_printf ("%s.tmp", path);
+  const guint8 *data;
+  gsize size, written;
+  gint fd;
+
+  fd = g_open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Could not open %s for writing", tmp_path);
+      return FALSE;
+    }
+
+  data = g_bytes_get_data (contents, &size);
+  for (written = 0; written < size;)
+    {
+      gssize r = write (fd, data + written, size - written);
+
+      if (r < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                       "Could not write %s", tmp_path);
+          g_close (fd, NULL);
+          g_unlink (tmp_path);
+          return FALSE;
+        }
+      written += r;
+    }
+
+  if (fdatasync (fd) < 0)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Could not sync %s", tmp_path);
+      g_close (fd, NULL);
+      g_unlink (tmp_path);
+      return FALSE;
+    }
+
+  if (!g_close (fd, error))
+    {
+      g_unlink (tmp_path);
+      return FALSE;
+    }
+
+  if (g_rename (tmp_path, path) < 0)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Could not rename %s to %s", tmp_path, path);
+      g_unlink (tmp_path);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void fp_print_store_schedule_flush (FpPrintStore *self);
+
+typedef struct
+{
+  gchar     *path;
+  GBytes    *contents;
+  GPtrArray *batch;
+} FlushData;
+
+static void
+flush_data_free (FlushData *data)
+{
+  g_free (data->path);
+  g_bytes_unref (data->contents);
+  g_ptr_array_unref (data->batch);
+  g_free (data);
+}
+
+static void
+flush_thread_cb (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+  FlushData *data = task_data;
+  GError *error = NULL;
+
+  if (write_contents_synced (data->path, data->contents, &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+static void
+flush_done_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FpPrintStore *self = FP_PRINT_STORE (source_object);
+  FlushData *data = g_task_get_task_data (G_TASK (res));
+  g_autoptr(GError) error = NULL;
+  guint i;
+
+  g_task_propagate_boolean (G_TASK (res), &error);
+
+  for (i = 0; i < data->batch->len; i++)
+    {
+      GTask *save_task = g_ptr_array_index (data->batch, i);
+
+      if (error)
+        g_task_return_error (save_task, g_error_copy (error));
+      else
+        g_task_return_boolean (save_task, TRUE);
+    }
+
+  self->flush_running = FALSE;
+
+  /* Saves that arrived while the write was in flight batch into the
+   * next one. */
+  if (self->dirty)
+    fp_print_store_schedule_flush (self);
+}
+
+static void
+fp_print_store_start_flush (FpPrintStore *self)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GVariant) state = NULL;
+  FlushData *data;
+
+  state = fp_print_store_to_variant (self);
+
+  data = g_new0 (FlushData, 1);
+  data->path = g_strdup (self->path);
+  data->contents = g_bytes_new (g_variant_get_data (state),
+                                g_variant_get_size (state));
+  data->batch = g_steal_pointer (&self->pending_tasks);
+  self->pending_tasks = g_ptr_array_new_with_free_func (g_object_unref);
+
+  self->dirty = FALSE;
+  self->flush_running = TRUE;
+
+  task = g_task_new (self, NULL, flush_done_cb, NULL);
+  g_task_set_task_data (task, data, (GDestroyNotify) flush_data_free);
+  g_task_run_in_thread (task, flush_thread_cb);
+}
+
+static gboolean
+flush_timeout_cb (gpointer user_data)
+{
+  FpPrintStore *self = FP_PRINT_STORE (user_data);
+
+  self->flush_source = NULL;
+  fp_print_store_start_flush (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fp_print_store_schedule_flush (FpPrintStore *self)
+{
+  g_autoptr(GSource) source = NULL;
+
+  if (self->flush_source || self->flush_running)
+    return;
+
+  source = g_timeout_source_new (FP_PRINT_STORE_FLUSH_INTERVAL_MS);
+  g_source_set_callback (source, flush_timeout_cb, self, NULL);
+  g_source_attach (source, g_main_context_get_thread_default ());
+  self->flush_source = source;
+}
+
+static void
+fp_print_store_finalize (GObject *object)
+{
+  FpPrintStore *self = FP_PRINT_STORE (object);
+
+  /* Save tasks keep the store alive, so nothing can be pending here;
+   * only an unflushed delete can still be dirty. */
+  g_clear_pointer (&self->flush_source, g_source_destroy);
+  if (self->dirty)
+    {
+      g_autoptr(GError) error = NULL;
+
+      if (!fp_print_store_flush (self, &error))
+        g_warning ("Could not flush print store: %s", error->message);
+    }
+
+  g_clear_pointer (&self->pending_tasks, g_ptr_array_unref);
+  g_clear_pointer (&self->prints, g_hash_table_unref);
+  g_clear_pointer (&self->path, g_free);
+
+  G_OBJECT_CLASS (fp_print_store_parent_class)->finalize (object);
+}
+
+static void
+fp_print_store_class_init (FpPrintStoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fp_print_store_finalize;
+}
+
+static void
+fp_print_store_init (FpPrintStore *self)
+{
+  self->prints = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, (GDestroyNotify) g_bytes_unref);
+  self->pending_tasks = g_ptr_array_new_with_free_func (g_object_unref);
+}
+
+/**
+ * fp_print_store_new_for_file:
+ * @path: path of the storage file
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Open the print store at @path, loading any existing prints. A missing
+ * file is not an error; it simply means the store starts out empty and
+ * the file is created on the first flush.
+ *
+ * Returns: (transfer full): a new #FpPrintStore, or %NULL on error
+ */
+FpPrintStore *
+fp_print_store_new_for_file (const gchar *path, GError **error)
+{
+  g_autoptr(FpPrintStore) self = NULL;
+  g_autoptr(GVariant) dict = NULL;
+  g_autoptr(GError) load_error = NULL;
+  GVariantIter iter;
+  GVariant *value;
+  gchar *contents = NULL;
+  gchar *key;
+  gsize length;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  self = g_object_new (FP_TYPE_PRINT_STORE, NULL);
+  self->path = g_strdup (path);
+
+  if (!g_file_get_contents (path, &contents, &length, &load_error))
+    {
+      if (!g_error_matches (load_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        {
+          g_propagate_error (error, g_steal_pointer (&load_error));
+          return NULL;
+        }
+      return g_steal_pointer (&self);
+    }
+
+  dict = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
+                                                      contents, length, FALSE,
+                                                      g_free, contents));
+
+  g_variant_iter_init (&iter, dict);
+  while (g_variant_iter_loop (&iter, "{sv}", &key, &value))
+    {
+      gconstpointer data;
+      gsize size;
+
+      if (!g_variant_is_of_type (value, G_VARIANT_TYPE ("ay")))
+        continue;
+
+      data = g_variant_get_fixed_array (value, &size, 1);
+      g_hash_table_insert (self->prints, g_strdup (key),
+                           g_bytes_new (data, size));
+    }
+
+  return g_steal_pointer (&self);
+}
+
+/**
+ * fp_print_store_get_path:
+ * @store: a #FpPrintStore
+ *
+ * Returns: the path of the backing storage file
+ */
+const gchar *
+fp_print_store_get_path (FpPrintStore *store)
+{
+  g_return_val_if_fail (FP_IS_PRINT_STORE (store), NULL);
+
+  return store->path;
+}
+
+/**
+ * fp_print_store_save_print_async:
+ * @store: a #FpPrintStore
+ * @print: the #FpPrint to save
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call once the print is on disk
+ * @user_data: the data to pass to @callback
+ *
+ * Save @print, replacing any stored print for the same device and
+ * finger. The in-memory state is updated immediately — a load right
+ * after this call returns the new print — while the file write happens
+ * on a worker thread after a short coalescing window, so several saves
+ * in quick succession are batched into a single write and sync.
+ */
+void
+fp_print_store_save_print_async (FpPrintStore       *store,
+                                 FpPrint            *print,
+                                 GCancellable       *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer            user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autofree guchar *data = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize size;
+
+  g_return_if_fail (FP_IS_PRINT_STORE (store));
+  g_return_if_fail (FP_IS_PRINT (print));
+
+  task = g_task_new (store, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fp_print_store_save_print_async);
+
+  if (!fp_print_serialize (print, &data, &size, &error))
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  g_hash_table_insert (store->prints,
+                       print_descriptor (fp_print_get_driver (print),
+                                         fp_print_get_device_id (print),
+                                         fp_print_get_finger (print)),
+                       g_bytes_new_take (g_steal_pointer (&data), size));
+
+  store->dirty = TRUE;
+  g_ptr_array_add (store->pending_tasks, g_steal_pointer (&task));
+  fp_print_store_schedule_flush (store);
+}
+
+/**
+ * fp_print_store_save_print_finish:
+ * @store: a #FpPrintStore
+ * @result: a #GAsyncResult
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous print save. When this returns %TRUE, the print
+ * has been written out and synced to disk.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_print_store_save_print_finish (FpPrintStore *store,
+                                  GAsyncResult *result,
+                                  GError      **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, store), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * fp_print_store_load_print:
+ * @store: a #FpPrintStore
+ * @device: the #FpDevice the print belongs to
+ * @finger: the #FpFinger
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Load the stored print for @device and @finger. This only touches the
+ * in-memory state and never blocks on I/O. No stored print is reported
+ * as %G_IO_ERROR_NOT_FOUND.
+ *
+ * Returns: (transfer full): the stored #FpPrint, or %NULL
+ */
+FpPrint *
+fp_print_store_load_print (FpPrintStore *store,
+                           FpDevice     *device,
+                           FpFinger      finger,
+                           GError      **error)
+{
+  g_autofree gchar *descr = NULL;
+  gconstpointer data;
+  GBytes *stored;
+  gsize size;
+
+  g_return_val_if_fail (FP_IS_PRINT_STORE (store), NULL);
+  g_return_val_if_fail (FP_IS_DEVICE (device), NULL);
+
+  descr = print_descriptor (fp_device_get_driver (device),
+                            fp_device_get_device_id (device),
+                            finger);
+  stored = g_hash_table_lookup (store->prints, descr);
+  if (!stored)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "No stored print for %s", descr);
+      return NULL;
+    }
+
+  data = g_bytes_get_data (stored, &size);
+  return fp_print_deserialize (data, size, error);
+}
+
+/**
+ * fp_print_store_delete_print:
+ * @store: a #FpPrintStore
+ * @device: the #FpDevice the print belongs to
+ * @finger: the #FpFinger
+ *
+ * Delete the stored print for @device and @finger, if any. Like saves,
+ * the deletion is written back after the coalescing window; use
+ * fp_print_store_flush() to force it out immediately.
+ *
+ * Returns: %TRUE if a print was deleted
+ */
+gboolean
+fp_print_store_delete_print (FpPrintStore *store,
+                             FpDevice     *device,
+                             FpFinger      finger)
+{
+  g_autofree gchar *descr = NULL;
+
+  g_return_val_if_fail (FP_IS_PRINT_STORE (store), FALSE);
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  descr = print_descriptor (fp_device_get_driver (device),
+                            fp_device_get_device_id (device),
+                            finger);
+  if (!g_hash_table_remove (store->prints, descr))
+    return FALSE;
+
+  store->dirty = TRUE;
+  fp_print_store_schedule_flush (store);
+
+  return TRUE;
+}
+
+/**
+ * fp_print_store_flush:
+ * @store: a #FpPrintStore
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Write the current state out synchronously, completing any pending
+ * save tasks. Does nothing if there are no unwritten changes.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_print_store_flush (FpPrintStore *store, GError **error)
+{
+  g_autoptr(GVariant) state = NULL;
+  g_autoptr(GBytes) contents = NULL;
+  g_autoptr(GError) write_error = NULL;
+  guint i;
+
+  g_return_val_if_fail (FP_IS_PRINT_STORE (store), FALSE);
+
+  if (!store->dirty)
+    return TRUE;
+
+  g_clear_pointer (&store->flush_source, g_source_destroy);
+
+  state = fp_print_store_to_variant (store);
+  contents = g_bytes_new (g_variant_get_data (state),
+                          g_variant_get_size (state));
+  write_contents_synced (store->path, contents, &write_error);
+
+  for (i = 0; i < store->pending_tasks->len; i++)
+    {
+      GTask *save_task = g_ptr_array_index (store->pending_tasks, i);
+
+      if (write_error)
+        g_task_return_error (save_task, g_error_copy (write_error));
+      else
+        g_task_return_boolean (save_task, TRUE);
+    }
+  g_ptr_array_set_size (store->pending_tasks, 0);
+
+  if (write_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&write_error));
+      return FALSE;
+    }
+
+  store->dirty = FALSE;
+  return TRUE;
+}
@@ -0,0 +1,56 @@
+/*
+ * FPrint Print Store - Asynchronous print storage
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "fp-device.h"
+#include "fp-print.h"
+
+G_BEGIN_DECLS
+
+#define FP_TYPE_PRINT_STORE (fp_print_store_get_type ())
+G_DECLARE_FINAL_TYPE (FpPrintStore, fp_print_store, FP, PRINT_STORE, GObject)
+
+FpPrintStore *fp_print_store_new_for_file (const gchar *path,
+                                           GError     **error);
+
+const gchar *fp_print_store_get_path (FpPrintStore *store);
+
+void     fp_print_store_save_print_async (FpPrintStore       *store,
+                                          FpPrint            *print,
+                                          GCancellable       *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer            user_data);
+gboolean fp_print_store_save_print_finish (FpPrintStore *store,
+                                           GAsyncResult *result,
+                                           GError      **error);
+
+FpPrint *fp_print_store_load_print (FpPrintStore *store,
+                                    FpDevice     *device,
+                                    FpFinger      finger,
+                                    GError      **error);
+
+gboolean fp_print_store_delete_print (FpPrintStore *store,
+                                      FpDevice     *device,
+                                      FpFinger      finger);
+
+gboolean fp_print_store_flush (FpPrintStore *store,
+                               GError      **error);
+
+G_END_DECLS
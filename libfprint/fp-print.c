@@ -80,6 +80,12 @@ fp_print_finalize (GObject *object)
   g_clear_pointer (&self->enroll_date, g_date_free);
   g_clear_pointer (&self->data, g_variant_unref);
   g_clear_pointer (&self->prints, g_ptr_array_unref);
+  if (self->lazy_destroy)
+    self->lazy_destroy (self->lazy_data);
+  g_clear_pointer (&self->bz_edge_tables, g_ptr_array_unref);
+  g_clear_pointer (&self->bz_prefilters, g_ptr_array_unref);
+  g_clear_pointer (&self->bz_poses, g_ptr_array_unref);
+  g_clear_pointer (&self->bz_prefixes, g_ptr_array_unref);
 
   G_OBJECT_CLASS (fp_print_parent_class)->finalize (object);
 }
@@ -191,11 +197,23 @@ fp_print_set_property (GObject      *object,
     case PROP_FPI_DATA:
       g_clear_pointer (&self->data, g_variant_unref);
       self->data = g_value_dup_variant (value);
+      self->body_hash_valid = FALSE;
       break;
 
     case PROP_FPI_PRINTS:
       g_clear_pointer (&self->prints, g_ptr_array_unref);
+      g_clear_pointer (&self->bz_edge_tables, g_ptr_array_unref);
+      g_clear_pointer (&self->bz_prefilters, g_ptr_array_unref);
+      g_clear_pointer (&self->bz_poses, g_ptr_array_unref);
+      g_clear_pointer (&self->bz_prefixes, g_ptr_array_unref);
+      if (self->lazy_destroy)
+        self->lazy_destroy (self->lazy_data);
+      self->lazy_cb = NULL;
+      self->lazy_data = NULL;
+      self->lazy_destroy = NULL;
+      self->lazy_done = 0;
       self->prints = g_value_get_pointer (value);
+      self->body_hash_valid = FALSE;
       break;
 
     default:
@@ -578,6 +596,59 @@ fp_print_compatible (FpPrint *self, FpDevice *device)
   return TRUE;
 }
 
+/* 64 bit FNV-1a */
+static guint64
+fp_print_hash_bytes (guint64 hash, gconstpointer data, gsize len)
+{
+  const guint8 *bytes = data;
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    hash = (hash ^ bytes[i]) * G_GUINT64_CONSTANT (0x100000001b3);
+
+  return hash;
+}
+
+/* Digest of the print body (raw data or NBIS templates), cached for the
+ * lifetime of the data. Equal digests still require a full comparison,
+ * but differing digests prove the prints are not equal. */
+static guint64
+fp_print_body_hash (FpPrint *self)
+{
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  guint i;
+
+  if (self->body_hash_valid)
+    return self->body_hash;
+
+  if (self->type == FPI_PRINT_RAW)
+    {
+      if (self->data)
+        hash = fp_print_hash_bytes (hash,
+                                    g_variant_get_data (self->data),
+                                    g_variant_get_size (self->data));
+    }
+  else if (self->type == FPI_PRINT_NBIS)
+    {
+      fpi_print_ensure_views (self);
+
+      for (i = 0; i < self->prints->len; i++)
+        {
+          struct xyt_struct *xyt = g_ptr_array_index (self->prints, i);
+
+          hash = fp_print_hash_bytes (hash, &xyt->nrows, sizeof (xyt->nrows));
+          hash = fp_print_hash_bytes (hash, xyt->xcol, xyt->nrows * sizeof (xyt->xcol[0]));
+          hash = fp_print_hash_bytes (hash, xyt->ycol, xyt->nrows * sizeof (xyt->ycol[0]));
+          hash = fp_print_hash_bytes (hash, xyt->thetacol, xyt->nrows * sizeof (xyt->thetacol[0]));
+        }
+    }
+
+  self->body_hash = hash;
+  self->body_hash_valid = TRUE;
+
+  return hash;
+}
+
 /**
  * fp_print_equal:
  * @self: First #FpPrint
@@ -605,6 +676,11 @@ fp_print_equal (FpPrint *self, FpPrint *other)
   if (g_strcmp0 (self->device_id, other->device_id))
     return FALSE;
 
+  /* Cheap reject through the cached digests before comparing the data;
+   * galleries compare the same prints over and over. */
+  if (fp_print_body_hash (self) != fp_print_body_hash (other))
+    return FALSE;
+
   if (self->type == FPI_PRINT_RAW)
     {
       return g_variant_equal (self->data, other->data);
@@ -637,30 +713,13 @@ fp_print_equal (FpPrint *self, FpPrint *other)
 
 G_STATIC_ASSERT (sizeof (((struct xyt_struct *) NULL)->xcol[0]) == 4);
 
-/**
- * fp_print_serialize:
- * @print: A #FpPrint
- * @data: (array length=length) (transfer full) (out): Return location for data pointer
- * @length: (transfer full) (out): Length of @data
- * @error: Return location for error
- *
- * Serialize a print definition for permanent storage. Note that this is
- * lossy in the sense that e.g. the image data is discarded.
- *
- * Returns: (type void): %TRUE on success
- */
-gboolean
-fp_print_serialize (FpPrint *print,
-                    guchar **data,
-                    gsize   *length,
-                    GError **error)
+/* Build the FP3 record body for @print, in its serialized (little
+ * endian) byte order. */
+static GVariant *
+fp_print_to_variant (FpPrint *print)
 {
-  g_autoptr(GVariant) result = NULL;
   GVariantBuilder builder = G_VARIANT_BUILDER_INIT (FPI_PRINT_VARIANT_TYPE);
-  gsize len;
-
-  g_assert (data);
-  g_assert (length);
+  GVariant *result;
 
   g_variant_builder_add (&builder, "i", print->type);
   g_variant_builder_add (&builder, "s", print->driver);
@@ -686,6 +745,8 @@ fp_print_serialize (FpPrint *print,
       GVariantBuilder nested = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("(a(aiaiai))"));
       guint i;
 
+      fpi_print_ensure_views (print);
+
       g_variant_builder_open (&nested, G_VARIANT_TYPE ("a(aiaiai)"));
       for (i = 0; i < print->prints->len; i++)
         {
@@ -729,37 +790,158 @@ fp_print_serialize (FpPrint *print,
       result = tmp;
     }
 
+  return result;
+}
+
+/**
+ * fpi_print_serialize_to_writer:
+ * @print: A #FpPrint
+ * @writer: An initialized #FpiByteWriter to append the record to
+ *
+ * Serialize a print into @writer at its current position, in the same
+ * format fp_print_serialize() produces. This lets callers batch many
+ * prints into one growable buffer instead of paying one heap
+ * allocation per print.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fpi_print_serialize_to_writer (FpPrint       *print,
+                               FpiByteWriter *writer)
+{
+  g_autoptr(GVariant) result = NULL;
+  gsize len;
+  guint pos;
+
+  g_return_val_if_fail (FP_IS_PRINT (print), FALSE);
+  g_return_val_if_fail (writer != NULL, FALSE);
+
+  result = fp_print_to_variant (print);
   len = g_variant_get_size (result);
-  /* Add 3 bytes of header */
-  len += 3;
 
-  *data = g_malloc (len);
-  *length = len;
+  /* The record size is known now; grab the capacity in one go instead
+   * of growing through the put calls below. */
+  if (!fpi_byte_writer_reserve (writer, fpi_byte_writer_get_pos (writer) + 3 + len))
+    return FALSE;
+
+  if (!fpi_byte_writer_put_data (writer, (const guint8 *) "FP3", 3))
+    return FALSE;
 
-  (*data)[0] = (guchar) 'F';
-  (*data)[1] = (guchar) 'P';
-  (*data)[2] = (guchar) '3';
+  /* Reserve the record body, then serialize straight into the buffer. */
+  pos = fpi_byte_writer_get_pos (writer);
+  if (!fpi_byte_writer_fill (writer, 0, len))
+    return FALSE;
 
-  g_variant_get_data (result);
-  g_variant_store (result, (*data) + 3);
+  g_variant_store (result, (guint8 *) writer->parent.data + pos);
 
   return TRUE;
 }
 
 /**
- * fp_print_deserialize:
- * @data: (array length=length): The binary data
- * @length: Length of the data
+ * fp_print_serialize:
+ * @print: A #FpPrint
+ * @data: (array length=length) (transfer full) (out): Return location for data pointer
+ * @length: (transfer full) (out): Length of @data
  * @error: Return location for error
  *
- * Deserialize a print definition from permanent storage.
+ * Serialize a print definition for permanent storage. Note that this is
+ * lossy in the sense that e.g. the image data is discarded.
  *
- * Returns: (transfer full): A newly created #FpPrint on success
+ * Returns: (type void): %TRUE on success
  */
-FpPrint *
-fp_print_deserialize (const guchar *data,
-                      gsize         length,
-                      GError      **error)
+gboolean
+fp_print_serialize (FpPrint *print,
+                    guchar **data,
+                    gsize   *length,
+                    GError **error)
+{
+  FpiByteWriter writer;
+
+  g_assert (data);
+  g_assert (length);
+
+  fpi_byte_writer_init (&writer);
+
+  if (!fpi_print_serialize_to_writer (print, &writer))
+    {
+      fpi_byte_writer_reset (&writer);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                   "Could not grow serialization buffer");
+      return FALSE;
+    }
+
+  *length = fpi_byte_writer_get_pos (&writer);
+  *data = fpi_byte_writer_reset_and_get_data (&writer);
+
+  return TRUE;
+}
+
+/**
+ * fp_print_serialize_many:
+ * @prints: (element-type FpPrint): Array of prints to serialize
+ * @data: (array length=length) (transfer full) (out): Return location for data pointer
+ * @length: (transfer full) (out): Length of @data
+ * @error: Return location for error
+ *
+ * Serialize several prints into one shared buffer, e.g. for a bulk
+ * transfer of a whole gallery. Each print is stored as a 32 bit little
+ * endian record length followed by the record fp_print_serialize()
+ * would produce; fp_print_deserialize_many() unpacks the buffer again.
+ *
+ * Returns: (type void): %TRUE on success
+ */
+gboolean
+fp_print_serialize_many (GPtrArray *prints,
+                         guchar   **data,
+                         gsize     *length,
+                         GError   **error)
+{
+  FpiByteWriter writer;
+  guint i;
+
+  g_assert (prints);
+  g_assert (data);
+  g_assert (length);
+
+  fpi_byte_writer_init (&writer);
+
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+      guint len_pos, end_pos;
+      gboolean ok;
+
+      /* Length-prefix each record, filling in the length once the
+       * record has been written. */
+      len_pos = fpi_byte_writer_get_pos (&writer);
+      ok = fpi_byte_writer_put_uint32_le (&writer, 0);
+      ok = ok && fpi_print_serialize_to_writer (print, &writer);
+
+      end_pos = fpi_byte_writer_get_pos (&writer);
+      ok = ok && fpi_byte_writer_set_pos (&writer, len_pos);
+      ok = ok && fpi_byte_writer_put_uint32_le (&writer, end_pos - len_pos - 4);
+      ok = ok && fpi_byte_writer_set_pos (&writer, end_pos);
+
+      if (!ok)
+        {
+          fpi_byte_writer_reset (&writer);
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                       "Could not grow serialization buffer");
+          return FALSE;
+        }
+    }
+
+  *length = fpi_byte_writer_get_pos (&writer);
+  *data = fpi_byte_writer_reset_and_get_data (&writer);
+
+  return TRUE;
+}
+
+static FpPrint *
+fp_print_deserialize_internal (const guchar *data,
+                               gsize         length,
+                               gboolean      trusted,
+                               GError      **error)
 {
   g_autoptr(FpPrint) result = NULL;
   g_autoptr(GVariant) raw_value = NULL;
@@ -790,18 +972,32 @@ fp_print_deserialize (const guchar *data,
 
   /* To support GLIB < 2.60 we need to make sure that the memory is aligned correctly.
    * We also need to copy the backing store for the raw data that we may keep for
-   * longer. */
-  aligned_data = g_malloc (length - 3);
-  memcpy (aligned_data, data + 3, length - 3);
-  raw_value = g_variant_new_from_data (FPI_PRINT_VARIANT_TYPE,
-                                       aligned_data, length - 3,
-                                       FALSE, g_free, aligned_data);
+   * longer. A trusted record is fully copied out below, so it only
+   * needs the copy when the caller's pointer is misaligned. */
+  if (trusted && ((guintptr) (data + 3)) % 8 == 0)
+    {
+      raw_value = g_variant_new_from_data (FPI_PRINT_VARIANT_TYPE,
+                                           data + 3, length - 3,
+                                           TRUE, NULL, NULL);
+    }
+  else
+    {
+      aligned_data = g_malloc (length - 3);
+      memcpy (aligned_data, data + 3, length - 3);
+      raw_value = g_variant_new_from_data (FPI_PRINT_VARIANT_TYPE,
+                                           aligned_data, length - 3,
+                                           trusted, g_free, aligned_data);
+    }
 
   if (!raw_value)
     goto invalid_format;
 
   if (G_BYTE_ORDER == G_BIG_ENDIAN)
     value = g_variant_byteswap (raw_value);
+  else if (trusted)
+    /* The store already guarantees integrity; serialized form equals
+     * normal form on little endian, so skip the validating pass. */
+    value = g_variant_ref (raw_value);
   else
     value = g_variant_get_normal_form (raw_value);
 
@@ -904,3 +1100,725 @@ invalid_format:
                "Data could not be parsed");
   return NULL;
 }
+
+/**
+ * fp_print_deserialize:
+ * @data: (array length=length): The binary data
+ * @length: Length of the data
+ * @error: Return location for error
+ *
+ * Deserialize a print definition from permanent storage.
+ *
+ * Returns: (transfer full): A newly created #FpPrint on success
+ */
+FpPrint *
+fp_print_deserialize (const guchar *data,
+                      gsize         length,
+                      GError      **error)
+{
+  return fp_print_deserialize_internal (data, length, FALSE, error);
+}
+
+/**
+ * fp_print_deserialize_trusted:
+ * @data: (array length=length): The binary data
+ * @length: Length of the data
+ * @error: Return location for error
+ *
+ * Like fp_print_deserialize(), but treats @data as coming from a
+ * trusted, integrity-checked store: the record is handed to GVariant
+ * in trusted mode and the validating normalization pass over the
+ * minutiae arrays is skipped (byteswapping on big endian hosts still
+ * happens). Only use this for records the caller itself serialized and
+ * protects, never for data received from another party.
+ *
+ * Returns: (transfer full): A newly created #FpPrint on success
+ */
+FpPrint *
+fp_print_deserialize_trusted (const guchar *data,
+                              gsize         length,
+                              GError      **error)
+{
+  return fp_print_deserialize_internal (data, length, TRUE, error);
+}
+
+/**
+ * fp_print_deserialize_header:
+ * @data: (array length=length): The binary data
+ * @length: Length of the data
+ * @error: Return location for error
+ *
+ * Deserialize only the metadata prefix of a stored print: driver,
+ * device id, finger, username, description and enrollment date. The
+ * template payload is never parsed or copied, so enumerating a large
+ * print store for listing or filtering stays cheap no matter how many
+ * minutiae the templates carry.
+ *
+ * The returned print carries no template data and can therefore not be
+ * used for matching; use fp_print_deserialize() on the same record once
+ * the full print is actually needed.
+ *
+ * Returns: (transfer full): A newly created #FpPrint on success
+ */
+FpPrint *
+fp_print_deserialize_header (const guchar *data,
+                             gsize         length,
+                             GError      **error)
+{
+  g_autoptr(FpPrint) result = NULL;
+  g_autoptr(GVariant) value = NULL;
+  g_autoptr(GDate) date = NULL;
+  guint8 finger_int8;
+  FpFinger finger;
+  g_autofree gchar *username = NULL;
+  g_autofree gchar *description = NULL;
+  gint julian_date;
+  FpiPrintType type;
+  const gchar *driver;
+  const gchar *device_id;
+  gboolean device_stored;
+
+  g_assert (data);
+  g_assert (length > 3);
+
+  if (memcmp (data, "FP3", 3) != 0)
+    goto invalid_format;
+
+  /* Unlike fp_print_deserialize() this neither copies the record nor
+   * brings it into normal form: the variant stays lazy and untrusted
+   * child accesses below yield safe defaults for malformed data, while
+   * the payload child is skipped entirely and its bytes never touched.
+   * The record only has to stay alive for the duration of this call,
+   * as every extracted field is copied out. */
+  if (((guintptr) (data + 3)) % 8 == 0)
+    {
+      value = g_variant_new_from_data (FPI_PRINT_VARIANT_TYPE,
+                                       data + 3, length - 3,
+                                       FALSE, NULL, NULL);
+    }
+  else
+    {
+      guchar *aligned_data = g_malloc (length - 3);
+
+      memcpy (aligned_data, data + 3, length - 3);
+      value = g_variant_new_from_data (FPI_PRINT_VARIANT_TYPE,
+                                       aligned_data, length - 3,
+                                       FALSE, g_free, aligned_data);
+    }
+
+  if (!value)
+    goto invalid_format;
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN)
+    {
+      /* Byteswapping traverses the whole record; correct but without
+       * the lazy-parse benefit. */
+      g_autoptr(GVariant) swapped = g_variant_byteswap (value);
+
+      g_variant_unref (value);
+      value = g_steal_pointer (&swapped);
+    }
+
+  g_variant_get (value,
+                 "(i&s&sbymsmsi@a{sv}v)",
+                 &type,
+                 &driver,
+                 &device_id,
+                 &device_stored,
+                 &finger_int8,
+                 &username,
+                 &description,
+                 &julian_date,
+                 NULL,
+                 NULL);
+
+  finger = finger_int8;
+
+  if (type != FPI_PRINT_NBIS && type != FPI_PRINT_RAW)
+    {
+      g_warning ("Invalid print type: 0x%X", type);
+      goto invalid_format;
+    }
+
+  result = g_object_new (FP_TYPE_PRINT,
+                         "fpi-type", type,
+                         "driver", driver,
+                         "device-id", device_id,
+                         "device-stored", device_stored,
+                         NULL);
+  g_object_ref_sink (result);
+
+  date = g_date_new_julian (julian_date);
+  g_object_set (result,
+                "finger", finger,
+                "username", username,
+                "description", description,
+                "enroll_date", date,
+                NULL);
+
+  return g_steal_pointer (&result);
+
+invalid_format:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Data could not be parsed");
+  return NULL;
+}
+
+typedef struct
+{
+  gsize   offset;
+  guint32 length;
+} DeserializeRecord;
+
+typedef struct
+{
+  gint               ref_count;
+
+  const guchar      *data;
+  GArray            *records; /* of DeserializeRecord, read-only for workers */
+  FpPrint          **results; /* one slot per record, filled by index */
+  GError            *first_error;
+
+  gint               next;    /* Next record index to claim (atomic) */
+  gint               failed;  /* Any worker hit an error (atomic) */
+
+  GMutex             lock;
+  GCond              cond;
+  guint              pending; /* Workers that have not finished yet */
+} DeserializeJob;
+
+static DeserializeJob *
+deserialize_job_ref (DeserializeJob *job)
+{
+  g_atomic_int_inc (&job->ref_count);
+  return job;
+}
+
+static void
+deserialize_job_unref (DeserializeJob *job)
+{
+  if (!g_atomic_int_dec_and_test (&job->ref_count))
+    return;
+
+  g_array_unref (job->records);
+  g_clear_error (&job->first_error);
+  g_mutex_clear (&job->lock);
+  g_cond_clear (&job->cond);
+  g_free (job);
+}
+
+static void
+deserialize_worker (gpointer data, gpointer user_data)
+{
+  DeserializeJob *job = data;
+  gint i;
+
+  while (!g_atomic_int_get (&job->failed) &&
+         (i = g_atomic_int_add (&job->next, 1)) < (gint) job->records->len)
+    {
+      DeserializeRecord *record = &g_array_index (job->records,
+                                                  DeserializeRecord, i);
+      GError *local_error = NULL;
+      FpPrint *print;
+
+      print = fp_print_deserialize (job->data + record->offset,
+                                    record->length, &local_error);
+      if (print)
+        {
+          job->results[i] = print;
+          continue;
+        }
+
+      /* The first error wins; the flag makes the other workers stop
+       * claiming records. */
+      g_atomic_int_set (&job->failed, TRUE);
+      g_mutex_lock (&job->lock);
+      if (!job->first_error)
+        job->first_error = g_steal_pointer (&local_error);
+      g_mutex_unlock (&job->lock);
+      g_clear_error (&local_error);
+    }
+
+  g_mutex_lock (&job->lock);
+  job->pending--;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+
+  deserialize_job_unref (job);
+}
+
+/**
+ * fp_print_deserialize_many:
+ * @data: (array length=length): The binary data
+ * @length: Length of the data
+ * @error: Return location for error
+ *
+ * Deserialize a buffer of prints created by fp_print_serialize_many().
+ * The record framing is walked up front and the records then fan out
+ * across a worker pool, since deserializing one print is independent of
+ * every other; the returned array preserves the stored order. Small
+ * buffers are deserialized serially to avoid the pool overhead.
+ *
+ * Returns: (transfer container) (element-type FpPrint): The contained prints
+ */
+GPtrArray *
+fp_print_deserialize_many (const guchar *data,
+                           gsize         length,
+                           GError      **error)
+{
+  static GThreadPool *pool = NULL;
+  g_autoptr(GPtrArray) prints = NULL;
+  g_autoptr(GArray) records = NULL;
+  g_autofree FpPrint **results = NULL;
+  DeserializeJob *job;
+  gboolean failed;
+  guint n_workers;
+  gsize pos = 0;
+  guint i;
+
+  g_assert (data || length == 0);
+
+  /* Walk the record framing first; this touches only the length
+   * prefixes. */
+  records = g_array_new (FALSE, FALSE, sizeof (DeserializeRecord));
+
+  while (pos < length)
+    {
+      DeserializeRecord record;
+      guint32 record_len;
+
+      if (length - pos < 4)
+        goto invalid_format;
+
+      memcpy (&record_len, data + pos, 4);
+      record_len = GUINT32_FROM_LE (record_len);
+      pos += 4;
+
+      if (record_len <= 3 || record_len > length - pos)
+        goto invalid_format;
+
+      record.offset = pos;
+      record.length = record_len;
+      g_array_append_val (records, record);
+      pos += record_len;
+    }
+
+  prints = g_ptr_array_new_with_free_func (g_object_unref);
+
+  n_workers = MIN (records->len, g_get_num_processors ());
+
+  if (n_workers <= 1 || records->len < 16)
+    {
+      for (i = 0; i < records->len; i++)
+        {
+          DeserializeRecord *record = &g_array_index (records,
+                                                      DeserializeRecord, i);
+          FpPrint *print;
+
+          print = fp_print_deserialize (data + record->offset,
+                                        record->length, error);
+          if (!print)
+            return NULL;
+
+          g_ptr_array_add (prints, print);
+        }
+
+      return g_steal_pointer (&prints);
+    }
+
+  if (g_once_init_enter (&pool))
+    g_once_init_leave (&pool,
+                       g_thread_pool_new (deserialize_worker, NULL,
+                                          g_get_num_processors (),
+                                          FALSE, NULL));
+
+  results = g_new0 (FpPrint *, records->len);
+
+  job = g_new0 (DeserializeJob, 1);
+  job->ref_count = 1;
+  job->data = data;
+  job->records = g_array_ref (records);
+  job->results = results;
+  job->next = 0;
+  job->pending = n_workers;
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->cond);
+
+  for (i = 0; i < n_workers; i++)
+    g_thread_pool_push (pool, deserialize_job_ref (job), NULL);
+
+  /* Wait for every worker; @data and @results only stay valid for the
+   * duration of this call, so there is no early return on failure. */
+  g_mutex_lock (&job->lock);
+  while (job->pending > 0)
+    g_cond_wait (&job->cond, &job->lock);
+  g_mutex_unlock (&job->lock);
+
+  failed = g_atomic_int_get (&job->failed);
+  if (failed)
+    g_propagate_error (error, g_steal_pointer (&job->first_error));
+  deserialize_job_unref (job);
+
+  for (i = 0; i < records->len; i++)
+    {
+      if (failed)
+        g_clear_object (&results[i]);
+      else
+        g_ptr_array_add (prints, g_steal_pointer (&results[i]));
+    }
+
+  if (failed)
+    return NULL;
+
+  return g_steal_pointer (&prints);
+
+invalid_format:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Data could not be parsed");
+  return NULL;
+}
+
+/* Varint helpers for the compact interchange encoding: little endian
+ * base-128 with the high bit as continuation, signed values in zigzag
+ * representation. */
+static gboolean
+compact_put_varint (FpiByteWriter *writer, guint32 value)
+{
+  gboolean ret = TRUE;
+
+  while (value >= 0x80)
+    {
+      ret = ret && fpi_byte_writer_put_uint8 (writer, (value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+
+  return ret && fpi_byte_writer_put_uint8 (writer, value);
+}
+
+static gboolean
+compact_get_varint (FpiByteReader *reader, guint32 *value)
+{
+  guint shift = 0;
+  guint8 byte;
+
+  *value = 0;
+  do
+    {
+      if (shift > 28 || !fpi_byte_reader_get_uint8 (reader, &byte))
+        return FALSE;
+      *value |= (guint32) (byte & 0x7f) << shift;
+      shift += 7;
+    }
+  while (byte & 0x80);
+
+  return TRUE;
+}
+
+static gboolean
+compact_put_svarint (FpiByteWriter *writer, gint32 value)
+{
+  return compact_put_varint (writer,
+                             ((guint32) value << 1) ^ (guint32) (value >> 31));
+}
+
+static gboolean
+compact_get_svarint (FpiByteReader *reader, gint32 *value)
+{
+  guint32 raw;
+
+  if (!compact_get_varint (reader, &raw))
+    return FALSE;
+
+  *value = (gint32) (raw >> 1) ^ -((gint32) (raw & 1));
+  return TRUE;
+}
+
+static gboolean
+compact_put_optional_string (FpiByteWriter *writer, const gchar *str)
+{
+  gboolean ret;
+
+  ret = fpi_byte_writer_put_uint8 (writer, str != NULL);
+  if (str)
+    ret = ret && fpi_byte_writer_put_string (writer, str);
+
+  return ret;
+}
+
+static gboolean
+compact_get_optional_string (FpiByteReader *reader, const gchar **str)
+{
+  guint8 present;
+
+  *str = NULL;
+  if (!fpi_byte_reader_get_uint8 (reader, &present))
+    return FALSE;
+  if (present && !fpi_byte_reader_get_string (reader, str))
+    return FALSE;
+
+  return TRUE;
+}
+
+/**
+ * fp_print_serialize_compact:
+ * @print: A #FpPrint
+ * @data: (out) (array length=length) (transfer full): Return location for data pointer
+ * @length: (out): Length of @data
+ * @error: Return location for error
+ *
+ * Serialize a print into the compact interchange encoding. NBIS
+ * templates store each minutia as varint deltas from the previous
+ * minutia instead of three 32 bit integers, which makes records
+ * roughly a quarter of the size fp_print_serialize() produces. The
+ * encoding is lossless: fp_print_deserialize_compact() restores a
+ * print that compares equal to the original.
+ *
+ * Use fp_print_serialize() for local storage; this format is meant for
+ * replicating enrolled prints over constrained links.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fp_print_serialize_compact (FpPrint *print,
+                            guchar **data,
+                            gsize   *length,
+                            GError **error)
+{
+  FpiByteWriter writer;
+  gboolean ret = TRUE;
+  guint i;
+
+  g_return_val_if_fail (FP_IS_PRINT (print), FALSE);
+  g_assert (data);
+  g_assert (length);
+
+  fpi_byte_writer_init (&writer);
+
+  ret = fpi_byte_writer_put_data (&writer, (const guint8 *) "FPC1", 4);
+  ret = ret && fpi_byte_writer_put_uint8 (&writer, print->type);
+  ret = ret && fpi_byte_writer_put_string (&writer,
+                                           print->driver ? print->driver : "");
+  ret = ret && fpi_byte_writer_put_string (&writer,
+                                           print->device_id ? print->device_id : "");
+  ret = ret && fpi_byte_writer_put_uint8 (&writer, !!print->device_stored);
+  ret = ret && fpi_byte_writer_put_uint8 (&writer, print->finger);
+  ret = ret && compact_put_optional_string (&writer, print->username);
+  ret = ret && compact_put_optional_string (&writer, print->description);
+  if (print->enroll_date && g_date_valid (print->enroll_date))
+    ret = ret && compact_put_varint (&writer, g_date_get_julian (print->enroll_date));
+  else
+    ret = ret && compact_put_varint (&writer, 0);
+
+  if (print->type == FPI_PRINT_NBIS)
+    {
+      fpi_print_ensure_views (print);
+
+      ret = ret && compact_put_varint (&writer, print->prints->len);
+
+      for (i = 0; ret && i < print->prints->len; i++)
+        {
+          struct xyt_struct *xyt = g_ptr_array_index (print->prints, i);
+          gint32 px = 0, py = 0, pt = 0;
+          gint j;
+
+          ret = ret && compact_put_varint (&writer, xyt->nrows);
+          for (j = 0; ret && j < xyt->nrows; j++)
+            {
+              ret = ret && compact_put_svarint (&writer, xyt->xcol[j] - px);
+              ret = ret && compact_put_svarint (&writer, xyt->ycol[j] - py);
+              ret = ret && compact_put_svarint (&writer, xyt->thetacol[j] - pt);
+              px = xyt->xcol[j];
+              py = xyt->ycol[j];
+              pt = xyt->thetacol[j];
+            }
+        }
+    }
+  else if (print->type == FPI_PRINT_RAW)
+    {
+      g_autoptr(GVariant) wire = NULL;
+      gsize size;
+
+      /* The raw bytes are stored in little endian, like the FP3
+       * format. */
+      if (G_BYTE_ORDER == G_BIG_ENDIAN)
+        wire = g_variant_byteswap (print->data);
+      else
+        wire = g_variant_get_normal_form (print->data);
+      size = g_variant_get_size (wire);
+
+      ret = ret && fpi_byte_writer_put_string (&writer,
+                                               g_variant_get_type_string (wire));
+      ret = ret && compact_put_varint (&writer, size);
+      ret = ret && fpi_byte_writer_put_data (&writer,
+                                             g_variant_get_data (wire), size);
+    }
+  else
+    {
+      fpi_byte_writer_reset (&writer);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Unsupported print type 0x%X", print->type);
+      return FALSE;
+    }
+
+  if (!ret)
+    {
+      fpi_byte_writer_reset (&writer);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                   "Could not grow serialization buffer");
+      return FALSE;
+    }
+
+  *length = fpi_byte_writer_get_pos (&writer);
+  *data = fpi_byte_writer_reset_and_get_data (&writer);
+
+  return TRUE;
+}
+
+/**
+ * fp_print_deserialize_compact:
+ * @data: (array length=length): The binary data
+ * @length: Length of the data
+ * @error: Return location for error
+ *
+ * Deserialize a print in the compact interchange encoding created by
+ * fp_print_serialize_compact().
+ *
+ * Returns: (transfer full): A newly created #FpPrint on success
+ */
+FpPrint *
+fp_print_deserialize_compact (const guchar *data,
+                              gsize         length,
+                              GError      **error)
+{
+  g_autoptr(FpPrint) result = NULL;
+  g_autoptr(GDate) date = NULL;
+  FpiByteReader reader;
+  const guint8 *magic;
+  const gchar *driver, *device_id, *username, *description;
+  guint32 julian_date, nprints;
+  guint8 type, device_stored, finger;
+  guint i;
+
+  g_assert (data);
+
+  fpi_byte_reader_init (&reader, data, length);
+
+  if (!fpi_byte_reader_get_data (&reader, 4, &magic) ||
+      memcmp (magic, "FPC1", 4) != 0)
+    goto invalid_format;
+
+  if (!fpi_byte_reader_get_uint8 (&reader, &type) ||
+      !fpi_byte_reader_get_string (&reader, &driver) ||
+      !fpi_byte_reader_get_string (&reader, &device_id) ||
+      !fpi_byte_reader_get_uint8 (&reader, &device_stored) ||
+      !fpi_byte_reader_get_uint8 (&reader, &finger) ||
+      !compact_get_optional_string (&reader, &username) ||
+      !compact_get_optional_string (&reader, &description) ||
+      !compact_get_varint (&reader, &julian_date))
+    goto invalid_format;
+
+  if (type == FPI_PRINT_NBIS)
+    {
+      result = g_object_new (FP_TYPE_PRINT,
+                             "driver", driver,
+                             "device-id", device_id,
+                             "device-stored", (gboolean) device_stored,
+                             NULL);
+      g_object_ref_sink (result);
+      fpi_print_set_type (result, FPI_PRINT_NBIS);
+
+      if (!compact_get_varint (&reader, &nprints))
+        goto invalid_format;
+
+      for (i = 0; i < nprints; i++)
+        {
+          g_autofree struct xyt_struct *xyt = NULL;
+          gint32 px = 0, py = 0, pt = 0;
+          gint32 dx, dy, dt;
+          guint32 nrows;
+          guint j;
+
+          if (!compact_get_varint (&reader, &nrows) ||
+              nrows > G_N_ELEMENTS (xyt->xcol))
+            goto invalid_format;
+
+          xyt = g_new0 (struct xyt_struct, 1);
+          xyt->nrows = nrows;
+          for (j = 0; j < nrows; j++)
+            {
+              if (!compact_get_svarint (&reader, &dx) ||
+                  !compact_get_svarint (&reader, &dy) ||
+                  !compact_get_svarint (&reader, &dt))
+                goto invalid_format;
+
+              px += dx;
+              py += dy;
+              pt += dt;
+              xyt->xcol[j] = px;
+              xyt->ycol[j] = py;
+              xyt->thetacol[j] = pt;
+            }
+
+          g_ptr_array_add (result->prints, g_steal_pointer (&xyt));
+        }
+    }
+  else if (type == FPI_PRINT_RAW)
+    {
+      g_autoptr(GVariant) raw_value = NULL;
+      g_autoptr(GVariant) fp_data = NULL;
+      const gchar *type_string;
+      const guint8 *bytes;
+      guchar *aligned_data;
+      guint32 size;
+
+      if (!fpi_byte_reader_get_string (&reader, &type_string) ||
+          !g_variant_type_string_is_valid (type_string) ||
+          !compact_get_varint (&reader, &size) ||
+          !fpi_byte_reader_get_data (&reader, size, &bytes))
+        goto invalid_format;
+
+      /* Align and copy the backing store, as we may keep it around. */
+      aligned_data = g_malloc (size);
+      memcpy (aligned_data, bytes, size);
+      raw_value = g_variant_new_from_data (G_VARIANT_TYPE (type_string),
+                                           aligned_data, size,
+                                           FALSE, g_free, aligned_data);
+      if (!raw_value)
+        goto invalid_format;
+
+      if (G_BYTE_ORDER == G_BIG_ENDIAN)
+        fp_data = g_variant_byteswap (raw_value);
+      else
+        fp_data = g_variant_get_normal_form (raw_value);
+
+      result = g_object_new (FP_TYPE_PRINT,
+                             "fpi-type", (FpiPrintType) type,
+                             "driver", driver,
+                             "device-id", device_id,
+                             "device-stored", (gboolean) device_stored,
+                             "fpi-data", fp_data,
+                             NULL);
+      g_object_ref_sink (result);
+    }
+  else
+    {
+      g_warning ("Invalid print type: 0x%X", type);
+      goto invalid_format;
+    }
+
+  if (julian_date != 0)
+    date = g_date_new_julian (julian_date);
+  g_object_set (result,
+                "finger", (FpFinger) finger,
+                "username", username,
+                "description", description,
+                "enroll_date", date,
+                NULL);
+
+  return g_steal_pointer (&result);
+
+invalid_format:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Data could not be parsed");
+  return NULL;
+}
@@ -104,6 +104,12 @@ gboolean fp_print_compatible (FpPrint  *self,
 gboolean fp_print_equal (FpPrint *self,
                          FpPrint *other);
 
+gboolean fp_print_match (FpPrint *probe,
+                         FpPrint *candidate,
+                         gint     threshold,
+                         gint    *score,
+                         GError **error);
+
 gboolean fp_print_serialize (FpPrint *print,
                              guchar **data,
                              gsize   *length,
@@ -113,4 +119,30 @@ FpPrint *fp_print_deserialize (const guchar *data,
                                gsize         length,
                                GError      **error);
 
+FpPrint *fp_print_deserialize_header (const guchar *data,
+                                      gsize         length,
+                                      GError      **error);
+
+FpPrint *fp_print_deserialize_trusted (const guchar *data,
+                                       gsize         length,
+                                       GError      **error);
+
+gboolean fp_print_serialize_many (GPtrArray *prints,
+                                  guchar   **data,
+                                  gsize     *length,
+                                  GError   **error);
+
+GPtrArray *fp_print_deserialize_many (const guchar *data,
+                                      gsize         length,
+                                      GError      **error);
+
+gboolean fp_print_serialize_compact (FpPrint *print,
+                                     guchar **data,
+                                     gsize   *length,
+                                     GError **error);
+
+FpPrint *fp_print_deserialize_compact (const guchar *data,
+                                       gsize         length,
+                                       GError      **error);
+
 G_END_DECLS
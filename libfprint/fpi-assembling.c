@@ -27,6 +27,8 @@
 #include <string.h>
 
 #include "fpi-assembling.h"
+#include "fpi-simd.h"
+#include "drivers/aeslib.h"
 
 /**
  * SECTION:fpi-assembling
@@ -39,6 +41,96 @@
  * data in small stripes.
  */
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* First pixel of @frame, honouring frames that reference pixels stored
+ * outside the fpi_frame itself (see get_frame_data in the context). */
+static const unsigned char *
+frame_data (struct fpi_frame_asmbl_ctx *ctx,
+            struct fpi_frame           *frame)
+{
+  if (ctx->get_frame_data)
+    return ctx->get_frame_data (ctx, frame);
+  return frame->data;
+}
+
+/* Sum of absolute differences over one row of packed 8bpp pixels. */
+FPI_SIMD_CLONES static unsigned int
+row_abs_diff_packed (const unsigned char *p1,
+                     const unsigned char *p2,
+                     unsigned int         width)
+{
+  unsigned int err = 0;
+  unsigned int j = 0;
+
+#if defined(__SSE2__)
+  __m128i acc = _mm_setzero_si128 ();
+
+  for (; j + 16 <= width; j += 16)
+    {
+      __m128i v1 = _mm_loadu_si128 ((const __m128i *) (p1 + j));
+      __m128i v2 = _mm_loadu_si128 ((const __m128i *) (p2 + j));
+
+      acc = _mm_add_epi64 (acc, _mm_sad_epu8 (v1, v2));
+    }
+
+  err = _mm_cvtsi128_si32 (acc) +
+        _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (acc, acc));
+#elif defined(__ARM_NEON)
+  uint16x8_t acc = vdupq_n_u16 (0);
+  uint32x4_t sum;
+
+  /* A u16 lane can take (width / 16) * 510 before overflowing, which is
+   * fine for the narrow frames of the swipe sensors using this path. */
+  for (; j + 16 <= width; j += 16)
+    acc = vpadalq_u8 (acc, vabdq_u8 (vld1q_u8 (p1 + j), vld1q_u8 (p2 + j)));
+
+  sum = vpaddlq_u16 (acc);
+  err = vgetq_lane_u32 (sum, 0) + vgetq_lane_u32 (sum, 1) +
+        vgetq_lane_u32 (sum, 2) + vgetq_lane_u32 (sum, 3);
+#endif
+
+  for (; j < width; j++)
+    {
+      unsigned char v1 = p1[j], v2 = p2[j];
+
+      err += v1 > v2 ? v1 - v2 : v2 - v1;
+    }
+
+  return err;
+}
+
+/* Sum of absolute differences between two columns of vertically packed
+ * 4bpp pixels in the AES layout (see aes_get_pixel()): two pixels per
+ * byte in column-major order, low nibble first. The columns may start
+ * at different vertical offsets. */
+FPI_SIMD_CLONES static unsigned int
+col_abs_diff_nibbles (const unsigned char *col1,
+                      unsigned int         y1,
+                      const unsigned char *col2,
+                      unsigned int         y2,
+                      unsigned int         height)
+{
+  unsigned int err = 0, i;
+
+  for (i = 0; i < height; i++)
+    {
+      unsigned int ya = y1 + i, yb = y2 + i;
+      unsigned char v1 = (col1[ya >> 1] >> ((ya & 1) * 4)) & 0xf;
+      unsigned char v2 = (col2[yb >> 1] >> ((yb & 1) * 4)) & 0xf;
+
+      err += v1 > v2 ? v1 - v2 : v2 - v1;
+    }
+
+  /* aes_get_pixel() scales nibbles by 17 into 8bpp range; the scale
+   * factors straight out of the absolute difference. */
+  return err * 17;
+}
+
 static unsigned int
 calc_error (struct fpi_frame_asmbl_ctx *ctx,
             struct fpi_frame           *first_frame,
@@ -59,31 +151,69 @@ calc_error (struct fpi_frame_asmbl_ctx *ctx,
   y2 = dy;
   i = 0;
   err = 0;
-  do
+
+  if (ctx->packed_8bpp)
     {
-      x1 = dx < 0 ? 0 : dx;
-      x2 = dx < 0 ? -dx : 0;
-      j = 0;
+      /* One byte per pixel in row-major order, no accessor indirection. */
+      unsigned int x1_start = dx < 0 ? 0 : dx;
+      unsigned int x2_start = dx < 0 ? -dx : 0;
 
       do
         {
-          unsigned char v1, v2;
+          err += row_abs_diff_packed (frame_data (ctx, first_frame) +
+                                      (y1 * ctx->frame_width) + x1_start,
+                                      frame_data (ctx, second_frame) +
+                                      (y2 * ctx->frame_width) + x2_start,
+                                      width);
+          i++;
+          y1++;
+          y2++;
+        }
+      while (i < height);
+    }
+  else if (ctx->packed_4bpp)
+    {
+      /* Column-major nibble pairs: each frame column is a contiguous
+       * run of frame_height / 2 bytes, so walk column pairs directly. */
+      unsigned int x1_start = dx < 0 ? 0 : dx;
+      unsigned int x2_start = dx < 0 ? -dx : 0;
+      unsigned int stride = ctx->frame_height >> 1;
+
+      for (j = 0; j < width; j++)
+        err += col_abs_diff_nibbles (frame_data (ctx, first_frame) +
+                                     (x1_start + j) * stride, y1,
+                                     frame_data (ctx, second_frame) +
+                                     (x2_start + j) * stride, y2,
+                                     height);
+    }
+  else
+    {
+      do
+        {
+          x1 = dx < 0 ? 0 : dx;
+          x2 = dx < 0 ? -dx : 0;
+          j = 0;
+
+          do
+            {
+              unsigned char v1, v2;
 
 
-          v1 = ctx->get_pixel (ctx, first_frame, x1, y1);
-          v2 = ctx->get_pixel (ctx, second_frame, x2, y2);
-          err += v1 > v2 ? v1 - v2 : v2 - v1;
-          j++;
-          x1++;
-          x2++;
+              v1 = ctx->get_pixel (ctx, first_frame, x1, y1);
+              v2 = ctx->get_pixel (ctx, second_frame, x2, y2);
+              err += v1 > v2 ? v1 - v2 : v2 - v1;
+              j++;
+              x1++;
+              x2++;
 
+            }
+          while (j < width);
+          i++;
+          y1++;
+          y2++;
         }
-      while (j < width);
-      i++;
-      y1++;
-      y2++;
+      while (i < height);
     }
-  while (i < height);
 
   /* Normalize error */
   err *= (ctx->frame_height * ctx->frame_width);
@@ -92,6 +222,67 @@ calc_error (struct fpi_frame_asmbl_ctx *ctx,
   return err;
 }
 
+/* Plain zero-offset sum of absolute differences between two whole
+ * frames, without the overlap normalization of calc_error(). Reuses the
+ * SIMD kernels above for the packed layouts. */
+static unsigned long long
+frame_delta (struct fpi_frame_asmbl_ctx *ctx,
+             struct fpi_frame           *f1,
+             struct fpi_frame           *f2)
+{
+  unsigned long long err = 0;
+  unsigned int i;
+
+  if (ctx->packed_8bpp)
+    {
+      for (i = 0; i < ctx->frame_height; i++)
+        err += row_abs_diff_packed (frame_data (ctx, f1) + i * ctx->frame_width,
+                                    frame_data (ctx, f2) + i * ctx->frame_width,
+                                    ctx->frame_width);
+    }
+  else if (ctx->packed_4bpp)
+    {
+      unsigned int stride = ctx->frame_height >> 1;
+
+      for (i = 0; i < ctx->frame_width; i++)
+        err += col_abs_diff_nibbles (frame_data (ctx, f1) + i * stride, 0,
+                                     frame_data (ctx, f2) + i * stride, 0,
+                                     ctx->frame_height);
+    }
+  else
+    {
+      unsigned int x, y;
+
+      for (y = 0; y < ctx->frame_height; y++)
+        for (x = 0; x < ctx->frame_width; x++)
+          {
+            unsigned char v1 = ctx->get_pixel (ctx, f1, x, y);
+            unsigned char v2 = ctx->get_pixel (ctx, f2, x, y);
+
+            err += v1 > v2 ? v1 - v2 : v2 - v1;
+          }
+    }
+
+  return err;
+}
+
+/* Mean per-pixel delta (in 8bpp gray levels) below which two adjacent
+ * frames count as the same stationary sensor view. Large enough to
+ * absorb sensor noise, far below the delta of a single row of actual
+ * movement. */
+#define STATIONARY_MEAN_DELTA 2
+
+static gboolean
+frame_is_stationary (struct fpi_frame_asmbl_ctx *ctx,
+                     struct fpi_frame           *frame,
+                     struct fpi_frame           *prev)
+{
+  unsigned long long threshold = (unsigned long long) STATIONARY_MEAN_DELTA *
+                                 ctx->frame_width * ctx->frame_height;
+
+  return frame_delta (ctx, frame, prev) < threshold;
+}
+
 /* This function is rather CPU-intensive. It's better to use hardware
  * to detect movement direction when possible.
  */
@@ -153,6 +344,19 @@ do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
     {
       struct fpi_frame *cur_stripe = l->data;
 
+      /* Slow swipes deliver runs of frames with no movement at all; the
+       * zero-offset frame delta is offsets-times cheaper than the
+       * overlap search, and the search would attribute a spurious
+       * two-row movement to an identical frame (its vertical seek
+       * starts at 2). */
+      if (frame_is_stationary (ctx, cur_stripe, prev_stripe))
+        {
+          cur_stripe->delta_x = 0;
+          cur_stripe->delta_y = 0;
+          prev_stripe = cur_stripe;
+          continue;
+        }
+
       if (reverse)
         {
           find_overlap (ctx, prev_stripe, cur_stripe,
@@ -204,6 +408,459 @@ fpi_do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
     do_movement_estimation (ctx, stripes, FALSE);
 }
 
+struct fpi_frame_ring
+{
+  gsize          stride;   /* frame header plus payload, aligned */
+  unsigned int   capacity;
+  gint           head;     /* frames committed, written by the producer */
+  unsigned int   tail;     /* frames consumed, owned by the consumer */
+  unsigned char *slots;
+};
+
+static struct fpi_frame *
+frame_ring_slot (struct fpi_frame_ring *ring, unsigned int i)
+{
+  return (struct fpi_frame *) (ring->slots + (gsize) i * ring->stride);
+}
+
+/**
+ * fpi_frame_ring_new:
+ * @frame_size: payload size (in bytes) of a single frame
+ * @capacity: maximum number of frames buffered per swipe
+ *
+ * Creates a preallocated single-producer single-consumer frame ring.
+ * The producer (usually a transfer completion callback) claims the next
+ * slot with fpi_frame_ring_producer_slot(), fills it in place and
+ * commits it with fpi_frame_ring_push(); the consumer drains committed
+ * frames in order with fpi_frame_ring_pop(). No per-frame allocation or
+ * locking happens on either side.
+ *
+ * Consuming a frame only advances the read cursor; all frames of a
+ * swipe stay resident so they can be revisited for stitching, until
+ * fpi_frame_ring_reset() recycles the ring for the next swipe.
+ *
+ * Returns: a newly allocated #fpi_frame_ring
+ */
+struct fpi_frame_ring *
+fpi_frame_ring_new (gsize frame_size, unsigned int capacity)
+{
+  struct fpi_frame_ring *ring;
+
+  g_return_val_if_fail (capacity > 0, NULL);
+
+  ring = g_new0 (struct fpi_frame_ring, 1);
+  ring->stride = (sizeof (struct fpi_frame) + frame_size + 7) & ~(gsize) 7;
+  ring->capacity = capacity;
+  ring->slots = g_malloc (ring->stride * capacity);
+
+  return ring;
+}
+
+/**
+ * fpi_frame_ring_producer_slot:
+ * @ring: a #fpi_frame_ring
+ *
+ * Claims the next free frame slot for the producer to fill. The slot's
+ * @delta_x and @delta_y are reset to zero. The frame only becomes
+ * visible to the consumer once committed with fpi_frame_ring_push().
+ *
+ * Returns: (nullable): the slot, or %NULL if all slots are in use
+ */
+struct fpi_frame *
+fpi_frame_ring_producer_slot (struct fpi_frame_ring *ring)
+{
+  struct fpi_frame *frame;
+
+  if ((unsigned int) ring->head >= ring->capacity)
+    return NULL;
+
+  frame = frame_ring_slot (ring, ring->head);
+  frame->delta_x = 0;
+  frame->delta_y = 0;
+
+  return frame;
+}
+
+/**
+ * fpi_frame_ring_push:
+ * @ring: a #fpi_frame_ring
+ *
+ * Commits the slot claimed with fpi_frame_ring_producer_slot(), making
+ * it visible to the consumer.
+ */
+void
+fpi_frame_ring_push (struct fpi_frame_ring *ring)
+{
+  g_return_if_fail ((unsigned int) ring->head < ring->capacity);
+
+  g_atomic_int_set (&ring->head, ring->head + 1);
+}
+
+/**
+ * fpi_frame_ring_pop:
+ * @ring: a #fpi_frame_ring
+ *
+ * Takes the oldest committed frame that has not been consumed yet. The
+ * returned frame stays valid until fpi_frame_ring_reset() or
+ * fpi_frame_ring_free().
+ *
+ * Returns: (nullable): the frame, or %NULL if the ring is drained
+ */
+struct fpi_frame *
+fpi_frame_ring_pop (struct fpi_frame_ring *ring)
+{
+  if (ring->tail >= (unsigned int) g_atomic_int_get (&ring->head))
+    return NULL;
+
+  return frame_ring_slot (ring, ring->tail++);
+}
+
+/**
+ * fpi_frame_ring_count:
+ * @ring: a #fpi_frame_ring
+ *
+ * Returns: the number of committed frames
+ */
+unsigned int
+fpi_frame_ring_count (struct fpi_frame_ring *ring)
+{
+  return g_atomic_int_get (&ring->head);
+}
+
+/**
+ * fpi_frame_ring_frame:
+ * @ring: a #fpi_frame_ring
+ * @i: index of the frame, in commit order
+ *
+ * Random access to a committed frame, for going over a whole swipe
+ * again during stitching. Only valid for indices below
+ * fpi_frame_ring_count().
+ *
+ * Returns: the frame
+ */
+struct fpi_frame *
+fpi_frame_ring_frame (struct fpi_frame_ring *ring, unsigned int i)
+{
+  return frame_ring_slot (ring, i);
+}
+
+/**
+ * fpi_frame_ring_reset:
+ * @ring: a #fpi_frame_ring
+ *
+ * Recycles all slots for the next swipe. May only be called while no
+ * producer or consumer is active; frames previously returned become
+ * invalid.
+ */
+void
+fpi_frame_ring_reset (struct fpi_frame_ring *ring)
+{
+  g_atomic_int_set (&ring->head, 0);
+  ring->tail = 0;
+}
+
+/**
+ * fpi_frame_ring_free:
+ * @ring: a #fpi_frame_ring
+ *
+ * Releases the ring and all frames stored in it.
+ */
+void
+fpi_frame_ring_free (struct fpi_frame_ring *ring)
+{
+  if (!ring)
+    return;
+
+  g_free (ring->slots);
+  g_free (ring);
+}
+
+typedef struct
+{
+  int          dx, dy;   /* forward estimate */
+  int          rdx, rdy; /* reverse estimate */
+} frame_deltas;
+
+struct fpi_frame_assembler
+{
+  struct fpi_frame_asmbl_ctx *ctx;
+  gsize               frame_size;
+
+  struct fpi_frame_ring *ring;
+  GArray             *deltas; /* one frame_deltas per frame but the first */
+  unsigned long long  total_err;
+  unsigned long long  total_rev_err;
+
+  GThread            *worker;
+  GMutex              lock;
+  GCond               cond;
+  gboolean            stopping;
+  gint                worker_waiting;
+  gboolean            warned_full;
+  struct fpi_frame   *prev_frame;
+};
+
+static gpointer
+frame_assembler_worker (gpointer data)
+{
+  struct fpi_frame_assembler *assembler = data;
+  struct fpi_frame_asmbl_ctx *ctx = assembler->ctx;
+
+  for (;;)
+    {
+      struct fpi_frame *frame = fpi_frame_ring_pop (assembler->ring);
+      frame_deltas deltas;
+      unsigned int err;
+
+      if (!frame)
+        {
+          /* Ring drained; sleep until the producer commits a frame. */
+          g_mutex_lock (&assembler->lock);
+          g_atomic_int_set (&assembler->worker_waiting, TRUE);
+          while (!(frame = fpi_frame_ring_pop (assembler->ring)) &&
+                 !assembler->stopping)
+            g_cond_wait (&assembler->cond, &assembler->lock);
+          g_atomic_int_set (&assembler->worker_waiting, FALSE);
+          g_mutex_unlock (&assembler->lock);
+
+          if (!frame)
+            break;
+        }
+
+      if (assembler->prev_frame)
+        {
+          find_overlap (ctx, frame, assembler->prev_frame,
+                        &deltas.dx, &deltas.dy, &err);
+          assembler->total_err += err;
+
+          find_overlap (ctx, assembler->prev_frame, frame,
+                        &deltas.rdx, &deltas.rdy, &err);
+          deltas.rdx = -deltas.rdx;
+          deltas.rdy = -deltas.rdy;
+          assembler->total_rev_err += err;
+
+          g_array_append_val (assembler->deltas, deltas);
+        }
+
+      assembler->prev_frame = frame;
+    }
+
+  return NULL;
+}
+
+/**
+ * fpi_frame_assembler_new:
+ * @ctx: #fpi_frame_asmbl_ctx - frame assembling context
+ * @frame_size: payload size (in bytes) of a single frame
+ * @max_frames: maximum number of frames buffered per swipe
+ *
+ * Creates an incremental frame assembler. Frames registered with
+ * fpi_frame_assembler_get_slot()/fpi_frame_assembler_commit_slot() (or
+ * fpi_frame_assembler_add_frame()) have their movement estimated on a
+ * worker thread while the swipe is still in progress, so that only the
+ * cheap final stitching remains once the finger leaves the sensor.
+ *
+ * All frame storage for a swipe is preallocated up front in a
+ * #fpi_frame_ring of @max_frames slots, so registering a frame does not
+ * allocate. Frames captured past @max_frames are dropped.
+ *
+ * This replaces the fpi_do_movement_estimation()/fpi_assemble_frames()
+ * pair for drivers without hardware movement estimation.
+ *
+ * Returns: a newly allocated #fpi_frame_assembler
+ */
+struct fpi_frame_assembler *
+fpi_frame_assembler_new (struct fpi_frame_asmbl_ctx *ctx,
+                         gsize                       frame_size,
+                         unsigned int                max_frames)
+{
+  struct fpi_frame_assembler *assembler;
+
+  assembler = g_new0 (struct fpi_frame_assembler, 1);
+  assembler->ctx = ctx;
+  assembler->frame_size = frame_size;
+  assembler->ring = fpi_frame_ring_new (frame_size, max_frames);
+  assembler->deltas = g_array_new (FALSE, FALSE, sizeof (frame_deltas));
+  g_mutex_init (&assembler->lock);
+  g_cond_init (&assembler->cond);
+  assembler->worker = g_thread_new ("frame-assembler",
+                                    frame_assembler_worker, assembler);
+
+  return assembler;
+}
+
+/**
+ * fpi_frame_assembler_get_slot:
+ * @assembler: a #fpi_frame_assembler
+ *
+ * Claims the next preallocated frame slot for the capture callback to
+ * fill in place, without any allocation. Commit it with
+ * fpi_frame_assembler_commit_slot() once the data is in.
+ *
+ * Returns: (nullable): the slot, or %NULL if the swipe exceeded the
+ *   assembler's capacity
+ */
+struct fpi_frame *
+fpi_frame_assembler_get_slot (struct fpi_frame_assembler *assembler)
+{
+  struct fpi_frame *frame = fpi_frame_ring_producer_slot (assembler->ring);
+
+  if (!frame && !assembler->warned_full)
+    {
+      fp_warn ("frame assembler ring full, dropping further frames");
+      assembler->warned_full = TRUE;
+    }
+
+  return frame;
+}
+
+/**
+ * fpi_frame_assembler_commit_slot:
+ * @assembler: a #fpi_frame_assembler
+ *
+ * Hands the slot claimed with fpi_frame_assembler_get_slot() over to the
+ * movement estimation worker. Frames that show no movement against the
+ * previously committed frame are dropped on the spot, so stationary
+ * stretches of a slow swipe cost neither estimation nor ring capacity.
+ */
+void
+fpi_frame_assembler_commit_slot (struct fpi_frame_assembler *assembler)
+{
+  unsigned int count = fpi_frame_ring_count (assembler->ring);
+
+  /* Cull frames that show no movement against the last kept frame
+   * before they ever reach the worker: slow swipes produce long runs
+   * of near-identical frames and every kept frame costs two full
+   * overlap searches. Committed frames are never written again, so
+   * reading the predecessor here is safe. The dropped slot is simply
+   * reclaimed by the next fpi_frame_ring_producer_slot() call. */
+  if (count > 0 &&
+      frame_is_stationary (assembler->ctx,
+                           frame_ring_slot (assembler->ring, count),
+                           fpi_frame_ring_frame (assembler->ring, count - 1)))
+    return;
+
+  fpi_frame_ring_push (assembler->ring);
+
+  /* Only take the lock when the worker has actually gone to sleep. */
+  if (g_atomic_int_get (&assembler->worker_waiting))
+    {
+      g_mutex_lock (&assembler->lock);
+      g_cond_signal (&assembler->cond);
+      g_mutex_unlock (&assembler->lock);
+    }
+}
+
+/**
+ * fpi_frame_assembler_add_frame:
+ * @assembler: a #fpi_frame_assembler
+ * @frame: (transfer full): the captured #fpi_frame
+ *
+ * Registers a newly captured frame in capture order by copying it into
+ * the next free slot; its @delta_x and @delta_y do not need to be
+ * populated. Drivers that can capture directly into the slot returned
+ * by fpi_frame_assembler_get_slot() should prefer that to avoid the
+ * copy and the caller-side allocation.
+ */
+void
+fpi_frame_assembler_add_frame (struct fpi_frame_assembler *assembler,
+                               struct fpi_frame           *frame)
+{
+  struct fpi_frame *slot = fpi_frame_assembler_get_slot (assembler);
+
+  if (slot)
+    {
+      memcpy (slot, frame,
+              sizeof (struct fpi_frame) + assembler->frame_size);
+      fpi_frame_assembler_commit_slot (assembler);
+    }
+
+  g_free (frame);
+}
+
+/**
+ * fpi_frame_assembler_finish:
+ * @assembler: a #fpi_frame_assembler
+ *
+ * Waits for the pending movement estimates (normally already complete by
+ * the time the finger leaves the sensor), picks the swipe direction with
+ * the smaller total error and stitches the frames together.
+ *
+ * Returns: (nullable) (transfer full): the assembled #FpImage
+ */
+FpImage *
+fpi_frame_assembler_finish (struct fpi_frame_assembler *assembler)
+{
+  GSList *stripes = NULL;
+  gboolean reverse;
+  unsigned int count;
+  FpImage *img;
+  guint i;
+
+  g_mutex_lock (&assembler->lock);
+  assembler->stopping = TRUE;
+  g_cond_signal (&assembler->cond);
+  g_mutex_unlock (&assembler->lock);
+  g_thread_join (assembler->worker);
+  assembler->worker = NULL;
+
+  count = fpi_frame_ring_count (assembler->ring);
+  if (count == 0)
+    return NULL;
+
+  reverse = assembler->total_rev_err < assembler->total_err;
+  fp_dbg ("errors: %llu rev: %llu",
+          assembler->total_err, assembler->total_rev_err);
+
+  for (i = 1; i < count; i++)
+    {
+      struct fpi_frame *frame = fpi_frame_ring_frame (assembler->ring, i);
+      frame_deltas *deltas = &g_array_index (assembler->deltas,
+                                             frame_deltas, i - 1);
+
+      frame->delta_x = reverse ? deltas->rdx : deltas->dx;
+      frame->delta_y = reverse ? deltas->rdy : deltas->dy;
+    }
+
+  for (i = count; i > 0; i--)
+    stripes = g_slist_prepend (stripes,
+                               fpi_frame_ring_frame (assembler->ring, i - 1));
+
+  img = fpi_assemble_frames (assembler->ctx, stripes);
+  g_slist_free (stripes);
+
+  return img;
+}
+
+/**
+ * fpi_frame_assembler_free:
+ * @assembler: a #fpi_frame_assembler
+ *
+ * Releases the assembler and all frames still owned by it. Can be called
+ * without fpi_frame_assembler_finish() to abort an ongoing assembly.
+ */
+void
+fpi_frame_assembler_free (struct fpi_frame_assembler *assembler)
+{
+  if (!assembler)
+    return;
+
+  if (assembler->worker)
+    {
+      g_mutex_lock (&assembler->lock);
+      assembler->stopping = TRUE;
+      g_cond_signal (&assembler->cond);
+      g_mutex_unlock (&assembler->lock);
+      g_thread_join (assembler->worker);
+    }
+
+  g_mutex_clear (&assembler->lock);
+  g_cond_clear (&assembler->cond);
+  g_array_unref (assembler->deltas);
+  fpi_frame_ring_free (assembler->ring);
+  g_free (assembler);
+}
+
 static inline void
 aes_blit_stripe (struct fpi_frame_asmbl_ctx *ctx,
                  FpImage *img,
@@ -237,6 +894,41 @@ aes_blit_stripe (struct fpi_frame_asmbl_ctx *ctx,
       fy1 = 0;
     }
 
+  if (ctx->packed_8bpp && fx1 < ctx->frame_width && ix1 < img->width)
+    {
+      /* Rows are contiguous in both the frame and the image. */
+      unsigned int copy_width = MIN (ctx->frame_width - fx1,
+                                     img->width - ix1);
+
+      for (fy = fy1, iy = iy1;
+           fy < ctx->frame_height && iy < img->height;
+           fy++, iy++)
+        memcpy (img->data + ix1 + (iy * img->width),
+                frame_data (ctx, stripe) + (fy * ctx->frame_width) + fx1,
+                copy_width);
+      return;
+    }
+
+  if (ctx->packed_4bpp && fy1 < ctx->frame_height && iy1 < img->height)
+    {
+      /* Frame columns are contiguous nibble pairs: expand each visible
+       * column once through the shared lookup table instead of paying
+       * the accessor's shift and scale for every pixel, then scatter
+       * it down the image column. */
+      unsigned int stride = ctx->frame_height >> 1;
+      unsigned int copy_height = MIN (ctx->frame_height - fy1,
+                                      img->height - iy1);
+      g_autofree unsigned char *col = g_malloc (ctx->frame_height);
+
+      for (fx = fx1, ix = ix1; fx < ctx->frame_width && ix < img->width; fx++, ix++)
+        {
+          aes_unpack_4bpp (frame_data (ctx, stripe) + fx * stride, col, ctx->frame_height);
+          for (fy = 0; fy < copy_height; fy++)
+            img->data[ix + ((iy1 + fy) * img->width)] = col[fy1 + fy];
+        }
+      return;
+    }
+
   for (fy = fy1, iy = iy1; fy < ctx->frame_height && iy < img->height; fy++, iy++)
     for (fx = fx1, ix = ix1; fx < ctx->frame_width && ix < img->width; fx++, ix++)
       img->data[ix + (iy * img->width)] = ctx->get_pixel (ctx, stripe, fx, fy);
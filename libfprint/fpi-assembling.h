@@ -51,6 +51,22 @@ struct fpi_frame
  * Drivers should define their own #fpi_frame_asmbl_ctx depending on
  * hardware parameters of scanner. @image_width is usually 25% wider than
  * @frame_width to take horizontal movement into account.
+ *
+ * Drivers whose @get_pixel simply indexes @data as one byte per pixel in
+ * row-major order should additionally set @packed_8bpp, which lets the
+ * movement estimation use a vectorized absolute-difference kernel over
+ * the rows instead of the per-pixel accessor. Drivers using the AES
+ * nibble layout (two vertically adjacent pixels per byte in column-major
+ * order, low nibble first, as decoded by aes_get_pixel()) should set
+ * @packed_4bpp instead for the equivalent direct kernel over the packed
+ * columns.
+ *
+ * Frames do not have to carry their pixels in @data: a driver that keeps
+ * captured packets alive can hand out frames that merely reference a
+ * region of the packet buffer by setting @get_frame_data to return the
+ * first pixel of the given frame. The packed kernels then read the
+ * pixels in place, so stripes never need to be copied out of the packet.
+ * When unset, @data is used directly.
  */
 struct fpi_frame_asmbl_ctx
 {
@@ -61,6 +77,10 @@ struct fpi_frame_asmbl_ctx
                              struct fpi_frame           *frame,
                              unsigned int                x,
                              unsigned int                y);
+  const unsigned char * (*get_frame_data)(struct fpi_frame_asmbl_ctx *ctx,
+                                          struct fpi_frame           *frame);
+  unsigned int  packed_8bpp;
+  unsigned int  packed_4bpp;
 };
 
 void fpi_do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
@@ -69,6 +89,50 @@ void fpi_do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
 FpImage *fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
                               GSList                     *stripes);
 
+/**
+ * fpi_frame_ring:
+ *
+ * An opaque preallocated single-producer single-consumer frame ring
+ * with a fixed per-frame stride. The capture callback claims a slot,
+ * fills it in place and commits it without allocating or locking; the
+ * consumer drains committed frames in capture order. All frames of a
+ * swipe stay resident until the ring is reset, so they can be revisited
+ * for stitching.
+ */
+struct fpi_frame_ring;
+
+struct fpi_frame_ring *fpi_frame_ring_new (gsize        frame_size,
+                                           unsigned int capacity);
+struct fpi_frame *fpi_frame_ring_producer_slot (struct fpi_frame_ring *ring);
+void fpi_frame_ring_push (struct fpi_frame_ring *ring);
+struct fpi_frame *fpi_frame_ring_pop (struct fpi_frame_ring *ring);
+unsigned int fpi_frame_ring_count (struct fpi_frame_ring *ring);
+struct fpi_frame *fpi_frame_ring_frame (struct fpi_frame_ring *ring,
+                                        unsigned int           i);
+void fpi_frame_ring_reset (struct fpi_frame_ring *ring);
+void fpi_frame_ring_free (struct fpi_frame_ring *ring);
+
+/**
+ * fpi_frame_assembler:
+ *
+ * An opaque incremental frame assembler. Frames are registered as they
+ * are captured and movement estimation runs concurrently on a worker
+ * thread, so the assembled image is available almost immediately once
+ * the swipe ends. Frame storage is preallocated in a #fpi_frame_ring,
+ * so registering a frame does not allocate.
+ */
+struct fpi_frame_assembler;
+
+struct fpi_frame_assembler *fpi_frame_assembler_new (struct fpi_frame_asmbl_ctx *ctx,
+                                                     gsize                       frame_size,
+                                                     unsigned int                max_frames);
+struct fpi_frame *fpi_frame_assembler_get_slot (struct fpi_frame_assembler *assembler);
+void fpi_frame_assembler_commit_slot (struct fpi_frame_assembler *assembler);
+void fpi_frame_assembler_add_frame (struct fpi_frame_assembler *assembler,
+                                    struct fpi_frame           *frame);
+FpImage *fpi_frame_assembler_finish (struct fpi_frame_assembler *assembler);
+void fpi_frame_assembler_free (struct fpi_frame_assembler *assembler);
+
 /**
  * fpi_line_asmbl_ctx:
  * @line_width: width of line
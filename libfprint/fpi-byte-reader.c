@@ -820,6 +820,96 @@ fpi_byte_reader_dup_data (FpiByteReader * reader, guint size, guint8 ** val)
   return fpi_byte_reader_dup_data_inline (reader, size, val);
 }
 
+/**
+ * fpi_byte_reader_get_uint16_le_array:
+ * @reader: a #FpiByteReader instance
+ * @count: number of values to read
+ * @val: (out caller-allocates) (array length=count): array in which to
+ *     store the result
+ *
+ * Read @count unsigned 16 bit little endian integers into @val and
+ * update the current position. The available data is validated once up
+ * front, so this is considerably cheaper than @count individual
+ * fpi_byte_reader_get_uint16_le() calls. On little endian hosts the
+ * values are copied in bulk.
+ *
+ * Returns: %TRUE if successful, %FALSE otherwise.
+ */
+gboolean
+fpi_byte_reader_get_uint16_le_array (FpiByteReader * reader, guint count,
+    guint16 * val)
+{
+  const guint8 *data;
+
+  g_return_val_if_fail (reader != NULL, FALSE);
+  g_return_val_if_fail (val != NULL, FALSE);
+
+  if (G_UNLIKELY (count > G_MAXUINT / sizeof (guint16)))
+    return FALSE;
+
+  if (!fpi_byte_reader_get_data_inline (reader, count * sizeof (guint16),
+          &data))
+    return FALSE;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  memcpy (val, data, count * sizeof (guint16));
+#else
+  {
+    guint i;
+
+    for (i = 0; i < count; i++)
+      val[i] = FP_READ_UINT16_LE (data + i * sizeof (guint16));
+  }
+#endif
+
+  return TRUE;
+}
+
+/**
+ * fpi_byte_reader_get_int32_le_array:
+ * @reader: a #FpiByteReader instance
+ * @count: number of values to read
+ * @val: (out caller-allocates) (array length=count): array in which to
+ *     store the result
+ *
+ * Read @count signed 32 bit little endian integers into @val and update
+ * the current position. The available data is validated once up front,
+ * so this is considerably cheaper than @count individual
+ * fpi_byte_reader_get_int32_le() calls. On little endian hosts the
+ * values are copied in bulk.
+ *
+ * Returns: %TRUE if successful, %FALSE otherwise.
+ */
+gboolean
+fpi_byte_reader_get_int32_le_array (FpiByteReader * reader, guint count,
+    gint32 * val)
+{
+  const guint8 *data;
+
+  g_return_val_if_fail (reader != NULL, FALSE);
+  g_return_val_if_fail (val != NULL, FALSE);
+
+  if (G_UNLIKELY (count > G_MAXUINT / sizeof (gint32)))
+    return FALSE;
+
+  if (!fpi_byte_reader_get_data_inline (reader, count * sizeof (gint32),
+          &data))
+    return FALSE;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  memcpy (val, data, count * sizeof (gint32));
+#else
+  {
+    guint i;
+
+    for (i = 0; i < count; i++)
+      val[i] = (gint32) FP_READ_UINT32_LE (data + i * sizeof (gint32));
+  }
+#endif
+
+  return TRUE;
+}
+
 /* Special optimized scan for mask 0xffffff00 and pattern 0x00000100 */
 static inline gint
 _scan_for_start_code (const guint8 * data, guint size)
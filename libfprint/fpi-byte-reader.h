@@ -219,6 +219,12 @@ gboolean        fpi_byte_reader_get_data        (FpiByteReader * reader, guint s
 
 gboolean        fpi_byte_reader_peek_data       (const FpiByteReader * reader, guint size, const guint8 ** val);
 
+
+gboolean        fpi_byte_reader_get_uint16_le_array (FpiByteReader * reader, guint count, guint16 * val);
+
+
+gboolean        fpi_byte_reader_get_int32_le_array  (FpiByteReader * reader, guint count, gint32  * val);
+
 #define fpi_byte_reader_dup_string(reader,str) \
     fpi_byte_reader_dup_string_utf8(reader,str)
 
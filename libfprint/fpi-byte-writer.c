@@ -39,6 +39,79 @@
  * in various character encodings.
  */
 
+/* Size-class pool of backing buffers, shared across writers. Command
+ * builders and template serializers create short-lived writers at a
+ * high rate; recycling their grown buffers turns the realloc chain of
+ * a big serialization into (at most) one pool hit per size class.
+ * Buffers are plain g_malloc allocations so that
+ * fpi_byte_writer_reset_and_get_data() can keep handing them to
+ * callers that g_free() them; such buffers simply never return to the
+ * pool. Only power-of-two sizes between 16 bytes and 64 KiB are
+ * pooled, which is every size the doubling growth policy produces. */
+#define WRITER_POOL_MIN_SHIFT 4
+#define WRITER_POOL_MAX_SHIFT 16
+#define WRITER_POOL_CLASSES (WRITER_POOL_MAX_SHIFT - WRITER_POOL_MIN_SHIFT + 1)
+#define WRITER_POOL_DEPTH 8
+
+static GMutex writer_pool_lock;
+static guint8 *writer_pool[WRITER_POOL_CLASSES][WRITER_POOL_DEPTH];
+static guint writer_pool_len[WRITER_POOL_CLASSES];
+
+/* Class index for @size, or -1 if buffers of this size are not pooled
+ * (not a power of two, or outside the pooled range). */
+static gint
+fpi_byte_writer_pool_class (guint size)
+{
+  gint shift;
+
+  if (size < (1u << WRITER_POOL_MIN_SHIFT) ||
+      size > (1u << WRITER_POOL_MAX_SHIFT) ||
+      (size & (size - 1)) != 0)
+    return -1;
+
+  shift = g_bit_nth_lsf (size, -1);
+  return shift - WRITER_POOL_MIN_SHIFT;
+}
+
+static guint8 *
+fpi_byte_writer_pool_alloc (guint alloc_size)
+{
+  gint cls = fpi_byte_writer_pool_class (alloc_size);
+  guint8 *data = NULL;
+
+  if (cls >= 0)
+    {
+      g_mutex_lock (&writer_pool_lock);
+      if (writer_pool_len[cls] > 0)
+        data = writer_pool[cls][--writer_pool_len[cls]];
+      g_mutex_unlock (&writer_pool_lock);
+    }
+
+  if (!data)
+    data = g_try_malloc (alloc_size);
+
+  return data;
+}
+
+static void
+fpi_byte_writer_pool_release (guint8 *data, guint alloc_size)
+{
+  gint cls = fpi_byte_writer_pool_class (alloc_size);
+
+  if (cls >= 0)
+    {
+      g_mutex_lock (&writer_pool_lock);
+      if (writer_pool_len[cls] < WRITER_POOL_DEPTH)
+        {
+          writer_pool[cls][writer_pool_len[cls]++] = data;
+          data = NULL;
+        }
+      g_mutex_unlock (&writer_pool_lock);
+    }
+
+  g_free (data);
+}
+
 /**
  * fpi_byte_writer_new: (skip)
  *
@@ -74,10 +147,7 @@ fpi_byte_writer_new_with_size (guint size, gboolean fixed)
 {
   FpiByteWriter *ret = fpi_byte_writer_new ();
 
-  ret->alloc_size = size;
-  ret->parent.data = g_malloc (ret->alloc_size);
-  ret->fixed = fixed;
-  ret->owned = TRUE;
+  fpi_byte_writer_init_with_size (ret, size, fixed);
 
   return ret;
 }
@@ -142,7 +212,15 @@ fpi_byte_writer_init_with_size (FpiByteWriter * writer, guint size,
 
   fpi_byte_writer_init (writer);
 
-  writer->parent.data = g_malloc (size);
+  /* Growable writers round up to the pooled size classes; fixed ones
+   * keep the exact size so fpi_byte_writer_get_remaining() reflects
+   * the requested capacity. */
+  if (!fixed)
+    size = fpi_byte_writer_next_pow2 (size);
+
+  writer->parent.data = fixed ? g_malloc (size) : fpi_byte_writer_pool_alloc (size);
+  if (!writer->parent.data)
+    writer->parent.data = g_malloc (size);
   writer->alloc_size = size;
   writer->fixed = fixed;
   writer->owned = TRUE;
@@ -186,8 +264,9 @@ fpi_byte_writer_reset (FpiByteWriter * writer)
 {
   g_return_if_fail (writer != NULL);
 
-  if (writer->owned)
-    g_free ((guint8 *) writer->parent.data);
+  if (writer->owned && writer->parent.data)
+    fpi_byte_writer_pool_release ((guint8 *) writer->parent.data,
+                                  writer->alloc_size);
   memset (writer, 0, sizeof (FpiByteWriter));
 }
 
@@ -293,6 +372,67 @@ fpi_byte_writer_ensure_free_space (FpiByteWriter * writer, guint size)
   return fpi_byte_writer_ensure_free_space_inline (writer, size);
 }
 
+/**
+ * fpi_byte_writer_reserve:
+ * @writer: #FpiByteWriter instance
+ * @size: Total capacity in bytes to reserve
+ *
+ * Makes sure the backing buffer can hold @size bytes in total without
+ * further reallocation. Serializers that can compute (or closely bound)
+ * their output size up front should call this once instead of growing
+ * through the put functions.
+ *
+ * Returns: %TRUE if @writer has capacity for @size bytes
+ */
+gboolean
+fpi_byte_writer_reserve (FpiByteWriter * writer, guint size)
+{
+  g_return_val_if_fail (writer != NULL, FALSE);
+
+  if (size <= writer->alloc_size)
+    return TRUE;
+
+  return fpi_byte_writer_grow (writer, size - writer->parent.byte);
+}
+
+/* Slow path of fpi_byte_writer_ensure_free_space_inline(): grow the
+ * backing buffer so that @size more bytes fit after the write cursor.
+ * The replacement buffer comes from the shared pool and the old one
+ * goes back to it, so repeated growth cycles stop hitting the
+ * allocator once the pool is warm. */
+gboolean
+fpi_byte_writer_grow (FpiByteWriter * writer, guint size)
+{
+  guint8 *data;
+  guint alloc_size;
+
+  g_return_val_if_fail (writer != NULL, FALSE);
+
+  if (G_LIKELY (size <= writer->alloc_size - writer->parent.byte))
+    return TRUE;
+  if (G_UNLIKELY (writer->fixed || !writer->owned))
+    return FALSE;
+  if (G_UNLIKELY (writer->parent.byte > G_MAXUINT - size))
+    return FALSE;
+
+  alloc_size = fpi_byte_writer_next_pow2 (writer->parent.byte + size);
+  data = fpi_byte_writer_pool_alloc (alloc_size);
+  if (G_UNLIKELY (data == NULL))
+    return FALSE;
+
+  if (writer->parent.data)
+    {
+      memcpy (data, writer->parent.data, writer->parent.size);
+      fpi_byte_writer_pool_release ((guint8 *) writer->parent.data,
+                                    writer->alloc_size);
+    }
+
+  writer->parent.data = data;
+  writer->alloc_size = alloc_size;
+
+  return TRUE;
+}
+
 
 #define CREATE_WRITE_FUNC(bits,type,name,write_func) \
 gboolean \
@@ -338,6 +478,92 @@ fpi_byte_writer_fill (FpiByteWriter * writer, guint8 value, guint size)
   return fpi_byte_writer_fill_inline (writer, value, size);
 }
 
+/**
+ * fpi_byte_writer_put_uint16_le_array:
+ * @writer: #FpiByteWriter instance
+ * @data: (transfer none) (array length=count): values to write
+ * @count: number of values to write
+ *
+ * Writes @count unsigned 16 bit little endian integers from @data to
+ * @writer. The free space is ensured once up front, so this is
+ * considerably cheaper than @count individual
+ * fpi_byte_writer_put_uint16_le() calls. On little endian hosts the
+ * values are copied in bulk.
+ *
+ * Returns: %TRUE if the values could be written
+ */
+gboolean
+fpi_byte_writer_put_uint16_le_array (FpiByteWriter * writer,
+    const guint16 * data, guint count)
+{
+  g_return_val_if_fail (writer != NULL, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  if (G_UNLIKELY (count > G_MAXUINT / sizeof (guint16)))
+    return FALSE;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  return fpi_byte_writer_put_data_inline (writer, (const guint8 *) data,
+      count * sizeof (guint16));
+#else
+  {
+    guint i;
+
+    if (G_UNLIKELY (!fpi_byte_writer_ensure_free_space_inline (writer,
+                count * sizeof (guint16))))
+      return FALSE;
+
+    for (i = 0; i < count; i++)
+      fpi_byte_writer_put_uint16_le_unchecked (writer, data[i]);
+
+    return TRUE;
+  }
+#endif
+}
+
+/**
+ * fpi_byte_writer_put_int32_le_array:
+ * @writer: #FpiByteWriter instance
+ * @data: (transfer none) (array length=count): values to write
+ * @count: number of values to write
+ *
+ * Writes @count signed 32 bit little endian integers from @data to
+ * @writer. The free space is ensured once up front, so this is
+ * considerably cheaper than @count individual
+ * fpi_byte_writer_put_int32_le() calls. On little endian hosts the
+ * values are copied in bulk.
+ *
+ * Returns: %TRUE if the values could be written
+ */
+gboolean
+fpi_byte_writer_put_int32_le_array (FpiByteWriter * writer,
+    const gint32 * data, guint count)
+{
+  g_return_val_if_fail (writer != NULL, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  if (G_UNLIKELY (count > G_MAXUINT / sizeof (gint32)))
+    return FALSE;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  return fpi_byte_writer_put_data_inline (writer, (const guint8 *) data,
+      count * sizeof (gint32));
+#else
+  {
+    guint i;
+
+    if (G_UNLIKELY (!fpi_byte_writer_ensure_free_space_inline (writer,
+                count * sizeof (gint32))))
+      return FALSE;
+
+    for (i = 0; i < count; i++)
+      fpi_byte_writer_put_int32_le_unchecked (writer, data[i]);
+
+    return TRUE;
+  }
+#endif
+}
+
 #define CREATE_WRITE_STRING_FUNC(bits,type) \
 gboolean \
 fpi_byte_writer_put_string_utf##bits (FpiByteWriter *writer, const type * data) \
@@ -124,6 +124,12 @@ guint           fpi_byte_writer_get_remaining     (const FpiByteWriter *writer);
 gboolean        fpi_byte_writer_ensure_free_space (FpiByteWriter *writer, guint size);
 
 
+gboolean        fpi_byte_writer_reserve           (FpiByteWriter *writer, guint size);
+
+
+gboolean        fpi_byte_writer_grow              (FpiByteWriter *writer, guint size);
+
+
 gboolean        fpi_byte_writer_put_uint8         (FpiByteWriter *writer, guint8 val);
 
 
@@ -196,6 +202,12 @@ gboolean        fpi_byte_writer_put_data          (FpiByteWriter *writer, const
 gboolean        fpi_byte_writer_fill              (FpiByteWriter *writer, guint8 value, guint size);
 
 
+gboolean        fpi_byte_writer_put_uint16_le_array (FpiByteWriter *writer, const guint16 *data, guint count);
+
+
+gboolean        fpi_byte_writer_put_int32_le_array  (FpiByteWriter *writer, const gint32 *data, guint count);
+
+
 gboolean        fpi_byte_writer_put_string_utf8   (FpiByteWriter *writer, const gchar *data);
 
 
@@ -234,23 +246,11 @@ fpi_byte_writer_next_pow2 (guint n)
 static inline gboolean
 fpi_byte_writer_ensure_free_space_inline (FpiByteWriter * writer, guint size)
 {
-  gpointer data;
-
   if (G_LIKELY (size <= writer->alloc_size - writer->parent.byte))
     return TRUE;
-  if (G_UNLIKELY (writer->fixed || !writer->owned))
-    return FALSE;
-  if (G_UNLIKELY (writer->parent.byte > G_MAXUINT - size))
-    return FALSE;
 
-  writer->alloc_size = fpi_byte_writer_next_pow2 (writer->parent.byte + size);
-  data = g_try_realloc ((guint8 *) writer->parent.data, writer->alloc_size);
-  if (G_UNLIKELY (data == NULL))
-    return FALSE;
-
-  writer->parent.data = (guint8 *) data;
-
-  return TRUE;
+  /* Out of line: growth goes through the shared backing-buffer pool. */
+  return fpi_byte_writer_grow (writer, size);
 }
 
 #define __FPI_BYTE_WRITER_CREATE_WRITE_FUNC(bits,type,name,write_func) \
@@ -26,6 +26,7 @@
 #include "fpi-log.h"
 
 #include "fp-device-private.h"
+#include "fpi-trace.h"
 
 /**
  * SECTION: fpi-device
@@ -346,6 +347,29 @@ static GSourceFuncs timeout_funcs = {
   NULL, NULL
 };
 
+/* Slack granted to timeouts for coalescing, as a divisor of the
+ * interval (20 means up to 5% extra delay). */
+#define TIMEOUT_SLACK_DIV 20
+
+/* Coalesce timeout expirations onto shared boundaries, in the spirit of
+ * g_timeout_add_seconds(): the expiration is rounded up to the next
+ * multiple of the slack in monotonic time, so timeouts whose deadlines
+ * fall into the same slack window get identical ready times and are
+ * dispatched from a single mainloop wakeup. Polling drivers scheduling
+ * periodic SSM delays across several devices then wake the loop once
+ * per poll tick instead of once per device. */
+static gint64
+timeout_coalesced_ready_time (gint64 now, gint interval)
+{
+  gint64 expiration = now + interval * (gint64) 1000;
+  gint64 slack = (interval * (gint64) 1000) / TIMEOUT_SLACK_DIV;
+
+  if (slack <= 0)
+    return expiration;
+
+  return expiration + (slack - expiration % slack) % slack;
+}
+
 /**
  * fpi_device_add_timeout:
  * @device: The #FpDevice
@@ -357,6 +381,10 @@ static GSourceFuncs timeout_funcs = {
  * Register a timeout to run. Drivers should always make sure that timers are
  * cancelled when appropriate.
  *
+ * To reduce mainloop wakeups, expirations are coalesced and may fire up
+ * to 5% of @interval late. Drivers needing exact timing should use
+ * their own #GSource.
+ *
  * Returns: (transfer none): A newly created and attached #GSource
  */
 GSource *
@@ -374,15 +402,13 @@ fpi_device_add_timeout (FpDevice      *device,
                                                    sizeof (FpDeviceTimeoutSource));
   source->device = device;
 
-  if (priv->current_task)
-    context = g_task_get_context (priv->current_task);
-  else
-    context = g_main_context_get_thread_default ();
+  context = fpi_device_get_driver_context (device);
 
   g_source_attach (&source->source, context);
   g_source_set_callback (&source->source, (GSourceFunc) func, user_data, destroy_notify);
   g_source_set_ready_time (&source->source,
-                           g_source_get_time (&source->source) + interval * (guint64) 1000);
+                           timeout_coalesced_ready_time (g_source_get_time (&source->source),
+                                                         interval));
   priv->sources = g_slist_prepend (priv->sources, source);
   g_source_unref (&source->source);
 
@@ -522,6 +548,55 @@ fpi_device_get_driver_data (FpDevice *device)
   return priv->driver_data;
 }
 
+/**
+ * fpi_device_set_driver_snapshot:
+ * @device: The #FpDevice
+ * @snapshot: (nullable) (transfer floating): The new snapshot, or %NULL to clear
+ *
+ * Store a driver-defined state snapshot on the device. The snapshot is
+ * kept for the lifetime of the device object, across close/open and
+ * suspend/resume cycles, allowing the driver to skip initialization
+ * steps on a later open when the hardware preserved its state (e.g.
+ * match-on-chip sensors that stay powered over system suspend).
+ *
+ * It is entirely up to the driver to define the snapshot contents and
+ * to validate on open that the snapshot still describes the hardware,
+ * for instance by comparing a cheap-to-query firmware version before
+ * skipping more expensive configuration steps.
+ */
+void
+fpi_device_set_driver_snapshot (FpDevice *device,
+                                GVariant *snapshot)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+
+  if (snapshot)
+    g_variant_ref_sink (snapshot);
+  g_clear_pointer (&priv->driver_snapshot, g_variant_unref);
+  priv->driver_snapshot = snapshot;
+}
+
+/**
+ * fpi_device_get_driver_snapshot:
+ * @device: The #FpDevice
+ *
+ * Retrieve the snapshot stored with fpi_device_set_driver_snapshot()
+ * by an earlier open of this device object, if any.
+ *
+ * Returns: (nullable) (transfer none): The stored snapshot
+ */
+GVariant *
+fpi_device_get_driver_snapshot (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), NULL);
+
+  return priv->driver_snapshot;
+}
+
 void
 enroll_data_free (FpEnrollData *data)
 {
@@ -545,6 +620,20 @@ match_data_free (FpMatchData *data)
 
   g_clear_object (&data->enrolled_print);
   g_clear_pointer (&data->gallery, g_ptr_array_unref);
+  g_clear_pointer (&data->multi_prints, g_ptr_array_unref);
+  g_clear_pointer (&data->candidates, g_ptr_array_unref);
+
+  g_free (data);
+}
+
+void
+list_data_free (FpListData *data)
+{
+  g_clear_pointer (&data->prints, g_ptr_array_unref);
+
+  if (data->list_destroy)
+    data->list_destroy (data->list_data);
+  data->list_data = NULL;
 
   g_free (data);
 }
@@ -573,6 +662,46 @@ fpi_device_get_enroll_data (FpDevice *device,
     *print = data->print;
 }
 
+/**
+ * fpi_device_get_enroll_duplicates_gallery:
+ * @device: The #FpDevice
+ *
+ * Get the gallery to screen for duplicates during enrollment, as set by
+ * the application with fp_device_set_enroll_duplicates_gallery().
+ *
+ * Returns: (transfer none) (nullable) (element-type FpPrint): The
+ *   gallery, or %NULL when no duplicate screen was requested
+ */
+GPtrArray *
+fpi_device_get_enroll_duplicates_gallery (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), NULL);
+  g_return_val_if_fail (priv->current_action == FPI_DEVICE_ACTION_ENROLL, NULL);
+
+  return priv->enroll_duplicates_gallery;
+}
+
+/**
+ * fpi_device_get_resume_on_retry:
+ * @device: The #FpDevice
+ *
+ * Whether the application asked for retryable scan errors to keep the
+ * operation running, as set with fp_device_set_resume_on_retry().
+ *
+ * Returns: %TRUE when retryable errors should not complete the operation
+ */
+gboolean
+fpi_device_get_resume_on_retry (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  return priv->resume_on_retry;
+}
+
 /**
  * fpi_device_get_capture_data:
  * @device: The #FpDevice
@@ -617,6 +746,79 @@ fpi_device_get_verify_data (FpDevice *device,
     *print = data->enrolled_print;
 }
 
+/**
+ * fpi_device_verify_has_next_stage:
+ * @device: The #FpDevice
+ *
+ * Whether the ongoing verification is a multi-finger one with further
+ * prints left after the current stage, see fp_device_verify_multi().
+ * Unlike fpi_device_verify_advance_stage() this changes nothing; use it
+ * to decide whether a deactivation decision must wait for the match
+ * result.
+ *
+ * Returns: %TRUE when further prints remain
+ */
+gboolean
+fpi_device_verify_has_next_stage (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpMatchData *data;
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+  g_return_val_if_fail (priv->current_action == FPI_DEVICE_ACTION_VERIFY, FALSE);
+
+  data = g_task_get_task_data (priv->current_task);
+  g_assert (data);
+
+  return data->multi_prints && data->multi_stage + 1 < data->multi_prints->len;
+}
+
+/**
+ * fpi_device_verify_advance_stage:
+ * @device: The #FpDevice
+ *
+ * Advance a multi-finger verification to its next print, see
+ * fp_device_verify_multi(). Call after reporting a successful match
+ * through fpi_device_verify_report(): when another print remains, the
+ * reported result is cleared, fpi_device_get_verify_data() switches to
+ * the next print, and the driver should re-arm the sensor instead of
+ * completing the operation.
+ *
+ * Returns: %TRUE when another finger is to be verified, %FALSE when
+ *    the operation is complete (or not a multi-finger verification)
+ */
+gboolean
+fpi_device_verify_advance_stage (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpMatchData *data;
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+  g_return_val_if_fail (priv->current_action == FPI_DEVICE_ACTION_VERIFY, FALSE);
+
+  data = g_task_get_task_data (priv->current_task);
+  g_assert (data);
+
+  if (!fpi_device_verify_has_next_stage (device))
+    return FALSE;
+
+  data->multi_stage++;
+  g_set_object (&data->enrolled_print,
+                g_ptr_array_index (data->multi_prints, data->multi_stage));
+
+  /* The per-finger result was already delivered through the match
+   * callback; the next finger's report starts from a clean slate. */
+  data->result_reported = FALSE;
+  g_clear_error (&data->error);
+  g_clear_object (&data->print);
+  g_clear_object (&data->match);
+
+  g_debug ("Multi-finger verification advanced to print %u of %u",
+           data->multi_stage + 1, data->multi_prints->len);
+
+  return TRUE;
+}
+
 /**
  * fpi_device_get_identify_data:
  * @device: The #FpDevice
@@ -641,6 +843,59 @@ fpi_device_get_identify_data (FpDevice   *device,
     *prints = data->gallery;
 }
 
+/**
+ * fpi_device_get_identify_max_candidates:
+ * @device: The #FpDevice
+ *
+ * Get the number of ranked candidates the ongoing identify operation
+ * asked for, see fp_device_identify_full(). Zero means the caller only
+ * wants the conventional best match and the matcher is free to stop at
+ * the first template above the threshold.
+ *
+ * Returns: The requested candidate count, or 0
+ */
+guint
+fpi_device_get_identify_max_candidates (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpMatchData *data;
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), 0);
+  g_return_val_if_fail (priv->current_action == FPI_DEVICE_ACTION_IDENTIFY, 0);
+
+  data = g_task_get_task_data (priv->current_task);
+  g_assert (data);
+
+  return data->max_candidates;
+}
+
+/**
+ * fpi_device_identify_report_candidates:
+ * @device: The #FpDevice
+ * @candidates: (transfer full) (element-type FpIdentifyCandidate): The ranked candidates
+ *
+ * Report the ranked candidate list of an identify operation that asked
+ * for one, to be returned from fp_device_identify_full_finish(). Call
+ * this before fpi_device_identify_report(); reporting a retry error
+ * discards the list so a later attempt starts clean.
+ */
+void
+fpi_device_identify_report_candidates (FpDevice  *device,
+                                       GPtrArray *candidates)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpMatchData *data;
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (priv->current_action == FPI_DEVICE_ACTION_IDENTIFY);
+
+  data = g_task_get_task_data (priv->current_task);
+  g_assert (data);
+
+  g_clear_pointer (&data->candidates, g_ptr_array_unref);
+  data->candidates = candidates;
+}
+
 /**
  * fpi_device_get_delete_data:
  * @device: The #FpDevice
@@ -921,7 +1176,7 @@ fpi_device_critical_leave (FpDevice *device)
   g_source_set_name (priv->critical_section_flush_source,
                      "Flush libfprint driver critical section");
   g_source_attach (priv->critical_section_flush_source,
-                   g_task_get_context (priv->current_task));
+                   fpi_device_get_driver_context (device));
   g_source_unref (priv->critical_section_flush_source);
 }
 
@@ -976,11 +1231,14 @@ fp_device_task_return_in_idle_cb (gpointer user_data)
 
   action_str = g_enum_to_string (FPI_TYPE_DEVICE_ACTION, priv->current_action);
   g_debug ("Completing action %s in idle!", action_str);
+  fpi_trace_span_end ("action %s", action_str);
 
   task = g_steal_pointer (&priv->current_task);
   action = priv->current_action;
   priv->current_action = FPI_DEVICE_ACTION_NONE;
   priv->current_task_idle_return_source = NULL;
+  priv->current_op_background = FALSE;
+  priv->preempt_requested = FALSE;
   g_clear_object (&priv->current_cancellable);
   cancellation_reason = g_steal_pointer (&priv->current_cancellation_reason);
 
@@ -1014,6 +1272,8 @@ fp_device_task_return_in_idle_cb (gpointer user_data)
       /* NOTE: The removed signal will be emitted from the GTask
        *       notify::completed if that is necessary. */
 
+      fpi_device_pump_op_queue (data->device);
+
       return G_SOURCE_REMOVE;
     }
 
@@ -1056,6 +1316,9 @@ fp_device_task_return_in_idle_cb (gpointer user_data)
       g_assert_not_reached ();
     }
 
+  /* The device is free again; start a queued operation, if any. */
+  fpi_device_pump_op_queue (data->device);
+
   return G_SOURCE_REMOVE;
 }
 
@@ -1164,6 +1427,35 @@ fpi_device_probe_complete (FpDevice    *device,
     }
 }
 
+/**
+ * fpi_device_set_probe_result:
+ * @device: The #FpDevice
+ * @device_id: Unique ID for the device
+ * @device_name: (nullable): Human readable name or %NULL for driver name
+ *
+ * Provide a probe result for @device before it is initialized. This is
+ * used by #FpContext to restore a previously cached probe result, in
+ * which case initialization completes with the given values instead of
+ * calling the driver's probe vfunc (which usually needs to open the
+ * device and do I/O).
+ */
+void
+fpi_device_set_probe_result (FpDevice    *device,
+                             const gchar *device_id,
+                             const gchar *device_name)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (priv->current_task == NULL);
+  g_return_if_fail (device_id != NULL);
+
+  g_clear_pointer (&priv->probe_cached_id, g_free);
+  g_clear_pointer (&priv->probe_cached_name, g_free);
+  priv->probe_cached_id = g_strdup (device_id);
+  priv->probe_cached_name = g_strdup (device_name);
+}
+
 /**
  * fpi_device_open_complete:
  * @device: The #FpDevice
@@ -1478,12 +1770,30 @@ fpi_device_capture_complete (FpDevice *device,
     }
 }
 
+/* Invoke the driver's delete vfunc for the next print of a batch
+ * deletion from an idle, so the driver is not re-entered from within
+ * its own completion path. */
+static gboolean
+fp_device_delete_next_in_idle_cb (gpointer user_data)
+{
+  FpDevice *device = user_data;
+  FpDeviceClass *cls = FP_DEVICE_GET_CLASS (device);
+
+  cls->delete (device);
+
+  return G_SOURCE_REMOVE;
+}
+
 /**
  * fpi_device_delete_complete:
  * @device: The #FpDevice
  * @error: The #GError or %NULL on success
  *
  * Finish an ongoing delete operation.
+ *
+ * During a batch deletion started with fp_device_delete_prints() this
+ * re-arms the delete vfunc with the next print instead of completing,
+ * until the whole batch has been deleted or a print failed.
  */
 void
 fpi_device_delete_complete (FpDevice *device,
@@ -1496,6 +1806,30 @@ fpi_device_delete_complete (FpDevice *device,
 
   g_debug ("Device reported deletion completion");
 
+  if (!error && priv->delete_prints &&
+      priv->delete_stage + 1 < priv->delete_prints->len)
+    {
+      GSource *source;
+      FpPrint *next;
+
+      priv->delete_stage++;
+      next = g_ptr_array_index (priv->delete_prints, priv->delete_stage);
+      g_task_set_task_data (priv->current_task,
+                            g_object_ref (next), g_object_unref);
+
+      source = g_idle_source_new ();
+      g_source_set_callback (source,
+                             fp_device_delete_next_in_idle_cb,
+                             g_object_ref (device),
+                             g_object_unref);
+      g_source_attach (source, fpi_device_get_driver_context (device));
+      g_source_unref (source);
+      return;
+    }
+
+  g_clear_pointer (&priv->delete_prints, g_ptr_array_unref);
+  priv->delete_stage = 0;
+
   clear_device_cancel_action (device);
   fpi_device_report_finger_status (device, FP_FINGER_STATUS_NONE);
 
@@ -1506,13 +1840,61 @@ fpi_device_delete_complete (FpDevice *device,
     fpi_device_return_task_in_idle (device, FP_DEVICE_TASK_RETURN_ERROR, error);
 }
 
+/**
+ * fpi_device_list_report:
+ * @device: The #FpDevice
+ * @prints: (element-type FpPrint) (transfer container): Array of newly listed prints
+ *
+ * Report a chunk of prints of an ongoing list operation before it
+ * completes, as soon as the corresponding protocol responses have been
+ * parsed. If the operation was started with
+ * fp_device_list_prints_full(), the chunk is handed to the caller's
+ * progress callback and released right away; otherwise it is
+ * accumulated and returned on completion, and drivers may simply pass
+ * %NULL to fpi_device_list_complete().
+ *
+ * Create the array with g_ptr_array_new_with_free_func() and
+ * g_object_unref() as free func, as for fpi_device_list_complete().
+ */
+void
+fpi_device_list_report (FpDevice  *device,
+                        GPtrArray *prints)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpListData *data;
+  guint i;
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (priv->current_action == FPI_DEVICE_ACTION_LIST);
+  g_return_if_fail (prints != NULL);
+
+  data = g_task_get_task_data (priv->current_task);
+  g_assert (data);
+
+  if (data->list_cb)
+    {
+      data->list_cb (device, prints, data->list_data);
+    }
+  else
+    {
+      if (!data->prints)
+        data->prints = g_ptr_array_new_with_free_func (g_object_unref);
+      for (i = 0; i < prints->len; i++)
+        g_ptr_array_add (data->prints,
+                         g_object_ref (g_ptr_array_index (prints, i)));
+    }
+
+  g_ptr_array_unref (prints);
+}
+
 /**
  * fpi_device_list_complete:
  * @device: The #FpDevice
  * @prints: (element-type FpPrint) (transfer container): Possibly empty array of prints or %NULL on error
  * @error: The #GError or %NULL on success
  *
- * Finish an ongoing list operation.
+ * Finish an ongoing list operation. @prints may be %NULL on success
+ * when the prints were delivered through fpi_device_list_report().
  *
  * Please note that the @prints array will be free'ed using
  * g_ptr_array_unref() and the elements are destroyed automatically.
@@ -1531,6 +1913,22 @@ fpi_device_list_complete (FpDevice  *device,
 
   g_debug ("Device reported listing completion");
 
+  if (!prints && !error)
+    {
+      /* Prints streamed through fpi_device_list_report(): complete with
+       * the accumulated array, or an empty one if a progress callback
+       * consumed them. */
+      FpListData *data = g_task_get_task_data (priv->current_task);
+
+      if (data)
+        {
+          if (data->prints)
+            prints = g_steal_pointer (&data->prints);
+          else
+            prints = g_ptr_array_new_with_free_func (g_object_unref);
+        }
+    }
+
   clear_device_cancel_action (device);
   fpi_device_report_finger_status (device, FP_FINGER_STATUS_NONE);
 
@@ -1627,7 +2025,7 @@ fpi_device_suspend (FpDevice *device)
           if (priv->critical_section)
             priv->suspend_queued = TRUE;
           else
-            FP_DEVICE_GET_CLASS (device)->suspend (device);
+            fpi_device_invoke_driver (device, FP_DEVICE_GET_CLASS (device)->suspend);
         }
       else
         {
@@ -1672,7 +2070,7 @@ fpi_device_resume (FpDevice *device)
           if (priv->critical_section)
             priv->resume_queued = TRUE;
           else
-            FP_DEVICE_GET_CLASS (device)->resume (device);
+            fpi_device_invoke_driver (device, FP_DEVICE_GET_CLASS (device)->resume);
         }
       else
         {
@@ -1846,6 +2244,9 @@ fpi_device_resume_complete (FpDevice *device,
     g_task_return_error (g_steal_pointer (&priv->suspend_resume_task), error);
   else
     g_task_return_boolean (g_steal_pointer (&priv->suspend_resume_task), TRUE);
+
+  /* Operations queued before the suspend can run again now. */
+  fpi_device_pump_op_queue (device);
 }
 
 /**
@@ -1949,7 +2350,18 @@ fpi_device_verify_report (FpDevice      *device,
 
   g_return_if_fail (FP_IS_DEVICE (device));
   g_return_if_fail (priv->current_action == FPI_DEVICE_ACTION_VERIFY);
-  g_return_if_fail (data->result_reported == FALSE);
+  /* Only a retryable result may be reported more than once: with
+   * resume-on-retry the operation keeps running and a later report
+   * replaces the earlier retry. */
+  g_return_if_fail (data->result_reported == FALSE ||
+                    (data->error != NULL && data->error->domain == FP_DEVICE_RETRY));
+
+  if (data->result_reported)
+    {
+      g_clear_error (&data->error);
+      g_clear_object (&data->print);
+      g_clear_object (&data->match);
+    }
 
   data->result_reported = TRUE;
 
@@ -2021,7 +2433,16 @@ fpi_device_identify_report (FpDevice *device,
 
   g_return_if_fail (FP_IS_DEVICE (device));
   g_return_if_fail (priv->current_action == FPI_DEVICE_ACTION_IDENTIFY);
-  g_return_if_fail (data->result_reported == FALSE);
+  /* As for verify, a retry report may be superseded by a later one. */
+  g_return_if_fail (data->result_reported == FALSE ||
+                    (data->error != NULL && data->error->domain == FP_DEVICE_RETRY));
+
+  if (data->result_reported)
+    {
+      g_clear_error (&data->error);
+      g_clear_object (&data->print);
+      g_clear_object (&data->match);
+    }
 
   data->result_reported = TRUE;
 
@@ -2055,6 +2476,10 @@ fpi_device_identify_report (FpDevice *device,
 
       data->error = error;
 
+      /* A retryable scan produced no usable ranking; drop any stale
+       * candidate list so a later attempt starts clean. */
+      g_clear_pointer (&data->candidates, g_ptr_array_unref);
+
       if (error->domain != FP_DEVICE_RETRY)
         {
           g_warning ("Driver reported a verify error that was not in the retry domain, delaying report!");
@@ -2238,19 +2663,46 @@ fpi_device_update_temp (FpDevice *device, gboolean is_active)
 
   g_clear_pointer (&priv->temp_timeout, g_source_destroy);
 
-  if (next_threshold < 0)
-    return;
+  if (next_threshold >= 0)
+    {
+      /* Set passed_seconds to the time until the next update is needed */
+      if (is_active)
+        passed_seconds = -priv->temp_hot_seconds * log ((next_threshold - 1.0) / (priv->temp_current_ratio - 1.0));
+      else
+        passed_seconds = -priv->temp_cold_seconds * log (next_threshold / priv->temp_current_ratio);
 
-  /* Set passed_seconds to the time until the next update is needed */
-  if (is_active)
-    passed_seconds = -priv->temp_hot_seconds * log ((next_threshold - 1.0) / (priv->temp_current_ratio - 1.0));
-  else
-    passed_seconds = -priv->temp_cold_seconds * log (next_threshold / priv->temp_current_ratio);
+      passed_seconds += TEMP_DELAY_SECONDS;
+
+      priv->temp_timeout = fpi_device_add_timeout (device,
+                                                   passed_seconds * 1000,
+                                                   update_temp_timeout,
+                                                   NULL, NULL);
+    }
+
+  /* A downward transition may unblock maintenance operations deferred
+   * by the thermal throttling policy. */
+  if (priv->temp_throttle && priv->temp_current < old_temp)
+    fpi_device_pump_op_queue (device);
+}
+
+/**
+ * fpi_device_should_throttle:
+ * @device: The #FpDevice
+ *
+ * Whether the driver should lower its duty cycle because thermal
+ * throttling is enabled and the device is no longer cold. Drivers that
+ * poll for finger presence in a timed loop can use this to stretch the
+ * polling interval before the temperature model reaches
+ * %FP_TEMPERATURE_HOT. See fp_device_set_thermal_throttling().
+ *
+ * Returns: %TRUE when the driver should throttle
+ */
+gboolean
+fpi_device_should_throttle (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
 
-  passed_seconds += TEMP_DELAY_SECONDS;
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
 
-  priv->temp_timeout = fpi_device_add_timeout (device,
-                                               passed_seconds * 1000,
-                                               update_temp_timeout,
-                                               NULL, NULL);
+  return priv->temp_throttle && priv->temp_current != FP_TEMPERATURE_COLD;
 }
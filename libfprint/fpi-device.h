@@ -239,15 +239,24 @@ GError * fpi_device_error_new_msg (FpDeviceError error,
 
 guint64 fpi_device_get_driver_data (FpDevice *device);
 
+void fpi_device_set_driver_snapshot (FpDevice *device,
+                                     GVariant *snapshot);
+GVariant * fpi_device_get_driver_snapshot (FpDevice *device);
+
 void fpi_device_get_enroll_data (FpDevice *device,
                                  FpPrint **print);
+GPtrArray *fpi_device_get_enroll_duplicates_gallery (FpDevice *device);
+gboolean fpi_device_get_resume_on_retry (FpDevice *device);
 
 void fpi_device_get_capture_data (FpDevice *device,
                                   gboolean *wait_for_finger);
 void fpi_device_get_verify_data (FpDevice *device,
                                  FpPrint **print);
+gboolean fpi_device_verify_has_next_stage (FpDevice *device);
+gboolean fpi_device_verify_advance_stage (FpDevice *device);
 void fpi_device_get_identify_data (FpDevice   *device,
                                    GPtrArray **prints);
+guint fpi_device_get_identify_max_candidates (FpDevice *device);
 void fpi_device_get_delete_data (FpDevice *device,
                                  FpPrint **print);
 GCancellable *fpi_device_get_cancellable (FpDevice *device);
@@ -280,6 +289,9 @@ void fpi_device_probe_complete (FpDevice    *device,
                                 const gchar *device_id,
                                 const gchar *device_name,
                                 GError      *error);
+void fpi_device_set_probe_result (FpDevice    *device,
+                                  const gchar *device_id,
+                                  const gchar *device_name);
 void fpi_device_open_complete (FpDevice *device,
                                GError   *error);
 void fpi_device_close_complete (FpDevice *device,
@@ -296,6 +308,8 @@ void fpi_device_capture_complete (FpDevice *device,
                                   GError   *error);
 void fpi_device_delete_complete (FpDevice *device,
                                  GError   *error);
+void fpi_device_list_report (FpDevice  *device,
+                             GPtrArray *prints);
 void fpi_device_list_complete (FpDevice  *device,
                                GPtrArray *prints,
                                GError    *error);
@@ -318,7 +332,10 @@ void fpi_device_identify_report (FpDevice *device,
                                  FpPrint  *match,
                                  FpPrint  *print,
                                  GError   *error);
+void fpi_device_identify_report_candidates (FpDevice  *device,
+                                            GPtrArray *candidates);
 
+gboolean fpi_device_should_throttle (FpDevice *device);
 gboolean fpi_device_report_finger_status (FpDevice           *device,
                                           FpFingerStatusFlags finger_status);
 gboolean fpi_device_report_finger_status_changes (FpDevice           *device,
@@ -20,9 +20,13 @@
 #define FP_COMPONENT "image_device"
 #include "fpi-log.h"
 
+#include "fp-device-private.h"
 #include "fp-image-device-private.h"
+#include "fpi-trace.h"
 #include "fp-image-device.h"
 
+#include <nbis.h>
+
 /**
  * SECTION: fpi-image-device
  * @title: Internal FpImageDevice
@@ -31,6 +35,12 @@
  * Internal image device functions. See #FpImageDevice for public routines.
  */
 
+/* Frames scoring below this in fp_image_get_quality_score() are
+ * rejected as a retry without running minutiae detection. Deliberately
+ * conservative: marginal frames still get the full pipeline, only
+ * obvious garbage (empty or smudged sensor) is filtered. */
+#define MIN_FRAME_QUALITY_SCORE 10
+
 /* Manually redefine what G_DEFINE_* macro does */
 static inline gpointer
 fp_image_device_get_instance_private (FpImageDevice *self)
@@ -124,6 +134,7 @@ fp_image_device_change_state (FpImageDevice *self, FpiImageDeviceState state)
   state_str = g_enum_to_string (FPI_TYPE_IMAGE_DEVICE_STATE, state);
   fp_dbg ("Image device internal state change from %s to %s",
           prev_state_str, state_str);
+  fpi_trace_mark ("image-device state %s", state_str);
 
   for (i = 0; i < G_N_ELEMENTS (valid_transitions); i++)
     {
@@ -155,6 +166,43 @@ fp_image_device_change_state (FpImageDevice *self, FpiImageDeviceState state)
     }
 }
 
+/* Adaptive enrollment, enabled per driver through
+ * FpImageDeviceClass::enroll_convergence: complete early once a new
+ * scan matches the accumulated template at ENROLL_CONVERGENCE_FACTOR
+ * times the bz3 verify threshold, provided at least
+ * ENROLL_CONVERGENCE_MIN_STAGES scans were taken so the template
+ * covers more than one placement. */
+#define ENROLL_CONVERGENCE_MIN_STAGES 3
+#define ENROLL_CONVERGENCE_FACTOR 3
+
+/* Decide whether an enroll stage may keep its raw frame. The first
+ * ENROLL_RAW_FRAMES_KEPT stages are admitted unconditionally; later
+ * stages are admitted only if they score better than the worst frame
+ * admitted so far, whose budget slot they then take over. Admission
+ * only: frames already handed out to the application are not retracted. */
+static gboolean
+fp_image_device_enroll_keep_raw (FpImageDevice *self, guint quality)
+{
+  FpImageDevicePrivate *priv = fp_image_device_get_instance_private (self);
+  guint min_idx = 0, i;
+
+  if (priv->enroll_kept_count < ENROLL_RAW_FRAMES_KEPT)
+    {
+      priv->enroll_kept_quality[priv->enroll_kept_count++] = quality;
+      return TRUE;
+    }
+
+  for (i = 1; i < ENROLL_RAW_FRAMES_KEPT; i++)
+    if (priv->enroll_kept_quality[i] < priv->enroll_kept_quality[min_idx])
+      min_idx = i;
+
+  if (quality <= priv->enroll_kept_quality[min_idx])
+    return FALSE;
+
+  priv->enroll_kept_quality[min_idx] = quality;
+  return TRUE;
+}
+
 static void
 fp_image_device_enroll_maybe_await_finger_on (FpImageDevice *self)
 {
@@ -168,6 +216,27 @@ fp_image_device_enroll_maybe_await_finger_on (FpImageDevice *self)
   fp_image_device_change_state (self, FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON);
 }
 
+/* A retryable error was reported with resume-on-retry set (see
+ * fp_device_set_resume_on_retry()): accept the next swipe within the
+ * same activation. Waits for the current finger to leave the sensor
+ * first, then arms it again. */
+static void
+fp_image_device_retry_resume (FpImageDevice *self)
+{
+  FpImageDevicePrivate *priv = fp_image_device_get_instance_private (self);
+
+  if (priv->finger_present)
+    {
+      priv->retry_pending = TRUE;
+      if (priv->state != FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_OFF)
+        fp_image_device_change_state (self, FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_OFF);
+    }
+  else if (priv->state != FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON)
+    {
+      fp_image_device_change_state (self, FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON);
+    }
+}
+
 static void
 fp_image_device_maybe_complete_action (FpImageDevice *self, GError *error)
 {
@@ -190,10 +259,15 @@ fp_image_device_maybe_complete_action (FpImageDevice *self, GError *error)
         }
     }
 
-  /* Do not complete if the device is still active or a minutiae scan is pending. */
-  if (priv->active || priv->minutiae_scan_active)
+  /* Do not complete if the device is still active or a minutiae scan or
+   * match is pending. */
+  if (priv->active || priv->minutiae_scan_active || priv->match_active)
     return;
 
+  /* All scans of this action are done; the detection session (if any)
+   * must not leak into the next action. */
+  g_clear_pointer (&priv->minutiae_session, (GDestroyNotify) lfs_session_free);
+
   if (!priv->action_error)
     g_cancellable_set_error_if_cancelled (fpi_device_get_cancellable (device), &priv->action_error);
 
@@ -212,6 +286,9 @@ fp_image_device_maybe_complete_action (FpImageDevice *self, GError *error)
       FpPrint *enroll_print;
       fpi_device_get_enroll_data (device, &enroll_print);
 
+      /* Drop redundant views before the template is handed out. */
+      fpi_print_consolidate (enroll_print);
+
       fpi_device_enroll_complete (device, g_object_ref (enroll_print), NULL);
     }
   else if (action == FPI_DEVICE_ACTION_VERIFY)
@@ -232,6 +309,236 @@ fp_image_device_maybe_complete_action (FpImageDevice *self, GError *error)
     }
 }
 
+typedef struct
+{
+  FpImage         *image;
+  FpiDeviceAction  action;
+  FpPrint         *template;  /* verify */
+  GPtrArray       *templates; /* identify */
+  gint             bz3_threshold;
+  guint            max_candidates; /* ranked identify */
+} FpImageDeviceMatchData;
+
+typedef struct
+{
+  FpPrint        *print;
+  FpPrint        *matched;
+  GPtrArray      *candidates; /* ranked identify */
+  FpiMatchResult  result;
+  GError         *error;
+} FpImageDeviceMatchResult;
+
+static void
+fp_image_device_match_data_free (FpImageDeviceMatchData *data)
+{
+  g_clear_object (&data->image);
+  g_clear_object (&data->template);
+  g_clear_pointer (&data->templates, g_ptr_array_unref);
+  g_free (data);
+}
+
+static void
+fp_image_device_match_result_free (FpImageDeviceMatchResult *result)
+{
+  g_clear_object (&result->print);
+  g_clear_pointer (&result->candidates, g_ptr_array_unref);
+  g_clear_error (&result->error);
+  g_free (result);
+}
+
+static void
+fp_image_device_match_thread (GTask        *task,
+                              gpointer      source_object,
+                              gpointer      task_data,
+                              GCancellable *cancellable)
+{
+  FpImageDevice *self = FP_IMAGE_DEVICE (source_object);
+  FpImageDeviceMatchData *data = task_data;
+  g_autoptr(FpPrint) print = NULL;
+  FpImageDeviceMatchResult *result;
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  print = fp_print_new (FP_DEVICE (self));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+  if (!fpi_print_add_from_image (print, data->image, &error))
+    {
+      g_clear_object (&print);
+
+      if (error->domain != FP_DEVICE_RETRY)
+        {
+          g_task_return_error (task, error);
+          return;
+        }
+    }
+
+  result = g_new0 (FpImageDeviceMatchResult, 1);
+  result->error = error;
+
+  if (!print)
+    result->result = FPI_MATCH_ERROR;
+  else if (data->action == FPI_DEVICE_ACTION_VERIFY)
+    result->result = fpi_print_bz3_match (data->template, print,
+                                          data->bz3_threshold,
+                                          &result->error);
+  else if (data->max_candidates)
+    {
+      result->candidates = fpi_print_bz3_rank_gallery (data->templates, print,
+                                                       data->bz3_threshold,
+                                                       data->max_candidates,
+                                                       &result->matched,
+                                                       &result->error);
+      if (!result->candidates)
+        result->result = FPI_MATCH_ERROR;
+      else
+        result->result = result->matched ? FPI_MATCH_SUCCESS : FPI_MATCH_FAIL;
+    }
+  else
+    result->result = fpi_print_bz3_match_gallery (data->templates, print,
+                                                  data->bz3_threshold,
+                                                  &result->matched,
+                                                  &result->error);
+
+  result->print = g_steal_pointer (&print);
+  g_task_return_pointer (task, result,
+                         (GDestroyNotify) fp_image_device_match_result_free);
+}
+
+static void
+fpi_image_device_match_done (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FpImageDevice *self = FP_IMAGE_DEVICE (source_object);
+  FpDevice *device = FP_DEVICE (self);
+  FpImageDevicePrivate *priv;
+  FpImageDeviceMatchResult *result = NULL;
+  FpiDeviceAction action;
+  GError *error = NULL;
+  gboolean was_retry;
+  gboolean deferred_deactivate;
+
+  priv = fp_image_device_get_instance_private (self);
+  priv->match_active = FALSE;
+
+  deferred_deactivate = fpi_device_get_resume_on_retry (device) ||
+                        (fpi_device_get_current_action (device) == FPI_DEVICE_ACTION_VERIFY &&
+                         fpi_device_verify_has_next_stage (device));
+
+  result = g_task_propagate_pointer (G_TASK (res), &error);
+  if (!result)
+    {
+      /* Cancellation or a fatal error creating the scanned print. */
+      fpi_device_stats_match_aborted (device);
+      fp_image_device_maybe_complete_action (self, g_steal_pointer (&error));
+      fpi_image_device_deactivate (self, TRUE);
+      return;
+    }
+
+  if (result->result == FPI_MATCH_ERROR)
+    fpi_device_stats_match_aborted (device);
+
+  action = fpi_device_get_current_action (device);
+  was_retry = result->error && result->error->domain == FP_DEVICE_RETRY;
+
+  if (action == FPI_DEVICE_ACTION_VERIFY)
+    {
+      if (!result->error || result->error->domain == FP_DEVICE_RETRY)
+        fpi_device_verify_report (device, result->result,
+                                  g_steal_pointer (&result->print),
+                                  g_steal_pointer (&result->error));
+    }
+  else if (action == FPI_DEVICE_ACTION_IDENTIFY)
+    {
+      if (!result->error || result->error->domain == FP_DEVICE_RETRY)
+        {
+          if (result->candidates)
+            fpi_device_identify_report_candidates (device,
+                                                   g_steal_pointer (&result->candidates));
+          fpi_device_identify_report (device, result->matched,
+                                      g_steal_pointer (&result->print),
+                                      g_steal_pointer (&result->error));
+        }
+    }
+  else
+    {
+      g_assert_not_reached ();
+    }
+
+  if (action == FPI_DEVICE_ACTION_VERIFY &&
+      result->result == FPI_MATCH_SUCCESS &&
+      fpi_device_verify_advance_stage (device))
+    {
+      /* Multi-finger verification: this finger passed, arm the sensor
+       * for the next one instead of completing. */
+      fp_image_device_retry_resume (self);
+      fp_image_device_match_result_free (result);
+      return;
+    }
+
+  if (was_retry && fpi_device_get_resume_on_retry (device))
+    {
+      /* The operation keeps running; arm the sensor for the next
+       * attempt instead of completing with the retry error. */
+      fp_image_device_retry_resume (self);
+      fp_image_device_match_result_free (result);
+      return;
+    }
+
+  fp_image_device_maybe_complete_action (self, g_steal_pointer (&result->error));
+
+  /* When the finger-off handling deferred the deactivation decision
+   * to us (resume-on-retry or a pending multi-finger stage), the
+   * result is conclusive, so deactivate now if the finger is gone. */
+  if (deferred_deactivate && !priv->finger_present)
+    fpi_image_device_deactivate (self, FALSE);
+
+  fp_image_device_match_result_free (result);
+}
+
+/* Pipeline the scanned print creation and matching with the device
+ * returning to AWAIT_FINGER_OFF: on swipe sensors the finger leaves the
+ * sensor long before bozorth3 finishes, so running the match on the main
+ * loop would add its full cost to the perceived verify latency. */
+static void
+fp_image_device_match_in_thread (FpImageDevice *self, FpImage *image)
+{
+  FpImageDevicePrivate *priv = fp_image_device_get_instance_private (self);
+  FpDevice *device = FP_DEVICE (self);
+  FpImageDeviceMatchData *data;
+  g_autoptr(GTask) task = NULL;
+
+  data = g_new0 (FpImageDeviceMatchData, 1);
+  data->image = g_object_ref (image);
+  data->action = fpi_device_get_current_action (device);
+  data->bz3_threshold = priv->bz3_threshold;
+
+  if (data->action == FPI_DEVICE_ACTION_VERIFY)
+    {
+      FpPrint *template;
+
+      fpi_device_get_verify_data (device, &template);
+      data->template = g_object_ref (template);
+    }
+  else
+    {
+      GPtrArray *templates;
+
+      fpi_device_get_identify_data (device, &templates);
+      data->templates = g_ptr_array_ref (templates);
+      data->max_candidates = fpi_device_get_identify_max_candidates (device);
+    }
+
+  priv->match_active = TRUE;
+  fpi_device_stats_match_attempted (device);
+
+  task = g_task_new (self, fpi_device_get_cancellable (device),
+                     fpi_image_device_match_done, NULL);
+  g_task_set_task_data (task, data,
+                        (GDestroyNotify) fp_image_device_match_data_free);
+  g_task_run_in_thread (task, fp_image_device_match_thread);
+}
+
 static void
 fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
@@ -273,6 +580,16 @@ fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, g
       return;
     }
 
+  /* Verify and identify continue in a worker thread, overlapping the match
+   * with the finger-off handling below. */
+  if (!error &&
+      (action == FPI_DEVICE_ACTION_VERIFY ||
+       action == FPI_DEVICE_ACTION_IDENTIFY))
+    {
+      fp_image_device_match_in_thread (self, image);
+      return;
+    }
+
   if (!error)
     {
       print = fp_print_new (device);
@@ -298,8 +615,59 @@ fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, g
 
       if (print)
         {
+          GPtrArray *dup_gallery = fpi_device_get_enroll_duplicates_gallery (device);
+          gboolean converged = FALSE;
+
+          /* Screen good scans against the application's gallery so that
+           * re-enrolling an already enrolled finger fails at the first
+           * stage, without a per-stage identify over all templates. */
+          if (dup_gallery &&
+              fpi_print_bz3_find_duplicate (dup_gallery, print,
+                                            priv->bz3_threshold))
+            {
+              g_clear_object (&print);
+              fp_image_device_maybe_complete_action (self,
+                                                     fpi_device_error_new (FP_DEVICE_ERROR_DATA_DUPLICATE));
+              fpi_image_device_deactivate (self, TRUE);
+              return;
+            }
+
+          /* For drivers that opted in, finish early once the template
+           * has converged: if the new scan matches the accumulated
+           * views far above the verify threshold, further stages would
+           * only add redundant views that fpi_print_consolidate()
+           * drops again anyway. Drivers with a fixed stage count, and
+           * frontends scripted around it (the virtual drivers' tests
+           * included), keep the full nr_enroll_stages run. */
+          if (FP_IMAGE_DEVICE_GET_CLASS (self)->enroll_convergence &&
+              priv->enroll_stage + 1 >= ENROLL_CONVERGENCE_MIN_STAGES &&
+              priv->enroll_stage + 1 < fp_device_get_nr_enroll_stages (device))
+            {
+              g_autoptr(GError) conv_error = NULL;
+
+              converged =
+                fpi_print_bz3_match (enroll_print, print,
+                                     priv->bz3_threshold * ENROLL_CONVERGENCE_FACTOR,
+                                     &conv_error) == FPI_MATCH_SUCCESS;
+            }
+
           fpi_print_add_print (enroll_print, print);
           priv->enroll_stage += 1;
+
+          /* The template holds minutiae only; the raw frame is attached
+           * to the stage print purely for fp_print_get_image(). Keep
+           * the pixel data of the best few frames and drop the rest so
+           * enrollment peak memory stays constant regardless of the
+           * stage and retry count. */
+          if (!fp_image_device_enroll_keep_raw (self, fp_image_get_quality_score (image)))
+            fpi_print_drop_image (print);
+
+          if (converged)
+            {
+              fp_dbg ("Template converged after %d stages, completing enrollment early",
+                      priv->enroll_stage);
+              priv->enroll_stage = fp_device_get_nr_enroll_stages (device);
+            }
         }
 
       fpi_device_enroll_progress (device, priv->enroll_stage,
@@ -327,27 +695,54 @@ fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, g
       else
         result = FPI_MATCH_ERROR;
 
+      if (error && error->domain == FP_DEVICE_RETRY &&
+          fpi_device_get_resume_on_retry (device))
+        {
+          fpi_device_verify_report (device, result, g_steal_pointer (&print), g_steal_pointer (&error));
+          fp_image_device_retry_resume (self);
+          return;
+        }
+
       if (!error || error->domain == FP_DEVICE_RETRY)
         fpi_device_verify_report (device, result, g_steal_pointer (&print), g_steal_pointer (&error));
 
+      if (result == FPI_MATCH_SUCCESS && fpi_device_verify_advance_stage (device))
+        {
+          /* Multi-finger verification: arm for the next finger. */
+          fp_image_device_retry_resume (self);
+          return;
+        }
+
       fp_image_device_maybe_complete_action (self, g_steal_pointer (&error));
     }
   else if (action == FPI_DEVICE_ACTION_IDENTIFY)
     {
-      gint i;
       GPtrArray *templates;
       FpPrint *result = NULL;
+      guint max_candidates = fpi_device_get_identify_max_candidates (device);
 
       fpi_device_get_identify_data (device, &templates);
-      for (i = 0; !error && i < templates->len; i++)
+      if (print && max_candidates)
         {
-          FpPrint *template = g_ptr_array_index (templates, i);
+          GPtrArray *candidates;
+
+          candidates = fpi_print_bz3_rank_gallery (templates, print,
+                                                   priv->bz3_threshold,
+                                                   max_candidates, &result,
+                                                   &error);
+          if (candidates)
+            fpi_device_identify_report_candidates (device, candidates);
+        }
+      else if (print)
+        fpi_print_bz3_match_gallery (templates, print, priv->bz3_threshold,
+                                     &result, &error);
 
-          if (fpi_print_bz3_match (template, print, priv->bz3_threshold, &error) == FPI_MATCH_SUCCESS)
-            {
-              result = template;
-              break;
-            }
+      if (error && error->domain == FP_DEVICE_RETRY &&
+          fpi_device_get_resume_on_retry (device))
+        {
+          fpi_device_identify_report (device, result, g_steal_pointer (&print), g_steal_pointer (&error));
+          fp_image_device_retry_resume (self);
+          return;
         }
 
       if (!error || error->domain == FP_DEVICE_RETRY)
@@ -392,6 +787,28 @@ fpi_image_device_set_bz3_threshold (FpImageDevice *self,
   priv->bz3_threshold = bz3_threshold;
 }
 
+/**
+ * fpi_image_device_get_state:
+ * @self: a #FpImageDevice imaging fingerprint device
+ *
+ * Returns the current state of the image device. This is identical to
+ * reading the #FpImageDevice:fpi-image-device-state property, without
+ * going through the GObject property machinery, so it is cheap enough
+ * for drivers to call in per-frame capture code.
+ *
+ * Returns: the current #FpiImageDeviceState
+ */
+FpiImageDeviceState
+fpi_image_device_get_state (FpImageDevice *self)
+{
+  FpImageDevicePrivate *priv = fp_image_device_get_instance_private (self);
+
+  g_return_val_if_fail (FP_IS_IMAGE_DEVICE (self),
+                        FPI_IMAGE_DEVICE_STATE_INACTIVE);
+
+  return priv->state;
+}
+
 /**
  * fpi_image_device_report_finger_status:
  * @self: a #FpImageDevice imaging fingerprint device
@@ -447,17 +864,39 @@ fpi_image_device_report_finger_status (FpImageDevice *self,
     }
   else if (!present && priv->state == FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_OFF)
     {
-      /* If we are in the non-enroll case, we always deactivate.
+      /* If we are in the non-enroll case, we always deactivate, unless
+       * resume-on-retry keeps the operation running.
        *
        * In the enroll case, the decision can only be made after minutiae
        * detection has finished.
        */
       fp_image_device_change_state (self, FPI_IMAGE_DEVICE_STATE_IDLE);
 
-      if (action != FPI_DEVICE_ACTION_ENROLL)
-        fpi_image_device_deactivate (self, FALSE);
+      if (action == FPI_DEVICE_ACTION_ENROLL)
+        {
+          fp_image_device_enroll_maybe_await_finger_on (self);
+        }
+      else if (priv->retry_pending)
+        {
+          /* A retryable error was reported; accept the next swipe
+           * right away instead of deactivating. */
+          priv->retry_pending = FALSE;
+          fp_image_device_change_state (self, FPI_IMAGE_DEVICE_STATE_AWAIT_FINGER_ON);
+        }
+      else if ((fpi_device_get_resume_on_retry (device) ||
+                (action == FPI_DEVICE_ACTION_VERIFY &&
+                 fpi_device_verify_has_next_stage (device))) &&
+               (priv->minutiae_scan_active || priv->match_active))
+        {
+          /* The scan is still being evaluated and a retryable result
+           * (or a multi-finger verification moving on to its next
+           * print) must keep the device active; defer the deactivation
+           * decision until the result is known. */
+        }
       else
-        fp_image_device_enroll_maybe_await_finger_on (self);
+        {
+          fpi_image_device_deactivate (self, FALSE);
+        }
     }
 }
 
@@ -492,8 +931,53 @@ fpi_image_device_image_captured (FpImageDevice *self, FpImage *image)
 
   g_debug ("Image device captured an image");
 
+  /* Reject frames that are obviously too poor to yield minutiae before
+   * paying for a full detection run. Capture mode hands the image to
+   * the user as-is, so it is exempt. */
+  if (action != FPI_DEVICE_ACTION_CAPTURE &&
+      fp_image_get_quality_score (image) < MIN_FRAME_QUALITY_SCORE)
+    {
+      g_debug ("Frame quality %u below threshold %d, requesting retry",
+               fp_image_get_quality_score (image), MIN_FRAME_QUALITY_SCORE);
+      fpi_device_stats_frame_captured (FP_DEVICE (self), TRUE);
+      /* The image was transferred to us; free rejected frames right
+       * away so a retry loop does not accumulate them. */
+      g_object_unref (image);
+      fpi_image_device_retry_scan (self, FP_DEVICE_RETRY_GENERAL);
+      return;
+    }
+
+  fpi_device_stats_frame_captured (FP_DEVICE (self), FALSE);
+
   priv->minutiae_scan_active = TRUE;
 
+  if (FP_IMAGE_DEVICE_GET_CLASS (self)->adaptive_binarization)
+    image->flags |= FPI_IMAGE_ADAPTIVE_BINARIZATION;
+
+  if (FP_IMAGE_DEVICE_GET_CLASS (self)->clahe)
+    image->flags |= FPI_IMAGE_CLAHE;
+
+  /* Enroll captures the same finger several times; share one detection
+   * session across the stages so each scan can seed its direction map
+   * from the previous stage's result. */
+  if (action == FPI_DEVICE_ACTION_ENROLL)
+    {
+      if (!priv->minutiae_session)
+        priv->minutiae_session = lfs_session_new ();
+      image->detection_session = priv->minutiae_session;
+
+      /* The enroll template only needs the minutiae; drop each stage's
+       * binarized buffer as soon as they have been extracted. */
+      fp_image_set_retention (image, FP_IMAGE_RETENTION_MINUTIAE_ONLY);
+    }
+
+  /* Let interactive matches overtake queued background work in the
+   * detection pool. */
+  if (action == FPI_DEVICE_ACTION_VERIFY || action == FPI_DEVICE_ACTION_IDENTIFY)
+    image->detect_priority = G_PRIORITY_HIGH;
+  else if (action == FPI_DEVICE_ACTION_ENROLL)
+    image->detect_priority = G_PRIORITY_LOW;
+
   /* XXX: We also detect minutiae in capture mode, we solely do this
    *      to normalize the image which will happen as a by-product. */
   fp_image_detect_minutiae (image,
@@ -531,6 +1015,8 @@ fpi_image_device_retry_scan (FpImageDevice *self, FpDeviceRetry retry)
                     action == FPI_DEVICE_ACTION_IDENTIFY ||
                     action == FPI_DEVICE_ACTION_CAPTURE);
 
+  fpi_device_stats_retry (FP_DEVICE (self), retry);
+
   error = fpi_device_retry_new (retry);
 
   if (action == FPI_DEVICE_ACTION_ENROLL)
@@ -543,15 +1029,30 @@ fpi_image_device_retry_scan (FpImageDevice *self, FpDeviceRetry retry)
   else if (action == FPI_DEVICE_ACTION_VERIFY)
     {
       fpi_device_verify_report (FP_DEVICE (self), FPI_MATCH_ERROR, NULL, error);
-      fp_image_device_maybe_complete_action (self, NULL);
-      fpi_image_device_deactivate (self, TRUE);
-
+      if (fpi_device_get_resume_on_retry (FP_DEVICE (self)))
+        {
+          g_debug ("Reporting retry during verify, device stays armed");
+          fp_image_device_retry_resume (self);
+        }
+      else
+        {
+          fp_image_device_maybe_complete_action (self, NULL);
+          fpi_image_device_deactivate (self, TRUE);
+        }
     }
   else if (action == FPI_DEVICE_ACTION_IDENTIFY)
     {
       fpi_device_identify_report (FP_DEVICE (self), NULL, NULL, error);
-      fp_image_device_maybe_complete_action (self, NULL);
-      fpi_image_device_deactivate (self, TRUE);
+      if (fpi_device_get_resume_on_retry (FP_DEVICE (self)))
+        {
+          g_debug ("Reporting retry during identify, device stays armed");
+          fp_image_device_retry_resume (self);
+        }
+      else
+        {
+          fp_image_device_maybe_complete_action (self, NULL);
+          fpi_image_device_deactivate (self, TRUE);
+        }
     }
   else
     {
@@ -678,6 +1179,7 @@ fpi_image_device_deactivate_complete (FpImageDevice *self, GError *error)
   g_debug ("Image device deactivation completed");
 
   priv->active = FALSE;
+  priv->retry_pending = FALSE;
 
   /* Assume finger was removed. */
   priv->finger_present = FALSE;
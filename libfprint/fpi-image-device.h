@@ -107,6 +107,16 @@ struct _FpImageDeviceClass
   gint          bz3_threshold;
   gint          img_width;
   gint          img_height;
+  /* Binarize with a local-mean adaptive threshold instead of the
+   * directional ridge filter; see FPI_IMAGE_ADAPTIVE_BINARIZATION. */
+  gboolean      adaptive_binarization;
+  /* Equalize local contrast before minutiae detection; see
+   * FPI_IMAGE_CLAHE. */
+  gboolean      clahe;
+  /* Complete enrollment before nr_enroll_stages once the template has
+   * converged. Opt-in: only sensible for drivers whose stage count is
+   * the library convention rather than a hardware or UI requirement. */
+  gboolean      enroll_convergence;
 
   void          (*img_open)     (FpImageDevice *dev);
   void          (*img_close)    (FpImageDevice *dev);
@@ -119,6 +129,8 @@ struct _FpImageDeviceClass
 void fpi_image_device_set_bz3_threshold (FpImageDevice *self,
                                          gint           bz3_threshold);
 
+FpiImageDeviceState fpi_image_device_get_state (FpImageDevice *self);
+
 void fpi_image_device_session_error (FpImageDevice *self,
                                      GError        *error);
 
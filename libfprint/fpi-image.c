@@ -22,6 +22,8 @@
 
 #include "fpi-image.h"
 #include "fpi-log.h"
+#include "fpi-mem.h"
+#include "fpi-simd.h"
 
 #include <nbis.h>
 
@@ -37,6 +39,14 @@
  * Internal image handling routines. See #FpImage for public routines.
  */
 
+/* These two kernels run for every captured line while drivers poll for
+ * finger presence, so they are written to auto-vectorize: the per-block
+ * partial sums use 32-bit accumulators (per-element widening into a
+ * 64-bit accumulator defeats the vectorizer), and the block length is
+ * bounded so a block's worth of squared byte deviations (255^2 each)
+ * cannot overflow 32 bits. */
+#define PIXEL_SUM_BLOCK 4096
+
 /**
  * fpi_std_sq_dev:
  * @buf: buffer (usually bitmap, one byte per pixel)
@@ -53,27 +63,157 @@
  *
  * Returns: the squared standard deviation for @buffer
  */
-gint
+FPI_SIMD_CLONES gint
 fpi_std_sq_dev (const guint8 *buf,
                 gint          size)
 {
   guint64 res = 0, mean = 0;
-  gint i;
+  gint i, block, len;
 
-  for (i = 0; i < size; i++)
-    mean += buf[i];
+  for (block = 0; block < size; block += len)
+    {
+      guint32 part = 0;
+
+      len = MIN (size - block, PIXEL_SUM_BLOCK);
+      for (i = 0; i < len; i++)
+        part += buf[block + i];
+      mean += part;
+    }
 
   mean /= size;
 
-  for (i = 0; i < size; i++)
+  for (block = 0; block < size; block += len)
     {
-      int dev = (int) buf[i] - mean;
-      res += dev * dev;
+      guint32 part = 0;
+
+      len = MIN (size - block, PIXEL_SUM_BLOCK);
+      for (i = 0; i < len; i++)
+        {
+          gint dev = (gint) buf[block + i] - (gint) mean;
+          part += dev * dev;
+        }
+      res += part;
     }
 
   return res / size;
 }
 
+/* Block size for the cached variance state. Smaller than
+ * PIXEL_SUM_BLOCK so that background-subtracted preview frames, which
+ * are mostly runs of zeros, get fine-grained reuse; squared byte sums
+ * over a block still fit a 32-bit accumulator. */
+#define VARIANCE_CACHE_BLOCK 1024
+
+/**
+ * fpi_variance_cache_init:
+ * @cache: state to initialize
+ * @size: frame size in bytes the cache will be used with
+ *
+ * Prepare @cache for fpi_std_sq_dev_cached() calls over frames of
+ * @size bytes. The first call computes every block.
+ */
+void
+fpi_variance_cache_init (FpiVarianceCache *cache,
+                         gsize             size)
+{
+  guint n_blocks = (size + VARIANCE_CACHE_BLOCK - 1) / VARIANCE_CACHE_BLOCK;
+
+  cache->size = size;
+  cache->prev = g_malloc (size);
+  cache->block_sum = g_new0 (guint32, n_blocks);
+  cache->block_sq = g_new0 (guint32, n_blocks);
+  cache->primed = FALSE;
+
+  fpi_mem_add (FPI_MEM_SUBSYS_IMAGE,
+               size + 2 * n_blocks * sizeof (guint32));
+}
+
+/**
+ * fpi_variance_cache_clear:
+ * @cache: state to release
+ *
+ * Release the buffers held by @cache.
+ */
+void
+fpi_variance_cache_clear (FpiVarianceCache *cache)
+{
+  if (cache->prev)
+    {
+      guint n_blocks = (cache->size + VARIANCE_CACHE_BLOCK - 1) / VARIANCE_CACHE_BLOCK;
+
+      fpi_mem_sub (FPI_MEM_SUBSYS_IMAGE,
+                   cache->size + 2 * n_blocks * sizeof (guint32));
+    }
+
+  g_clear_pointer (&cache->prev, g_free);
+  g_clear_pointer (&cache->block_sum, g_free);
+  g_clear_pointer (&cache->block_sq, g_free);
+  cache->size = 0;
+  cache->primed = FALSE;
+}
+
+/**
+ * fpi_std_sq_dev_cached:
+ * @buf: buffer (usually bitmap, one byte per pixel)
+ * @size: size of @buffer
+ * @cache: state from fpi_variance_cache_init()
+ *
+ * Same result as fpi_std_sq_dev(), but per-block pixel sums are kept in
+ * @cache and blocks whose bytes are identical to the previous call are
+ * not summed again. Finger detectors running on every preview frame
+ * mostly see static background between consecutive frames, so the
+ * per-frame cost drops to a compare over the unchanged blocks.
+ *
+ * Returns: the squared standard deviation for @buffer
+ */
+FPI_SIMD_CLONES gint
+fpi_std_sq_dev_cached (const guint8     *buf,
+                       gint              size,
+                       FpiVarianceCache *cache)
+{
+  guint64 sum = 0, sq = 0, mean;
+  gint block, len;
+  guint b = 0;
+
+  if (cache == NULL || cache->prev == NULL || cache->size != (gsize) size)
+    return fpi_std_sq_dev (buf, size);
+
+  for (block = 0; block < size; block += len, b++)
+    {
+      len = MIN (size - block, VARIANCE_CACHE_BLOCK);
+
+      if (!cache->primed ||
+          memcmp (cache->prev + block, buf + block, len) != 0)
+        {
+          guint32 s = 0, q = 0;
+          gint i;
+
+          for (i = 0; i < len; i++)
+            {
+              guint32 v = buf[block + i];
+
+              s += v;
+              q += v * v;
+            }
+
+          cache->block_sum[b] = s;
+          cache->block_sq[b] = q;
+          memcpy (cache->prev + block, buf + block, len);
+        }
+
+      sum += cache->block_sum[b];
+      sq += cache->block_sq[b];
+    }
+
+  cache->primed = TRUE;
+
+  /* Expand sum ((x - mean)^2) so it only needs the cached block sums;
+   * with the same truncated integer mean this matches the two-pass
+   * computation in fpi_std_sq_dev() bit for bit. */
+  mean = sum / size;
+  return (sq - 2 * mean * sum + size * mean * mean) / size;
+}
+
 /**
  * fpi_mean_sq_diff_norm:
  * @buf1: buffer (usually bitmap, one byte per pixel)
@@ -91,58 +231,412 @@ fpi_std_sq_dev (const guint8 *buf,
  *
  * Returns: the normalized mean squared difference between @buf1 and @buf2
  */
-gint
+FPI_SIMD_CLONES gint
 fpi_mean_sq_diff_norm (const guint8 *buf1,
                        const guint8 *buf2,
                        gint          size)
 {
-  int res = 0, i;
+  guint64 res = 0;
+  gint i, block, len;
 
-  for (i = 0; i < size; i++)
+  for (block = 0; block < size; block += len)
     {
-      int dev = (int) buf1[i] - (int) buf2[i];
-      res += dev * dev;
+      guint32 part = 0;
+
+      len = MIN (size - block, PIXEL_SUM_BLOCK);
+      for (i = 0; i < len; i++)
+        {
+          gint dev = (gint) buf1[block + i] - (gint) buf2[block + i];
+          part += dev * dev;
+        }
+      res += part;
     }
 
   return res / size;
 }
 
+/**
+ * fpi_image_histogram:
+ * @buf: buffer (usually bitmap, one byte per pixel)
+ * @size: size of @buf
+ * @histogram: (array fixed-size=256): receives the count of pixels per value
+ *
+ * Count how many pixels of each value @buf contains. The counting is
+ * spread over four accumulator arrays so that runs of equal pixels (flat
+ * background) do not serialize on a single counter's store-to-load
+ * dependency; drivers should use this instead of hand-rolling per-pixel
+ * histogram loops.
+ */
+FPI_SIMD_CLONES void
+fpi_image_histogram (const guint8 *buf,
+                     gint          size,
+                     guint32       histogram[256])
+{
+  guint32 acc[4][256] = { { 0, }, };
+  gint i;
+
+  for (i = 0; i + 4 <= size; i += 4)
+    {
+      acc[0][buf[i + 0]]++;
+      acc[1][buf[i + 1]]++;
+      acc[2][buf[i + 2]]++;
+      acc[3][buf[i + 3]]++;
+    }
+  for (; i < size; i++)
+    acc[0][buf[i]]++;
+
+  for (i = 0; i < 256; i++)
+    histogram[i] = acc[0][i] + acc[1][i] + acc[2][i] + acc[3][i];
+}
+
+/**
+ * fpi_image_stretch:
+ * @buf: buffer (usually bitmap, one byte per pixel), modified in place
+ * @size: size of @buf
+ * @low: pixel value mapped to 0
+ * @high: pixel value mapped to 255
+ *
+ * Linearly stretch the pixel range [@low, @high] to the full [0, 255]
+ * range, clamping values outside it. The mapping is built once as a
+ * 256-entry lookup table and then applied per pixel, which vectorizes
+ * well and costs the same no matter how the cut points were chosen
+ * (typically from percentiles of a fpi_image_histogram() result).
+ *
+ * Does nothing if @high is not greater than @low.
+ */
+FPI_SIMD_CLONES void
+fpi_image_stretch (guint8 *buf,
+                   gint    size,
+                   guint8  low,
+                   guint8  high)
+{
+  guint8 lut[256];
+  gint i;
+
+  if (high <= low)
+    return;
+
+  for (i = 0; i < 256; i++)
+    {
+      if (i <= low)
+        lut[i] = 0;
+      else if (i >= high)
+        lut[i] = 255;
+      else
+        lut[i] = ((i - low) * 255) / (high - low);
+    }
+
+  for (i = 0; i < size; i++)
+    buf[i] = lut[buf[i]];
+}
+
+/* CLAHE tile geometry and clip limit. 64 px tiles are small enough to
+ * follow local lighting across the aged optical sensors this targets
+ * while still holding enough pixels (4096) for a stable histogram; the
+ * clip limit caps each bin at this multiple of the flat distribution,
+ * which bounds how much near-uniform (dry, low-contrast) areas can
+ * amplify noise. */
+#define CLAHE_TILE_SIZE 64
+#define CLAHE_CLIP_LIMIT 3
+
+/**
+ * fpi_image_clahe:
+ * @buf: buffer (usually bitmap, one byte per pixel), modified in place
+ * @width: width of the image
+ * @height: height of the image
+ *
+ * Contrast-limited adaptive histogram equalization: the image is split
+ * into tiles, each tile gets its own clipped equalization mapping, and
+ * every pixel is remapped through a bilinear blend of the four
+ * surrounding tile mappings so tile borders stay invisible. Used via
+ * %FPI_IMAGE_CLAHE to recover ridge contrast on marginal (typically
+ * dry-finger) captures before minutiae detection.
+ */
+FPI_SIMD_CLONES void
+fpi_image_clahe (guint8 *buf,
+                 gint    width,
+                 gint    height)
+{
+  g_autofree guint8 *luts = NULL;
+  gint tiles_x, tiles_y;
+  gint tx, ty;
+  gint x, y;
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  tiles_x = MAX (1, (width + CLAHE_TILE_SIZE / 2) / CLAHE_TILE_SIZE);
+  tiles_y = MAX (1, (height + CLAHE_TILE_SIZE / 2) / CLAHE_TILE_SIZE);
+  luts = g_malloc (tiles_x * tiles_y * 256);
+
+  for (ty = 0; ty < tiles_y; ty++)
+    {
+      for (tx = 0; tx < tiles_x; tx++)
+        {
+          guint32 hist[256] = { 0, };
+          guint8 *lut = luts + (ty * tiles_x + tx) * 256;
+          gint x0 = tx * width / tiles_x;
+          gint x1 = (tx + 1) * width / tiles_x;
+          gint y0 = ty * height / tiles_y;
+          gint y1 = (ty + 1) * height / tiles_y;
+          guint32 npix = (x1 - x0) * (y1 - y0);
+          guint32 clip, excess = 0, cdf = 0;
+          gint i;
+
+          for (y = y0; y < y1; y++)
+            {
+              const guint8 *row = buf + y * width;
+
+              for (x = x0; x < x1; x++)
+                hist[row[x]]++;
+            }
+
+          /* Clip the histogram and spread the excess evenly; this is
+           * what keeps flat areas from exploding into noise. */
+          clip = MAX (1, CLAHE_CLIP_LIMIT * npix / 256);
+          for (i = 0; i < 256; i++)
+            {
+              if (hist[i] > clip)
+                {
+                  excess += hist[i] - clip;
+                  hist[i] = clip;
+                }
+            }
+          for (i = 0; i < 256; i++)
+            hist[i] += excess / 256;
+
+          for (i = 0; i < 256; i++)
+            {
+              cdf += hist[i];
+              lut[i] = (255 * cdf + npix / 2) / MAX (1, npix);
+            }
+        }
+    }
+
+  /* Remap every pixel through a bilinear blend of the four surrounding
+   * tile mappings, anchored at the tile centers. */
+  for (y = 0; y < height; y++)
+    {
+      guint8 *row = buf + y * width;
+      gint fy = y * tiles_y * 256 / height - 128;
+      gint ty0 = CLAMP (fy >> 8, 0, tiles_y - 1);
+      gint ty1 = MIN (ty0 + 1, tiles_y - 1);
+      gint wy = fy - (ty0 << 8);
+
+      if (fy < 0)
+        wy = 0;
+
+      for (x = 0; x < width; x++)
+        {
+          gint fx = x * tiles_x * 256 / width - 128;
+          gint tx0 = CLAMP (fx >> 8, 0, tiles_x - 1);
+          gint tx1 = MIN (tx0 + 1, tiles_x - 1);
+          gint wx = fx - (tx0 << 8);
+          const guint8 *l00 = luts + (ty0 * tiles_x + tx0) * 256;
+          const guint8 *l01 = luts + (ty0 * tiles_x + tx1) * 256;
+          const guint8 *l10 = luts + (ty1 * tiles_x + tx0) * 256;
+          const guint8 *l11 = luts + (ty1 * tiles_x + tx1) * 256;
+          guint8 v = row[x];
+          gint top, bottom;
+
+          if (fx < 0)
+            wx = 0;
+
+          top = l00[v] * (256 - wx) + l01[v] * wx;
+          bottom = l10[v] * (256 - wx) + l11[v] * wx;
+          row[x] = (top * (256 - wy) + bottom * wy) >> 16;
+        }
+    }
+}
+
+/* Average each 2x2 block of src into one pixel of dst; odd trailing
+ * rows and columns are handled by clamping to the last source line. */
+FPI_SIMD_CLONES static void
+fpi_image_downscale_2x2 (const guint8 *src,
+                         guint         src_width,
+                         guint         src_height,
+                         guint8       *dst,
+                         guint         dst_width,
+                         guint         dst_height)
+{
+  for (guint y = 0; y < dst_height; y++)
+    {
+      const guint8 *r0 = src + (gsize) 2 * y * src_width;
+      const guint8 *r1 = (2 * y + 1 < src_height) ? r0 + src_width : r0;
+      guint8 *out = dst + (gsize) y * dst_width;
+
+      for (guint x = 0; x < dst_width; x++)
+        {
+          guint x0 = 2 * x;
+          guint x1 = MIN (2 * x + 1, src_width - 1);
+
+          out[x] = (r0[x0] + r0[x1] + r1[x0] + r1[x1] + 2) / 4;
+        }
+    }
+}
+
+/**
+ * fpi_image_get_pyramid_level:
+ * @image: the image
+ * @level: the downscale level, 1 up to %FPI_IMAGE_PYRAMID_DEPTH
+ * @width: (out) (optional): width of the returned level
+ * @height: (out) (optional): height of the returned level
+ *
+ * Returns the image box-downscaled by a factor of 2^@level. Levels are
+ * materialized on the first request and cached on the image, so every
+ * consumer of the same scale (preview, quality prescreen, detection)
+ * shares one downscale pass. Level 0 is the image data itself.
+ *
+ * Like the other lazy caches on #FpImage the pyramid is not locked;
+ * callers must not request levels from two threads at once.
+ *
+ * Returns: (transfer none) (nullable): the cached level, or %NULL if
+ *   the image buffer has already been dropped
+ */
+const guint8 *
+fpi_image_get_pyramid_level (FpImage *image,
+                             guint    level,
+                             guint   *width,
+                             guint   *height)
+{
+  const guint8 *src;
+  guint src_width, src_height;
+
+  g_return_val_if_fail (FP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (level <= FPI_IMAGE_PYRAMID_DEPTH, NULL);
+
+  src = image->data;
+  src_width = image->width;
+  src_height = image->height;
+
+  if (src == NULL)
+    return NULL;
+
+  for (guint l = 1; l <= level; l++)
+    {
+      guint dst_width = MAX (1, src_width >> 1);
+      guint dst_height = MAX (1, src_height >> 1);
+
+      if (image->pyramid[l - 1] == NULL)
+        {
+          image->pyramid[l - 1] = g_malloc ((gsize) dst_width * dst_height);
+          fpi_image_downscale_2x2 (src, src_width, src_height,
+                                   image->pyramid[l - 1],
+                                   dst_width, dst_height);
+        }
+
+      src = image->pyramid[l - 1];
+      src_width = dst_width;
+      src_height = dst_height;
+    }
+
+  if (width)
+    *width = src_width;
+  if (height)
+    *height = src_height;
+
+  return src;
+}
+
 #if HAVE_PIXMAN
-FpImage *
-fpi_image_resize (FpImage *orig_img,
-                  guint    w_factor,
-                  guint    h_factor)
+
+/* Output size from which the resize is split into row bands processed
+ * on separate threads. Today's sensors stay below this; it targets
+ * high-DPI parts where the scale becomes a multi-megapixel render. */
+#define RESIZE_PARALLEL_MIN_PIXELS (1024 * 1024)
+#define RESIZE_MAX_BANDS 8
+
+typedef struct
 {
-  int new_width = orig_img->width * w_factor;
-  int new_height = orig_img->height * h_factor;
+  FpImage *orig_img;
+  FpImage *newimg;
+  guint    w_factor, h_factor;
+  int      y0, y1; /* Destination row band, [y0, y1) */
+} ResizeBand;
+
+/* Render one band of destination rows. Each band wraps the shared
+ * pixel buffers in its own pixman images, so bands are independent and
+ * the result is bit-identical to a single full-height composite. */
+static gpointer
+fpi_image_resize_band (gpointer data)
+{
+  ResizeBand *band = data;
+  int new_width = band->orig_img->width * band->w_factor;
+  int new_height = band->orig_img->height * band->h_factor;
   pixman_image_t *orig, *resized;
   pixman_transform_t transform;
-  FpImage *newimg;
 
-  orig = pixman_image_create_bits (PIXMAN_a8, orig_img->width, orig_img->height, (uint32_t *) orig_img->data, orig_img->width);
-  resized = pixman_image_create_bits (PIXMAN_a8, new_width, new_height, NULL, new_width);
+  orig = pixman_image_create_bits (PIXMAN_a8, band->orig_img->width, band->orig_img->height,
+                                   (uint32_t *) band->orig_img->data, band->orig_img->width);
+  /* render straight into the new image, no intermediate buffer */
+  resized = pixman_image_create_bits (PIXMAN_a8, new_width, new_height,
+                                      (uint32_t *) band->newimg->data, new_width);
 
   pixman_transform_init_identity (&transform);
-  pixman_transform_scale (NULL, &transform, pixman_int_to_fixed (w_factor), pixman_int_to_fixed (h_factor));
+  pixman_transform_scale (NULL, &transform,
+                          pixman_int_to_fixed (band->w_factor),
+                          pixman_int_to_fixed (band->h_factor));
   pixman_image_set_transform (orig, &transform);
   pixman_image_set_filter (orig, PIXMAN_FILTER_BILINEAR, NULL, 0);
   pixman_image_composite32 (PIXMAN_OP_SRC,
                             orig, /* src */
                             NULL, /* mask */
                             resized, /* dst */
-                            0, 0, /* src x y */
+                            0, band->y0, /* src x y */
                             0, 0, /* mask x y */
-                            0, 0, /* dst x y */
-                            new_width, new_height /* width height */
+                            0, band->y0, /* dst x y */
+                            new_width, band->y1 - band->y0 /* width height */
                            );
 
+  pixman_image_unref (orig);
+  pixman_image_unref (resized);
+
+  return NULL;
+}
+
+FpImage *
+fpi_image_resize (FpImage *orig_img,
+                  guint    w_factor,
+                  guint    h_factor)
+{
+  int new_width = orig_img->width * w_factor;
+  int new_height = orig_img->height * h_factor;
+  ResizeBand bands[RESIZE_MAX_BANDS];
+  GThread *threads[RESIZE_MAX_BANDS];
+  FpImage *newimg;
+  guint n_bands = 1;
+  guint i;
+
   newimg = fp_image_new (new_width, new_height);
   newimg->flags = orig_img->flags;
 
-  memcpy (newimg->data, pixman_image_get_data (resized), new_width * new_height);
+  if (w_factor == 1 && h_factor == 1)
+    {
+      memcpy (newimg->data, orig_img->data, (gsize) new_width * new_height);
+      return newimg;
+    }
 
-  pixman_image_unref (orig);
-  pixman_image_unref (resized);
+  if ((gsize) new_width * new_height >= RESIZE_PARALLEL_MIN_PIXELS)
+    n_bands = CLAMP (g_get_num_processors (), 1, RESIZE_MAX_BANDS);
+  n_bands = MIN (n_bands, (guint) new_height);
+
+  for (i = 0; i < n_bands; i++)
+    {
+      bands[i].orig_img = orig_img;
+      bands[i].newimg = newimg;
+      bands[i].w_factor = w_factor;
+      bands[i].h_factor = h_factor;
+      bands[i].y0 = new_height * i / n_bands;
+      bands[i].y1 = new_height * (i + 1) / n_bands;
+    }
+
+  for (i = 1; i < n_bands; i++)
+    threads[i] = g_thread_new ("image-resize", fpi_image_resize_band, &bands[i]);
+
+  fpi_image_resize_band (&bands[0]);
+
+  for (i = 1; i < n_bands; i++)
+    g_thread_join (threads[i]);
 
   return newimg;
 }
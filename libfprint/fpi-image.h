@@ -28,6 +28,13 @@
  * @FPI_IMAGE_V_FLIPPED: the image is vertically flipped
  * @FPI_IMAGE_H_FLIPPED: the image is horizontally flipped
  * @FPI_IMAGE_COLORS_INVERTED: the colours are inverted
+ * @FPI_IMAGE_PARTIAL: the image only covers part of the finger
+ * @FPI_IMAGE_ADAPTIVE_BINARIZATION: binarize with a local-mean adaptive
+ *   threshold instead of directional ridge filters; for unevenly lit
+ *   sensors where the directional filter causes spurious retries
+ * @FPI_IMAGE_CLAHE: equalize local contrast (tiled adaptive histogram
+ *   equalization) before minutiae detection; for sensors where dry
+ *   fingers produce low-contrast captures that would otherwise retry
  *
  * Flags used in an #FpImage structure to describe the contained image.
  * This is useful for image drivers as they can simply set these flags and
@@ -38,8 +45,14 @@ typedef enum {
   FPI_IMAGE_H_FLIPPED       = 1 << 1,
   FPI_IMAGE_COLORS_INVERTED = 1 << 2,
   FPI_IMAGE_PARTIAL         = 1 << 3,
+  FPI_IMAGE_ADAPTIVE_BINARIZATION = 1 << 4,
+  FPI_IMAGE_CLAHE           = 1 << 5,
 } FpiImageFlags;
 
+/* Deepest cached downscale level: 1 / 2^4 of the capture, which is
+ * already below minutiae resolution for every supported sensor. */
+#define FPI_IMAGE_PYRAMID_DEPTH 4
+
 /**
  * FpImage:
  * @width: Width of the image
@@ -67,16 +80,82 @@ struct _FpImage
   guint8    *data;
   guint8    *binarized;
 
+  /* Backing file mapping when the pixels are memory mapped, see
+   * fp_image_new_from_file(); %NULL for heap buffers. @data then points
+   * into the mapping and must not be freed on its own. */
+  GMappedFile *mapped;
+
+  /* Buffer retention policy applied once minutiae have been detected,
+   * see fp_image_set_retention(). */
+  FpImageRetention retention;
+
+  /* Cached fp_image_get_quality_score() result, -1 if not computed. */
+  gint quality_score;
+
+  /* Lazily built downscale pyramid, see fpi_image_get_pyramid_level().
+   * Slot n - 1 holds the image at 1 / 2^n scale. */
+  guint8 *pyramid[FPI_IMAGE_PYRAMID_DEPTH];
+
   GPtrArray *minutiae;
-  guint      ref_count;
+
+  /* Detection session context (LFS_SESSION) shared across the enroll
+   * stages of one finger; owned by the image device, not the image. */
+  gpointer detection_session;
+
+  /* GLib priority of the next minutiae detection in the detection
+   * pool; lower values run first. */
+  gint detect_priority;
+
+  guint ref_count;
 };
 
 gint fpi_std_sq_dev (const guint8 *buf,
                      gint          size);
+
+/**
+ * FpiVarianceCache:
+ *
+ * Per-block sums kept between fpi_std_sq_dev_cached() calls so that
+ * blocks unchanged since the previous frame are not summed again.
+ * Initialize with fpi_variance_cache_init() for a fixed frame size and
+ * release with fpi_variance_cache_clear().
+ */
+typedef struct
+{
+  gsize    size;
+  guint8  *prev;
+  guint32 *block_sum;
+  guint32 *block_sq;
+  gboolean primed;
+} FpiVarianceCache;
+
+void fpi_variance_cache_init (FpiVarianceCache *cache,
+                              gsize             size);
+void fpi_variance_cache_clear (FpiVarianceCache *cache);
+gint fpi_std_sq_dev_cached (const guint8     *buf,
+                            gint              size,
+                            FpiVarianceCache *cache);
+
 gint fpi_mean_sq_diff_norm (const guint8 *buf1,
                             const guint8 *buf2,
                             gint          size);
 
+void fpi_image_histogram (const guint8 *buf,
+                          gint          size,
+                          guint32       histogram[256]);
+void fpi_image_stretch (guint8 *buf,
+                        gint    size,
+                        guint8  low,
+                        guint8  high);
+void fpi_image_clahe (guint8 *buf,
+                      gint    width,
+                      gint    height);
+
+const guint8 *fpi_image_get_pyramid_level (FpImage *image,
+                                           guint    level,
+                                           guint   *width,
+                                           guint   *height);
+
 #if HAVE_PIXMAN
 FpImage *fpi_image_resize (FpImage *orig,
                            guint    w_factor,
@@ -42,6 +42,8 @@
 
 #include <glib.h>
 
+#include <string.h>
+
 /**
  * fp_dbg:
  *
@@ -50,6 +52,47 @@
  */
 #define fp_dbg g_debug
 
+/**
+ * fp_dbg_enabled:
+ *
+ * Returns whether libfprint debug messages are enabled through the
+ * `G_MESSAGES_DEBUG` environment variable. The result is computed once
+ * and cached; use it to skip debug-only work on hot paths.
+ */
+static inline gboolean
+fp_dbg_enabled (void)
+{
+  static gsize enabled = 0;
+
+  if (g_once_init_enter (&enabled))
+    {
+      const char *domains = g_getenv ("G_MESSAGES_DEBUG");
+      gsize value = 1;
+
+      if (domains == NULL ||
+          (strcmp (domains, "all") != 0 && strstr (domains, "libfprint") == NULL))
+        value = 2;
+      g_once_init_leave (&enabled, value);
+    }
+
+  return enabled == 1;
+}
+
+/**
+ * fp_dbg_lazy:
+ *
+ * Same as fp_dbg(), but the message is only formatted when debug output
+ * is enabled (see fp_dbg_enabled()). g_debug() always formats its
+ * arguments before the log writer decides to drop them, which is
+ * measurable on paths that log for every state machine transition; use
+ * this variant there.
+ */
+#define fp_dbg_lazy(...) G_STMT_START {                                \
+    if (G_UNLIKELY (fp_dbg_enabled ()))                                \
+      g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,               \
+                        "MESSAGE", __VA_ARGS__);                       \
+  } G_STMT_END
+
 /**
  * fp_info:
  *
@@ -0,0 +1,79 @@
+/*
+ * FPrint allocation accounting
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "fpi-mem.h"
+
+#if HAVE_MEM_STATS
+
+/* One process-wide table; allocations from the detection thread pool
+ * and from per-device worker threads all land here, so updates take a
+ * lock. The instrumented sites are coarse enough (whole maps, whole
+ * pools) that contention is not a concern.
+ */
+static GMutex fpi_mem_lock;
+static FpiMemStats fpi_mem_counters;
+
+void
+fpi_mem_add (FpiMemSubsys subsys, gsize bytes)
+{
+  g_return_if_fail (subsys < FPI_MEM_N_SUBSYS);
+
+  g_mutex_lock (&fpi_mem_lock);
+
+  fpi_mem_counters.current[subsys] += bytes;
+  if (fpi_mem_counters.current[subsys] > fpi_mem_counters.peak[subsys])
+    fpi_mem_counters.peak[subsys] = fpi_mem_counters.current[subsys];
+
+  fpi_mem_counters.current_total += bytes;
+  if (fpi_mem_counters.current_total > fpi_mem_counters.peak_total)
+    fpi_mem_counters.peak_total = fpi_mem_counters.current_total;
+
+  g_mutex_unlock (&fpi_mem_lock);
+}
+
+void
+fpi_mem_sub (FpiMemSubsys subsys, gsize bytes)
+{
+  g_return_if_fail (subsys < FPI_MEM_N_SUBSYS);
+
+  g_mutex_lock (&fpi_mem_lock);
+
+  g_assert (fpi_mem_counters.current[subsys] >= bytes);
+  fpi_mem_counters.current[subsys] -= bytes;
+  fpi_mem_counters.current_total -= bytes;
+
+  g_mutex_unlock (&fpi_mem_lock);
+}
+
+/**
+ * fpi_mem_stats:
+ * @stats: Location to store the counters to
+ *
+ * Snapshots the per-subsystem byte counters and high-water marks. With
+ * the 'mem-stats' meson option disabled this returns all zeroes.
+ */
+void
+fpi_mem_stats (FpiMemStats *stats)
+{
+  g_mutex_lock (&fpi_mem_lock);
+  *stats = fpi_mem_counters;
+  g_mutex_unlock (&fpi_mem_lock);
+}
+
+#endif /* HAVE_MEM_STATS */
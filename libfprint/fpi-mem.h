@@ -0,0 +1,67 @@
+/*
+ * FPrint allocation accounting
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <glib.h>
+
+/* Byte counters and high-water marks for the library's larger
+ * allocation sites, grouped by subsystem. Compiled out entirely unless
+ * the 'mem-stats' meson option is enabled; with it disabled the
+ * fpi_mem_add()/fpi_mem_sub() calls sprinkled over the hot paths cost
+ * nothing.
+ *
+ * Coverage is deliberately partial: the instrumented sites are the
+ * ones that dominate residency on small devices (image caches, the
+ * persistent mindtct lookup tables, the recycled USB transfer
+ * buffers), not every g_malloc() in the tree.
+ */
+
+typedef enum {
+  FPI_MEM_SUBSYS_IMAGE,
+  FPI_MEM_SUBSYS_MINDTCT,
+  FPI_MEM_SUBSYS_USB,
+  FPI_MEM_N_SUBSYS,
+} FpiMemSubsys;
+
+typedef struct
+{
+  gsize current[FPI_MEM_N_SUBSYS];
+  gsize peak[FPI_MEM_N_SUBSYS];
+  gsize current_total;
+  gsize peak_total;
+} FpiMemStats;
+
+#if HAVE_MEM_STATS
+
+void fpi_mem_add (FpiMemSubsys subsys,
+                  gsize        bytes);
+void fpi_mem_sub (FpiMemSubsys subsys,
+                  gsize        bytes);
+void fpi_mem_stats (FpiMemStats *stats);
+
+#else
+
+#define fpi_mem_add(subsys, bytes) do {} while (0)
+#define fpi_mem_sub(subsys, bytes) do {} while (0)
+#define fpi_mem_stats(stats) do { *(stats) = (FpiMemStats) {0}; } while (0)
+
+#endif
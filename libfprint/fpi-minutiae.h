@@ -34,6 +34,9 @@ struct fp_minutia
   int   *nbrs;
   int   *ridge_counts;
   int    num_nbrs;
+  /* Candidate pool this structure was handed out of, or NULL if it was
+   * allocated individually (see create_minutia in mindtct/minutia.c). */
+  void  *pool;
 };
 
 /* fp_minutiae structure definition */
@@ -42,4 +45,6 @@ struct fp_minutiae
   int                 alloc;
   int                 num;
   struct fp_minutia **list;
+  /* Candidate pool the list's minutiae are handed out of. */
+  void               *pool;
 };
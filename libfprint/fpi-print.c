@@ -24,6 +24,10 @@
 #include "fp-print-private.h"
 #include "fpi-device.h"
 #include "fpi-compat.h"
+#include "fpi-trace.h"
+
+#include <math.h>
+#include <string.h>
 
 /**
  * SECTION: fpi-print
@@ -49,8 +53,10 @@ fpi_print_add_print (FpPrint *print, FpPrint *add)
   g_return_if_fail (print->type == FPI_PRINT_NBIS);
   g_return_if_fail (add->type == FPI_PRINT_NBIS);
 
+  fpi_print_ensure_views (add);
   g_assert (add->prints->len == 1);
   g_ptr_array_add (print->prints, g_memdup (add->prints->pdata[0], sizeof (struct xyt_struct)));
+  print->body_hash_valid = FALSE;
 }
 
 /**
@@ -97,21 +103,76 @@ fpi_print_set_device_stored (FpPrint *print,
   g_object_notify (G_OBJECT (print), "device-stored");
 }
 
-/* XXX: This is the old version, but wouldn't it be smarter to instead
- * use the highest quality mintutiae? Possibly just using bz_prune from
- * upstream? */
+static int
+sort_quality_desc (const void *a, const void *b)
+{
+  return ((const struct minutiae_struct *) b)->col[3] -
+         ((const struct minutiae_struct *) a)->col[3];
+}
+
+/* Quality-ranked pruning cap applied when building xyt templates.
+ * Defaults to bozorth's 150-minutiae sweet spot; FP_MINUTIAE_CAP
+ * overrides it for deployments that want to trade the last bit of
+ * discrimination for smaller templates and faster matching (edge-table
+ * construction is quadratic in the minutiae count), or the other way
+ * around. bz_prune() would do the same job but the vendored bozorth3
+ * only ships its declaration. */
+static int
+minutiae_cap (void)
+{
+  static gsize cap = 0;
+
+  if (g_once_init_enter (&cap))
+    {
+      const char *env = g_getenv ("FP_MINUTIAE_CAP");
+      gint64 value = DEFAULT_BOZORTH_MINUTIAE;
+
+      if (env)
+        {
+          value = g_ascii_strtoll (env, NULL, 10);
+          if (value < MIN_COMPUTABLE_BOZORTH_MINUTIAE ||
+              value > MAX_FILE_MINUTIAE)
+            {
+              g_warning ("FP_MINUTIAE_CAP out of range [%d, %d], using %d",
+                         MIN_COMPUTABLE_BOZORTH_MINUTIAE, MAX_FILE_MINUTIAE,
+                         DEFAULT_BOZORTH_MINUTIAE);
+              value = DEFAULT_BOZORTH_MINUTIAE;
+            }
+        }
+
+      g_once_init_leave (&cap, (gsize) value);
+    }
+
+  return (int) cap;
+}
+
+/* Minutiae used for the progressive-match prefix in
+ * fpi_print_bz3_match(): enough discrimination to reject clear
+ * non-matches, an order of magnitude fewer edges than a full view. */
+#define BZ3_PREFIX_MINUTIAE 25
+
+/* A prefix match can only score a fraction of the full score, so a
+ * candidate proceeds to the full match whenever the prefix reaches
+ * threshold / BZ3_PREFIX_SLACK_DIV. Genuine matches comfortably clear
+ * this bar with their best 25 minutiae; most impostors score near
+ * zero and are rejected without the full match. */
+#define BZ3_PREFIX_SLACK_DIV 4
+
 static void
 minutiae_to_xyt (struct fp_minutiae *minutiae,
                  int                 bwidth,
                  int                 bheight,
-                 struct xyt_struct  *xyt)
+                 struct xyt_struct  *xyt,
+                 struct xyt_struct  *prefix)
 {
   int i;
   struct fp_minutia *minutia;
   struct minutiae_struct c[MAX_FILE_MINUTIAE];
 
-  /* struct xyt_struct uses arrays of MAX_BOZORTH_MINUTIAE (200) */
-  int nmin = min (minutiae->num, MAX_BOZORTH_MINUTIAE);
+  int nmin = min (minutiae->num, MAX_FILE_MINUTIAE);
+
+  if (prefix)
+    prefix->nrows = 0;
 
   for (i = 0; i < nmin; i++)
     {
@@ -125,6 +186,37 @@ minutiae_to_xyt (struct fp_minutiae *minutiae,
         c[i].col[2] -= 360;
     }
 
+  /* Keep only the most reliable minutiae when there are more than the
+   * configured cap. Bozorth cost grows roughly with the square of the
+   * minutiae count and the extra low-reliability points add more noise
+   * than discrimination. */
+  if (nmin > minutiae_cap () || (prefix && nmin > BZ3_PREFIX_MINUTIAE))
+    qsort ((void *) &c, (size_t) nmin, sizeof (struct minutiae_struct),
+           sort_quality_desc);
+
+  /* Side-build the reliability prefix while c[] is quality-ordered;
+   * views at or below the prefix size gain nothing from prescreening
+   * and keep no prefix. */
+  if (prefix && nmin > BZ3_PREFIX_MINUTIAE)
+    {
+      struct minutiae_struct p[BZ3_PREFIX_MINUTIAE];
+
+      memcpy (p, c, sizeof (p));
+      qsort ((void *) &p, (size_t) BZ3_PREFIX_MINUTIAE,
+             sizeof (struct minutiae_struct), sort_x_y);
+
+      for (i = 0; i < BZ3_PREFIX_MINUTIAE; i++)
+        {
+          prefix->xcol[i]     = p[i].col[0];
+          prefix->ycol[i]     = p[i].col[1];
+          prefix->thetacol[i] = p[i].col[2];
+        }
+      prefix->nrows = BZ3_PREFIX_MINUTIAE;
+    }
+
+  if (nmin > minutiae_cap ())
+    nmin = minutiae_cap ();
+
   qsort ((void *) &c, (size_t) nmin, sizeof (struct minutiae_struct),
          sort_x_y);
 
@@ -159,6 +251,7 @@ fpi_print_add_from_image (FpPrint *print,
   GPtrArray *minutiae;
   struct fp_minutiae _minutiae;
   struct xyt_struct *xyt;
+  g_autofree struct xyt_struct *prefix = NULL;
 
   if (print->type != FPI_PRINT_NBIS || !image)
     {
@@ -184,8 +277,19 @@ fpi_print_add_from_image (FpPrint *print,
   _minutiae.alloc = minutiae->len;
 
   xyt = g_new0 (struct xyt_struct, 1);
-  minutiae_to_xyt (&_minutiae, image->width, image->height, xyt);
+  prefix = g_new0 (struct xyt_struct, 1);
+  minutiae_to_xyt (&_minutiae, image->width, image->height, xyt, prefix);
   g_ptr_array_add (print->prints, xyt);
+  print->body_hash_valid = FALSE;
+
+  /* Record the reliability prefix under the same view index; views from
+   * other sources leave holes and simply are not prescreened. */
+  if (!print->bz_prefixes)
+    print->bz_prefixes = g_ptr_array_new_with_free_func (g_free);
+  g_ptr_array_set_size (print->bz_prefixes, print->prints->len - 1);
+  if (prefix->nrows == 0)
+    g_clear_pointer (&prefix, g_free);
+  g_ptr_array_add (print->bz_prefixes, g_steal_pointer (&prefix));
 
   g_clear_object (&print->image);
   print->image = g_object_ref (image);
@@ -194,6 +298,539 @@ fpi_print_add_from_image (FpPrint *print,
   return TRUE;
 }
 
+/**
+ * fpi_print_drop_image:
+ * @print: A #FpPrint
+ *
+ * Releases the #FpImage attached to @print by fpi_print_add_from_image().
+ * The minutiae extracted from it are unaffected; only fp_print_get_image()
+ * loses access to the raw pixels.
+ *
+ * The image device uses this during enrollment to bound the number of
+ * full frames held alive through the stage prints.
+ */
+void
+fpi_print_drop_image (FpPrint *print)
+{
+  g_return_if_fail (FP_IS_PRINT (print));
+
+  if (!print->image)
+    return;
+
+  g_clear_object (&print->image);
+  g_object_notify (G_OBJECT (print), "image");
+}
+
+/* Bozorth score above which two enroll views are considered duplicate
+ * coverage of the same finger area. Well above the default verify
+ * threshold (40), so only near-identical impressions are merged. */
+#define BZ3_CONSOLIDATE_THRESHOLD 80
+
+/**
+ * fpi_print_consolidate:
+ * @print: A #FpPrint of type #FPI_PRINT_NBIS
+ *
+ * Consolidates an enrolled template by dropping views that are
+ * near-duplicates of an earlier view, i.e. score far above the match
+ * threshold against it. Enroll stages routinely capture the same finger
+ * placement several times; the redundant views inflate storage and every
+ * later verify or identify pays one bozorth comparison per view.
+ *
+ * The views are not merged into a single minutiae cloud on purpose:
+ * impressions are not registered to a common frame, so combining their
+ * coordinates would fabricate inter-view edges that bozorth then scores.
+ * Distinct placements are kept as separate views instead.
+ *
+ * Called by the image device at the end of enrollment; drivers doing
+ * host-side NBIS enrollment on their own may call it as well.
+ */
+void
+fpi_print_consolidate (FpPrint *print)
+{
+  guint before, i, j;
+
+  g_return_if_fail (FP_IS_PRINT (print));
+  g_return_if_fail (print->type == FPI_PRINT_NBIS);
+
+  fpi_print_ensure_views (print);
+  before = print->prints->len;
+
+  for (i = 0; i + 1 < print->prints->len; i++)
+    {
+      struct xyt_struct *pstruct = g_ptr_array_index (print->prints, i);
+      gint probe_len = bozorth_probe_init (pstruct);
+
+      j = i + 1;
+      while (j < print->prints->len)
+        {
+          struct xyt_struct *gstruct = g_ptr_array_index (print->prints, j);
+
+          if (bozorth_to_gallery (probe_len, pstruct, gstruct) >= BZ3_CONSOLIDATE_THRESHOLD)
+            g_ptr_array_remove_index (print->prints, j);
+          else
+            j++;
+        }
+    }
+
+  if (print->prints->len != before)
+    {
+      fp_dbg ("Consolidated enroll template from %u to %u views",
+              before, print->prints->len);
+
+      /* The cached per-view data is indexed by view, so rebuild it. */
+      g_clear_pointer (&print->bz_edge_tables, g_ptr_array_unref);
+      g_clear_pointer (&print->bz_prefilters, g_ptr_array_unref);
+      g_clear_pointer (&print->bz_poses, g_ptr_array_unref);
+      g_clear_pointer (&print->bz_prefixes, g_ptr_array_unref);
+      print->body_hash_valid = FALSE;
+    }
+}
+
+/**
+ * fpi_print_set_lazy_views:
+ * @print: A #FpPrint of type #FPI_PRINT_NBIS without any views yet
+ * @n_views: Number of views the print will have
+ * @materialize: Callback installing the actual views
+ * @user_data: Data passed to @materialize
+ * @destroy: Free function for @user_data
+ *
+ * Defer loading the minutiae views of @print: the print gets @n_views
+ * placeholder views, and the first code path that needs the actual
+ * minutiae data calls @materialize through fpi_print_ensure_views() to
+ * fill them in. @user_data identifies the backing storage; prints
+ * sharing it are treated as copies of one template by the gallery
+ * matchers, exactly like prints sharing view pointers are.
+ *
+ * Until materialization the print can take part in everything that
+ * works from metadata and imported prefilter vectors (see
+ * fpi_print_import_prefilters()), which is all the screening pass of
+ * gallery identification needs.
+ *
+ * @materialize may run on a matcher worker thread and must tolerate
+ * being invoked concurrently for different prints sharing @user_data.
+ */
+void
+fpi_print_set_lazy_views (FpPrint         *print,
+                          guint            n_views,
+                          FpiPrintLazyFunc materialize,
+                          gpointer         user_data,
+                          GDestroyNotify   destroy)
+{
+  g_return_if_fail (FP_IS_PRINT (print));
+  g_return_if_fail (print->type == FPI_PRINT_NBIS);
+  g_return_if_fail (print->prints->len == 0);
+  g_return_if_fail (n_views > 0);
+  g_return_if_fail (materialize != NULL);
+  g_return_if_fail (print->lazy_cb == NULL);
+
+  /* The installed views stay owned by whatever @materialize hooks up
+   * (the gallery keeps them alive through object data); replace the
+   * owning array from fpi_print_set_type() with a non-owning one of
+   * placeholders. */
+  g_ptr_array_unref (print->prints);
+  print->prints = g_ptr_array_new ();
+  g_ptr_array_set_size (print->prints, n_views);
+
+  print->lazy_cb = materialize;
+  print->lazy_data = user_data;
+  print->lazy_destroy = destroy;
+}
+
+/**
+ * fpi_print_ensure_views:
+ * @print: A #FpPrint, or %NULL
+ *
+ * Make sure the minutiae views of @print are materialized, invoking the
+ * callback installed with fpi_print_set_lazy_views() if they are not.
+ * A no-op for prints that carry their views directly.
+ *
+ * The matcher jobs hand whole templates to a single worker, so within
+ * one print no locking is needed here; the callback serializes prints
+ * sharing a payload on its own.
+ */
+void
+fpi_print_ensure_views (FpPrint *print)
+{
+  if (print == NULL || print->lazy_cb == NULL ||
+      g_atomic_int_get (&print->lazy_done))
+    return;
+
+  print->lazy_cb (print, print->lazy_data);
+  g_atomic_int_set (&print->lazy_done, 1);
+}
+
+#define BZ3_PREFILTER_THETA_BINS 8
+
+/* Minimum prefilter similarity (0-100) below which a gallery pairing is
+ * considered an obvious non-match and full bozorth scoring is skipped.
+ * Deliberately conservative: a genuine pair with a third of its minutiae
+ * directions in agreement still passes comfortably. */
+#define BZ3_PREFILTER_THRESHOLD 25
+
+/* Fixed-length summary of one print view, cheap to compare: the minutiae
+ * count and a coarse histogram of the ridge-flow directions. Positions
+ * are deliberately left out, since finger placement shifts them. */
+typedef struct
+{
+  gint n;
+  gint theta_hist[BZ3_PREFILTER_THETA_BINS];
+} Bz3Prefilter;
+
+static void
+bz3_prefilter_build (const struct xyt_struct *xyt, Bz3Prefilter *filter)
+{
+  gint i;
+
+  memset (filter, 0, sizeof (*filter));
+  filter->n = xyt->nrows;
+
+  /* thetacol is in (-180, 180] degrees, 45° per bin */
+  for (i = 0; i < xyt->nrows; i++)
+    filter->theta_hist[((xyt->thetacol[i] + 360) % 360) / 45]++;
+}
+
+static gint
+bz3_prefilter_compare (const Bz3Prefilter *a, const Bz3Prefilter *b)
+{
+  gint best = 0;
+  gint shift, i;
+
+  if (MAX (a->n, b->n) == 0)
+    return 0;
+
+  /* Histogram intersection, allowing one bin (45°) of rotation slack.
+   * Normalizing by the larger count also penalizes gross minutiae count
+   * mismatches, since the intersection can reach at most the smaller. */
+  for (shift = -1; shift <= 1; shift++)
+    {
+      gint inter = 0;
+
+      for (i = 0; i < BZ3_PREFILTER_THETA_BINS; i++)
+        inter += MIN (a->theta_hist[i],
+                      b->theta_hist[(i + shift + BZ3_PREFILTER_THETA_BINS) % BZ3_PREFILTER_THETA_BINS]);
+
+      best = MAX (best, inter);
+    }
+
+  return (100 * best) / MAX (a->n, b->n);
+}
+
+/* Fetch (building on first use) the cached prefilter vector for view
+ * @idx of @print, mirroring fpi_print_get_edge_table() below. */
+static Bz3Prefilter *
+fpi_print_get_prefilter (FpPrint *print, guint idx)
+{
+  Bz3Prefilter *filter;
+
+  if (!print->bz_prefilters)
+    print->bz_prefilters = g_ptr_array_new_with_free_func (g_free);
+
+  if (print->bz_prefilters->len < print->prints->len)
+    g_ptr_array_set_size (print->bz_prefilters, print->prints->len);
+
+  filter = g_ptr_array_index (print->bz_prefilters, idx);
+  if (!filter)
+    {
+      fpi_print_ensure_views (print);
+      filter = g_new (Bz3Prefilter, 1);
+      bz3_prefilter_build (g_ptr_array_index (print->prints, idx), filter);
+      print->bz_prefilters->pdata[idx] = filter;
+    }
+
+  return filter;
+}
+
+/**
+ * fpi_print_prefilter_size:
+ *
+ * Returns: The size in bytes of one prefilter vector as stored by
+ *   fpi_print_export_prefilters()
+ */
+gsize
+fpi_print_prefilter_size (void)
+{
+  return sizeof (Bz3Prefilter);
+}
+
+/**
+ * fpi_print_export_prefilters:
+ * @print: A #FpPrint of type #FPI_PRINT_NBIS
+ * @buffer: A #GByteArray the vectors are appended to
+ *
+ * Append the prefilter vector of every view of @print to @buffer, one
+ * fpi_print_prefilter_size() sized record per view, in native byte
+ * order. Together with fpi_print_import_prefilters() this lets a
+ * gallery file keep the screening vectors readable next to compressed
+ * view payloads, so identification can prefilter without touching the
+ * payloads.
+ */
+void
+fpi_print_export_prefilters (FpPrint *print, GByteArray *buffer)
+{
+  guint i;
+
+  g_return_if_fail (FP_IS_PRINT (print));
+  g_return_if_fail (print->type == FPI_PRINT_NBIS);
+
+  for (i = 0; i < print->prints->len; i++)
+    g_byte_array_append (buffer,
+                         (const guint8 *) fpi_print_get_prefilter (print, i),
+                         sizeof (Bz3Prefilter));
+}
+
+/**
+ * fpi_print_import_prefilters:
+ * @print: A #FpPrint of type #FPI_PRINT_NBIS
+ * @data: One stored vector per view of @print, as produced by
+ *   fpi_print_export_prefilters()
+ *
+ * Install previously exported prefilter vectors, replacing any cached
+ * ones, so they need not be rebuilt from the views. The number of
+ * vectors read from @data is the print's view count.
+ */
+void
+fpi_print_import_prefilters (FpPrint *print, const guint8 *data)
+{
+  guint i;
+
+  g_return_if_fail (FP_IS_PRINT (print));
+  g_return_if_fail (print->type == FPI_PRINT_NBIS);
+
+  g_clear_pointer (&print->bz_prefilters, g_ptr_array_unref);
+  print->bz_prefilters = g_ptr_array_new_with_free_func (g_free);
+  g_ptr_array_set_size (print->bz_prefilters, print->prints->len);
+
+  for (i = 0; i < print->prints->len; i++)
+    print->bz_prefilters->pdata[i] =
+      g_memdup (data + i * sizeof (Bz3Prefilter), sizeof (Bz3Prefilter));
+}
+
+/**
+ * fpi_print_prefilter_score:
+ * @template: A #FpPrint containing one or more prints
+ * @print: A newly scanned #FpPrint to test
+ *
+ * Cheaply estimate how plausible it is that @print matches @template,
+ * from fixed-length summaries of the minutiae data (count and ridge-flow
+ * direction histogram). This costs a few dozen integer operations per
+ * pairing and is meant to reject obvious non-matches before the full
+ * bozorth scoring in large-gallery identification; it is not a match
+ * decision by itself.
+ *
+ * Returns: A similarity estimate between 0 and 100, or 100 if the prints
+ *   cannot be summarized (so such pairs are never rejected)
+ */
+gint
+fpi_print_prefilter_score (FpPrint *template, FpPrint *print)
+{
+  gint best = 0;
+  guint i;
+
+  if (template->type != FPI_PRINT_NBIS || print->type != FPI_PRINT_NBIS ||
+      print->prints->len != 1 || template->prints->len == 0)
+    return 100;
+
+  for (i = 0; i < template->prints->len; i++)
+    best = MAX (best, bz3_prefilter_compare (fpi_print_get_prefilter (template, i),
+                                             fpi_print_get_prefilter (print, 0)));
+
+  return best;
+}
+
+/* Pose pre-alignment: probe and gallery view are each summarized by a
+ * dominant ridge-flow direction, and when the two estimates disagree by
+ * more than BZ3_POSE_ALIGN_MIN_DEG the probe minutiae are rotated into
+ * the gallery view's pose before scoring. bozorth3 compensates rotation
+ * by admitting wide angular ranges into its compatible-edge tables, so
+ * aligning the probe up front keeps those tables small on rotated
+ * touches instead of paying for the tolerance on every edge pair. */
+#define BZ3_POSE_ALIGN_MIN_DEG 15
+
+static gint
+bz3_pose_estimate (const struct xyt_struct *xyt)
+{
+  double sx = 0.0, sy = 0.0;
+  gint i;
+
+  /* Circular mean of the doubled minutiae angles; doubling makes the
+   * estimate insensitive to the 180 degree ridge-ending/bifurcation
+   * direction ambiguity. The result is in (-90, 90]. */
+  for (i = 0; i < xyt->nrows; i++)
+    {
+      double a = 2.0 * xyt->thetacol[i] * G_PI / 180.0;
+
+      sx += cos (a);
+      sy += sin (a);
+    }
+
+  if (sx == 0.0 && sy == 0.0)
+    return 0;
+
+  return (gint) nearbyint (atan2 (sy, sx) * 180.0 / G_PI / 2.0);
+}
+
+/* Difference between two pose estimates, wrapped into (-90, 90]. */
+static gint
+bz3_pose_delta (gint a, gint b)
+{
+  gint delta = (a - b) % 180;
+
+  if (delta > 90)
+    delta -= 180;
+  else if (delta <= -90)
+    delta += 180;
+
+  return delta;
+}
+
+static void
+bz3_pose_rotate (const struct xyt_struct *src,
+                 struct xyt_struct       *dst,
+                 gint                     degrees)
+{
+  struct minutiae_struct c[MAX_BOZORTH_MINUTIAE];
+  double a = degrees * G_PI / 180.0;
+  double co = cos (a), s = sin (a);
+  double cx = 0.0, cy = 0.0;
+  gint i;
+
+  dst->nrows = src->nrows;
+  if (src->nrows == 0)
+    return;
+
+  /* Rotate around the minutiae centroid so the print stays roughly in
+   * place; bozorth only looks at relative geometry anyway. */
+  for (i = 0; i < src->nrows; i++)
+    {
+      cx += src->xcol[i];
+      cy += src->ycol[i];
+    }
+  cx /= src->nrows;
+  cy /= src->nrows;
+
+  for (i = 0; i < src->nrows; i++)
+    {
+      double dx = src->xcol[i] - cx;
+      double dy = src->ycol[i] - cy;
+      gint theta = src->thetacol[i] + degrees;
+
+      c[i].col[0] = (gint) nearbyint (cx + co * dx - s * dy);
+      c[i].col[1] = (gint) nearbyint (cy + s * dx + co * dy);
+
+      /* Back into (-180, 180]. */
+      while (theta > 180)
+        theta -= 360;
+      while (theta <= -180)
+        theta += 360;
+      c[i].col[2] = theta;
+      c[i].col[3] = 0;
+    }
+
+  /* Rotation scrambles the (x, y) order the template build established;
+   * bz_comp()'s early-exit pruning assumes ascending x, so restore it
+   * before the result is fed to bozorth. */
+  qsort ((void *) &c, (size_t) src->nrows,
+         sizeof (struct minutiae_struct), sort_x_y);
+
+  for (i = 0; i < src->nrows; i++)
+    {
+      dst->xcol[i]     = c[i].col[0];
+      dst->ycol[i]     = c[i].col[1];
+      dst->thetacol[i] = c[i].col[2];
+    }
+}
+
+/* Fetch (building on first use) the cached pose estimate for view @idx
+ * of @print, mirroring fpi_print_get_prefilter() above. */
+static gint
+fpi_print_get_pose (FpPrint *print, guint idx)
+{
+  gint *pose;
+
+  if (!print->bz_poses)
+    print->bz_poses = g_ptr_array_new_with_free_func (g_free);
+
+  if (print->bz_poses->len < print->prints->len)
+    g_ptr_array_set_size (print->bz_poses, print->prints->len);
+
+  pose = g_ptr_array_index (print->bz_poses, idx);
+  if (!pose)
+    {
+      fpi_print_ensure_views (print);
+      pose = g_new (gint, 1);
+      *pose = bz3_pose_estimate (g_ptr_array_index (print->prints, idx));
+      print->bz_poses->pdata[idx] = pose;
+    }
+
+  return *pose;
+}
+
+/* Fetch (building on first use) the precomputed bozorth edge table for
+ * view @idx of @print. The tables are what bozorth_gallery_init() would
+ * otherwise recompute from scratch on every single comparison, and they
+ * only depend on the xyt data, so caching them on the print makes repeat
+ * matching (verify retries, identification) much cheaper.
+ *
+ * Returns %NULL if the table could not be allocated; callers then fall
+ * back to the unprepared path. */
+static struct bz_edge_table *
+fpi_print_get_edge_table (FpPrint *print, guint idx)
+{
+  struct bz_edge_table *table;
+
+  if (!print->bz_edge_tables)
+    print->bz_edge_tables = g_ptr_array_new_with_free_func (g_free);
+
+  if (print->bz_edge_tables->len < print->prints->len)
+    g_ptr_array_set_size (print->bz_edge_tables, print->prints->len);
+
+  table = g_ptr_array_index (print->bz_edge_tables, idx);
+  if (!table)
+    {
+      fpi_print_ensure_views (print);
+      table = bozorth_edge_table_build (g_ptr_array_index (print->prints, idx));
+      print->bz_edge_tables->pdata[idx] = table;
+    }
+
+  return table;
+}
+
+/**
+ * fpi_print_prewarm:
+ * @print: A #FpPrint
+ *
+ * Build the cached bozorth edge tables, prefilter vectors and pose
+ * estimates for every view of @print up front, so the first match against it does not pay
+ * for them. Prints that are not NBIS prints are left untouched.
+ *
+ * The caches are built lazily and without locking during matching, so
+ * call this only while @print is not taking part in a match, e.g. from
+ * fp_gallery_warmup_async() during idle time.
+ */
+void
+fpi_print_prewarm (FpPrint *print)
+{
+  guint i;
+
+  g_return_if_fail (FP_IS_PRINT (print));
+
+  if (print->type != FPI_PRINT_NBIS)
+    return;
+
+  /* Prints with deferred views would have to materialize here; leave
+   * them cold so warming a compressed gallery does not decompress it
+   * wholesale. Their prefilter vectors are imported at load time. */
+  if (print->lazy_cb && !g_atomic_int_get (&print->lazy_done))
+    return;
+
+  for (i = 0; i < print->prints->len; i++)
+    {
+      fpi_print_get_prefilter (print, i);
+      fpi_print_get_edge_table (print, i);
+      fpi_print_get_pose (print, i);
+    }
+}
+
 /**
  * fpi_print_bz3_match:
  * @template: A #FpPrint containing one or more prints
@@ -213,7 +850,14 @@ FpiMatchResult
 fpi_print_bz3_match (FpPrint *template, FpPrint *print, gint bz3_threshold, GError **error)
 {
   struct xyt_struct *pstruct;
-  gint probe_len;
+  struct xyt_struct *prefix = NULL;
+  struct xyt_struct rotated;
+  struct xyt_struct prefix_rotated;
+  gint probe_pose;
+  gint probe_delta = 0;
+  gboolean probe_is_full = TRUE;
+  gint probe_len = 0;
+  gint prescreen_target = MAX (1, bz3_threshold / BZ3_PREFIX_SLACK_DIV);
   gint i;
 
   /* XXX: Use a different error type? */
@@ -231,24 +875,1198 @@ fpi_print_bz3_match (FpPrint *template, FpPrint *print, gint bz3_threshold, GErr
       return FPI_MATCH_ERROR;
     }
 
+  fpi_trace_span_begin ("bz3-match %p", template);
+
+  fpi_print_ensure_views (template);
   pstruct = g_ptr_array_index (print->prints, 0);
-  probe_len = bozorth_probe_init (pstruct);
+  if (print->bz_prefixes && print->bz_prefixes->len > 0)
+    prefix = g_ptr_array_index (print->bz_prefixes, 0);
+  probe_pose = bz3_pose_estimate (pstruct);
+  if (!prefix)
+    probe_len = bozorth_probe_init (pstruct);
 
   for (i = 0; i < template->prints->len; i++)
     {
       struct xyt_struct *gstruct;
-      gint score;
+      struct xyt_struct *probe;
+      struct bz_edge_table *table;
+      gint delta, score;
       gstruct = g_ptr_array_index (template->prints, i);
-      score = bozorth_to_gallery (probe_len, pstruct, gstruct);
-      fp_dbg ("score %d/%d", score, bz3_threshold);
+      table = fpi_print_get_edge_table (template, i);
+
+      /* Pre-rotate the probe into this view's pose when the estimated
+       * orientations disagree noticeably; aligned pairs score over
+       * much smaller compatible-edge tables. bozorth_probe_init()
+       * keeps per-probe state, so re-init whenever the effective probe
+       * changes between views. */
+      delta = bz3_pose_delta (fpi_print_get_pose (template, i), probe_pose);
+      if (ABS (delta) < BZ3_POSE_ALIGN_MIN_DEG)
+        delta = 0;
+
+      /* Prescreen with the reliability prefix: score the top minutiae
+       * only and move on to the full (an order of magnitude costlier)
+       * match only when the prefix lands within slack of the
+       * threshold. Accepts still always come from the full score. */
+      if (prefix)
+        {
+          struct xyt_struct *pre = prefix;
+          gint pre_len, pre_score;
+
+          if (delta != 0)
+            {
+              bz3_pose_rotate (prefix, &prefix_rotated, delta);
+              pre = &prefix_rotated;
+            }
+          pre_len = bozorth_probe_init (pre);
+          probe_is_full = FALSE;
+
+          if (table)
+            pre_score = bozorth_to_gallery_prepared_threshold (pre_len, pre, gstruct,
+                                                               table, prescreen_target);
+          else
+            pre_score = bozorth_to_gallery_threshold (pre_len, pre, gstruct,
+                                                      prescreen_target);
+          if (pre_score < prescreen_target)
+            {
+              fp_dbg ("prefix score %d/%d, skipping full match (pose delta %d)",
+                      pre_score, prescreen_target, delta);
+              continue;
+            }
+        }
+
+      if (!probe_is_full || delta != probe_delta)
+        {
+          if (delta != 0)
+            bz3_pose_rotate (pstruct, &rotated, delta);
+          probe_len = bozorth_probe_init (delta != 0 ? &rotated : pstruct);
+          probe_delta = delta;
+          probe_is_full = TRUE;
+        }
+      probe = probe_delta != 0 ? &rotated : pstruct;
+
+      if (table)
+        score = bozorth_to_gallery_prepared_threshold (probe_len, probe, gstruct,
+                                                       table, bz3_threshold);
+      else
+        score = bozorth_to_gallery_threshold (probe_len, probe, gstruct,
+                                              bz3_threshold);
+      fp_dbg ("score %d/%d (pose delta %d)", score, bz3_threshold, delta);
 
       if (score >= bz3_threshold)
-        return FPI_MATCH_SUCCESS;
+        {
+          fpi_trace_span_end ("bz3-match %p", template);
+          return FPI_MATCH_SUCCESS;
+        }
     }
 
+  fpi_trace_span_end ("bz3-match %p", template);
   return FPI_MATCH_FAIL;
 }
 
+/* Optional negative-result cache for gallery identification. When the
+ * same unenrolled finger is presented repeatedly (FP_NEGATIVE_CACHE=N
+ * in the environment, N = number of remembered rejections), a probe
+ * whose quantized prefilter vector matches a recently rejected one is
+ * only scored against the templates that were at least plausible on
+ * the previous full scan, instead of the whole gallery. The
+ * quantization is deliberately coarse so that successive captures of
+ * the same finger land on the same key. Entries are tied to the exact
+ * gallery array (pointer and length); any gallery change misses the
+ * cache and triggers a full scan again. */
+typedef struct
+{
+  guint64    key;           /* quantized prefilter hash, 0 = empty slot */
+  GPtrArray *templates;     /* gallery identity, strong reference */
+  guint      templates_len;
+  GArray    *candidates;    /* of guint: plausible template indices */
+  gint64     stamp;         /* last use, for LRU eviction */
+} NegCacheEntry;
+
+static GMutex neg_cache_lock;
+static NegCacheEntry *neg_cache;
+static guint neg_cache_capacity;
+static gint64 neg_cache_stamp;
+
+static guint
+neg_cache_get_capacity (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init))
+    {
+      const gchar *env = g_getenv ("FP_NEGATIVE_CACHE");
+      guint capacity = 0;
+
+      if (env)
+        {
+          gint64 value = g_ascii_strtoll (env, NULL, 10);
+
+          if (value >= 1 && value <= 64)
+            capacity = value;
+          else
+            g_warning ("Ignoring out of range FP_NEGATIVE_CACHE value \"%s\"", env);
+        }
+
+      if (capacity)
+        neg_cache = g_new0 (NegCacheEntry, capacity);
+      neg_cache_capacity = capacity;
+
+      g_once_init_leave (&init, 1);
+    }
+
+  return neg_cache_capacity;
+}
+
+/* Locality-sensitive key of a probe's prefilter vector: the minutiae
+ * count and direction histogram are quantized into coarse buckets and
+ * FNV-folded, so near-identical probes collide on purpose. */
+static guint64
+bz3_prefilter_lsh (const Bz3Prefilter *filter)
+{
+  guint64 h = 0xcbf29ce484222325ull;
+  gint i;
+
+  h = (h ^ (guint64) (filter->n / 8)) * 0x100000001b3ull;
+  for (i = 0; i < BZ3_PREFILTER_THETA_BINS; i++)
+    h = (h ^ (guint64) (filter->theta_hist[i] / 4)) * 0x100000001b3ull;
+
+  return h | 1; /* 0 marks an empty slot */
+}
+
+static void
+neg_cache_entry_clear (NegCacheEntry *entry)
+{
+  entry->key = 0;
+  g_clear_pointer (&entry->templates, g_ptr_array_unref);
+  g_clear_pointer (&entry->candidates, g_array_unref);
+}
+
+/* Returns the remembered plausible-template indices for @key against
+ * @templates, or %NULL on a miss. */
+static GArray *
+neg_cache_lookup (guint64 key, GPtrArray *templates)
+{
+  GArray *candidates = NULL;
+  guint i;
+
+  g_mutex_lock (&neg_cache_lock);
+  for (i = 0; i < neg_cache_capacity; i++)
+    {
+      NegCacheEntry *entry = &neg_cache[i];
+
+      if (entry->key != key)
+        continue;
+
+      if (entry->templates != templates ||
+          entry->templates_len != templates->len)
+        {
+          /* Same finger, different gallery: stale, forget it. */
+          neg_cache_entry_clear (entry);
+          continue;
+        }
+
+      entry->stamp = ++neg_cache_stamp;
+      candidates = g_array_ref (entry->candidates);
+      break;
+    }
+  g_mutex_unlock (&neg_cache_lock);
+
+  return candidates;
+}
+
+static void
+neg_cache_remove (guint64 key, GPtrArray *templates)
+{
+  guint i;
+
+  g_mutex_lock (&neg_cache_lock);
+  for (i = 0; i < neg_cache_capacity; i++)
+    if (neg_cache[i].key == key && neg_cache[i].templates == templates)
+      neg_cache_entry_clear (&neg_cache[i]);
+  g_mutex_unlock (&neg_cache_lock);
+}
+
+/* Remember a rejected probe along with the indices of the templates a
+ * near-identical probe would still have to be scored against (those
+ * that passed the prefilter this time). */
+static void
+neg_cache_store (guint64 key, GPtrArray *templates, FpPrint *print)
+{
+  GArray *candidates;
+  NegCacheEntry *victim;
+  guint i;
+
+  candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+  for (i = 0; i < templates->len; i++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, i);
+
+      if (fpi_print_prefilter_score (template, print) >= BZ3_PREFILTER_THRESHOLD)
+        g_array_append_val (candidates, i);
+    }
+
+  g_mutex_lock (&neg_cache_lock);
+  victim = &neg_cache[0];
+  for (i = 0; i < neg_cache_capacity; i++)
+    {
+      NegCacheEntry *entry = &neg_cache[i];
+
+      if (entry->key == key && entry->templates == templates)
+        {
+          victim = entry;
+          break;
+        }
+      if (entry->key == 0)
+        victim = entry;
+      else if (victim->key != 0 && entry->stamp < victim->stamp)
+        victim = entry;
+    }
+
+  neg_cache_entry_clear (victim);
+  victim->key = key;
+  victim->templates = g_ptr_array_ref (templates);
+  victim->templates_len = templates->len;
+  victim->candidates = candidates;
+  victim->stamp = ++neg_cache_stamp;
+  g_mutex_unlock (&neg_cache_lock);
+}
+
+/**
+ * fp_print_match:
+ * @probe: A newly captured #FpPrint containing exactly one print
+ * @candidate: A #FpPrint to test against, e.g. a stored enrollment
+ * @threshold: The BZ3 score threshold to count as a match
+ * @score: (out) (optional): Location to store the best observed score
+ * @error: Return location for error
+ *
+ * Match @probe against @candidate purely on the print data, without any
+ * device involved, for host-side matching of serialized prints. Both
+ * prints need to be of type #FPI_PRINT_NBIS; the views of @candidate
+ * are scored against the probe and the best score is reported.
+ *
+ * The comparison uses thread-local scratch state and lazily built
+ * per-print tables, so independent pairs can be matched concurrently
+ * from as many threads as the host has cores. The scoring exits early
+ * once @threshold is reached, so a reported @score at or above the
+ * threshold is the score of the winning view, while a lower value is
+ * only the best bound the early exits allowed.
+ *
+ * Returns: %TRUE if the prints match; %FALSE with @error unset means
+ *   they do not, %FALSE with @error set means the prints could not be
+ *   compared
+ */
+gboolean
+fp_print_match (FpPrint *probe,
+                FpPrint *candidate,
+                gint     threshold,
+                gint    *score,
+                GError **error)
+{
+  struct xyt_struct *pstruct;
+  gint probe_len;
+  gint best = 0;
+  guint i;
+
+  g_return_val_if_fail (FP_IS_PRINT (probe), FALSE);
+  g_return_val_if_fail (FP_IS_PRINT (candidate), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (score)
+    *score = 0;
+
+  if (probe->type != FPI_PRINT_NBIS || candidate->type != FPI_PRINT_NBIS)
+    {
+      g_set_error (error, FP_DEVICE_ERROR, FP_DEVICE_ERROR_NOT_SUPPORTED,
+                   "It is only possible to match NBIS type print data");
+      return FALSE;
+    }
+
+  if (probe->prints->len != 1)
+    {
+      g_set_error (error, FP_DEVICE_ERROR, FP_DEVICE_ERROR_GENERAL,
+                   "Probe print contains more than one print!");
+      return FALSE;
+    }
+
+  fpi_print_ensure_views (probe);
+  fpi_print_ensure_views (candidate);
+
+  pstruct = g_ptr_array_index (probe->prints, 0);
+  probe_len = bozorth_probe_init (pstruct);
+
+  for (i = 0; i < candidate->prints->len; i++)
+    {
+      struct xyt_struct *gstruct = g_ptr_array_index (candidate->prints, i);
+      struct bz_edge_table *table;
+      gint view_score;
+
+      table = fpi_print_get_edge_table (candidate, i);
+      if (table)
+        view_score = bozorth_to_gallery_prepared_threshold (probe_len, pstruct,
+                                                            gstruct, table,
+                                                            threshold);
+      else
+        view_score = bozorth_to_gallery_threshold (probe_len, pstruct, gstruct,
+                                                   threshold);
+
+      best = MAX (best, view_score);
+      if (best >= threshold)
+        break;
+    }
+
+  if (score)
+    *score = best;
+
+  return best >= threshold;
+}
+
+/* Deduplication key of view @idx of @print for the canonical maps
+ * below. Lazily loaded prints are keyed by their shared payload handle,
+ * since their view pointers start out as placeholders and only become
+ * meaningful on materialization; everything else by the view itself. */
+static gpointer
+bz3_canonical_key (FpPrint *print, guint idx)
+{
+  if (print->lazy_data)
+    return print->lazy_data;
+
+  return g_ptr_array_index (print->prints, idx);
+}
+
+typedef struct
+{
+  gint               ref_count; /* Caller plus one reference per worker */
+
+  struct xyt_struct *probe;
+  Bz3Prefilter       probe_filter;
+  FpPrint           *print;     /* Owns @probe */
+  GPtrArray         *templates;
+  gint               bz3_threshold;
+
+  /* First template carrying each distinct xyt table, so templates that
+   * share tables (metadata copies from a deduplicated gallery file) are
+   * scored once. Read-only once the workers start. */
+  GHashTable        *canonical;
+
+  gint               next;    /* Next template index to claim (atomic) */
+  gint               matched; /* Matched template index, or -1 (atomic) */
+
+  GMutex             lock;
+  GCond              cond;
+  guint              pending; /* Workers that have not finished yet */
+} Bz3GalleryJob;
+
+static Bz3GalleryJob *
+bz3_gallery_job_ref (Bz3GalleryJob *job)
+{
+  g_atomic_int_inc (&job->ref_count);
+  return job;
+}
+
+static void
+bz3_gallery_job_unref (Bz3GalleryJob *job)
+{
+  if (!g_atomic_int_dec_and_test (&job->ref_count))
+    return;
+
+  g_ptr_array_unref (job->templates);
+  g_object_unref (job->print);
+  g_hash_table_unref (job->canonical);
+  g_mutex_clear (&job->lock);
+  g_cond_clear (&job->cond);
+  g_free (job);
+}
+
+static void
+bz3_gallery_worker (gpointer data, gpointer user_data)
+{
+  Bz3GalleryJob *job = data;
+  gint probe_len;
+  gint i;
+
+  /* The bozorth scratch tables are thread-local, so every worker needs to
+   * build its own probe comparison table before scanning the gallery. */
+  probe_len = bozorth_probe_init (job->probe);
+
+  while (g_atomic_int_get (&job->matched) < 0 &&
+         (i = g_atomic_int_add (&job->next, 1)) < (gint) job->templates->len)
+    {
+      FpPrint *template = g_ptr_array_index (job->templates, i);
+      gint j;
+
+      for (j = 0; j < template->prints->len; j++)
+        {
+          struct xyt_struct *gstruct;
+          struct bz_edge_table *table;
+          gint score;
+
+          /* Metadata copies of a deduplicated gallery print share their
+           * mapped xyt tables; only the first copy gets scored. */
+          if (g_hash_table_lookup (job->canonical,
+                                   bz3_canonical_key (template, j)) != (gpointer) template)
+            continue;
+
+          /* Workers claim whole templates, so no two threads build the
+           * same template's tables concurrently. */
+          if (bz3_prefilter_compare (&job->probe_filter,
+                                     fpi_print_get_prefilter (template, j)) < BZ3_PREFILTER_THRESHOLD)
+            continue;
+
+          /* Only plausible candidates get this far; materialize the
+           * views of lazily loaded templates now. */
+          fpi_print_ensure_views (template);
+          gstruct = g_ptr_array_index (template->prints, j);
+
+          table = fpi_print_get_edge_table (template, j);
+          if (table)
+            score = bozorth_to_gallery_prepared_threshold (probe_len, job->probe,
+                                                           gstruct, table,
+                                                           job->bz3_threshold);
+          else
+            score = bozorth_to_gallery_threshold (probe_len, job->probe, gstruct,
+                                                  job->bz3_threshold);
+
+          fp_dbg ("template %d: score %d/%d", i, score, job->bz3_threshold);
+
+          if (score >= job->bz3_threshold)
+            {
+              /* Remaining shards see this and stop early.  Wake the
+               * caller right away so it can report the match while the
+               * other shards wind down in the background. */
+              g_atomic_int_compare_and_exchange (&job->matched, -1, i);
+              g_mutex_lock (&job->lock);
+              g_cond_signal (&job->cond);
+              g_mutex_unlock (&job->lock);
+              break;
+            }
+        }
+    }
+
+  g_mutex_lock (&job->lock);
+  job->pending--;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+
+  bz3_gallery_job_unref (job);
+}
+
+/**
+ * fpi_print_bz3_match_gallery:
+ * @templates: Array of #FpPrint gallery templates to scan
+ * @print: A newly scanned #FpPrint to test
+ * @bz3_threshold: The BZ3 match threshold
+ * @matched: (out) (transfer none): Location to store the matched template, or %NULL
+ * @error: Return location for error
+ *
+ * Match the newly scanned @print against every template in @templates,
+ * sharding the gallery across a thread pool. This returns the moment
+ * any template scores above @bz3_threshold: the remaining shards notice
+ * the match and wind down in the background, holding their own
+ * references on @print and @templates, so the caller is not charged for
+ * whatever template each shard was still scoring. Which of several
+ * possible matches is reported is unspecified in that case.
+ *
+ * Small galleries are matched serially to avoid the pool overhead.
+ *
+ * If the optional negative-result cache is enabled (FP_NEGATIVE_CACHE
+ * environment variable), a probe that looks near-identical to one that
+ * recently failed against the same @templates array is only re-scored
+ * against the templates its prefilter deemed plausible back then,
+ * bounding the cost of repeatedly presenting an unenrolled finger.
+ *
+ * Returns: Whether any template matched, @error will be set if #FPI_MATCH_ERROR is returned
+ */
+FpiMatchResult
+fpi_print_bz3_match_gallery (GPtrArray *templates,
+                             FpPrint   *print,
+                             gint       bz3_threshold,
+                             FpPrint  **matched,
+                             GError   **error)
+{
+  static GThreadPool *pool = NULL;
+  Bz3GalleryJob *job;
+  GArray *neg_candidates = NULL;
+  guint64 neg_key = 0;
+  gint matched_idx;
+  guint n_workers;
+  guint i;
+
+  if (matched)
+    *matched = NULL;
+
+  if (print->type != FPI_PRINT_NBIS)
+    {
+      *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                         "It is only possible to match NBIS type print data");
+      return FPI_MATCH_ERROR;
+    }
+
+  if (print->prints->len != 1)
+    {
+      *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_GENERAL,
+                                         "New print contains more than one print!");
+      return FPI_MATCH_ERROR;
+    }
+
+  for (i = 0; i < templates->len; i++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, i);
+
+      if (template->type != FPI_PRINT_NBIS)
+        {
+          *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                             "It is only possible to match NBIS type print data");
+          return FPI_MATCH_ERROR;
+        }
+    }
+
+  if (neg_cache_get_capacity () > 0)
+    {
+      Bz3Prefilter probe_filter;
+
+      bz3_prefilter_build (g_ptr_array_index (print->prints, 0), &probe_filter);
+      neg_key = bz3_prefilter_lsh (&probe_filter);
+
+      neg_candidates = neg_cache_lookup (neg_key, templates);
+      if (neg_candidates)
+        {
+          /* A near-identical probe was just rejected against this very
+           * gallery; only re-score the templates that were plausible
+           * back then. */
+          fp_dbg ("negative cache hit, scoring %u of %u templates",
+                  neg_candidates->len, templates->len);
+
+          for (i = 0; i < neg_candidates->len; i++)
+            {
+              guint idx = g_array_index (neg_candidates, guint, i);
+              FpPrint *template = g_ptr_array_index (templates, idx);
+              FpiMatchResult result;
+
+              result = fpi_print_bz3_match (template, print, bz3_threshold, error);
+              if (result == FPI_MATCH_SUCCESS)
+                {
+                  neg_cache_remove (neg_key, templates);
+                  if (matched)
+                    *matched = template;
+                }
+              if (result != FPI_MATCH_FAIL)
+                {
+                  g_array_unref (neg_candidates);
+                  return result;
+                }
+            }
+
+          g_array_unref (neg_candidates);
+          return FPI_MATCH_FAIL;
+        }
+    }
+
+  n_workers = MIN (templates->len, g_get_num_processors ());
+
+  if (n_workers <= 1)
+    {
+      /* Serial fallback, identical to looping fpi_print_bz3_match(). */
+      for (i = 0; i < templates->len; i++)
+        {
+          FpPrint *template = g_ptr_array_index (templates, i);
+          FpiMatchResult result;
+
+          if (fpi_print_prefilter_score (template, print) < BZ3_PREFILTER_THRESHOLD)
+            continue;
+
+          result = fpi_print_bz3_match (template, print, bz3_threshold, error);
+          if (result == FPI_MATCH_SUCCESS && matched)
+            *matched = template;
+          if (result != FPI_MATCH_FAIL)
+            return result;
+        }
+
+      if (neg_key)
+        neg_cache_store (neg_key, templates, print);
+      return FPI_MATCH_FAIL;
+    }
+
+  if (g_once_init_enter (&pool))
+    g_once_init_leave (&pool,
+                       g_thread_pool_new (bz3_gallery_worker, NULL,
+                                          g_get_num_processors (),
+                                          FALSE, NULL));
+
+  job = g_new0 (Bz3GalleryJob, 1);
+  job->ref_count = 1;
+  job->probe = g_ptr_array_index (print->prints, 0);
+  bz3_prefilter_build (job->probe, &job->probe_filter);
+  job->print = g_object_ref (print);
+  job->templates = g_ptr_array_ref (templates);
+  job->bz3_threshold = bz3_threshold;
+  job->canonical = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < templates->len; i++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, i);
+      guint j;
+
+      for (j = 0; j < template->prints->len; j++)
+        {
+          gpointer key = bz3_canonical_key (template, j);
+
+          if (!g_hash_table_contains (job->canonical, key))
+            g_hash_table_insert (job->canonical, key, template);
+        }
+    }
+  job->next = 0;
+  job->matched = -1;
+  job->pending = n_workers;
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->cond);
+
+  for (i = 0; i < n_workers; i++)
+    g_thread_pool_push (pool, bz3_gallery_job_ref (job), NULL);
+
+  /* Wait for either a match or all shards to come up empty; on a match
+   * the remaining shards wind down on their own and drop their job
+   * references once done. */
+  g_mutex_lock (&job->lock);
+  while (g_atomic_int_get (&job->matched) < 0 && job->pending > 0)
+    g_cond_wait (&job->cond, &job->lock);
+  g_mutex_unlock (&job->lock);
+
+  matched_idx = g_atomic_int_get (&job->matched);
+  bz3_gallery_job_unref (job);
+
+  if (matched_idx >= 0)
+    {
+      if (matched)
+        *matched = g_ptr_array_index (templates, matched_idx);
+      return FPI_MATCH_SUCCESS;
+    }
+
+  if (neg_key)
+    neg_cache_store (neg_key, templates, print);
+  return FPI_MATCH_FAIL;
+}
+
+typedef struct
+{
+  FpPrint *template;
+  gint     score;
+} Bz3RankEntry;
+
+/* Bounded partial selection: keep the best @max entries sorted in
+ * descending score order, rejecting anything below the current cutoff
+ * in O(1), so ranking never pays for a full sort of the gallery. */
+static void
+bz3_rank_insert (Bz3RankEntry *top,
+                 guint        *n_top,
+                 guint         max,
+                 FpPrint      *template,
+                 gint          score)
+{
+  guint i, j;
+
+  if (*n_top == max && score <= top[*n_top - 1].score)
+    return;
+
+  for (i = 0; i < *n_top; i++)
+    if (score > top[i].score)
+      break;
+
+  if (*n_top < max)
+    (*n_top)++;
+
+  for (j = *n_top - 1; j > i; j--)
+    top[j] = top[j - 1];
+
+  top[i].template = template;
+  top[i].score = score;
+}
+
+typedef struct
+{
+  gint               ref_count; /* Caller plus one reference per worker */
+
+  struct xyt_struct *probe;
+  Bz3Prefilter       probe_filter;
+  FpPrint           *print;     /* Owns @probe */
+  GPtrArray         *templates;
+  guint              max_candidates;
+
+  /* See Bz3GalleryJob; deduplicated gallery copies are scored once. */
+  GHashTable        *canonical;
+
+  gint               next;      /* Next template index to claim (atomic) */
+
+  GMutex             lock;
+  GCond              cond;
+  guint              pending;   /* Workers that have not finished yet */
+
+  /* Global top list; finishing workers merge their local list into it
+   * under @lock. */
+  Bz3RankEntry      *top;
+  guint              n_top;
+} Bz3RankJob;
+
+static Bz3RankJob *
+bz3_rank_job_ref (Bz3RankJob *job)
+{
+  g_atomic_int_inc (&job->ref_count);
+  return job;
+}
+
+static void
+bz3_rank_job_unref (Bz3RankJob *job)
+{
+  if (!g_atomic_int_dec_and_test (&job->ref_count))
+    return;
+
+  g_ptr_array_unref (job->templates);
+  g_object_unref (job->print);
+  g_hash_table_unref (job->canonical);
+  g_free (job->top);
+  g_mutex_clear (&job->lock);
+  g_cond_clear (&job->cond);
+  g_free (job);
+}
+
+/* Best bozorth score of one template against the prepared probe; -1
+ * when every view was skipped by the prefilter or deduplication. */
+static gint
+bz3_rank_template_score (FpPrint            *template,
+                         struct xyt_struct  *probe,
+                         gint                probe_len,
+                         const Bz3Prefilter *probe_filter,
+                         GHashTable         *canonical)
+{
+  gint best = -1;
+  guint j;
+
+  for (j = 0; j < template->prints->len; j++)
+    {
+      struct xyt_struct *gstruct;
+      struct bz_edge_table *table;
+      gint score;
+
+      if (canonical &&
+          g_hash_table_lookup (canonical,
+                               bz3_canonical_key (template, j)) != (gpointer) template)
+        continue;
+
+      if (bz3_prefilter_compare (probe_filter,
+                                 fpi_print_get_prefilter (template, j)) < BZ3_PREFILTER_THRESHOLD)
+        continue;
+
+      fpi_print_ensure_views (template);
+      gstruct = g_ptr_array_index (template->prints, j);
+
+      table = fpi_print_get_edge_table (template, j);
+      if (table)
+        score = bozorth_to_gallery_prepared (probe_len, probe, gstruct, table);
+      else
+        score = bozorth_to_gallery (probe_len, probe, gstruct);
+
+      best = MAX (best, score);
+    }
+
+  return best;
+}
+
+static void
+bz3_rank_worker (gpointer data, gpointer user_data)
+{
+  Bz3RankJob *job = data;
+  g_autofree Bz3RankEntry *local = NULL;
+  guint n_local = 0;
+  gint probe_len;
+  guint i;
+  gint idx;
+
+  local = g_new0 (Bz3RankEntry, job->max_candidates);
+  probe_len = bozorth_probe_init (job->probe);
+
+  while ((idx = g_atomic_int_add (&job->next, 1)) < (gint) job->templates->len)
+    {
+      FpPrint *template = g_ptr_array_index (job->templates, idx);
+      gint score;
+
+      score = bz3_rank_template_score (template, job->probe, probe_len,
+                                       &job->probe_filter, job->canonical);
+      if (score > 0)
+        bz3_rank_insert (local, &n_local, job->max_candidates,
+                         template, score);
+    }
+
+  g_mutex_lock (&job->lock);
+  for (i = 0; i < n_local; i++)
+    bz3_rank_insert (job->top, &job->n_top, job->max_candidates,
+                     local[i].template, local[i].score);
+  job->pending--;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+
+  bz3_rank_job_unref (job);
+}
+
+static void
+fp_identify_candidate_free (gpointer data)
+{
+  FpIdentifyCandidate *candidate = data;
+
+  g_object_unref (candidate->print);
+  g_free (candidate);
+}
+
+/**
+ * fpi_print_bz3_rank_gallery:
+ * @templates: Array of #FpPrint gallery templates to scan
+ * @print: A newly scanned #FpPrint to test
+ * @bz3_threshold: The BZ3 match threshold
+ * @max_candidates: Maximum number of candidates to return, at least 1
+ * @matched: (out) (transfer none): Location to store the matched template, or %NULL
+ * @error: Return location for error
+ *
+ * Score @print against every template in @templates and return the
+ * @max_candidates best as #FpIdentifyCandidate entries, highest score
+ * first. Unlike fpi_print_bz3_match_gallery() this cannot stop at the
+ * first template above @bz3_threshold, since ranking needs the whole
+ * gallery scored; the threshold only decides whether the best
+ * candidate is also reported through @matched. Templates rejected by
+ * the bozorth prefilter are treated as scoring zero and never ranked.
+ *
+ * The gallery is sharded across the same thread pool as
+ * fpi_print_bz3_match_gallery(); each shard keeps a bounded
+ * partial-selection list of @max_candidates entries, so no full sort
+ * of the gallery scores ever happens.
+ *
+ * Returns: (transfer full) (element-type FpIdentifyCandidate): The
+ *    ranked candidates, or %NULL with @error set
+ */
+GPtrArray *
+fpi_print_bz3_rank_gallery (GPtrArray *templates,
+                            FpPrint   *print,
+                            gint       bz3_threshold,
+                            guint      max_candidates,
+                            FpPrint  **matched,
+                            GError   **error)
+{
+  static GThreadPool *pool = NULL;
+  g_autoptr(GPtrArray) candidates = NULL;
+  Bz3RankJob *job;
+  guint n_workers;
+  guint i;
+
+  if (matched)
+    *matched = NULL;
+
+  g_return_val_if_fail (max_candidates > 0, NULL);
+
+  if (print->type != FPI_PRINT_NBIS)
+    {
+      *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                         "It is only possible to match NBIS type print data");
+      return NULL;
+    }
+
+  if (print->prints->len != 1)
+    {
+      *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_GENERAL,
+                                         "New print contains more than one print!");
+      return NULL;
+    }
+
+  for (i = 0; i < templates->len; i++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, i);
+
+      if (template->type != FPI_PRINT_NBIS)
+        {
+          *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                             "It is only possible to match NBIS type print data");
+          return NULL;
+        }
+    }
+
+  job = g_new0 (Bz3RankJob, 1);
+  job->ref_count = 1;
+  job->probe = g_ptr_array_index (print->prints, 0);
+  bz3_prefilter_build (job->probe, &job->probe_filter);
+  job->print = g_object_ref (print);
+  job->templates = g_ptr_array_ref (templates);
+  job->max_candidates = max_candidates;
+  job->canonical = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < templates->len; i++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, i);
+      guint j;
+
+      for (j = 0; j < template->prints->len; j++)
+        {
+          gpointer key = bz3_canonical_key (template, j);
+
+          if (!g_hash_table_contains (job->canonical, key))
+            g_hash_table_insert (job->canonical, key, template);
+        }
+    }
+  job->next = 0;
+  job->top = g_new0 (Bz3RankEntry, max_candidates);
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->cond);
+
+  n_workers = MIN (templates->len, g_get_num_processors ());
+
+  if (n_workers <= 1)
+    {
+      job->pending = 1;
+      bz3_rank_job_ref (job);
+      bz3_rank_worker (job, NULL);
+    }
+  else
+    {
+      if (g_once_init_enter (&pool))
+        g_once_init_leave (&pool,
+                           g_thread_pool_new (bz3_rank_worker, NULL,
+                                              g_get_num_processors (),
+                                              FALSE, NULL));
+
+      job->pending = n_workers;
+      for (i = 0; i < n_workers; i++)
+        g_thread_pool_push (pool, bz3_rank_job_ref (job), NULL);
+
+      g_mutex_lock (&job->lock);
+      while (job->pending > 0)
+        g_cond_wait (&job->cond, &job->lock);
+      g_mutex_unlock (&job->lock);
+    }
+
+  candidates = g_ptr_array_new_full (job->n_top, fp_identify_candidate_free);
+  for (i = 0; i < job->n_top; i++)
+    {
+      FpIdentifyCandidate *candidate = g_new0 (FpIdentifyCandidate, 1);
+
+      candidate->print = g_object_ref (job->top[i].template);
+      candidate->score = job->top[i].score;
+      g_ptr_array_add (candidates, candidate);
+    }
+
+  if (matched && job->n_top > 0 && job->top[0].score >= bz3_threshold)
+    *matched = job->top[0].template;
+
+  bz3_rank_job_unref (job);
+
+  return g_steal_pointer (&candidates);
+}
+
+/**
+ * fpi_print_bz3_match_multi:
+ * @probes: Array of newly scanned #FpPrint probes to test
+ * @templates: Array of #FpPrint gallery templates to scan
+ * @bz3_threshold: The BZ3 match threshold
+ * @matched_probe: (out) (transfer none): Location to store the best probe, or %NULL
+ * @matched_template: (out) (transfer none): Location to store the best template, or %NULL
+ * @error: Return location for error
+ *
+ * Score every probe in @probes against every template in @templates in
+ * one pass and report the best scoring (probe, template) pair. Callers
+ * that capture several frames per presentation can submit them all at
+ * once instead of re-walking the gallery per frame; the pairwise
+ * comparison tables of both sides are built once and reloaded per
+ * pairing, so the quadratic bozorth init cost is paid once per print
+ * rather than once per pairing.
+ *
+ * Unlike fpi_print_bz3_match_gallery() this does not stop at the first
+ * template above the threshold, since the whole point is to find the
+ * best pair.
+ *
+ * Returns: Whether the best pair matched, @error will be set if #FPI_MATCH_ERROR is returned
+ */
+FpiMatchResult
+fpi_print_bz3_match_multi (GPtrArray *probes,
+                           GPtrArray *templates,
+                           gint       bz3_threshold,
+                           FpPrint  **matched_probe,
+                           FpPrint  **matched_template,
+                           GError   **error)
+{
+  gint best_score = -1;
+  guint i, t;
+
+  if (matched_probe)
+    *matched_probe = NULL;
+  if (matched_template)
+    *matched_template = NULL;
+
+  for (i = 0; i < probes->len; i++)
+    {
+      FpPrint *probe = g_ptr_array_index (probes, i);
+
+      if (probe->type != FPI_PRINT_NBIS)
+        {
+          *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                             "It is only possible to match NBIS type print data");
+          return FPI_MATCH_ERROR;
+        }
+
+      if (probe->prints->len != 1)
+        {
+          *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_GENERAL,
+                                             "New print contains more than one print!");
+          return FPI_MATCH_ERROR;
+        }
+    }
+
+  for (t = 0; t < templates->len; t++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, t);
+
+      if (template->type != FPI_PRINT_NBIS)
+        {
+          *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                             "It is only possible to match NBIS type print data");
+          return FPI_MATCH_ERROR;
+        }
+    }
+
+  for (i = 0; i < probes->len; i++)
+    {
+      FpPrint *probe = g_ptr_array_index (probes, i);
+      struct xyt_struct *pstruct = g_ptr_array_index (probe->prints, 0);
+      struct bz_edge_table *ptable;
+      gint probe_len;
+
+      ptable = fpi_print_get_edge_table (probe, 0);
+      if (ptable)
+        probe_len = bozorth_probe_init_from_table (ptable);
+      else
+        probe_len = bozorth_probe_init (pstruct);
+
+      for (t = 0; t < templates->len; t++)
+        {
+          FpPrint *template = g_ptr_array_index (templates, t);
+          guint j;
+
+          for (j = 0; j < template->prints->len; j++)
+            {
+              struct xyt_struct *gstruct;
+              struct bz_edge_table *table;
+              gint score;
+
+              if (bz3_prefilter_compare (fpi_print_get_prefilter (probe, 0),
+                                         fpi_print_get_prefilter (template, j)) < BZ3_PREFILTER_THRESHOLD)
+                continue;
+
+              fpi_print_ensure_views (template);
+              gstruct = g_ptr_array_index (template->prints, j);
+
+              table = fpi_print_get_edge_table (template, j);
+              if (table)
+                score = bozorth_to_gallery_prepared_threshold (probe_len, pstruct,
+                                                               gstruct, table,
+                                                               bz3_threshold);
+              else
+                score = bozorth_to_gallery_threshold (probe_len, pstruct, gstruct,
+                                                      bz3_threshold);
+
+              if (score > best_score)
+                {
+                  best_score = score;
+                  if (matched_probe)
+                    *matched_probe = probe;
+                  if (matched_template)
+                    *matched_template = template;
+                }
+            }
+        }
+    }
+
+  fp_dbg ("best score %d/%d", best_score, bz3_threshold);
+
+  if (best_score >= bz3_threshold)
+    return FPI_MATCH_SUCCESS;
+
+  if (matched_probe)
+    *matched_probe = NULL;
+  if (matched_template)
+    *matched_template = NULL;
+
+  return FPI_MATCH_FAIL;
+}
+
+/**
+ * fpi_print_bz3_find_duplicate:
+ * @templates: Array of #FpPrint to screen against
+ * @print: A newly scanned #FpPrint to test
+ * @bz3_threshold: The BZ3 match threshold
+ *
+ * Cheaply screen a freshly scanned @print for a duplicate among
+ * @templates. Every pairing is ranked by its prefilter score only, and a
+ * single full bozorth comparison confirms the best-ranked candidate.
+ * Unlike fpi_print_bz3_match_gallery() this never scores more than one
+ * pairing, so the cost stays flat as the gallery grows; the price is
+ * that a duplicate hiding behind a better-ranked impostor is missed.
+ * That trade is fine for its purpose — refusing the common case of
+ * re-enrolling an already enrolled finger — and wrong for
+ * identification, which must not miss matches.
+ *
+ * The screen is best effort: non-NBIS templates are skipped rather than
+ * reported as errors.
+ *
+ * Returns: (transfer none) (nullable): The duplicate template, or %NULL
+ */
+FpPrint *
+fpi_print_bz3_find_duplicate (GPtrArray *templates,
+                              FpPrint   *print,
+                              gint       bz3_threshold)
+{
+  FpPrint *best_template = NULL;
+  struct xyt_struct *pstruct;
+  struct xyt_struct *gstruct;
+  struct bz_edge_table *table;
+  gint best_score = -1;
+  guint best_view = 0;
+  gint probe_len, score;
+  guint t, j;
+
+  if (print->type != FPI_PRINT_NBIS || print->prints->len != 1)
+    return NULL;
+
+  for (t = 0; t < templates->len; t++)
+    {
+      FpPrint *template = g_ptr_array_index (templates, t);
+
+      if (template->type != FPI_PRINT_NBIS)
+        continue;
+
+      for (j = 0; j < template->prints->len; j++)
+        {
+          score = bz3_prefilter_compare (fpi_print_get_prefilter (print, 0),
+                                         fpi_print_get_prefilter (template, j));
+          if (score > best_score)
+            {
+              best_score = score;
+              best_template = template;
+              best_view = j;
+            }
+        }
+    }
+
+  if (!best_template || best_score < BZ3_PREFILTER_THRESHOLD)
+    return NULL;
+
+  pstruct = g_ptr_array_index (print->prints, 0);
+  probe_len = bozorth_probe_init (pstruct);
+
+  fpi_print_ensure_views (best_template);
+  gstruct = g_ptr_array_index (best_template->prints, best_view);
+  table = fpi_print_get_edge_table (best_template, best_view);
+  if (table)
+    score = bozorth_to_gallery_prepared_threshold (probe_len, pstruct, gstruct,
+                                                   table, bz3_threshold);
+  else
+    score = bozorth_to_gallery_threshold (probe_len, pstruct, gstruct,
+                                          bz3_threshold);
+  fp_dbg ("duplicate screen score %d/%d", score, bz3_threshold);
+
+  return score >= bz3_threshold ? best_template : NULL;
+}
+
 /**
  * fpi_print_generate_user_id:
  * @print: #FpPrint to generate the ID for
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fpi-enums.h"
+#include "fpi-byte-writer.h"
 #include "fp-device.h"
 #include "fp-print.h"
 
@@ -38,15 +39,78 @@ void     fpi_print_set_type (FpPrint     *print,
 void     fpi_print_set_device_stored (FpPrint *print,
                                       gboolean device_stored);
 
+gboolean fpi_print_serialize_to_writer (FpPrint       *print,
+                                        FpiByteWriter *writer);
+
 gboolean fpi_print_add_from_image (FpPrint *print,
                                    FpImage *image,
                                    GError **error);
 
+void     fpi_print_drop_image (FpPrint *print);
+
+void     fpi_print_consolidate (FpPrint *print);
+
+/**
+ * FpiPrintLazyFunc:
+ * @print: The #FpPrint whose views are needed
+ * @user_data: The data passed to fpi_print_set_lazy_views()
+ *
+ * Callback installing the deferred minutiae views of @print, see
+ * fpi_print_set_lazy_views().
+ */
+typedef void (*FpiPrintLazyFunc) (FpPrint *print,
+                                  gpointer user_data);
+
+void     fpi_print_set_lazy_views (FpPrint         *print,
+                                   guint            n_views,
+                                   FpiPrintLazyFunc materialize,
+                                   gpointer         user_data,
+                                   GDestroyNotify   destroy);
+
+void     fpi_print_ensure_views (FpPrint *print);
+
+gsize    fpi_print_prefilter_size (void);
+
+void     fpi_print_export_prefilters (FpPrint    *print,
+                                      GByteArray *buffer);
+
+void     fpi_print_import_prefilters (FpPrint      *print,
+                                      const guint8 *data);
+
+gint fpi_print_prefilter_score (FpPrint *temp,
+                                FpPrint *print);
+
+void fpi_print_prewarm (FpPrint *print);
+
 FpiMatchResult fpi_print_bz3_match (FpPrint *temp,
                                     FpPrint *print,
                                     gint     bz3_threshold,
                                     GError **error);
 
+FpiMatchResult fpi_print_bz3_match_gallery (GPtrArray *templates,
+                                            FpPrint   *print,
+                                            gint       bz3_threshold,
+                                            FpPrint  **matched,
+                                            GError   **error);
+
+GPtrArray *fpi_print_bz3_rank_gallery (GPtrArray *templates,
+                                       FpPrint   *print,
+                                       gint       bz3_threshold,
+                                       guint      max_candidates,
+                                       FpPrint  **matched,
+                                       GError   **error);
+
+FpiMatchResult fpi_print_bz3_match_multi (GPtrArray *probes,
+                                          GPtrArray *templates,
+                                          gint       bz3_threshold,
+                                          FpPrint  **matched_probe,
+                                          FpPrint  **matched_template,
+                                          GError   **error);
+
+FpPrint *fpi_print_bz3_find_duplicate (GPtrArray *templates,
+                                       FpPrint   *print,
+                                       gint       bz3_threshold);
+
 /* Helpers to encode metadata into user ID strings. */
 gchar *  fpi_print_generate_user_id (FpPrint *print);
 gboolean fpi_print_fill_from_user_id (FpPrint    *print,
@@ -0,0 +1,55 @@
+/*
+ * FPrint SIMD dispatch helpers
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "simd"
+
+#include "fpi-simd.h"
+#include "fpi-log.h"
+
+/**
+ * fpi_simd_init:
+ *
+ * Logs the SIMD capabilities the imaging kernels will dispatch on.
+ * The multi-versioned kernels resolve themselves on first call; this
+ * only exists so a debug log of a slow device shows which variants a
+ * machine is getting. Called once from the #FpContext initialization.
+ */
+void
+fpi_simd_init (void)
+{
+  static gsize once = 0;
+
+  if (!g_once_init_enter (&once))
+    return;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init ();
+  g_debug ("x86-64 imaging kernels: baseline SSE2%s%s",
+           __builtin_cpu_supports ("avx2") ? ", AVX2 variants selected" : "",
+           FPI_SIMD_HAVE_CLONES ? "" : " (multi-versioning not built)");
+#elif defined(__aarch64__)
+  g_debug ("AArch64 imaging kernels: NEON (baseline)");
+#elif defined(__ARM_NEON)
+  g_debug ("ARM imaging kernels: NEON (compile-time)");
+#else
+  g_debug ("Imaging kernels: portable scalar build");
+#endif
+
+  g_once_init_leave (&once, 1);
+}
@@ -0,0 +1,55 @@
+/*
+ * FPrint SIMD dispatch helpers
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/* Runtime ISA dispatch for the imaging kernels.
+ *
+ * The hot kernels in this tree (fpi-image.c, fpi-assembling.c, the NBIS
+ * binarization and morphology passes) are written as portable C shaped
+ * for the compiler's auto-vectorizer, with at most baseline SSE2/NEON
+ * intrinsics behind compile-time guards. Rather than duplicating each
+ * kernel per instruction set and selecting through function-pointer
+ * tables, dispatch uses compiler function multi-versioning: putting
+ * FPI_SIMD_CLONES on a kernel makes the compiler emit one variant per
+ * listed target plus the portable default, and the resolver picks the
+ * best one for the running CPU on first call. There is only ever one
+ * source-level implementation, so the variants cannot drift apart.
+ *
+ * The attribute expands to nothing where multi-versioning is not
+ * available (non-x86-64, non-glibc, older compilers); those builds get
+ * the single portable kernel exactly as before. On AArch64 NEON is part
+ * of the baseline, so there is nothing to dispatch on.
+ */
+
+#ifdef __has_attribute
+#if defined(__x86_64__) && defined(__GLIBC__) && __has_attribute (target_clones)
+#define FPI_SIMD_CLONES __attribute__((target_clones ("avx2", "default")))
+#define FPI_SIMD_HAVE_CLONES 1
+#endif
+#endif
+
+#ifndef FPI_SIMD_CLONES
+#define FPI_SIMD_CLONES
+#define FPI_SIMD_HAVE_CLONES 0
+#endif
+
+void fpi_simd_init (void);
@@ -27,6 +27,10 @@
 #define SPIDEV_BLOCK_SIZE_FALLBACK 4096
 static gsize block_size = 0;
 
+/* Maximum number of spi_ioc_transfer elements per SPI_IOC_MESSAGE ioctl
+ * when submitting batched transfers. */
+#define SPI_TRANSFER_BATCH_SIZE 16
+
 /**
  * SECTION:fpi-spi-transfer
  * @title: SPI transfer helpers
@@ -37,6 +41,8 @@ static gsize block_size = 0;
  * and provide a usable asynchronous API to libfprint drivers.
  *
  * Currently only transfers with a write and subsequent read are supported.
+ * Multiple transfers can be batched into a single ioctl using
+ * fpi_spi_transfer_append().
  *
  * Drivers should always use this API rather than calling read/write/ioctl on
  * the spidev device.
@@ -48,6 +54,50 @@ static gsize block_size = 0;
 
 G_DEFINE_BOXED_TYPE (FpiSpiTransfer, fpi_spi_transfer, fpi_spi_transfer_ref, fpi_spi_transfer_unref)
 
+static void
+ensure_block_size (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = NULL;
+
+  if (G_LIKELY (block_size != 0))
+    return;
+
+  block_size = SPIDEV_BLOCK_SIZE_FALLBACK;
+
+  if (g_file_get_contents (SPIDEV_BLOCK_SIZE_PARAM, &contents, NULL, &error))
+    {
+      block_size = MIN (g_ascii_strtoull (contents, NULL, 0), G_MAXUINT16);
+      if (block_size == 0)
+        {
+          block_size = SPIDEV_BLOCK_SIZE_FALLBACK;
+          g_warning ("spidev blocksize could not be decoded, using %" G_GSIZE_FORMAT, block_size);
+        }
+    }
+  else
+    {
+      g_message ("Failed to read spidev block size, using %" G_GSIZE_FORMAT, block_size);
+    }
+}
+
+/**
+ * fpi_spi_transfer_block_size:
+ *
+ * Get the largest transfer the spidev driver accepts per
+ * spi_ioc_transfer element, as read from the module's bufsiz parameter.
+ * Drivers can use this to size batched reads to the biggest burst the
+ * kernel will take in one ioctl.
+ *
+ * Returns: The spidev block size in bytes
+ */
+gsize
+fpi_spi_transfer_block_size (void)
+{
+  ensure_block_size ();
+
+  return block_size;
+}
+
 static void
 dump_buffer (guchar *buf, gssize dump_len)
 {
@@ -72,8 +122,10 @@ dump_buffer (guchar *buf, gssize dump_len)
 static void
 log_transfer (FpiSpiTransfer *transfer, gboolean submit, GError *error)
 {
-  if (g_getenv ("FP_DEBUG_TRANSFER"))
+  for (; transfer; transfer = transfer->next)
     {
+      if (!g_getenv ("FP_DEBUG_TRANSFER"))
+        return;
       if (submit)
         {
           g_debug ("Transfer %p submitted, write length %zd, read length %zd",
@@ -119,27 +171,7 @@ fpi_spi_transfer_new (FpDevice * device, int spidev_fd)
 
   g_assert (FP_IS_DEVICE (device));
 
-  if (G_UNLIKELY (block_size == 0))
-    {
-      g_autoptr(GError) error = NULL;
-      g_autofree char *contents = NULL;
-
-      block_size = SPIDEV_BLOCK_SIZE_FALLBACK;
-
-      if (g_file_get_contents (SPIDEV_BLOCK_SIZE_PARAM, &contents, NULL, &error))
-        {
-          block_size = MIN (g_ascii_strtoull (contents, NULL, 0), G_MAXUINT16);
-          if (block_size == 0)
-            {
-              block_size = SPIDEV_BLOCK_SIZE_FALLBACK;
-              g_warning ("spidev blocksize could not be decoded, using %" G_GSIZE_FORMAT, block_size);
-            }
-        }
-      else
-        {
-          g_message ("Failed to read spidev block size, using %" G_GSIZE_FORMAT, block_size);
-        }
-    }
+  ensure_block_size ();
 
   self = g_slice_new0 (FpiSpiTransfer);
   self->ref_count = 1;
@@ -167,6 +199,8 @@ fpi_spi_transfer_free (FpiSpiTransfer *self)
   self->buffer_wr = NULL;
   self->buffer_rd = NULL;
 
+  g_clear_pointer (&self->next, fpi_spi_transfer_unref);
+
   g_slice_free (FpiSpiTransfer, self);
 }
 
@@ -293,6 +327,37 @@ fpi_spi_transfer_read_full (FpiSpiTransfer *transfer,
   transfer->free_buffer_rd = free_func;
 }
 
+/**
+ * fpi_spi_transfer_append:
+ * @transfer: The #FpiSpiTransfer
+ * @next: (transfer full): The #FpiSpiTransfer to run after @transfer
+ *
+ * Queue @next to be executed together with @transfer. Where possible the
+ * batched transfers are packed into a single spi_ioc_transfer array that
+ * is handed to the kernel in one %SPI_IOC_MESSAGE ioctl, with the chip
+ * being deselected in between; either way the whole batch costs only one
+ * worker thread round trip.
+ *
+ * Note that @next is stolen and completion (or the first error) is
+ * reported through the callback passed when submitting @transfer; any
+ * callback set on @next is ignored. Both transfers must target the same
+ * spidev device.
+ */
+void
+fpi_spi_transfer_append (FpiSpiTransfer *transfer,
+                         FpiSpiTransfer *next)
+{
+  g_return_if_fail (transfer);
+  g_return_if_fail (next);
+  g_return_if_fail (next->callback == NULL);
+  g_return_if_fail (transfer->spidev_fd == next->spidev_fd);
+
+  while (transfer->next)
+    transfer = transfer->next;
+
+  transfer->next = next;
+}
+
 static void
 transfer_finish_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
@@ -382,47 +447,226 @@ transfer_chunk (FpiSpiTransfer *transfer, gsize full_length, gsize *transferred)
   return status;
 }
 
-static void
-transfer_thread_func (GTask        *task,
-                      gpointer      source_object,
-                      gpointer      task_data,
-                      GCancellable *cancellable)
+static int
+transfer_batch (FpiSpiTransfer *transfer, FpiSpiTransfer **next_out)
+{
+  struct spi_ioc_transfer xfer[SPI_TRANSFER_BATCH_SIZE] = { 0 };
+  FpiSpiTransfer *link;
+  gsize len = 0;
+  int segments = 0;
+  int status;
+
+  for (link = transfer; link; link = link->next)
+    {
+      int needed = (link->buffer_wr ? 1 : 0) + (link->buffer_rd ? 1 : 0);
+      gsize link_len = 0;
+
+      if (link->buffer_wr)
+        link_len += link->length_wr;
+      if (link->buffer_rd)
+        link_len += link->length_rd;
+
+      /* The first transfer always fits (the caller checked the length),
+       * further ones are deferred to the next ioctl if needed. */
+      if (segments + needed > SPI_TRANSFER_BATCH_SIZE ||
+          len + link_len > block_size)
+        break;
+
+      /* Deselect the chip between two batched transfers. */
+      if (segments > 0)
+        xfer[segments - 1].cs_change = TRUE;
+
+      if (link->buffer_wr)
+        {
+          xfer[segments].tx_buf = (gsize) link->buffer_wr;
+          xfer[segments].len = link->length_wr;
+          segments += 1;
+        }
+      if (link->buffer_rd)
+        {
+          xfer[segments].rx_buf = (gsize) link->buffer_rd;
+          xfer[segments].len = link->length_rd;
+          segments += 1;
+        }
+
+      len += link_len;
+    }
+
+  g_assert (segments > 0);
+
+  /* This ioctl cannot be interrupted. */
+  status = ioctl (transfer->spidev_fd, SPI_IOC_MESSAGE (segments), xfer);
+
+  *next_out = link;
+  return status;
+}
+
+/* Execute @transfer (and its appended batch) on the calling thread. */
+static gboolean
+transfer_execute (FpiSpiTransfer *transfer, GError **error)
 {
-  FpiSpiTransfer *transfer = (FpiSpiTransfer *) task_data;
-  gsize full_length;
-  gsize transferred = 0;
+  FpiSpiTransfer *link;
   int status = 0;
 
-  if (transfer->buffer_wr == NULL && transfer->buffer_rd == NULL)
+  /* Sanity check the whole batch before touching the bus. */
+  for (link = transfer; link; link = link->next)
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVALID_ARGUMENT,
-                               "Transfer with neither write or read!");
-      return;
+      if (link->buffer_wr == NULL && link->buffer_rd == NULL)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_ARGUMENT,
+                       "Transfer with neither write or read!");
+          return FALSE;
+        }
     }
 
-  full_length = 0;
-  if (transfer->buffer_wr)
-    full_length += transfer->length_wr;
-  if (transfer->buffer_rd)
-    full_length += transfer->length_rd;
+  link = transfer;
+  while (link && status >= 0)
+    {
+      gsize full_length = 0;
+
+      if (link->buffer_wr)
+        full_length += link->length_wr;
+      if (link->buffer_rd)
+        full_length += link->length_rd;
 
-  while (transferred < full_length && status >= 0)
-    status = transfer_chunk (transfer, full_length, &transferred);
+      if (full_length > block_size)
+        {
+          /* Too long for a single message; split it over multiple ioctls. */
+          gsize transferred = 0;
+
+          while (transferred < full_length && status >= 0)
+            status = transfer_chunk (link, full_length, &transferred);
+
+          link = link->next;
+        }
+      else
+        {
+          status = transfer_batch (link, &link);
+        }
+    }
 
   if (status < 0)
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               g_io_error_from_errno (errno),
-                               "Error invoking ioctl for SPI transfer (%d)",
-                               errno);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Error invoking ioctl for SPI transfer (%d)",
+                   errno);
+      return FALSE;
     }
-  else
+
+  return TRUE;
+}
+
+/* Persistent per-device submission worker. Each device gets one thread
+ * consuming a FIFO queue, so transfers are executed strictly in
+ * submission order without the per-transfer thread-pool dispatch and
+ * wakeup of g_task_run_in_thread(). The worker lives until the device
+ * is finalized; pending async submissions keep the device alive through
+ * their GTask, so the queue is empty by then. */
+typedef struct
+{
+  GThread     *thread;
+  GAsyncQueue *queue;
+} SpiWorker;
+
+typedef struct
+{
+  /* Asynchronous submissions return through the task. */
+  GTask          *task;
+
+  /* Synchronous submissions are waited for by the caller. */
+  FpiSpiTransfer *transfer;
+  GError         *error;
+  gboolean        done;
+  GMutex          lock;
+  GCond           cond;
+} SpiWorkItem;
+
+#define SPI_WORKER_STOP ((gpointer) &spi_workers)
+
+static GMutex spi_workers_lock;
+static GHashTable *spi_workers; /* FpDevice * -> SpiWorker * */
+
+static void
+spi_work_item_run (SpiWorkItem *item)
+{
+  GError *error = NULL;
+
+  if (item->task)
     {
-      g_task_return_boolean (task, TRUE);
+      FpiSpiTransfer *transfer = g_task_get_task_data (item->task);
+
+      if (transfer_execute (transfer, &error))
+        g_task_return_boolean (item->task, TRUE);
+      else
+        g_task_return_error (item->task, error);
+
+      g_object_unref (item->task);
+      g_free (item);
+      return;
     }
+
+  transfer_execute (item->transfer, &item->error);
+
+  g_mutex_lock (&item->lock);
+  item->done = TRUE;
+  g_cond_signal (&item->cond);
+  g_mutex_unlock (&item->lock);
+}
+
+static gpointer
+spi_worker_thread (gpointer data)
+{
+  SpiWorker *worker = data;
+  gpointer item;
+
+  while ((item = g_async_queue_pop (worker->queue)) != SPI_WORKER_STOP)
+    spi_work_item_run (item);
+
+  return NULL;
+}
+
+static void
+spi_worker_device_gone (gpointer data, GObject *dead_device)
+{
+  SpiWorker *worker = data;
+
+  g_mutex_lock (&spi_workers_lock);
+  g_hash_table_remove (spi_workers, dead_device);
+  g_mutex_unlock (&spi_workers_lock);
+
+  g_async_queue_push (worker->queue, SPI_WORKER_STOP);
+  g_thread_join (worker->thread);
+  g_async_queue_unref (worker->queue);
+  g_free (worker);
+}
+
+static SpiWorker *
+spi_worker_for_device (FpDevice *device)
+{
+  SpiWorker *worker;
+
+  g_mutex_lock (&spi_workers_lock);
+
+  if (!spi_workers)
+    spi_workers = g_hash_table_new (NULL, NULL);
+
+  worker = g_hash_table_lookup (spi_workers, device);
+  if (!worker)
+    {
+      worker = g_new0 (SpiWorker, 1);
+      worker->queue = g_async_queue_new ();
+      worker->thread = g_thread_new ("spi-worker", spi_worker_thread, worker);
+      g_hash_table_insert (spi_workers, device, worker);
+      g_object_weak_ref (G_OBJECT (device), spi_worker_device_gone, worker);
+    }
+
+  g_mutex_unlock (&spi_workers_lock);
+
+  return worker;
 }
 
 /**
@@ -448,6 +692,7 @@ fpi_spi_transfer_submit (FpiSpiTransfer        *transfer,
                          gpointer               user_data)
 {
   g_autoptr(GTask) task = NULL;
+  SpiWorkItem *item;
 
   g_return_if_fail (transfer);
   g_return_if_fail (callback);
@@ -464,11 +709,15 @@ fpi_spi_transfer_submit (FpiSpiTransfer        *transfer,
                      cancellable,
                      transfer_finish_cb,
                      NULL);
+
+  item = g_new0 (SpiWorkItem, 1);
+  item->task = g_object_ref (task);
   g_task_set_task_data (task,
                         g_steal_pointer (&transfer),
                         (GDestroyNotify) fpi_spi_transfer_unref);
 
-  g_task_run_in_thread (task, transfer_thread_func);
+  g_async_queue_push (spi_worker_for_device (g_task_get_source_object (task))->queue,
+                      item);
 }
 
 /**
@@ -488,7 +737,7 @@ gboolean
 fpi_spi_transfer_submit_sync (FpiSpiTransfer *transfer,
                               GError        **error)
 {
-  g_autoptr(GTask) task = NULL;
+  SpiWorkItem item = { NULL, };
   GError *err = NULL;
   gboolean res;
 
@@ -499,17 +748,24 @@ fpi_spi_transfer_submit_sync (FpiSpiTransfer *transfer,
 
   log_transfer (transfer, TRUE, NULL);
 
-  task = g_task_new (transfer->device,
-                     NULL,
-                     NULL,
-                     NULL);
-  g_task_set_task_data (task,
-                        fpi_spi_transfer_ref (transfer),
-                        (GDestroyNotify) fpi_spi_transfer_unref);
+  /* Go through the same queue as asynchronous submissions so ordering
+   * is kept even when both are mixed. */
+  item.transfer = transfer;
+  g_mutex_init (&item.lock);
+  g_cond_init (&item.cond);
+
+  g_async_queue_push (spi_worker_for_device (transfer->device)->queue, &item);
+
+  g_mutex_lock (&item.lock);
+  while (!item.done)
+    g_cond_wait (&item.cond, &item.lock);
+  g_mutex_unlock (&item.lock);
 
-  g_task_run_in_thread_sync (task, transfer_thread_func);
+  g_mutex_clear (&item.lock);
+  g_cond_clear (&item.cond);
 
-  res = g_task_propagate_boolean (task, &err);
+  err = g_steal_pointer (&item.error);
+  res = err == NULL;
 
   log_transfer (transfer, FALSE, err);
 
@@ -66,6 +66,10 @@ struct _FpiSpiTransfer
 
   int   spidev_fd;
 
+  /* Next transfer batched into the same ioctl, see
+   * fpi_spi_transfer_append(). */
+  FpiSpiTransfer *next;
+
   /* Callbacks */
   gpointer               user_data;
   FpiSpiTransferCallback callback;
@@ -76,6 +80,7 @@ struct _FpiSpiTransfer
 };
 
 GType              fpi_spi_transfer_get_type (void) G_GNUC_CONST;
+gsize              fpi_spi_transfer_block_size (void);
 FpiSpiTransfer     *fpi_spi_transfer_new (FpDevice *device,
                                           int       spidev_fd);
 FpiSpiTransfer     *fpi_spi_transfer_ref (FpiSpiTransfer *self);
@@ -99,6 +104,9 @@ void               fpi_spi_transfer_read_full (FpiSpiTransfer *transfer,
                                                gsize           length,
                                                GDestroyNotify  free_func);
 
+void               fpi_spi_transfer_append (FpiSpiTransfer *transfer,
+                                            FpiSpiTransfer *next);
+
 void               fpi_spi_transfer_submit (FpiSpiTransfer        *transfer,
                                             GCancellable          *cancellable,
                                             FpiSpiTransferCallback callback,
@@ -22,8 +22,11 @@
 #define FP_COMPONENT "SSM"
 
 #include "drivers_api.h"
+#include "fp-device-private.h"
 #include "fpi-ssm.h"
 
+#include <time.h>
+
 
 /**
  * SECTION:fpi-ssm
@@ -81,11 +84,17 @@ struct _FpiSsm
   int                     start_cleanup;
   int                     cur_state;
   gboolean                completed;
+  gboolean                ever_started;
   gboolean                silence;
   GSource                *timeout;
   GError                 *error;
   FpiSsmCompletedCallback callback;
   FpiSsmHandlerCallback   handler;
+
+  /* Per-state timing statistics, allocated by fpi_ssm_enable_timing() */
+  FpiSsmTiming           *timings;
+  gint64                  enter_wall;
+  gint64                  enter_cpu;
 };
 
 /**
@@ -240,17 +249,79 @@ fpi_ssm_free (FpiSsm *machine)
     g_clear_pointer (&machine->ssm_data, machine->ssm_data_destroy);
   g_clear_pointer (&machine->error, g_error_free);
   g_clear_pointer (&machine->name, g_free);
+  g_clear_pointer (&machine->timings, g_free);
   fpi_ssm_clear_delayed_action (machine);
   g_free (machine);
 }
 
+static gint64
+fpi_ssm_thread_cpu_time (void)
+{
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/* Account the time spent in the state we are about to leave. The enter
+ * timestamp doubles as the "currently in a state" flag so that the
+ * various transition paths can all call this without double counting. */
+static void
+fpi_ssm_timing_account (FpiSsm *machine)
+{
+  FpiSsmTiming *timing;
+  guint64 wall;
+
+  if (!machine->timings || machine->enter_wall == 0)
+    return;
+
+  wall = g_get_monotonic_time () - machine->enter_wall;
+
+  timing = &machine->timings[machine->cur_state];
+  timing->count++;
+  timing->total_wall_us += wall;
+  timing->total_cpu_us += fpi_ssm_thread_cpu_time () - machine->enter_cpu;
+  if (wall > timing->max_wall_us)
+    timing->max_wall_us = wall;
+
+  machine->enter_wall = 0;
+}
+
+static void
+fpi_ssm_timing_dump (FpiSsm *machine)
+{
+  int i;
+
+  for (i = 0; i < machine->nr_states; i++)
+    {
+      FpiSsmTiming *timing = &machine->timings[i];
+
+      if (timing->count == 0)
+        continue;
+
+      fp_dbg_lazy ("[%s] %s state %d: %" G_GUINT64_FORMAT " runs, "
+              "wall %" G_GUINT64_FORMAT "µs (max %" G_GUINT64_FORMAT "µs), "
+              "cpu %" G_GUINT64_FORMAT "µs",
+              fp_device_get_driver (machine->dev), machine->name, i,
+              timing->count, timing->total_wall_us, timing->max_wall_us,
+              timing->total_cpu_us);
+    }
+}
+
 /* Invoke the state handler */
 static void
 __ssm_call_handler (FpiSsm *machine, gboolean force_msg)
 {
   if (force_msg || !machine->silence)
-    fp_dbg ("[%s] %s entering state %d", fp_device_get_driver (machine->dev),
-            machine->name, machine->cur_state);
+    fp_dbg_lazy ("[%s] %s entering state %d", fp_device_get_driver (machine->dev),
+                 machine->name, machine->cur_state);
+  if (machine->timings)
+    {
+      machine->enter_wall = g_get_monotonic_time ();
+      machine->enter_cpu = fpi_ssm_thread_cpu_time ();
+    }
   machine->handler (machine, machine->dev);
 }
 
@@ -273,6 +344,14 @@ fpi_ssm_start (FpiSsm *ssm, FpiSsmCompletedCallback callback)
   g_return_if_fail (ssm != NULL);
 
   BUG_ON (!ssm->completed);
+
+  /* Restarting a machine that already ran is legal but worth counting:
+   * drivers do it to recover from protocol hiccups, so a rising restart
+   * rate flags a misbehaving sensor (see fp_device_get_statistics()). */
+  if (ssm->ever_started && ssm->dev)
+    fpi_device_stats_ssm_restart (ssm->dev);
+  ssm->ever_started = TRUE;
+
   ssm->callback = callback;
   ssm->cur_state = 0;
   ssm->completed = FALSE;
@@ -338,6 +417,7 @@ fpi_ssm_mark_completed (FpiSsm *machine)
   BUG_ON (machine->timeout != NULL);
 
   fpi_ssm_clear_delayed_action (machine);
+  fpi_ssm_timing_account (machine);
 
   /* complete in a cleanup state just moves forward one step */
   if (machine->cur_state < machine->start_cleanup)
@@ -354,12 +434,15 @@ fpi_ssm_mark_completed (FpiSsm *machine)
 
   machine->completed = TRUE;
 
+  if (machine->timings)
+    fpi_ssm_timing_dump (machine);
+
   if (machine->error)
-    fp_dbg ("[%s] %s completed with error: %s", fp_device_get_driver (machine->dev),
-            machine->name, machine->error->message);
+    fp_dbg_lazy ("[%s] %s completed with error: %s", fp_device_get_driver (machine->dev),
+                 machine->name, machine->error->message);
   else
-    fp_dbg ("[%s] %s completed successfully", fp_device_get_driver (machine->dev),
-            machine->name);
+    fp_dbg_lazy ("[%s] %s completed successfully", fp_device_get_driver (machine->dev),
+                 machine->name);
   if (machine->callback)
     {
       GError *error = machine->error ? g_error_copy (machine->error) : NULL;
@@ -428,11 +511,11 @@ fpi_ssm_mark_failed (FpiSsm *machine, GError *error)
       return;
     }
 
-  fp_dbg ("[%s] SSM %s failed in state %d%s with error: %s",
-          fp_device_get_driver (machine->dev), machine->name,
-          machine->cur_state,
-          machine->cur_state >= machine->start_cleanup ? " (cleanup)" : "",
-          error->message);
+  fp_dbg_lazy ("[%s] SSM %s failed in state %d%s with error: %s",
+               fp_device_get_driver (machine->dev), machine->name,
+               machine->cur_state,
+               machine->cur_state >= machine->start_cleanup ? " (cleanup)" : "",
+               error->message);
   if (!machine->error)
     machine->error = g_steal_pointer (&error);
   else
@@ -457,10 +540,15 @@ fpi_ssm_next_state (FpiSsm *machine)
   BUG_ON (machine->timeout != NULL);
 
   fpi_ssm_clear_delayed_action (machine);
+  fpi_ssm_timing_account (machine);
 
   machine->cur_state++;
   if (machine->cur_state == machine->nr_states)
     fpi_ssm_mark_completed (machine);
+  else if (fpi_device_should_preempt (machine->dev))
+    fpi_ssm_mark_failed (machine,
+                         g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                              "Background operation preempted"));
   else
     __ssm_call_handler (machine, FALSE);
 }
@@ -472,8 +560,8 @@ fpi_ssm_cancel_delayed_state_change (FpiSsm *machine)
   BUG_ON (machine->completed);
   BUG_ON (machine->timeout == NULL);
 
-  fp_dbg ("[%s] %s cancelled delayed state change",
-          fp_device_get_driver (machine->dev), machine->name);
+  fp_dbg_lazy ("[%s] %s cancelled delayed state change",
+               fp_device_get_driver (machine->dev), machine->name);
 
   fpi_ssm_clear_delayed_action (machine);
 }
@@ -534,10 +622,15 @@ fpi_ssm_jump_to_state (FpiSsm *machine, int state)
   BUG_ON (machine->timeout != NULL);
 
   fpi_ssm_clear_delayed_action (machine);
+  fpi_ssm_timing_account (machine);
 
   machine->cur_state = state;
   if (machine->cur_state == machine->nr_states)
     fpi_ssm_mark_completed (machine);
+  else if (fpi_device_should_preempt (machine->dev))
+    fpi_ssm_mark_failed (machine,
+                         g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                              "Background operation preempted"));
   else
     __ssm_call_handler (machine, FALSE);
 }
@@ -660,6 +753,53 @@ fpi_ssm_silence_debug (FpiSsm *machine)
   machine->silence = TRUE;
 }
 
+/**
+ * fpi_ssm_enable_timing:
+ * @machine: an #FpiSsm state machine
+ *
+ * Start collecting per-state timing statistics for this SSM. Each state
+ * transition then records the wall-clock and thread CPU time spent in
+ * the state that is being left, and a summary is printed to the debug
+ * log when the SSM completes.
+ *
+ * The collected statistics can be queried with fpi_ssm_get_timings(),
+ * e.g. from the completion callback. They accumulate across restarts of
+ * the same SSM.
+ *
+ * This is cheap enough to leave enabled in production: the cost is two
+ * clock reads per state transition.
+ */
+void
+fpi_ssm_enable_timing (FpiSsm *machine)
+{
+  g_return_if_fail (machine != NULL);
+
+  if (!machine->timings)
+    machine->timings = g_new0 (FpiSsmTiming, machine->nr_states);
+}
+
+/**
+ * fpi_ssm_get_timings:
+ * @machine: an #FpiSsm state machine
+ * @nr_states: (out) (optional): number of entries in the returned array
+ *
+ * Returns the timing statistics collected so far, one #FpiSsmTiming per
+ * state, indexed by state number.
+ *
+ * Returns: (transfer none) (nullable): the statistics, or %NULL unless
+ *   fpi_ssm_enable_timing() was called
+ */
+const FpiSsmTiming *
+fpi_ssm_get_timings (FpiSsm *machine, int *nr_states)
+{
+  g_return_val_if_fail (machine != NULL, NULL);
+
+  if (nr_states)
+    *nr_states = machine->nr_states;
+
+  return machine->timings;
+}
+
 /**
  * fpi_ssm_usb_transfer_cb:
  * @transfer: a #FpiUsbTransfer
@@ -58,6 +58,29 @@ typedef void (*FpiSsmCompletedCallback)(FpiSsm   *ssm,
 typedef void (*FpiSsmHandlerCallback)(FpiSsm   *ssm,
                                       FpDevice *dev);
 
+/**
+ * FpiSsmTiming:
+ * @count: number of times the state was entered
+ * @total_wall_us: accumulated wall-clock time spent in the state, in µs
+ * @total_cpu_us: accumulated thread CPU time spent in the state, in µs
+ * @max_wall_us: longest single wall-clock stay in the state, in µs
+ *
+ * Accumulated timing statistics for one state of a #FpiSsm, recorded
+ * with monotonic clocks. Collection is opt-in, see fpi_ssm_enable_timing().
+ *
+ * Wall time covers everything between entering the state and the next
+ * transition, including waits for device I/O and delayed transitions —
+ * which is usually what dominates the latency of an operation. CPU time
+ * is the time this thread was actually executing in that window.
+ */
+typedef struct
+{
+  guint64 count;
+  guint64 total_wall_us;
+  guint64 total_cpu_us;
+  guint64 max_wall_us;
+} FpiSsmTiming;
+
 /* for library and drivers */
 #define fpi_ssm_new(dev, handler, nr_states) \
   fpi_ssm_new_full (dev, handler, nr_states, nr_states, #nr_states)
@@ -98,6 +121,10 @@ int fpi_ssm_get_cur_state (FpiSsm *machine);
 
 void fpi_ssm_silence_debug (FpiSsm *machine);
 
+void fpi_ssm_enable_timing (FpiSsm *machine);
+const FpiSsmTiming * fpi_ssm_get_timings (FpiSsm *machine,
+                                          int    *nr_states);
+
 /* Callbacks to be used by the driver instead of implementing their own
  * logic.
  */
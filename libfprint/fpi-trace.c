@@ -0,0 +1,72 @@
+/*
+ * FPrint latency tracepoints
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "fpi-trace.h"
+
+#if HAVE_TRACING
+
+#include <stdio.h>
+
+/* One line per event, written in a single call so that events from the
+ * minutiae detection thread pool do not interleave mid-line:
+ *   fp-trace <B|E|M> <monotonic time in µs> <name>
+ */
+static void
+fpi_trace_emit (char type, const char *format, va_list args)
+{
+  char name[256];
+  char line[320];
+
+  g_vsnprintf (name, sizeof (name), format, args);
+  g_snprintf (line, sizeof (line), "fp-trace %c %" G_GINT64_FORMAT " %s\n",
+              type, g_get_monotonic_time (), name);
+  fputs (line, stderr);
+}
+
+void
+fpi_trace_span_begin (const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  fpi_trace_emit ('B', format, args);
+  va_end (args);
+}
+
+void
+fpi_trace_span_end (const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  fpi_trace_emit ('E', format, args);
+  va_end (args);
+}
+
+void
+fpi_trace_mark (const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  fpi_trace_emit ('M', format, args);
+  va_end (args);
+}
+
+#endif /* HAVE_TRACING */
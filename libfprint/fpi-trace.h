@@ -0,0 +1,51 @@
+/*
+ * FPrint latency tracepoints
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <glib.h>
+
+/* Lightweight tracepoints for attributing end-to-end latency to the
+ * right subsystem. Compiled out entirely unless the 'tracing' meson
+ * option is enabled; the emitted lines can be turned into a per-action
+ * waterfall with scripts/trace-waterfall.py.
+ *
+ * Spans with the same formatted name are paired last-in-first-out, so
+ * overlapping spans (e.g. in-flight USB transfers) should include a
+ * distinguishing pointer or index in the name.
+ */
+
+#if HAVE_TRACING
+
+void fpi_trace_span_begin (const char *format,
+                           ...) G_GNUC_PRINTF (1, 2);
+void fpi_trace_span_end (const char *format,
+                         ...) G_GNUC_PRINTF (1, 2);
+void fpi_trace_mark (const char *format,
+                     ...) G_GNUC_PRINTF (1, 2);
+
+#else
+
+#define fpi_trace_span_begin(...) do {} while (0)
+#define fpi_trace_span_end(...) do {} while (0)
+#define fpi_trace_mark(...) do {} while (0)
+
+#endif
@@ -18,6 +18,12 @@
  */
 
 #include "fpi-usb-transfer.h"
+#include "fpi-trace.h"
+#include "fpi-mem.h"
+#include "fp-device-private.h"
+
+#include <stdlib.h>
+#include <unistd.h>
 
 /**
  * SECTION:fpi-usb-transfer
@@ -88,6 +94,190 @@ log_transfer (FpiUsbTransfer *transfer, gboolean submit, GError *error)
     }
 }
 
+/* Transfer buffers are recycled through a small pool of power-of-two size
+ * classes. Drivers like upeksonly submit hundreds of identically sized bulk
+ * transfers per swipe, and allocating/freeing each buffer individually
+ * shows up as allocator churn on the capture hot path. Each pooled buffer
+ * carries a small header recording its size class so it can be returned to
+ * the right bucket from the plain GDestroyNotify free callback. */
+
+#define TRANSFER_POOL_MIN_SHIFT 5  /* 32 B */
+#define TRANSFER_POOL_MAX_SHIFT 20 /* 1 MiB */
+#define TRANSFER_POOL_N_CLASSES (TRANSFER_POOL_MAX_SHIFT - TRANSFER_POOL_MIN_SHIFT + 1)
+#define TRANSFER_POOL_MAX_PER_CLASS 16
+
+/* Keep the payload maximally aligned for drivers that cast buffers.
+ * The header records the size class, or TRANSFER_POOL_OVERSIZE and the
+ * exact length for buffers too large for any class. */
+#define TRANSFER_POOL_HEADER_SIZE 16
+#define TRANSFER_POOL_OVERSIZE G_MAXUINT32
+
+/* Buffers of a page or more are page aligned. usbfs can then DMA-map the
+ * submitting process' pages directly for bulk reads; unaligned buffers go
+ * through a kernel bounce buffer and cost an extra copy of the whole
+ * frame (~350 KiB per uru4000 capture). Aligned buffers start on a page
+ * boundary with the pool header at the end of the preceding page, marked
+ * by TRANSFER_POOL_ALIGNED in the size class (or the dedicated oversize
+ * tag) so the free path can find the allocation base. */
+#define TRANSFER_POOL_ALIGNED 0x40000000u
+#define TRANSFER_POOL_OVERSIZE_ALIGNED (G_MAXUINT32 - 1)
+
+static gsize transfer_pool_page_size;
+
+static GMutex transfer_pool_lock;
+static guint8 *transfer_pool[TRANSFER_POOL_N_CLASSES][TRANSFER_POOL_MAX_PER_CLASS];
+static guint transfer_pool_len[TRANSFER_POOL_N_CLASSES];
+
+static gint
+transfer_pool_class (gsize length)
+{
+  gint class;
+
+  for (class = TRANSFER_POOL_MIN_SHIFT; class <= TRANSFER_POOL_MAX_SHIFT; class++)
+    if (length <= ((gsize) 1 << class))
+      return class - TRANSFER_POOL_MIN_SHIFT;
+
+  return -1;
+}
+
+/* Returns the payload pointer, or NULL if aligned allocation failed and
+ * the caller should fall back to the plain path. The header is placed
+ * just below the page-aligned payload and tagged with @tag. */
+static guint8 *
+transfer_pool_alloc_aligned (gsize payload_size, guint32 tag)
+{
+  guint8 *base = NULL;
+  guint8 *header;
+
+  if (posix_memalign ((void **) &base,
+                      transfer_pool_page_size,
+                      transfer_pool_page_size + payload_size) != 0)
+    return NULL;
+
+  header = base + transfer_pool_page_size - TRANSFER_POOL_HEADER_SIZE;
+  *((guint32 *) header) = tag;
+  fpi_mem_add (FPI_MEM_SUBSYS_USB, transfer_pool_page_size + payload_size);
+
+  return base + transfer_pool_page_size;
+}
+
+static guint8 *
+transfer_pool_alloc0 (gsize length)
+{
+  guint8 *mem = NULL;
+  gsize class_size;
+  gint class;
+
+  if (G_UNLIKELY (transfer_pool_page_size == 0))
+    transfer_pool_page_size = sysconf (_SC_PAGESIZE);
+
+  class = transfer_pool_class (length);
+  if (class < 0)
+    {
+      guint8 *payload = NULL;
+
+      if (length >= transfer_pool_page_size)
+        payload = transfer_pool_alloc_aligned (length,
+                                               TRANSFER_POOL_OVERSIZE_ALIGNED);
+      if (payload)
+        {
+          *((gsize *) (payload - TRANSFER_POOL_HEADER_SIZE + 8)) = length;
+          memset (payload, 0, length);
+          return payload;
+        }
+
+      mem = g_malloc0 (TRANSFER_POOL_HEADER_SIZE + length);
+      *((guint32 *) mem) = TRANSFER_POOL_OVERSIZE;
+      *((gsize *) (mem + 8)) = length;
+      fpi_mem_add (FPI_MEM_SUBSYS_USB, TRANSFER_POOL_HEADER_SIZE + length);
+      return mem + TRANSFER_POOL_HEADER_SIZE;
+    }
+
+  g_mutex_lock (&transfer_pool_lock);
+  if (transfer_pool_len[class] > 0)
+    mem = transfer_pool[class][--transfer_pool_len[class]];
+  g_mutex_unlock (&transfer_pool_lock);
+
+  class_size = (gsize) 1 << (class + TRANSFER_POOL_MIN_SHIFT);
+
+  if (!mem && class_size >= transfer_pool_page_size)
+    {
+      guint8 *payload;
+
+      payload = transfer_pool_alloc_aligned (class_size,
+                                             class | TRANSFER_POOL_ALIGNED);
+      if (payload)
+        mem = payload - TRANSFER_POOL_HEADER_SIZE;
+    }
+
+  if (!mem)
+    {
+      mem = g_malloc (TRANSFER_POOL_HEADER_SIZE + class_size);
+      *((guint32 *) mem) = class;
+      /* Stays accounted while cached in the pool; the pool caps how
+       * much can be retained per size class. */
+      fpi_mem_add (FPI_MEM_SUBSYS_USB,
+                   TRANSFER_POOL_HEADER_SIZE + class_size);
+    }
+
+  memset (mem + TRANSFER_POOL_HEADER_SIZE, 0, length);
+  return mem + TRANSFER_POOL_HEADER_SIZE;
+}
+
+static void
+transfer_pool_free (gpointer buffer)
+{
+  guint8 *mem = ((guint8 *) buffer) - TRANSFER_POOL_HEADER_SIZE;
+  guint32 class = *((guint32 *) mem);
+  gboolean aligned;
+
+  if (class == TRANSFER_POOL_OVERSIZE || class == TRANSFER_POOL_OVERSIZE_ALIGNED)
+    {
+      gsize length = *((gsize *) (mem + 8));
+
+      if (class == TRANSFER_POOL_OVERSIZE_ALIGNED)
+        {
+          fpi_mem_sub (FPI_MEM_SUBSYS_USB, transfer_pool_page_size + length);
+          free (((guint8 *) buffer) - transfer_pool_page_size);
+        }
+      else
+        {
+          fpi_mem_sub (FPI_MEM_SUBSYS_USB, TRANSFER_POOL_HEADER_SIZE + length);
+          g_free (mem);
+        }
+      return;
+    }
+
+  aligned = (class & TRANSFER_POOL_ALIGNED) != 0;
+  class &= ~TRANSFER_POOL_ALIGNED;
+
+  g_mutex_lock (&transfer_pool_lock);
+  if (transfer_pool_len[class] < TRANSFER_POOL_MAX_PER_CLASS)
+    {
+      transfer_pool[class][transfer_pool_len[class]++] = mem;
+      mem = NULL;
+    }
+  g_mutex_unlock (&transfer_pool_lock);
+
+  if (mem)
+    {
+      gsize class_size = (gsize) 1 << (class + TRANSFER_POOL_MIN_SHIFT);
+
+      if (aligned)
+        {
+          fpi_mem_sub (FPI_MEM_SUBSYS_USB,
+                       transfer_pool_page_size + class_size);
+          free (mem + TRANSFER_POOL_HEADER_SIZE - transfer_pool_page_size);
+        }
+      else
+        {
+          fpi_mem_sub (FPI_MEM_SUBSYS_USB,
+                       TRANSFER_POOL_HEADER_SIZE + class_size);
+          g_free (mem);
+        }
+    }
+}
+
 /**
  * fpi_usb_transfer_new:
  * @device: The #FpDevice the transfer is for
@@ -167,9 +357,10 @@ fpi_usb_transfer_unref (FpiUsbTransfer *self)
  * @endpoint: The endpoint to send the transfer to
  * @length: The buffer size to allocate
  *
- * Prepare a bulk transfer. A buffer will be created for you, use
- * fpi_usb_transfer_fill_bulk_full() if you want to send a static buffer
- * or receive a pre-defined buffer.
+ * Prepare a bulk transfer. A buffer will be created for you (drawn from a
+ * pool of recycled transfer buffers), use fpi_usb_transfer_fill_bulk_full()
+ * if you want to send a static buffer or receive into caller-owned memory
+ * without any copies.
  */
 void
 fpi_usb_transfer_fill_bulk (FpiUsbTransfer *transfer,
@@ -178,9 +369,9 @@ fpi_usb_transfer_fill_bulk (FpiUsbTransfer *transfer,
 {
   fpi_usb_transfer_fill_bulk_full (transfer,
                                    endpoint,
-                                   g_malloc0 (length),
+                                   transfer_pool_alloc0 (length),
                                    length,
-                                   g_free);
+                                   transfer_pool_free);
 }
 
 /**
@@ -246,8 +437,8 @@ fpi_usb_transfer_fill_control (FpiUsbTransfer       *transfer,
   transfer->idx = idx;
 
   transfer->length = length;
-  transfer->buffer = g_malloc0 (length);
-  transfer->free_buffer = g_free;
+  transfer->buffer = transfer_pool_alloc0 (length);
+  transfer->free_buffer = transfer_pool_free;
 }
 
 /**
@@ -266,9 +457,9 @@ fpi_usb_transfer_fill_interrupt (FpiUsbTransfer *transfer,
 {
   fpi_usb_transfer_fill_interrupt_full (transfer,
                                         endpoint,
-                                        g_malloc0 (length),
+                                        transfer_pool_alloc0 (length),
                                         length,
-                                        g_free);
+                                        transfer_pool_free);
 }
 
 /**
@@ -335,6 +526,7 @@ transfer_finish_cb (GObject *source_object, GAsyncResult *res, gpointer user_dat
     }
 
   log_transfer (transfer, FALSE, error);
+  fpi_trace_span_end ("usb-transfer %p", transfer);
 
   /* Check for short error, and set an error if requested */
   if (error == NULL &&
@@ -347,6 +539,12 @@ transfer_finish_cb (GObject *source_object, GAsyncResult *res, gpointer user_dat
                            "Unexpected short error of %zd size (expected %zd)", transfer->actual_length, transfer->length);
     }
 
+  fpi_device_transfer_stats_completed (transfer->device,
+                                       transfer->endpoint,
+                                       transfer->actual_length,
+                                       g_get_monotonic_time () - transfer->submit_time,
+                                       error != NULL);
+
   callback = transfer->callback;
   transfer->callback = NULL;
   callback (transfer, transfer->device, transfer->user_data, error);
@@ -417,6 +615,11 @@ fpi_usb_transfer_submit (FpiUsbTransfer        *transfer,
       return;
     }
 
+  transfer->submit_time = g_get_monotonic_time ();
+  fpi_device_transfer_stats_submitted (transfer->device, transfer->endpoint);
+
+  fpi_trace_span_begin ("usb-transfer %p", transfer);
+
   switch (transfer->type)
     {
     case FP_TRANSFER_BULK:
@@ -464,6 +667,219 @@ fpi_usb_transfer_submit (FpiUsbTransfer        *transfer,
     }
 }
 
+/* Interrupt transfer streams keep several identical URBs queued on one
+ * endpoint. The kernel refills from the queue on each completion, so no
+ * packet is lost in the gap between a completion callback and the next
+ * submission, and the completion path stops allocating: each transfer
+ * (and its pooled buffer) is recycled and resubmitted after delivery. */
+struct _FpiUsbTransferStream
+{
+  FpDevice                    *device;
+  GCancellable                *cancellable;
+  FpiUsbTransferStreamCallback callback;
+  gpointer                     user_data;
+
+  /* Set once fpi_usb_transfer_stream_stop() was called; the stream is
+   * freed when the last in-flight transfer has drained. */
+  FpTimeoutFunc                stopped_cb;
+  gpointer                     stopped_data;
+  gboolean                     stop_requested;
+
+  gboolean                     stopped;
+  guint                        in_flight;
+};
+
+static void fpi_usb_transfer_stream_transfer_cb (FpiUsbTransfer *transfer,
+                                                 FpDevice       *device,
+                                                 gpointer        user_data,
+                                                 GError         *error);
+
+static void
+fpi_usb_transfer_stream_finish (FpiUsbTransferStream *stream)
+{
+  FpTimeoutFunc stopped_cb = stream->stopped_cb;
+  gpointer stopped_data = stream->stopped_data;
+  FpDevice *device = stream->device;
+
+  g_clear_object (&stream->cancellable);
+  g_free (stream);
+
+  if (stopped_cb)
+    stopped_cb (device, stopped_data);
+}
+
+/* One in-flight transfer will not be resubmitted; free the stream once
+ * the driver asked for a stop and everything has drained. */
+static void
+fpi_usb_transfer_stream_drop (FpiUsbTransferStream *stream)
+{
+  stream->in_flight--;
+
+  if (stream->stop_requested && stream->in_flight == 0)
+    fpi_usb_transfer_stream_finish (stream);
+}
+
+static void
+fpi_usb_transfer_stream_transfer_cb (FpiUsbTransfer *transfer,
+                                     FpDevice       *device,
+                                     gpointer        user_data,
+                                     GError         *error)
+{
+  FpiUsbTransferStream *stream = user_data;
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_clear_error (&error);
+      fpi_usb_transfer_stream_drop (stream);
+      return;
+    }
+
+  if (error)
+    {
+      /* Report the first error and stop; the other queued transfers
+       * drain through the cancellation path above. */
+      if (!stream->stopped)
+        {
+          stream->stopped = TRUE;
+          g_cancellable_cancel (stream->cancellable);
+          stream->callback (stream, device, NULL, stream->user_data, error);
+        }
+      else
+        {
+          g_error_free (error);
+        }
+
+      fpi_usb_transfer_stream_drop (stream);
+      return;
+    }
+
+  stream->callback (stream, device, transfer, stream->user_data, NULL);
+
+  /* The callback may have stopped the stream. */
+  if (stream->stopped)
+    {
+      fpi_usb_transfer_stream_drop (stream);
+      return;
+    }
+
+  /* Re-queue the same transfer; the other pre-queued packets cover the
+   * time spent in the callback. */
+  fpi_usb_transfer_submit (fpi_usb_transfer_ref (transfer), 0,
+                           stream->cancellable,
+                           fpi_usb_transfer_stream_transfer_cb, stream);
+}
+
+/**
+ * fpi_usb_transfer_stream_start:
+ * @device: The #FpDevice the stream is for
+ * @endpoint: The interrupt endpoint to read from
+ * @length: The packet size to request
+ * @n_prequeued: Number of transfers to keep queued on the endpoint
+ * @callback: Callback for each received packet
+ * @user_data: Data to pass to @callback
+ *
+ * Start a continuous interrupt transfer stream on @endpoint. @callback
+ * runs once per received packet; the transfers are recycled internally
+ * so the steady state performs no allocations, and keeping @n_prequeued
+ * URBs on the endpoint means no packet is dropped while a completion is
+ * being handled. Short packets are reported as errors.
+ *
+ * On error the stream stops resubmitting but stays valid; the driver
+ * must always call fpi_usb_transfer_stream_stop() eventually to free
+ * it.
+ *
+ * Returns: (transfer full): The new stream
+ */
+FpiUsbTransferStream *
+fpi_usb_transfer_stream_start (FpDevice                    *device,
+                               guint8                       endpoint,
+                               gsize                        length,
+                               guint                        n_prequeued,
+                               FpiUsbTransferStreamCallback callback,
+                               gpointer                     user_data)
+{
+  FpiUsbTransferStream *stream;
+  guint i;
+
+  g_return_val_if_fail (device != NULL, NULL);
+  g_return_val_if_fail (callback != NULL, NULL);
+
+  n_prequeued = MAX (n_prequeued, 1);
+
+  /* umockdev replays URBs strictly in their recorded order, which a
+   * queue of identical reads would violate. */
+  if (g_getenv ("FP_DEVICE_EMULATION"))
+    n_prequeued = 1;
+
+  stream = g_new0 (FpiUsbTransferStream, 1);
+  stream->device = device;
+  stream->cancellable = g_cancellable_new ();
+  stream->callback = callback;
+  stream->user_data = user_data;
+
+  for (i = 0; i < n_prequeued; i++)
+    {
+      FpiUsbTransfer *transfer = fpi_usb_transfer_new (device);
+
+      transfer->short_is_error = TRUE;
+      fpi_usb_transfer_fill_interrupt (transfer, endpoint, length);
+      stream->in_flight++;
+      fpi_usb_transfer_submit (transfer, 0, stream->cancellable,
+                               fpi_usb_transfer_stream_transfer_cb, stream);
+    }
+
+  return stream;
+}
+
+/**
+ * fpi_usb_transfer_stream_is_running:
+ * @stream: The #FpiUsbTransferStream
+ *
+ * Checks whether the stream is still delivering packets, i.e. it has
+ * neither failed nor been stopped.
+ *
+ * Returns: %TRUE if the stream is running
+ */
+gboolean
+fpi_usb_transfer_stream_is_running (FpiUsbTransferStream *stream)
+{
+  g_return_val_if_fail (stream != NULL, FALSE);
+
+  return !stream->stopped;
+}
+
+/**
+ * fpi_usb_transfer_stream_stop:
+ * @stream: (transfer full): The #FpiUsbTransferStream
+ * @stopped_cb: (nullable): Called once all transfers have drained
+ * @stopped_data: Data to pass to @stopped_cb
+ *
+ * Stop the stream and free it once the in-flight transfers have
+ * drained. No packets are delivered after this call; @stopped_cb runs
+ * when the endpoint is quiet, which may be before this returns.
+ */
+void
+fpi_usb_transfer_stream_stop (FpiUsbTransferStream *stream,
+                              FpTimeoutFunc         stopped_cb,
+                              gpointer              stopped_data)
+{
+  g_return_if_fail (stream != NULL);
+  g_return_if_fail (!stream->stop_requested);
+
+  stream->stop_requested = TRUE;
+  stream->stopped_cb = stopped_cb;
+  stream->stopped_data = stopped_data;
+
+  if (!stream->stopped)
+    {
+      stream->stopped = TRUE;
+      g_cancellable_cancel (stream->cancellable);
+    }
+
+  if (stream->in_flight == 0)
+    fpi_usb_transfer_stream_finish (stream);
+}
+
 /**
  * fpi_usb_transfer_submit_sync:
  * @transfer: The transfer to submit, must have been filled.
@@ -494,6 +910,9 @@ fpi_usb_transfer_submit_sync (FpiUsbTransfer *transfer,
 
   log_transfer (transfer, TRUE, NULL);
 
+  transfer->submit_time = g_get_monotonic_time ();
+  fpi_device_transfer_stats_submitted (transfer->device, transfer->endpoint);
+
   switch (transfer->type)
     {
     case FP_TRANSFER_BULK:
@@ -546,5 +965,11 @@ fpi_usb_transfer_submit_sync (FpiUsbTransfer *transfer,
   else
     transfer->actual_length = actual_length;
 
+  fpi_device_transfer_stats_completed (transfer->device,
+                                       transfer->endpoint,
+                                       transfer->actual_length,
+                                       g_get_monotonic_time () - transfer->submit_time,
+                                       !res);
+
   return res;
 }
@@ -96,6 +96,9 @@ struct _FpiUsbTransfer
   /* Flags */
   gboolean short_is_error;
 
+  /* Submission timestamp for the per-device transfer statistics */
+  gint64 submit_time;
+
   /* Callbacks */
   gpointer               user_data;
   FpiUsbTransferCallback callback;
@@ -153,6 +156,37 @@ gboolean           fpi_usb_transfer_submit_sync (FpiUsbTransfer *transfer,
                                                  guint           timeout_ms,
                                                  GError        **error);
 
+typedef struct _FpiUsbTransferStream FpiUsbTransferStream;
+
+/**
+ * FpiUsbTransferStreamCallback:
+ * @stream: The streams the packet belongs to
+ * @device: The #FpDevice the stream is for
+ * @transfer: The completed transfer, or %NULL if @error is set
+ * @user_data: User data passed to fpi_usb_transfer_stream_start()
+ * @error: (transfer full): #GError that stopped the stream or %NULL
+ *
+ * Callback for each packet received on an interrupt transfer stream.
+ * On error the stream has already stopped resubmitting; ownership of
+ * @error passes to the callback.
+ */
+typedef void (*FpiUsbTransferStreamCallback) (FpiUsbTransferStream *stream,
+                                              FpDevice             *device,
+                                              FpiUsbTransfer       *transfer,
+                                              gpointer              user_data,
+                                              GError               *error);
+
+FpiUsbTransferStream *fpi_usb_transfer_stream_start (FpDevice                    *device,
+                                                     guint8                       endpoint,
+                                                     gsize                        length,
+                                                     guint                        n_prequeued,
+                                                     FpiUsbTransferStreamCallback callback,
+                                                     gpointer                     user_data);
+gboolean           fpi_usb_transfer_stream_is_running (FpiUsbTransferStream *stream);
+void               fpi_usb_transfer_stream_stop (FpiUsbTransferStream *stream,
+                                                 FpTimeoutFunc         stopped_cb,
+                                                 gpointer              stopped_data);
+
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (FpiUsbTransfer, fpi_usb_transfer_unref)
 
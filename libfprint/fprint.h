@@ -21,4 +21,7 @@
 
 #include "fp-context.h"
 #include "fp-device.h"
+#include "fp-gallery.h"
 #include "fp-image.h"
+#include "fp-print.h"
+#include "fp-print-store.h"
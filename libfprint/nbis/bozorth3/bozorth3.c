@@ -79,8 +79,39 @@ of the software.
 ***********************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#define BZ_CONTEXT_ALIASES
 #include <bozorth.h>
 
+/* bz_comp() rounds atanf(dy/dx) to whole degrees for every minutia pair
+   within the DM distance bound, which makes it the one libm call in the
+   edge-table construction that identification repeats per gallery view.
+   Since |dy| and |dx| are at most DM there, the rounded results fit a
+   small lookup table filled once with the exact expression bz_comp()
+   used inline; negative ratios reuse it through the sign symmetry of
+   atanf().  Racing initializations are harmless as every thread stores
+   the identical values. */
+
+static signed char atan_deg_lut[ DM + 1 ][ DM + 1 ];	/* [ |dy| ][ |dx| ], dx != 0 */
+static int atan_deg_lut_ready;
+
+static void atan_deg_lut_init( void )
+{
+int dy, dx;
+
+	for ( dx = 1; dx <= DM; dx++ ) {
+		for ( dy = 0; dy <= DM; dy++ ) {
+			double dz;
+
+			dz = ( 180.0F / PI_SINGLE ) * atanf( (float) dy / (float) dx );
+			dz += 0.5F;
+			atan_deg_lut[ dy ][ dx ] = (int) dz;
+		}
+	}
+
+	atan_deg_lut_ready = 1;
+}
+
 /***********************************************************************/
 void bz_comp(
 	int npoints,				/* INPUT: # of points */
@@ -93,12 +124,7 @@ void bz_comp(
 	int * colptrs[]				/* INPUT and OUTPUT: sorted list of pointers to rows in cols[] */
 	)
 {
-int i, j, k;
-
-int b;
-int t;
-int n;
-int l;
+int j, k;
 
 int table_index;
 
@@ -147,17 +173,15 @@ for ( k = 0; k < npoints - 1; k++ ) {
 		if ( dx == 0 )
 			theta_kj = 90;
 		else {
-			double dz;
-
-			if ( 0 )
-				dz = ( 180.0F / PI_SINGLE ) * atanf( (float) -dy / (float) dx );
-			else
-				dz = ( 180.0F / PI_SINGLE ) * atanf( (float) dy / (float) dx );
-			if ( dz < 0.0F )
-				dz -= 0.5F;
-			else
-				dz += 0.5F;
-			theta_kj = (int) dz;
+			/* Rounded atanf(dy/dx) in degrees via the lookup
+			   table; the distance check above guarantees the
+			   magnitudes stay within DM. */
+			if ( ! atan_deg_lut_ready )
+				atan_deg_lut_init();
+
+			theta_kj = atan_deg_lut[ abs(dy) ][ abs(dx) ];
+			if ( ( dy < 0 ) != ( dx < 0 ) )
+				theta_kj = -theta_kj;
 		}
 
 
@@ -190,61 +214,12 @@ for ( k = 0; k < npoints - 1; k++ ) {
 
 
 
-		b = 0;
-		t = table_index + 1;
-		l = 1;
-		n = -1;			/* Init binary search state ... */
-
-
-
-
-		while ( t - b > 1 ) {
-			int * midpoint;
-
-			l = ( b + t ) / 2;
-			midpoint = colptrs[l-1];
-
-
-
-
-			for ( i=0; i < 3; i++ ) {
-				int dd, ff;
-
-				dd = cols[table_index][i];
-
-				ff = midpoint[i];
-
-
-				n = SENSE(dd,ff);
-
-
-				if ( n < 0 ) {
-					t = l;
-					break;
-				}
-				if ( n > 0 ) {
-					b = l;
-					break;
-				}
-			}
-
-			if ( n == 0 ) {
-				n = 1;
-				b = l;
-			}
-		} /* END while */
-
-		if ( n == 1 )
-			++l;
-
-
-
-
-		for ( i = table_index; i >= l; --i )
-			colptrs[i] = colptrs[i-1];
-
-
-		colptrs[l-1] = &cols[table_index][0];
+		/* The row-pointer list used to be kept sorted here with a
+		   binary search and an O(n) insertion per entry; nothing
+		   reads it until the table is complete, so the rows are now
+		   appended in construction order and sorted once at the end
+		   (see sort_edge_table() below). */
+		colptrs[table_index] = &cols[table_index][0];
 		++table_index;
 
 
@@ -263,6 +238,7 @@ for ( k = 0; k < npoints - 1; k++ ) {
 COMP_END:
 	*ncomparisons = table_index;
 
+	sort_edge_table( colptrs, table_index );
 }
 
 /***********************************************************************/
@@ -582,6 +558,16 @@ END:
 
 
 	}
+
+	/* Sentinel row: endpoints are 1-based, so a zeroed endpoint pair
+	   can never equal a real edge pair's endpoints.  The lookahead
+	   scan in bz_match_score() runs until the endpoints change, and
+	   without the sentinel it would run into rows left over from a
+	   previous candidate. */
+	if ( edge_pair_index < COLP_SIZE_1 ) {
+		colp[edge_pair_index][1] = 0;
+		colp[edge_pair_index][3] = 0;
+	}
 }
 
 
@@ -680,16 +666,24 @@ if ( gstruct->nrows < MIN_COMPUTABLE_BOZORTH_MINUTIAE ) {
 
 
 								/* initialize tables to 0's */
-INT_SET( (int *) &yl, YL_SIZE_1 * YL_SIZE_2, 0 );
-
 
-
-INT_SET( (int *) &sc, SC_SIZE, 0 );
-INT_SET( (int *) &cp, CP_SIZE, 0 );
-INT_SET( (int *) &rp, RP_SIZE, 0 );
-INT_SET( (int *) &tq, TQ_SIZE, 0 );
-INT_SET( (int *) &rq, RQ_SIZE, 0 );
-INT_SET( (int *) &zz, ZZ_SIZE, 1000 );				/* zz[] initialized to 1000's */
+/* The working tables live in the context at their maximum sizes, but a
+   candidate only ever touches a small prefix of each: sc[], rk[] and
+   the zz[] probes at edge pair indices stay below NP (the lookahead
+   scan stops at the sentinel row bz_match() writes after the list),
+   while tq[], rq[], cp[], rp[] and the zz[] endpoint slots are indexed
+   by 1-based minutia numbers, which MAX_BOZORTH_MINUTIAE bounds.  The
+   remaining entries still hold their initial values from the previous
+   reset, so clearing just those prefixes -- a few KB instead of the
+   half MB the full tables span -- is exact.  yl[] is zeroed lazily as
+   each cluster slot is first used, below. */
+
+INT_SET( (int *) &sc, np, 0 );
+INT_SET( (int *) &cp, MAX_BOZORTH_MINUTIAE, 0 );
+INT_SET( (int *) &rp, MAX_BOZORTH_MINUTIAE, 0 );
+INT_SET( (int *) &tq, MAX_BOZORTH_MINUTIAE, 0 );
+INT_SET( (int *) &rq, MAX_BOZORTH_MINUTIAE, 0 );
+INT_SET( (int *) &zz, MAX( np, MAX_BOZORTH_MINUTIAE ), 1000 );	/* zz[] initialized to 1000's */
 
 INT_SET( (int *) &avn, AVN_SIZE, 0 );				/* avn[0...4] <== 0; */
 
@@ -975,6 +969,11 @@ for ( k = 0; k < np - 1; k++ ) {
 			int pc = 0;
 			int pd = 0;
 
+			/* First use of cluster slot TP this candidate; the
+			   bulk clear of yl[][] is gone, so empty it here. */
+			yl[0][tp] = 0;
+			yl[1][tp] = 0;
+
 			for ( i = 0; i < tot; i++ ) {
 				int idx = bz_y[i] - 1;
 				for ( ii = 1; ii < 4; ii++ ) {
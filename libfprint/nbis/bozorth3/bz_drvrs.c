@@ -64,6 +64,20 @@ of the software.
 #cat:                        same probe fingerprint is matches repeatedly
 #cat:                        to multiple gallery fingerprints as in
 #cat:                        identification mode
+#cat: bozorth_edge_table_build - computes and prunes a gallery record's
+#cat:                        pairwise comparison table once, returning it
+#cat:                        in a form that can be reloaded cheaply
+#cat: bozorth_probe_init_from_table - reloads a precomputed probe
+#cat:                        comparison table instead of rebuilding it
+#cat: bozorth_gallery_init_from_table - reloads a precomputed gallery
+#cat:                        comparison table instead of rebuilding it
+#cat: bozorth_to_gallery_prepared - bozorth_to_gallery against a
+#cat:                        precomputed gallery comparison table
+#cat: bozorth_to_gallery_threshold - bozorth_to_gallery with an early
+#cat:                        exit once the caller's decision threshold
+#cat:                        is provably unreachable
+#cat: bozorth_to_gallery_prepared_threshold - combines the precomputed
+#cat:                        table and early-exit variants
 #cat: bozorth_main -         supports the matching scenario where a
 #cat:                        single probe fingerprint is to be matched
 #cat:                        to a single gallery fingerprint as in
@@ -74,6 +88,7 @@ of the software.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#define BZ_CONTEXT_ALIASES
 #include <bozorth.h>
 
 /**************************************************************************/
@@ -84,6 +99,8 @@ int sim;	/* number of pointwise comparisons for Subject's record*/
 int msim;	/* Pruned length of Subject's comparison pointer list */
 
 
+/* Make sure the thread has an active working state context. */
+bz_get_context();
 
 /* Take Subject's points and compute pointwise comparison statistics table and sorted row-pointer list. */
 /* This builds a "Web" of relative edge statistics between points. */
@@ -122,6 +139,8 @@ int fim;	/* number of pointwise comparisons for On-File record*/
 int mfim;	/* Pruned length of On-File Record's pointer list */
 
 
+bz_get_context();
+
 /* Take On-File Record's points and compute pointwise comparison statistics table and sorted row-pointer list. */
 /* This builds a "Web" of relative edge statistics between points. */
 bz_comp(
@@ -153,17 +172,156 @@ return mfim;
 
 /**************************************************************************/
 
+struct bz_edge_table * bozorth_edge_table_build( struct xyt_struct * gstruct )
+{
+struct bz_edge_table * table;
+int fim;	/* number of pointwise comparisons for On-File record*/
+int mfim;	/* Pruned length of On-File Record's pointer list */
+int i;
+
+
+bz_get_context();
+
+/* Build the On-File Record's Web exactly as bozorth_gallery_init() would ... */
+bz_comp(
+	gstruct->nrows,
+	gstruct->xcol,
+	gstruct->ycol,
+	gstruct->thetacol,
+	&fim,
+	fcols,
+	fcolpt );
+
+mfim = fim;
+
+bz_find( &mfim, fcolpt );
+
+if ( mfim < FDD )
+	mfim = ( fim > FDD ) ? FDD : fim;
+
+table = (struct bz_edge_table *) malloc_or_return_error(
+		sizeof(struct bz_edge_table) + mfim * COLS_SIZE_2 * sizeof(int),
+		"bozorth_edge_table_build" );
+if ( table == (struct bz_edge_table *) NULL )
+	return (struct bz_edge_table *) NULL;
+
+table->len = mfim;
+
+/* ... then materialize the sorted row-pointer list, so the pruned Web can
+   be reloaded later without rerunning bz_comp()/bz_find() */
+for ( i = 0; i < mfim; i++ )
+	memcpy( table->cols[i], fcolpt[i], COLS_SIZE_2 * sizeof(int) );
+
+return table;
+}
+
+/**************************************************************************/
+
+int bozorth_probe_init_from_table( const struct bz_edge_table * table )
+{
+int i;
+
+
+bz_get_context();
+
+/* Reload a precomputed Web into this thread's probe scratch tables, the
+   same way bozorth_gallery_init_from_table() does for gallery records.
+   This lets multiple probes share one pass over a gallery without
+   rerunning bz_comp()/bz_find() per pairing. */
+memcpy( scols, table->cols, table->len * COLS_SIZE_2 * sizeof(int) );
+
+for ( i = 0; i < table->len; i++ )
+	scolpt[i] = scols[i];
+
+return table->len;
+}
+
+/**************************************************************************/
+
+int bozorth_gallery_init_from_table( const struct bz_edge_table * table )
+{
+int i;
+
+
+bz_get_context();
+
+/* Reload the precomputed Web into this thread's scratch tables. The match
+   core only walks the edges through fcolpt[], so identity pointers over the
+   copied rows reproduce the original sorted order. */
+memcpy( fcols, table->cols, table->len * COLS_SIZE_2 * sizeof(int) );
+
+for ( i = 0; i < table->len; i++ )
+	fcolpt[i] = fcols[i];
+
+return table->len;
+}
+
+/**************************************************************************/
+
+int bozorth_to_gallery_prepared(
+		int probe_len,
+		struct xyt_struct * pstruct,
+		struct xyt_struct * gstruct,
+		const struct bz_edge_table * table
+		)
+{
+return bozorth_to_gallery_prepared_threshold( probe_len, pstruct, gstruct, table, 0 );
+}
+
+/**************************************************************************/
+
 int bozorth_to_gallery(
 		int probe_len,
 		struct xyt_struct * pstruct,
 		struct xyt_struct * gstruct
 		)
 {
+return bozorth_to_gallery_threshold( probe_len, pstruct, gstruct, 0 );
+}
+
+/**************************************************************************/
+
+/* The match score accumulates endpoint-disjoint groups of compatible edge
+   pairs, so it can never exceed NP, the number of compatible pairs found
+   by bz_match().  When NP is already below the caller's decision
+   threshold, the expensive web traversal in bz_match_score() cannot
+   change the match/no-match outcome, so it is skipped and 0 returned.
+   A threshold of 0 disables the early exit and computes the full score. */
+
+int bozorth_to_gallery_prepared_threshold(
+		int probe_len,
+		struct xyt_struct * pstruct,
+		struct xyt_struct * gstruct,
+		const struct bz_edge_table * table,
+		int threshold
+		)
+{
+int np;
+int gallery_len;
+
+gallery_len = bozorth_gallery_init_from_table( table );
+np = bz_match( probe_len, gallery_len );
+if ( threshold > 0 && np < threshold )
+	return 0;
+return bz_match_score( np, pstruct, gstruct );
+}
+
+/**************************************************************************/
+
+int bozorth_to_gallery_threshold(
+		int probe_len,
+		struct xyt_struct * pstruct,
+		struct xyt_struct * gstruct,
+		int threshold
+		)
+{
 int np;
 int gallery_len;
 
 gallery_len = bozorth_gallery_init( gstruct );
 np = bz_match( probe_len, gallery_len );
+if ( threshold > 0 && np < threshold )
+	return 0;
 return bz_match_score( np, pstruct, gstruct );
 }
 
@@ -50,78 +50,81 @@ of the software.
                       Stan Janet (NIST)
       DATE:           09/21/2004
 
-      Contains global variables responsible for supporting the
+      Contains the context management for the working state of the
       Bozorth3 fingerprint matching "core" algorithm.
 
 ***********************************************************************
-***********************************************************************/
-
-#include <bozorth.h>
-
-/**************************************************************************/
-/* General supporting global variables */
-/**************************************************************************/
 
-int colp[ COLP_SIZE_1 ][ COLP_SIZE_2 ];		/* Output from match(), this is a sorted table of compatible edge pairs containing: */
-						/*	DeltaThetaKJs, Subject's K, J, then On-File's {K,J} or {J,K} depending */
-						/* Sorted first on Subject's point index K, */
-						/*	then On-File's K or J point index (depending), */
-						/*	lastly on Subject's J point index */
-int scols[ SCOLS_SIZE_1 ][ COLS_SIZE_2 ];	/* Subject's pointwise comparison table containing: */
-						/*	Distance,min(BetaK,BetaJ),max(BetaK,BbetaJ), K,J,ThetaKJ */
-int fcols[ FCOLS_SIZE_1 ][ COLS_SIZE_2 ];	/* On-File Record's pointwise comparison table with: */
-						/*	Distance,min(BetaK,BetaJ),max(BetaK,BbetaJ),K,J, ThetaKJ */
-int * scolpt[ SCOLPT_SIZE ];			/* Subject's list of pointers to pointwise comparison rows, sorted on: */
-						/*	Distance, min(BetaK,BetaJ), then max(BetaK,BetaJ) */
-int * fcolpt[ FCOLPT_SIZE ];			/* On-File Record's list of pointers to pointwise comparison rows sorted on: */
-						/*	Distance, min(BetaK,BetaJ), then max(BetaK,BetaJ) */
-int sc[ SC_SIZE ];				/* Flags all compatible edges in the Subject's Web */
+      ROUTINES:
+#cat: bz_context_new -  allocates an independent set of matcher working
+#cat:                   state for re-entrant use
+#cat: bz_context_free - releases a context allocated with bz_context_new
+#cat: bz_get_context -  returns the calling thread's active context,
+#cat:                   falling back to the thread's default context
+#cat: bz_set_context -  switches the calling thread's active context
 
-int yl[ YL_SIZE_1 ][ YL_SIZE_2 ];
+***********************************************************************
+***********************************************************************/
 
+#include <string.h>
+#include <bozorth.h>
 
 /**************************************************************************/
-/* Globals used significantly by sift() */
+/* The matcher's working state, formerly file scope globals */
 /**************************************************************************/
-#ifdef TARGET_OS
-   int rq[ RQ_SIZE ];
-   int tq[ TQ_SIZE ];
-   int zz[ ZZ_SIZE ];
-
-   int rx[ RX_SIZE ];
-   int mm[ MM_SIZE ];
-   int nn[ NN_SIZE ];
-
-   int qq[ QQ_SIZE ];
-
-   int rk[ RK_SIZE ];
-
-   int cp[ CP_SIZE ];
-   int rp[ RP_SIZE ];
-
-   int rf[RF_SIZE_1][RF_SIZE_2];
-   int cf[CF_SIZE_1][CF_SIZE_2];
-
-   int bz_y[20000];
-#else
-   int rq[ RQ_SIZE ] = {};
-   int tq[ TQ_SIZE ] = {};
-   int zz[ ZZ_SIZE ] = {};
-
-   int rx[ RX_SIZE ] = {};
-   int mm[ MM_SIZE ] = {};
-   int nn[ NN_SIZE ] = {};
-
-   int qq[ QQ_SIZE ] = {};
-
-   int rk[ RK_SIZE ] = {};
-
-   int cp[ CP_SIZE ] = {};
-   int rp[ RP_SIZE ] = {};
-
-   int rf[RF_SIZE_1][RF_SIZE_2] = {};
-   int cf[CF_SIZE_1][CF_SIZE_2] = {};
 
-   int bz_y[20000] = {};
-#endif
+/* Each thread owns a default context, so independent threads keep
+   matching concurrently with no setup, exactly as with the previous
+   thread-local globals.  bz_context_new()/bz_set_context() allow a
+   caller to run several interleaved match sequences on one thread. */
+static BZ_TLS struct bz_context bz_default_context;
+
+BZ_TLS struct bz_context * bz_ctx;
+
+/***********************************************************************/
+struct bz_context * bz_context_new( void )
+{
+struct bz_context * ctx;
+
+ctx = (struct bz_context *) malloc_or_return_error( sizeof(struct bz_context), "bz_context_new" );
+if ( ctx == (struct bz_context *) NULL )
+	return (struct bz_context *) NULL;
+
+/* The former globals lived in zero initialized storage. */
+memset( ctx, 0, sizeof(struct bz_context) );
+
+return ctx;
+}
+
+/***********************************************************************/
+void bz_context_free( struct bz_context * ctx )
+{
+if ( ctx == (struct bz_context *) NULL )
+	return;
+if ( bz_ctx == ctx )
+	bz_ctx = &bz_default_context;
+free( (char *) ctx );
+}
+
+/***********************************************************************/
+/* Returns the calling thread's active context, selecting the thread's
+   default context first if none is active yet. */
+struct bz_context * bz_get_context( void )
+{
+if ( bz_ctx == (struct bz_context *) NULL )
+	bz_ctx = &bz_default_context;
+return bz_ctx;
+}
+
+/***********************************************************************/
+/* Makes ctx the calling thread's active context (NULL selects the
+   thread's default context) and returns the previously active one. */
+struct bz_context * bz_set_context( struct bz_context * ctx )
+{
+struct bz_context * prev;
+
+prev = bz_get_context();
+bz_ctx = ( ctx != (struct bz_context *) NULL ) ? ctx : &bz_default_context;
+return prev;
+}
 
@@ -63,10 +63,15 @@ of the software.
 #cat:            then on y
 #cat: sort_order_decreasing - calls a custom quicksort that sorts
 #cat:            a list of integers in decreasing order
+#cat: sort_edge_table - stable LSD counting sort of the pairwise
+#cat:            comparison table's row-pointer list, ordering rows
+#cat:            lexicographically on (distance, beta_min, beta_max)
 
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
+#include <nbis-helpers.h>
 #include <bozorth.h>
 
 /* These are now externally defined in bozorth.h */
@@ -97,6 +102,57 @@ if ( af->col[1] > bf->col[1] )
 return 0;
 }
 
+/***********************************************************************/
+/* Sorts the list of row pointers into the pairwise comparison table,  */
+/* ordering the rows lexicographically increasing on columns 0..2      */
+/* (squared distance, then the two beta angles).  The keys are small   */
+/* bounded non-negative integers -- distances are at most 125^2 and    */
+/* the angles below 256 -- so four stable counting passes over single  */
+/* bytes replace the comparison sort; cost is linear in the number of  */
+/* edges.  The ordering and tie behaviour match the binary-insertion   */
+/* scheme bz_comp() historically used to maintain this list.           */
+
+void sort_edge_table( int * colptrs[], int ncomparisons )
+{
+static const int pass_col[4]   = { 2, 1, 0, 0 };
+static const int pass_shift[4] = { 0, 0, 0, 8 };
+int ** temp;
+int ** src;
+int ** dst;
+int ** swap;
+int count[ 257 ];
+int pass;
+int i;
+
+if ( ncomparisons < 2 )
+	return;
+
+temp = (int **) g_malloc( ncomparisons * sizeof(int *) );
+
+src = colptrs;
+dst = temp;
+for ( pass = 0; pass < 4; pass++ ) {
+	int col   = pass_col[ pass ];
+	int shift = pass_shift[ pass ];
+
+	memset( count, 0, sizeof(count) );
+	for ( i = 0; i < ncomparisons; i++ )
+		count[ ( ( src[i][col] >> shift ) & 0xFF ) + 1 ]++;
+	for ( i = 1; i < 257; i++ )
+		count[i] += count[i-1];
+	for ( i = 0; i < ncomparisons; i++ )
+		dst[ count[ ( src[i][col] >> shift ) & 0xFF ]++ ] = src[i];
+
+	swap = src;
+	src  = dst;
+	dst  = swap;
+}
+
+/* An even number of passes: the result is back in colptrs[]. */
+
+g_free( temp );
+}
+
 /********************************************************
 qsort_decreasing() - quicksort an array of integers in decreasing
                      order [based on multisort.c, by Michael Garris
@@ -206,6 +206,14 @@ struct xytq_struct {
 #define XYT_NULL ( (struct xyt_struct *) NULL ) /* bz_load() */
 #define XYTQ_NULL ( (struct xytq_struct *) NULL ) /* bz_load() */
 
+/* Precomputed pairwise-comparison "Web" for a gallery record: the pruned
+   edge statistics rows in their sorted order, ready to be reloaded into
+   the scratch tables without rerunning bz_comp()/bz_find(). */
+struct bz_edge_table {
+	int len;	/* Pruned length of the sorted edge list */
+	int cols[][COLS_SIZE_2];
+};
+
 
 /**************************************************************************/
 /**************************************************************************/
@@ -223,29 +231,76 @@ extern FILE *stderr;
 /**************************************************************************/
 /* In: BZ_GBLS.C */
 /**************************************************************************/
-/* Global arrays supporting "core" bozorth algorithm */
-extern int colp[ COLP_SIZE_1 ][ COLP_SIZE_2 ];
-extern int scols[ SCOLS_SIZE_1 ][ COLS_SIZE_2 ];
-extern int fcols[ FCOLS_SIZE_1 ][ COLS_SIZE_2 ];
-extern int * scolpt[ SCOLPT_SIZE ];
-extern int * fcolpt[ FCOLPT_SIZE ];
-extern int sc[ SC_SIZE ];
-extern int yl[ YL_SIZE_1 ][ YL_SIZE_2 ];
-/* Global arrays supporting "core" bozorth algorithm continued: */
-/*    Globals used significantly by sift() */
-extern int rq[ RQ_SIZE ];
-extern int tq[ TQ_SIZE ];
-extern int zz[ ZZ_SIZE ];
-extern int rx[ RX_SIZE ];
-extern int mm[ MM_SIZE ];
-extern int nn[ NN_SIZE ];
-extern int qq[ QQ_SIZE ];
-extern int rk[ RK_SIZE ];
-extern int cp[ CP_SIZE ];
-extern int rp[ RP_SIZE ];
-extern int rf[RF_SIZE_1][RF_SIZE_2];
-extern int cf[CF_SIZE_1][CF_SIZE_2];
-extern int bz_y[20000];
+#ifndef BZ_TLS
+#define BZ_TLS __thread
+#endif
+
+/* All "core" algorithm working state, formerly a set of file scope
+   globals, collected into one context structure so the matcher is
+   re-entrant.  Every thread has an implicit default context selected
+   automatically by the driver routines in BZ_DRVRS.C, which preserves
+   the old behavior: independent threads can match concurrently without
+   any setup.  Callers that need to interleave several match sequences
+   on one thread can allocate additional contexts with bz_context_new()
+   and switch between them with bz_set_context(). */
+struct bz_context {
+	int colp[ COLP_SIZE_1 ][ COLP_SIZE_2 ];	/* Output from match(), sorted table of compatible edge pairs */
+	int scols[ SCOLS_SIZE_1 ][ COLS_SIZE_2 ];	/* Subject's pointwise comparison table */
+	int fcols[ FCOLS_SIZE_1 ][ COLS_SIZE_2 ];	/* On-File Record's pointwise comparison table */
+	int * scolpt[ SCOLPT_SIZE ];		/* Subject's sorted list of comparison row pointers */
+	int * fcolpt[ FCOLPT_SIZE ];		/* On-File Record's sorted list of comparison row pointers */
+	int sc[ SC_SIZE ];			/* Flags all compatible edges in the Subject's Web */
+	int yl[ YL_SIZE_1 ][ YL_SIZE_2 ];
+	/* State used significantly by sift() */
+	int rq[ RQ_SIZE ];
+	int tq[ TQ_SIZE ];
+	int zz[ ZZ_SIZE ];
+	int rx[ RX_SIZE ];
+	int mm[ MM_SIZE ];
+	int nn[ NN_SIZE ];
+	int qq[ QQ_SIZE ];
+	int rk[ RK_SIZE ];
+	int cp[ CP_SIZE ];
+	int rp[ RP_SIZE ];
+	int rf[RF_SIZE_1][RF_SIZE_2];
+	int cf[CF_SIZE_1][CF_SIZE_2];
+	int bz_y[20000];
+};
+
+/* The active context of the calling thread; NULL until a driver routine
+   or bz_get_context() selects the thread's default context. */
+extern BZ_TLS struct bz_context * bz_ctx;
+
+extern struct bz_context * bz_context_new( void );
+extern void bz_context_free( struct bz_context * );
+extern struct bz_context * bz_get_context( void );
+extern struct bz_context * bz_set_context( struct bz_context * );
+
+/* The matcher sources keep referring to the working state by its
+   historical global names; route those through the active context.
+   Opt-in so the short names cannot clash outside the matcher. */
+#ifdef BZ_CONTEXT_ALIASES
+#define colp	(bz_ctx->colp)
+#define scols	(bz_ctx->scols)
+#define fcols	(bz_ctx->fcols)
+#define scolpt	(bz_ctx->scolpt)
+#define fcolpt	(bz_ctx->fcolpt)
+#define sc	(bz_ctx->sc)
+#define yl	(bz_ctx->yl)
+#define rq	(bz_ctx->rq)
+#define tq	(bz_ctx->tq)
+#define zz	(bz_ctx->zz)
+#define rx	(bz_ctx->rx)
+#define mm	(bz_ctx->mm)
+#define nn	(bz_ctx->nn)
+#define qq	(bz_ctx->qq)
+#define rk	(bz_ctx->rk)
+#define cp	(bz_ctx->cp)
+#define rp	(bz_ctx->rp)
+#define rf	(bz_ctx->rf)
+#define cf	(bz_ctx->cf)
+#define bz_y	(bz_ctx->bz_y)
+#endif /* BZ_CONTEXT_ALIASES */
 
 /**************************************************************************/
 /**************************************************************************/
@@ -255,6 +310,15 @@ extern int bz_y[20000];
 extern int bozorth_probe_init( struct xyt_struct *);
 extern int bozorth_gallery_init( struct xyt_struct *);
 extern int bozorth_to_gallery(int, struct xyt_struct *, struct xyt_struct *);
+extern struct bz_edge_table *bozorth_edge_table_build( struct xyt_struct *);
+extern int bozorth_probe_init_from_table( const struct bz_edge_table *);
+extern int bozorth_gallery_init_from_table( const struct bz_edge_table *);
+extern int bozorth_to_gallery_prepared(int, struct xyt_struct *,
+			struct xyt_struct *, const struct bz_edge_table *);
+extern int bozorth_to_gallery_threshold(int, struct xyt_struct *,
+			struct xyt_struct *, int);
+extern int bozorth_to_gallery_prepared_threshold(int, struct xyt_struct *,
+			struct xyt_struct *, const struct bz_edge_table *, int);
 extern int bozorth_main(struct xyt_struct *, struct xyt_struct *);
 /* In: BOZORTH3.C */
 extern void bz_comp(int, int [], int [], int [], int *, int [][COLS_SIZE_2],
@@ -285,5 +349,6 @@ extern int fd_readable(int);
 extern int sort_quality_decreasing(const void *, const void *);
 extern int sort_x_y(const void *, const void *);
 extern int sort_order_decreasing(int [], int, int []);
+extern void sort_edge_table(int *[], int);
 
 #endif /* !_BOZORTH_H */
@@ -123,11 +123,16 @@ typedef struct dftwave{
 } DFTWAVE;
 
 /* DFT wave forms structure containing all wave forms  */
-/* to be used in DFT analysis.                         */
+/* to be used in DFT analysis.  The wave samples are   */
+/* additionally stored as one dense row-major matrix   */
+/* (cos and sin rows interleaved per wave) so that the */
+/* per-block power computation reduces to unit-stride  */
+/* dot products.                                       */
 typedef struct dftwaves{
    int nwaves;
    int wavelen;
    DFTWAVE **waves;
+   double *dense;
 }DFTWAVES;
 
 /* Rotated pixel offsets for a grid of specified dimensions */
@@ -266,8 +271,80 @@ typedef struct g_lfsparms{
    /* Ridge Counting Controls */
    int    max_nbrs;
    int    max_ridge_steps;
+
+   /* Adaptive Binarization Controls */
+   int    adaptive_binarize;
+   int    adaptive_bin_radius;
+   int    adaptive_bin_thresh_pct;
+
+   /* Low Memory Controls */
+   int    low_memory;
 } LFSPARMS;
 
+/* Detection session context carried across the enroll stages of one
+   finger.  Captures of the same finger on the same sensor share most of
+   their ridge flow structure, so the final Direction Map of one stage is
+   kept here and used by the next stage as a starting hypothesis for
+   blocks where the DFT analysis alone could not determine a direction.
+   Seeded directions are vetted by the regular neighbor consistency and
+   smoothing passes before use. */
+typedef struct lfs_session{
+   int *prior_direction_map;  /* final Direction Map of the previous stage */
+   int prior_mw;              /* block dimensions of the prior map */
+   int prior_mh;
+} LFS_SESSION;
+
+/* Progressive detection context for swipe sensors.  The caller feeds
+   finalized row bands as the swipe image is assembled; each fed band is
+   scaled into the padded working image immediately and the initial map
+   entries of every block row whose DFT windows are complete are
+   computed right away, overlapping the dominant map generation stage
+   with image acquisition.  lfs_progressive_finish() computes the
+   remaining bottom block rows and runs the rest of the regular
+   lfs_detect_minutiae_V2 pipeline, with results identical to a
+   whole-image run (the coarse-lattice pyramid approximation is not
+   used on this path). */
+typedef struct lfs_progressive{
+   int iw;                /* unpadded image width */
+   int ih;                /* unpadded rows fed so far */
+   int max_ih;            /* row capacity of the padded buffer */
+   int pad;               /* pad border width */
+   int pw;                /* padded row stride */
+   unsigned char *pdata;  /* padded 6-bit image, filled band by band */
+   int mw;                /* blocks per block row */
+   int bh_done;           /* block rows already computed */
+   int map_alloc;         /* block rows allocated in the maps */
+   int *direction_map;    /* initial maps, grown per block row */
+   int *low_contrast_map;
+   int *low_flow_map;
+   int *blkoffs;
+   DIR2RAD *dir2rad;      /* lookup tables owned by the context */
+   DFTWAVES *dftwaves;
+   ROTGRIDS *dftgrids;
+   ROTGRIDS *dirbingrids;
+   const LFSPARMS *lfsparms;
+} LFS_PROGRESSIVE;
+
+/* Optional compute backend for the data-parallel front-end stages of
+   lfs_detect_minutiae_V2 (map generation and binarization).  A backend
+   registered with lfs_set_offload_backend() is offered each stage first
+   and may decline any of them (NULL member or LFS_OFFLOAD_UNSUPPORTED
+   return), in which case the regular CPU implementation runs; a backend
+   failure also falls back rather than failing the detection.  The
+   branchy minutiae stages always stay on the CPU.  A binarize backend
+   must produce the [0,1] pixel domain of binarize_V2(). */
+typedef struct lfs_offload_backend{
+   const char *name;
+   int (*image_maps)(int **, int **, int **, int **, int *, int *,
+                     unsigned char *, const int, const int,
+                     const DIR2RAD *, const DFTWAVES *,
+                     const ROTGRIDS *, const LFSPARMS *);
+   int (*binarize)(unsigned char **, int *, int *,
+                   unsigned char *, const int, const int,
+                   const int *, const int, const int,
+                   const ROTGRIDS *, const LFSPARMS *);
+} LFS_OFFLOAD_BACKEND;
+
 /*************************************************************************/
 /*        LFS CONSTANT DEFINITIONS                                       */
 /*************************************************************************/
@@ -445,6 +522,14 @@ typedef struct g_lfsparms{
 /* of pixel length 1 in horizontal and vertical runs are filled.   */
 #define NUM_FILL_HOLES           3
 
+/* Neighborhood radius (pixels) of the local mean window used by the */
+/* integral-image adaptive binarizer (see binarize_adaptive()).      */
+#define ADAPTIVE_BIN_RADIUS      8
+
+/* A pixel is binarized to black (ridge) when its intensity falls    */
+/* below this percentage of the local mean.                          */
+#define ADAPTIVE_BIN_THRESH_PCT 92
+
 
 /***** MINUTIAE DETECTION CONSTANTS *****/
 
@@ -680,6 +765,14 @@ typedef struct g_lfsparms{
 /* Pixel value limit in 6-bit image. */
 #define IMG_6BIT_PIX_LIMIT      64
 
+/* Return code reported by lfs_detect_minutiae_V2() when the caller's
+   cancellation check (lfs_set_cancel_check) fired at a stage boundary. */
+#define LFS_CANCELLED         -590
+
+/* Return code of an offload backend stage (see LFS_OFFLOAD_BACKEND)
+   declining the work; the CPU implementation runs instead. */
+#define LFS_OFFLOAD_UNSUPPORTED  1
+
 /* Maximum number (or reallocated chunks) of minutia to be detected */
 /* in an image.                                                     */
 #define MAX_MINUTIAE          1000
@@ -729,8 +822,20 @@ extern int binarize_image_V2(unsigned char **, int *, int *,
                      unsigned char *, const int, const int,
                      const int *, const int, const int,
                      const int, const ROTGRIDS *);
+extern void binarize_image_V2_band(unsigned char *, const int, const int,
+                     unsigned char *, const int, const int,
+                     const int *, const int, const int,
+                     const int, const ROTGRIDS *);
 extern int dirbinarize(const unsigned char *, const int, const ROTGRIDS *);
 extern int isobinarize(unsigned char *, const int, const int, const int);
+extern int binarize_adaptive(unsigned char **, int *, int *,
+                 unsigned char *, const int, const int,
+                 int *, const int, const int,
+                 const int, const LFSPARMS *);
+extern int binarize_image_adaptive(unsigned char **, int *, int *,
+                 unsigned char *, const int, const int,
+                 const int *, const int, const int,
+                 const int, const int, const LFSPARMS *);
 
 /* block.c */
 extern int block_offsets(int **, int *, int *, const int, const int,
@@ -785,7 +890,23 @@ extern int lfs_detect_minutiae_V2(MINUTIAE **,
                      int **, int **, int **, int **, int *, int *,
                      unsigned char **, int *, int *,
                      unsigned char *, const int, const int,
+                     const LFSPARMS *, LFS_SESSION *);
+extern int lfs_detect_minutiae_V2_low_mem(MINUTIAE **,
+                     int **, int **, int **, int **, int *, int *,
+                     unsigned char **, int *, int *,
+                     unsigned char *, const int, const int,
+                     const LFSPARMS *, LFS_SESSION *);
+extern LFS_SESSION *lfs_session_new(void);
+extern void lfs_session_free(LFS_SESSION *);
+extern void lfs_set_cancel_check(int (*)(void *), void *);
+extern int lfs_progressive_start(LFS_PROGRESSIVE **, const int, const int,
                      const LFSPARMS *);
+extern int lfs_progressive_feed(LFS_PROGRESSIVE *, unsigned char *,
+                     const int);
+extern int lfs_progressive_finish(LFS_PROGRESSIVE *, MINUTIAE **,
+                     int **, int **, int **, int **, int *, int *,
+                     unsigned char **, int *, int *, LFS_SESSION *);
+extern void lfs_progressive_free(LFS_PROGRESSIVE *);
 
 /* dft.c */
 extern int dft_dir_powers(double **, unsigned char *, const int,
@@ -794,6 +915,8 @@ extern int dft_dir_powers(double **, unsigned char *, const int,
 extern void sum_rot_block_rows(int *, const unsigned char *, const int *,
                      const int);
 extern void dft_power(double *, const int *, const DFTWAVE *, const int);
+extern void dft_power_dense(double **, const int, const double *,
+                 const DFTWAVES *);
 extern int dft_power_stats(int *, double *, int *, double *, double **,
                      const int, const int, const int);
 extern void get_max_norm(double *, int *, double *, const double *, const int);
@@ -810,7 +933,8 @@ extern int get_minutiae(MINUTIAE **, int **, int **, int **,
                  int **, int **, int *, int *,
                  unsigned char **, int *, int *, int *,
                  unsigned char *, const int, const int,
-                 const int, const double, const LFSPARMS *);
+                 const int, const double, const LFSPARMS *,
+                 LFS_SESSION *);
 
 /* imgutil.c */
 extern void bits_6to8(unsigned char *, const int, const int);
@@ -820,6 +944,8 @@ extern void gray2bin(const int, const int, const int,
 extern int pad_uchar_image(unsigned char **, int *, int *,
                      unsigned char *, const int, const int, const int,
                      const int);
+extern void pad_uchar_image_8to6(unsigned char *, const int,
+                     unsigned char *, const int, const int, const int);
 extern void fill_holes(unsigned char *, const int, const int);
 extern int free_path(const int, const int, const int, const int,
                      unsigned char *, const int, const int, const LFSPARMS *);
@@ -899,13 +1025,21 @@ extern void flood_fill4(const int, const int, const int,
 extern int gen_image_maps(int **, int **, int **, int **, int *, int *,
                     unsigned char *, const int, const int,
                     const DIR2RAD *, const DFTWAVES *,
-                    const ROTGRIDS *, const LFSPARMS *);
+                    const ROTGRIDS *, const LFSPARMS *, LFS_SESSION *);
 extern int gen_initial_maps(int **, int **, int **,
                     int *, const int, const int,
                     unsigned char *, const int, const int,
                     const DFTWAVES *, const  ROTGRIDS *, const LFSPARMS *);
+extern int gen_initial_maps_band(int *, int *, int *,
+                    int *, const int, const int, const int,
+                    unsigned char *, const int, const int,
+                    const DFTWAVES *, const ROTGRIDS *, const LFSPARMS *);
+extern int gen_image_maps_finish(int **, int **, int **, int **,
+                    int *, int *, int *, int *, int *,
+                    const int, const int,
+                    const DIR2RAD *, const LFSPARMS *, LFS_SESSION *);
 extern int interpolate_direction_map(int *, int *, const int, const int,
-                    const LFSPARMS *);
+                    const DIR2RAD *, const LFSPARMS *);
 extern int morph_TF_map(int *, const int, const int, const LFSPARMS *);
 extern int pixelize_map(int **, const int, const int,
                      int *, const int, const int, const int);
@@ -958,6 +1092,12 @@ extern int curvature(int *, const int, const int, const int, const int,
 extern int match_1st_pair(unsigned char, unsigned char, int *, int *);
 extern int match_2nd_pair(unsigned char, unsigned char, int *, int *);
 extern int match_3rd_pair(unsigned char, unsigned char, int *, int *);
+extern unsigned int match_1st_pair_mask(unsigned char, unsigned char);
+extern unsigned int match_2nd_pair_mask(unsigned char, unsigned char,
+                     unsigned int);
+extern unsigned int match_3rd_pair_mask(unsigned char, unsigned char,
+                     unsigned int);
+extern int match_first_feature(unsigned int);
 extern void skip_repeated_horizontal_pair(int *, const int,
                      unsigned char **, unsigned char **, const int, const int);
 extern void skip_repeated_vertical_pair(int *, const int,
@@ -985,7 +1125,7 @@ extern int rm_dup_minutiae(MINUTIAE *);
 extern void dump_minutiae(FILE *, const MINUTIAE *);
 extern void dump_minutiae_pts(FILE *, const MINUTIAE *);
 extern void dump_reliable_minutiae_pts(FILE *, const MINUTIAE *, const double);
-extern int create_minutia(MINUTIA **, const int, const int,
+extern int create_minutia(MINUTIA **, MINUTIAE *, const int, const int,
                      const int, const int, const int, const double,
                      const int, const int, const int);
 extern void free_minutiae(MINUTIAE *);
@@ -1074,12 +1214,29 @@ extern int adjust_high_curvature_minutia_V2(int *, int *, int *,
 extern int get_low_curvature_direction(const int, const int, const int,
                      const int);
 
+/* offload.c */
+extern void lfs_set_offload_backend(const LFS_OFFLOAD_BACKEND *);
+extern int offload_image_maps(int **, int **, int **, int **, int *, int *,
+                     unsigned char *, const int, const int,
+                     const DIR2RAD *, const DFTWAVES *,
+                     const ROTGRIDS *, const LFSPARMS *);
+extern int offload_binarize(unsigned char **, int *, int *,
+                     unsigned char *, const int, const int,
+                     const int *, const int, const int,
+                     const ROTGRIDS *, const LFSPARMS *);
+
 /* quality.c */
+extern int gen_quality_map_block(int *, int *, int *, int *,
+                     const int, const int, const int, const int);
 extern int gen_quality_map(int **, int *, int *, int *, int *,
                      const int, const int);
 extern int combined_minutia_quality(MINUTIAE *, int *, const int, const int,
                      const int, unsigned char *, const int, const int,
                      const int, const double);
+extern int combined_minutia_quality_lazy(MINUTIAE *, int **, int *, int *,
+                     int *, int *, const int, const int, const int,
+                     unsigned char *, const int, const int, const int,
+                     const double);
 double grayscale_reliability(MINUTIA *, unsigned char *,
                      const int, const int, const int);
 extern void get_neighborhood_stats(double *, double *, MINUTIA *,
@@ -1189,6 +1346,7 @@ extern void sort_row_on_x(ROW *);
 /* sort.c */
 extern int sort_indices_int_inc(int **, int *, const int);
 extern int sort_indices_double_inc(int **, double *, const int);
+extern void radix_sort_int_inc_2(int *, int *, const int);
 extern void bubble_sort_int_inc_2(int *, int *, const int);
 extern void bubble_sort_double_inc_2(double *, int *, const int);
 extern void bubble_sort_double_dec_2(double *, int *,  const int);
@@ -1218,12 +1376,16 @@ extern void lfs2nist_format(MINUTIAE *, int, int);
 /*************************************************************************/
 /*        EXTERNAL GLOBAL VARIABLE DEFINITIONS                           */
 /*************************************************************************/
-extern double g_dft_coefs[];
-extern LFSPARMS g_lfsparms;
-extern LFSPARMS g_lfsparms_V2;
-extern int g_nbr8_dx[];
-extern int g_nbr8_dy[];
-extern int g_chaincodes_nbr8[];
-extern FEATURE_PATTERN g_feature_patterns[];
+/* All of these are read-only: every mutable piece of detection state
+   lives in the per-call LFS_SESSION / scratch structures (or is
+   thread-local), so concurrent get_minutiae() calls never share
+   writable data. */
+extern const double g_dft_coefs[];
+extern const LFSPARMS g_lfsparms;
+extern const LFSPARMS g_lfsparms_V2;
+extern const int g_nbr8_dx[];
+extern const int g_nbr8_dy[];
+extern const int g_chaincodes_nbr8[];
+extern const FEATURE_PATTERN g_feature_patterns[];
 
 #endif
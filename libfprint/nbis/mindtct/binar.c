@@ -63,11 +63,124 @@ of the software.
 			binarize_image_V2()
                         dirbinarize()
                         isobinarize()
+                        binarize_adaptive()
+                        binarize_image_adaptive()
 
 ***********************************************************************/
 
 #include <stdio.h>
 #include <lfs.h>
+#include <fpi-simd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BINAR_HAVE_SIMD 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BINAR_HAVE_SIMD 1
+#endif
+
+#ifdef BINAR_HAVE_SIMD
+/*************************************************************************
+**************************************************************************
+#cat: dirbinarize_run16 - Vectorized equivalent of calling dirbinarize()
+#cat:              on 16 horizontally consecutive pixels that share the
+#cat:              same (VALID) block direction.  Instead of gathering the
+#cat:              rotated grid per pixel, each grid offset is applied to
+#cat:              all 16 pixels with one wide load, accumulating 16
+#cat:              independent grid and center-row sums.
+
+   CAUTION: All 16 pixels must lie within the same direction block, and
+            the image must be padded for the rotated grid radius like for
+            dirbinarize().
+
+   Input:
+      pptr        - pointer to first of 16 consecutive grayscale pixels
+      idir        - IMAP integer direction shared by all 16 pixels
+      dirbingrids - set of precomputed rotated grid offsets
+      cy          - precomputed center row index of the rotated grid
+   Output:
+      bptr        - receives 16 binary pixels {0 = black, 1 = white}
+**************************************************************************/
+FPI_SIMD_CLONES static void dirbinarize_run16(unsigned char *bptr, const unsigned char *pptr,
+                  const int idir, const ROTGRIDS *dirbingrids, const int cy)
+{
+   int gx, gy, gi;
+   int *grid;
+
+   grid = dirbingrids->grids[idir];
+   gi = 0;
+
+#if defined(__SSE2__)
+   {
+      __m128i gsum_lo, gsum_hi, csum_lo, csum_hi;
+      __m128i zero, gh, mask_lo, mask_hi;
+
+      zero = _mm_setzero_si128();
+      gsum_lo = zero; gsum_hi = zero;
+      csum_lo = zero; csum_hi = zero;
+
+      for(gy = 0; gy < dirbingrids->grid_h; gy++){
+         __m128i rsum_lo = zero, rsum_hi = zero;
+         for(gx = 0; gx < dirbingrids->grid_w; gx++){
+            __m128i pix = _mm_loadu_si128((const __m128i *)(pptr+grid[gi]));
+            rsum_lo = _mm_add_epi16(rsum_lo, _mm_unpacklo_epi8(pix, zero));
+            rsum_hi = _mm_add_epi16(rsum_hi, _mm_unpackhi_epi8(pix, zero));
+            gi++;
+         }
+         gsum_lo = _mm_add_epi16(gsum_lo, rsum_lo);
+         gsum_hi = _mm_add_epi16(gsum_hi, rsum_hi);
+         if(gy == cy){
+            csum_lo = rsum_lo;
+            csum_hi = rsum_hi;
+         }
+      }
+
+      /* BLACK where (csum * grid_h) < gsum; maximum sums fit in  */
+      /* signed 16 bits (7x9 grid of 8-bit pixels).  Emit 0/1     */
+      /* directly in the domain minutiae detection consumes.      */
+      gh = _mm_set1_epi16((short)dirbingrids->grid_h);
+      mask_lo = _mm_cmpgt_epi16(gsum_lo, _mm_mullo_epi16(csum_lo, gh));
+      mask_hi = _mm_cmpgt_epi16(gsum_hi, _mm_mullo_epi16(csum_hi, gh));
+      _mm_storeu_si128((__m128i *)bptr,
+                       _mm_andnot_si128(_mm_packs_epi16(mask_lo, mask_hi),
+                                        _mm_set1_epi8(1)));
+   }
+#elif defined(__ARM_NEON)
+   {
+      uint16x8_t gsum_lo, gsum_hi, csum_lo, csum_hi;
+      uint16x8_t gh;
+      uint8x16_t mask;
+
+      gsum_lo = vdupq_n_u16(0); gsum_hi = vdupq_n_u16(0);
+      csum_lo = vdupq_n_u16(0); csum_hi = vdupq_n_u16(0);
+
+      for(gy = 0; gy < dirbingrids->grid_h; gy++){
+         uint16x8_t rsum_lo = vdupq_n_u16(0), rsum_hi = vdupq_n_u16(0);
+         for(gx = 0; gx < dirbingrids->grid_w; gx++){
+            uint8x16_t pix = vld1q_u8(pptr+grid[gi]);
+            rsum_lo = vaddw_u8(rsum_lo, vget_low_u8(pix));
+            rsum_hi = vaddw_u8(rsum_hi, vget_high_u8(pix));
+            gi++;
+         }
+         gsum_lo = vaddq_u16(gsum_lo, rsum_lo);
+         gsum_hi = vaddq_u16(gsum_hi, rsum_hi);
+         if(gy == cy){
+            csum_lo = rsum_lo;
+            csum_hi = rsum_hi;
+         }
+      }
+
+      gh = vdupq_n_u16((unsigned short)dirbingrids->grid_h);
+      mask = vcombine_u8(vmovn_u16(vcgtq_u16(gsum_lo, vmulq_u16(csum_lo, gh))),
+                         vmovn_u16(vcgtq_u16(gsum_hi, vmulq_u16(csum_hi, gh))));
+      /* mask lanes are all-ones where BLACK; invert and mask down */
+      /* to the 1/0 domain minutiae detection consumes.            */
+      vst1q_u8(bptr, vandq_u8(vmvnq_u8(mask), vdupq_n_u8(1)));
+   }
+#endif
+}
+#endif /* BINAR_HAVE_SIMD */
 
 /*************************************************************************
 **************************************************************************
@@ -117,6 +230,7 @@ of the software.
       lfsparms    - parameters and thresholds for controlling LFS
    Output:
       odata - points to created (unpadded) binary image
+              {0 = black pixel (ridge) and 1 = white pixel (valley)}
       ow    - width of binary image
       oh    - height of binary image
    Return Code:
@@ -195,6 +309,7 @@ int binarize_V2(unsigned char **odata, int *ow, int *oh,
                     binarization
    Output:
       odata  - points to binary image results
+               {0 = black pixel (ridge) and 1 = white pixel (valley)}
       ow     - points to binary image width
       oh     - points to binary image height
    Return Code:
@@ -206,9 +321,8 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
                    const int *direction_map, const int mw, const int mh,
                    const int blocksize, const ROTGRIDS *dirbingrids)
 {
-   int ix, iy, bw, bh, bx, by, mapval;
-   unsigned char *bdata, *bptr;
-   unsigned char *pptr, *spptr;
+   int bw, bh;
+   unsigned char *bdata;
 
    /* Compute dimensions of "unpadded" binary image results. */
    bw = pw - (dirbingrids->pad<<1);
@@ -216,12 +330,70 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
 
    bdata = (unsigned char *)g_malloc(bw * bh * sizeof(unsigned char));
 
-   bptr = bdata;
-   spptr = pdata + (dirbingrids->pad * pw) + dirbingrids->pad;
-   for(iy = 0; iy < bh; iy++){
+   binarize_image_V2_band(bdata, 0, bh, pdata, pw, ph,
+                          direction_map, mw, mh, blocksize, dirbingrids);
+
+   *odata = bdata;
+   *ow = bw;
+   *oh = bh;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: binarize_image_V2_band - Binarizes a contiguous band of image rows
+#cat:              into a caller-provided full-width binary image.  Only
+#cat:              the padded rows covered by the band's rotated grids
+#cat:              (the band rows plus twice the grid pad below them) are
+#cat:              read, so the low-memory detection path can present a
+#cat:              sliding window of the padded image instead of holding
+#cat:              it whole; binarize_image_V2() runs it over every row.
+
+   Input:
+      iy_first    - first binary image row of the band
+      iy_last     - row after the last binary image row of the band
+      pdata       - padded input grayscale image
+      pw          - padded width (in pixels) of input image
+      ph          - padded height (in pixels) of input image
+      direction_map - 2-D vector of discrete ridge flow directions
+      mw          - width (in blocks) of the map
+      mh          - height (in blocks) of the map
+      blocksize   - dimension (in pixels) of each NMAP block
+      dirbingrids - set of rotated grid offsets used for directional
+                    binarization
+   Output:
+      bdata  - band rows of the binary image results are filled
+               {0 = black pixel (ridge) and 1 = white pixel (valley)}
+**************************************************************************/
+void binarize_image_V2_band(unsigned char *bdata,
+                   const int iy_first, const int iy_last,
+                   unsigned char *pdata, const int pw, const int ph,
+                   const int *direction_map, const int mw, const int mh,
+                   const int blocksize, const ROTGRIDS *dirbingrids)
+{
+   int ix, iy, bw, bx, by, mapval;
+   unsigned char *bptr;
+   unsigned char *pptr, *spptr;
+#ifdef BINAR_HAVE_SIMD
+   int cy;
+   double dcy;
+
+   /* Precompute the rotated grid's center row once; dirbinarize()    */
+   /* rederives this per pixel, but it only depends on the grid size. */
+   dcy = (dirbingrids->grid_h-1)/(double)2.0;
+   dcy = trunc_dbl_precision(dcy, TRUNC_SCALE);
+   cy = sround(dcy);
+#endif
+
+   /* Compute width of "unpadded" binary image results. */
+   bw = pw - (dirbingrids->pad<<1);
+
+   bptr = bdata + (iy_first * bw);
+   spptr = pdata + ((dirbingrids->pad + iy_first) * pw) + dirbingrids->pad;
+   for(iy = iy_first; iy < iy_last; iy++){
       /* Set pixel pointer to start of next row in grid. */
       pptr = spptr;
-      for(ix = 0; ix < bw; ix++){
+      for(ix = 0; ix < bw; ){
 
          /* Compute which block the current pixel is in. */
          bx = (int)(ix/blocksize);
@@ -229,21 +401,204 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
          /* Get corresponding value in Direction Map. */
          mapval = *(direction_map + (by*mw) + bx);
          /* If current block has has INVALID direction ... */
-         if(mapval == INVALID_DIR)
-            /* Set binary pixel to white (255). */
-            *bptr = WHITE_PIXEL;
-         /* Otherwise, if block has a valid direction ... */
-         else /*if(mapval >= 0)*/
-            /* Use directional binarization based on block's direction. */
-            *bptr = dirbinarize(pptr, mapval, dirbingrids);
+         if(mapval == INVALID_DIR){
+            /* Set binary pixel to white (1). */
+            *bptr = 1;
+            pptr++;
+            bptr++;
+            ix++;
+            continue;
+         }
+#ifdef BINAR_HAVE_SIMD
+         /* If 16 consecutive pixels remain within this block and row, */
+         /* binarize them in one vectorized pass.                      */
+         if(((bx+1)*blocksize)-ix >= 16 && bw-ix >= 16){
+            dirbinarize_run16(bptr, pptr, mapval, dirbingrids, cy);
+            pptr += 16;
+            bptr += 16;
+            ix += 16;
+            continue;
+         }
+#endif
+         /* Use directional binarization based on block's direction, */
+         /* mapping the result into the [0,1] output domain.         */
+         *bptr = (dirbinarize(pptr, mapval, dirbingrids) == WHITE_PIXEL);
 
          /* Bump input and output pixel pointers. */
          pptr++;
          bptr++;
+         ix++;
       }
       /* Bump pointer to the next row in padded input image. */
       spptr += pw;
    }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: binarize_adaptive - Takes a padded grayscale input image and produces
+#cat:              a binarized version using a local-mean adaptive threshold
+#cat:              instead of directional ridge filters.  A shared
+#cat:              summed-area table makes the local mean of the window
+#cat:              around each pixel an O(1) lookup, so the cost per pixel
+#cat:              is constant and well below the rotated-grid filter of
+#cat:              binarize_V2().  Intended for unevenly lit sensors where
+#cat:              the directional filter binarizes poorly.  Holes are
+#cat:              filled like in binarize_V2().
+
+   Input:
+      pdata       - padded input grayscale image
+      pw          - padded width (in pixels) of input image
+      ph          - padded height (in pixels) of input image
+      direction_map - 2-D vector of discrete ridge flow directions
+      mw          - width (in blocks) of the map
+      mh          - height (in blocks) of the map
+      pad         - image pad size (in pixels)
+      lfsparms    - parameters and thresholds for controlling LFS
+   Output:
+      odata - points to created (unpadded) binary image
+              {0 = black pixel (ridge) and 1 = white pixel (valley)}
+      ow    - width of binary image
+      oh    - height of binary image
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int binarize_adaptive(unsigned char **odata, int *ow, int *oh,
+          unsigned char *pdata, const int pw, const int ph,
+          int *direction_map, const int mw, const int mh,
+          const int pad, const LFSPARMS *lfsparms)
+{
+   unsigned char *bdata;
+   int i, bw, bh, ret; /* return code */
+
+   /* 1. Binarize the padded input image with the adaptive threshold. */
+   if((ret = binarize_image_adaptive(&bdata, &bw, &bh, pdata, pw, ph,
+                            direction_map, mw, mh,
+                            lfsparms->blocksize, pad, lfsparms))){
+      return(ret);
+   }
+
+   /* 2. Fill black and white holes in binary image. */
+   /* LFS scans the binary image, filling holes, 3 times. */
+   for(i = 0; i < lfsparms->num_fill_holes; i++)
+      fill_holes(bdata, bw, bh);
+
+   /* Return binarized input image. */
+   *odata = bdata;
+   *ow = bw;
+   *oh = bh;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: binarize_image_adaptive - Takes a grayscale input image and generates
+#cat:              a binarized version by thresholding each pixel against
+#cat:              the mean intensity of its surrounding window.  The means
+#cat:              come from a summed-area table built in a single pass, so
+#cat:              every window lookup is 4 additions regardless of the
+#cat:              window radius.  Blocks with INVALID ridge flow are forced
+#cat:              to white like in binarize_image_V2() so downstream
+#cat:              masking behaves identically.
+
+   Input:
+      pdata       - padded input grayscale image
+      pw          - padded width (in pixels) of input image
+      ph          - padded height (in pixels) of input image
+      direction_map - 2-D vector of discrete ridge flow directions
+      mw          - width (in blocks) of the map
+      mh          - height (in blocks) of the map
+      blocksize   - dimension (in pixels) of each map block
+      pad         - image pad size (in pixels)
+      lfsparms    - parameters and thresholds for controlling LFS
+   Output:
+      odata  - points to binary image results
+               {0 = black pixel (ridge) and 1 = white pixel (valley)}
+      ow     - points to binary image width
+      oh     - points to binary image height
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int binarize_image_adaptive(unsigned char **odata, int *ow, int *oh,
+                   unsigned char *pdata, const int pw, const int ph,
+                   const int *direction_map, const int mw, const int mh,
+                   const int blocksize, const int pad,
+                   const LFSPARMS *lfsparms)
+{
+   int ix, iy, bw, bh, bx, by;
+   int x1, y1, x2, y2, radius, area;
+   guint64 *intgrl, *irow, *prow, sum;
+   unsigned char *bdata, *bptr, *pptr, *sptr;
+
+   /* Compute dimensions of "unpadded" binary image results. */
+   bw = pw - (pad<<1);
+   bh = ph - (pad<<1);
+   radius = lfsparms->adaptive_bin_radius;
+
+   /* Build a summed-area table over the unpadded image interior with  */
+   /* a zeroed leading row and column, so the sum of any window is the */
+   /* usual 4-corner combination without edge special cases.  64-bit   */
+   /* accumulators cannot overflow for any practical image size.       */
+   intgrl = g_new(guint64, (guint64)(bw+1) * (bh+1));
+   memset(intgrl, 0, (bw+1) * sizeof(guint64));
+   sptr = pdata + (pad * pw) + pad;
+   prow = intgrl;
+   for(iy = 0; iy < bh; iy++){
+      irow = prow + (bw+1);
+      irow[0] = 0;
+      sum = 0;
+      pptr = sptr;
+      for(ix = 0; ix < bw; ix++){
+         sum += *pptr++;
+         irow[ix+1] = prow[ix+1] + sum;
+      }
+      prow = irow;
+      sptr += pw;
+   }
+
+   bdata = (unsigned char *)g_malloc(bw * bh * sizeof(unsigned char));
+
+   bptr = bdata;
+   sptr = pdata + (pad * pw) + pad;
+   for(iy = 0; iy < bh; iy++){
+      y1 = max(iy - radius, 0);
+      y2 = min(iy + radius, bh - 1);
+      pptr = sptr;
+      for(ix = 0; ix < bw; ix++){
+         /* Compute which block the current pixel is in. */
+         bx = (int)(ix/blocksize);
+         by = (int)(iy/blocksize);
+         /* If current block has has INVALID direction ... */
+         if(*(direction_map + (by*mw) + bx) == INVALID_DIR){
+            /* Set binary pixel to white (1). */
+            *bptr++ = 1;
+            pptr++;
+            continue;
+         }
+
+         x1 = max(ix - radius, 0);
+         x2 = min(ix + radius, bw - 1);
+         area = (x2 - x1 + 1) * (y2 - y1 + 1);
+         sum = intgrl[(guint64)(y2+1)*(bw+1) + (x2+1)]
+             - intgrl[(guint64)(y1)*(bw+1) + (x2+1)]
+             - intgrl[(guint64)(y2+1)*(bw+1) + (x1)]
+             + intgrl[(guint64)(y1)*(bw+1) + (x1)];
+
+         /* Black (ridge) when the pixel falls below the configured    */
+         /* percentage of the window's mean; the comparison is kept in */
+         /* integers by scaling both sides with the window area.       */
+         if((guint64)(*pptr) * area * 100 < sum * lfsparms->adaptive_bin_thresh_pct)
+            *bptr++ = 0;
+         else
+            *bptr++ = 1;
+         pptr++;
+      }
+      sptr += pw;
+   }
+
+   g_free(intgrl);
 
    *odata = bdata;
    *ow = bw;
@@ -102,24 +102,79 @@ of the software.
       Zero      - lists were successfully allocated
       Negative  - system (allocation) error
 **************************************************************************/
+/* Per-thread cache of contour buffer sets.  Every minutia candidate      */
+/* traced during detection allocates and frees 4 coordinate lists, which  */
+/* makes the allocator the hottest spot of contour tracing on dense       */
+/* prints.  Freed buffer sets are parked here and handed back out by      */
+/* allocate_contour() when their capacity suffices.  The cache is         */
+/* thread-local so concurrent detections never share buffers.             */
+#define CONTOUR_CACHE_DEPTH 8
+
+typedef struct contour_bufs{
+   int *contour_x;
+   int *contour_y;
+   int *contour_ex;
+   int *contour_ey;
+   int cap;
+} CONTOUR_BUFS;
+
+/* Buffer sets currently handed out (tracked so free_contour() can */
+/* recover their capacity) and sets available for reuse.           */
+static __thread CONTOUR_BUFS g_contour_live[CONTOUR_CACHE_DEPTH];
+static __thread CONTOUR_BUFS g_contour_avail[CONTOUR_CACHE_DEPTH];
+
 int allocate_contour(int **ocontour_x, int **ocontour_y,
                      int **ocontour_ex, int **ocontour_ey, const int ncontour)
 {
    int *contour_x, *contour_y, *contour_ex, *contour_ey;
+   int i, cap;
 
    ASSERT_SIZE_MUL(ncontour, sizeof(int));
 
-   /* Allocate contour's x-coord list. */
-   contour_x = (int *)g_malloc(ncontour * sizeof(int));
+   cap = ncontour;
+
+   /* Look for a cached buffer set large enough for this contour. */
+   for(i = 0; i < CONTOUR_CACHE_DEPTH; i++){
+      if((g_contour_avail[i].contour_x != NULL) &&
+         (g_contour_avail[i].cap >= ncontour))
+         break;
+   }
+
+   if(i < CONTOUR_CACHE_DEPTH){
+      /* Reuse the cached set, remembering its real capacity. */
+      contour_x = g_contour_avail[i].contour_x;
+      contour_y = g_contour_avail[i].contour_y;
+      contour_ex = g_contour_avail[i].contour_ex;
+      contour_ey = g_contour_avail[i].contour_ey;
+      cap = g_contour_avail[i].cap;
+      g_contour_avail[i].contour_x = NULL;
+   }
+   else{
+      /* Allocate contour's x-coord list. */
+      contour_x = (int *)g_malloc(ncontour * sizeof(int));
 
-   /* Allocate contour's y-coord list. */
-   contour_y = (int *)g_malloc(ncontour * sizeof(int));
+      /* Allocate contour's y-coord list. */
+      contour_y = (int *)g_malloc(ncontour * sizeof(int));
 
-   /* Allocate contour's edge x-coord list. */
-   contour_ex = (int *)g_malloc(ncontour * sizeof(int));
+      /* Allocate contour's edge x-coord list. */
+      contour_ex = (int *)g_malloc(ncontour * sizeof(int));
 
-   /* Allocate contour's edge y-coord list. */
-   contour_ey = (int *)g_malloc(ncontour * sizeof(int));
+      /* Allocate contour's edge y-coord list. */
+      contour_ey = (int *)g_malloc(ncontour * sizeof(int));
+   }
+
+   /* Track the buffer set so free_contour() can cache it again.  If */
+   /* the live table is full, the set is simply freed for real.      */
+   for(i = 0; i < CONTOUR_CACHE_DEPTH; i++){
+      if(g_contour_live[i].contour_x == NULL){
+         g_contour_live[i].contour_x = contour_x;
+         g_contour_live[i].contour_y = contour_y;
+         g_contour_live[i].contour_ex = contour_ex;
+         g_contour_live[i].contour_ey = contour_ey;
+         g_contour_live[i].cap = cap;
+         break;
+      }
+   }
 
    /* Otherwise, allocations successful, so assign output pointers. */
    *ocontour_x = contour_x;
@@ -152,6 +207,25 @@ int allocate_contour(int **ocontour_x, int **ocontour_y,
 void free_contour(int *contour_x, int *contour_y,
                   int *contour_ex, int *contour_ey)
 {
+   int i, j;
+
+   /* If the buffer set is tracked, park it for reuse instead of */
+   /* freeing it (see allocate_contour() above).                 */
+   for(i = 0; i < CONTOUR_CACHE_DEPTH; i++){
+      if((contour_x != NULL) && (g_contour_live[i].contour_x == contour_x)){
+         for(j = 0; j < CONTOUR_CACHE_DEPTH; j++){
+            if(g_contour_avail[j].contour_x == NULL){
+               g_contour_avail[j] = g_contour_live[i];
+               g_contour_live[i].contour_x = NULL;
+               return;
+            }
+         }
+         /* No room in the reuse table; forget the set and free it. */
+         g_contour_live[i].contour_x = NULL;
+         break;
+      }
+   }
+
    g_free(contour_x);
    g_free(contour_y);
    g_free(contour_ex);
@@ -56,16 +56,590 @@ of the software.
 
 ***********************************************************************
                ROUTINES:
+                        lfs_session_new()
+                        lfs_session_free()
+                        lfs_set_cancel_check()
                         lfs_detect_minutiae()
                         lfs_detect_minutiae_V2()
 
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <lfs.h>
 #include <mytime.h>
 #include <log.h>
 
+/* Cached LFS working memories: the direction lookup tables, DFT wave
+   forms, rotated grid offsets and the padded image buffer only depend
+   on the image geometry and parameters, yet were reallocated and
+   recomputed for every image.  They are retained here across calls on
+   the same thread instead.  Minutiae detection runs on pool threads,
+   so no locking is needed and each thread converges on the sensor
+   geometry it services. */
+typedef struct lfs_scratch {
+   int iw, ih;
+   int num_directions;
+   int windowsize, windowoffset;
+   int dirbin_grid_w, dirbin_grid_h;
+   double start_dir_angle;
+   int pad_value;
+   int maxpad;
+   DIR2RAD *dir2rad;
+   DFTWAVES *dftwaves;
+   ROTGRIDS *dftgrids;
+   ROTGRIDS *dirbingrids;
+   unsigned char *pdata;
+   int pw, ph;
+} LFS_SCRATCH;
+
+static __thread LFS_SCRATCH lfs_scratch;
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_scratch_release - Deallocates a thread's set of cached LFS
+#cat:              working memories.
+
+   Input:
+      scratch   - the scratch set to be released
+**************************************************************************/
+static void lfs_scratch_release(LFS_SCRATCH *scratch)
+{
+   if(scratch->dir2rad != (DIR2RAD *)NULL)
+      free_dir2rad(scratch->dir2rad);
+   if(scratch->dftwaves != (DFTWAVES *)NULL)
+      free_dftwaves(scratch->dftwaves);
+   if(scratch->dftgrids != (ROTGRIDS *)NULL)
+      free_rotgrids(scratch->dftgrids);
+   if(scratch->dirbingrids != (ROTGRIDS *)NULL)
+      free_rotgrids(scratch->dirbingrids);
+   g_free(scratch->pdata);
+
+   memset(scratch, 0, sizeof(*scratch));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_scratch_prepare - Prepares a thread's set of cached LFS working
+#cat:              memories for an image of the given dimensions.  If the
+#cat:              cached set was built for the same dimensions and
+#cat:              parameters it is reused as is, otherwise it is rebuilt.
+
+   Input:
+      scratch   - the scratch set to be prepared
+      iw        - width (in pixels) of the input image
+      ih        - height (in pixels) of the input image
+      lfsparms  - parameters and thresholds for controlling LFS
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+static int lfs_scratch_prepare(LFS_SCRATCH *scratch,
+                  const int iw, const int ih, const LFSPARMS *lfsparms)
+{
+   int ret, maxpad;
+
+   if((scratch->pdata != (unsigned char *)NULL) &&
+      (scratch->iw == iw) && (scratch->ih == ih) &&
+      (scratch->num_directions == lfsparms->num_directions) &&
+      (scratch->windowsize == lfsparms->windowsize) &&
+      (scratch->windowoffset == lfsparms->windowoffset) &&
+      (scratch->dirbin_grid_w == lfsparms->dirbin_grid_w) &&
+      (scratch->dirbin_grid_h == lfsparms->dirbin_grid_h) &&
+      (scratch->start_dir_angle == lfsparms->start_dir_angle) &&
+      (scratch->pad_value == lfsparms->pad_value))
+      /* The cached memories match, nothing to do. */
+      return(0);
+
+   lfs_scratch_release(scratch);
+
+   /* Determine the maximum amount of image padding required to support */
+   /* LFS processes.                                                    */
+   maxpad = get_max_padding_V2(lfsparms->windowsize, lfsparms->windowoffset,
+                          lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
+
+   /* Initialize lookup table for converting integer directions */
+   /* to angles in radians.                                     */
+   if((ret = init_dir2rad(&scratch->dir2rad, lfsparms->num_directions))){
+      lfs_scratch_release(scratch);
+      return(ret);
+   }
+
+   /* Initialize wave form lookup tables for DFT analyses. */
+   /* used for direction binarization.                             */
+   if((ret = init_dftwaves(&scratch->dftwaves, g_dft_coefs,
+                        lfsparms->num_dft_waves, lfsparms->windowsize))){
+      lfs_scratch_release(scratch);
+      return(ret);
+   }
+
+   /* Initialize lookup table for pixel offsets to rotated grids */
+   /* used for DFT analyses.                                     */
+   if((ret = init_rotgrids(&scratch->dftgrids, iw, ih, maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->windowsize, lfsparms->windowsize,
+                        RELATIVE2ORIGIN))){
+      lfs_scratch_release(scratch);
+      return(ret);
+   }
+
+   /* Initialize lookup table for pixel offsets to rotated grids */
+   /* used for directional binarization.                         */
+   if((ret = init_rotgrids(&scratch->dirbingrids, iw, ih, maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
+                        RELATIVE2CENTER))){
+      lfs_scratch_release(scratch);
+      return(ret);
+   }
+
+   /* Allocate the padded image buffer; its interior is refilled per  */
+   /* image while the pad border, filled once here with the scaled    */
+   /* pad value, is never written again (see pad_uchar_image_8to6).   */
+   scratch->pw = iw + (maxpad<<1);
+   scratch->ph = ih + (maxpad<<1);
+   scratch->pdata = (unsigned char *)g_malloc(scratch->pw * scratch->ph);
+   memset(scratch->pdata, lfsparms->pad_value >> 2, scratch->pw * scratch->ph);
+
+   scratch->iw = iw;
+   scratch->ih = ih;
+   scratch->num_directions = lfsparms->num_directions;
+   scratch->windowsize = lfsparms->windowsize;
+   scratch->windowoffset = lfsparms->windowoffset;
+   scratch->dirbin_grid_w = lfsparms->dirbin_grid_w;
+   scratch->dirbin_grid_h = lfsparms->dirbin_grid_h;
+   scratch->start_dir_angle = lfsparms->start_dir_angle;
+   scratch->pad_value = lfsparms->pad_value;
+   scratch->maxpad = maxpad;
+
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_session_new - Allocates an empty detection session context.
+#cat:            A session carries the final Direction Map of one
+#cat:            detection across to the next one, where it seeds the
+#cat:            initial map as a starting hypothesis (see
+#cat:            gen_image_maps).  Use one session per enroll sequence
+#cat:            of a single finger.
+
+   Return Code:
+      Pointer to the new session context
+**************************************************************************/
+LFS_SESSION *lfs_session_new(void)
+{
+   LFS_SESSION *session;
+
+   session = (LFS_SESSION *)g_malloc(sizeof(LFS_SESSION));
+   memset(session, 0, sizeof(LFS_SESSION));
+
+   return(session);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_session_free - Deallocates a detection session context and the
+#cat:            prior Direction Map it carries.
+
+   Input:
+      session - session context to be deallocated
+**************************************************************************/
+void lfs_session_free(LFS_SESSION *session)
+{
+   if(session == (LFS_SESSION *)NULL)
+      return;
+
+   g_free(session->prior_direction_map);
+   g_free(session);
+}
+
+/* Per-thread cooperative cancellation hook.  Detection runs on pool
+   threads; each thread's caller installs its own check before invoking
+   detection, so no locking is needed. */
+static __thread int (*lfs_cancel_check)(void *);
+static __thread void *lfs_cancel_arg;
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_set_cancel_check - Installs a cancellation check consulted by
+#cat:            lfs_detect_minutiae_V2 at the boundaries between its
+#cat:            processing stages on the calling thread.  When the check
+#cat:            returns nonzero, detection stops at the next boundary
+#cat:            and reports LFS_CANCELLED.  Pass a NULL check to remove
+#cat:            an installed one.
+
+   Input:
+      check - function returning nonzero once the caller wants the
+              detection abandoned, or NULL
+      arg   - opaque pointer handed through to the check
+**************************************************************************/
+void lfs_set_cancel_check(int (*check)(void *), void *arg)
+{
+   lfs_cancel_check = check;
+   lfs_cancel_arg = arg;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_cancelled - Evaluates the calling thread's cancellation check,
+#cat:            if one is installed.
+
+   Return Code:
+      Nonzero - the current detection should be abandoned
+      Zero    - no check installed, or detection should continue
+**************************************************************************/
+static int lfs_cancelled(void)
+{
+   if(lfs_cancel_check == (int (*)(void *))NULL)
+      return(0);
+
+   return(lfs_cancel_check(lfs_cancel_arg));
+}
+
+static int lfs_detect_minutiae_V2_tail(MINUTIAE **ominutiae,
+                int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                int *omw, int *omh,
+                unsigned char **obdata, int *obw, int *obh,
+                unsigned char *pdata, const int pw, const int ph,
+                const int iw, const int ih,
+                int *direction_map, int *low_contrast_map,
+                int *low_flow_map, int *high_curve_map,
+                const int mw, const int mh,
+                const ROTGRIDS *dirbingrids, const LFSPARMS *lfsparms);
+static int lfs_detect_minutiae_V2_post(MINUTIAE **ominutiae,
+                int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                int *omw, int *omh,
+                unsigned char **obdata, int *obw, int *obh,
+                unsigned char *bdata, const int bw, const int bh,
+                const int iw, const int ih,
+                int *direction_map, int *low_contrast_map,
+                int *low_flow_map, int *high_curve_map,
+                const int mw, const int mh, const LFSPARMS *lfsparms);
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_progressive_start - Allocates a progressive detection context
+#cat:            for a swipe image of the given width and maximum height.
+#cat:            Rows are then fed with lfs_progressive_feed() as the
+#cat:            assembler finalizes them, and the detection is completed
+#cat:            with lfs_progressive_finish().  Unlike the whole-image
+#cat:            entry point the context owns its lookup tables, so the
+#cat:            feed and finish calls may come from different threads
+#cat:            (one at a time).
+
+   Input:
+      iw        - width (in pixels) of the swipe image
+      max_ih    - maximum height (in pixels) the image may reach
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      oprog     - the allocated progressive context
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int lfs_progressive_start(LFS_PROGRESSIVE **oprog, const int iw,
+                const int max_ih, const LFSPARMS *lfsparms)
+{
+   LFS_PROGRESSIVE *prog;
+   int maxpad;
+   int ret; /* return code */
+
+   if((iw < lfsparms->blocksize) || (max_ih < lfsparms->blocksize)){
+      fprintf(stderr,
+         "ERROR : lfs_progressive_start : image must be at least %d wide and high\n",
+              lfsparms->blocksize);
+      return(-600);
+   }
+
+   prog = (LFS_PROGRESSIVE *)g_malloc(sizeof(LFS_PROGRESSIVE));
+   memset(prog, 0, sizeof(LFS_PROGRESSIVE));
+   prog->lfsparms = lfsparms;
+
+   maxpad = get_max_padding_V2(lfsparms->windowsize, lfsparms->windowoffset,
+                          lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
+
+   if((ret = init_dir2rad(&prog->dir2rad, lfsparms->num_directions))){
+      lfs_progressive_free(prog);
+      return(ret);
+   }
+
+   if((ret = init_dftwaves(&prog->dftwaves, g_dft_coefs,
+                        lfsparms->num_dft_waves, lfsparms->windowsize))){
+      lfs_progressive_free(prog);
+      return(ret);
+   }
+
+   if((ret = init_rotgrids(&prog->dftgrids, iw, max_ih, maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->windowsize, lfsparms->windowsize,
+                        RELATIVE2ORIGIN))){
+      lfs_progressive_free(prog);
+      return(ret);
+   }
+
+   if((ret = init_rotgrids(&prog->dirbingrids, iw, max_ih, maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
+                        RELATIVE2CENTER))){
+      lfs_progressive_free(prog);
+      return(ret);
+   }
+
+   prog->iw = iw;
+   prog->max_ih = max_ih;
+   prog->pad = maxpad;
+   prog->pw = iw + (maxpad<<1);
+   prog->mw = (int)ceil(iw / (double)lfsparms->blocksize);
+
+   /* As with the whole-image path, the pad border keeps the scaled pad */
+   /* value it is filled with here; feeding rows only ever writes the   */
+   /* interior.                                                         */
+   prog->pdata = (unsigned char *)g_malloc(prog->pw * (max_ih + (maxpad<<1)));
+   memset(prog->pdata, lfsparms->pad_value >> 2,
+          prog->pw * (max_ih + (maxpad<<1)));
+
+   *oprog = prog;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_progressive_grow - Extends the progressive context's initial
+#cat:            maps and block offset list to cover the given number of
+#cat:            block rows.  New Direction Map entries start INVALID,
+#cat:            new contrast/flow entries start FALSE; offsets are
+#cat:            filled in by the caller, which knows the row anchors.
+**************************************************************************/
+static void lfs_progressive_grow(LFS_PROGRESSIVE *prog, const int bh)
+{
+   int oldsize, newsize;
+
+   if(bh <= prog->map_alloc)
+      return;
+
+   oldsize = prog->mw * prog->map_alloc;
+   newsize = prog->mw * bh;
+
+   prog->direction_map = (int *)g_realloc(prog->direction_map,
+                                          newsize * sizeof(int));
+   memset(prog->direction_map + oldsize, INVALID_DIR,
+          (newsize - oldsize) * sizeof(int));
+   prog->low_contrast_map = (int *)g_realloc(prog->low_contrast_map,
+                                             newsize * sizeof(int));
+   memset(prog->low_contrast_map + oldsize, 0,
+          (newsize - oldsize) * sizeof(int));
+   prog->low_flow_map = (int *)g_realloc(prog->low_flow_map,
+                                         newsize * sizeof(int));
+   memset(prog->low_flow_map + oldsize, 0,
+          (newsize - oldsize) * sizeof(int));
+   prog->blkoffs = (int *)g_realloc(prog->blkoffs, newsize * sizeof(int));
+
+   prog->map_alloc = bh;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_progressive_anchor - Fills the block offsets of one block row.
+#cat:            Anchoring matches block_offsets(): interior rows start
+#cat:            at their natural origin, the last row and column are
+#cat:            pulled in so their blocks end at the image edge.
+**************************************************************************/
+static void lfs_progressive_anchor(LFS_PROGRESSIVE *prog, const int by,
+                const int row_anchor)
+{
+   int bx, offset;
+
+   offset = ((prog->pad + row_anchor) * prog->pw) + prog->pad;
+   for(bx = 0; bx < prog->mw - 1; bx++){
+      prog->blkoffs[(by * prog->mw) + bx] = offset;
+      offset += prog->lfsparms->blocksize;
+   }
+   prog->blkoffs[(by * prog->mw) + prog->mw - 1] =
+      ((prog->pad + row_anchor) * prog->pw) + prog->pad +
+      prog->iw - prog->lfsparms->blocksize;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_progressive_feed - Appends finalized image rows to the
+#cat:            progressive context, scaling them into the padded 6-bit
+#cat:            working image, and computes the initial map entries of
+#cat:            every block row whose DFT windows are now complete.
+
+   Input:
+      prog      - progressive detection context
+      rows      - nrows * iw pixels of finalized 8-bit grayscale rows
+      nrows     - number of rows in the band
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int lfs_progressive_feed(LFS_PROGRESSIVE *prog, unsigned char *rows,
+                const int nrows)
+{
+   const LFSPARMS *lfsparms = prog->lfsparms;
+   unsigned char *sptr, *dptr;
+   int k, x, by, need, wneed, ph;
+   int ret; /* return code */
+
+   if(prog->ih + nrows > prog->max_ih){
+      fprintf(stderr, "ERROR : lfs_progressive_feed : "
+              "rows exceed the declared maximum height\n");
+      return(-601);
+   }
+
+   /* Scale the band into the padded working image. */
+   for(k = 0; k < nrows; k++){
+      sptr = rows + (k * prog->iw);
+      dptr = prog->pdata + ((prog->pad + prog->ih + k) * prog->pw) +
+             prog->pad;
+      for(x = 0; x < prog->iw; x++)
+         *dptr++ = *sptr++ >> 2;
+   }
+   prog->ih += nrows;
+
+   /* Compute every block row whose rows and DFT windows are final.    */
+   /* The conservative padded height never lets the window clamps bind */
+   /* for these interior rows, so the results match a whole-image run. */
+   ph = prog->pad + prog->ih + prog->pad;
+   for(;;){
+      by = prog->bh_done;
+      need = (by + 1) * lfsparms->blocksize;
+      wneed = (by * lfsparms->blocksize) +
+              lfsparms->windowsize - lfsparms->windowoffset + 1;
+      if(wneed > need)
+         need = wneed;
+      if(prog->ih < need)
+         break;
+
+      lfs_progressive_grow(prog, by + 1);
+      lfs_progressive_anchor(prog, by, by * lfsparms->blocksize);
+
+      if((ret = gen_initial_maps_band(prog->direction_map,
+                     prog->low_contrast_map, prog->low_flow_map,
+                     prog->blkoffs, prog->mw, by, by,
+                     prog->pdata, prog->pw, ph,
+                     prog->dftwaves, prog->dftgrids, lfsparms)))
+         return(ret);
+
+      prog->bh_done++;
+   }
+
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_progressive_finish - Completes a progressive detection: anchors
+#cat:            and computes the remaining bottom block rows, finishes
+#cat:            map generation and runs binarization, minutiae detection,
+#cat:            false minutia removal and ridge counting on the
+#cat:            accumulated image.  The context stays owned by the
+#cat:            caller and must outlive the returned binary image no
+#cat:            longer than lfs_progressive_free() allows.
+
+   Input:
+      prog      - progressive detection context with all rows fed
+      session   - optional detection session context, or NULL
+   Output:
+      (as lfs_detect_minutiae_V2)
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int lfs_progressive_finish(LFS_PROGRESSIVE *prog, MINUTIAE **ominutiae,
+                int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                int *omw, int *omh,
+                unsigned char **obdata, int *obw, int *obh,
+                LFS_SESSION *session)
+{
+   const LFSPARMS *lfsparms = prog->lfsparms;
+   int *direction_map, *low_contrast_map, *low_flow_map, *high_curve_map;
+   int bh, by, ph;
+   int ret; /* return code */
+
+   if(prog->ih < lfsparms->blocksize){
+      fprintf(stderr, "ERROR : lfs_progressive_finish : "
+              "image must be at least %d rows high\n", lfsparms->blocksize);
+      return(-602);
+   }
+
+   bh = (int)ceil(prog->ih / (double)lfsparms->blocksize);
+   ph = prog->pad + prog->ih + prog->pad;
+
+   /* Compute the block rows the feed calls could not: the bottom rows */
+   /* whose windows were still growing, with the last row pulled in to */
+   /* end at the image edge.                                           */
+   if(prog->bh_done < bh){
+      lfs_progressive_grow(prog, bh);
+      for(by = prog->bh_done; by < bh; by++)
+         lfs_progressive_anchor(prog, by,
+                    by < bh - 1 ? by * lfsparms->blocksize
+                                : prog->ih - lfsparms->blocksize);
+
+      if((ret = gen_initial_maps_band(prog->direction_map,
+                     prog->low_contrast_map, prog->low_flow_map,
+                     prog->blkoffs, prog->mw, prog->bh_done, bh - 1,
+                     prog->pdata, prog->pw, ph,
+                     prog->dftwaves, prog->dftgrids, lfsparms)))
+         return(ret);
+
+      prog->bh_done = bh;
+   }
+
+   /* The remaining passes consume the initial maps; drop our pointers */
+   /* so the context does not free them as well.                       */
+   direction_map = prog->direction_map;
+   low_contrast_map = prog->low_contrast_map;
+   low_flow_map = prog->low_flow_map;
+   prog->direction_map = (int *)NULL;
+   prog->low_contrast_map = (int *)NULL;
+   prog->low_flow_map = (int *)NULL;
+
+   if((ret = gen_image_maps_finish(&direction_map, &low_contrast_map,
+                  &low_flow_map, &high_curve_map, omw, omh,
+                  direction_map, low_contrast_map, low_flow_map,
+                  prog->mw, bh, prog->dir2rad, lfsparms, session)))
+      return(ret);
+
+   return(lfs_detect_minutiae_V2_tail(ominutiae, odmap, olcmap, olfmap,
+                  ohcmap, omw, omh, obdata, obw, obh,
+                  prog->pdata, prog->pw, ph, prog->iw, prog->ih,
+                  direction_map, low_contrast_map, low_flow_map,
+                  high_curve_map, prog->mw, bh,
+                  prog->dirbingrids, lfsparms));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_progressive_free - Deallocates a progressive detection context
+#cat:            and everything it still owns.
+
+   Input:
+      prog - progressive context to be deallocated
+**************************************************************************/
+void lfs_progressive_free(LFS_PROGRESSIVE *prog)
+{
+   if(prog == (LFS_PROGRESSIVE *)NULL)
+      return;
+
+   if(prog->dir2rad != (DIR2RAD *)NULL)
+      free_dir2rad(prog->dir2rad);
+   if(prog->dftwaves != (DFTWAVES *)NULL)
+      free_dftwaves(prog->dftwaves);
+   if(prog->dftgrids != (ROTGRIDS *)NULL)
+      free_rotgrids(prog->dftgrids);
+   if(prog->dirbingrids != (ROTGRIDS *)NULL)
+      free_rotgrids(prog->dirbingrids);
+   g_free(prog->pdata);
+   g_free(prog->direction_map);
+   g_free(prog->low_contrast_map);
+   g_free(prog->low_flow_map);
+   g_free(prog->blkoffs);
+   g_free(prog);
+}
+
 /*************************************************************************
 #cat: lfs_detect_minutiae - Takes a grayscale fingerprint image (of arbitrary
 #cat:          size), and returns a map of directional ridge flow in the image
@@ -137,10 +711,10 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
                         int *omw, int *omh,
                         unsigned char **obdata, int *obw, int *obh,
                         unsigned char *idata, const int iw, const int ih,
-                        const LFSPARMS *lfsparms)
+                        const LFSPARMS *lfsparms, LFS_SESSION *session)
 {
-   unsigned char *pdata, *bdata;
-   int pw, ph, bw, bh;
+   unsigned char *pdata;
+   int pw, ph;
    DIR2RAD *dir2rad;
    DFTWAVES *dftwaves;
    ROTGRIDS *dftgrids;
@@ -148,7 +722,6 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    int *direction_map, *low_contrast_map, *low_flow_map, *high_curve_map;
    int mw, mh;
    int ret, maxpad;
-   MINUTIAE *minutiae;
 
    set_timer(total_timer);
 
@@ -161,88 +734,271 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       /* If system error, exit with error code. */
       return(ret);
 
-   /* Determine the maximum amount of image padding required to support */
-   /* LFS processes.                                                    */
-   maxpad = get_max_padding_V2(lfsparms->windowsize, lfsparms->windowoffset,
-                          lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
+   /* Prepare this thread's cached working memories (lookup tables and */
+   /* the padded image buffer), reusing them if the geometry matches.  */
+   if((ret = lfs_scratch_prepare(&lfs_scratch, iw, ih, lfsparms))){
+      return(ret);
+   }
 
-   /* Initialize lookup table for converting integer directions */
-   /* to angles in radians.                                     */
-   if((ret = init_dir2rad(&dir2rad, lfsparms->num_directions))){
-      /* Free memory allocated to this point. */
+   maxpad = lfs_scratch.maxpad;
+   dir2rad = lfs_scratch.dir2rad;
+   dftwaves = lfs_scratch.dftwaves;
+   dftgrids = lfs_scratch.dftgrids;
+   dirbingrids = lfs_scratch.dirbingrids;
+   pdata = lfs_scratch.pdata;
+   pw = lfs_scratch.pw;
+   ph = lfs_scratch.ph;
+
+   /* Refill the interior of the reused padded buffer, scaling the     */
+   /* input to 6 bits [0..63] as it is copied.  The pad border was     */
+   /* filled with the scaled pad value when the buffer was built (see  */
+   /* lfs_scratch_prepare) and is never written by the copy, so the    */
+   /* former full-buffer memset and separate bits_8to6() pass over     */
+   /* pw x ph pixels are not needed; the one remaining pass is the     */
+   /* 6-bit scaling the DFT computations require anyway.               */
+   /* !!! Would like to remove the 6-bit dependency eventualy !!!      */
+   /* But, the DFT computations will need to be changed, and           */
+   /* could not get this work upon first attempt. Also, if not         */
+   /* careful, I think accumulated power magnitudes may overflow       */
+   /* doubles.                                                         */
+   pad_uchar_image_8to6(pdata, pw, idata, iw, ih, maxpad);
+
+   print2log("\nINITIALIZATION AND PADDING DONE\n");
+
+   /* Release the thread quickly if the caller already gave up. */
+   if(lfs_cancelled())
+      return(LFS_CANCELLED);
+
+   /******************/
+   /*      MAPS      */
+   /******************/
+   set_timer(imap_timer);
+
+   /* Generate block maps from the input image, offering the stage to */
+   /* a registered compute backend first (see offload.c); the CPU     */
+   /* implementation runs whenever there is none or it declines.      */
+   ret = offload_image_maps(&direction_map, &low_contrast_map,
+                    &low_flow_map, &high_curve_map, &mw, &mh,
+                    pdata, pw, ph, dir2rad, dftwaves, dftgrids, lfsparms);
+   if(ret == LFS_OFFLOAD_UNSUPPORTED)
+      ret = gen_image_maps(&direction_map, &low_contrast_map,
+                    &low_flow_map, &high_curve_map, &mw, &mh,
+                    pdata, pw, ph, dir2rad, dftwaves, dftgrids, lfsparms,
+                    session);
+   if(ret){
       return(ret);
    }
 
-   /* Initialize wave form lookup tables for DFT analyses. */
-   /* used for direction binarization.                             */
-   if((ret = init_dftwaves(&dftwaves, g_dft_coefs, lfsparms->num_dft_waves,
-                        lfsparms->windowsize))){
+   print2log("\nMAPS DONE\n");
+
+   time_accum(imap_timer, imap_time);
+
+   if(lfs_cancelled()){
       /* Free memory allocated to this point. */
+      g_free(direction_map);
+      g_free(low_contrast_map);
+      g_free(low_flow_map);
+      g_free(high_curve_map);
+      return(LFS_CANCELLED);
+   }
+
+   /* The remaining stages operate on the completed maps and padded    */
+   /* image only, so they are shared with the progressive entry point. */
+   return(lfs_detect_minutiae_V2_tail(ominutiae, odmap, olcmap, olfmap,
+                   ohcmap, omw, omh, obdata, obw, obh,
+                   pdata, pw, ph, iw, ih,
+                   direction_map, low_contrast_map, low_flow_map,
+                   high_curve_map, mw, mh, dirbingrids, lfsparms));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: low_mem_fill_window - Fills a window of padded 6-bit image rows
+#cat:            [r0..r1) from the unpadded 8-bit input image, scaling
+#cat:            pixels as they are copied and filling the pad border
+#cat:            rows and columns with the scaled pad value.  The rows
+#cat:            produced are identical to the same rows of the full
+#cat:            padded image the whole-image entry point builds.
+**************************************************************************/
+static void low_mem_fill_window(unsigned char *window, const int r0,
+                const int r1, unsigned char *idata, const int iw,
+                const int ih, const int pw, const int pad,
+                const int pad_value)
+{
+   unsigned char *dptr, *sptr;
+   int r, x;
+
+   dptr = window;
+   for(r = r0; r < r1; r++){
+      if((r < pad) || (r >= pad + ih)){
+         memset(dptr, pad_value, pw);
+         dptr += pw;
+         continue;
+      }
+      memset(dptr, pad_value, pad);
+      sptr = idata + ((r - pad) * iw);
+      for(x = 0; x < iw; x++)
+         dptr[pad + x] = sptr[x] >> 2;
+      memset(dptr + pad + iw, pad_value, pw - pad - iw);
+      dptr += pw;
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_detect_minutiae_V2_low_mem - Runs the lfs_detect_minutiae_V2
+#cat:            pipeline with a bounded working set: instead of holding
+#cat:            the whole padded image, map generation and binarization
+#cat:            stream the input through a sliding window of padded rows
+#cat:            that is rebuilt from the caller's image band by band.
+#cat:            Results are identical to a whole-image run with the
+#cat:            coarse-lattice pyramid approximation disabled; the map
+#cat:            DFTs run serially and compute backends are not offered,
+#cat:            so large images trade some time for a peak allocation of
+#cat:            one binary image plus a window of a few hundred rows.
+#cat:            Selected with the low_memory parameter for targets where
+#cat:            the regular path's transient buffers do not fit.
+
+   Input:
+      (as lfs_detect_minutiae_V2)
+   Output:
+      (as lfs_detect_minutiae_V2)
+   Return Code:
+      Zero      - successful completion
+      Negative  - system error
+**************************************************************************/
+int lfs_detect_minutiae_V2_low_mem(MINUTIAE **ominutiae,
+                        int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                        int *omw, int *omh,
+                        unsigned char **obdata, int *obw, int *obh,
+                        unsigned char *idata, const int iw, const int ih,
+                        const LFSPARMS *lfsparms, LFS_SESSION *session)
+{
+   DIR2RAD *dir2rad;
+   DFTWAVES *dftwaves;
+   ROTGRIDS *dftgrids;
+   ROTGRIDS *dirbingrids;
+   unsigned char *window, *vdata, *bdata;
+   int *direction_map, *low_contrast_map, *low_flow_map, *high_curve_map;
+   int *blkoffs;
+   int mw, mh, pw, ph, maxpad, pad_value, context, wrows;
+   int by, iy, nrows, prow, r0, r1, bsize, i;
+   int ret; /* return code */
+
+   set_timer(total_timer);
+
+   /* If LOG_REPORT defined, open log report file. */
+   if((ret = open_logfile()))
+      return(ret);
+
+   maxpad = get_max_padding_V2(lfsparms->windowsize, lfsparms->windowoffset,
+                          lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
+   pw = iw + (maxpad<<1);
+   ph = ih + (maxpad<<1);
+   pad_value = lfsparms->pad_value >> 2;
+
+   /* Build the lookup tables locally; the per-thread scratch set is
+      left alone because its cached full-size padded image is exactly
+      the kind of allocation this mode exists to avoid. */
+   if((ret = init_dir2rad(&dir2rad, lfsparms->num_directions)))
+      return(ret);
+
+   if((ret = init_dftwaves(&dftwaves, g_dft_coefs,
+                        lfsparms->num_dft_waves, lfsparms->windowsize))){
       free_dir2rad(dir2rad);
       return(ret);
    }
 
-   /* Initialize lookup table for pixel offsets to rotated grids */
-   /* used for DFT analyses.                                     */
    if((ret = init_rotgrids(&dftgrids, iw, ih, maxpad,
                         lfsparms->start_dir_angle, lfsparms->num_directions,
                         lfsparms->windowsize, lfsparms->windowsize,
                         RELATIVE2ORIGIN))){
-      /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
       free_dftwaves(dftwaves);
+      free_dir2rad(dir2rad);
       return(ret);
    }
 
-   /* Pad input image based on max padding. */
-   if(maxpad > 0){   /* May not need to pad at all */
-      if((ret = pad_uchar_image(&pdata, &pw, &ph, idata, iw, ih,
-                             maxpad, lfsparms->pad_value))){
-         /* Free memory allocated to this point. */
-         free_dir2rad(dir2rad);
-         free_dftwaves(dftwaves);
-         free_rotgrids(dftgrids);
-         return(ret);
-      }
-   }
-   else{
-      /* If padding is unnecessary, then copy the input image. */
-      pdata = (unsigned char *)g_malloc(iw * ih);
-      memcpy(pdata, idata, iw*ih);
-      pw = iw;
-      ph = ih;
+   /* Compute block offsets into the (never materialized) padded image. */
+   if((ret = block_offsets(&blkoffs, &mw, &mh, iw, ih,
+                        maxpad, lfsparms->blocksize))){
+      free_rotgrids(dftgrids);
+      free_dftwaves(dftwaves);
+      free_dir2rad(dir2rad);
+      return(ret);
    }
 
-   /* Scale input image to 6 bits [0..63] */
-   /* !!! Would like to remove this dependency eventualy !!!     */
-   /* But, the DFT computations will need to be changed, and     */
-   /* could not get this work upon first attempt. Also, if not   */
-   /* careful, I think accumulated power magnitudes may overflow */
-   /* doubles.                                                   */
-   bits_8to6(pdata, pw, ph);
+   bsize = mw * mh;
+   direction_map = (int *)g_malloc(bsize * sizeof(int));
+   memset(direction_map, INVALID_DIR, bsize * sizeof(int));
+   low_contrast_map = (int *)g_malloc(bsize * sizeof(int));
+   memset(low_contrast_map, 0, bsize * sizeof(int));
+   low_flow_map = (int *)g_malloc(bsize * sizeof(int));
+   memset(low_flow_map, 0, bsize * sizeof(int));
 
-   print2log("\nINITIALIZATION AND PADDING DONE\n");
+   /* The window must cover every padded row a block row's DFT windows
+      can touch: the rotated grids stay within maxpad + windowsize + 1
+      rows of the block anchor on either side (the whole-image padding
+      guarantee applied to the top and bottom block rows). */
+   context = maxpad + lfsparms->windowsize + 1;
+   wrows = min(ph, lfsparms->blocksize + (context<<1));
+   window = (unsigned char *)g_malloc(wrows * pw);
+
+   print2log("\nINITIALIZATION DONE\n");
 
    /******************/
    /*      MAPS      */
    /******************/
    set_timer(imap_timer);
 
-   /* Generate block maps from the input image. */
-   if((ret = gen_image_maps(&direction_map, &low_contrast_map,
-                    &low_flow_map, &high_curve_map, &mw, &mh,
-                    pdata, pw, ph, dir2rad, dftwaves, dftgrids, lfsparms))){
+   /* Generate the initial maps one block row at a time.  The window is
+      addressed through a pointer biased back by its first row, so the
+      block offsets, window clamps and map results stay bit-identical
+      to the whole-image run. */
+   ret = 0;
+   for(by = 0; by < mh; by++){
+      prow = blkoffs[by * mw] / pw;
+      r0 = max(0, prow - context);
+      r1 = min(ph, prow + lfsparms->blocksize + context);
+      low_mem_fill_window(window, r0, r1, idata, iw, ih, pw, maxpad,
+                          pad_value);
+      vdata = window - ((size_t)r0 * pw);
+      if((ret = gen_initial_maps_band(direction_map, low_contrast_map,
+                     low_flow_map, blkoffs, mw, by, by,
+                     vdata, pw, ph, dftwaves, dftgrids, lfsparms)))
+         break;
+   }
+   if(ret == 0 && lfs_cancelled())
+      ret = LFS_CANCELLED;
+   if(ret){
       /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
-      free_dftwaves(dftwaves);
       free_rotgrids(dftgrids);
-      g_free(pdata);
+      free_dftwaves(dftwaves);
+      free_dir2rad(dir2rad);
+      g_free(blkoffs);
+      g_free(direction_map);
+      g_free(low_contrast_map);
+      g_free(low_flow_map);
+      g_free(window);
       return(ret);
    }
-   /* Deallocate working memories. */
-   free_dir2rad(dir2rad);
-   free_dftwaves(dftwaves);
+
+   /* The DFT tables and block offsets are only needed for the initial
+      maps; drop them before the binary image is allocated. */
    free_rotgrids(dftgrids);
+   free_dftwaves(dftwaves);
+   g_free(blkoffs);
+
+   /* Complete map generation; the maps are in block resolution and do
+      not contribute meaningfully to the peak. */
+   if((ret = gen_image_maps_finish(&direction_map, &low_contrast_map,
+                  &low_flow_map, &high_curve_map, omw, omh,
+                  direction_map, low_contrast_map, low_flow_map,
+                  mw, mh, dir2rad, lfsparms, session))){
+      free_dir2rad(dir2rad);
+      g_free(window);
+      return(ret);
+   }
+   free_dir2rad(dir2rad);
 
    print2log("\nMAPS DONE\n");
 
@@ -253,43 +1009,122 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /******************/
    set_timer(bin_timer);
 
-   /* Initialize lookup table for pixel offsets to rotated grids */
-   /* used for directional binarization.                         */
    if((ret = init_rotgrids(&dirbingrids, iw, ih, maxpad,
                         lfsparms->start_dir_angle, lfsparms->num_directions,
                         lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
                         RELATIVE2CENTER))){
       /* Free memory allocated to this point. */
-      g_free(pdata);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
       g_free(high_curve_map);
+      g_free(window);
       return(ret);
    }
 
-   /* Binarize input image based on NMAP information. */
-   if((ret = binarize_V2(&bdata, &bw, &bh,
+   bdata = (unsigned char *)g_malloc(iw * ih);
+
+   /* Binarize in bands sized to the same window.  A binary row reads
+      the padded rows from its own down to two grid pads below it, so
+      bands of (wrows - 2 * maxpad) rows fit the window exactly. */
+   nrows = wrows - (maxpad<<1);
+   for(iy = 0; iy < ih; iy += nrows){
+      r0 = iy;
+      r1 = min(ph, iy + nrows + (maxpad<<1));
+      low_mem_fill_window(window, r0, r1, idata, iw, ih, pw, maxpad,
+                          pad_value);
+      vdata = window - ((size_t)r0 * pw);
+      binarize_image_V2_band(bdata, iy, min(ih, iy + nrows),
+                     vdata, pw, ph, direction_map, mw, mh,
+                     lfsparms->blocksize, dirbingrids);
+   }
+   free_rotgrids(dirbingrids);
+   g_free(window);
+
+   /* Fill black and white holes in binary image, as binarize_V2(). */
+   for(i = 0; i < lfsparms->num_fill_holes; i++)
+      fill_holes(bdata, iw, ih);
+
+   print2log("\nBINARIZATION DONE\n");
+
+   time_accum(bin_timer, bin_time);
+
+   if(lfs_cancelled()){
+      /* Free memory allocated to this point. */
+      g_free(direction_map);
+      g_free(low_contrast_map);
+      g_free(low_flow_map);
+      g_free(high_curve_map);
+      g_free(bdata);
+      return(LFS_CANCELLED);
+   }
+
+   return(lfs_detect_minutiae_V2_post(ominutiae, odmap, olcmap, olfmap,
+                   ohcmap, omw, omh, obdata, obw, obh,
+                   bdata, iw, ih, iw, ih,
+                   direction_map, low_contrast_map, low_flow_map,
+                   high_curve_map, mw, mh, lfsparms));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_detect_minutiae_V2_tail - Runs the stages of minutiae detection
+#cat:            that follow map generation (binarization, detection,
+#cat:            false minutia removal and ridge counting) from a padded
+#cat:            6-bit image and a completed set of image maps.  Shared
+#cat:            between lfs_detect_minutiae_V2 and the progressive
+#cat:            entry points; takes ownership of the four maps.
+**************************************************************************/
+static int lfs_detect_minutiae_V2_tail(MINUTIAE **ominutiae,
+                int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                int *omw, int *omh,
+                unsigned char **obdata, int *obw, int *obh,
+                unsigned char *pdata, const int pw, const int ph,
+                const int iw, const int ih,
+                int *direction_map, int *low_contrast_map,
+                int *low_flow_map, int *high_curve_map,
+                const int mw, const int mh,
+                const ROTGRIDS *dirbingrids, const LFSPARMS *lfsparms)
+{
+   unsigned char *bdata;
+   int bw, bh;
+   int ret; /* return code */
+
+   /******************/
+   /* BINARIZARION   */
+   /******************/
+   set_timer(bin_timer);
+
+   /* Binarize input image based on NMAP information.  The adaptive     */
+   /* threshold path replaces the directional filter entirely and runs  */
+   /* on the CPU; otherwise the stage is offered to the compute backend */
+   /* first.                                                            */
+   if(lfsparms->adaptive_binarize)
+      ret = binarize_adaptive(&bdata, &bw, &bh,
                       pdata, pw, ph, direction_map, mw, mh,
-                      dirbingrids, lfsparms))){
+                      dirbingrids->pad, lfsparms);
+   else{
+      ret = offload_binarize(&bdata, &bw, &bh,
+                      pdata, pw, ph, direction_map, mw, mh,
+                      dirbingrids, lfsparms);
+      if(ret == LFS_OFFLOAD_UNSUPPORTED)
+         ret = binarize_V2(&bdata, &bw, &bh,
+                      pdata, pw, ph, direction_map, mw, mh,
+                      dirbingrids, lfsparms);
+   }
+   if(ret){
       /* Free memory allocated to this point. */
-      g_free(pdata);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
       g_free(high_curve_map);
-      free_rotgrids(dirbingrids);
       return(ret);
    }
 
-   /* Deallocate working memory. */
-   free_rotgrids(dirbingrids);
-
    /* Check dimension of binary image.  If they are different from */
    /* the input image, then ERROR.                                 */
    if((iw != bw) || (ih != bh)){
       /* Free memory allocated to this point. */
-      g_free(pdata);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
@@ -305,14 +1140,53 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
 
    time_accum(bin_timer, bin_time);
 
+   if(lfs_cancelled()){
+      /* Free memory allocated to this point. */
+      g_free(direction_map);
+      g_free(low_contrast_map);
+      g_free(low_flow_map);
+      g_free(high_curve_map);
+      g_free(bdata);
+      return(LFS_CANCELLED);
+   }
+
+   return(lfs_detect_minutiae_V2_post(ominutiae, odmap, olcmap, olfmap,
+                   ohcmap, omw, omh, obdata, obw, obh,
+                   bdata, bw, bh, iw, ih,
+                   direction_map, low_contrast_map, low_flow_map,
+                   high_curve_map, mw, mh, lfsparms));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_detect_minutiae_V2_post - Runs the stages of minutiae detection
+#cat:            that follow binarization (detection, false minutia
+#cat:            removal and ridge counting) and fills the output
+#cat:            pointers.  Shared by the whole-image, progressive and
+#cat:            low-memory entry points; takes ownership of the binary
+#cat:            image and the four maps.
+**************************************************************************/
+static int lfs_detect_minutiae_V2_post(MINUTIAE **ominutiae,
+                int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                int *omw, int *omh,
+                unsigned char **obdata, int *obw, int *obh,
+                unsigned char *bdata, const int bw, const int bh,
+                const int iw, const int ih,
+                int *direction_map, int *low_contrast_map,
+                int *low_flow_map, int *high_curve_map,
+                const int mw, const int mh, const LFSPARMS *lfsparms)
+{
+   MINUTIAE *minutiae;
+   int ret; /* return code */
+
    /******************/
    /*   DETECTION    */
    /******************/
    set_timer(minutia_timer);
 
-   /* Convert 8-bit grayscale binary image [0,255] to */
-   /* 8-bit binary image [0,1].                       */
-   gray2bin(1, 1, 0, bdata, iw, ih);
+   /* Binarization emits the 8-bit binary image [0,1] that detection */
+   /* consumes directly, so the former full-image gray2bin() rescan  */
+   /* of the fresh binary image is not needed here.                  */
 
    /* Allocate initial list of minutia pointers. */
    if((ret = alloc_minutiae(&minutiae, MAX_MINUTIAE))){
@@ -324,7 +1198,6 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
                              direction_map, low_flow_map, high_curve_map,
                              mw, mh, lfsparms))){
       /* Free memory allocated to this point. */
-      g_free(pdata);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
@@ -335,13 +1208,23 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
 
    time_accum(minutia_timer, minutia_time);
 
+   if(lfs_cancelled()){
+      /* Free memory allocated to this point. */
+      g_free(direction_map);
+      g_free(low_contrast_map);
+      g_free(low_flow_map);
+      g_free(high_curve_map);
+      g_free(bdata);
+      free_minutiae(minutiae);
+      return(LFS_CANCELLED);
+   }
+
    set_timer(rm_minutia_timer);
 
    if((ret = remove_false_minutia_V2(minutiae, bdata, iw, ih,
                        direction_map, low_flow_map, high_curve_map, mw, mh,
                        lfsparms))){
       /* Free memory allocated to this point. */
-      g_free(pdata);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
@@ -355,6 +1238,17 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
 
    time_accum(rm_minutia_timer, rm_minutia_time);
 
+   if(lfs_cancelled()){
+      /* Free memory allocated to this point. */
+      g_free(direction_map);
+      g_free(low_contrast_map);
+      g_free(low_flow_map);
+      g_free(high_curve_map);
+      g_free(bdata);
+      free_minutiae(minutiae);
+      return(LFS_CANCELLED);
+   }
+
    /******************/
    /*  RIDGE COUNTS  */
    /******************/
@@ -362,7 +1256,6 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
 
    if((ret = count_minutiae_ridges(minutiae, bdata, iw, ih, lfsparms))){
       /* Free memory allocated to this point. */
-      g_free(pdata);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
@@ -384,9 +1277,6 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /* grayscale binary image [0,255].           */
    gray2bin(1, 255, 0, bdata, iw, ih);
 
-   /* Deallocate working memory. */
-   g_free(pdata);
-
    /* Assign results to output pointers. */
    *odmap = direction_map;
    *olcmap = low_contrast_map;
@@ -427,4 +1317,3 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
 
    return(0);
 }
-
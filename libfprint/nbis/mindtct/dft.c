@@ -59,6 +59,7 @@ of the software.
                         dft_dir_powers()
                         sum_rot_block_rows()
                         dft_power()
+                        dft_power_dense()
                         dft_power_stats()
                         get_max_norm()
                         sort_dft_waves()
@@ -105,6 +106,7 @@ int dft_dir_powers(double **powers, unsigned char *pdata,
 {
    int w, dir;
    int *rowsums;
+   double *drowsums;
    unsigned char *blkptr;
 
    /* Allocate line sum vector, and initialize to zeros */
@@ -115,6 +117,7 @@ int dft_dir_powers(double **powers, unsigned char *pdata,
    }
    rowsums = (int *)g_malloc(dftgrids->grid_w * sizeof(int));
    memset(rowsums, 0, dftgrids->grid_w * sizeof(int));
+   drowsums = (double *)g_malloc(dftgrids->grid_w * sizeof(double));
 
    /* Foreach direction ... */
    for(dir = 0; dir < dftgrids->ngrids; dir++){
@@ -123,15 +126,18 @@ int dft_dir_powers(double **powers, unsigned char *pdata,
       sum_rot_block_rows(rowsums, blkptr,
                          dftgrids->grids[dir], dftgrids->grid_w);
 
-      /* Foreach DFT wave ... */
-      for(w = 0; w < dftwaves->nwaves; w++){
-         dft_power(&(powers[w][dir]), rowsums,
-                   dftwaves->waves[w], dftwaves->wavelen);
-      }
+      /* Widen the row sums once, so the wave products below are pure */
+      /* floating point dot products.                                 */
+      for(w = 0; w < dftgrids->grid_w; w++)
+         drowsums[w] = (double)rowsums[w];
+
+      /* Apply all DFT waves to this direction's row sums. */
+      dft_power_dense(powers, dir, drowsums, dftwaves);
    }
 
    /* Deallocate working memory. */
    g_free(rowsums);
+   g_free(drowsums);
 
    return(0);
 }
@@ -214,6 +220,49 @@ void dft_power(double *power, const int *rowsums,
    *power = (cospart * cospart) + (sinpart * sinpart);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: dft_power_dense - Computes the DFT power of every wave form at one
+#cat:             orientation in a single pass over the dense wave matrix.
+#cat:             The row sums are taken pre-widened to double so each
+#cat:             cos/sin product is a unit-stride floating point dot
+#cat:             product the compiler can vectorize (and fuse into FMAs).
+
+   Input:
+      dir      - the orientation (direction) the row sums were sampled at
+      rowsums  - accumulated rows of pixels from within a rotated grid
+                 overlaying an input image block, widened to double
+      dftwaves - structure containing the DFT wave forms and their dense
+                 matrix form
+   Output:
+      powers   - the computed DFT power of each wave form at the given
+                 orientation stored to powers[wave][dir]
+**************************************************************************/
+void dft_power_dense(double **powers, const int dir, const double *rowsums,
+               const DFTWAVES *dftwaves)
+{
+   int w, i;
+   const double *cosrow, *sinrow;
+   double cospart, sinpart;
+
+   /* Foreach DFT wave ... */
+   for(w = 0; w < dftwaves->nwaves; w++){
+      cosrow = dftwaves->dense + (2 * w * dftwaves->wavelen);
+      sinrow = cosrow + dftwaves->wavelen;
+
+      /* Accumulate cos and sin components of DFT. */
+      cospart = 0.0;
+      sinpart = 0.0;
+      for(i = 0; i < dftwaves->wavelen; i++){
+         cospart += (rowsums[i] * cosrow[i]);
+         sinpart += (rowsums[i] * sinrow[i]);
+      }
+
+      /* Power is the sum of the squared cos and sin components */
+      powers[w][dir] = (cospart * cospart) + (sinpart * sinpart);
+   }
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: dft_power_stats - Derives statistics from a set of DFT power vectors.
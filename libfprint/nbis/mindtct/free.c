@@ -62,6 +62,7 @@ of the software.
 
 #include <stdio.h>
 #include <lfs.h>
+#include <fpi-mem.h>
 
 /*************************************************************************
 **************************************************************************
@@ -72,6 +73,9 @@ of the software.
 *************************************************************************/
 void free_dir2rad(DIR2RAD *dir2rad)
 {
+   fpi_mem_sub(FPI_MEM_SUBSYS_MINDTCT,
+               sizeof(DIR2RAD) + 2*dir2rad->ndirs*sizeof(double));
+
    g_free(dir2rad->cos);
    g_free(dir2rad->sin);
    g_free(dir2rad);
@@ -87,6 +91,11 @@ void free_dir2rad(DIR2RAD *dir2rad)
 **************************************************************************/
 void free_dftwaves(DFTWAVES *dftwaves)
 {
+   fpi_mem_sub(FPI_MEM_SUBSYS_MINDTCT,
+               sizeof(DFTWAVES) + dftwaves->nwaves*sizeof(DFTWAVE *) +
+               dftwaves->nwaves*sizeof(DFTWAVE) +
+               4*dftwaves->nwaves*dftwaves->wavelen*sizeof(double));
+
    int i;
 
    for(i = 0; i < dftwaves->nwaves; i++){
@@ -95,6 +104,7 @@ void free_dftwaves(DFTWAVES *dftwaves)
        g_free(dftwaves->waves[i]);
    }
    g_free(dftwaves->waves);
+   g_free(dftwaves->dense);
    g_free(dftwaves);
 }
 
@@ -108,6 +118,10 @@ void free_dftwaves(DFTWAVES *dftwaves)
 **************************************************************************/
 void free_rotgrids(ROTGRIDS *rotgrids)
 {
+   fpi_mem_sub(FPI_MEM_SUBSYS_MINDTCT,
+               sizeof(ROTGRIDS) + rotgrids->ngrids*sizeof(int *) +
+               rotgrids->ngrids*rotgrids->grid_w*rotgrids->grid_h*sizeof(int));
+
    int i;
 
    for(i = 0; i < rotgrids->ngrids; i++)
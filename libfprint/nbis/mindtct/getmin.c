@@ -78,10 +78,13 @@ of the software.
       id       - pixel depth (in bits) of the grayscale image
       ppmm     - the scan resolution (in pixels/mm) of the grayscale image
       lfsparms - parameters and thresholds for controlling LFS
+      session  - detection session context shared by the enroll stages
+                 of one finger, or NULL (see lfs_session_new)
    Output:
       ominutiae         - points to a structure containing the
                           detected minutiae
-      oquality_map      - resulting integrated image quality map
+      oquality_map      - resulting integrated image quality map; graded
+                          on demand, blocks without minutiae remain -1
       odirection_map    - resulting direction map
       olow_contrast_map - resulting low contrast map
       olow_flow_map     - resulting low ridge flow map
@@ -102,7 +105,8 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
                  int *omap_w, int *omap_h,
                  unsigned char **obdata, int *obw, int *obh, int *obd,
                  unsigned char *idata, const int iw, const int ih,
-                 const int id, const double ppmm, const LFSPARMS *lfsparms)
+                 const int id, const double ppmm, const LFSPARMS *lfsparms,
+                 LFS_SESSION *session)
 {
    int ret;
    MINUTIAE *minutiae;
@@ -119,39 +123,39 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
       return(-2);
    }
 
-   /* Detect minutiae in grayscale fingerpeint image. */
-   if((ret = lfs_detect_minutiae_V2(&minutiae,
+   /* Detect minutiae in grayscale fingerpeint image.  The low memory  */
+   /* variant streams the padded image through a sliding window of     */
+   /* rows instead of materializing it whole (see detect.c).           */
+   if(lfsparms->low_memory)
+      ret = lfs_detect_minutiae_V2_low_mem(&minutiae,
                                    &direction_map, &low_contrast_map,
                                    &low_flow_map, &high_curve_map,
                                    &map_w, &map_h,
                                    &bdata, &bw, &bh,
-                                   idata, iw, ih, lfsparms))){
-      return(ret);
-   }
-
-   /* Build integrated quality map. */
-   if((ret = gen_quality_map(&quality_map,
-                            direction_map, low_contrast_map,
-                            low_flow_map, high_curve_map, map_w, map_h))){
-      free_minutiae(minutiae);
-      g_free(direction_map);
-      g_free(low_contrast_map);
-      g_free(low_flow_map);
-      g_free(high_curve_map);
-      g_free(bdata);
+                                   idata, iw, ih, lfsparms, session);
+   else
+      ret = lfs_detect_minutiae_V2(&minutiae,
+                                   &direction_map, &low_contrast_map,
+                                   &low_flow_map, &high_curve_map,
+                                   &map_w, &map_h,
+                                   &bdata, &bw, &bh,
+                                   idata, iw, ih, lfsparms, session);
+   if(ret){
       return(ret);
    }
 
-   /* Assign reliability from quality map. */
-   if((ret = combined_minutia_quality(minutiae, quality_map, map_w, map_h,
-                                     lfsparms->blocksize,
+   /* Assign reliability from an on-demand quality map, grading only */
+   /* the blocks that contain surviving minutiae.                    */
+   if((ret = combined_minutia_quality_lazy(minutiae, &quality_map,
+                                     direction_map, low_contrast_map,
+                                     low_flow_map, high_curve_map,
+                                     map_w, map_h, lfsparms->blocksize,
                                      idata, iw, ih, id, ppmm))){
       free_minutiae(minutiae);
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
       g_free(high_curve_map);
-      g_free(quality_map);
       g_free(bdata);
       return(ret);
    }
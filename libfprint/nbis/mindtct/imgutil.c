@@ -211,6 +211,44 @@ int pad_uchar_image(unsigned char **optr, int *ow, int *oh,
    return(0);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: pad_uchar_image_8to6 - Copies an 8-bit grayscale image into the
+#cat:              interior of a preallocated padded image buffer, scaling
+#cat:              each pixel to 6 bits [0..64) as it is copied.  The
+#cat:              caller is expected to have filled the buffer's pad
+#cat:              border with the scaled pad value already; the border is
+#cat:              left untouched, so the padding refill and the separate
+#cat:              bits_8to6() pass over the whole padded buffer both
+#cat:              collapse into this single pass over the input image.
+
+   Input:
+      pw        - width (in pixels) of the padded image
+      idata     - input 8-bit grayscale image
+      iw        - width (in pixels) of the input image
+      ih        - height (in pixels) of the input image
+      pad       - size of padding (in pixels) around the input image
+   Output:
+      pdata     - padded image buffer receiving the scaled input
+**************************************************************************/
+void pad_uchar_image_8to6(unsigned char *pdata, const int pw,
+                          unsigned char *idata, const int iw, const int ih,
+                          const int pad)
+{
+   unsigned char *pptr, *iptr;
+   int px, py;
+
+   /* Copy input image into the padded interior one scanline at a */
+   /* time, dividing every pixel value by 4 so [0..256) -> [0..64) */
+   iptr = idata;
+   pptr = pdata + (pad * pw) + pad;
+   for(py = 0; py < ih; py++){
+      for(px = 0; px < iw; px++)
+         *pptr++ = *iptr++ >> 2;
+      pptr += pw - iw;
+   }
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: fill_holes - Takes an input image and analyzes triplets of horizontal
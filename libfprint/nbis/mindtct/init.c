@@ -67,6 +67,7 @@ of the software.
 
 #include <stdio.h>
 #include <lfs.h>
+#include <fpi-mem.h>
 
 /*************************************************************************
 **************************************************************************
@@ -119,6 +120,9 @@ int init_dir2rad(DIR2RAD **optr, const int ndirs)
       dir2rad->sin[i] = sn;
    }
 
+   fpi_mem_add(FPI_MEM_SUBSYS_MINDTCT,
+               sizeof(DIR2RAD) + 2*ndirs*sizeof(double));
+
    *optr = dir2rad;
    return(0);
 }
@@ -147,6 +151,7 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
    int i, j;
    double pi_factor, freq, x;
    double *cptr, *sptr;
+   double *dcptr, *dsptr;
 
    /* Allocate structure */
    dftwaves = (DFTWAVES *)g_malloc(sizeof(DFTWAVES));
@@ -158,6 +163,9 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
 
    /* Allocate list of wave pointers */
    dftwaves->waves = (DFTWAVE **)g_malloc(nwaves * sizeof(DFTWAVE *));
+   /* Allocate the dense wave matrix: cos and sin rows per wave. */
+   dftwaves->dense = (double *)g_malloc(2 * nwaves * blocksize *
+                                        sizeof(double));
    if(dftwaves == (DFTWAVES *)NULL){
       /* Free memory allocated to this point. */
       g_free(dftwaves);
@@ -182,6 +190,8 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
       /* Assign pointer nicknames */
       cptr = dftwaves->waves[i]->cos;
       sptr = dftwaves->waves[i]->sin;
+      dcptr = dftwaves->dense + (2 * i * blocksize);
+      dsptr = dcptr + blocksize;
 
       /* Compute actual frequency */
       freq = pi_factor * dft_coefs[i];
@@ -190,12 +200,20 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
       for (j = 0; j < blocksize; ++j) {
          /* Compute sample points from frequency */
          x = freq * (double)j;
-         /* Store cos and sin components of sample point */
+         /* Store cos and sin components of sample point, both in the */
+         /* per-wave vectors and in the dense matrix.                  */
          *cptr++ = cos(x);
          *sptr++ = sin(x);
+         *dcptr++ = cos(x);
+         *dsptr++ = sin(x);
       }
    }
 
+   fpi_mem_add(FPI_MEM_SUBSYS_MINDTCT,
+               sizeof(DFTWAVES) + nwaves*sizeof(DFTWAVE *) +
+               nwaves*sizeof(DFTWAVE) +
+               4*nwaves*blocksize*sizeof(double));
+
    *optr = dftwaves;
    return(0);
 }
@@ -526,6 +544,10 @@ int init_rotgrids(ROTGRIDS **optr, const int iw, const int ih, const int ipad,
       }/* iy */
    }/* dir */
 
+   fpi_mem_add(FPI_MEM_SUBSYS_MINDTCT,
+               sizeof(ROTGRIDS) + ndirs*sizeof(int *) +
+               ndirs*grid_size*sizeof(int));
+
    *optr = rotgrids;
    return(0);
 }
@@ -62,7 +62,11 @@ of the software.
 #include <log.h>
 
 /* If logging is on, declare global file pointer and supporting */
-/* global variable for logging intermediate results.            */
+/* global variable for logging intermediate results.  Without    */
+/* LOG_REPORT the routines are empty macros (see log.h) and this */
+/* translation unit contributes nothing.                         */
+
+#ifdef LOG_REPORT
 
 /***************************************************************************/
 /***************************************************************************/
@@ -102,3 +106,5 @@ int close_logfile(void)
    return(0);
 }
 
+#endif /* LOG_REPORT */
+
@@ -578,7 +578,7 @@ int process_loop_V2(MINUTIAE *minutiae,
                reliability = HIGH_RELIABILITY;
 
             /* Create new minutia object. */
-            if((ret = create_minutia(&minutia,
+            if((ret = create_minutia(&minutia, minutiae,
                                     contour_x[max_fr], contour_y[max_fr],
                                     contour_ex[max_fr], contour_ey[max_fr],
                                     idir, reliability,
@@ -625,7 +625,7 @@ int process_loop_V2(MINUTIAE *minutiae,
                reliability = HIGH_RELIABILITY;
 
             /* Create new minutia object. */
-            if((ret = create_minutia(&minutia,
+            if((ret = create_minutia(&minutia, minutiae,
                                     contour_x[max_to], contour_y[max_to],
                                     contour_ex[max_to], contour_ey[max_to],
                                     idir, reliability,
@@ -91,6 +91,7 @@ of the software.
 #include <lfs.h>
 #include <morph.h>
 #include <log.h>
+#include <fpi-simd.h>
 
 /*************************************************************************
 **************************************************************************
@@ -112,6 +113,10 @@ of the software.
       dftwaves  - structure containing the DFT wave forms
       dftgrids  - structure containing the rotated pixel grid offsets
       lfsparms  - parameters and thresholds for controlling LFS
+      session   - detection session context carrying the previous enroll
+                  stage's Direction Map, or NULL; used to seed blocks the
+                  DFT analysis leaves INVALID, and updated with this
+                  image's final Direction Map on return
    Output:
       odmap     - points to the created Direction Map
       olcmap    - points to the created Low Contrast Map
@@ -127,9 +132,10 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
               int *omw, int *omh,
               unsigned char *pdata, const int pw, const int ph,
               const DIR2RAD *dir2rad, const DFTWAVES *dftwaves,
-              const ROTGRIDS *dftgrids, const LFSPARMS *lfsparms)
+              const ROTGRIDS *dftgrids, const LFSPARMS *lfsparms,
+              LFS_SESSION *session)
 {
-   int *direction_map, *low_contrast_map, *low_flow_map, *high_curve_map;
+   int *direction_map, *low_contrast_map, *low_flow_map;
    int mw, mh, iw, ih;
    int *blkoffs;
    int ret; /* return code */
@@ -158,6 +164,53 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
       return(ret);
    }
 
+   /* Steps 3 onward only operate on the completed initial maps, so   */
+   /* they are shared with the progressive (banded) entry points.      */
+   g_free(blkoffs);
+   return(gen_image_maps_finish(odmap, olcmap, olfmap, ohcmap, omw, omh,
+                       direction_map, low_contrast_map, low_flow_map,
+                       mw, mh, dir2rad, lfsparms, session));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: gen_image_maps_finish - Completes map generation from computed
+#cat:            initial Direction, Low Contrast and Low Flow Maps:
+#cat:            morphs the flow map, seeds from the session's prior
+#cat:            Direction Map, runs the consistency, smoothing and
+#cat:            interpolation passes and derives the High Curvature
+#cat:            Map.  Takes ownership of the three initial maps.
+
+   Input:
+      direction_map    - initial Direction Map (consumed)
+      low_contrast_map - initial Low Contrast Map (consumed)
+      low_flow_map     - initial Low Ridge Flow Map (consumed)
+      mw        - width (in blocks) of the maps
+      mh        - height (in blocks) of the maps
+      dir2rad   - lookup table for converting integer directions
+      lfsparms  - parameters and thresholds for controlling LFS
+      session   - optional detection session context, or NULL
+   Output:
+      odmap     - resulting Direction Map
+      olcmap    - resulting Low Contrast Map
+      olfmap    - resulting Low Ridge Flow Map
+      ohcmap    - resulting High Curvature Map
+      omw       - width (in blocks) of the maps
+      omh       - height (in blocks) of the maps
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int gen_image_maps_finish(int **odmap, int **olcmap, int **olfmap,
+              int **ohcmap, int *omw, int *omh,
+              int *direction_map, int *low_contrast_map, int *low_flow_map,
+              const int mw, const int mh,
+              const DIR2RAD *dir2rad, const LFSPARMS *lfsparms,
+              LFS_SESSION *session)
+{
+   int *high_curve_map;
+   int ret; /* return code */
+
    if((ret = morph_TF_map(low_flow_map, mw, mh, lfsparms))){
       g_free(direction_map);
       g_free(low_contrast_map);
@@ -165,6 +218,26 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
       return(ret);
    }
 
+   /* 2b. Seed INVALID blocks from the session's prior Direction Map.   */
+   /* Blocks where the DFT analysis of this capture found no direction  */
+   /* but the previous enroll stage of the same finger did are given    */
+   /* the prior direction as a starting hypothesis; the consistency     */
+   /* and smoothing passes below (steps 3-7) vet every seeded value     */
+   /* against this capture's own evidence.  Low contrast blocks are     */
+   /* left INVALID so background is never seeded.                       */
+   if((session != (LFS_SESSION *)NULL) &&
+      (session->prior_direction_map != (int *)NULL) &&
+      (session->prior_mw == mw) && (session->prior_mh == mh)){
+      int bi;
+
+      for(bi = 0; bi < mw*mh; bi++){
+         if((direction_map[bi] == INVALID_DIR) &&
+            (!low_contrast_map[bi]) &&
+            (session->prior_direction_map[bi] != INVALID_DIR))
+            direction_map[bi] = session->prior_direction_map[bi];
+      }
+   }
+
    /* 3. Remove directions that are inconsistent with neighbors */
    remove_incon_dirs(direction_map, mw, mh, dir2rad, lfsparms);
 
@@ -175,7 +248,7 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
 
    /* 5. Interpolate INVALID direction blocks with their valid neighbors. */
    if((ret = interpolate_direction_map(direction_map, low_contrast_map,
-                                       mw, mh, lfsparms))){
+                                       mw, mh, dir2rad, lfsparms))){
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
@@ -204,8 +277,19 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
       return(ret);
    }
 
-   /* Deallocate working memory. */
-   g_free(blkoffs);
+   /* Retain a copy of the final Direction Map in the session, to seed */
+   /* the next stage of the enroll sequence.                           */
+   if(session != (LFS_SESSION *)NULL){
+      if((session->prior_direction_map == (int *)NULL) ||
+         (session->prior_mw != mw) || (session->prior_mh != mh)){
+         g_free(session->prior_direction_map);
+         session->prior_direction_map = (int *)g_malloc(mw*mh * sizeof(int));
+         session->prior_mw = mw;
+         session->prior_mh = mh;
+      }
+      memcpy(session->prior_direction_map, direction_map,
+             mw*mh * sizeof(int));
+   }
 
    *odmap = direction_map;
    *olcmap = low_contrast_map;
@@ -253,6 +337,262 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
       Zero     - successful completion
       Negative - system error
 **************************************************************************/
+typedef struct maps_block_state {
+   /* Shared, read-only inputs */
+   int *direction_map;
+   int *low_contrast_map;
+   int *low_flow_map;
+   int *blkoffs;
+   int mw, mh, bsize;
+   unsigned char *pdata;
+   int pw, ph;
+   const DFTWAVES *dftwaves;
+   const ROTGRIDS *dftgrids;
+   const LFSPARMS *lfsparms;
+   int xminlimit, xmaxlimit, yminlimit, ymaxlimit;
+   /* Pyramid mode: 0 = single full-resolution pass, 1 = coarse pass   */
+   /* over every other block, 2 = refinement pass over the remainder.  */
+   int pyramid_pass;
+   int cw;          /* blocks per row of the coarse lattice */
+   int claim_limit; /* number of claimable indices in the current pass */
+   /* Shared, atomically updated */
+   int next_block;
+   int error;
+} MAPS_BLOCK_STATE;
+
+/*************************************************************************
+**************************************************************************
+#cat: pyramid_nbr_consensus - Determines whether the coarse-lattice blocks
+#cat:            surrounding the given block all agree on a single ridge
+#cat:            direction.  Returns that direction, or INVALID_DIR when
+#cat:            any neighbor is missing, invalid or disagrees, in which
+#cat:            case the block must be refined with a full DFT analysis.
+**************************************************************************/
+static int pyramid_nbr_consensus(MAPS_BLOCK_STATE *state, const int bi)
+{
+   int bx = bi % state->mw;
+   int by = bi / state->mw;
+   int ax, ay, dir, nbr_dir = INVALID_DIR;
+
+   /* Visit the coarse anchors adjacent to the block: same row/column */
+   /* when the coordinate is even, the two flanking ones when odd.    */
+   for(ay = by - (by & 1); ay <= by + (by & 1); ay += 2){
+      for(ax = bx - (bx & 1); ax <= bx + (bx & 1); ax += 2){
+         if(ax < 0 || ax >= state->mw || ay < 0 || ay >= state->mh)
+            return(INVALID_DIR);
+         dir = state->direction_map[(ay * state->mw) + ax];
+         if(dir == INVALID_DIR)
+            return(INVALID_DIR);
+         if(nbr_dir == INVALID_DIR)
+            nbr_dir = dir;
+         else if(dir != nbr_dir)
+            return(INVALID_DIR);
+      }
+   }
+
+   return(nbr_dir);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: gen_initial_maps_block - Computes the Direction Map, Low Contrast
+#cat:            Map and Low Flow Map entries of a single block.  Each
+#cat:            block only reads the shared image and writes its own map
+#cat:            entries, so blocks may be processed concurrently as long
+#cat:            as every caller brings its own DFT scratch memory.
+**************************************************************************/
+static int gen_initial_maps_block(MAPS_BLOCK_STATE *state, const int bi,
+                double **powers, int *wis, double *powmaxs,
+                int *powmax_dirs, double *pownorms, const int nstats)
+{
+   int blkdir;
+   int ret; /* return code */
+   int dft_offset;
+   int win_x, win_y, low_contrast_offset;
+
+   /* Adjust block offset from pointing to block origin to pointing */
+   /* to surrounding window origin.                                 */
+   dft_offset = state->blkoffs[bi] -
+                   (state->lfsparms->windowoffset * state->pw) -
+                   state->lfsparms->windowoffset;
+
+   /* Compute pixel coords of window origin. */
+   win_x = dft_offset % state->pw;
+   win_y = (int)(dft_offset / state->pw);
+
+   /* Make sure the current window does not access padded image pixels */
+   /* for analyzing low contrast.                                      */
+   win_x = max(state->xminlimit, win_x);
+   win_x = min(state->xmaxlimit, win_x);
+   win_y = max(state->yminlimit, win_y);
+   win_y = min(state->ymaxlimit, win_y);
+   low_contrast_offset = (win_y * state->pw) + win_x;
+
+   print2log("   BLOCK %2d (%2d, %2d) ", bi, bi%state->mw, bi/state->mw);
+
+   /* If block is low contrast ... */
+   if((ret = low_contrast_block(low_contrast_offset,
+                               state->lfsparms->windowsize,
+                               state->pdata, state->pw, state->ph,
+                               state->lfsparms))){
+      /* If system error ... */
+      if(ret < 0)
+         return(ret);
+
+      /* Otherwise, block is low contrast ... */
+      print2log("LOW CONTRAST\n");
+      state->low_contrast_map[bi] = TRUE;
+      /* Direction Map's block is already set to INVALID. */
+      return(0);
+   }
+
+   /* Otherwise, sufficient contrast for DFT processing ... */
+   print2log("\n");
+
+   /* In the refinement pass of the pyramid mode, a block surrounded by */
+   /* coarse blocks that agree on a direction inherits that direction   */
+   /* without running the DFT analysis; only blocks whose neighborhood  */
+   /* disagrees (direction changes, cores, deltas) are refined.         */
+   if(state->pyramid_pass == 2 &&
+      (blkdir = pyramid_nbr_consensus(state, bi)) != INVALID_DIR){
+      state->direction_map[bi] = blkdir;
+      return(0);
+   }
+
+   /* Compute DFT powers */
+   if((ret = dft_dir_powers(powers, state->pdata, low_contrast_offset,
+                         state->pw, state->ph,
+                         state->dftwaves, state->dftgrids)))
+      return(ret);
+
+   /* Compute DFT power statistics, skipping first applied DFT  */
+   /* wave.  This is dependent on how the primary and secondary */
+   /* direction tests work below.                               */
+   if((ret = dft_power_stats(wis, powmaxs, powmax_dirs, pownorms, powers,
+                          1, state->dftwaves->nwaves,
+                          state->dftgrids->ngrids)))
+      return(ret);
+
+#ifdef LOG_REPORT /*vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
+   {  int _w;
+      fprintf(logfp, "      Power\n");
+      for(_w = 0; _w < nstats; _w++){
+         /* Add 1 to wis[w] to create index to original g_dft_coefs[] */
+         fprintf(logfp, "         wis[%d] %d %12.3f %2d %9.3f %12.3f\n",
+              _w, wis[_w]+1,
+              powmaxs[wis[_w]], powmax_dirs[wis[_w]], pownorms[wis[_w]],
+              powers[0][powmax_dirs[wis[_w]]]);
+      }
+   }
+#endif /*^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
+
+   /* Conduct primary direction test */
+   blkdir = primary_dir_test(powers, wis, powmaxs, powmax_dirs,
+                            pownorms, nstats, state->lfsparms);
+
+   if(blkdir != INVALID_DIR)
+      state->direction_map[bi] = blkdir;
+   else{
+      /* Conduct secondary (fork) direction test */
+      blkdir = secondary_fork_test(powers, wis, powmaxs, powmax_dirs,
+                            pownorms, nstats, state->lfsparms);
+      if(blkdir != INVALID_DIR)
+         state->direction_map[bi] = blkdir;
+      /* Otherwise current direction in Direction Map remains INVALID */
+      else
+         /* Flag the block as having LOW RIDGE FLOW. */
+         state->low_flow_map[bi] = TRUE;
+   }
+
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: gen_initial_maps_worker - Claims blocks from the shared counter and
+#cat:            processes them with worker-private DFT scratch memory
+#cat:            until the map is exhausted or any worker reports an error.
+**************************************************************************/
+static gpointer gen_initial_maps_worker(gpointer arg)
+{
+   MAPS_BLOCK_STATE *state = arg;
+   int ci, bi, bx, by, nstats;
+   int *wis, *powmax_dirs;
+   double **powers, *powmaxs, *pownorms;
+   int ret; /* return code */
+
+   /* Allocate worker-private DFT directional power vectors */
+   if((ret = alloc_dir_powers(&powers, state->dftwaves->nwaves,
+                           state->dftgrids->ngrids))){
+      g_atomic_int_compare_and_exchange(&state->error, 0, ret);
+      return(NULL);
+   }
+
+   /* Allocate worker-private DFT power statistic arrays */
+   /* Statistics are not needed for the first DFT wave, so the length */
+   /* is number of waves - 1.                                         */
+   nstats = state->dftwaves->nwaves - 1;
+   if((ret = alloc_power_stats(&wis, &powmaxs, &powmax_dirs,
+                            &pownorms, nstats))){
+      free_dir_powers(powers, state->dftwaves->nwaves);
+      g_atomic_int_compare_and_exchange(&state->error, 0, ret);
+      return(NULL);
+   }
+
+   /* Claim and process blocks until done (or an error occurred). */
+   while(g_atomic_int_get(&state->error) == 0 &&
+         (ci = g_atomic_int_add(&state->next_block, 1)) < state->claim_limit){
+      bi = ci;
+      if(state->pyramid_pass == 1){
+         /* Coarse pass: map the claimed index onto every other block. */
+         bx = (ci % state->cw) << 1;
+         by = (ci / state->cw) << 1;
+         bi = (by * state->mw) + bx;
+      }
+      else if(state->pyramid_pass == 2){
+         /* Refinement pass: skip the blocks the coarse pass computed. */
+         bx = bi % state->mw;
+         by = bi / state->mw;
+         if(((bx | by) & 1) == 0)
+            continue;
+      }
+      if((ret = gen_initial_maps_block(state, bi, powers, wis, powmaxs,
+                                    powmax_dirs, pownorms, nstats)))
+         g_atomic_int_compare_and_exchange(&state->error, 0, ret);
+   }
+
+   /* Deallocate worker-private memory */
+   free_dir_powers(powers, state->dftwaves->nwaves);
+   g_free(wis);
+   g_free(powmaxs);
+   g_free(powmax_dirs);
+   g_free(pownorms);
+
+   return(NULL);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: run_maps_workers - Runs one claim-counter pass over the map with
+#cat:            one worker per core; the calling thread doubles as one
+#cat:            of the workers.
+**************************************************************************/
+static void run_maps_workers(MAPS_BLOCK_STATE *state, const int nthreads)
+{
+   GThread **threads;
+   int ti;
+
+   threads = (GThread **)g_malloc((nthreads-1) * sizeof(GThread *));
+   for(ti = 0; ti < nthreads-1; ti++)
+      threads[ti] = g_thread_new("maps-dft", gen_initial_maps_worker, state);
+
+   gen_initial_maps_worker(state);
+
+   for(ti = 0; ti < nthreads-1; ti++)
+      g_thread_join(threads[ti]);
+   g_free(threads);
+}
+
 int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
                 int *blkoffs, const int mw, const int mh,
                 unsigned char *pdata, const int pw, const int ph,
@@ -260,14 +600,8 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
                 const LFSPARMS *lfsparms)
 {
    int *direction_map, *low_contrast_map, *low_flow_map;
-   int bi, bsize, blkdir;
-   int *wis, *powmax_dirs;
-   double **powers, *powmaxs, *pownorms;
-   int nstats;
-   int ret; /* return code */
-   int dft_offset;
-   int xminlimit, xmaxlimit, yminlimit, ymaxlimit;
-   int win_x, win_y, low_contrast_offset;
+   int bsize, nthreads;
+   MAPS_BLOCK_STATE state;
 
    print2log("INITIAL MAP\n");
 
@@ -290,159 +624,316 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
    /* Initialize the Low Flow Map to FALSE (0). */
    memset(low_flow_map, 0, bsize * sizeof(int));
 
-   /* Allocate DFT directional power vectors */
-   if((ret = alloc_dir_powers(&powers, dftwaves->nwaves, dftgrids->ngrids))){
-      /* Free memory allocated to this point. */
+   state.direction_map = direction_map;
+   state.low_contrast_map = low_contrast_map;
+   state.low_flow_map = low_flow_map;
+   state.blkoffs = blkoffs;
+   state.mw = mw;
+   state.mh = mh;
+   state.bsize = bsize;
+   state.pdata = pdata;
+   state.pw = pw;
+   state.ph = ph;
+   state.dftwaves = dftwaves;
+   state.dftgrids = dftgrids;
+   state.lfsparms = lfsparms;
+   /* Compute special window origin limits for determining low contrast.  */
+   /* These pixel limits avoid analyzing the padded borders of the image. */
+   state.xminlimit = dftgrids->pad;
+   state.yminlimit = dftgrids->pad;
+   state.xmaxlimit = pw - dftgrids->pad - lfsparms->windowsize - 1;
+   state.ymaxlimit = ph - dftgrids->pad - lfsparms->windowsize - 1;
+   state.next_block = 0;
+   state.error = 0;
+
+   /* Optionally resolve the map as a two-level pyramid: compute the  */
+   /* DFT directions on a 2x-coarser lattice first, then refine only  */
+   /* the blocks whose coarse neighbors disagree, letting blocks in   */
+   /* locally uniform ridge flow inherit the consensus direction      */
+   /* without a DFT.  The approximation is disabled under emulation   */
+   /* so recorded image tests keep their bit-exact pipeline output.   */
+   state.pyramid_pass = 0;
+   state.cw = (mw + 1) / 2;
+   state.claim_limit = bsize;
+   if(mw >= 4 && mh >= 4 && g_getenv("FP_DEVICE_EMULATION") == NULL)
+      state.pyramid_pass = 1;
+
+   /* Shard the blocks across the available cores; the calling thread */
+   /* doubles as one of the workers.                                  */
+   nthreads = min((int)g_get_num_processors(), bsize);
+   nthreads = max(nthreads, 1);
+
+   if(state.pyramid_pass){
+      state.claim_limit = state.cw * ((mh + 1) / 2);
+      run_maps_workers(&state, min(nthreads, state.claim_limit));
+
+      if(state.error == 0){
+         state.pyramid_pass = 2;
+         state.next_block = 0;
+         state.claim_limit = bsize;
+         run_maps_workers(&state, nthreads);
+      }
+   }
+   else{
+      run_maps_workers(&state, nthreads);
+   }
+
+   if(state.error){
       g_free(direction_map);
       g_free(low_contrast_map);
       g_free(low_flow_map);
-      return(ret);
+      return(state.error);
    }
 
-   /* Allocate DFT power statistic arrays */
-   /* Compute length of statistics arrays.  Statistics not needed   */
-   /* for the first DFT wave, so the length is number of waves - 1. */
+   *odmap = direction_map;
+   *olcmap = low_contrast_map;
+   *olfmap = low_flow_map;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: gen_initial_maps_band - Computes the initial Direction Map, Low
+#cat:            Contrast Map and Low Flow Map entries of a contiguous
+#cat:            band of block rows into caller-provided full-size maps.
+#cat:            Used by the progressive detection entry points to fold
+#cat:            map generation into image acquisition; runs serially on
+#cat:            the calling thread.
+
+   Input:
+      blkoffs   - offsets to the pixel origin of each block in the band,
+                  indexed by full-map block index
+      mw        - width (in blocks) of the maps
+      by_first  - first block row of the band
+      by_last   - last block row of the band (inclusive)
+      pdata     - padded 6-bit grayscale image; rows covered by the
+                  band's DFT windows must be final
+      pw        - padded width (in pixels) of the image
+      ph        - padded height (in pixels) of the image
+      dftwaves  - structure containing the DFT wave forms
+      dftgrids  - structure containing the rotated pixel grid offsets
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      direction_map    - band entries of the Direction Map are filled
+      low_contrast_map - band entries of the Low Contrast Map are filled
+      low_flow_map     - band entries of the Low Flow Map are filled
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int gen_initial_maps_band(int *direction_map, int *low_contrast_map,
+                int *low_flow_map, int *blkoffs, const int mw,
+                const int by_first, const int by_last,
+                unsigned char *pdata, const int pw, const int ph,
+                const DFTWAVES *dftwaves, const ROTGRIDS *dftgrids,
+                const LFSPARMS *lfsparms)
+{
+   MAPS_BLOCK_STATE state;
+   int bi, nstats;
+   int *wis, *powmax_dirs;
+   double **powers, *powmaxs, *pownorms;
+   int ret; /* return code */
+
+   state.direction_map = direction_map;
+   state.low_contrast_map = low_contrast_map;
+   state.low_flow_map = low_flow_map;
+   state.blkoffs = blkoffs;
+   state.mw = mw;
+   state.mh = by_last + 1;
+   state.bsize = mw * (by_last + 1);
+   state.pdata = pdata;
+   state.pw = pw;
+   state.ph = ph;
+   state.dftwaves = dftwaves;
+   state.dftgrids = dftgrids;
+   state.lfsparms = lfsparms;
+   state.xminlimit = dftgrids->pad;
+   state.yminlimit = dftgrids->pad;
+   state.xmaxlimit = pw - dftgrids->pad - lfsparms->windowsize - 1;
+   state.ymaxlimit = ph - dftgrids->pad - lfsparms->windowsize - 1;
+   state.pyramid_pass = 0;
+   state.cw = 0;
+   state.claim_limit = state.bsize;
+   state.next_block = 0;
+   state.error = 0;
+
+   /* Allocate DFT directional power vectors and statistics arrays */
+   if((ret = alloc_dir_powers(&powers, dftwaves->nwaves,
+                           dftgrids->ngrids)))
+      return(ret);
+
    nstats = dftwaves->nwaves - 1;
    if((ret = alloc_power_stats(&wis, &powmaxs, &powmax_dirs,
                             &pownorms, nstats))){
-      /* Free memory allocated to this point. */
-      g_free(direction_map);
-      g_free(low_contrast_map);
-      g_free(low_flow_map);
       free_dir_powers(powers, dftwaves->nwaves);
       return(ret);
    }
 
-   /* Compute special window origin limits for determining low contrast.  */
-   /* These pixel limits avoid analyzing the padded borders of the image. */
-   xminlimit = dftgrids->pad;
-   yminlimit = dftgrids->pad;
-   xmaxlimit = pw - dftgrids->pad - lfsparms->windowsize - 1;
-   ymaxlimit = ph - dftgrids->pad - lfsparms->windowsize - 1;
-
-   /* Foreach block in image ... */
-   for(bi = 0; bi < bsize; bi++){
-      /* Adjust block offset from pointing to block origin to pointing */
-      /* to surrounding window origin.                                 */
-      dft_offset = blkoffs[bi] - (lfsparms->windowoffset * pw) -
-                      lfsparms->windowoffset;
-
-      /* Compute pixel coords of window origin. */
-      win_x = dft_offset % pw;
-      win_y = (int)(dft_offset / pw);
-
-      /* Make sure the current window does not access padded image pixels */
-      /* for analyzing low contrast.                                      */
-      win_x = max(xminlimit, win_x);
-      win_x = min(xmaxlimit, win_x);
-      win_y = max(yminlimit, win_y);
-      win_y = min(ymaxlimit, win_y);
-      low_contrast_offset = (win_y * pw) + win_x;
-
-      print2log("   BLOCK %2d (%2d, %2d) ", bi, bi%mw, bi/mw);
-
-      /* If block is low contrast ... */
-      if((ret = low_contrast_block(low_contrast_offset, lfsparms->windowsize,
-                                  pdata, pw, ph, lfsparms))){
-         /* If system error ... */
-         if(ret < 0){
-            g_free(direction_map);
-            g_free(low_contrast_map);
-            g_free(low_flow_map);
-            free_dir_powers(powers, dftwaves->nwaves);
-            g_free(wis);
-            g_free(powmaxs);
-            g_free(powmax_dirs);
-            g_free(pownorms);
-            return(ret);
-         }
+   for(bi = by_first * mw; bi <= (by_last * mw) + mw - 1; bi++){
+      if((ret = gen_initial_maps_block(&state, bi, powers, wis, powmaxs,
+                                    powmax_dirs, pownorms, nstats)))
+         break;
+   }
 
-         /* Otherwise, block is low contrast ... */
-         print2log("LOW CONTRAST\n");
-         low_contrast_map[bi] = TRUE;
-         /* Direction Map's block is already set to INVALID. */
-      }
-      /* Otherwise, sufficient contrast for DFT processing ... */
-      else {
-         print2log("\n");
-
-         /* Compute DFT powers */
-         if((ret = dft_dir_powers(powers, pdata, low_contrast_offset, pw, ph,
-                               dftwaves, dftgrids))){
-            /* Free memory allocated to this point. */
-            g_free(direction_map);
-            g_free(low_contrast_map);
-            g_free(low_flow_map);
-            free_dir_powers(powers, dftwaves->nwaves);
-            g_free(wis);
-            g_free(powmaxs);
-            g_free(powmax_dirs);
-            g_free(pownorms);
-            return(ret);
-         }
+   free_dir_powers(powers, dftwaves->nwaves);
+   g_free(wis);
+   g_free(powmaxs);
+   g_free(powmax_dirs);
+   g_free(pownorms);
 
-         /* Compute DFT power statistics, skipping first applied DFT  */
-         /* wave.  This is dependent on how the primary and secondary */
-         /* direction tests work below.                               */
-         if((ret = dft_power_stats(wis, powmaxs, powmax_dirs, pownorms, powers,
-                                1, dftwaves->nwaves, dftgrids->ngrids))){
-            /* Free memory allocated to this point. */
-            g_free(direction_map);
-            g_free(low_contrast_map);
-            g_free(low_flow_map);
-            free_dir_powers(powers, dftwaves->nwaves);
-            g_free(wis);
-            g_free(powmaxs);
-            g_free(powmax_dirs);
-            g_free(pownorms);
-            return(ret);
-         }
+   return(ret);
+}
 
-#ifdef LOG_REPORT /*vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
-         {  int _w;
-            fprintf(logfp, "      Power\n");
-            for(_w = 0; _w < nstats; _w++){
-               /* Add 1 to wis[w] to create index to original g_dft_coefs[] */
-               fprintf(logfp, "         wis[%d] %d %12.3f %2d %9.3f %12.3f\n",
-                    _w, wis[_w]+1,
-                    powmaxs[wis[_w]], powmax_dirs[wis[_w]], pownorms[wis[_w]],
-                    powers[0][powmax_dirs[wis[_w]]]);
-            }
-         }
-#endif /*^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
+/*************************************************************************
+**************************************************************************
+#cat: dir_from_vector - Converts averaged cosine and sine direction
+#cat:              components back into a rounded integer direction on the
+#cat:              range [0..ndirs).  Unlike a mean of raw direction
+#cat:              indices, the unit-vector average cannot tear across the
+#cat:              0/ndirs wraparound.
 
-         /* Conduct primary direction test */
-         blkdir = primary_dir_test(powers, wis, powmaxs, powmax_dirs,
-                                  pownorms, nstats, lfsparms);
+   Input:
+      cospart - averaged cosine component
+      sinpart - averaged sine component
+      dir2rad - lookup table for converting integer directions
+   Return Code:
+      Integer direction on the range [0..ndirs)
+**************************************************************************/
+static int dir_from_vector(const double cospart, const double sinpart,
+                           const DIR2RAD *dir2rad)
+{
+   double pi2, pi_factor, theta, avr;
+   int avrdir;
 
-         if(blkdir != INVALID_DIR)
-            direction_map[bi] = blkdir;
-         else{
-            /* Conduct secondary (fork) direction test */
-            blkdir = secondary_fork_test(powers, wis, powmaxs, powmax_dirs,
-                                  pownorms, nstats, lfsparms);
-            if(blkdir != INVALID_DIR)
-               direction_map[bi] = blkdir;
-            /* Otherwise current direction in Direction Map remains INVALID */
-            else
-               /* Flag the block as having LOW RIDGE FLOW. */
-               low_flow_map[bi] = TRUE;
-         }
+   /* Compute angle (in radians) from Arctan of avarage         */
+   /* cosine and sine direction components.  I think this order */
+   /* is necessary because 0 direction is vertical and positive */
+   /* direction is clockwise.                                   */
+   theta = atan2(sinpart, cospart);
 
-      } /* End DFT */
-   } /* bi */
+   /* Atan2 returns theta on range [-PI..PI].  Adjust theta so that */
+   /* it is on the range [0..2PI].                                  */
+   pi2 = 2*M_PI;
+   theta += pi2;
+   theta = fmod(theta, pi2);
 
-   /* Deallocate working memory */
-   free_dir_powers(powers, dftwaves->nwaves);
-   g_free(wis);
-   g_free(powmaxs);
-   g_free(powmax_dirs);
-   g_free(pownorms);
+   /* Pi_factor sets the period of the trig functions to NDIRS units in x. */
+   pi_factor = pi2/(double)dir2rad->ndirs; /* 2(M_PI/ndirs) */
 
-   *odmap = direction_map;
-   *olcmap = low_contrast_map;
-   *olfmap = low_flow_map;
-   return(0);
+   /* Round off the direction. */
+   avr = theta / pi_factor;
+   /* Need to truncate precision so that answers are consistent */
+   /* on different computer architectures when rounding doubles. */
+   avr = trunc_dbl_precision(avr, TRUNC_SCALE);
+   avrdir = sround(avr);
+
+   /* Really do need to map values > NDIRS back onto [0..NDIRS) range. */
+   avrdir %= dir2rad->ndirs;
+   return(avrdir);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dir_from_components - Given accumulated cosine and sine direction
+#cat:              components and the number of directions accumulated,
+#cat:              computes the average direction and its strength exactly
+#cat:              like the tail of average_8nbr_dir().
+
+   Input:
+      cossum  - accumulated cosine components
+      sinsum  - accumulated sine components
+      nvalid  - number of valid directions accumulated
+      dir2rad - lookup table for converting integer directions
+   Output:
+      avrdir    - the average direction computed from the components
+      dir_strength - the strength of the average direction
+**************************************************************************/
+static void dir_from_components(int *avrdir, double *dir_strength,
+                                const double cossum, const double sinsum,
+                                const int nvalid, const DIR2RAD *dir2rad)
+{
+   double cospart, sinpart;
+
+   /* If there were no neighbors found with valid direction ... */
+   if(nvalid == 0){
+      /* Return INVALID direction. */
+      *dir_strength = 0;
+      *avrdir = INVALID_DIR;
+      return;
+   }
+
+   /* Compute averages of accumulated cosine and sine direction components */
+   cospart = cossum / (double)nvalid;
+   sinpart = sinsum / (double)nvalid;
+
+   /* Compute directional strength as hypotenuse (without sqrt) of average */
+   /* cosine and sine direction components.  Believe this value will be on */
+   /* the range of [0 .. 1].                                               */
+   *dir_strength = (cospart * cospart) + (sinpart * sinpart);
+   /* Need to truncate precision so that answers are consistent   */
+   /* on different computer architectures when comparing doubles. */
+   *dir_strength = trunc_dbl_precision(*dir_strength, TRUNC_SCALE);
+
+   /* If the direction strength is not sufficiently high ... */
+   if(*dir_strength < DIR_STRENGTH_MIN){
+      /* Return INVALID direction. */
+      *dir_strength = 0;
+      *avrdir = INVALID_DIR;
+      return;
+   }
+
+   *avrdir = dir_from_vector(cospart, sinpart, dir2rad);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: accumulate_8nbrs - Accumulates the unit-vector components and valid
+#cat:              neighbor counts of the 8-neighborhood of every interior
+#cat:              cell of a padded SoA direction grid.  Each of the 8
+#cat:              neighbor offsets is applied to a whole grid row with one
+#cat:              flat loop, which the auto-vectorizer turns into wide
+#cat:              adds (see fpi-simd.h); the zero padding ring stands in
+#cat:              for the per-cell boundary and validity tests of
+#cat:              average_8nbr_dir().
+
+   Input:
+      cosp    - padded cosine plane (pw x mh+2), zero outside valid cells
+      sinp    - padded sine plane
+      vldp    - padded validity plane {1.0 = valid direction, 0.0 = not}
+      mw      - width (in blocks) of the interior grid
+      mh      - height (in blocks) of the interior grid
+      pw      - row stride (in cells) of the padded planes (mw + 2)
+   Output:
+      cossum  - per-cell accumulated cosine components (mw x mh)
+      sinsum  - per-cell accumulated sine components
+      vldsum  - per-cell accumulated valid neighbor counts
+**************************************************************************/
+FPI_SIMD_CLONES static void accumulate_8nbrs(double *cossum, double *sinsum,
+                   double *vldsum,
+                   const double *cosp, const double *sinp, const double *vldp,
+                   const int mw, const int mh, const int pw)
+{
+   static const int dx[8] = { -1,  0,  1, -1, 1, -1, 0, 1 };
+   static const int dy[8] = { -1, -1, -1,  0, 0,  1, 1, 1 };
+   int my, mx, k;
+
+   for(my = 0; my < mh; my++){
+      double *cs = cossum + (my*mw);
+      double *ss = sinsum + (my*mw);
+      double *vs = vldsum + (my*mw);
+
+      for(k = 0; k < 8; k++){
+         const double *pc = cosp + ((my+1+dy[k])*pw) + 1 + dx[k];
+         const double *ps = sinp + ((my+1+dy[k])*pw) + 1 + dx[k];
+         const double *pv = vldp + ((my+1+dy[k])*pw) + 1 + dx[k];
+
+         for(mx = 0; mx < mw; mx++){
+            cs[mx] += pc[mx];
+            ss[mx] += ps[mx];
+            vs[mx] += pv[mx];
+         }
+      }
+   }
 }
 
 /*************************************************************************
@@ -463,6 +954,7 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
       low_contrast_map - map of blocks flagged as LOW CONTRAST
       mw        - number of blocks horizontally in the maps
       mh        - number of blocks vertically in the maps
+      dir2rad   - lookup table for converting integer directions
       lfsparms  - parameters and thresholds for controlling LFS
    Output:
       direction_map - contains the newly interpolated results
@@ -471,7 +963,8 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
       Negative - system error
 **************************************************************************/
 int interpolate_direction_map(int *direction_map, int *low_contrast_map,
-                      const int mw, const int mh, const LFSPARMS *lfsparms)
+                      const int mw, const int mh, const DIR2RAD *dir2rad,
+                      const LFSPARMS *lfsparms)
 {
    int x, y, new_dir;
    int n_dir, e_dir, s_dir, w_dir;
@@ -480,7 +973,7 @@ int interpolate_direction_map(int *direction_map, int *low_contrast_map,
    int n_delta = 0, e_delta = 0, s_delta = 0, w_delta = 0, total_delta;
    int nbr_x, nbr_y;
    int *omap, *dptr, *cptr, *optr;
-   double avr_dir;
+   double avr_cos, avr_sin;
 
    print2log("INTERPOLATE DIRECTION MAP\n");
 
@@ -580,27 +1073,32 @@ int interpolate_direction_map(int *direction_map, int *low_contrast_map,
                   total_delta += w_delta;
                }
 
-               avr_dir = 0.0;
+               /* Average the neighbor directions as weighted unit     */
+               /* vectors; a weighted mean of raw direction indices     */
+               /* tears across the 0/ndirs wraparound and interpolated  */
+               /* nearly-vertical flows to a horizontal direction.      */
+               avr_cos = 0.0;
+               avr_sin = 0.0;
 
                if(n_found){
-                  avr_dir += (n_dir*(n_delta/(double)total_delta));
+                  avr_cos += (dir2rad->cos[n_dir]*(n_delta/(double)total_delta));
+                  avr_sin += (dir2rad->sin[n_dir]*(n_delta/(double)total_delta));
                }
                if(e_found){
-                  avr_dir += (e_dir*(e_delta/(double)total_delta));
+                  avr_cos += (dir2rad->cos[e_dir]*(e_delta/(double)total_delta));
+                  avr_sin += (dir2rad->sin[e_dir]*(e_delta/(double)total_delta));
                }
                if(s_found){
-                  avr_dir += (s_dir*(s_delta/(double)total_delta));
+                  avr_cos += (dir2rad->cos[s_dir]*(s_delta/(double)total_delta));
+                  avr_sin += (dir2rad->sin[s_dir]*(s_delta/(double)total_delta));
                }
                if(w_found){
-                  avr_dir += (w_dir*(w_delta/(double)total_delta));
+                  avr_cos += (dir2rad->cos[w_dir]*(w_delta/(double)total_delta));
+                  avr_sin += (dir2rad->sin[w_dir]*(w_delta/(double)total_delta));
                }
 
-               /* Need to truncate precision so that answers are consistent  */
-               /* on different computer architectures when rounding doubles. */
-               avr_dir = trunc_dbl_precision(avr_dir, TRUNC_SCALE);
-
                /* Assign interpolated direction to output Direction Map. */
-               new_dir = sround(avr_dir);
+               new_dir = dir_from_vector(avr_cos, avr_sin, dir2rad);
 
                print2log("   Block %d,%d INTERP numnbs=%d newdir=%d\n",
                        x, y, total_found, new_dir);
@@ -753,6 +1251,11 @@ int pixelize_map(int **omap, const int iw, const int ih,
 **************************************************************************
 #cat: smooth_direction_map - Takes a vector of integer directions and smooths
 #cat:               them by analyzing the direction of adjacent neighbors.
+#cat:               The neighborhood averages come from flat vectorized
+#cat:               passes over a padded unit-vector grid (see
+#cat:               accumulate_8nbrs()), and every block is smoothed
+#cat:               against the input map rather than partially smoothed
+#cat:               predecessors.
 
    Input:
       direction_map - vector of integer block values
@@ -767,13 +1270,46 @@ void smooth_direction_map(int *direction_map, int *low_contrast_map,
                  const int mw, const int mh,
                  const DIR2RAD *dir2rad, const LFSPARMS *lfsparms)
 {
-   int mx, my;
+   int mx, my, bi, pw;
    int *dptr, *cptr;
    int avrdir, nvalid;
    double dir_strength;
+   double *cosp, *sinp, *vldp;
+   double *cossum, *sinsum, *vldsum;
 
    print2log("SMOOTH DIRECTION MAP\n");
 
+   /* Unpack the direction grid into flat unit-vector planes with a     */
+   /* one-block ring of zero padding, so the neighborhood accumulation  */
+   /* needs no per-cell boundary or validity tests and vectorizes.  The */
+   /* snapshot also makes the pass order-independent: every block is    */
+   /* smoothed against the map as it stood on entry instead of against  */
+   /* already smoothed predecessors.                                    */
+   pw = mw + 2;
+   ASSERT_SIZE_MUL(pw, mh+2);
+   ASSERT_SIZE_MUL(pw*(mh+2), 3*sizeof(double));
+   cosp = (double *)g_malloc0(pw * (mh+2) * 3 * sizeof(double));
+   sinp = cosp + (pw * (mh+2));
+   vldp = sinp + (pw * (mh+2));
+   for(my = 0; my < mh; my++){
+      dptr = direction_map + (my*mw);
+      for(mx = 0; mx < mw; mx++){
+         if(dptr[mx] != INVALID_DIR){
+            bi = ((my+1)*pw) + mx + 1;
+            cosp[bi] = dir2rad->cos[dptr[mx]];
+            sinp[bi] = dir2rad->sin[dptr[mx]];
+            vldp[bi] = 1.0;
+         }
+      }
+   }
+
+   /* Accumulate the 8-neighborhood sums of every block in flat */
+   /* vector passes.                                            */
+   cossum = (double *)g_malloc0(mw * mh * 3 * sizeof(double));
+   sinsum = cossum + (mw*mh);
+   vldsum = sinsum + (mw*mh);
+   accumulate_8nbrs(cossum, sinsum, vldsum, cosp, sinp, vldp, mw, mh, pw);
+
    /* Assign pointers to beginning of both maps. */
    dptr = direction_map;
    cptr = low_contrast_map;
@@ -783,12 +1319,16 @@ void smooth_direction_map(int *direction_map, int *low_contrast_map,
       for(mx = 0; mx < mw; mx++){
          /* If the current block does NOT have LOW CONTRAST ... */
          if(!*cptr){
+            bi = (my*mw)+mx;
+
+            /* The valid neighbor count is a sum of exact 1.0s, so the */
+            /* rounding merely converts it back to an integer.         */
+            nvalid = sround(vldsum[bi]);
 
-            /* Compute average direction from neighbors, returning the */
-            /* number of valid neighbors used in the computation, and  */
-            /* the "strength" of the average direction.                */
-            average_8nbr_dir(&avrdir, &dir_strength, &nvalid,
-                             direction_map, mx, my, mw, mh, dir2rad);
+            /* Compute average direction from the accumulated neighbor */
+            /* components along with its "strength".                   */
+            dir_from_components(&avrdir, &dir_strength,
+                                cossum[bi], sinsum[bi], nvalid, dir2rad);
 
             /* If average direction strength is strong enough */
             /*    (Ex. thresh==0.2)...                        */
@@ -796,43 +1336,17 @@ void smooth_direction_map(int *direction_map, int *low_contrast_map,
                /* If Direction Map direction is valid ... */
                if(*dptr != INVALID_DIR){
                   /* Conduct valid neighbor test (Ex. thresh==3)... */
-                  if(nvalid >= lfsparms->rmv_valid_nbr_min){
-
-#ifdef LOG_REPORT /*vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
-                     fprintf(logfp, "   BLOCK %2d (%2d, %2d)\n",
-                             mx+(my*mw), mx, my);
-                     fprintf(logfp, "      Average NBR :   %2d %6.3f %d\n",
-                             avrdir, dir_strength, nvalid);
-                     fprintf(logfp, "      1. Valid NBR (%d >= %d)\n",
-                             nvalid, lfsparms->rmv_valid_nbr_min);
-                     fprintf(logfp, "      Valid Direction = %d\n", *dptr);
-                     fprintf(logfp, "      Smoothed Direction = %d\n", avrdir);
-#endif /*^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
-
+                  if(nvalid >= lfsparms->rmv_valid_nbr_min)
                      /* Reassign valid direction with average direction. */
                      *dptr = avrdir;
-                  }
                }
                /* Otherwise direction is invalid ... */
                else{
                   /* Even if DIRECTION_MAP value is invalid, if number of */
                   /* valid neighbors is big enough (Ex. thresh==7)...     */
-                  if(nvalid >= lfsparms->smth_valid_nbr_min){
-
-#ifdef LOG_REPORT /*vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
-                     fprintf(logfp, "   BLOCK %2d (%2d, %2d)\n",
-                             mx+(my*mw), mx, my);
-                     fprintf(logfp, "      Average NBR :   %2d %6.3f %d\n",
-                             avrdir, dir_strength, nvalid);
-                     fprintf(logfp, "      2. Invalid NBR (%d >= %d)\n",
-                             nvalid, lfsparms->smth_valid_nbr_min);
-                     fprintf(logfp, "      Invalid Direction = %d\n", *dptr);
-                     fprintf(logfp, "      Smoothed Direction = %d\n", avrdir);
-#endif /*^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
-
+                  if(nvalid >= lfsparms->smth_valid_nbr_min)
                      /* Assign invalid direction with average direction. */
                      *dptr = avrdir;
-                  }
                }
             }
          }
@@ -843,6 +1357,9 @@ void smooth_direction_map(int *direction_map, int *low_contrast_map,
          cptr++;
       }
    }
+
+   g_free(cosp);
+   g_free(cossum);
 }
 
 /*************************************************************************
@@ -1658,8 +2175,6 @@ void average_8nbr_dir(int *avrdir, double *dir_strength, int *nvalid,
    int *iptr;
    int e,w,n,s;
    double cospart, sinpart;
-   double pi2, pi_factor, theta;
-   double avr;
 
    /* Compute neighbor coordinates to current IMAP direction */
    e = mx+1;  /* East */
@@ -1784,62 +2299,10 @@ void average_8nbr_dir(int *avrdir, double *dir_strength, int *nvalid,
       }
    }
 
-   /* If there were no neighbors found with valid direction ... */
-   if(*nvalid == 0){
-      /* Return INVALID direction. */
-      *dir_strength = 0;
-      *avrdir = INVALID_DIR;
-      return;
-   }
-
-   /* Compute averages of accumulated cosine and sine direction components */
-   cospart /= (double)(*nvalid);
-   sinpart /= (double)(*nvalid);
-
-   /* Compute directional strength as hypotenuse (without sqrt) of average */
-   /* cosine and sine direction components.  Believe this value will be on */
-   /* the range of [0 .. 1].                                               */
-   *dir_strength = (cospart * cospart) + (sinpart * sinpart);
-   /* Need to truncate precision so that answers are consistent   */
-   /* on different computer architectures when comparing doubles. */
-   *dir_strength = trunc_dbl_precision(*dir_strength, TRUNC_SCALE);
-
-   /* If the direction strength is not sufficiently high ... */
-   if(*dir_strength < DIR_STRENGTH_MIN){
-      /* Return INVALID direction. */
-      *dir_strength = 0;
-      *avrdir = INVALID_DIR;
-      return;
-   }
-
-   /* Compute angle (in radians) from Arctan of avarage         */
-   /* cosine and sine direction components.  I think this order */
-   /* is necessary because 0 direction is vertical and positive */
-   /* direction is clockwise.                                   */
-   theta = atan2(sinpart, cospart);
-
-   /* Atan2 returns theta on range [-PI..PI].  Adjust theta so that */
-   /* it is on the range [0..2PI].                                  */
-   pi2 = 2*M_PI;
-   theta += pi2;
-   theta = fmod(theta, pi2);
-
-   /* Pi_factor sets the period of the trig functions to NDIRS units in x. */
-   /* For example, if NDIRS==16, then pi_factor = 2(PI/16) = .3926...      */
-   /* Dividing theta (in radians) by this factor ((1/pi_factor)==2.546...) */
-   /* will produce directions on the range [0..NDIRS].                     */
-   pi_factor = pi2/(double)dir2rad->ndirs; /* 2(M_PI/ndirs) */
-
-   /* Round off the direction and return it as an average direction */
-   /* for the neighborhood.                                         */
-   avr = theta / pi_factor;
-   /* Need to truncate precision so that answers are consistent */
-   /* on different computer architectures when rounding doubles. */
-   avr = trunc_dbl_precision(avr, TRUNC_SCALE);
-   *avrdir = sround(avr);
-
-   /* Really do need to map values > NDIRS back onto [0..NDIRS) range. */
-   *avrdir %= dir2rad->ndirs;
+   /* Convert the accumulated components into the average direction */
+   /* and its strength.                                              */
+   dir_from_components(avrdir, dir_strength, cospart, sinpart,
+                       *nvalid, dir2rad);
 }
 
 /*************************************************************************
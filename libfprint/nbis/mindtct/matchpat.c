@@ -58,6 +58,10 @@ of the software.
                         match_1st_pair()
                         match_2nd_pair()
                         match_3rd_pair()
+                        match_1st_pair_mask()
+                        match_2nd_pair_mask()
+                        match_3rd_pair_mask()
+                        match_first_feature()
                         skip_repeated_horizontal_pair()
                         skip_repeated_vertical_pair()
 ***********************************************************************/
@@ -65,6 +69,49 @@ of the software.
 #include <stdio.h>
 #include <lfs.h>
 
+/* Bit-parallel feature pattern masks.  Entry [p] holds one bit per
+   g_feature_patterns[] index whose first (second, third) pixel pair
+   equals the binary pixel pair packed as p = (p1<<1)|p2.  They are
+   compiled from the pattern table on first use, so the per-pixel
+   pattern scan reduces to table lookups and bitwise ANDs over a
+   candidate mask instead of loops over candidate index lists. */
+static unsigned int g_first_pair_masks[4];
+static unsigned int g_second_pair_masks[4];
+static unsigned int g_third_pair_masks[4];
+static gsize g_pair_masks_built;
+
+/*************************************************************************
+**************************************************************************
+#cat: build_pair_masks - Compiles the bit-parallel pixel pair masks from
+#cat:            g_feature_patterns[].  Thread safe; concurrent detections
+#cat:            build the tables at most once.
+*************************************************************************/
+static void build_pair_masks(void)
+{
+   if(g_once_init_enter(&g_pair_masks_built)){
+      int i, p;
+
+      for(p = 0; p < 4; p++){
+         int p1 = p >> 1;
+         int p2 = p & 1;
+
+         for(i = 0; i < NFEATURES; i++){
+            if((p1 == g_feature_patterns[i].first[0]) &&
+               (p2 == g_feature_patterns[i].first[1]))
+               g_first_pair_masks[p] |= (1u << i);
+            if((p1 == g_feature_patterns[i].second[0]) &&
+               (p2 == g_feature_patterns[i].second[1]))
+               g_second_pair_masks[p] |= (1u << i);
+            if((p1 == g_feature_patterns[i].third[0]) &&
+               (p2 == g_feature_patterns[i].third[1]))
+               g_third_pair_masks[p] |= (1u << i);
+         }
+      }
+
+      g_once_init_leave(&g_pair_masks_built, 1);
+   }
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: match_1st_pair - Determines which of the g_feature_patterns[] have their
@@ -194,6 +241,89 @@ int match_3rd_pair(unsigned char p1, unsigned char p2,
    return(*nposs);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: match_1st_pair_mask - Bit-parallel equivalent of match_1st_pair().
+#cat:            Returns the mask of g_feature_patterns[] whose first pixel
+#cat:            pair matches the specified binary pixel pair.
+
+   Input:
+      p1 - first pixel value of pair (binary)
+      p2 - second pixel value of pair (binary)
+   Return Code:
+      Mask with one bit set per matching g_feature_patterns[] index
+*************************************************************************/
+unsigned int match_1st_pair_mask(unsigned char p1, unsigned char p2)
+{
+   build_pair_masks();
+
+   return(g_first_pair_masks[(p1<<1)|p2]);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: match_2nd_pair_mask - Bit-parallel equivalent of match_2nd_pair().
+#cat:            Narrows a candidate mask to those features whose second
+#cat:            pixel pair matches the specified binary pixel pair.  Every
+#cat:            pattern's second pair has differing pixels, so equal pairs
+#cat:            yield an empty mask just as match_2nd_pair() rejects them.
+
+   Input:
+      p1       - first pixel value of pair (binary)
+      p2       - second pixel value of pair (binary)
+      possible - mask of potentially-matching g_feature_patterns[]
+   Return Code:
+      Narrowed candidate mask
+*************************************************************************/
+unsigned int match_2nd_pair_mask(unsigned char p1, unsigned char p2,
+                   unsigned int possible)
+{
+   return(possible & g_second_pair_masks[(p1<<1)|p2]);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: match_3rd_pair_mask - Bit-parallel equivalent of match_3rd_pair().
+#cat:            Narrows a candidate mask to those features whose third
+#cat:            pixel pair matches the specified binary pixel pair.
+
+   Input:
+      p1       - first pixel value of pair (binary)
+      p2       - second pixel value of pair (binary)
+      possible - mask of potentially-matching g_feature_patterns[]
+   Return Code:
+      Narrowed candidate mask
+*************************************************************************/
+unsigned int match_3rd_pair_mask(unsigned char p1, unsigned char p2,
+                   unsigned int possible)
+{
+   return(possible & g_third_pair_masks[(p1<<1)|p2]);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: match_first_feature - Returns the lowest g_feature_patterns[] index
+#cat:            set in a candidate mask; the list-based routines keep
+#cat:            their candidates in ascending index order, so this is the
+#cat:            feature match_3rd_pair() would have left in possible[0].
+
+   Input:
+      possible - non-empty candidate mask
+   Return Code:
+      Index of the lowest set bit
+*************************************************************************/
+int match_first_feature(unsigned int possible)
+{
+   int i = 0;
+
+   while(!(possible & 1u)){
+      possible >>= 1;
+      i++;
+   }
+
+   return(i);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: skip_repeated_horizontal_pair - Takes the location of two pixel in
@@ -101,10 +101,33 @@ of the software.
 #include <stdio.h>
 #include <lfs.h>
 
+/* Candidate pool the minutia structures of one detection are handed
+   out of.  Detection creates and discards thousands of candidates per
+   image; bumping a pointer through one block replaces an individual
+   malloc/free per candidate.  The pool is reference counted because
+   accepted minutiae outlive the list they were detected into (the
+   library steals them into per-image arrays): each pooled minutia and
+   the owning list hold one reference, and the block is released when
+   the last of them is freed.  Releases may happen from a different
+   thread than detection ran on, hence the atomic count. */
+typedef struct minutia_pool{
+   gint refs;                    /* owning list plus one per pooled minutia */
+   int used;                     /* structures handed out of block[] so far */
+   MINUTIA block[MAX_MINUTIAE];
+} MINUTIA_POOL;
+
+static void minutia_pool_unref(MINUTIA_POOL *pool)
+{
+   if(g_atomic_int_dec_and_test(&pool->refs))
+      g_free(pool);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: alloc_minutiae - Allocates and initializes a minutia list based on the
 #cat:            specified maximum number of minutiae to be detected.
+#cat:            The candidate pool and the list storage are preallocated
+#cat:            in full so detection itself does not allocate per minutia.
 
    Input:
       DEFAULT_BOZORTH_MINUTIAE - number of minutia to be allocated in list
@@ -117,6 +140,7 @@ of the software.
 int alloc_minutiae(MINUTIAE **ominutiae, const int DEFAULT_BOZORTH_MINUTIAE)
 {
    MINUTIAE *minutiae;
+   MINUTIA_POOL *pool;
 
    minutiae = (MINUTIAE *)g_malloc(sizeof(MINUTIAE));
    minutiae->list = (MINUTIA **)g_malloc(DEFAULT_BOZORTH_MINUTIAE * sizeof(MINUTIA *));
@@ -124,6 +148,11 @@ int alloc_minutiae(MINUTIAE **ominutiae, const int DEFAULT_BOZORTH_MINUTIAE)
    minutiae->alloc = DEFAULT_BOZORTH_MINUTIAE;
    minutiae->num = 0;
 
+   pool = (MINUTIA_POOL *)g_malloc(sizeof(MINUTIA_POOL));
+   pool->refs = 1;
+   pool->used = 0;
+   minutiae->pool = pool;
+
    *ominutiae = minutiae;
    return(0);
 }
@@ -707,8 +736,12 @@ int rm_dup_minutiae(MINUTIAE *minutiae)
 **************************************************************************
 #cat: create_minutia - Takes attributes associated with a detected minutia
 #cat:            point and allocates and initializes a minutia structure.
+#cat:            The structure comes from the candidate pool of the given
+#cat:            minutiae list; once the pool is exhausted, structures are
+#cat:            allocated individually as before.
 
    Input:
+      minutiae - list whose candidate pool the structure is drawn from
       x_loc   - x-pixel coord of minutia (interior to feature)
       y_loc   - y-pixel coord of minutia (interior to feature)
       x_edge  - x-pixel coord of corresponding edge pixel (exterior to feature)
@@ -724,15 +757,27 @@ int rm_dup_minutiae(MINUTIAE *minutiae)
       Zero       - minutia structure successfully allocated and initialized
       Negative   - system error
 *************************************************************************/
-int create_minutia(MINUTIA **ominutia, const int x_loc, const int y_loc,
+int create_minutia(MINUTIA **ominutia, MINUTIAE *minutiae,
+                   const int x_loc, const int y_loc,
                    const int x_edge, const int y_edge, const int idir,
                    const double reliability,
                    const int type, const int appearing, const int feature_id)
 {
+   MINUTIA_POOL *pool;
    MINUTIA *minutia;
 
-   /* Allocate a minutia structure. */
-   minutia = (MINUTIA *)g_malloc(sizeof(MINUTIA));
+   /* Take the next structure from the list's candidate pool, falling */
+   /* back to an individual allocation once the pool is exhausted.    */
+   pool = (MINUTIA_POOL *)minutiae->pool;
+   if(pool->used < MAX_MINUTIAE){
+      minutia = &pool->block[pool->used++];
+      minutia->pool = pool;
+      g_atomic_int_inc(&pool->refs);
+   }
+   else{
+      minutia = (MINUTIA *)g_malloc(sizeof(MINUTIA));
+      minutia->pool = (void *)NULL;
+   }
 
    /* Assign minutia structure attributes. */
    minutia->x = x_loc;
@@ -772,6 +817,10 @@ void free_minutiae(MINUTIAE *minutiae)
    /* Deallocate list of minutia pointers. */
    g_free(minutiae->list);
 
+   /* Release the list's reference on the candidate pool; the pool is */
+   /* freed once the last minutia drawn from it is freed as well.     */
+   minutia_pool_unref((MINUTIA_POOL *)minutiae->pool);
+
    /* Deallocate the list structure. */
    g_free(minutiae);
 }
@@ -792,8 +841,12 @@ void free_minutia(MINUTIA *minutia)
    if(minutia->ridge_counts != (int *)NULL)
       g_free(minutia->ridge_counts);
 
-   /* Deallocate the minutia structure. */
-   g_free(minutia);
+   /* Return the structure to its candidate pool, or deallocate it */
+   /* individually if it did not come from one.                    */
+   if(minutia->pool != (void *)NULL)
+      minutia_pool_unref((MINUTIA_POOL *)minutia->pool);
+   else
+      g_free(minutia);
 }
 
 /*************************************************************************
@@ -1053,7 +1106,7 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
 {
    int sx, sy, ex, ey, cx, cy, x2;
    unsigned char *p1ptr, *p2ptr;
-   int possible[NFEATURES], nposs;
+   unsigned int possible;
    int ret;
 
    /* Set scan region to entire image. */
@@ -1076,7 +1129,7 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
          p2ptr = bdata+((cy+1)*iw)+cx;
          /* If scan pixel pair matches first pixel pair of */
          /* 1 or more features... */
-         if(match_1st_pair(*p1ptr, *p2ptr, possible, &nposs)){
+         if((possible = match_1st_pair_mask(*p1ptr, *p2ptr))){
             /* Bump forward to next scan pixel pair. */
             cx++;
             p1ptr++;
@@ -1085,7 +1138,7 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
             if(cx < ex){
                /* If scan pixel pair matches second pixel pair of */
                /* 1 or more features... */
-               if(match_2nd_pair(*p1ptr, *p2ptr, possible, &nposs)){
+               if((possible = match_2nd_pair_mask(*p1ptr, *p2ptr, possible))){
                   /* Store current x location. */
                   x2 = cx;
                   /* Skip repeated pixel pairs. */
@@ -1095,10 +1148,10 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
                   if(cx < ex){
                      /* If scan pixel pair matches third pixel pair of */
                      /* a single feature... */
-                     if(match_3rd_pair(*p1ptr, *p2ptr, possible, &nposs)){
+                     if((possible = match_3rd_pair_mask(*p1ptr, *p2ptr, possible))){
                         /* Process detected minutia point. */
                         if((ret = process_horizontal_scan_minutia_V2(minutiae,
-                                         cx, cy, x2, possible[0],
+                                         cx, cy, x2, match_first_feature(possible),
                                          bdata, iw, ih, pdirection_map,
                                          plow_flow_map, phigh_curve_map,
                                          lfsparms))){
@@ -1204,7 +1257,7 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
 {
    int sx, sy, ex, ey, cx, cy, y2;
    unsigned char *p1ptr, *p2ptr;
-   int possible[NFEATURES], nposs;
+   unsigned int possible;
    int ret;
 
    /* Set scan region to entire image. */
@@ -1227,7 +1280,7 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
          p2ptr = p1ptr+1;
          /* If scan pixel pair matches first pixel pair of */
          /* 1 or more features... */
-         if(match_1st_pair(*p1ptr, *p2ptr, possible, &nposs)){
+         if((possible = match_1st_pair_mask(*p1ptr, *p2ptr))){
             /* Bump forward to next scan pixel pair. */
             cy++;
             p1ptr+=iw;
@@ -1236,7 +1289,7 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
             if(cy < ey){
                /* If scan pixel pair matches second pixel pair of */
                /* 1 or more features... */
-               if(match_2nd_pair(*p1ptr, *p2ptr, possible, &nposs)){
+               if((possible = match_2nd_pair_mask(*p1ptr, *p2ptr, possible))){
                   /* Store current y location. */
                   y2 = cy;
                   /* Skip repeated pixel pairs. */
@@ -1246,10 +1299,10 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
                   if(cy < ey){
                      /* If scan pixel pair matches third pixel pair of */
                      /* a single feature... */
-                     if(match_3rd_pair(*p1ptr, *p2ptr, possible, &nposs)){
+                     if((possible = match_3rd_pair_mask(*p1ptr, *p2ptr, possible))){
                         /* Process detected minutia point. */
                         if((ret = process_vertical_scan_minutia_V2(minutiae,
-                                         cx, cy, y2, possible[0],
+                                         cx, cy, y2, match_first_feature(possible),
                                          bdata, iw, ih, pdirection_map,
                                          plow_flow_map, phigh_curve_map,
                                          lfsparms))){
@@ -1613,7 +1666,8 @@ int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae,
       reliability = HIGH_RELIABILITY;
 
    /* Create a minutia object based on derived attributes. */
-   if((ret = create_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
+   if((ret = create_minutia(&minutia, minutiae,
+                     x_loc, y_loc, x_edge, y_edge, idir,
                      reliability,
                      g_feature_patterns[feature_id].type,
                      g_feature_patterns[feature_id].appearing, feature_id)))
@@ -1764,7 +1818,8 @@ int process_vertical_scan_minutia_V2(MINUTIAE *minutiae,
       reliability = HIGH_RELIABILITY;
 
    /* Create a minutia object based on derived attributes. */
-   if((ret = create_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
+   if((ret = create_minutia(&minutia, minutiae,
+                     x_loc, y_loc, x_edge, y_edge, idir,
                      reliability,
                      g_feature_patterns[feature_id].type,
                      g_feature_patterns[feature_id].appearing, feature_id)))
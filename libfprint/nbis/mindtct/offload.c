@@ -0,0 +1,123 @@
+/***********************************************************************
+      LIBRARY: LFS - NIST Latent Fingerprint System
+
+      FILE:    OFFLOAD.C
+      DATE:    08/2026
+
+      Contains the registration point and stage trampolines for an
+      optional compute backend taking over the data-parallel front-end
+      stages of minutiae detection (block map generation and directional
+      binarization).  A backend is free to decline any stage, and any
+      backend failure falls back to the regular CPU implementation, so
+      registering one never changes whether detection succeeds.
+
+***********************************************************************
+               ROUTINES:
+                        lfs_set_offload_backend()
+                        offload_image_maps()
+                        offload_binarize()
+***********************************************************************/
+
+#include <stdio.h>
+#include <lfs.h>
+
+/* The registered backend, or NULL.  Read atomically because detection
+   runs on worker threads while registration happens on the caller's. */
+static const LFS_OFFLOAD_BACKEND *offload_backend = (LFS_OFFLOAD_BACKEND *)NULL;
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_set_offload_backend - Registers (or, with NULL, removes) the
+#cat:              compute backend offered the front-end detection stages.
+#cat:              The backend structure must stay valid until replaced;
+#cat:              detections already past a stage boundary keep using
+#cat:              the implementation they started with.
+
+   Input:
+      backend - stage implementations to register, or NULL
+**************************************************************************/
+void lfs_set_offload_backend(const LFS_OFFLOAD_BACKEND *backend)
+{
+   g_atomic_pointer_set(&offload_backend, backend);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: offload_image_maps - Offers the block map generation stage to the
+#cat:              registered backend.  Declined or failed attempts report
+#cat:              LFS_OFFLOAD_UNSUPPORTED so the caller runs
+#cat:              gen_image_maps() instead.
+
+   Input/Output: identical to gen_image_maps(), minus the session
+      argument: a backend computes the maps from the image alone and
+      does not take prior-stage direction hints.
+   Return Code:
+      Zero                    - backend produced the maps
+      LFS_OFFLOAD_UNSUPPORTED - run the CPU implementation
+**************************************************************************/
+int offload_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+          int *omw, int *omh,
+          unsigned char *pdata, const int pw, const int ph,
+          const DIR2RAD *dir2rad, const DFTWAVES *dftwaves,
+          const ROTGRIDS *dftgrids, const LFSPARMS *lfsparms)
+{
+   const LFS_OFFLOAD_BACKEND *backend;
+   int ret;
+
+   backend = g_atomic_pointer_get(&offload_backend);
+   if((backend == (LFS_OFFLOAD_BACKEND *)NULL) ||
+      (backend->image_maps == (int (*)(int **, int **, int **, int **,
+                    int *, int *, unsigned char *, const int, const int,
+                    const DIR2RAD *, const DFTWAVES *,
+                    const ROTGRIDS *, const LFSPARMS *))NULL))
+      return(LFS_OFFLOAD_UNSUPPORTED);
+
+   ret = backend->image_maps(odmap, olcmap, olfmap, ohcmap, omw, omh,
+                    pdata, pw, ph, dir2rad, dftwaves, dftgrids, lfsparms);
+   if(ret < 0){
+      g_debug("offload backend %s failed map generation (%d), "
+              "falling back to CPU", backend->name, ret);
+      return(LFS_OFFLOAD_UNSUPPORTED);
+   }
+
+   return(ret);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: offload_binarize - Offers the directional binarization stage to the
+#cat:              registered backend.  Declined or failed attempts report
+#cat:              LFS_OFFLOAD_UNSUPPORTED so the caller runs
+#cat:              binarize_V2() instead.
+
+   Input/Output: identical to binarize_V2().
+   Return Code:
+      Zero                    - backend produced the binary image
+      LFS_OFFLOAD_UNSUPPORTED - run the CPU implementation
+**************************************************************************/
+int offload_binarize(unsigned char **odata, int *ow, int *oh,
+          unsigned char *pdata, const int pw, const int ph,
+          const int *direction_map, const int mw, const int mh,
+          const ROTGRIDS *dirbingrids, const LFSPARMS *lfsparms)
+{
+   const LFS_OFFLOAD_BACKEND *backend;
+   int ret;
+
+   backend = g_atomic_pointer_get(&offload_backend);
+   if((backend == (LFS_OFFLOAD_BACKEND *)NULL) ||
+      (backend->binarize == (int (*)(unsigned char **, int *, int *,
+                    unsigned char *, const int, const int,
+                    const int *, const int, const int,
+                    const ROTGRIDS *, const LFSPARMS *))NULL))
+      return(LFS_OFFLOAD_UNSUPPORTED);
+
+   ret = backend->binarize(odata, ow, oh, pdata, pw, ph,
+                    direction_map, mw, mh, dirbingrids, lfsparms);
+   if(ret < 0){
+      g_debug("offload backend %s failed binarization (%d), "
+              "falling back to CPU", backend->name, ret);
+      return(LFS_OFFLOAD_UNSUPPORTED);
+   }
+
+   return(ret);
+}
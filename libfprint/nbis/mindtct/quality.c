@@ -56,8 +56,10 @@ of the software.
 
 ***********************************************************************
                ROUTINES:
+                        gen_quality_map_block()
                         gen_quality_map()
                         combined_minutia_quality()
+                        combined_minutia_quality_lazy()
                         grayscale_reliability()
                         get_neighborhood_stats()
                         reliability_fr_quality_map()
@@ -68,6 +70,96 @@ of the software.
 #include <math.h>
 #include <lfs.h>
 
+/***********************************************************************
+************************************************************************
+#cat: gen_quality_map_block - Computes the integrated quality grade of a
+#cat:              single block from the direction map, low contrast map,
+#cat:              low ridge flow map, and high curvature map.  Applies the
+#cat:              same heuristics as gen_quality_map, which is implemented
+#cat:              in terms of this routine.
+
+   Input:
+      direction_map    - map with blocks assigned dominant ridge flow direction
+      low_contrast_map - map with blocks flagged as low contrast
+      low_flow_map     - map with blocks flagged as low ridge flow
+      high_curve_map   - map with blocks flagged as high curvature
+      map_w            - width (in blocks) of the maps
+      map_h            - height (in blocks) of the maps
+      thisX            - horizontal block coordinate
+      thisY            - vertical block coordinate
+   Return Value:
+      quality    - the block's quality grade on the scale [0...4]
+************************************************************************/
+int gen_quality_map_block(int *direction_map, int *low_contrast_map,
+                    int *low_flow_map, int *high_curve_map,
+                    const int map_w, const int map_h,
+                    const int thisX, const int thisY)
+{
+   int compX, compY;
+   int arrayPos, arrayPos2;
+   int QualOffset;
+   int quality;
+
+   /* Compute block index. */
+   arrayPos=(thisY*map_w)+thisX;
+   /* If current block has low contrast or INVALID direction ... */
+   if(low_contrast_map[arrayPos] || direction_map[arrayPos]<0)
+      /* Set block's quality to 0/F. */
+      return(0);
+
+   /* Set baseline quality before looking at neighbors    */
+   /*     (will subtract QualOffset below)                */
+   /* If current block has low flow or high curvature ... */
+   if(low_flow_map[arrayPos] || high_curve_map[arrayPos])
+      /* Set block's quality initially to 3/B. */
+      quality = 3;  /* offset will be -1..-2 */
+   /* Otherwise, block is NOT low flow AND NOT high curvature... */
+   else
+      /* Set block's quality to 4/A. */
+      quality = 4;    /* offset will be 0..-2 */
+
+   /* If block within NEIGHBOR_DELTA of edge ... */
+   if(thisY < NEIGHBOR_DELTA || thisY > map_h - 1 - NEIGHBOR_DELTA ||
+      thisX < NEIGHBOR_DELTA || thisX > map_w - 1 - NEIGHBOR_DELTA)
+      /* Set block's quality to 1/E. */
+      return(1);
+
+   /* Otherwise, test neighboring blocks ... */
+   /* Initialize quality adjustment to 0. */
+   QualOffset=0;
+   /* Foreach row in neighborhood ... */
+   for(compY=thisY-NEIGHBOR_DELTA;
+       compY<=thisY+NEIGHBOR_DELTA;compY++){
+      /* Foreach block in neighborhood */
+      /*  (including current block)... */
+      for(compX=thisX-NEIGHBOR_DELTA;
+          compX<=thisX+NEIGHBOR_DELTA;compX++) {
+         /* Compute neighboring block's index. */
+         arrayPos2 = (compY*map_w)+compX;
+        /* If neighbor block (which might be itself) has */
+        /* low contrast or INVALID direction .. */
+        if(low_contrast_map[arrayPos2] ||
+            direction_map[arrayPos2]<0) {
+            /* Set quality adjustment to -2. */
+            QualOffset=-2;
+            /* Done with neighborhood row. */
+            break;
+         }
+         /* Otherwise, if neighbor block (which might be */
+         /* itself) has low flow or high curvature ... */
+         else if(low_flow_map[arrayPos2] ||
+                 high_curve_map[arrayPos2]) {
+            /* Set quality to -1 if not already -2. */
+            QualOffset=min(QualOffset,-1);
+         }
+      }
+   }
+   /* Decrement minutia quality by neighborhood adjustment. */
+   quality+=QualOffset;
+
+   return(quality);
+}
+
 /***********************************************************************
 ************************************************************************
 #cat: gen_quality_map - Takes a direction map, low contrast map, low ridge
@@ -111,9 +203,7 @@ int gen_quality_map(int **oqmap, int *direction_map, int *low_contrast_map,
 
    int *QualMap;
    int thisX, thisY;
-   int compX, compY;
-   int arrayPos, arrayPos2;
-   int QualOffset;
+   int arrayPos;
 
    ASSERT_SIZE_MUL(map_w, map_h);
    ASSERT_SIZE_MUL(map_w * map_h, sizeof(int));
@@ -126,62 +216,11 @@ int gen_quality_map(int **oqmap, int *direction_map, int *low_contrast_map,
       for(thisX=0; thisX<map_w; thisX++) {
          /* Compute block index. */
          arrayPos=(thisY*map_w)+thisX;
-         /* If current block has low contrast or INVALID direction ... */
-         if(low_contrast_map[arrayPos] || direction_map[arrayPos]<0)
-            /* Set block's quality to 0/F. */
-            QualMap[arrayPos]=0;
-         else{
-            /* Set baseline quality before looking at neighbors    */
-            /*     (will subtract QualOffset below)                */
-            /* If current block has low flow or high curvature ... */
-            if(low_flow_map[arrayPos] || high_curve_map[arrayPos])
-               /* Set block's quality initially to 3/B. */
-               QualMap[arrayPos] = 3;  /* offset will be -1..-2 */
-            /* Otherwise, block is NOT low flow AND NOT high curvature... */
-            else
-               /* Set block's quality to 4/A. */
-               QualMap[arrayPos]=4;    /* offset will be 0..-2 */
-
-            /* If block within NEIGHBOR_DELTA of edge ... */
-            if(thisY < NEIGHBOR_DELTA || thisY > map_h - 1 - NEIGHBOR_DELTA ||
-               thisX < NEIGHBOR_DELTA || thisX > map_w - 1 - NEIGHBOR_DELTA)
-               /* Set block's quality to 1/E. */
-               QualMap[arrayPos]=1;
-            /* Otherwise, test neighboring blocks ... */
-            else{
-               /* Initialize quality adjustment to 0. */
-               QualOffset=0;
-               /* Foreach row in neighborhood ... */
-               for(compY=thisY-NEIGHBOR_DELTA;
-                   compY<=thisY+NEIGHBOR_DELTA;compY++){
-                  /* Foreach block in neighborhood */
-                  /*  (including current block)... */
-                  for(compX=thisX-NEIGHBOR_DELTA;
-                      compX<=thisX+NEIGHBOR_DELTA;compX++) {
-                     /* Compute neighboring block's index. */
-                     arrayPos2 = (compY*map_w)+compX;
-                    /* If neighbor block (which might be itself) has */
-                    /* low contrast or INVALID direction .. */
-                    if(low_contrast_map[arrayPos2] ||
-                        direction_map[arrayPos2]<0) {
-                        /* Set quality adjustment to -2. */
-                        QualOffset=-2;
-                        /* Done with neighborhood row. */
-                        break;
-                     }
-                     /* Otherwise, if neighbor block (which might be */
-                     /* itself) has low flow or high curvature ... */
-                     else if(low_flow_map[arrayPos2] ||
-                             high_curve_map[arrayPos2]) {
-                        /* Set quality to -1 if not already -2. */
-                        QualOffset=min(QualOffset,-1);
-                     }
-                  }
-               }
-               /* Decrement minutia quality by neighborhood adjustment. */
-               QualMap[arrayPos]+=QualOffset;
-            }
-         }
+         /* Grade the current block. */
+         QualMap[arrayPos] = gen_quality_map_block(direction_map,
+                                  low_contrast_map, low_flow_map,
+                                  high_curve_map, map_w, map_h,
+                                  thisX, thisY);
       }
    }
 
@@ -296,6 +335,132 @@ int combined_minutia_quality(MINUTIAE *minutiae,
    return(0);
 }
 
+/***********************************************************************
+************************************************************************
+#cat: combined_minutia_quality_lazy - Assigns minutia reliabilities like
+#cat:              combined_minutia_quality, but builds the quality map on
+#cat:              demand, grading only the blocks that actually contain
+#cat:              detected minutiae.  Blocks without minutiae are left at
+#cat:              -1 (uncomputed) in the returned map.
+
+   Input:
+      minutiae    - structure contining the detected minutia
+      direction_map    - map with blocks assigned dominant ridge flow direction
+      low_contrast_map - map with blocks flagged as low contrast
+      low_flow_map     - map with blocks flagged as low ridge flow
+      high_curve_map   - map with blocks flagged as high curvature
+      mw          - width (in blocks) of the maps
+      mh          - height (in blocks) of the maps
+      blocksize   - size (in pixels) of each block in the map
+      idata       - 8-bit grayscale fingerprint image
+      iw          - width (in pixels) of the image
+      ih          - height (in pixels) of the image
+      id          - depth (in pixels) of the image
+      ppmm        - scan resolution of the image in pixels/mm
+   Output:
+      oqmap       - points to the partially graded quality map
+      minutiae    - updated reliability members
+   Return Code:
+      Zero       - successful completion
+      Negative   - system error
+************************************************************************/
+int combined_minutia_quality_lazy(MINUTIAE *minutiae, int **oqmap,
+             int *direction_map, int *low_contrast_map,
+             int *low_flow_map, int *high_curve_map,
+             const int mw, const int mh, const int blocksize,
+             unsigned char *idata, const int iw, const int ih, const int id,
+             const double ppmm)
+{
+   int i, bx, by, arrayPos, radius_pix;
+   int *QualMap, qmap_value;
+   MINUTIA *minutia;
+   double gs_reliability, reliability;
+
+   /* If image is not 8-bit grayscale ... */
+   if(id != 8){
+      fprintf(stderr, "ERROR : combined_minutia_quality_lazy : ");
+      fprintf(stderr, "image must pixel depth = %d must be 8 ", id);
+      fprintf(stderr, "to compute reliability\n");
+      return(-2);
+   }
+
+   ASSERT_SIZE_MUL(mw, mh);
+   ASSERT_SIZE_MUL(mw * mh, sizeof(int));
+
+   /* Allocate the quality map with every block marked uncomputed. */
+   QualMap = (int *)g_malloc(mw * mh * sizeof(int));
+   for(i = 0; i < mw*mh; i++)
+      QualMap[i] = -1;
+
+   /* Compute pixel radius of neighborhood based on image's scan resolution. */
+   radius_pix = sround(RADIUS_MM * ppmm);
+
+   /* Foreach minutiae detected ... */
+   for(i = 0; i < minutiae->num; i++){
+      /* Assign minutia pointer. */
+      minutia = minutiae->list[i];
+
+      /* Compute reliability from stdev and mean of pixel neighborhood. */
+      gs_reliability = grayscale_reliability(minutia,
+                                             idata, iw, ih, radius_pix);
+
+      /* Locate the minutia's block the same way pixelize_map would:  */
+      /* blocks are laid out on a regular grid except for the last    */
+      /* row and column, which are flush with the image edges and     */
+      /* overwrite any pixels they overlap.                           */
+      bx = (minutia->x >= iw - blocksize) ? mw - 1 : minutia->x/blocksize;
+      by = (minutia->y >= ih - blocksize) ? mh - 1 : minutia->y/blocksize;
+      /* Compute block index. */
+      arrayPos = (by*mw)+bx;
+
+      /* Grade the block on first use. */
+      if(QualMap[arrayPos] < 0)
+         QualMap[arrayPos] = gen_quality_map_block(direction_map,
+                                  low_contrast_map, low_flow_map,
+                                  high_curve_map, mw, mh, bx, by);
+      /* Lookup quality map value. */
+      qmap_value = QualMap[arrayPos];
+
+      /* Combine grayscale reliability and quality map value. */
+      switch(qmap_value){
+         /* Quality A : [50..99]% */
+         case 4 :
+            reliability = 0.50 + (0.49 * gs_reliability);
+            break;
+         /* Quality B : [25..49]% */
+         case 3 :
+            reliability = 0.25 + (0.24 * gs_reliability);
+            break;
+         /* Quality C : [10..24]% */
+         case 2 :
+            reliability = 0.10 + (0.14 * gs_reliability);
+            break;
+         /* Quality D : [5..9]% */
+         case 1 :
+            reliability = 0.05 + (0.04 * gs_reliability);
+            break;
+         /* Quality E : 1% */
+         case 0 :
+            reliability = 0.01;
+            break;
+         /* Error if quality value not in range [0..4]. */
+         default:
+            fprintf(stderr, "ERROR : combined_minutia_quality_lazy : ");
+            fprintf(stderr, "unexpected quality map value %d ", qmap_value);
+            fprintf(stderr, "not in range [0..4]\n");
+            g_free(QualMap);
+            return(-3);
+      }
+      minutia->reliability = reliability;
+   }
+
+   /* Assign quality map to output pointer. */
+   *oqmap = QualMap;
+
+   /* Return normally. */
+   return(0);
+}
+
 
 /***********************************************************************
 ************************************************************************
@@ -203,6 +203,37 @@ int remove_false_minutia_V2(MINUTIAE *minutiae,
    return(0);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: remove_flagged_minutiae - Removes all minutiae flagged in the
+#cat:            to_remove list from the minutiae list, compacting the
+#cat:            list in a single pass regardless of how many minutiae
+#cat:            are flagged.
+
+   Input:
+      minutiae  - list of true and false minutiae
+      to_remove - list of flags (one per minutia), TRUE == remove
+   Output:
+      minutiae  - list of pruned minutiae
+**************************************************************************/
+static void remove_flagged_minutiae(MINUTIAE *minutiae, const int *to_remove)
+{
+   int fr, to;
+
+   /* Slide the unflagged minutiae up over top of the flagged ones. */
+   to = 0;
+   for(fr = 0; fr < minutiae->num; fr++){
+      if(to_remove[fr])
+         /* Deallocate the minutia structure being removed. */
+         free_minutia(minutiae->list[fr]);
+      else
+         minutiae->list[to++] = minutiae->list[fr];
+   }
+
+   /* Set the number of minutiae remaining in the list. */
+   minutiae->num = to;
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: remove_holes - Removes minutia points on small loops around valleys.
@@ -223,14 +254,26 @@ int remove_holes(MINUTIAE *minutiae,
                  unsigned char *bdata, const int iw, const int ih,
                  const LFSPARMS *lfsparms)
 {
-   int i, ret;
+   int i, ret, *to_remove;
    MINUTIA *minutia;
 
    print2log("\nREMOVING HOLES:\n");
 
-   i = 0;
-   /* Foreach minutia remaining in list ... */
-   while(i < minutiae->num){
+   /* Allocate list of minutia indices that upon completion of testing */
+   /* should be removed from the minutiae lists.  Note: That using     */
+   /* "calloc" initializes the list to FALSE.                          */
+   to_remove = (int *)calloc(minutiae->num, sizeof(int));
+   if(to_remove == (int *)NULL){
+      fprintf(stderr, "ERROR : remove_holes : calloc : to_remove\n");
+      return(-612);
+   }
+
+   /* The loop test reads the binary image without editing it, so each */
+   /* minutia can be tested independently against the unedited list    */
+   /* and the survivors compacted in a single pass at the end.         */
+
+   /* Foreach minutia in list ... */
+   for(i = 0; i < minutiae->num; i++){
       /* Assign a temporary pointer. */
       minutia = minutiae->list[i];
       /* If current minutia is a bifurcation ... */
@@ -242,32 +285,25 @@ int remove_holes(MINUTIAE *minutiae,
 
             print2log("%d,%d RM\n", minutia->x, minutia->y);
 
-            /* Then remove the minutia from list. */
-            if((ret = remove_minutia(i, minutiae))){
-               /* Return error code. */
-               return(ret);
-            }
-            /* No need to advance because next minutia has "slid" */
-            /* into position pointed to by 'i'.                   */
-         }
-         /* If the minutia is NOT on a loop... */
-         else if (ret == FALSE){
-            /* Simply advance to next minutia in the list. */
-            i++;
+            /* Then flag the minutia to be removed from the list. */
+            to_remove[i] = TRUE;
          }
          /* Otherwise, an ERROR occurred while looking for loop. */
-         else{
+         else if (ret != FALSE){
+            /* Deallocate flag list. */
+            free(to_remove);
             /* Return error code. */
             return(ret);
          }
       }
-      /* Otherwise, the current minutia is a ridge-ending... */
-      else{
-         /* Advance to next minutia in the list. */
-         i++;
-      }
    }
 
+   /* Now remove all minutiae in list that have been flagged for removal. */
+   remove_flagged_minutiae(minutiae, to_remove);
+
+   /* Deallocate flag list. */
+   free(to_remove);
+
    /* Return normally. */
    return(0);
 }
@@ -295,7 +331,7 @@ int remove_hooks(MINUTIAE *minutiae,
                  const LFSPARMS *lfsparms)
 {
    int *to_remove;
-   int i, f, s, ret;
+   int f, s, ret;
    int delta_y, full_ndirs, qtr_ndirs, deltadir, min_deltadir;
    MINUTIA *minutia1, *minutia2;
    double dist;
@@ -472,18 +508,7 @@ int remove_hooks(MINUTIAE *minutiae,
    }/* End primary minutiae loop. */
 
    /* Now remove all minutiae in list that have been flagged for removal. */
-   /* NOTE: Need to remove the minutia from their lists in reverse       */
-   /*       order, otherwise, indices will be off.                       */
-   for(i = minutiae->num-1; i >= 0; i--){
-      /* If the current minutia index is flagged for removal ... */
-      if(to_remove[i]){
-         /* Remove the minutia from the minutiae list. */
-         if((ret = remove_minutia(i, minutiae))){
-            g_free(to_remove);
-            return(ret);
-         }
-      }
-   }
+   remove_flagged_minutiae(minutiae, to_remove);
 
    /* Deallocate flag list. */
    g_free(to_remove);
@@ -541,7 +566,7 @@ int remove_islands_and_lakes(MINUTIAE *minutiae,
                       const LFSPARMS *lfsparms)
 {
    int *to_remove;
-   int i, f, s, ret;
+   int f, s, ret;
    int delta_y, full_ndirs, qtr_ndirs, deltadir, min_deltadir;
    int *loop_x, *loop_y, *loop_ex, *loop_ey, nloop;
    MINUTIA *minutia1, *minutia2;
@@ -739,18 +764,7 @@ int remove_islands_and_lakes(MINUTIAE *minutiae,
    }/* End primary minutiae loop. */
 
    /* Now remove all minutiae in list that have been flagged for removal. */
-   /* NOTE: Need to remove the minutia from their lists in reverse       */
-   /*       order, otherwise, indices will be off.                       */
-   for(i = minutiae->num-1; i >= 0; i--){
-      /* If the current minutia index is flagged for removal ... */
-      if(to_remove[i]){
-         /* Remove the minutia from the minutiae list. */
-         if((ret = remove_minutia(i, minutiae))){
-            g_free(to_remove);
-            return(ret);
-         }
-      }
-   }
+   remove_flagged_minutiae(minutiae, to_remove);
 
    /* Deallocate flag list. */
    g_free(to_remove);
@@ -1268,7 +1282,7 @@ int remove_pointing_invblock_V2(MINUTIAE *minutiae,
                              int *direction_map, const int mw, const int mh,
                              const LFSPARMS *lfsparms)
 {
-   int i, ret;
+   int i, *to_remove;
    int delta_x, delta_y, dmapval;
    int nx, ny, bx, by;
    MINUTIA *minutia;
@@ -1277,12 +1291,24 @@ int remove_pointing_invblock_V2(MINUTIAE *minutiae,
 
    print2log("\nREMOVING MINUTIA POINTING TO INVALID BLOCKS:\n");
 
+   /* Allocate list of minutia indices that upon completion of testing */
+   /* should be removed from the minutiae lists.  Note: That using     */
+   /* "calloc" initializes the list to FALSE.                          */
+   to_remove = (int *)calloc(minutiae->num, sizeof(int));
+   if(to_remove == (int *)NULL){
+      fprintf(stderr,
+              "ERROR : remove_pointing_invblock_V2 : calloc : to_remove\n");
+      return(-630);
+   }
+
    /* Compute factor for converting integer directions to radians. */
    pi_factor = M_PI / (double)lfsparms->num_directions;
 
-   i = 0;
-   /* Foreach minutia remaining in list ... */
-   while(i < minutiae->num){
+   /* The direction map is read-only here, so each minutia is tested */
+   /* independently and the survivors compacted in a single pass.    */
+
+   /* Foreach minutia in list ... */
+   for(i = 0; i < minutiae->num; i++){
       /* Set temporary minutia pointer. */
       minutia = minutiae->list[i];
       /* Convert minutia's direction to radians. */
@@ -1318,18 +1344,17 @@ int remove_pointing_invblock_V2(MINUTIAE *minutiae,
 
          print2log("%d,%d RM\n", minutia->x, minutia->y);
 
-         /* Remove the minutia from the minutiae list. */
-         if((ret = remove_minutia(i, minutiae))){
-            return(ret);
-         }
-         /* No need to advance because next minutia has slid into slot. */
-      }
-      else{
-         /* Advance to next minutia in list. */
-         i++;
+         /* Flag the minutia to be removed from the minutiae list. */
+         to_remove[i] = TRUE;
       }
    }
 
+   /* Now remove all minutiae in list that have been flagged for removal. */
+   remove_flagged_minutiae(minutiae, to_remove);
+
+   /* Deallocate flag list. */
+   free(to_remove);
+
    /* Return normally. */
    return(0);
 }
@@ -1371,10 +1396,9 @@ int remove_perimeter_pts(MINUTIAE *minutiae,
                        unsigned char *bdata, const int iw, const int ih,
                        const LFSPARMS *lfsparms)
 {
-    int i, j, ret, *to_remove;
+    int i, j, *to_remove;
     int *left, *left_up, *left_down;
     int *right, *right_up, *right_down;
-    int removed = 0;
     int left_min, right_max;
 
     if (!lfsparms->remove_perimeter_pts)
@@ -1470,17 +1494,8 @@ int remove_perimeter_pts(MINUTIAE *minutiae,
     free(left);
     free(right);
 
-    for (i = minutiae->num - 1; i >= 0; i--) {
-        /* If the current minutia index is flagged for removal ... */
-        if (to_remove[i]){
-            removed ++;
-            /* Remove the minutia from the minutiae list. */
-            if((ret = remove_minutia(i, minutiae))){
-                free(to_remove);
-                return(ret);
-            }
-        }
-    }
+    /* Remove all minutiae that have been flagged for removal. */
+    remove_flagged_minutiae(minutiae, to_remove);
 
     free(to_remove);
 
@@ -1512,7 +1527,7 @@ int remove_overlaps(MINUTIAE *minutiae,
                     const LFSPARMS *lfsparms)
 {
    int *to_remove;
-   int i, f, s, ret;
+   int f, s;
    int delta_y, full_ndirs, qtr_ndirs, deltadir, min_deltadir;
    MINUTIA *minutia1, *minutia2;
    double dist;
@@ -1697,18 +1712,7 @@ int remove_overlaps(MINUTIAE *minutiae,
    }/* End primary minutiae loop. */
 
    /* Now remove all minutiae in list that have been flagged for removal. */
-   /* NOTE: Need to remove the minutia from their lists in reverse       */
-   /*       order, otherwise, indices will be off.                       */
-   for(i = minutiae->num-1; i >= 0; i--){
-      /* If the current minutia index is flagged for removal ... */
-      if(to_remove[i]){
-         /* Remove the minutia from the minutiae list. */
-         if((ret = remove_minutia(i, minutiae))){
-            g_free(to_remove);
-            return(ret);
-         }
-      }
-   }
+   remove_flagged_minutiae(minutiae, to_remove);
 
    /* Deallocate flag list. */
    g_free(to_remove);
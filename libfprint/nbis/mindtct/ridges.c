@@ -229,7 +229,7 @@ int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
    int ret, second, last_nbr;
    MINUTIA *minutia1, *minutia2;
    int *nbr_list, nnbrs;
-   double *nbr_sqr_dists, xdist, xdist2;
+   double *nbr_sqr_dists, xdist, xdist2, ydist, ydist2;
 
    /* Allocate list of neighbor minutiae indices. */
    nbr_list = (int *)g_malloc(max_nbrs * sizeof(int));
@@ -245,6 +245,9 @@ int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
    /* Compute location of maximum last stored neighbor. */
    last_nbr = max_nbrs - 1;
 
+   /* Assign the primary minutia pointer (invariant over the scan). */
+   minutia1 = minutiae->list[first];
+
    /* While minutia (in sorted order) still remian for processing ... */
    /* NOTE: The minutia in the input list have been sorted on X and   */
    /* then on Y.  So, the neighbors are selected according to those   */
@@ -252,8 +255,7 @@ int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
    /* then subsequently those that lie in complete pixel columns to   */
    /* the right of the primary minutia.                               */
    while(second < minutiae->num){
-      /* Assign temporary minutia pointers. */
-      minutia1 = minutiae->list[first];
+      /* Assign temporary minutia pointer. */
       minutia2 = minutiae->list[second];
 
       /* Compute squared distance between minutiae along x-axis. */
@@ -264,6 +266,18 @@ int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
       /* secondary is smaller than maximum neighbor distance stored ...  */
       if((nnbrs < max_nbrs) ||
          (xdist2 < nbr_sqr_dists[last_nbr])){
+         /* The y-distance alone can also disqualify the candidate.      */
+         /* Unlike the x-distance it does not grow monotonically along   */
+         /* the sorted list, so a large value only skips this candidate  */
+         /* rather than ending the search.                               */
+         ydist = minutia2->y - minutia1->y;
+         ydist2 = ydist * ydist;
+         if((nnbrs == max_nbrs) &&
+            (ydist2 >= nbr_sqr_dists[last_nbr])){
+            /* Bump to next secondary minutia. */
+            second++;
+            continue;
+         }
          /* Append or insert the new neighbor into the neighbor lists. */
          if((ret = update_nbr_dists(nbr_list, nbr_sqr_dists, &nnbrs, max_nbrs,
                           first, second, minutiae))){
@@ -57,6 +57,7 @@ of the software.
                ROUTINES:
                         sort_indices_int_inc()
                         sort_indices_double_inc()
+                        radix_sort_int_inc_2()
                         bubble_sort_int_inc_2()
                         bubble_sort_double_inc_2()
                         bubble_sort_double_dec_2()
@@ -64,6 +65,7 @@ of the software.
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <lfs.h>
 
 /*************************************************************************
@@ -95,7 +97,7 @@ int sort_indices_int_inc(int **optr, int *ranks, const int num)
       order[i] = i;
 
    /* Sort the indecies into rank order. */
-   bubble_sort_int_inc_2(ranks, order, num);
+   radix_sort_int_inc_2(ranks, order, num);
 
    /* Set output pointer to the resulting order of sorted indices. */
    *optr = order;
@@ -121,6 +123,99 @@ int sort_indices_int_inc(int **optr, int *ranks, const int num)
       Negative  - system error
 **************************************************************************/
 
+/*************************************************************************
+**************************************************************************
+#cat: radix_sort_int_inc_2 - Takes a list of integer ranks and a corresponding
+#cat:                        list of integer attributes, and sorts the ranks
+#cat:                        into increasing order moving the attributes
+#cat:                        correspondingly.  Uses a stable LSD radix sort
+#cat:                        on the bytes of the ranks, so the cost is linear
+#cat:                        in the length of the list rather than quadratic
+#cat:                        as with the bubble sort.  Lists containing
+#cat:                        negative ranks fall back to the bubble sort.
+
+   Input:
+      ranks - list of integers to be sorted
+      items - list of corresponding integer attributes
+      len   - number of items in list
+   Output:
+      ranks - list of integers sorted in increasing order
+      items - list of attributes in corresponding sorted order
+**************************************************************************/
+void radix_sort_int_inc_2(int *ranks, int *items, const int len)
+{
+   int *trank, *titem;
+   int *srank, *sitem, *drank, *ditem, *tptr;
+   int count[257];
+   int maxrank;
+   int npasses, pass, shift;
+   int i;
+
+   if(len < 2)
+      return;
+
+   /* Determine the largest rank, so that byte passes over leading   */
+   /* zero bytes can be skipped.  The keys sorted through here are   */
+   /* pixel offsets and qualities, so they are expected to be        */
+   /* non-negative; if a negative rank does show up, play it safe    */
+   /* and use the comparison sort.                                   */
+   maxrank = ranks[0];
+   for(i = 1; i < len; i++){
+      if(ranks[i] < 0){
+         bubble_sort_int_inc_2(ranks, items, len);
+         return;
+      }
+      if(ranks[i] > maxrank)
+         maxrank = ranks[i];
+   }
+
+   npasses = 1;
+   while((npasses < (int)sizeof(int)) && (maxrank >> (npasses * 8)))
+      npasses++;
+
+   /* Allocate the ping-pong buffers. */
+   trank = (int *)g_malloc(len * sizeof(int));
+   titem = (int *)g_malloc(len * sizeof(int));
+
+   srank = ranks;
+   sitem = items;
+   drank = trank;
+   ditem = titem;
+
+   /* Foreach byte of the ranks, least significant first ... */
+   for(pass = 0; pass < npasses; pass++){
+      shift = pass * 8;
+
+      /* Count the occurrences of each byte value ... */
+      memset(count, 0, sizeof(count));
+      for(i = 0; i < len; i++)
+         count[((srank[i] >> shift) & 0xFF) + 1]++;
+      /* ... turn the counts into start offsets ... */
+      for(i = 1; i < 257; i++)
+         count[i] += count[i-1];
+      /* ... and scatter ranks and items into place (stable). */
+      for(i = 0; i < len; i++){
+         int slot = count[(srank[i] >> shift) & 0xFF]++;
+
+         drank[slot] = srank[i];
+         ditem[slot] = sitem[i];
+      }
+
+      tptr = srank; srank = drank; drank = tptr;
+      tptr = sitem; sitem = ditem; ditem = tptr;
+   }
+
+   /* After an odd number of passes the result sits in the temporary */
+   /* buffers; copy it back out. */
+   if(npasses & 1){
+      memcpy(ranks, trank, len * sizeof(int));
+      memcpy(items, titem, len * sizeof(int));
+   }
+
+   g_free(trank);
+   g_free(titem);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: bubble_sort_int_inc_2 - Takes a list of integer ranks and a corresponding
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+#
+# Turn libfprint trace output into per-action latency waterfalls.
+#
+# Build libfprint with -Dtracing=true, run your client with stderr
+# captured, then feed the log through this script:
+#
+#     ./attendance-client 2>trace.log
+#     scripts/trace-waterfall.py trace.log
+#
+# Span begin/end lines with the same name are paired last-in-first-out;
+# marks are single events. Everything between the begin and end of an
+# "action ..." span is printed as one indented waterfall, so a verify
+# shows the image device state changes, USB transfers, minutiae
+# detection and bozorth matching that made up its latency.
+
+import re
+import sys
+
+LINE_RE = re.compile(r"^fp-trace ([BEM]) (\d+) (.*)$")
+
+
+def parse(stream):
+    events = []
+    for line in stream:
+        m = LINE_RE.match(line.strip())
+        if m:
+            events.append((m.group(1), int(m.group(2)), m.group(3)))
+    return events
+
+
+def pair_spans(events):
+    """Return (spans, marks); spans are (begin_us, end_us, name)."""
+    spans = []
+    marks = []
+    open_spans = {}
+    for kind, ts, name in events:
+        if kind == "B":
+            open_spans.setdefault(name, []).append(ts)
+        elif kind == "E":
+            stack = open_spans.get(name)
+            if stack:
+                spans.append((stack.pop(), ts, name))
+            else:
+                print("warning: unmatched span end: %s" % name, file=sys.stderr)
+        else:
+            marks.append((ts, name))
+    for name, stack in open_spans.items():
+        for ts in stack:
+            print("warning: span never ended: %s" % name, file=sys.stderr)
+    spans.sort()
+    return spans, marks
+
+
+def print_waterfall(action, spans, marks):
+    begin, end, name = action
+    total_ms = (end - begin) / 1000.0
+    print("%s  (%.1f ms)" % (name, total_ms))
+
+    rows = [(b, e, n, False) for b, e, n in spans
+            if b >= begin and e <= end and (b, e, n) != action]
+    rows += [(t, t, n, True) for t, n in marks if begin <= t <= end]
+    rows.sort()
+
+    for b, e, n, is_mark in rows:
+        off_ms = (b - begin) / 1000.0
+        if is_mark:
+            print("  %8.1f ms            * %s" % (off_ms, n))
+        else:
+            dur_ms = (e - b) / 1000.0
+            print("  %8.1f ms %8.1f ms  %s" % (off_ms, dur_ms, n))
+    print()
+
+
+def main():
+    if len(sys.argv) > 2 or sys.argv[1:] in (["-h"], ["--help"]):
+        print("usage: trace-waterfall.py [trace-log]", file=sys.stderr)
+        return 1
+
+    stream = open(sys.argv[1]) if len(sys.argv) == 2 else sys.stdin
+    spans, marks = pair_spans(parse(stream))
+
+    actions = [s for s in spans if s[2].startswith("action ")]
+    if not actions:
+        print("no action spans found in input", file=sys.stderr)
+        return 1
+
+    for action in actions:
+        print_waterfall(action, spans, marks)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,223 @@
+/*
+ * Synthetic swipe assembly benchmark
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Generates parameterized synthetic swipes (frame count, overlap, speed
+ * drift, sensor noise) over a procedural ridge texture and times
+ * fpi_do_movement_estimation() and fpi_assemble_frames() on them,
+ * reporting throughput as machine-parseable "phase <name> <usecs> us"
+ * lines. Because the true per-frame offsets are known, each workload
+ * also reports the movement estimation error and the grey-level
+ * reconstruction error against the clean texture, so regressions in the
+ * packed difference kernels show up as quality changes, not just timing
+ * changes.
+ *
+ * The repetition count can be overridden with FP_BENCHMARK_ITERATIONS.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "fpi-assembling.h"
+#include "fpi-image.h"
+
+#define DEFAULT_ITERATIONS 100
+
+#define FRAME_WIDTH  128
+#define FRAME_HEIGHT 16
+
+typedef struct
+{
+  const char *name;
+  guint       frames; /* frames per swipe */
+  gint        step;   /* mean vertical advance per frame */
+  gint        drift;  /* max per-frame deviation from step */
+  gint        noise;  /* max absolute grey noise per pixel */
+} workload;
+
+static const workload workloads[] = {
+  { "short-clean", 40, 10, 0, 0 },
+  { "long-clean", 160, 6, 0, 0 },
+  { "noisy", 80, 8, 0, 12 },
+  { "drifting", 80, 8, 3, 12 },
+};
+
+static gint
+get_iterations (void)
+{
+  const char *env = g_getenv ("FP_BENCHMARK_ITERATIONS");
+
+  if (env && atoi (env) > 0)
+    return atoi (env);
+
+  return DEFAULT_ITERATIONS;
+}
+
+static void
+print_phase (const char *name, gint64 start, gint iterations)
+{
+  gint64 elapsed = g_get_monotonic_time () - start;
+
+  g_print ("phase %s %" G_GINT64_FORMAT " us (%.2f us/swipe over %d swipes)\n",
+           name, elapsed, (double) elapsed / iterations, iterations);
+}
+
+static unsigned char
+frame_get_pixel (struct fpi_frame_asmbl_ctx *ctx,
+                 struct fpi_frame           *frame,
+                 unsigned int                x,
+                 unsigned int                y)
+{
+  return frame->data[x + y * ctx->frame_width];
+}
+
+/* A smooth quasi-periodic ridge texture. The phase modulation keeps the
+ * vertical structure aperiodic within the overlap search window, so an
+ * offset estimate can only score well at the true overlap. */
+static guint8 *
+generate_texture (guint height)
+{
+  guint8 *base = g_malloc (FRAME_WIDTH * height);
+
+  for (guint y = 0; y < height; y++)
+    for (guint x = 0; x < FRAME_WIDTH; x++)
+      {
+        double ridges = sin (x * 0.31 + 3.0 * sin (y * 0.045)) *
+                        sin (y * 0.17 + 2.0 * sin (x * 0.021));
+        int v = (int) (127.5 + 120.0 * ridges);
+
+        base[x + y * FRAME_WIDTH] = CLAMP (v, 0, 255);
+      }
+
+  return base;
+}
+
+static void
+run_workload (const workload *w, gint iterations)
+{
+  g_autofree guint8 *base = NULL;
+  g_autofree gint *steps = g_new0 (gint, w->frames);
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x5720c5);
+  g_autoptr(FpImage) img = NULL;
+  g_autofree char *phase_name = NULL;
+  struct fpi_frame_asmbl_ctx ctx = { 0, };
+  GSList *frames = NULL;
+  guint texture_height;
+  gint64 start;
+  guint i, y0;
+  double dy_error, recon_error;
+  guint64 dy_sum = 0, recon_sum = 0, recon_pixels = 0;
+
+  ctx.get_pixel = frame_get_pixel;
+  ctx.frame_width = FRAME_WIDTH;
+  ctx.frame_height = FRAME_HEIGHT;
+  ctx.image_width = FRAME_WIDTH;
+  ctx.packed_8bpp = 1;
+
+  texture_height = FRAME_HEIGHT + w->frames * (w->step + w->drift) + 1;
+  base = generate_texture (texture_height);
+
+  /* Cut the swipe out of the texture, advancing by a possibly drifting
+   * step and overlaying per-pixel sensor noise. */
+  y0 = 0;
+  for (i = 0; i < w->frames; i++)
+    {
+      struct fpi_frame *frame;
+
+      if (i > 0)
+        {
+          steps[i] = w->step;
+          if (w->drift)
+            steps[i] += g_rand_int_range (rand, -w->drift, w->drift + 1);
+          y0 += steps[i];
+        }
+
+      frame = g_malloc0 (sizeof (struct fpi_frame) +
+                         FRAME_WIDTH * FRAME_HEIGHT);
+      for (guint j = 0; j < FRAME_WIDTH * FRAME_HEIGHT; j++)
+        {
+          int v = base[j + y0 * FRAME_WIDTH];
+
+          if (w->noise)
+            v += g_rand_int_range (rand, -w->noise, w->noise + 1);
+          frame->data[j] = CLAMP (v, 0, 255);
+        }
+
+      frames = g_slist_append (frames, frame);
+    }
+
+  start = g_get_monotonic_time ();
+  for (gint it = 0; it < iterations; it++)
+    fpi_do_movement_estimation (&ctx, frames);
+  phase_name = g_strdup_printf ("estimate-%s", w->name);
+  print_phase (phase_name, start, iterations);
+
+  i = 0;
+  for (GSList *l = frames; l != NULL; l = l->next, i++)
+    {
+      struct fpi_frame *frame = l->data;
+
+      if (i > 0)
+        dy_sum += ABS (frame->delta_y - steps[i]);
+    }
+  dy_error = (double) dy_sum / (w->frames - 1);
+
+  start = g_get_monotonic_time ();
+  for (gint it = 0; it < iterations; it++)
+    {
+      g_clear_object (&img);
+      img = fpi_assemble_frames (&ctx, frames);
+    }
+  g_free (phase_name);
+  phase_name = g_strdup_printf ("assemble-%s", w->name);
+  print_phase (phase_name, start, iterations);
+
+  /* The first frame lands at texture row 0, so with perfect offsets the
+   * assembled image reproduces the clean texture row for row. Skip a few
+   * border columns that horizontal jitter can leave unwritten. */
+  for (guint y = 0; y < MIN (img->height, texture_height); y++)
+    for (guint x = 4; x < FRAME_WIDTH - 4; x++)
+      {
+        recon_sum += ABS ((int) img->data[x + y * FRAME_WIDTH] -
+                          (int) base[x + y * FRAME_WIDTH]);
+        recon_pixels++;
+      }
+  recon_error = (double) recon_sum / recon_pixels;
+
+  g_print ("# %s: %u frames, step %d+/-%d, noise +/-%d: "
+           "dy error %.2f px, reconstruction error %.2f grey levels\n",
+           w->name, w->frames, w->step, w->drift, w->noise,
+           dy_error, recon_error);
+
+  g_slist_free_full (frames, g_free);
+}
+
+int
+main (int argc, char **argv)
+{
+  gint iterations = get_iterations ();
+
+  g_print ("# assembling benchmark: %d swipes per workload, %dx%d frames\n",
+           iterations, FRAME_WIDTH, FRAME_HEIGHT);
+
+  for (guint i = 0; i < G_N_ELEMENTS (workloads); i++)
+    run_workload (&workloads[i], iterations);
+
+  return 0;
+}
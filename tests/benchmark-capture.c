@@ -0,0 +1,157 @@
+/*
+ * Driver capture replay benchmark
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Runs one capture against the first available device and reports how
+ * long each phase of the driver hot path took, as machine-parseable
+ * "phase <name> <usecs> us" lines:
+ *
+ *   open    - device activation (driver init SSM)
+ *   capture - frame handling up to the assembled image
+ *   detect  - minutiae detection on the captured image
+ *   close   - device deactivation
+ *
+ * Meant to run under umockdev replay; umockdev-test.py --benchmark
+ * invokes it repeatedly against a driver's recorded capture and
+ * aggregates the phase timings into per-driver throughput numbers.
+ * The detect phase can be repeated with FP_BENCHMARK_ITERATIONS.
+ */
+
+#include <libfprint/fprint.h>
+
+typedef struct
+{
+  GMainLoop *loop;
+  gboolean   ok;
+  GError    *error;
+} DetectData;
+
+static void
+detect_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+  DetectData *data = user_data;
+
+  data->ok = fp_image_detect_minutiae_finish (FP_IMAGE (source), res,
+                                              &data->error);
+  g_main_loop_quit (data->loop);
+}
+
+static gboolean
+detect_minutiae (FpImage *image, GError **error)
+{
+  DetectData data = { NULL, FALSE, NULL };
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  fp_image_detect_minutiae (image, NULL, detect_cb, &data);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+
+  if (!data.ok)
+    g_propagate_error (error, data.error);
+
+  return data.ok;
+}
+
+static gint
+get_iterations (void)
+{
+  const char *env = g_getenv ("FP_BENCHMARK_ITERATIONS");
+
+  if (env && atoi (env) > 0)
+    return atoi (env);
+
+  return 1;
+}
+
+static void
+print_phase (const char *name, gint64 start)
+{
+  g_print ("phase %s %" G_GINT64_FORMAT " us\n",
+           name, g_get_monotonic_time () - start);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr(FpContext) ctx = NULL;
+  g_autoptr(FpImage) image = NULL;
+  g_autoptr(GError) error = NULL;
+  GPtrArray *devices;
+  FpDevice *dev;
+  gint64 start;
+  gint iterations, i;
+
+  ctx = fp_context_new ();
+  devices = fp_context_get_devices (ctx);
+  if (!devices || devices->len == 0)
+    {
+      g_printerr ("No device found, nothing to benchmark\n");
+      return 77;
+    }
+
+  dev = g_ptr_array_index (devices, 0);
+  if (!fp_device_has_feature (dev, FP_DEVICE_FEATURE_CAPTURE))
+    {
+      g_printerr ("Device %s does not support capture\n",
+                  fp_device_get_name (dev));
+      return 77;
+    }
+
+  g_print ("# capture benchmark: %s (%s)\n",
+           fp_device_get_name (dev), fp_device_get_driver (dev));
+
+  start = g_get_monotonic_time ();
+  if (!fp_device_open_sync (dev, NULL, &error))
+    {
+      g_printerr ("Failed to open device: %s\n", error->message);
+      return 1;
+    }
+  print_phase ("open", start);
+
+  start = g_get_monotonic_time ();
+  image = fp_device_capture_sync (dev, TRUE, NULL, &error);
+  if (!image)
+    {
+      g_printerr ("Failed to capture: %s\n", error->message);
+      return 1;
+    }
+  print_phase ("capture", start);
+
+  iterations = get_iterations ();
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      if (!detect_minutiae (image, &error))
+        {
+          g_printerr ("Minutiae detection failed: %s\n", error->message);
+          return 1;
+        }
+    }
+  g_print ("phase detect %" G_GINT64_FORMAT " us\n",
+           (g_get_monotonic_time () - start) / iterations);
+
+  start = g_get_monotonic_time ();
+  if (!fp_device_close_sync (dev, NULL, &error))
+    {
+      g_printerr ("Failed to close device: %s\n", error->message);
+      return 1;
+    }
+  print_phase ("close", start);
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Core library dispatch overhead benchmark
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Drives no-op enroll and verify cycles through FpiDeviceFake and
+ * reports the per-operation cost of fpi-device.c's action plumbing
+ * (GTask setup, action dispatch, queueing, completion idles) as
+ * machine-parseable "phase <name> <usecs> us" lines. The fake driver
+ * completes every action synchronously from the dispatch call, so the
+ * numbers are pure core-library overhead that every real operation
+ * pays on top of its I/O.
+ *
+ * The cycle count can be overridden with FP_BENCHMARK_ITERATIONS.
+ */
+
+#include <libfprint/fprint.h>
+
+#include "fpi-device.h"
+#include "test-device-fake.h"
+
+#define DEFAULT_ITERATIONS 5000
+
+static gint
+get_iterations (void)
+{
+  const char *env = g_getenv ("FP_BENCHMARK_ITERATIONS");
+
+  if (env && atoi (env) > 0)
+    return atoi (env);
+
+  return DEFAULT_ITERATIONS;
+}
+
+static void
+print_phase (const char *name, gint64 start, gint iterations)
+{
+  gint64 elapsed = g_get_monotonic_time () - start;
+
+  g_print ("phase %s %" G_GINT64_FORMAT " us (%.2f us/op over %d ops)\n",
+           name, elapsed, (double) elapsed / iterations, iterations);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr(FpDevice) device = NULL;
+  g_autoptr(FpPrint) enrolled = NULL;
+  g_autoptr(GError) error = NULL;
+  FpiDeviceFake *fake_dev;
+  gint64 start;
+  gint iterations, i;
+
+  device = g_object_new (FPI_TYPE_DEVICE_FAKE, NULL);
+  fake_dev = FPI_DEVICE_FAKE (device);
+  fake_dev->ret_result = FPI_MATCH_SUCCESS;
+
+  if (!fp_device_open_sync (device, NULL, &error))
+    {
+      g_printerr ("Could not open fake device: %s\n", error->message);
+      return 1;
+    }
+
+  iterations = get_iterations ();
+  g_print ("# dispatch benchmark: %d no-op cycles through %s\n",
+           iterations, fp_device_get_driver (device));
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      g_autoptr(FpPrint) print = NULL;
+
+      print = fp_device_enroll_sync (device, fp_print_new (device),
+                                     NULL, NULL, NULL, &error);
+      if (!print)
+        {
+          g_printerr ("Enroll failed: %s\n", error->message);
+          return 1;
+        }
+
+      if (i == 0)
+        enrolled = g_object_ref (print);
+    }
+  print_phase ("enroll", start, iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      gboolean match = FALSE;
+
+      if (!fp_device_verify_sync (device, enrolled, NULL, NULL, NULL,
+                                  &match, NULL, &error))
+        {
+          g_printerr ("Verify failed: %s\n", error->message);
+          return 1;
+        }
+      if (!match)
+        {
+          g_printerr ("Verify unexpectedly did not match\n");
+          return 1;
+        }
+    }
+  print_phase ("verify", start, iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    {
+      if (!fp_device_close_sync (device, NULL, &error) ||
+          !fp_device_open_sync (device, NULL, &error))
+        {
+          g_printerr ("Open/close cycle failed: %s\n", error->message);
+          return 1;
+        }
+    }
+  print_phase ("open-close", start, iterations);
+
+  if (!fp_device_close_sync (device, NULL, &error))
+    {
+      g_printerr ("Could not close fake device: %s\n", error->message);
+      return 1;
+    }
+
+  return 0;
+}
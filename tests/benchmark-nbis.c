@@ -0,0 +1,181 @@
+/*
+ * NBIS pipeline benchmark (mindtct + bozorth3)
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Run with `meson test --benchmark -C <builddir> nbis`.
+ *
+ * Measures the minutiae-detection front end (get_minutiae) and the
+ * bozorth3 matcher over a bundled sensor capture, reporting ns/op and
+ * peak RSS so regressions in detect.c, maps.c and bozorth3.c are caught
+ * before shipping. Iterations can be tuned with FP_BENCHMARK_ITERATIONS.
+ */
+
+#include <cairo.h>
+#include <glib.h>
+#include <nbis.h>
+#include <sys/resource.h>
+
+#include "fp-print-private.h"
+#include "test-config.h"
+
+#define DEFAULT_ITERATIONS 10
+#define WARMUP_ITERATIONS 2
+
+static guint8 *
+load_image_gray (const char *path, gint *width, gint *height)
+{
+  cairo_surface_t *surface;
+  guint8 *gray, *data;
+  gint w, h, stride, x, y;
+  cairo_format_t format;
+
+  surface = cairo_image_surface_create_from_png (path);
+  g_assert (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS);
+
+  w = cairo_image_surface_get_width (surface);
+  h = cairo_image_surface_get_height (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  format = cairo_image_surface_get_format (surface);
+  data = cairo_image_surface_get_data (surface);
+
+  gray = g_malloc (w * h);
+  for (y = 0; y < h; y++)
+    {
+      for (x = 0; x < w; x++)
+        {
+          if (format == CAIRO_FORMAT_A8)
+            gray[y * w + x] = data[y * stride + x];
+          else
+            gray[y * w + x] = data[y * stride + x * 4 + 1]; /* G channel */
+        }
+    }
+
+  cairo_surface_destroy (surface);
+
+  *width = w;
+  *height = h;
+  return gray;
+}
+
+static gint
+get_iterations (void)
+{
+  const char *env = g_getenv ("FP_BENCHMARK_ITERATIONS");
+
+  if (env && atoi (env) > 0)
+    return atoi (env);
+
+  return DEFAULT_ITERATIONS;
+}
+
+static glong
+peak_rss_kib (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static void
+run_get_minutiae (const guint8 *image, gint width, gint height)
+{
+  struct fp_minutiae *minutiae = NULL;
+  g_autofree gint *direction_map = NULL;
+  g_autofree gint *low_contrast_map = NULL;
+  g_autofree gint *low_flow_map = NULL;
+  g_autofree gint *high_curve_map = NULL;
+  g_autofree gint *quality_map = NULL;
+  g_autofree guchar *bdata = NULL;
+  g_autofree guint8 *copy = NULL;
+  gint map_w, map_h, bw, bh, bd, r;
+
+  /* get_minutiae works on a private copy like the detection task does. */
+  copy = g_memdup (image, width * height);
+
+  r = get_minutiae (&minutiae, &quality_map, &direction_map,
+                    &low_contrast_map, &low_flow_map, &high_curve_map,
+                    &map_w, &map_h, &bdata, &bw, &bh, &bd,
+                    copy, width, height, 8,
+                    500.0 / 25.4, &g_lfsparms_V2, NULL);
+  g_assert (r == 0);
+
+  free_minutiae (minutiae);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autofree gchar *image_path = NULL;
+  g_autofree guint8 *image = NULL;
+  g_autoptr(FpImage) fp_image = NULL;
+  g_autoptr(FpPrint) print = NULL;
+  g_autoptr(GError) error = NULL;
+  struct xyt_struct *xyt;
+  gint width, height, iterations, i, score = 0;
+  gint64 start, elapsed;
+
+  image_path = g_build_filename (SOURCE_ROOT, "tests", "vfs5011",
+                                 "capture.png", NULL);
+  image = load_image_gray (image_path, &width, &height);
+  iterations = get_iterations ();
+
+  g_print ("# NBIS benchmark: %dx%d capture, %d iterations (+%d warmup)\n",
+           width, height, iterations, WARMUP_ITERATIONS);
+
+  /* mindtct front end */
+  for (i = 0; i < WARMUP_ITERATIONS; i++)
+    run_get_minutiae (image, width, height);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    run_get_minutiae (image, width, height);
+  elapsed = g_get_monotonic_time () - start;
+
+  g_print ("get_minutiae: %" G_GINT64_FORMAT " ns/op\n",
+           (elapsed * 1000) / iterations);
+
+  /* bozorth3 matcher, probe matched against itself */
+  fp_image = fp_image_new (width, height);
+  fp_image->data = g_memdup (image, width * height);
+  fp_image->ppmm = 500.0 / 25.4;
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT, NULL));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+  if (!fpi_print_add_from_image (print, fp_image, &error))
+    {
+      g_print ("Skipping bozorth3 benchmark: %s\n", error->message);
+      return 0;
+    }
+
+  xyt = g_ptr_array_index (print->prints, 0);
+
+  for (i = 0; i < WARMUP_ITERATIONS; i++)
+    score = bozorth_main (xyt, xyt);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    score = bozorth_main (xyt, xyt);
+  elapsed = g_get_monotonic_time () - start;
+
+  g_print ("bozorth_main: %" G_GINT64_FORMAT " ns/op (self-match score %d)\n",
+           (elapsed * 1000) / iterations, score);
+
+  g_print ("peak RSS: %ld KiB\n", peak_rss_kib ());
+
+  return 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * Synthetic template corpus generator for matcher benchmarking
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Produces statistically plausible NBIS xyt templates at configurable
+ * scale, for benchmarking the bozorth3 gallery matcher without access
+ * to real enrollment data. Minutiae counts, spatial clustering and the
+ * position/angle correlation are modelled on typical mindtct output
+ * over 500 dpi touch sensor captures; views of one print are jittered
+ * copies of a base template, like repeated placements of one finger.
+ *
+ * Output is either (or both of):
+ *   --out-dir DIR      one fp_print_serialize() file per print
+ *   --gallery FILE     a single mmap()able gallery, see fp-gallery.c
+ *
+ * Example: generate-gallery --count 50000 --views 3 --gallery big.fpgl
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <math.h>
+#include <nbis.h>
+
+#include "fp-print-private.h"
+#include "fpi-print.h"
+#include "fp-gallery.h"
+
+#define DEFAULT_COUNT 1000
+#define DEFAULT_VIEWS 1
+#define DEFAULT_SEED 42
+#define DEFAULT_WIDTH 256
+#define DEFAULT_HEIGHT 360
+
+/* Matches the cap applied by minutiae_to_xyt(); mindtct rarely finds
+ * more on a touch sensor anyway. */
+#define MAX_GEN_MINUTIAE 150
+
+static gint opt_count = DEFAULT_COUNT;
+static gint opt_views = DEFAULT_VIEWS;
+static gint opt_seed = DEFAULT_SEED;
+static gint opt_width = DEFAULT_WIDTH;
+static gint opt_height = DEFAULT_HEIGHT;
+static gchar *opt_out_dir = NULL;
+static gchar *opt_gallery = NULL;
+
+static const GOptionEntry entries[] = {
+  { "count", 'c', 0, G_OPTION_ARG_INT, &opt_count,
+    "Number of prints to generate", "N" },
+  { "views", 'v', 0, G_OPTION_ARG_INT, &opt_views,
+    "Enrollment views per print", "N" },
+  { "seed", 's', 0, G_OPTION_ARG_INT, &opt_seed,
+    "Random seed, same seed reproduces the corpus", "N" },
+  { "width", 0, 0, G_OPTION_ARG_INT, &opt_width,
+    "Sensor width in 500 dpi pixels", "PX" },
+  { "height", 0, 0, G_OPTION_ARG_INT, &opt_height,
+    "Sensor height in 500 dpi pixels", "PX" },
+  { "out-dir", 'o', 0, G_OPTION_ARG_FILENAME, &opt_out_dir,
+    "Write one serialized print per file into this directory", "DIR" },
+  { "gallery", 'g', 0, G_OPTION_ARG_FILENAME, &opt_gallery,
+    "Write all prints as one mmap()able gallery file", "FILE" },
+  { NULL }
+};
+
+/* Box-Muller; GRand only provides uniform deviates. */
+static gdouble
+rand_gauss (GRand *rng, gdouble mean, gdouble sigma)
+{
+  gdouble u1 = 1.0 - g_rand_double (rng);
+  gdouble u2 = g_rand_double (rng);
+
+  return mean + sigma * sqrt (-2.0 * log (u1)) * cos (2.0 * G_PI * u2);
+}
+
+typedef struct
+{
+  gint x;
+  gint y;
+  gint theta;
+} GenMinutia;
+
+static gint
+cmp_x_y (gconstpointer pa, gconstpointer pb)
+{
+  const GenMinutia *a = pa;
+  const GenMinutia *b = pb;
+
+  if (a->x != b->x)
+    return a->x - b->x;
+
+  return a->y - b->y;
+}
+
+static gint
+wrap_theta (gint theta)
+{
+  while (theta > 180)
+    theta -= 360;
+  while (theta <= -180)
+    theta += 360;
+
+  return theta;
+}
+
+/* Ridge direction at (dx, dy) relative to the core of a loop-like
+ * pattern: roughly tangential around the core, which is what gives
+ * real templates their strong position/angle correlation. */
+static gint
+flow_theta (GRand *rng, gdouble dx, gdouble dy)
+{
+  gdouble tangent = atan2 (dy, dx) * 180.0 / G_PI + 90.0;
+
+  return wrap_theta ((gint) (tangent + rand_gauss (rng, 0, 12.0)));
+}
+
+static GArray *
+generate_base_minutiae (GRand *rng)
+{
+  GArray *base = g_array_new (FALSE, FALSE, sizeof (GenMinutia));
+  gdouble core_x, core_y;
+  gint n, i;
+
+  /* Mean/spread of mindtct minutiae counts over decent captures. */
+  n = (gint) rand_gauss (rng, 38.0, 12.0);
+  n = CLAMP (n, 12, MAX_GEN_MINUTIAE);
+
+  /* The core lands near the middle of the platen, placements offset
+   * it; minutiae cluster around it with density falling off. */
+  core_x = opt_width / 2.0 + rand_gauss (rng, 0, opt_width / 10.0);
+  core_y = opt_height / 2.0 + rand_gauss (rng, 0, opt_height / 10.0);
+
+  for (i = 0; i < n; i++)
+    {
+      GenMinutia m;
+      gdouble dx = rand_gauss (rng, 0, opt_width / 4.5);
+      gdouble dy = rand_gauss (rng, 0, opt_height / 4.5);
+
+      m.x = CLAMP ((gint) (core_x + dx), 4, opt_width - 5);
+      m.y = CLAMP ((gint) (core_y + dy), 4, opt_height - 5);
+      m.theta = flow_theta (rng, dx, dy);
+      g_array_append_val (base, m);
+    }
+
+  return base;
+}
+
+/* One placement of the finger: the base template translated and
+ * rotated a little, with some minutiae missed and a few spurious
+ * detections added, as repeated captures of one finger would be. */
+static struct xyt_struct *
+generate_view (GRand *rng, GArray *base)
+{
+  struct xyt_struct *xyt = g_new0 (struct xyt_struct, 1);
+  g_autoptr(GArray) view = g_array_new (FALSE, FALSE, sizeof (GenMinutia));
+  gdouble rot = rand_gauss (rng, 0, 6.0) * G_PI / 180.0;
+  gdouble tx = rand_gauss (rng, 0, 8.0);
+  gdouble ty = rand_gauss (rng, 0, 8.0);
+  gdouble cx = opt_width / 2.0;
+  gdouble cy = opt_height / 2.0;
+  guint i, n_spurious;
+
+  for (i = 0; i < base->len; i++)
+    {
+      GenMinutia m = g_array_index (base, GenMinutia, i);
+      gdouble dx = m.x - cx;
+      gdouble dy = m.y - cy;
+      GenMinutia out;
+
+      /* ~15% of minutiae are missed on any given placement. */
+      if (g_rand_double (rng) < 0.15)
+        continue;
+
+      out.x = (gint) (cx + dx * cos (rot) - dy * sin (rot) + tx +
+                      rand_gauss (rng, 0, 1.5));
+      out.y = (gint) (cy + dx * sin (rot) + dy * cos (rot) + ty +
+                      rand_gauss (rng, 0, 1.5));
+      out.theta = wrap_theta (m.theta + (gint) (rot * 180.0 / G_PI) +
+                              g_rand_int_range (rng, -4, 5));
+
+      if (out.x < 0 || out.x >= opt_width ||
+          out.y < 0 || out.y >= opt_height)
+        continue;
+
+      g_array_append_val (view, out);
+    }
+
+  n_spurious = g_rand_int_range (rng, 0, 5);
+  for (i = 0; i < n_spurious && view->len < MAX_GEN_MINUTIAE; i++)
+    {
+      GenMinutia out;
+
+      out.x = g_rand_int_range (rng, 0, opt_width);
+      out.y = g_rand_int_range (rng, 0, opt_height);
+      out.theta = g_rand_int_range (rng, -179, 181);
+      g_array_append_val (view, out);
+    }
+
+  /* minutiae_to_xyt() emits templates sorted by x then y. */
+  g_array_sort (view, cmp_x_y);
+
+  xyt->nrows = MIN (view->len, MAX_GEN_MINUTIAE);
+  for (i = 0; i < (guint) xyt->nrows; i++)
+    {
+      GenMinutia *m = &g_array_index (view, GenMinutia, i);
+
+      xyt->xcol[i] = m->x;
+      xyt->ycol[i] = m->y;
+      xyt->thetacol[i] = m->theta;
+    }
+
+  return xyt;
+}
+
+static FpPrint *
+generate_print (GRand *rng, gint index)
+{
+  g_autoptr(GArray) base = NULL;
+  g_autofree gchar *username = NULL;
+  FpPrint *print;
+  gint view;
+
+  username = g_strdup_printf ("user%05d", index);
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT,
+                                           "driver", "synthetic",
+                                           "device-id", "0",
+                                           "username", username,
+                                           "finger", FP_FINGER_RIGHT_INDEX,
+                                           NULL));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+
+  base = generate_base_minutiae (rng);
+  for (view = 0; view < opt_views; view++)
+    g_ptr_array_add (print->prints, generate_view (rng, base));
+
+  return print;
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GPtrArray) prints = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GRand) rng = NULL;
+  gint i;
+
+  context = g_option_context_new ("- generate a synthetic template corpus");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  if (!opt_out_dir && !opt_gallery)
+    {
+      g_printerr ("At least one of --out-dir or --gallery is required\n");
+      return 1;
+    }
+
+  if (opt_count < 1 || opt_views < 1 ||
+      opt_width < 32 || opt_height < 32)
+    {
+      g_printerr ("Invalid corpus dimensions\n");
+      return 1;
+    }
+
+  if (opt_out_dir && g_mkdir_with_parents (opt_out_dir, 0755) != 0)
+    {
+      g_printerr ("Cannot create %s\n", opt_out_dir);
+      return 1;
+    }
+
+  rng = g_rand_new_with_seed (opt_seed);
+  prints = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < opt_count; i++)
+    {
+      FpPrint *print = generate_print (rng, i);
+
+      if (opt_out_dir)
+        {
+          g_autofree gchar *path = NULL;
+          g_autofree guchar *data = NULL;
+          gsize length;
+
+          if (!fp_print_serialize (print, &data, &length, &error))
+            {
+              g_printerr ("Serializing print %d failed: %s\n",
+                          i, error->message);
+              return 1;
+            }
+
+          path = g_strdup_printf ("%s/%05d.print", opt_out_dir, i);
+          if (!g_file_set_contents (path, (const gchar *) data, length,
+                                    &error))
+            {
+              g_printerr ("Writing %s failed: %s\n", path, error->message);
+              return 1;
+            }
+        }
+
+      g_ptr_array_add (prints, print);
+    }
+
+  if (opt_gallery)
+    {
+      if (!fp_gallery_write_to_file (prints, opt_gallery, &error))
+        {
+          g_printerr ("Writing gallery %s failed: %s\n",
+                      opt_gallery, error->message);
+          return 1;
+        }
+    }
+
+  g_print ("Generated %d prints with %d view(s) each (seed %d)\n",
+           opt_count, opt_views, opt_seed);
+
+  return 0;
+}
@@ -0,0 +1,409 @@
+/*
+ * FpGallery unit tests
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib/gstdio.h>
+#include <nbis.h>
+
+#include "fp-print-private.h"
+#include "fpi-print.h"
+#include "fp-gallery.h"
+
+/* Mirrors the layout in fp-gallery.c: 4 byte magic plus three guint32
+ * fields, followed by the per-print offset table. */
+#define GALLERY_HEADER_SIZE 16
+
+/* A deterministic packed view. Five minutiae keep 2 + 5 * 3 * 2 bytes
+ * per view, a 4 byte multiple, so written payloads carry no trailing
+ * padding and any truncation cuts into real data. */
+static struct xyt_struct *
+make_view (guint seed)
+{
+  struct xyt_struct *xyt = g_new0 (struct xyt_struct, 1);
+  gint i;
+
+  xyt->nrows = 5;
+  for (i = 0; i < xyt->nrows; i++)
+    {
+      xyt->xcol[i] = 10 + 31 * i + (seed * 7) % 50;
+      xyt->ycol[i] = 20 + 23 * i + (seed * 13) % 50;
+      xyt->thetacol[i] = ((seed + i) * 37) % 180 - 90;
+    }
+
+  return xyt;
+}
+
+static FpPrint *
+make_print (guint seed,
+            guint n_views)
+{
+  g_autofree gchar *username = g_strdup_printf ("user%03u", seed);
+  FpPrint *print;
+  guint i;
+
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT,
+                                           "driver", "synthetic",
+                                           "device-id", "0",
+                                           "username", username,
+                                           "finger", FP_FINGER_RIGHT_INDEX,
+                                           NULL));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+
+  for (i = 0; i < n_views; i++)
+    g_ptr_array_add (print->prints, make_view (seed * 100 + i));
+
+  return print;
+}
+
+static GPtrArray *
+make_prints (guint count,
+             guint n_views)
+{
+  GPtrArray *prints = g_ptr_array_new_with_free_func (g_object_unref);
+  guint i;
+
+  for (i = 0; i < count; i++)
+    g_ptr_array_add (prints, make_print (i, n_views));
+
+  return prints;
+}
+
+static void
+assert_views_equal (FpPrint *expected,
+                    FpPrint *loaded)
+{
+  guint i;
+  gint k;
+
+  g_assert_cmpuint (loaded->prints->len, ==, expected->prints->len);
+
+  for (i = 0; i < expected->prints->len; i++)
+    {
+      struct xyt_struct *exp = g_ptr_array_index (expected->prints, i);
+      struct xyt_struct *got = g_ptr_array_index (loaded->prints, i);
+
+      g_assert_cmpint (got->nrows, ==, exp->nrows);
+      for (k = 0; k < exp->nrows; k++)
+        {
+          g_assert_cmpint (got->xcol[k], ==, exp->xcol[k]);
+          g_assert_cmpint (got->ycol[k], ==, exp->ycol[k]);
+          g_assert_cmpint (got->thetacol[k], ==, exp->thetacol[k]);
+        }
+    }
+}
+
+static gchar *
+make_gallery_path (void)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *dir = NULL;
+
+  dir = g_dir_make_tmp ("fp-gallery-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  return g_build_filename (dir, "test.fpgl", NULL);
+}
+
+static void
+delete_gallery_path (gchar *path)
+{
+  g_autofree gchar *dir = g_path_get_dirname (path);
+
+  g_unlink (path);
+  g_rmdir (dir);
+  g_free (path);
+}
+
+static void
+assert_gallery_invalid (const gchar *path)
+{
+  g_autoptr(FpGallery) gallery = NULL;
+  g_autoptr(GError) error = NULL;
+
+  gallery = fp_gallery_new_for_file (path, &error);
+  g_assert_null (gallery);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+}
+
+static void
+test_gallery_round_trip (void)
+{
+  g_autofree gchar *path = make_gallery_path ();
+  g_autoptr(GPtrArray) prints = make_prints (3, 2);
+  g_autoptr(FpGallery) gallery = NULL;
+  g_autoptr(GError) error = NULL;
+  GPtrArray *loaded;
+  guint i;
+
+  g_assert_true (fp_gallery_write_to_file (prints, path, &error));
+  g_assert_no_error (error);
+
+  gallery = fp_gallery_new_for_file (path, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (gallery);
+  g_assert_cmpuint (fp_gallery_get_size (gallery), ==, prints->len);
+
+  loaded = fp_gallery_get_prints (gallery);
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *expected = g_ptr_array_index (prints, i);
+      FpPrint *got = g_ptr_array_index (loaded, i);
+
+      g_assert_cmpstr (fp_print_get_username (got), ==,
+                       fp_print_get_username (expected));
+      g_assert_cmpint (fp_print_get_finger (got), ==,
+                       fp_print_get_finger (expected));
+      assert_views_equal (expected, got);
+    }
+
+  delete_gallery_path (g_steal_pointer (&path));
+}
+
+static void
+test_gallery_truncated (void)
+{
+  g_autofree gchar *path = make_gallery_path ();
+  g_autoptr(GPtrArray) prints = make_prints (3, 1);
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *data = NULL;
+  gsize length;
+  /* Inside the header, inside the offset table, inside the last
+   * payload; every one must be rejected, not parsed short. */
+  gsize cut_points[] = { GALLERY_HEADER_SIZE - 4, GALLERY_HEADER_SIZE + 6, 0 };
+  guint i;
+
+  g_assert_true (fp_gallery_write_to_file (prints, path, &error));
+  g_assert_no_error (error);
+
+  g_assert_true (g_file_get_contents (path, &data, &length, &error));
+  g_assert_no_error (error);
+  cut_points[G_N_ELEMENTS (cut_points) - 1] = length - 1;
+
+  for (i = 0; i < G_N_ELEMENTS (cut_points); i++)
+    {
+      g_assert_true (g_file_set_contents (path, data, cut_points[i], &error));
+      g_assert_no_error (error);
+      assert_gallery_invalid (path);
+    }
+
+  delete_gallery_path (g_steal_pointer (&path));
+}
+
+static void
+test_gallery_corrupt_offset (void)
+{
+  g_autofree gchar *path = make_gallery_path ();
+  g_autoptr(GPtrArray) prints = make_prints (3, 1);
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *data = NULL;
+  guint32 *offsets;
+  guint32 saved;
+  gsize length;
+
+  g_assert_true (fp_gallery_write_to_file (prints, path, &error));
+  g_assert_no_error (error);
+
+  g_assert_true (g_file_get_contents (path, &data, &length, &error));
+  g_assert_no_error (error);
+  offsets = (guint32 *) (data + GALLERY_HEADER_SIZE);
+  saved = offsets[1];
+
+  /* An entry offset that is not 4 byte aligned. */
+  offsets[1] = saved + 2;
+  g_assert_true (g_file_set_contents (path, data, length, &error));
+  g_assert_no_error (error);
+  assert_gallery_invalid (path);
+
+  /* An entry offset pointing past the end of the file. */
+  offsets[1] = length;
+  g_assert_true (g_file_set_contents (path, data, length, &error));
+  g_assert_no_error (error);
+  assert_gallery_invalid (path);
+
+  /* Restoring the offset makes the file load again. */
+  offsets[1] = saved;
+  g_assert_true (g_file_set_contents (path, data, length, &error));
+  g_assert_no_error (error);
+  {
+    g_autoptr(FpGallery) gallery = fp_gallery_new_for_file (path, &error);
+
+    g_assert_no_error (error);
+    g_assert_nonnull (gallery);
+  }
+
+  delete_gallery_path (g_steal_pointer (&path));
+}
+
+static void
+test_gallery_compressed_round_trip (void)
+{
+  g_autofree gchar *path = make_gallery_path ();
+  g_autoptr(GPtrArray) prints = make_prints (3, 2);
+  g_autoptr(FpGallery) gallery = NULL;
+  g_autoptr(GError) error = NULL;
+  GPtrArray *loaded;
+  guint i;
+
+  g_assert_true (fp_gallery_write_to_file_full (prints, path,
+                                                FP_GALLERY_WRITE_COMPRESS,
+                                                &error));
+  g_assert_no_error (error);
+
+  gallery = fp_gallery_new_for_file (path, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (gallery);
+  g_assert_cmpuint (fp_gallery_get_size (gallery), ==, prints->len);
+
+  loaded = fp_gallery_get_prints (gallery);
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *expected = g_ptr_array_index (prints, i);
+      FpPrint *got = g_ptr_array_index (loaded, i);
+
+      g_assert_cmpstr (fp_print_get_username (got), ==,
+                       fp_print_get_username (expected));
+
+      /* The payload stays compressed until the views are needed. */
+      fpi_print_ensure_views (got);
+      assert_views_equal (expected, got);
+    }
+
+  delete_gallery_path (g_steal_pointer (&path));
+}
+
+static void
+test_gallery_compressed_size_mismatch (void)
+{
+  g_autofree gchar *path = make_gallery_path ();
+  g_autoptr(GPtrArray) prints = make_prints (1, 1);
+  g_autoptr(FpGallery) gallery = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *data = NULL;
+  guint32 *raw_size;
+  guint32 entry;
+  gsize length;
+  FpPrint *got;
+
+  g_assert_true (fp_gallery_write_to_file_full (prints, path,
+                                                FP_GALLERY_WRITE_COMPRESS,
+                                                &error));
+  g_assert_no_error (error);
+
+  /* Grow the recorded expanded size so the payload inflates short of
+   * it. The version 4 entry starts with n_views, payload and
+   * payload_size; raw_size is the fourth guint32. */
+  g_assert_true (g_file_get_contents (path, &data, &length, &error));
+  g_assert_no_error (error);
+  entry = ((guint32 *) (data + GALLERY_HEADER_SIZE))[0];
+  raw_size = (guint32 *) (data + entry + 3 * sizeof (guint32));
+  *raw_size += 4;
+  g_assert_true (g_file_set_contents (path, data, length, &error));
+  g_assert_no_error (error);
+
+  /* The metadata still parses; the damage only shows when the payload
+   * is inflated, and must yield empty views rather than a crash. */
+  gallery = fp_gallery_new_for_file (path, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (gallery);
+
+  got = g_ptr_array_index (fp_gallery_get_prints (gallery), 0);
+  g_test_expect_message ("libfprint-gallery", G_LOG_LEVEL_WARNING,
+                         "*expanded to*");
+  g_test_expect_message ("libfprint-gallery", G_LOG_LEVEL_WARNING,
+                         "*is malformed*");
+  fpi_print_ensure_views (got);
+  g_test_assert_expected_messages ();
+
+  g_assert_cmpuint (got->prints->len, ==, 1);
+  g_assert_cmpint (((struct xyt_struct *)
+                    g_ptr_array_index (got->prints, 0))->nrows, ==, 0);
+
+  delete_gallery_path (g_steal_pointer (&path));
+}
+
+static void
+test_gallery_compressed_cache_eviction (void)
+{
+  g_autofree gchar *path = make_gallery_path ();
+  g_autoptr(GPtrArray) prints = NULL;
+  g_autoptr(FpGallery) gallery = NULL;
+  g_autoptr(GError) error = NULL;
+  struct xyt_struct *first, *second, *again;
+  GPtrArray *loaded;
+  guint i;
+
+  /* Three prints sharing one payload plus a distinct one; with
+   * FP_GALLERY_CACHE=1 (set in main, the capacity latches once per
+   * process) inflating the distinct payload evicts the shared one. */
+  prints = g_ptr_array_new_with_free_func (g_object_unref);
+  for (i = 0; i < 3; i++)
+    g_ptr_array_add (prints, make_print (0, 1));
+  g_ptr_array_add (prints, make_print (7, 1));
+
+  g_assert_true (fp_gallery_write_to_file_full (prints, path,
+                                                FP_GALLERY_WRITE_COMPRESS,
+                                                &error));
+  g_assert_no_error (error);
+
+  gallery = fp_gallery_new_for_file (path, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (gallery);
+  loaded = fp_gallery_get_prints (gallery);
+
+  /* While cached, prints sharing a payload share one conversion. */
+  fpi_print_ensure_views (g_ptr_array_index (loaded, 0));
+  fpi_print_ensure_views (g_ptr_array_index (loaded, 1));
+  first = g_ptr_array_index (((FpPrint *) g_ptr_array_index (loaded, 0))->prints, 0);
+  second = g_ptr_array_index (((FpPrint *) g_ptr_array_index (loaded, 1))->prints, 0);
+  g_assert_true (first == second);
+
+  /* Inflating the other payload evicts the shared one, so the third
+   * print gets a fresh conversion with the same content; the evicted
+   * views stay pinned by the prints already holding them. */
+  fpi_print_ensure_views (g_ptr_array_index (loaded, 3));
+  fpi_print_ensure_views (g_ptr_array_index (loaded, 2));
+  again = g_ptr_array_index (((FpPrint *) g_ptr_array_index (loaded, 2))->prints, 0);
+  g_assert_true (again != first);
+  assert_views_equal (g_ptr_array_index (loaded, 0),
+                      g_ptr_array_index (loaded, 2));
+  g_assert_cmpint (first->nrows, ==, 5);
+
+  delete_gallery_path (g_steal_pointer (&path));
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  /* Must be set before any gallery is used, see
+   * test_gallery_compressed_cache_eviction(). */
+  g_setenv ("FP_GALLERY_CACHE", "1", TRUE);
+
+  g_test_add_func ("/gallery/round_trip", test_gallery_round_trip);
+  g_test_add_func ("/gallery/truncated", test_gallery_truncated);
+  g_test_add_func ("/gallery/corrupt_offset", test_gallery_corrupt_offset);
+  g_test_add_func ("/gallery/compressed/round_trip",
+                   test_gallery_compressed_round_trip);
+  g_test_add_func ("/gallery/compressed/size_mismatch",
+                   test_gallery_compressed_size_mismatch);
+  g_test_add_func ("/gallery/compressed/cache_eviction",
+                   test_gallery_compressed_cache_eviction);
+
+  return g_test_run ();
+}
@@ -0,0 +1,164 @@
+/*
+ * FpPrint unit tests
+ * Copyright (C) 2026 The libfprint Development Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <nbis.h>
+
+#include "fp-print-private.h"
+#include "fpi-print.h"
+
+static struct xyt_struct *
+make_view (guint seed)
+{
+  struct xyt_struct *xyt = g_new0 (struct xyt_struct, 1);
+  gint i;
+
+  xyt->nrows = 7;
+  for (i = 0; i < xyt->nrows; i++)
+    {
+      xyt->xcol[i] = 10 + 29 * i + (seed * 7) % 40;
+      xyt->ycol[i] = 15 + 21 * i + (seed * 11) % 40;
+      xyt->thetacol[i] = ((seed + i) * 43) % 360 - 180;
+    }
+
+  return xyt;
+}
+
+static FpPrint *
+make_nbis_print (void)
+{
+  g_autoptr(GDate) date = NULL;
+  FpPrint *print;
+  guint i;
+
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT,
+                                           "driver", "synthetic",
+                                           "device-id", "0",
+                                           NULL));
+  fpi_print_set_type (print, FPI_PRINT_NBIS);
+  fp_print_set_finger (print, FP_FINGER_LEFT_THUMB);
+  fp_print_set_username (print, "testuser");
+  fp_print_set_description (print, "compact round trip");
+
+  date = g_date_new_dmy (27, 8, 2026);
+  fp_print_set_enroll_date (print, date);
+
+  for (i = 0; i < 3; i++)
+    g_ptr_array_add (print->prints, make_view (i));
+
+  return print;
+}
+
+static void
+test_print_compact_round_trip (void)
+{
+  g_autoptr(FpPrint) print = make_nbis_print ();
+  g_autoptr(FpPrint) loaded = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree guchar *data = NULL;
+  gsize length;
+
+  g_assert_true (fp_print_serialize_compact (print, &data, &length, &error));
+  g_assert_no_error (error);
+
+  loaded = fp_print_deserialize_compact (data, length, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (loaded);
+
+  g_assert_cmpstr (fp_print_get_driver (loaded), ==,
+                   fp_print_get_driver (print));
+  g_assert_cmpstr (fp_print_get_device_id (loaded), ==,
+                   fp_print_get_device_id (print));
+  g_assert_cmpint (fp_print_get_finger (loaded), ==,
+                   fp_print_get_finger (print));
+  g_assert_cmpstr (fp_print_get_username (loaded), ==,
+                   fp_print_get_username (print));
+  g_assert_cmpstr (fp_print_get_description (loaded), ==,
+                   fp_print_get_description (print));
+  g_assert_cmpint (g_date_compare (fp_print_get_enroll_date (loaded),
+                                   fp_print_get_enroll_date (print)), ==, 0);
+
+  /* The encoding is lossless: the restored print compares equal. */
+  g_assert_true (fp_print_equal (print, loaded));
+  g_assert_true (fp_print_equal (loaded, print));
+}
+
+static void
+test_print_compact_malformed (void)
+{
+  g_autoptr(FpPrint) print = make_nbis_print ();
+  g_autoptr(GError) error = NULL;
+  g_autofree guchar *data = NULL;
+  gsize length;
+  gsize i;
+
+  g_assert_true (fp_print_serialize_compact (print, &data, &length, &error));
+  g_assert_no_error (error);
+
+  /* Every field is required, so every truncation must be rejected. */
+  for (i = 0; i < length; i++)
+    {
+      g_autoptr(FpPrint) loaded = NULL;
+      g_autoptr(GError) trunc_error = NULL;
+
+      loaded = fp_print_deserialize_compact (data, i, &trunc_error);
+      g_assert_null (loaded);
+      g_assert_error (trunc_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    }
+
+  /* A wrong magic. */
+  for (i = 0; i < 4; i++)
+    {
+      g_autoptr(FpPrint) loaded = NULL;
+      g_autoptr(GError) byte_error = NULL;
+      guchar saved = data[i];
+
+      data[i] ^= 0xff;
+      loaded = fp_print_deserialize_compact (data, length, &byte_error);
+      g_assert_null (loaded);
+      g_assert_error (byte_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+      data[i] = saved;
+    }
+
+  /* An unsupported print type behind a valid magic. */
+  {
+    g_autoptr(FpPrint) loaded = NULL;
+    g_autoptr(GError) type_error = NULL;
+    guchar saved = data[4];
+
+    data[4] = 0xab;
+    g_test_expect_message ("libfprint-print", G_LOG_LEVEL_WARNING,
+                           "*Invalid print type*");
+    loaded = fp_print_deserialize_compact (data, length, &type_error);
+    g_test_assert_expected_messages ();
+    g_assert_null (loaded);
+    g_assert_error (type_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    data[4] = saved;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/print/compact/round_trip", test_print_compact_round_trip);
+  g_test_add_func ("/print/compact/malformed", test_print_compact_malformed);
+
+  return g_test_run ();
+}
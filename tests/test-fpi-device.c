@@ -26,7 +26,9 @@
 #include "fpi-device.h"
 #include "fpi-compat.h"
 #include "fpi-log.h"
+#include "fpi-ssm.h"
 #include "test-device-fake.h"
+#include "fp-device-private.h"
 #include "fp-print-private.h"
 
 /* gcc 12.0.1 is complaining about dangling pointers in the auto_close* functions */
@@ -3318,6 +3320,140 @@ test_driver_add_timeout_cancelled (void)
   g_assert_null (fake_dev->last_called_function);
 }
 
+enum {
+  PREEMPT_TEST_WORK_0,
+  PREEMPT_TEST_WORK_1,
+  PREEMPT_TEST_WORK_2,
+  PREEMPT_TEST_CLEANUP_0,
+  PREEMPT_TEST_CLEANUP_1,
+  PREEMPT_TEST_N_STATES,
+};
+
+typedef struct
+{
+  gint     work_states;
+  gint     cleanup_states;
+  gint     preempts_in_cleanup;
+  gboolean background_completed;
+  GError  *background_error;
+  gboolean interactive_completed;
+  gboolean interactive_match;
+} PreemptTestData;
+
+static void
+test_driver_preempt_ssm_handler (FpiSsm *ssm, FpDevice *device)
+{
+  FpiDeviceFake *fake_dev = FPI_DEVICE_FAKE (device);
+  PreemptTestData *data = fake_dev->user_data;
+
+  if (fpi_ssm_get_cur_state (ssm) >= PREEMPT_TEST_CLEANUP_0)
+    {
+      data->cleanup_states++;
+      /* The request was consumed at the boundary that failed the
+       * machine; the cleanup transitions must not see it again. */
+      if (fpi_device_should_preempt (device))
+        data->preempts_in_cleanup++;
+      fpi_ssm_next_state (ssm);
+    }
+  else
+    {
+      data->work_states++;
+      fpi_ssm_next_state_delayed (ssm, 5);
+    }
+}
+
+static void
+test_driver_preempt_ssm_done (FpiSsm *ssm, FpDevice *device, GError *error)
+{
+  fpi_device_verify_complete (device, error);
+}
+
+static void
+fake_device_preempt_verify (FpDevice *device)
+{
+  FpiDeviceFake *fake_dev = FPI_DEVICE_FAKE (device);
+  FpiSsm *ssm;
+
+  fake_dev->last_called_function = fake_device_preempt_verify;
+
+  ssm = fpi_ssm_new_full (device, test_driver_preempt_ssm_handler,
+                          PREEMPT_TEST_N_STATES, PREEMPT_TEST_CLEANUP_0,
+                          "preempt-test");
+  fpi_ssm_start (ssm, test_driver_preempt_ssm_done);
+}
+
+static void
+test_driver_preempt_background_cb (GObject      *source,
+                                   GAsyncResult *res,
+                                   gpointer      user_data)
+{
+  PreemptTestData *data = user_data;
+
+  fp_device_verify_finish (FP_DEVICE (source), res, NULL, NULL,
+                           &data->background_error);
+  data->background_completed = TRUE;
+}
+
+static void
+test_driver_preempt_interactive_cb (GObject      *source,
+                                    GAsyncResult *res,
+                                    gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+  PreemptTestData *data = user_data;
+
+  g_assert_true (fp_device_verify_finish (FP_DEVICE (source), res,
+                                          &data->interactive_match, NULL,
+                                          &error));
+  g_assert_no_error (error);
+  data->interactive_completed = TRUE;
+}
+
+static void
+test_driver_background_preempt (void)
+{
+  g_autoptr(FpAutoResetClass) dev_class = auto_reset_device_class ();
+  g_autoptr(FpAutoCloseDevice) device = NULL;
+  g_autoptr(FpPrint) enrolled_print = NULL;
+  PreemptTestData data = { 0, };
+  FpiDeviceFake *fake_dev;
+
+  dev_class->verify = fake_device_preempt_verify;
+
+  device = auto_close_fake_device_new ();
+  fake_dev = FPI_DEVICE_FAKE (device);
+  fake_dev->user_data = &data;
+  enrolled_print = make_fake_print_reffed (device, NULL);
+
+  fp_device_set_op_queueing (device, TRUE);
+  fp_device_set_background_ops (device, TRUE);
+  fp_device_verify (device, enrolled_print, NULL, NULL, NULL, NULL,
+                    test_driver_preempt_background_cb, &data);
+  g_assert_cmpint (data.work_states, ==, 1);
+
+  /* An interactive arrival asks the running background operation to
+   * yield at its next state boundary. */
+  fp_device_set_background_ops (device, FALSE);
+  dev_class->verify = default_fake_dev_class.verify;
+  fake_dev->ret_result = FPI_MATCH_SUCCESS;
+  fp_device_verify (device, enrolled_print, NULL, NULL, NULL, NULL,
+                    test_driver_preempt_interactive_cb, &data);
+
+  while (!data.interactive_completed)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (data.background_completed);
+  g_assert_error (data.background_error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&data.background_error);
+
+  /* Preempted at the first boundary after the request: no further work
+   * state ran, while both cleanup states did, exactly once each. */
+  g_assert_cmpint (data.work_states, ==, 1);
+  g_assert_cmpint (data.cleanup_states, ==, 2);
+  g_assert_cmpint (data.preempts_in_cleanup, ==, 0);
+  g_assert_true (data.interactive_match);
+}
+
 static void
 test_driver_error_types (void)
 {
@@ -3471,6 +3607,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/driver/cancel/fail", test_driver_cancel_fail);
 
   g_test_add_func ("/driver/critical", test_driver_critical);
+  g_test_add_func ("/driver/background_preempt", test_driver_background_preempt);
 
   g_test_add_func ("/driver/get_current_action", test_driver_current_action);
   g_test_add_func ("/driver/get_current_action/open", test_driver_current_action_open);
@@ -8,7 +8,12 @@ import shutil
 import tempfile
 import subprocess
 
-if len(sys.argv) != 2:
+args = sys.argv[1:]
+benchmark_mode = '--benchmark' in args
+if benchmark_mode:
+    args.remove('--benchmark')
+
+if len(args) != 1:
     print("You need to specify exactly one argument, the directory with test data")
 
 # Check that umockdev is available
@@ -27,7 +32,7 @@ except FileNotFoundError:
     sys.exit(77)
 
 edir = os.path.dirname(sys.argv[0])
-ddir = sys.argv[1]
+ddir = args[0]
 
 tmpdir = tempfile.mkdtemp(prefix='libfprint-umockdev-test-')
 
@@ -94,11 +99,12 @@ def get_umockdev_runner(ioctl_basename):
                     '--']
 
     wrapper = os.getenv('LIBFPRINT_TEST_WRAPPER')
-    return umockdev + (wrapper.split(' ') if wrapper else []) + [sys.executable]
+    return umockdev + (wrapper.split(' ') if wrapper else [])
 
 def capture():
     subprocess.check_call(get_umockdev_runner("capture") +
-                          ['%s' % os.path.join(edir, "capture.py"),
+                          [sys.executable,
+                           '%s' % os.path.join(edir, "capture.py"),
                            '%s' % os.path.join(tmpdir, "capture.png")])
 
     assert os.path.isfile(os.path.join(tmpdir, "capture.png"))
@@ -108,14 +114,46 @@ def capture():
 
 def custom():
     subprocess.check_call(get_umockdev_runner("custom") +
-                          ['%s' % os.path.join(ddir, "custom.py")])
+                          [sys.executable,
+                           '%s' % os.path.join(ddir, "custom.py")])
+
+def benchmark():
+    # Replay the recorded capture repeatedly through the C harness and
+    # aggregate its per-phase timings (activation, frame handling,
+    # minutiae detection) into per-driver throughput numbers.
+    runs = int(os.getenv('FP_BENCHMARK_RUNS', '3'))
+    harness = os.getenv('LIBFPRINT_BENCHMARK_HARNESS')
+    if not harness:
+        build_root = os.getenv('MESON_BUILD_ROOT')
+        assert build_root, \
+            'Set LIBFPRINT_BENCHMARK_HARNESS or MESON_BUILD_ROOT to locate benchmark-capture'
+        harness = os.path.join(build_root, 'tests', 'benchmark-capture')
+
+    phases = {}
+    for i in range(runs):
+        out = subprocess.check_output(get_umockdev_runner("capture") + [harness],
+                                      universal_newlines=True)
+        sys.stdout.write(out)
+        for line in out.splitlines():
+            if line.startswith('phase '):
+                _, name, usecs, _ = line.split()
+                phases.setdefault(name, []).append(float(usecs))
+
+    for name, vals in phases.items():
+        print("benchmark %s: min %.0f us, mean %.0f us over %d runs"
+              % (name, min(vals), sum(vals) / len(vals), len(vals)))
 
 try:
-    if glob.glob(os.path.join(ddir, "capture.*")):
-        capture()
+    if benchmark_mode:
+        assert glob.glob(os.path.join(ddir, "capture.*")), \
+            'Benchmark mode needs a recorded capture'
+        benchmark()
+    else:
+        if glob.glob(os.path.join(ddir, "capture.*")):
+            capture()
 
-    if glob.glob(os.path.join(ddir, "custom.*")):
-        custom()
+        if glob.glob(os.path.join(ddir, "custom.*")):
+            custom()
 
 except Exception as e:
     # Store created output files for inspection (in the build directory)
@@ -8,6 +8,7 @@ try:
 
     from gi.repository import GLib, Gio
 
+    import time
     import unittest
     import socket
     import struct
@@ -113,10 +114,10 @@ class VirtualDeviceBase(unittest.TestCase):
             ctx.iteration(False)
 
     def send_command(self, command, *args):
-        self.assertIn(command, ['INSERT', 'REMOVE', 'SCAN', 'ERROR', 'RETRY',
-            'FINGER', 'UNPLUG', 'SLEEP', 'SET_ENROLL_STAGES', 'SET_SCAN_TYPE',
-            'SET_CANCELLATION_ENABLED', 'SET_KEEP_ALIVE', 'IGNORED_COMMAND',
-            'CONT'])
+        self.assertIn(command, ['INSERT', 'BULK_INSERT', 'REMOVE', 'SCAN',
+            'ERROR', 'RETRY', 'FINGER', 'UNPLUG', 'SLEEP', 'SET_ENROLL_STAGES',
+            'SET_SCAN_TYPE', 'SET_CANCELLATION_ENABLED', 'SET_KEEP_ALIVE',
+            'SET_LATENCY', 'IGNORED_COMMAND', 'CONT'])
 
         with Connection(self.sockaddr) as con:
             params = ' '.join(str(p) for p in args)
@@ -983,6 +984,94 @@ class VirtualDeviceBusyDeviceOperations(VirtualDeviceBase):
                                                 FPrint.DeviceError.BUSY))
 
 
+class VirtualDeviceQueuedOps(VirtualDeviceBase):
+
+    driver_name = 'virtual_device_storage'
+
+    def setUp(self):
+        super().setUp()
+        self.dev.set_op_queueing(True)
+
+    def tearDown(self):
+        self.dev.set_op_queueing(False)
+        if self.dev.is_open() and not self.dev.props.removed:
+            self.dev.clear_storage_sync()
+        super().tearDown()
+
+    def start_queued_op(self, p, order, name, identify=False):
+        def done_cb(dev, res):
+            try:
+                if identify:
+                    dev.identify_finish(res)
+                else:
+                    dev.verify_finish(res)
+            except GLib.Error as e:
+                order.append((name, e))
+            else:
+                order.append((name, None))
+
+        if identify:
+            self.dev.identify(p if isinstance(p, list) else [p],
+                callback=done_cb)
+        else:
+            self.dev.verify(p, callback=done_cb)
+
+    def test_queued_ops_fifo_order(self):
+        p1 = self.enroll_print('queued-1', FPrint.Finger.RIGHT_INDEX)
+        p2 = self.enroll_print('queued-2', FPrint.Finger.RIGHT_MIDDLE)
+
+        order = []
+        self.start_queued_op(p1, order, 'verify-1')
+        self.start_queued_op(p2, order, 'verify-2')
+        self.start_queued_op([p1, p2], order, 'identify', identify=True)
+
+        # Feed one scan at a time; each queued operation must start the
+        # moment the previous one returns, in submission order.
+        for nick, completed in [('queued-1', 1), ('queued-2', 2), ('queued-1', 3)]:
+            self.send_command('SCAN', nick)
+            while len(order) < completed:
+                ctx.iteration(True)
+
+        self.assertEqual([name for name, error in order],
+                         ['verify-1', 'verify-2', 'identify'])
+        for name, error in order:
+            self.assertIsNone(error)
+
+    def test_cancel_queued_op(self):
+        p = self.enroll_print('queued-cancel', FPrint.Finger.RIGHT_INDEX)
+
+        order = []
+        self.start_queued_op(p, order, 'verify-1')
+
+        cancellable = Gio.Cancellable()
+        cancelled = []
+
+        def queued_cb(dev, res):
+            try:
+                dev.verify_finish(res)
+            except GLib.Error as e:
+                cancelled.append(e)
+            else:
+                cancelled.append(None)
+
+        self.dev.verify(p, cancellable=cancellable, callback=queued_cb)
+        cancellable.cancel()
+
+        # Still parked: the cancellation only surfaces when the queue
+        # would start the operation, without touching the device.
+        self.assertEqual(cancelled, [])
+
+        self.send_command('SCAN', 'queued-cancel')
+        while len(cancelled) < 1:
+            ctx.iteration(True)
+
+        self.assertEqual(len(order), 1)
+        self.assertIsNone(order[0][1])
+        self.assertIsNotNone(cancelled[0])
+        self.assertTrue(cancelled[0].matches(Gio.io_error_quark(),
+                                             Gio.IOErrorEnum.CANCELLED))
+
+
 class VirtualDeviceStorage(VirtualDevice):
 
     def tearDown(self):
@@ -991,6 +1080,7 @@ class VirtualDeviceStorage(VirtualDevice):
 
     def cleanup_device_storage(self):
         if self.dev.is_open() and not self.dev.props.removed:
+            self.send_command('SET_LATENCY', 0)
             self.send_command('CONT')
             self.dev.clear_storage_sync()
 
@@ -1031,6 +1121,39 @@ class VirtualDeviceStorage(VirtualDevice):
         print2 = self.enroll_print('p2', FPrint.Finger.LEFT_LITTLE)
         self.assertEqual({'p1', 'p2'}, {p.props.fpi_data.get_string() for p in self.dev.list_prints_sync()})
 
+    def test_list_bulk_populated(self):
+        self.send_command('BULK_INSERT', 10000, 'scaled')
+        stored = self.dev.list_prints_sync()
+        self.assertEqual(len(stored), 10000)
+        self.assertIn('scaled-0',
+            {p.props.fpi_data.get_string() for p in stored})
+        self.assertIn('scaled-9999',
+            {p.props.fpi_data.get_string() for p in stored})
+
+    def test_identify_bulk_populated(self):
+        self.send_command('BULK_INSERT', 10000, 'scaled')
+        rt = self.enroll_print('needle', FPrint.Finger.RIGHT_THUMB)
+
+        self.check_verify([rt], 'needle', identify=True, match=True)
+        self.check_verify([rt], 'scaled-123', identify=True, match=False)
+
+    def test_storage_latency(self):
+        multiplier = 5 if 'UNDER_VALGRIND' in os.environ else 1
+
+        def timed_list():
+            start = time.monotonic()
+            self.dev.list_prints_sync()
+            return time.monotonic() - start
+
+        self.send_command('INSERT', 'p1')
+        base = timed_list()
+
+        self.send_command('SET_LATENCY', 500 * multiplier)
+        self.assertGreaterEqual(timed_list(), base + 0.4 * multiplier)
+
+        self.send_command('SET_LATENCY', 0)
+        self.assertLess(timed_list(), base + 0.4 * multiplier)
+
     def test_list_delete(self):
         p = self.enroll_print('testprint', FPrint.Finger.RIGHT_THUMB)
         l = self.dev.list_prints_sync()
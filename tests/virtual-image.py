@@ -132,6 +132,35 @@ class VirtualImage(unittest.TestCase):
         while iterate and ctx.pending():
             ctx.iteration(False)
 
+    def send_ring_setup(self, images, iterate=True):
+        # Write the named prints back-to-back into a shared-memory ring
+        # file and ask the driver to map it; frames are then injected by
+        # slot index with send_ring_slot.
+        frames = []
+        w = h = None
+        for name in images:
+            img = self.prints[name]
+            if w is None:
+                w, h = img.get_width(), img.get_height()
+            assert (img.get_width(), img.get_height()) == (w, h)
+            frames.append(img.get_data().tobytes())
+
+        path = os.path.join(self.tmpdir, 'image-ring')
+        with open(path, 'wb') as ring:
+            for frame in frames:
+                ring.write(frame)
+
+        ctrl = ('%d %d %d %s' % (w, h, len(frames), path)).encode()
+        self.con.sendall(struct.pack('ii', -6, len(ctrl)) + ctrl)
+        while iterate and ctx.pending():
+            ctx.iteration(False)
+
+    def send_ring_slot(self, slot, iterate=True):
+        # Inject the frame in the given ring slot as a captured image
+        self.con.sendall(struct.pack('ii', -7, slot))
+        while iterate and ctx.pending():
+            ctx.iteration(False)
+
     def test_features(self):
         self.assertTrue(self.dev.has_feature(FPrint.DeviceFeature.CAPTURE))
         self.assertTrue(self.dev.has_feature(FPrint.DeviceFeature.IDENTIFY))
@@ -356,6 +385,30 @@ class VirtualImage(unittest.TestCase):
         assert(self._identify_error is not None)
         assert(self._identify_error.matches(FPrint.device_error_quark(), FPrint.DeviceError.GENERAL))
 
+    def test_shared_memory_injection(self):
+        def verify_cb(dev, res):
+            self._verify_match, self._verify_fp = dev.verify_finish(res)
+
+        fp_tented_arch = self.enroll_print('tented_arch')
+
+        self.send_ring_setup(['tented_arch', 'arch'])
+
+        self._verify_match = None
+        self._verify_fp = None
+        self.dev.verify(fp_tented_arch, callback=verify_cb)
+        self.send_ring_slot(0)
+        while self._verify_match is None:
+            ctx.iteration(True)
+        assert(self._verify_match)
+
+        self._verify_match = None
+        self._verify_fp = None
+        self.dev.verify(fp_tented_arch, callback=verify_cb)
+        self.send_ring_slot(1)
+        while self._verify_match is None:
+            ctx.iteration(True)
+        assert(not self._verify_match)
+
     def test_verify_serialized(self):
         done = False
 